@@ -74,6 +74,42 @@ typedef struct {
     NovaExpr *value;
 } NovaUnaryExpr;
 
+typedef enum {
+    NOVA_OP_ADD,
+    NOVA_OP_SUB,
+    NOVA_OP_MUL,
+    NOVA_OP_DIV,
+    NOVA_OP_MOD,
+    NOVA_OP_LT,
+    NOVA_OP_LE,
+    NOVA_OP_GT,
+    NOVA_OP_GE,
+    NOVA_OP_EQ,
+    NOVA_OP_NE,
+    NOVA_OP_AND,
+    NOVA_OP_OR,
+    NOVA_OP_NEG,
+    NOVA_OP_NOT,
+    NOVA_OP_TO_INT, // Int(x); only produced by IR lowering
+    NOVA_OP_TO_NUMBER, // Number(x); only produced by IR lowering
+    NOVA_OP_LIST_LENGTH, // length(xs); only produced by IR lowering
+    NOVA_OP_LIST_GET, // get(xs, i); only produced by IR lowering
+    NOVA_OP_LIST_PUSH, // push(xs, x); only produced by IR lowering
+    NOVA_OP_MAP_NEW, // Map(keys, values), or Map() with two empty lists; only produced by IR lowering
+    NOVA_OP_MAP_LENGTH, // length(m); only produced by IR lowering
+    NOVA_OP_MAP_GET, // get(m, k); only produced by IR lowering
+    NOVA_OP_MAP_HAS, // has(m, k); only produced by IR lowering
+    NOVA_OP_MAP_PUT, // put(m, k, v); only produced by IR lowering
+    NOVA_OP_MAP_REMOVE, // remove(m, k); only produced by IR lowering
+} NovaOperator;
+
+typedef struct {
+    NovaOperator op;
+    NovaToken op_token;
+    NovaExpr *left;
+    NovaExpr *right; // NULL for the unary operators
+} NovaOperatorExpr;
+
 typedef struct {
     NovaExpr *target;
     NovaExprList stages;
@@ -94,9 +130,31 @@ struct NovaBlock {
     NovaExprList expressions;
 };
 
+typedef enum {
+    NOVA_PATTERN_WILDCARD,
+    NOVA_PATTERN_NAME, // a binding, or a payload-free variant of the matched type
+    NOVA_PATTERN_CONSTRUCTOR,
+    NOVA_PATTERN_LITERAL,
+} NovaPatternKind;
+
+typedef struct NovaPattern NovaPattern;
+
 typedef struct {
-    NovaToken name;
-    NovaParamList bindings;
+    NovaPattern **items;
+    size_t count;
+    size_t capacity;
+} NovaPatternList;
+
+struct NovaPattern {
+    NovaPatternKind kind;
+    NovaToken token; // name, constructor or literal
+    NovaLiteralKind literal_kind; // for NOVA_PATTERN_LITERAL
+    NovaPatternList args; // payload patterns for NOVA_PATTERN_CONSTRUCTOR
+};
+
+typedef struct {
+    NovaPattern *pattern;
+    NovaExpr *guard; // nullable
     NovaExpr *body;
 } NovaMatchArm;
 
@@ -109,6 +167,7 @@ typedef struct {
 typedef struct {
     NovaExpr *scrutinee;
     NovaMatchArmList arms;
+    bool is_let; // a block-local `let pattern = value`; the single arm's body is the rest of the block
 } NovaMatchExpr;
 
 typedef enum {
@@ -126,6 +185,7 @@ typedef enum {
     NOVA_EXPR_BLOCK,
     NOVA_EXPR_LIST_LITERAL,
     NOVA_EXPR_PAREN,
+    NOVA_EXPR_OPERATOR,
 } NovaExprKind;
 
 struct NovaExpr {
@@ -136,6 +196,7 @@ struct NovaExpr {
         NovaWhileExpr while_expr;
         NovaMatchExpr match_expr;
         NovaUnaryExpr unary;
+        NovaOperatorExpr op;
         NovaPipeExpr pipe;
         NovaCallExpr call;
         NovaIdentifier identifier;
@@ -180,7 +241,7 @@ typedef enum {
 typedef struct {
     NovaToken name;
     NovaTypeDeclKind kind;
-    NovaVariantList variants; // for sum types
+    NovaVariantList variants; // for sum types; a tuple type has one, named after the type
     NovaParamList tuple_fields; // for tuple types
 } NovaTypeDecl;
 
@@ -226,6 +287,9 @@ typedef struct {
     size_t decl_capacity;
 } NovaProgram;
 
+// Source spelling of an operator, for diagnostics and generated C.
+const char *nova_operator_lexeme(NovaOperator op);
+
 void nova_param_list_init(NovaParamList *list);
 void nova_param_list_push(NovaParamList *list, NovaParam param);
 void nova_param_list_free(NovaParamList *list);
@@ -238,6 +302,12 @@ void nova_expr_list_init(NovaExprList *list);
 void nova_expr_list_push(NovaExprList *list, NovaExpr *expr);
 void nova_expr_list_free(NovaExprList *list);
 
+NovaPattern *nova_pattern_new(NovaPatternKind kind, NovaToken token);
+void nova_pattern_free(NovaPattern *pattern);
+void nova_pattern_list_init(NovaPatternList *list);
+void nova_pattern_list_push(NovaPatternList *list, NovaPattern *pattern);
+void nova_pattern_list_free(NovaPatternList *list);
+
 void nova_match_arm_list_init(NovaMatchArmList *list);
 void nova_match_arm_list_push(NovaMatchArmList *list, NovaMatchArm arm);
 void nova_match_arm_list_free(NovaMatchArmList *list);
@@ -5,6 +5,20 @@
 #include "nova/ir.h"
 #include "nova/semantic.h"
 
+// The C backend splits programs with many functions into translation units
+// that compile in parallel (at most NOVA_CODEGEN_JOBS at once, by default one
+// per processor) and joins them with an LTO link. When NOVA_CACHE_DIR names a
+// directory, every program is split into small units whose objects are kept
+// there, keyed by a hash of their source and compiler flags, and only units
+// missing from it are compiled.
 bool nova_codegen_emit_object(const NovaIRProgram *program, const NovaSemanticContext *semantics, const char *object_path, char *error_buffer, size_t error_buffer_size);
 
 bool nova_codegen_emit_executable(const NovaIRProgram *program, const NovaSemanticContext *semantics, const char *executable_path, const char *entry_function, char *error_buffer, size_t error_buffer_size);
+
+// Writes the textual LLVM IR for program to ir_path without invoking a compiler.
+bool nova_codegen_emit_llvm_ir(const NovaIRProgram *program, const NovaSemanticContext *semantics, const char *ir_path, char *error_buffer, size_t error_buffer_size);
+
+// Assigns each function a translation unit below units, keeping callees near
+// their callers and each lifted function with the functions referring to it;
+// returns how many units are used.
+size_t nova_codegen_partition(const NovaIRProgram *program, size_t units, size_t *unit_of);
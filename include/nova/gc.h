@@ -11,6 +11,9 @@ typedef void *(*NovaGCAllocFn)(void *ctx, size_t size);
 typedef void (*NovaGCFreeFn)(void *ctx, void *ptr);
 typedef void (*NovaGCTraceFn)(NovaGC *gc, void *payload);
 typedef void (*NovaGCFinalizerFn)(void *payload);
+// Marks roots the collector cannot enumerate as slots, such as a stack scanned
+// conservatively; runs once at the start of every collection.
+typedef void (*NovaGCRootScanFn)(NovaGC *gc, void *ctx);
 
 typedef struct {
     NovaGCAllocFn alloc;
@@ -41,8 +44,16 @@ void *nova_gc_alloc(NovaGC *gc,
 
 bool nova_gc_add_root(NovaGC *gc, void **slot);
 void nova_gc_remove_root(NovaGC *gc, void **slot);
+void nova_gc_set_root_scanner(NovaGC *gc, NovaGCRootScanFn scan, void *ctx);
+
+// Whether payload is the start of a live object's payload.
+bool nova_gc_owns(const NovaGC *gc, const void *payload);
 
 void nova_gc_mark_ptr(NovaGC *gc, void *payload);
+// Call before overwriting a reference held by an object that may already
+// have been traced: while a collection is marking, payload is then kept
+// alive for it, so code that moves the reference elsewhere cannot hide it.
+void nova_gc_write_barrier(NovaGC *gc, void *payload);
 void nova_gc_collect(NovaGC *gc);
 void nova_gc_collect_step(NovaGC *gc, size_t budget_objects);
 
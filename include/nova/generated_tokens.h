@@ -1,7 +1,7 @@
 // Auto-generated from nova.g4. Do not edit manually.
 #pragma once
 
-#define NOVA_TOKEN_KEYWORD_COUNT 16
+#define NOVA_TOKEN_KEYWORD_COUNT 30
 static const char *const nova_token_names[] = {
     "MODULE",
     "IMPORT",
@@ -17,6 +17,20 @@ static const char *const nova_token_names[] = {
     "PIPE",
     "ARROW",
     "EFFECT",
+    "AND",
+    "OR",
+    "NOT",
+    "PLUS",
+    "MINUS",
+    "STAR",
+    "SLASH",
+    "PERCENT",
+    "LT",
+    "LE",
+    "GT",
+    "GE",
+    "EQ",
+    "NE",
     "TRUE",
     "FALSE",
     "NUMBER",
@@ -41,6 +55,18 @@ static const char *const nova_keyword_lexemes[] = {
     "|>",
     "->",
     "!",
+    "and",
+    "or",
+    "not",
+    "-",
+    "/",
+    "%",
+    "<",
+    "<=",
+    ">",
+    ">=",
+    "==",
+    "!=",
     "true",
     "false",
 };
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdint.h>
+
 #include "nova/ast.h"
 #include "nova/semantic.h"
 
@@ -7,6 +9,7 @@ struct NovaIRExpr;
 
 typedef enum {
     NOVA_IR_EXPR_NUMBER,
+    NOVA_IR_EXPR_INT,
     NOVA_IR_EXPR_STRING,
     NOVA_IR_EXPR_BOOL,
     NOVA_IR_EXPR_UNIT,
@@ -17,10 +20,18 @@ typedef enum {
     NOVA_IR_EXPR_IF,
     NOVA_IR_EXPR_WHILE,
     NOVA_IR_EXPR_MATCH,
+    NOVA_IR_EXPR_LET,
+    NOVA_IR_EXPR_ASSIGN,
+    NOVA_IR_EXPR_CONSTRUCT,
+    NOVA_IR_EXPR_OPERATOR,
+    NOVA_IR_EXPR_CLOSURE,
+    NOVA_IR_EXPR_APPLY,
 } NovaIRExprKind;
 
 typedef struct {
     NovaToken constructor;
+    size_t tag; // variant index in the scrutinee's NovaTypeRecord; SIZE_MAX for literal and catch-all arms
+    struct NovaIRExpr *literal; // constant compared against a Number, Int, String or Bool scrutinee; NULL otherwise
     NovaToken *bindings;
     size_t binding_count;
     struct NovaIRExpr *body;
@@ -28,6 +39,13 @@ typedef struct {
 
 typedef struct NovaIRExpr NovaIRExpr;
 
+// Which way a profile says a branch usually goes.
+typedef enum {
+    NOVA_IR_BRANCH_UNKNOWN,
+    NOVA_IR_BRANCH_LIKELY, // the condition almost always holds
+    NOVA_IR_BRANCH_UNLIKELY,
+} NovaIRBranchHint;
+
 typedef struct {
     NovaToken name;
     NovaTypeId type;
@@ -38,8 +56,10 @@ struct NovaIRExpr {
     NovaTypeId type;
     union {
         double number_value;
+        int64_t int_value;
         struct {
-            char *text;
+            char *text; // the literal as written, quotes included; NULL for the empty string
+            size_t index; // its decoded bytes in NovaIRProgram.strings when text is not NULL
         } string_value;
         bool bool_value;
         struct {
@@ -55,11 +75,14 @@ struct NovaIRExpr {
             NovaToken callee;
             NovaIRExpr **args;
             size_t arg_count;
+            NovaEffectMask effects; // effects of the call itself, excluding its arguments
         } call;
         struct {
             NovaIRExpr *condition;
             NovaIRExpr *then_branch;
             NovaIRExpr *else_branch;
+            size_t site; // 1 + index into NovaIRProgram::branch_sites; copies made by inlining share it
+            NovaIRBranchHint hint; // from an applied profile
         } if_expr;
         struct {
             NovaIRExpr *condition;
@@ -70,23 +93,130 @@ struct NovaIRExpr {
             NovaIRMatchArm *arms;
             size_t arm_count;
         } match_expr;
+        struct {
+            NovaToken name;
+            NovaIRExpr *value;
+            NovaIRExpr *body;
+            bool is_mutable; // may be the target of NOVA_IR_EXPR_ASSIGN
+        } let_expr;
+        struct {
+            NovaToken target; // a parameter or mutable let
+            NovaIRExpr *value;
+        } assign;
+        struct {
+            NovaToken constructor;
+            size_t tag; // variant index in the NovaTypeRecord of the expression's type
+            NovaIRExpr **args;
+            size_t arg_count;
+        } construct;
+        struct {
+            NovaOperator op; // never NOVA_OP_AND or NOVA_OP_OR, which lower to NOVA_IR_EXPR_IF
+            NovaIRExpr *left;
+            NovaIRExpr *right; // NULL for unary operators
+            NovaIRExpr *third; // the value of NOVA_OP_MAP_PUT; NULL for every other operator
+        } op;
+        struct {
+            NovaToken function; // program function whose leading capture_count params receive the captures
+            NovaIRExpr **captures; // values copied into the environment: identifiers, or constants once inlined
+            size_t capture_count;
+        } closure;
+        struct {
+            NovaIRExpr *callee; // a function value; calls to known functions are NOVA_IR_EXPR_CALL
+            NovaIRExpr **args;
+            size_t arg_count;
+            NovaEffectMask effects;
+        } apply;
     } as;
 };
 
 typedef struct {
     NovaToken name;
+    uint64_t profile_calls; // entries recorded by an applied profile
     NovaIRParam *params;
     size_t param_count;
     NovaTypeId return_type;
     NovaEffectMask effects;
     NovaIRExpr *body;
+    size_t capture_count; // lifted lambdas: leading params holding captured values
+    bool lifted; // a lambda lifted out of another function's body
+    bool internal; // not part of the module's interface: lifted, or not a root of dead-code elimination
 } NovaIRFunction;
 
+// Profiles identify a branch by its function and its position there, which
+// stay the same from one build of unchanged source to the next.
+typedef struct {
+    NovaToken function;
+    size_t ordinal;
+} NovaIRBranchSite;
+
+// A string literal's decoded bytes, which may include NULs.
+typedef struct {
+    char *bytes;
+    size_t length;
+} NovaIRString;
+
 typedef struct {
     NovaIRFunction *functions;
     size_t function_count;
     size_t function_capacity;
+    NovaTypeId *types; // custom types declared by the module, in declaration order
+    size_t type_count;
+    size_t type_capacity;
+    char **names; // storage for compiler-generated identifiers
+    size_t name_count;
+    size_t name_capacity;
+    size_t name_counter;
+    NovaIRString *strings; // the module's string table: distinct literals, in first-use order
+    size_t string_count;
+    size_t string_capacity;
+    NovaIRBranchSite *branch_sites; // every `if` as lowered, numbered per function in pre-order
+    size_t branch_site_count;
+    bool profiled; // a profile has been applied; see nova/profile.h
 } NovaIRProgram;
 
+typedef struct {
+    size_t *callees; // functions called or referenced as values, deduplicated
+    size_t callee_count;
+    size_t callee_capacity;
+    size_t call_site_count; // call sites in the whole program targeting this function
+    bool recursive; // member of a call-graph cycle, including direct self calls
+} NovaIRCallGraphNode;
+
+typedef struct {
+    NovaIRCallGraphNode *nodes; // parallel to NovaIRProgram::functions
+    size_t node_count;
+    size_t *bottom_up; // every function index, callees before their callers
+    size_t *name_slots; // open-addressed name index storing function index + 1
+    size_t name_mask;
+} NovaIRCallGraph;
+
 NovaIRProgram *nova_ir_lower(const NovaProgram *program, const NovaSemanticContext *semantics);
 void nova_ir_free(NovaIRProgram *program);
+void nova_ir_function_free(NovaIRFunction *fn);
+
+typedef void (*NovaIRChildFn)(NovaIRExpr **slot, void *ctx);
+
+NovaIRExpr *nova_ir_expr_new(NovaIRExprKind kind, NovaTypeId type);
+NovaIRExpr *nova_ir_expr_clone(const NovaIRExpr *expr);
+void nova_ir_expr_free(NovaIRExpr *expr);
+size_t nova_ir_expr_size(const NovaIRExpr *expr);
+void nova_ir_expr_for_each_child(NovaIRExpr *expr, NovaIRChildFn fn, void *ctx);
+void nova_ir_fold_constants(NovaIRExpr **expr);
+
+// Turns calls through closures whose value is known at the call site into
+// direct calls of the lifted function; returns the number of calls rewritten.
+size_t nova_ir_devirtualize(NovaIRProgram *program, const NovaSemanticContext *semantics, NovaIRExpr **body);
+
+// Returns a fresh identifier derived from base that is unique within the program.
+NovaToken nova_ir_fresh_name(NovaIRProgram *program, const NovaToken *base);
+// Decodes a string literal and returns its index in the program's string
+// table, adding it unless an equal string is already there; SIZE_MAX when
+// memory runs out.
+size_t nova_ir_intern_string(NovaIRProgram *program, const char *literal);
+// Returns the index of the named function, or SIZE_MAX when it is not part of the program.
+size_t nova_ir_find_function(const NovaIRProgram *program, const NovaToken *name);
+
+bool nova_ir_call_graph_build(const NovaIRProgram *program, NovaIRCallGraph *graph);
+void nova_ir_call_graph_free(NovaIRCallGraph *graph);
+// Resolves a callee name through the graph's index; SIZE_MAX when the name is not a program function.
+size_t nova_ir_call_graph_lookup(const NovaIRCallGraph *graph, const NovaIRProgram *program, const NovaToken *name);
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "nova/ir.h"
+#include "nova/semantic.h"
+
+// An in-process execution engine over the native backend's encoder. Every
+// function starts as a stub that compiles it on its first call, so only
+// code that actually runs is compiled; calls between functions go through a
+// slot table that the stubs patch. Code pages are writable or executable,
+// never both. Compiled functions are listed in /tmp/perf-<pid>.map so perf
+// can attribute samples to them. The program and semantics must outlive
+// the engine.
+typedef struct NovaJit NovaJit;
+
+typedef struct {
+    NovaTypeKind kind; // NUMBER, INT, BOOL or UNIT
+    union {
+        double number;
+        int64_t int_value;
+        bool bool_value;
+    } as;
+} NovaJitValue;
+
+NovaJit *nova_jit_create(const NovaIRProgram *program, const NovaSemanticContext *semantics);
+void nova_jit_free(NovaJit *jit);
+
+// Runs a function without parameters. Functions it reaches that the native
+// backend cannot compile, and traps such as division by zero, are reported
+// in error_buffer; the engine stays usable afterwards.
+bool nova_jit_call(NovaJit *jit, const char *function, NovaJitValue *result, char *error_buffer, size_t error_buffer_size);
+
+// Compiles function now and returns its address, callable from C with the
+// System V convention; NULL on error. Its callees still compile lazily, and
+// one that cannot be compiled aborts the process.
+void *nova_jit_function(NovaJit *jit, const char *function, char *error_buffer, size_t error_buffer_size);
+
+size_t nova_jit_compiled_count(const NovaJit *jit);
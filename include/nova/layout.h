@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "nova/semantic.h"
+
+// Decides how values of each sum type are held at run time. Both backends
+// read sizes, offsets, tags and niche encodings from here, and sum values are
+// passed by value, so small ones travel in registers.
+
+typedef enum {
+    NOVA_LAYOUT_ENUM, // no variant has a payload: the value is the tag
+    NOVA_LAYOUT_NICHE, // one variant holds a single field; the others are values that field never takes
+    NOVA_LAYOUT_TAGGED, // a tag followed by the variants' payloads overlaid in one union
+    NOVA_LAYOUT_STRUCT, // a single variant with several fields: a plain struct, no tag and no union
+} NovaLayoutKind;
+
+typedef enum {
+    NOVA_REPR_F64,
+    NOVA_REPR_BOOL,
+    NOVA_REPR_INT, // unsigned integer of size bytes
+    NOVA_REPR_PTR,
+    NOVA_REPR_STRUCT, // a tagged or struct layout; niche values live in a tagged layout's tag
+} NovaReprKind;
+
+// Number niche values are signalling NaNs, which arithmetic never produces.
+#define NOVA_LAYOUT_F64_NICHE 0x7ff4000000000000ull
+#define NOVA_LAYOUT_F64_QUIET_NAN 0x7ff8000000000000ull
+
+typedef struct {
+    NovaReprKind kind;
+    size_t size;
+    size_t align;
+    uint64_t niche_start; // first bit pattern no value of the type uses
+    uint64_t niche_count; // unused bit patterns from niche_start on
+} NovaRepr;
+
+typedef struct {
+    NovaTypeId type;
+    size_t offset; // from the start of the variant's payload
+    bool boxed; // the field refers back to a type being laid out, so it is stored behind a pointer
+} NovaFieldLayout;
+
+typedef struct {
+    NovaFieldLayout *fields;
+    size_t field_count;
+    size_t size;
+    size_t align;
+    uint64_t niche_code; // NOVA_LAYOUT_NICHE: the value standing for this payload-free variant
+} NovaVariantLayout;
+
+typedef struct NovaTypeLayout {
+    NovaLayoutKind kind;
+    NovaTypeId type;
+    size_t order; // layouts that embed this one come later
+    NovaRepr repr;
+    char *c_type;
+    char *llvm_type;
+    size_t tag_size; // bytes; 0 for struct layouts
+    size_t payload_offset; // NOVA_LAYOUT_TAGGED and NOVA_LAYOUT_STRUCT
+    size_t payload_size;
+    size_t payload_align;
+    size_t dataful; // NOVA_LAYOUT_NICHE: the variant holding the field
+    NovaVariantLayout *variants; // one per variant, in tag order
+    size_t variant_count;
+} NovaTypeLayout;
+
+// Lays out every type record that has no layout yet.
+void nova_layout_compute(NovaSemanticContext *ctx);
+void nova_layout_free(NovaTypeLayout *layout);
+
+// Returns NULL for types that are not sum types.
+const NovaTypeLayout *nova_layout_of(const NovaSemanticContext *ctx, NovaTypeId type);
+NovaRepr nova_layout_repr(const NovaSemanticContext *ctx, NovaTypeId type);
+
+// For a niche layout, walks down to the tagged layout whose tag holds its
+// niche; NULL when the niche lives in a scalar.
+const NovaTypeLayout *nova_layout_niche_host(const NovaSemanticContext *ctx, const NovaTypeLayout *layout);
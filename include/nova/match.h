@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "nova/ast.h"
+#include "nova/semantic.h"
+
+// Compiles a match expression's pattern matrix into a decision tree that tests
+// every part of the scrutinee at most once. Semantic analysis reads
+// exhaustiveness and unreachable arms off the tree; IR lowering emits it.
+
+typedef enum {
+    NOVA_DECISION_FAIL, // no arm matches the value
+    NOVA_DECISION_ARM, // the arm matches once its guard, if any, holds
+    NOVA_DECISION_SWITCH, // branch on an occurrence's variant tag or literal value
+} NovaDecisionKind;
+
+typedef struct NovaDecision NovaDecision;
+
+typedef struct {
+    size_t tag; // variant index; SIZE_MAX for literal cases
+    const NovaPattern *literal; // literal compared against the occurrence, NULL for variant cases
+    size_t first_field; // occurrence of the first payload field; the others follow in order
+    NovaDecision *next;
+} NovaDecisionCase;
+
+typedef struct {
+    NovaToken name;
+    size_t occurrence;
+} NovaDecisionBinding;
+
+struct NovaDecision {
+    NovaDecisionKind kind;
+    size_t occurrence; // NOVA_DECISION_SWITCH: the value being tested
+    NovaDecisionCase *cases;
+    size_t case_count;
+    NovaDecision *fallback; // values no case covers; NULL when the cases are complete
+    size_t arm; // NOVA_DECISION_ARM
+    NovaDecisionBinding *bindings;
+    size_t binding_count;
+    NovaDecision *guard_failed; // continues matching when the arm's guard is false
+};
+
+typedef struct {
+    NovaTypeId type;
+    size_t parent; // SIZE_MAX for the scrutinee
+    size_t field; // payload index within the parent
+    bool used; // tested or bound somewhere in the tree
+} NovaMatchOccurrence;
+
+typedef struct {
+    NovaDecision *root;
+    NovaMatchOccurrence *occurrences; // occurrence 0 is the scrutinee
+    size_t occurrence_count;
+    size_t occurrence_capacity;
+    bool *arm_reachable; // one entry per arm
+    size_t arm_count;
+    bool exhaustive;
+} NovaMatchPlan;
+
+typedef struct {
+    uint32_t seed;
+    uint32_t *displacements; // indexed by hash & (bucket_count - 1)
+    size_t bucket_count;
+    uint32_t *slots; // key index per slot; empty slots hold 0, so one comparison confirms any lookup
+    size_t slot_count;
+} NovaPerfectHash;
+
+// Returns the variant tag a name or constructor pattern selects in type, or
+// SIZE_MAX when the pattern does not name a variant of that type.
+size_t nova_match_pattern_variant(const NovaSemanticContext *ctx, const NovaPattern *pattern, NovaTypeId type);
+
+bool nova_match_compile(const NovaSemanticContext *ctx, const NovaMatchExpr *match, NovaTypeId scrutinee_type, NovaMatchPlan *plan);
+void nova_match_plan_free(NovaMatchPlan *plan);
+
+// Decodes a quoted string literal; the result is NUL-terminated and owned by the caller.
+char *nova_match_decode_string(const char *literal, size_t length, size_t *out_length);
+
+// Lookup: hash = nova_match_string_hash(text, seed), then
+// slot = nova_match_hash_mix(hash ^ displacements[hash & (bucket_count - 1)]) & (slot_count - 1).
+uint32_t nova_match_string_hash(const char *text, size_t length, uint32_t seed);
+uint32_t nova_match_hash_mix(uint32_t hash);
+bool nova_match_perfect_hash(const char *const *keys, const size_t *lengths, size_t count, NovaPerfectHash *hash);
+void nova_perfect_hash_free(NovaPerfectHash *hash);
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "nova/ir.h"
+#include "nova/semantic.h"
+
+// The native backend encodes x86-64 machine code straight from the IR and
+// writes ELF files itself, so no C compiler or linker runs. It is meant for
+// debug builds where compile latency matters more than code quality and
+// covers the scalar core of the language: Number, Int, Bool and Unit values,
+// calls between the module's functions, conditionals, loops, mutable
+// bindings and literal matches. Anything else is reported as unsupported.
+// nova_codegen_emit_object and nova_codegen_emit_executable route here when
+// NOVA_CODEGEN_BACKEND=native.
+
+// Writes a relocatable ELF object defining every function of program with
+// the System V calling convention, so C code can call them.
+bool nova_native_emit_object(const NovaIRProgram *program, const NovaSemanticContext *semantics, const char *object_path, char *error_buffer, size_t error_buffer_size);
+
+// Writes a static ELF executable whose startup stub calls entry_function and
+// exits with its result, converted as the other backends' main does.
+bool nova_native_emit_executable(const NovaIRProgram *program, const NovaSemanticContext *semantics, const char *executable_path, const char *entry_function, char *error_buffer, size_t error_buffer_size);
+
+// Encodes one function as position-independent machine code for the JIT.
+// Calls to function i jump through call_slots[i], which must outlive the
+// code. The bytes are malloc'd and owned by the caller.
+bool nova_native_encode_function(const NovaIRProgram *program, const NovaSemanticContext *semantics, size_t function_index, void *const *call_slots, uint8_t **code, size_t *code_size, char *error_buffer, size_t error_buffer_size);
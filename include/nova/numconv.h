@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Exact conversions between decimal text and doubles, shared by lowering,
+// match checking and both code generators. Neither direction allocates or
+// needs a NUL-terminated copy of the text.
+
+// Longest text nova_number_format writes, including the terminator.
+#define NOVA_NUMBER_BUFFER_SIZE 32
+
+// Parses digits[.digits][(e|E)[+|-]digits] from the first length bytes of
+// text into the nearest double, ties to even, as strtod would; values beyond
+// the double range become infinity or zero. Returns false, leaving *value
+// untouched, when the text is not such a number.
+bool nova_number_parse(const char *text, size_t length, double *value);
+
+// Parses a run of decimal digits; false when it is not one or does not fit.
+bool nova_integer_parse(const char *text, size_t length, int64_t *value);
+
+// Writes the shortest decimal that parses back to value, always with a
+// '.' so it reads as a double in C and LLVM IR alike (`0.1`, `3.0`,
+// `1.0e300`); returns its length. value must be finite.
+size_t nova_number_format(double value, char *buffer);
+
+// nova_number_format for results shown to people, which also spells out
+// `inf`, `-inf` and `nan`.
+size_t nova_number_show(double value, char *buffer);
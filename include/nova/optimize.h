@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "nova/ir.h"
+#include "nova/semantic.h"
+
+typedef struct {
+    bool inline_functions;
+    size_t inline_threshold; // callee size (IR nodes) that is always worth inlining
+    size_t inline_constant_bonus; // extra budget per constant argument
+    size_t inline_single_call_threshold; // budget for callees with exactly one call site
+    size_t inline_hot_threshold; // budget for profiled calls where caller and callee ran at least 1/64 as often as the hottest function
+    size_t inline_growth_limit; // callers never grow past this many IR nodes
+    bool eliminate_common_calls; // share repeated pure calls and drop unused ones
+    bool eliminate_tail_calls; // turn self tail recursion into loops
+    bool eliminate_dead_functions;
+    const char *const *roots; // entry point or exported functions; when empty every function is kept
+    size_t root_count;
+} NovaOptimizeOptions;
+
+typedef struct {
+    size_t inlined_calls;
+    size_t hoisted_calls;
+    size_t removed_calls;
+    size_t tail_recursive_functions;
+    NovaToken *removed_functions;
+    size_t removed_function_count;
+    size_t removed_function_capacity;
+    NovaToken *removed_types;
+    size_t removed_type_count;
+    size_t removed_type_capacity;
+} NovaOptimizeReport;
+
+void nova_optimize_options_init(NovaOptimizeOptions *options);
+void nova_optimize_report_free(NovaOptimizeReport *report);
+
+size_t nova_optimize_inline(NovaIRProgram *program, const NovaSemanticContext *semantics, const NovaOptimizeOptions *options);
+
+// Returns the number of hoisted pure calls; removed_calls receives the number of unused pure calls dropped.
+size_t nova_optimize_eliminate_common_calls(NovaIRProgram *program, const NovaSemanticContext *semantics, size_t *removed_calls);
+
+// Rewrites self tail calls into loops that reassign the parameters; returns the number of functions rewritten.
+size_t nova_optimize_tail_calls(NovaIRProgram *program, const NovaSemanticContext *semantics);
+
+bool nova_optimize_eliminate_dead_code(NovaIRProgram *program, const NovaSemanticContext *semantics, const char *const *roots, size_t root_count, NovaOptimizeReport *report, char *error_buffer, size_t error_buffer_size);
+
+bool nova_optimize_program(NovaIRProgram *program, const NovaSemanticContext *semantics, const NovaOptimizeOptions *options, NovaOptimizeReport *report, char *error_buffer, size_t error_buffer_size);
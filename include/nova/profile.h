@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "nova/ir.h"
+
+// Profile-guided optimisation. An executable built with NOVA_PGO_GENERATE
+// naming a directory counts how often each function is entered and which
+// way each branch goes, and appends the counts to NOVA_PROFILE_FILE in that
+// directory when its entry function returns; the C compiler's own profile
+// lands in the same directory. Runs accumulate, one record per line:
+//
+//   function <name> <calls> <branch sites>
+//   branch <function> <ordinal> <taken> <not taken>
+//
+// Functions and branches are named as in the source (see NovaIRBranchSite),
+// so a profile outlives rebuilds; records of a function whose number of
+// branch sites changed are ignored as stale.
+#define NOVA_PROFILE_FILE "nova.profile"
+
+// Reads the profile in directory into a freshly lowered program: it sets
+// each function's profile_calls and hints the branches that went one way at
+// least nine times in ten, then marks the program profiled.
+bool nova_profile_apply(NovaIRProgram *program, const char *directory, char *error_buffer, size_t error_buffer_size);
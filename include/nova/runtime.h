@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Entry points of libnovart, the runtime statically linked into every
+// executable the code generators produce. Generated code declares these
+// itself rather than including this header, so the two must agree.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Traces one heap object: marks every managed pointer the payload holds
+// with nova_rt_mark. gc is the collector passed through opaquely.
+typedef void (*NovaRTTraceFn)(void *gc, void *payload);
+
+// Called by the generated main before the entry function runs. stack_base
+// is the address of a local in main; everything between it and the
+// collecting frame is scanned conservatively for roots.
+void nova_rt_init(void *stack_base);
+void nova_rt_shutdown(void);
+
+// Returns zeroed managed memory; aborts when the allocator fails. A
+// runtime that was never initialised allocates without ever collecting.
+void *nova_rt_alloc(size_t size, NovaRTTraceFn trace);
+
+// Marks payload if it is a managed object; anything else, such as a
+// static closure or a niche value, is ignored.
+void nova_rt_mark(void *gc, const void *payload);
+
+// Runtime code that updates an object in place calls this before
+// overwriting a reference in it, so a collection under way still traces
+// what the reference named.
+void nova_rt_write_barrier(const void *payload);
+
+// The trace function of a heap cell holding one reference, such as a list
+// element that is a function value or another list.
+void nova_rt_trace_ref(void *gc, void *payload);
+
+// Persistent lists (runtime/list.cpp). Elements are elem_size bytes each,
+// traced with elem_trace when it is not NULL. nova_list_new copies count
+// elements, or zeroes them when elements is NULL, into one allocation.
+void *nova_list_new(size_t elem_size, NovaRTTraceFn elem_trace, size_t count, const void *elements);
+int64_t nova_list_length(const void *list);
+// Aborts when index is out of range.
+const void *nova_list_at(const void *list, int64_t index);
+// A new list with element appended; list itself is unchanged.
+void *nova_list_push(const void *list, size_t elem_size, NovaRTTraceFn elem_trace, const void *element);
+
+// Strings (runtime/string.cpp) are immutable and pointer-sized. A value with
+// bit 0 set holds up to NOVA_STRING_INLINE_MAX bytes itself: the length in
+// bits 1..3 and byte i in bits 8i+8..8i+15, the rest zero. Any other value
+// points at a NovaString, which the code generators also emit for literals
+// in each module's read-only string table.
+#define NOVA_STRING_INLINE_MAX 7
+
+enum {
+    NOVA_STRING_FLAT, // length bytes and a NUL follow the header
+    NOVA_STRING_ROPE, // the left and right Strings follow the header
+    NOVA_STRING_TAIL, // a String and a flat append buffer holding the bytes after it follow
+};
+
+typedef struct {
+    uint64_t length;
+    uint32_t kind;
+    uint32_t depth; // ropes: the levels of ropes below and including this one
+} NovaString;
+
+// O(1).
+int64_t nova_string_length(const void *string);
+// Short results are copied; long ones share both operands under a rope node,
+// rebalanced so that ropes stay logarithmically deep.
+const void *nova_string_concat(const void *left, const void *right);
+// Seeded FNV-1a over the bytes; agrees with nova_match_string_hash.
+uint32_t nova_string_hash(const void *string, uint32_t seed);
+bool nova_string_equal(const void *left, const void *right);
+
+// Maps (runtime/map.cpp) are persistent hash array mapped tries. Keys are
+// Ints or Strings passed as 64-bit words; values are value_size bytes each,
+// traced with value_trace when it is not NULL. Functions that add entries
+// take the key kind and value layout, since the map they start from may be
+// an empty one whose types were never known.
+enum {
+    NOVA_MAP_INT_KEYS,
+    NOVA_MAP_STRING_KEYS,
+};
+
+void *nova_map_new(void);
+int64_t nova_map_length(const void *map);
+// The value stored under key, or NULL when there is none.
+const void *nova_map_find(const void *map, uint64_t key);
+// Aborts when key is absent.
+const void *nova_map_at(const void *map, uint64_t key);
+// New maps with key set to value or without key; map itself is unchanged.
+void *nova_map_put(const void *map, uint32_t key_kind, size_t value_size, NovaRTTraceFn value_trace, uint64_t key, const void *value);
+void *nova_map_remove(const void *map, uint64_t key);
+
+// A transient builds a map by updating the nodes it created in place rather
+// than copying a path per entry. nova_map_persistent ends it; the map it
+// returns is immutable like any other and the transient must not be used
+// again.
+void *nova_map_transient(const void *map);
+void nova_map_transient_put(void *transient, uint32_t key_kind, size_t value_size, NovaRTTraceFn value_trace, uint64_t key, const void *value);
+void *nova_map_persistent(void *transient);
+// The map of keys[i] to values[i], built with a transient; later keys win.
+// Aborts when the two lists differ in length.
+void *nova_map_from_lists(uint32_t key_kind, size_t value_size, NovaRTTraceFn value_trace, const void *keys, const void *values);
+
+#ifdef __cplusplus
+}
+#endif
@@ -8,10 +8,12 @@ typedef size_t NovaTypeId;
 typedef enum {
     NOVA_TYPE_KIND_UNKNOWN,
     NOVA_TYPE_KIND_NUMBER,
+    NOVA_TYPE_KIND_INT,
     NOVA_TYPE_KIND_STRING,
     NOVA_TYPE_KIND_BOOL,
     NOVA_TYPE_KIND_UNIT,
     NOVA_TYPE_KIND_LIST,
+    NOVA_TYPE_KIND_MAP,
     NOVA_TYPE_KIND_FUNCTION,
     NOVA_TYPE_KIND_CUSTOM,
 } NovaTypeKind;
@@ -23,6 +25,7 @@ typedef enum {
 } NovaEffectMask;
 
 struct NovaTypeRecord;
+struct NovaTypeLayout;
 
 typedef struct {
     NovaTypeKind kind;
@@ -30,6 +33,10 @@ typedef struct {
         struct {
             NovaTypeId element;
         } list;
+        struct {
+            NovaTypeId key;
+            NovaTypeId value;
+        } map;
         struct {
             NovaTypeId *params;
             size_t param_count;
@@ -60,6 +67,7 @@ typedef struct NovaScope {
 typedef struct {
     const NovaVariantDecl *variant;
     size_t arity;
+    NovaTypeId *payload_types; // arity entries; the variant's tag is its index in the record
 } NovaVariantRecord;
 
 typedef struct NovaTypeRecord {
@@ -67,6 +75,7 @@ typedef struct NovaTypeRecord {
     NovaTypeId type_id;
     NovaVariantRecord *variants;
     size_t variant_count;
+    struct NovaTypeLayout *layout; // run-time representation, set once the program's types are registered
 } NovaTypeRecord;
 
 typedef struct {
@@ -104,6 +113,8 @@ typedef struct {
     NovaTypeId type_number;
     NovaTypeId type_string;
     NovaTypeId type_bool;
+    NovaTypeId type_int;
+    NovaTypeId expected_type; // consumed by the next analyze_expr; types integral literals
 } NovaSemanticContext;
 
 void nova_semantic_context_init(NovaSemanticContext *ctx);
@@ -112,3 +123,25 @@ void nova_semantic_analyze_program(NovaSemanticContext *ctx, const NovaProgram *
 const NovaExprInfo *nova_semantic_lookup_expr(const NovaSemanticContext *ctx, const NovaExpr *expr);
 const NovaTypeInfo *nova_semantic_type_info(const NovaSemanticContext *ctx, NovaTypeId type_id);
 const NovaTypeRecord *nova_semantic_find_type(const NovaSemanticContext *ctx, const NovaToken *name);
+const NovaTypeRecord *nova_semantic_type_record(const NovaSemanticContext *ctx, NovaTypeId type_id);
+// True when callee names the built-in Int or Number conversion rather than a binding.
+bool nova_semantic_is_conversion(const NovaSemanticContext *ctx, const NovaExpr *callee);
+// Splits a type annotation such as `List[Number]` into its name and type
+// argument; false when it has none.
+bool nova_semantic_split_type_argument(const NovaToken *token, NovaToken *name, NovaToken *argument);
+// The list type of the given element type, or type_unknown when no
+// expression or annotation in the program has that type.
+NovaTypeId nova_semantic_list_type(const NovaSemanticContext *ctx, NovaTypeId element);
+// Splits type arguments such as `String, Int` at their top-level comma;
+// false when there is no such comma.
+bool nova_semantic_split_type_pair(const NovaToken *arguments, NovaToken *first, NovaToken *second);
+// The map type with the given key and value types, or type_unknown when no
+// expression or annotation in the program has that type.
+NovaTypeId nova_semantic_map_type(const NovaSemanticContext *ctx, NovaTypeId key, NovaTypeId value);
+// True when callee names the built-in length, get or push on lists; length
+// and get apply to maps as well.
+bool nova_semantic_is_list_builtin(const NovaSemanticContext *ctx, const NovaExpr *callee);
+// True when callee names the built-in Map, put, has or remove.
+bool nova_semantic_is_map_builtin(const NovaSemanticContext *ctx, const NovaExpr *callee);
+// Returns the tag of the named variant, or SIZE_MAX when record has no such variant.
+size_t nova_semantic_find_variant(const NovaTypeRecord *record, const NovaToken *name);
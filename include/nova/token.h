@@ -39,6 +39,20 @@ typedef enum {
     NOVA_TOKEN_ARROW_FN, /* alias for ARROW for clarity */
     NOVA_TOKEN_PIPE_OPERATOR, /* alias for PIPE */
     NOVA_TOKEN_BANG,
+    NOVA_TOKEN_PLUS,
+    NOVA_TOKEN_MINUS,
+    NOVA_TOKEN_STAR,
+    NOVA_TOKEN_SLASH,
+    NOVA_TOKEN_PERCENT,
+    NOVA_TOKEN_LESS,
+    NOVA_TOKEN_LESS_EQUAL,
+    NOVA_TOKEN_GREATER,
+    NOVA_TOKEN_GREATER_EQUAL,
+    NOVA_TOKEN_EQUAL_EQUAL,
+    NOVA_TOKEN_BANG_EQUAL,
+    NOVA_TOKEN_AND,
+    NOVA_TOKEN_OR,
+    NOVA_TOKEN_NOT,
     NOVA_TOKEN_EOF,
     NOVA_TOKEN_ERROR
 } NovaTokenType;
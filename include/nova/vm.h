@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "nova/gc.h"
+#include "nova/ir.h"
+#include "nova/semantic.h"
+
+// A bytecode interpreter for hosts that cannot run a C compiler and for
+// fast startup. nova_vm_compile translates a whole NovaIRProgram into a
+// register-based instruction set: each function gets a frame of virtual
+// registers, and instructions name their operands by register. The loop
+// dispatches with computed gotos where the compiler supports them. Fused
+// instructions cover compare-and-branch, add-immediate and calls in tail
+// position, and calls through function values keep a per-site inline cache.
+// Sum, tuple and closure values live on the VM's own collector
+// (nova_gc_alloc). Strings, lists and maps are not supported: code using them
+// compiles to an instruction that reports why when it is reached.
+typedef struct NovaVMProgram NovaVMProgram;
+typedef struct NovaVM NovaVM;
+
+typedef struct {
+    NovaTypeKind kind; // NUMBER, INT, BOOL and UNIT are scalars; CUSTOM and FUNCTION are objects
+    union {
+        double number;
+        int64_t int_value;
+        bool bool_value;
+        const void *object; // valid until the VM's next collection
+    } as;
+} NovaVMValue;
+
+// Fails only when memory runs out; unsupported code is reported when
+// reached. The result does not refer to program or semantics.
+NovaVMProgram *nova_vm_compile(const NovaIRProgram *program, const NovaSemanticContext *semantics, char *error_buffer, size_t error_buffer_size);
+void nova_vm_program_free(NovaVMProgram *program);
+// Writes function's bytecode, one instruction per line; false when there is
+// no such function.
+bool nova_vm_disassemble(const NovaVMProgram *program, const char *function, FILE *out);
+
+// The program's inline caches are updated as it runs, so a program should
+// run in one VM at a time.
+NovaVM *nova_vm_create(NovaVMProgram *program);
+void nova_vm_free(NovaVM *vm);
+bool nova_vm_call(NovaVM *vm, const char *function, const NovaVMValue *args, size_t arg_count, NovaVMValue *result, char *error_buffer, size_t error_buffer_size);
+NovaGCStats nova_vm_gc_stats(const NovaVM *vm);
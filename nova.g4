@@ -1,152 +1,214 @@
-grammar nova;
-
-// --------------------------------------------------------------------
-//  LEXER
-// --------------------------------------------------------------------
-MODULE  : 'module';
-IMPORT  : 'import';
-FUN     : 'fun';
-LET     : 'let';
-TYPE    : 'type';
+grammar nova;
+
+// --------------------------------------------------------------------
+//  LEXER
+// --------------------------------------------------------------------
+MODULE  : 'module';
+IMPORT  : 'import';
+FUN     : 'fun';
+LET     : 'let';
+TYPE    : 'type';
 IF      : 'if';
 WHILE   : 'while';
 ELSE    : 'else';
 MATCH   : 'match';
-ASYNC   : 'async';
-AWAIT   : 'await';
-PIPE    : '|>';
-ARROW   : '->';
-EFFECT  : '!';
-TRUE    : 'true';
-FALSE   : 'false';
-NUMBER  : [0-9]+ ('.' [0-9]+)?;
-STRING  : '"' (~["\\] | '\\' .)* '"' | '"""' .*? '"""';
-ID      : [a-zA-Z_][a-zA-Z_0-9]*;
-COMMENT : '#' ~[\r\n]* -> skip;
-WS      : [ \t\r\n]+ -> skip;
-
-// --------------------------------------------------------------------
-//  PARSER
-// --------------------------------------------------------------------
-program
-    : moduleDecl importDecl* decl* EOF
-    ;
-
-moduleDecl
-    : MODULE modulePath
-    ;
-
-importDecl
-    : IMPORT modulePath ('{' ID (',' ID)* '}')?
-    ;
-
-modulePath
-    : ID ('.' ID)*
-    ;
-
-decl
-    : typeDecl
-    | funDecl
-    | letDecl
-    ;
-
-typeDecl
-    : TYPE ID ('=' variantList | '(' paramList? ')')
-    ;
-
-variantList
-    : ID ('|' ID)*
-    ;
-
-funDecl
-    : FUN ID '(' paramList? ')' (':' typeRef)? '=' expr
-    ;
-
-letDecl
-    : LET ID (':' typeRef)? '=' expr
-    ;
-
-paramList
-    : param (',' param)*
-    ;
-
-param
-    : ID (':' typeRef)?
-    ;
-
-typeRef
-    : ID
-    ;
-
-// --------------------------------------------------------------------
-//  EXPRESSIONS
-// --------------------------------------------------------------------
+ASYNC   : 'async';
+AWAIT   : 'await';
+PIPE    : '|>';
+ARROW   : '->';
+EFFECT  : '!';
+AND     : 'and';
+OR      : 'or';
+NOT     : 'not';
+PLUS    : '+';
+MINUS   : '-';
+STAR    : '*';
+SLASH   : '/';
+PERCENT : '%';
+LT      : '<';
+LE      : '<=';
+GT      : '>';
+GE      : '>=';
+EQ      : '==';
+NE      : '!=';
+TRUE    : 'true';
+FALSE   : 'false';
+NUMBER  : [0-9]+ ('.' [0-9]+)?;
+STRING  : '"' (~["\\] | '\\' .)* '"' | '"""' .*? '"""';
+ID      : [a-zA-Z_][a-zA-Z_0-9]*;
+COMMENT : '#' ~[\r\n]* -> skip;
+WS      : [ \t\r\n]+ -> skip;
+
+// --------------------------------------------------------------------
+//  PARSER
+// --------------------------------------------------------------------
+program
+    : moduleDecl importDecl* decl* EOF
+    ;
+
+moduleDecl
+    : MODULE modulePath
+    ;
+
+importDecl
+    : IMPORT modulePath ('{' ID (',' ID)* '}')?
+    ;
+
+modulePath
+    : ID ('.' ID)*
+    ;
+
+decl
+    : typeDecl
+    | funDecl
+    | letDecl
+    ;
+
+typeDecl
+    : TYPE ID ('=' variantList | '(' paramList? ')')
+    ;
+
+variantList
+    : ID ('|' ID)*
+    ;
+
+funDecl
+    : FUN ID '(' paramList? ')' (':' typeRef)? '=' expr
+    ;
+
+letDecl
+    : LET ID (':' typeRef)? '=' expr
+    ;
+
+paramList
+    : param (',' param)*
+    ;
+
+param
+    : ID (':' typeRef)?
+    ;
+
+typeRef
+    : ID
+    ;
+
+// --------------------------------------------------------------------
+//  EXPRESSIONS
+// --------------------------------------------------------------------
 expr
     : IF expr block (ELSE block)?                 #ifExpr
     | WHILE expr block                            #whileExpr
     | MATCH expr '{' matchArm+ '}'                #matchExpr
-    | ASYNC block                                 #asyncExpr
-    | AWAIT expr                                  #awaitExpr
-    | EFFECT expr                                 #effectExpr
-    | pipeExpr                                    #pipeExpr
-    ;
-
-pipeExpr
-    : callExpr (PIPE callExpr)*
-    ;
-
-callExpr
-    : primary ('(' argList? ')')*
-    ;
-
-argList
-    : arg (',' arg)*
-    ;
-
-arg
-    : (ID '=')? expr
-    ;
-
-primary
-    : literal
-    | ID
-    | lambda
-    | '(' expr ')'
-    ;
-
-lambda
-    : '(' paramList? ')' ARROW expr
-    ;
-
-// --------------------------------------------------------------------
-//  MATCH / BLOCK
-// --------------------------------------------------------------------
-matchArm
-    : ID ('(' paramList? ')')? ARROW expr
-    ;
-
-block
-    : '{' exprList? '}'
-    ;
-
-exprList
-    : expr (';' expr)*
-    ;
-
-// --------------------------------------------------------------------
-//  LITERALS
-// --------------------------------------------------------------------
-literal
-    : NUMBER
-    | STRING
-    | TRUE
-    | FALSE
-    | listLiteral
-    ;
-
-listLiteral
-    : '[' (expr (',' expr)*)? ']'
-    ;
-
-// --------------------------------------------------------------------
-
+    | ASYNC block                                 #asyncExpr
+    | AWAIT expr                                  #awaitExpr
+    | EFFECT expr                                 #effectExpr
+    | pipeExpr                                    #pipeExpr
+    ;
+
+pipeExpr
+    : orExpr (PIPE callExpr)*
+    ;
+
+// Binary operators associate to the left; each level binds tighter than the
+// one above it.
+orExpr
+    : andExpr (OR andExpr)*
+    ;
+
+andExpr
+    : equalityExpr (AND equalityExpr)*
+    ;
+
+equalityExpr
+    : compareExpr ((EQ | NE) compareExpr)*
+    ;
+
+compareExpr
+    : addExpr ((LT | LE | GT | GE) addExpr)*
+    ;
+
+addExpr
+    : mulExpr ((PLUS | MINUS) mulExpr)*
+    ;
+
+mulExpr
+    : unaryExpr ((STAR | SLASH | PERCENT) unaryExpr)*
+    ;
+
+unaryExpr
+    : (MINUS | NOT) unaryExpr
+    | callExpr
+    ;
+
+callExpr
+    : primary ('(' argList? ')')*
+    ;
+
+argList
+    : arg (',' arg)*
+    ;
+
+arg
+    : (ID '=')? expr
+    ;
+
+primary
+    : literal
+    | ID
+    | lambda
+    | '(' expr ')'
+    ;
+
+lambda
+    : '(' paramList? ')' ARROW expr
+    ;
+
+// --------------------------------------------------------------------
+//  MATCH / BLOCK
+// --------------------------------------------------------------------
+matchArm
+    : pattern (IF expr)? ARROW expr
+    ;
+
+// `_` is a wildcard; a bare ID is a payload-free variant of the matched type
+// when one exists and a binding otherwise.
+pattern
+    : ID '(' (pattern (',' pattern)*)? ')'
+    | ID
+    | NUMBER
+    | STRING
+    | TRUE
+    | FALSE
+    ;
+
+block
+    : '{' exprList? '}'
+    ;
+
+exprList
+    : blockItem (';' blockItem)*
+    ;
+
+// A block-local let scopes over the rest of the block.
+blockItem
+    : LET pattern '=' expr
+    | expr
+    ;
+
+// --------------------------------------------------------------------
+//  LITERALS
+// --------------------------------------------------------------------
+literal
+    : NUMBER
+    | STRING
+    | TRUE
+    | FALSE
+    | listLiteral
+    ;
+
+listLiteral
+    : '[' (expr (',' expr)*)? ']'
+    ;
+
+// --------------------------------------------------------------------
+
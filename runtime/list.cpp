@@ -0,0 +1,197 @@
+#include "nova/runtime.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Lists are persistent: nova_list_push returns a new list and leaves its
+// operand intact. A list is a small header pointing at a leaf that holds its
+// last elements, the tail. Once the tail holds LIST_BRANCH elements, the next
+// push hangs that leaf in a radix-balanced tree of LIST_BRANCH-element leaves,
+// as in Clojure's vectors, and starts a new tail. Elements always sit
+// contiguously, in leaves or in the tail.
+//
+// Headers share their tail. A leaf counts the slots some list has claimed,
+// and a push onto the list that claimed the last of them writes into the next
+// slot in place and allocates only a header; pushing onto an older version
+// copies the tail instead. Appending in a loop thus allocates one header per
+// element and one leaf per LIST_BRANCH elements, plus the path to the
+// rightmost leaf. Slots are only ever filled once, so no reference a
+// collection has seen is overwritten and the write needs no barrier.
+//
+// There is no concatenation or slicing, so every leaf is full and indexes
+// never need the size tables of relaxed trees.
+
+#define LIST_BITS 5
+#define LIST_BRANCH (1u << LIST_BITS)
+#define LIST_MASK (LIST_BRANCH - 1)
+
+typedef struct {
+    size_t elem_size;
+    NovaRTTraceFn elem_trace;
+    size_t filled; // slots claimed by some list
+    size_t capacity;
+} ListLeaf; // followed by capacity elements; LIST_BRANCH in the tree
+
+typedef struct {
+    const void *children[LIST_BRANCH]; // branches, or leaves at the bottom level
+} ListBranch;
+
+typedef struct {
+    size_t length;
+    const ListBranch *root; // NULL until the first leaf moves out of the tail
+    ListLeaf *tail;
+    uint32_t tail_count; // elements of tail this list owns; the ones before them are in the tree
+    uint32_t shift; // LIST_BITS times the number of branch levels
+} ListHeader;
+
+// Element data follows a header at an offset that suits any element type.
+#define LIST_DATA_OFFSET(type) ((sizeof(type) + 15) & ~(size_t)15)
+
+static unsigned char *leaf_data(const ListLeaf *leaf) {
+    return (unsigned char *)leaf + LIST_DATA_OFFSET(ListLeaf);
+}
+
+static void trace_elements(void *gc, NovaRTTraceFn trace, unsigned char *data, size_t elem_size, size_t count) {
+    if (!trace) return;
+    for (size_t i = 0; i < count; ++i) {
+        trace(gc, data + i * elem_size);
+    }
+}
+
+static void trace_leaf(void *gc, void *payload) {
+    const ListLeaf *leaf = static_cast<const ListLeaf *>(payload);
+    trace_elements(gc, leaf->elem_trace, leaf_data(leaf), leaf->elem_size, leaf->filled);
+}
+
+static void trace_branch(void *gc, void *payload) {
+    const ListBranch *branch = static_cast<const ListBranch *>(payload);
+    for (size_t i = 0; i < LIST_BRANCH; ++i) {
+        nova_rt_mark(gc, branch->children[i]);
+    }
+}
+
+static void trace_list(void *gc, void *payload) {
+    const ListHeader *list = static_cast<const ListHeader *>(payload);
+    nova_rt_mark(gc, list->root);
+    nova_rt_mark(gc, list->tail);
+}
+
+// The header is allocated after the nodes it points at, so a collection
+// never sees it half built.
+static ListHeader *header_new(size_t length, unsigned shift, const ListBranch *root, ListLeaf *tail, size_t tail_count) {
+    ListHeader *list = static_cast<ListHeader *>(nova_rt_alloc(sizeof(ListHeader), trace_list));
+    list->length = length;
+    list->tail_count = tail_count;
+    list->shift = shift;
+    list->root = root;
+    list->tail = tail;
+    return list;
+}
+
+// A leaf with room for capacity elements, the first count copied from elements.
+static ListLeaf *leaf_new(size_t elem_size, NovaRTTraceFn elem_trace, size_t capacity, const void *elements, size_t count) {
+    ListLeaf *leaf = static_cast<ListLeaf *>(nova_rt_alloc(LIST_DATA_OFFSET(ListLeaf) + elem_size * capacity, trace_leaf));
+    leaf->elem_size = elem_size;
+    leaf->elem_trace = elem_trace;
+    leaf->filled = count;
+    leaf->capacity = capacity;
+    if (count > 0) memcpy(leaf_data(leaf), elements, elem_size * count);
+    return leaf;
+}
+
+static ListBranch *branch_copy(const ListBranch *branch) {
+    ListBranch *copy = static_cast<ListBranch *>(nova_rt_alloc(sizeof(ListBranch), trace_branch));
+    if (branch) *copy = *branch;
+    return copy;
+}
+
+// A chain of single-child branches leading down level bits to leaf.
+static const void *new_path(unsigned level, const ListLeaf *leaf) {
+    if (level == 0) return leaf;
+    ListBranch *branch = branch_copy(NULL);
+    branch->children[0] = new_path(level - LIST_BITS, leaf);
+    return branch;
+}
+
+// Copies the path down to where the leaf holding elements
+// [count - LIST_BRANCH, count) belongs and hangs leaf there.
+static ListBranch *push_leaf(unsigned level, const ListBranch *parent, size_t count, const ListLeaf *leaf) {
+    size_t index = ((count - 1) >> level) & LIST_MASK;
+    ListBranch *copy = branch_copy(parent);
+    if (level == LIST_BITS) {
+        copy->children[index] = leaf;
+    } else {
+        const ListBranch *child = parent ? static_cast<const ListBranch *>(parent->children[index]) : NULL;
+        copy->children[index] = child ? push_leaf(level - LIST_BITS, child, count, leaf) : new_path(level - LIST_BITS, leaf);
+    }
+    return copy;
+}
+
+// Adds a full leaf after the count - LIST_BRANCH elements under root,
+// growing the tree a level when root is full.
+static const ListBranch *root_with_leaf(const ListBranch *root, unsigned *shift, size_t count, const ListLeaf *leaf) {
+    if ((count >> LIST_BITS) > ((size_t)1 << *shift)) {
+        ListBranch *grown = branch_copy(NULL);
+        grown->children[0] = root;
+        grown->children[1] = new_path(*shift, leaf);
+        *shift += LIST_BITS;
+        return grown;
+    }
+    return push_leaf(*shift, root, count, leaf);
+}
+
+// A literal keeps its last 1..LIST_BRANCH elements in a tail that is exactly
+// their size, and any before them in full leaves.
+extern "C" void *nova_list_new(size_t elem_size, NovaRTTraceFn elem_trace, size_t count, const void *elements) {
+    const unsigned char *data = static_cast<const unsigned char *>(elements);
+    size_t tree_count = count > 0 ? ((count - 1) >> LIST_BITS) << LIST_BITS : 0;
+    const ListBranch *root = NULL;
+    unsigned shift = LIST_BITS;
+    for (size_t start = 0; start < tree_count; start += LIST_BRANCH) {
+        const ListLeaf *leaf = leaf_new(elem_size, elem_trace, LIST_BRANCH, data + start * elem_size, LIST_BRANCH);
+        root = root_with_leaf(root, &shift, start + LIST_BRANCH, leaf);
+    }
+    size_t tail_count = count - tree_count;
+    ListLeaf *tail = leaf_new(elem_size, elem_trace, tail_count, data + tree_count * elem_size, tail_count);
+    return header_new(count, shift, root, tail, tail_count);
+}
+
+extern "C" int64_t nova_list_length(const void *list) {
+    return (int64_t) static_cast<const ListHeader *>(list)->length;
+}
+
+extern "C" const void *nova_list_at(const void *list, int64_t index) {
+    const ListHeader *header = static_cast<const ListHeader *>(list);
+    if (index < 0 || (uint64_t)index >= header->length) abort();
+    size_t i = (size_t)index;
+    size_t tail_start = header->length - header->tail_count;
+    const ListLeaf *tail = header->tail;
+    if (i >= tail_start) return leaf_data(tail) + (i - tail_start) * tail->elem_size;
+    const void *node = header->root;
+    for (unsigned level = header->shift; level > 0; level -= LIST_BITS) {
+        node = static_cast<const ListBranch *>(node)->children[(i >> level) & LIST_MASK];
+    }
+    return leaf_data(static_cast<const ListLeaf *>(node)) + (i & LIST_MASK) * tail->elem_size;
+}
+
+extern "C" void *nova_list_push(const void *list, size_t elem_size, NovaRTTraceFn elem_trace, const void *element) {
+    const ListHeader *header = static_cast<const ListHeader *>(list);
+    size_t length = header->length;
+    size_t count = header->tail_count;
+    ListLeaf *tail = header->tail;
+    if (count == LIST_BRANCH) {
+        // The tail is full: the leaf itself moves into the tree and a new one starts.
+        unsigned shift = header->shift;
+        const ListBranch *root = root_with_leaf(header->root, &shift, length, tail);
+        return header_new(length + 1, shift, root, leaf_new(elem_size, elem_trace, LIST_BRANCH, element, 1), 1);
+    }
+    if (tail->filled != count || count == tail->capacity) {
+        // Another version already claimed the next slot, or this is a
+        // literal's tail with no room left.
+        tail = leaf_new(elem_size, elem_trace, LIST_BRANCH, leaf_data(tail), count);
+    }
+    memcpy(leaf_data(tail) + elem_size * count, element, elem_size);
+    tail->filled = count + 1;
+    return header_new(length + 1, header->shift, header->root, tail, count + 1);
+}
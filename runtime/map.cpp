@@ -0,0 +1,431 @@
+#include "nova/runtime.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Maps are compressed hash array mapped tries in the CHAMP layout. Each node
+// consumes MAP_BITS bits of a key's 32-bit hash and keeps two bitmaps over
+// the 32 values those bits can take: datamap marks fragments whose single
+// entry sits in the node itself, nodemap those that lead to a child. Entries
+// and children are packed in bitmap order, so a fragment's slot is the
+// popcount of the bitmap below its bit and nodes have no empty slots. Keys
+// whose hashes agree in every bit end up in a collision node that is searched
+// linearly.
+//
+// Updates copy the path from the root to the changed node and share the rest
+// with the map they started from. Removal keeps the trie canonical: a child
+// left with one entry is pulled up into its parent, so a node other than the
+// root always holds at least two entries and equal maps have equal shapes.
+//
+// A transient owns the nodes it creates, marked with its edit number, and
+// changes them in place; only nodes it does not own yet are copied. Edit
+// numbers are never reused, so once a transient ends nothing can change its
+// nodes again.
+
+#define MAP_BITS 5
+#define MAP_MASK ((1u << MAP_BITS) - 1)
+#define MAP_HASH_BITS 32
+
+typedef struct {
+    size_t count; // entries in this subtree
+    NovaRTTraceFn value_trace;
+    uint64_t edit; // the transient that may change this node in place, or 0
+    uint32_t value_size;
+    uint16_t key_kind;
+    uint16_t collisions; // entries of a node past the last hash level; 0 elsewhere
+    uint32_t datamap;
+    uint32_t nodemap;
+} MapNode; // followed by the entries, each a key word and a value, then the children
+
+typedef struct {
+    uint32_t key_kind;
+    size_t value_size;
+    NovaRTTraceFn value_trace;
+} MapLayout;
+
+typedef struct {
+    const MapNode *root;
+    uint64_t edit; // 0 once the transient has ended
+} MapTransient;
+
+// Every empty map; nothing ever changes it, and the collector ignores it.
+static const MapNode empty_map = {};
+
+static uint64_t next_edit;
+
+static unsigned popcount(uint32_t bits) {
+    return (unsigned)__builtin_popcount(bits);
+}
+
+// The slot of bit's fragment among those set in bitmap.
+static unsigned slot_of(uint32_t bitmap, uint32_t bit) {
+    return popcount(bitmap & (bit - 1));
+}
+
+static uint32_t fragment_bit(uint32_t hash, unsigned shift) {
+    return 1u << ((hash >> shift) & MAP_MASK);
+}
+
+static size_t entry_stride(size_t value_size) {
+    return sizeof(uint64_t) + ((value_size + 7) & ~(size_t)7);
+}
+
+static unsigned data_count(const MapNode *node) {
+    return node->collisions ? node->collisions : popcount(node->datamap);
+}
+
+static unsigned char *entry_at(const MapNode *node, unsigned index) {
+    return (unsigned char *)(node + 1) + index * entry_stride(node->value_size);
+}
+
+static uint64_t entry_key(const unsigned char *entry) {
+    uint64_t key;
+    memcpy(&key, entry, sizeof(key));
+    return key;
+}
+
+static const MapNode **children(const MapNode *node) {
+    return (const MapNode **)entry_at(node, data_count(node));
+}
+
+static uint32_t key_hash(uint32_t key_kind, uint64_t key) {
+    if (key_kind == NOVA_MAP_STRING_KEYS) return nova_string_hash((const void *)(uintptr_t)key, 0);
+    // The murmur3 finaliser, so neighbouring Ints spread over the trie.
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ull;
+    key ^= key >> 33;
+    return (uint32_t)key;
+}
+
+static bool key_equal(uint32_t key_kind, uint64_t a, uint64_t b) {
+    if (a == b) return true;
+    return key_kind == NOVA_MAP_STRING_KEYS && nova_string_equal((const void *)(uintptr_t)a, (const void *)(uintptr_t)b);
+}
+
+static void trace_node(void *gc, void *payload) {
+    const MapNode *node = static_cast<const MapNode *>(payload);
+    // Int keys and plain values hold no references, so only children are marked.
+    unsigned count = node->key_kind == NOVA_MAP_STRING_KEYS || node->value_trace ? data_count(node) : 0;
+    for (unsigned i = 0; i < count; ++i) {
+        unsigned char *entry = entry_at(node, i);
+        if (node->key_kind == NOVA_MAP_STRING_KEYS) nova_rt_mark(gc, (const void *)(uintptr_t)entry_key(entry));
+        if (node->value_trace) node->value_trace(gc, entry + sizeof(uint64_t));
+    }
+    const MapNode **kids = children(node);
+    for (unsigned i = 0; i < popcount(node->nodemap); ++i) {
+        nova_rt_mark(gc, kids[i]);
+    }
+}
+
+static void trace_transient(void *gc, void *payload) {
+    nova_rt_mark(gc, static_cast<const MapTransient *>(payload)->root);
+}
+
+static MapLayout layout_of(const MapNode *node) {
+    MapLayout layout;
+    layout.key_kind = node->key_kind;
+    layout.value_size = node->value_size;
+    layout.value_trace = node->value_trace;
+    return layout;
+}
+
+static MapNode *node_new(const MapLayout *layout, uint64_t edit, uint32_t datamap, uint32_t nodemap, unsigned collisions, size_t count) {
+    unsigned entries = collisions ? collisions : popcount(datamap);
+    size_t size = sizeof(MapNode) + entries * entry_stride(layout->value_size) + popcount(nodemap) * sizeof(MapNode *);
+    MapNode *node = static_cast<MapNode *>(nova_rt_alloc(size, trace_node));
+    node->count = count;
+    node->value_trace = layout->value_trace;
+    node->edit = edit;
+    node->value_size = (uint32_t)layout->value_size;
+    node->key_kind = (uint16_t)layout->key_kind;
+    node->collisions = (uint16_t)collisions;
+    node->datamap = datamap;
+    node->nodemap = nodemap;
+    return node;
+}
+
+static void entry_set(unsigned char *entry, uint64_t key, const void *value, size_t value_size) {
+    memcpy(entry, &key, sizeof(key));
+    memcpy(entry + sizeof(uint64_t), value, value_size);
+}
+
+static bool owned(const MapNode *node, uint64_t edit) {
+    return edit != 0 && node->edit == edit;
+}
+
+// node itself when edit owns it, otherwise a copy that edit owns.
+static MapNode *editable(const MapNode *node, const MapLayout *layout, uint64_t edit) {
+    if (owned(node, edit)) return const_cast<MapNode *>(node);
+    MapNode *copy = node_new(layout, edit, node->datamap, node->nodemap, node->collisions, node->count);
+    size_t body = data_count(node) * entry_stride(node->value_size) + popcount(node->nodemap) * sizeof(MapNode *);
+    memcpy(copy + 1, node + 1, body);
+    return copy;
+}
+
+// A node below shift holding two entries whose hashes agree below it.
+static const MapNode *merge(const MapLayout *layout, uint64_t edit, unsigned shift, uint64_t key1, uint32_t hash1, const void *value1, uint64_t key2, uint32_t hash2, const void *value2) {
+    size_t size = layout->value_size;
+    if (shift >= MAP_HASH_BITS) {
+        MapNode *node = node_new(layout, edit, 0, 0, 2, 2);
+        entry_set(entry_at(node, 0), key1, value1, size);
+        entry_set(entry_at(node, 1), key2, value2, size);
+        return node;
+    }
+    uint32_t bit1 = fragment_bit(hash1, shift);
+    uint32_t bit2 = fragment_bit(hash2, shift);
+    if (bit1 == bit2) {
+        MapNode *node = node_new(layout, edit, 0, bit1, 0, 2);
+        children(node)[0] = merge(layout, edit, shift + MAP_BITS, key1, hash1, value1, key2, hash2, value2);
+        return node;
+    }
+    MapNode *node = node_new(layout, edit, bit1 | bit2, 0, 0, 2);
+    bool first = bit1 < bit2;
+    entry_set(entry_at(node, first ? 0 : 1), key1, value1, size);
+    entry_set(entry_at(node, first ? 1 : 0), key2, value2, size);
+    return node;
+}
+
+// node with an entry for the fragment bit, which it does not have yet.
+static const MapNode *with_entry(const MapNode *node, const MapLayout *layout, uint64_t edit, uint32_t bit, uint64_t key, const void *value) {
+    MapNode *copy = node_new(layout, edit, node->datamap | bit, node->nodemap, 0, node->count + 1);
+    size_t stride = entry_stride(layout->value_size);
+    unsigned index = slot_of(node->datamap, bit);
+    unsigned entries = popcount(node->datamap);
+    memcpy(entry_at(copy, 0), entry_at(node, 0), index * stride);
+    entry_set(entry_at(copy, index), key, value, layout->value_size);
+    memcpy(entry_at(copy, index + 1), entry_at(node, index), (entries - index) * stride);
+    memcpy(children(copy), children(node), popcount(node->nodemap) * sizeof(MapNode *));
+    return copy;
+}
+
+// node with the entry for the fragment bit moved down into child, which
+// holds it along with one more entry.
+static const MapNode *entry_to_child(const MapNode *node, const MapLayout *layout, uint64_t edit, uint32_t bit, const MapNode *child) {
+    MapNode *copy = node_new(layout, edit, node->datamap & ~bit, node->nodemap | bit, 0, node->count + 1);
+    size_t stride = entry_stride(layout->value_size);
+    unsigned index = slot_of(node->datamap, bit);
+    unsigned entries = popcount(node->datamap);
+    memcpy(entry_at(copy, 0), entry_at(node, 0), index * stride);
+    memcpy(entry_at(copy, index), entry_at(node, index + 1), (entries - index - 1) * stride);
+    unsigned slot = slot_of(node->nodemap, bit);
+    unsigned kids = popcount(node->nodemap);
+    memcpy(children(copy), children(node), slot * sizeof(MapNode *));
+    children(copy)[slot] = child;
+    memcpy(children(copy) + slot + 1, children(node) + slot, (kids - slot) * sizeof(MapNode *));
+    return copy;
+}
+
+// node with the child for the fragment bit, down to one entry, pulled up.
+static const MapNode *child_to_entry(const MapNode *node, uint32_t bit, const MapNode *child) {
+    MapLayout layout = layout_of(node);
+    MapNode *copy = node_new(&layout, 0, node->datamap | bit, node->nodemap & ~bit, 0, node->count - 1);
+    size_t stride = entry_stride(layout.value_size);
+    unsigned index = slot_of(node->datamap, bit);
+    unsigned entries = popcount(node->datamap);
+    memcpy(entry_at(copy, 0), entry_at(node, 0), index * stride);
+    memcpy(entry_at(copy, index), entry_at(child, 0), stride);
+    memcpy(entry_at(copy, index + 1), entry_at(node, index), (entries - index) * stride);
+    unsigned slot = slot_of(node->nodemap, bit);
+    unsigned kids = popcount(node->nodemap);
+    memcpy(children(copy), children(node), slot * sizeof(MapNode *));
+    memcpy(children(copy) + slot, children(node) + slot + 1, (kids - slot - 1) * sizeof(MapNode *));
+    return copy;
+}
+
+// node with entry index, one of its count entries, left out.
+static const MapNode *without_entry(const MapNode *node, uint32_t datamap, unsigned collisions, unsigned index) {
+    MapLayout layout = layout_of(node);
+    MapNode *copy = node_new(&layout, 0, datamap, node->nodemap, collisions, node->count - 1);
+    size_t stride = entry_stride(layout.value_size);
+    unsigned entries = data_count(node);
+    memcpy(entry_at(copy, 0), entry_at(node, 0), index * stride);
+    memcpy(entry_at(copy, index), entry_at(node, index + 1), (entries - index - 1) * stride);
+    memcpy(children(copy), children(node), popcount(node->nodemap) * sizeof(MapNode *));
+    return copy;
+}
+
+static const MapNode *insert_collision(const MapNode *node, const MapLayout *layout, uint64_t edit, uint64_t key, const void *value, bool *added) {
+    unsigned count = node->collisions;
+    for (unsigned i = 0; i < count; ++i) {
+        if (key_equal(layout->key_kind, entry_key(entry_at(node, i)), key)) {
+            MapNode *target = editable(node, layout, edit);
+            memcpy(entry_at(target, i) + sizeof(uint64_t), value, layout->value_size);
+            return target;
+        }
+    }
+    MapNode *grown = node_new(layout, edit, 0, 0, count + 1, node->count + 1);
+    memcpy(entry_at(grown, 0), entry_at(node, 0), count * entry_stride(layout->value_size));
+    entry_set(entry_at(grown, count), key, value, layout->value_size);
+    *added = true;
+    return grown;
+}
+
+// node with key set to value. Under a transient the result may be node
+// itself, changed in place; *added is set when key is new.
+static const MapNode *insert(const MapNode *node, const MapLayout *layout, uint64_t edit, unsigned shift, uint32_t hash, uint64_t key, const void *value, bool *added) {
+    if (node->collisions) return insert_collision(node, layout, edit, key, value, added);
+    uint32_t bit = fragment_bit(hash, shift);
+    if (node->datamap & bit) {
+        unsigned index = slot_of(node->datamap, bit);
+        const unsigned char *entry = entry_at(node, index);
+        uint64_t existing = entry_key(entry);
+        if (key_equal(layout->key_kind, existing, key)) {
+            MapNode *target = editable(node, layout, edit);
+            memcpy(entry_at(target, index) + sizeof(uint64_t), value, layout->value_size);
+            return target;
+        }
+        uint32_t existing_hash = key_hash(layout->key_kind, existing);
+        const MapNode *child = merge(layout, edit, shift + MAP_BITS, existing, existing_hash, entry + sizeof(uint64_t), key, hash, value);
+        *added = true;
+        return entry_to_child(node, layout, edit, bit, child);
+    }
+    if (node->nodemap & bit) {
+        unsigned slot = slot_of(node->nodemap, bit);
+        const MapNode *child = children(node)[slot];
+        const MapNode *updated = insert(child, layout, edit, shift + MAP_BITS, hash, key, value, added);
+        if (updated == child && !*added) return node;
+        MapNode *target = editable(node, layout, edit);
+        if (updated != child) {
+            // The old child may be all that still leads a collision under
+            // way to entries that moved into the new one.
+            if (target == node) nova_rt_write_barrier(child);
+            children(target)[slot] = updated;
+        }
+        if (*added) target->count += 1;
+        return target;
+    }
+    *added = true;
+    return with_entry(node, layout, edit, bit, key, value);
+}
+
+// node without key; node itself when key is absent, NULL when nothing is left.
+static const MapNode *remove_key(const MapNode *node, unsigned shift, uint32_t hash, uint64_t key) {
+    if (node->collisions) {
+        for (unsigned i = 0; i < node->collisions; ++i) {
+            if (key_equal(node->key_kind, entry_key(entry_at(node, i)), key)) {
+                return without_entry(node, 0, node->collisions - 1u, i);
+            }
+        }
+        return node;
+    }
+    uint32_t bit = fragment_bit(hash, shift);
+    if (node->datamap & bit) {
+        unsigned index = slot_of(node->datamap, bit);
+        if (!key_equal(node->key_kind, entry_key(entry_at(node, index)), key)) return node;
+        if (node->count == 1) return NULL;
+        return without_entry(node, node->datamap & ~bit, 0, index);
+    }
+    if (!(node->nodemap & bit)) return node;
+    unsigned slot = slot_of(node->nodemap, bit);
+    const MapNode *child = children(node)[slot];
+    const MapNode *updated = remove_key(child, shift + MAP_BITS, hash, key);
+    if (updated == child) return node;
+    if (updated->count == 1) return child_to_entry(node, bit, updated);
+    MapLayout layout = layout_of(node);
+    MapNode *copy = editable(node, &layout, 0);
+    children(copy)[slot] = updated;
+    copy->count -= 1;
+    return copy;
+}
+
+static const unsigned char *find_entry(const MapNode *node, uint64_t key) {
+    if (node->count == 0) return NULL;
+    uint32_t key_kind = node->key_kind;
+    uint32_t hash = key_hash(key_kind, key);
+    for (unsigned shift = 0;; shift += MAP_BITS) {
+        if (node->collisions) {
+            for (unsigned i = 0; i < node->collisions; ++i) {
+                const unsigned char *entry = entry_at(node, i);
+                if (key_equal(key_kind, entry_key(entry), key)) return entry;
+            }
+            return NULL;
+        }
+        uint32_t bit = fragment_bit(hash, shift);
+        if (node->datamap & bit) {
+            const unsigned char *entry = entry_at(node, slot_of(node->datamap, bit));
+            return key_equal(key_kind, entry_key(entry), key) ? entry : NULL;
+        }
+        if (!(node->nodemap & bit)) return NULL;
+        node = children(node)[slot_of(node->nodemap, bit)];
+    }
+}
+
+static MapLayout layout_new(uint32_t key_kind, size_t value_size, NovaRTTraceFn value_trace) {
+    MapLayout layout;
+    layout.key_kind = key_kind;
+    layout.value_size = value_size;
+    layout.value_trace = value_trace;
+    return layout;
+}
+
+extern "C" void *nova_map_new(void) {
+    return const_cast<MapNode *>(&empty_map);
+}
+
+extern "C" int64_t nova_map_length(const void *map) {
+    return (int64_t) static_cast<const MapNode *>(map)->count;
+}
+
+extern "C" const void *nova_map_find(const void *map, uint64_t key) {
+    const unsigned char *entry = find_entry(static_cast<const MapNode *>(map), key);
+    return entry ? entry + sizeof(uint64_t) : NULL;
+}
+
+extern "C" const void *nova_map_at(const void *map, uint64_t key) {
+    const void *value = nova_map_find(map, key);
+    if (!value) abort();
+    return value;
+}
+
+extern "C" void *nova_map_put(const void *map, uint32_t key_kind, size_t value_size, NovaRTTraceFn value_trace, uint64_t key, const void *value) {
+    MapLayout layout = layout_new(key_kind, value_size, value_trace);
+    bool added = false;
+    return const_cast<MapNode *>(insert(static_cast<const MapNode *>(map), &layout, 0, 0, key_hash(key_kind, key), key, value, &added));
+}
+
+extern "C" void *nova_map_remove(const void *map, uint64_t key) {
+    const MapNode *node = static_cast<const MapNode *>(map);
+    if (node->count == 0) return const_cast<MapNode *>(node);
+    const MapNode *removed = remove_key(node, 0, key_hash(node->key_kind, key), key);
+    return const_cast<MapNode *>(removed ? removed : &empty_map);
+}
+
+extern "C" void *nova_map_transient(const void *map) {
+    MapTransient *transient = static_cast<MapTransient *>(nova_rt_alloc(sizeof(MapTransient), trace_transient));
+    transient->root = static_cast<const MapNode *>(map);
+    transient->edit = ++next_edit;
+    return transient;
+}
+
+extern "C" void nova_map_transient_put(void *transient, uint32_t key_kind, size_t value_size, NovaRTTraceFn value_trace, uint64_t key, const void *value) {
+    MapTransient *builder = static_cast<MapTransient *>(transient);
+    if (builder->edit == 0) abort();
+    MapLayout layout = layout_new(key_kind, value_size, value_trace);
+    bool added = false;
+    const MapNode *root = insert(builder->root, &layout, builder->edit, 0, key_hash(key_kind, key), key, value, &added);
+    if (root != builder->root) {
+        nova_rt_write_barrier(builder->root);
+        builder->root = root;
+    }
+}
+
+extern "C" void *nova_map_persistent(void *transient) {
+    MapTransient *builder = static_cast<MapTransient *>(transient);
+    builder->edit = 0;
+    return const_cast<MapNode *>(builder->root);
+}
+
+extern "C" void *nova_map_from_lists(uint32_t key_kind, size_t value_size, NovaRTTraceFn value_trace, const void *keys, const void *values) {
+    int64_t count = nova_list_length(keys);
+    if (nova_list_length(values) != count) abort();
+    void *builder = nova_map_transient(nova_map_new());
+    for (int64_t i = 0; i < count; ++i) {
+        uint64_t key;
+        memcpy(&key, nova_list_at(keys, i), sizeof(key));
+        nova_map_transient_put(builder, key_kind, value_size, value_trace, key, nova_list_at(values, i));
+    }
+    return nova_map_persistent(builder);
+}
@@ -0,0 +1,93 @@
+#include "nova/runtime.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "nova/gc.h"
+
+static NovaGC *runtime_gc;
+static void *runtime_stack_base;
+
+// Reads whole stack frames, redzones included.
+__attribute__((no_sanitize("address"))) static void mark_range(NovaGC *gc, const void *begin, const void *end) {
+    uintptr_t at = ((uintptr_t)begin + sizeof(void *) - 1) & ~(uintptr_t)(sizeof(void *) - 1);
+    for (; at + sizeof(void *) <= (uintptr_t)end; at += sizeof(void *)) {
+        void *word = *(void *const *)at;
+        if (nova_gc_owns(gc, word)) {
+            nova_gc_mark_ptr(gc, word);
+        }
+    }
+}
+
+__attribute__((noinline)) static void scan_frames(NovaGC *gc) {
+    mark_range(gc, __builtin_frame_address(0), runtime_stack_base);
+}
+
+// Generated code keeps no root slots: any word on the stack, or in a
+// callee-saved register, that names a managed object keeps it alive.
+// Objects are then traced precisely. setjmp is no use here since glibc
+// mangles the registers it saves.
+static void scan_stack(NovaGC *gc, void *ctx) {
+    (void)ctx;
+    __builtin_unwind_init(); // spills every callee-saved register into this frame
+    scan_frames(gc);
+    __asm__ volatile("" ::: "memory"); // keeps the call above from becoming a tail call
+}
+
+static NovaGC *runtime_collector(void) {
+    if (!runtime_gc) {
+        // Without a stack base there is nothing to scan, so never collect.
+        NovaGCConfig config{};
+        config.initial_threshold_bytes = SIZE_MAX;
+        runtime_gc = nova_gc_create(&config);
+        if (!runtime_gc) {
+            abort();
+        }
+    }
+    return runtime_gc;
+}
+
+extern "C" void nova_rt_init(void *stack_base) {
+    if (runtime_gc) {
+        return;
+    }
+    NovaGCConfig config{};
+    config.initial_threshold_bytes = 1024 * 1024;
+    runtime_gc = nova_gc_create(&config);
+    if (!runtime_gc) {
+        abort();
+    }
+    runtime_stack_base = stack_base;
+    nova_gc_set_root_scanner(runtime_gc, scan_stack, NULL);
+}
+
+extern "C" void nova_rt_shutdown(void) {
+    nova_gc_destroy(runtime_gc);
+    runtime_gc = NULL;
+    runtime_stack_base = NULL;
+}
+
+extern "C" void *nova_rt_alloc(size_t size, NovaRTTraceFn trace) {
+    void *payload = nova_gc_alloc(runtime_collector(), size > 0 ? size : 1, reinterpret_cast<NovaGCTraceFn>(trace), NULL);
+    if (!payload) {
+        abort();
+    }
+    return payload;
+}
+
+extern "C" void nova_rt_mark(void *gc, const void *payload) {
+    NovaGC *collector = static_cast<NovaGC *>(gc);
+    if (nova_gc_owns(collector, payload)) {
+        nova_gc_mark_ptr(collector, const_cast<void *>(payload));
+    }
+}
+
+extern "C" void nova_rt_trace_ref(void *gc, void *payload) {
+    nova_rt_mark(gc, *static_cast<void *const *>(payload));
+}
+
+extern "C" void nova_rt_write_barrier(const void *payload) {
+    if (runtime_gc && nova_gc_owns(runtime_gc, payload)) {
+        nova_gc_write_barrier(runtime_gc, const_cast<void *>(payload));
+    }
+}
@@ -0,0 +1,335 @@
+#include "nova/runtime.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A String is an inline word, a flat NovaString holding its bytes, or a
+// rope: a node sharing two Strings that concatenation produced. Short
+// strings are inline, so they never allocate, and joining two inline or flat
+// strings into at most STRING_FLAT_MAX bytes copies them flat; anything
+// longer builds a rope. Ropes are kept balanced like AVL trees, the two
+// sides of every node differing in depth by at most one, so every walk
+// stays shallow.
+//
+// Appending a short piece to a long string would copy the rope's right
+// spine each time, so nova_string_concat instead returns a tail node: the
+// long string and a flat buffer of STRING_TAIL_MAX bytes holding what was
+// appended since. A buffer's length counts the bytes some tail has claimed,
+// and appending to the tail that claimed the last of them copies the piece
+// into the buffer in place and allocates only the node; appending to an
+// older version copies the buffer instead. A full buffer joins the rope as
+// a flat leaf. Tails only ever sit at the top of a String, and any other
+// concatenation joins them into the rope first.
+
+#define STRING_FLAT_MAX 128
+#define STRING_TAIL_MAX 992 // a full buffer stays within the collector's size classes
+
+typedef struct {
+    NovaString header;
+    const void *left;
+    const void *right;
+} StringRope;
+
+typedef struct {
+    NovaString header;
+    const void *body;
+    NovaString *buffer; // its first header.length - length(body) bytes follow body
+} StringTail;
+
+static bool is_inline(const void *string) {
+    return (uintptr_t)string & 1;
+}
+
+static size_t string_length(const void *string) {
+    if (is_inline(string)) return ((uintptr_t)string >> 1) & 7;
+    return static_cast<const NovaString *>(string)->length;
+}
+
+static uint32_t string_depth(const void *string) {
+    return is_inline(string) ? 0 : static_cast<const NovaString *>(string)->depth;
+}
+
+static const StringRope *as_rope(const void *string) {
+    if (is_inline(string) || static_cast<const NovaString *>(string)->kind != NOVA_STRING_ROPE) return NULL;
+    return static_cast<const StringRope *>(string);
+}
+
+static const StringTail *as_tail(const void *string) {
+    if (is_inline(string) || static_cast<const NovaString *>(string)->kind != NOVA_STRING_TAIL) return NULL;
+    return static_cast<const StringTail *>(string);
+}
+
+static bool is_leaf(const void *string) {
+    return is_inline(string) || static_cast<const NovaString *>(string)->kind == NOVA_STRING_FLAT;
+}
+
+static char *flat_bytes(const NovaString *flat) {
+    return (char *)(flat + 1);
+}
+
+// The bytes of an inline or flat string; inline ones are unpacked into buffer.
+static const char *leaf_bytes(const void *string, char buffer[8]) {
+    if (!is_inline(string)) return flat_bytes(static_cast<const NovaString *>(string));
+    uintptr_t word = (uintptr_t)string;
+    for (size_t i = 0; i < 8; ++i) buffer[i] = (char)(word >> (8 * (i + 1)));
+    return buffer;
+}
+
+static const void *inline_new(const char *bytes, size_t length) {
+    uintptr_t word = 1 | (uintptr_t)length << 1;
+    for (size_t i = 0; i < length; ++i) word |= (uintptr_t)(unsigned char)bytes[i] << (8 * (i + 1));
+    return (const void *)word;
+}
+
+static void copy_bytes(char *dest, const void *string) {
+    if (const StringRope *rope = as_rope(string)) {
+        copy_bytes(dest, rope->left);
+        copy_bytes(dest + string_length(rope->left), rope->right);
+        return;
+    }
+    if (const StringTail *tail = as_tail(string)) {
+        size_t body_length = string_length(tail->body);
+        copy_bytes(dest, tail->body);
+        memcpy(dest + body_length, flat_bytes(tail->buffer), tail->header.length - body_length);
+        return;
+    }
+    char buffer[8];
+    memcpy(dest, leaf_bytes(string, buffer), string_length(string));
+}
+
+static void trace_rope(void *gc, void *payload) {
+    const StringRope *rope = static_cast<const StringRope *>(payload);
+    nova_rt_mark(gc, rope->left);
+    nova_rt_mark(gc, rope->right);
+}
+
+static void trace_tail(void *gc, void *payload) {
+    const StringTail *tail = static_cast<const StringTail *>(payload);
+    nova_rt_mark(gc, tail->body);
+    nova_rt_mark(gc, tail->buffer);
+}
+
+static NovaString *flat_new(size_t length) {
+    NovaString *flat = static_cast<NovaString *>(nova_rt_alloc(sizeof(NovaString) + length + 1, NULL));
+    flat->length = length;
+    flat->kind = NOVA_STRING_FLAT;
+    return flat;
+}
+
+static const void *rope_new(const void *left, const void *right) {
+    StringRope *rope = static_cast<StringRope *>(nova_rt_alloc(sizeof(StringRope), trace_rope));
+    uint32_t left_depth = string_depth(left);
+    uint32_t right_depth = string_depth(right);
+    rope->header.length = string_length(left) + string_length(right);
+    rope->header.kind = NOVA_STRING_ROPE;
+    rope->header.depth = 1 + (left_depth > right_depth ? left_depth : right_depth);
+    rope->left = left;
+    rope->right = right;
+    return rope;
+}
+
+// The node (left, right) rotated: right's left child moves under left.
+static const void *rotate_left(const void *left, const void *right) {
+    const StringRope *pivot = as_rope(right);
+    return rope_new(rope_new(left, pivot->left), pivot->right);
+}
+
+// The node (left, right) rotated: left's right child moves over to right.
+static const void *rotate_right(const void *left, const void *right) {
+    const StringRope *pivot = as_rope(left);
+    return rope_new(pivot->left, rope_new(pivot->right, right));
+}
+
+static const void *concat(const void *left, const void *right);
+
+// Joins right onto the right spine of left, which is deeper by more than one.
+static const void *join_right(const void *left, const void *right) {
+    const StringRope *rope = as_rope(left);
+    const void *joined;
+    if (string_depth(rope->right) <= string_depth(right) + 1) {
+        joined = concat(rope->right, right);
+        if (string_depth(joined) <= string_depth(rope->left) + 1) return rope_new(rope->left, joined);
+        const StringRope *node = as_rope(joined);
+        return rotate_left(rope->left, rotate_right(node->left, node->right));
+    }
+    joined = join_right(rope->right, right);
+    if (string_depth(joined) <= string_depth(rope->left) + 1) return rope_new(rope->left, joined);
+    return rotate_left(rope->left, joined);
+}
+
+// Joins left onto the left spine of right, which is deeper by more than one.
+static const void *join_left(const void *left, const void *right) {
+    const StringRope *rope = as_rope(right);
+    const void *joined;
+    if (string_depth(rope->left) <= string_depth(left) + 1) {
+        joined = concat(left, rope->left);
+        if (string_depth(joined) <= string_depth(rope->right) + 1) return rope_new(joined, rope->right);
+        const StringRope *node = as_rope(joined);
+        return rotate_right(rotate_left(node->left, node->right), rope->right);
+    }
+    joined = join_left(left, rope->left);
+    if (string_depth(joined) <= string_depth(rope->right) + 1) return rope_new(joined, rope->right);
+    return rotate_right(joined, rope->right);
+}
+
+static const void *concat(const void *left, const void *right) {
+    size_t left_length = string_length(left);
+    size_t right_length = string_length(right);
+    if (left_length == 0) return right;
+    if (right_length == 0) return left;
+    size_t length = left_length + right_length;
+    // Rotations can leave short ropes; merging those could make a subtree
+    // shallower than its balance allows.
+    bool leaves = !as_rope(left) && !as_rope(right);
+    if (leaves && length <= NOVA_STRING_INLINE_MAX) {
+        if (is_inline(left) && is_inline(right)) {
+            // Both are words already; shift right's bytes in after left's.
+            uintptr_t bytes = ((uintptr_t)left >> 8) | ((uintptr_t)right >> 8) << (8 * left_length);
+            return (const void *)(1 | (uintptr_t)length << 1 | bytes << 8);
+        }
+        char bytes[8];
+        copy_bytes(bytes, left);
+        copy_bytes(bytes + left_length, right);
+        return inline_new(bytes, length);
+    }
+    if (leaves && length <= STRING_FLAT_MAX) {
+        NovaString *flat = flat_new(length);
+        copy_bytes(flat_bytes(flat), left);
+        copy_bytes(flat_bytes(flat) + left_length, right);
+        return flat;
+    }
+    uint32_t left_depth = string_depth(left);
+    uint32_t right_depth = string_depth(right);
+    if (left_depth > right_depth + 1) return join_right(left, right);
+    if (right_depth > left_depth + 1) return join_left(left, right);
+    return rope_new(left, right);
+}
+
+static const void *tail_new(const void *body, NovaString *buffer, size_t buffered) {
+    StringTail *tail = static_cast<StringTail *>(nova_rt_alloc(sizeof(StringTail), trace_tail));
+    tail->header.length = string_length(body) + buffered;
+    tail->header.kind = NOVA_STRING_TAIL;
+    tail->header.depth = string_depth(body) + 1;
+    tail->body = body;
+    tail->buffer = buffer;
+    return tail;
+}
+
+// A balanced rope with the bytes of string, which may be a tail.
+static const void *settle(const void *string) {
+    const StringTail *tail = as_tail(string);
+    if (!tail) return string;
+    size_t buffered = tail->header.length - string_length(tail->body);
+    NovaString *buffer = tail->buffer;
+    // A full buffer can no longer change, so it becomes the leaf itself.
+    if (buffered != STRING_TAIL_MAX) {
+        buffer = flat_new(buffered);
+        memcpy(flat_bytes(buffer), flat_bytes(tail->buffer), buffered);
+    }
+    return concat(tail->body, buffer);
+}
+
+// A fresh buffer holding the first count bytes at bytes.
+static NovaString *buffer_new(const char *bytes, size_t count) {
+    NovaString *buffer = flat_new(STRING_TAIL_MAX);
+    memcpy(flat_bytes(buffer), bytes, count);
+    buffer->length = count;
+    return buffer;
+}
+
+// Appends a leaf of at most STRING_FLAT_MAX bytes to a string too long to
+// merge with it. A piece that overflows the buffer fills it, so the buffer
+// joins the rope as it is, and the rest starts the next one.
+static const void *append(const void *left, const void *piece) {
+    char scratch[8];
+    const char *bytes = leaf_bytes(piece, scratch);
+    size_t length = string_length(piece);
+    const StringTail *tail = as_tail(left);
+    if (!tail) return tail_new(left, buffer_new(bytes, length), length);
+    size_t buffered = tail->header.length - string_length(tail->body);
+    NovaString *buffer = tail->buffer;
+    if (buffer->length != buffered) {
+        // Another tail already claimed the bytes after ours.
+        buffer = buffer_new(flat_bytes(buffer), buffered);
+    }
+    size_t taken = STRING_TAIL_MAX - buffered < length ? STRING_TAIL_MAX - buffered : length;
+    memcpy(flat_bytes(buffer) + buffered, bytes, taken);
+    buffer->length = buffered + taken;
+    if (taken == length) return tail_new(tail->body, buffer, buffered + taken);
+    const void *body = concat(tail->body, buffer);
+    return tail_new(body, buffer_new(bytes + taken, length - taken), length - taken);
+}
+
+static uint32_t hash_bytes(const void *string, uint32_t hash) {
+    if (const StringRope *rope = as_rope(string)) {
+        return hash_bytes(rope->right, hash_bytes(rope->left, hash));
+    }
+    if (const StringTail *tail = as_tail(string)) {
+        hash = hash_bytes(tail->body, hash);
+        const char *bytes = flat_bytes(tail->buffer);
+        for (size_t i = 0, n = tail->header.length - string_length(tail->body); i < n; ++i) {
+            hash = (hash ^ (unsigned char)bytes[i]) * 16777619u;
+        }
+        return hash;
+    }
+    char buffer[8];
+    const char *bytes = leaf_bytes(string, buffer);
+    size_t length = string_length(string);
+    for (size_t i = 0; i < length; ++i) {
+        hash = (hash ^ (unsigned char)bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Whether string's bytes equal those at bytes, which has string's length.
+static bool bytes_equal(const void *string, const char *bytes) {
+    if (const StringRope *rope = as_rope(string)) {
+        return bytes_equal(rope->left, bytes) && bytes_equal(rope->right, bytes + string_length(rope->left));
+    }
+    if (const StringTail *tail = as_tail(string)) {
+        size_t body_length = string_length(tail->body);
+        return bytes_equal(tail->body, bytes) &&
+               memcmp(flat_bytes(tail->buffer), bytes + body_length, tail->header.length - body_length) == 0;
+    }
+    char buffer[8];
+    return memcmp(leaf_bytes(string, buffer), bytes, string_length(string)) == 0;
+}
+
+extern "C" int64_t nova_string_length(const void *string) {
+    return (int64_t)string_length(string);
+}
+
+extern "C" const void *nova_string_concat(const void *left, const void *right) {
+    size_t right_length = string_length(right);
+    if (is_leaf(right) && right_length > 0 && right_length <= STRING_FLAT_MAX &&
+        (as_tail(left) || string_length(left) + right_length > STRING_FLAT_MAX)) {
+        return append(left, right);
+    }
+    return concat(settle(left), settle(right));
+}
+
+extern "C" uint32_t nova_string_hash(const void *string, uint32_t seed) {
+    return hash_bytes(string, 2166136261u ^ seed);
+}
+
+extern "C" bool nova_string_equal(const void *left, const void *right) {
+    if (left == right) return true;
+    size_t length = string_length(left);
+    if (length != string_length(right)) return false;
+    if (!is_leaf(right) && is_leaf(left)) {
+        const void *swap = left;
+        left = right;
+        right = swap;
+    }
+    if (is_leaf(right)) {
+        char buffer[8];
+        return bytes_equal(left, leaf_bytes(right, buffer));
+    }
+    char *bytes = static_cast<char *>(malloc(length));
+    if (!bytes) abort();
+    copy_bytes(bytes, right);
+    bool equal = bytes_equal(left, bytes);
+    free(bytes);
+    return equal;
+}
@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+"""Generate the power-of-five tables used by src/numconv.cpp."""
+from __future__ import annotations
+import pathlib
+
+# Decimal exponents the parser can meet before the result under- or overflows.
+PARSE_MIN_EXPONENT = -342
+PARSE_MAX_EXPONENT = 308
+# Entries and precision of the shortest-printing tables.
+PRINT_POW5_COUNT = 326
+PRINT_POW5_INV_COUNT = 342
+PRINT_BITS = 125
+
+def parse_entry(q: int) -> int:
+    """5^q scaled into [2^127, 2^128), truncated; reciprocals are rounded up."""
+    if q >= 0:
+        power = 5 ** q
+        while power < (1 << 127):
+            power *= 2
+        while power >= (1 << 128):
+            power //= 2
+        return power
+    power = 5 ** -q
+    bits = power.bit_length()
+    if q >= -27:
+        return (1 << (bits + 127)) // power + 1
+    entry = (1 << (2 * bits + 128)) // power + 1
+    while entry >= (1 << 128):
+        entry //= 2
+    return entry
+
+def print_entry(i: int) -> int:
+    power = 5 ** i
+    shift = power.bit_length() - PRINT_BITS
+    return power >> shift if shift >= 0 else power << -shift
+
+def print_inverse_entry(i: int) -> int:
+    power = 5 ** i
+    return (1 << (power.bit_length() - 1 + PRINT_BITS)) // power + 1
+
+def write_table(f, name: str, values) -> None:
+    f.write(f"static const uint64_t {name}[][2] = {{\n")
+    for value in values:
+        f.write(f"    {{0x{value >> 64:016x}u, 0x{value & (2 ** 64 - 1):016x}u}},\n")
+    f.write("};\n\n")
+
+def write_header(output: pathlib.Path) -> None:
+    with output.open("w", encoding="utf8") as f:
+        f.write("// Auto-generated by scripts/generate_numconv_tables.py. Do not edit manually.\n")
+        f.write("#pragma once\n\n#include <stdint.h>\n\n")
+        f.write(f"#define NOVA_NUMCONV_PARSE_MIN_EXPONENT ({PARSE_MIN_EXPONENT})\n")
+        f.write(f"#define NOVA_NUMCONV_PARSE_MAX_EXPONENT {PARSE_MAX_EXPONENT}\n")
+        f.write(f"#define NOVA_NUMCONV_PRINT_BITS {PRINT_BITS}\n\n")
+        f.write("// {high, low} halves of 5^q normalised to 128 bits, q from the minimum exponent.\n")
+        write_table(f, "nova_numconv_parse_pow5", (parse_entry(q) for q in range(PARSE_MIN_EXPONENT, PARSE_MAX_EXPONENT + 1)))
+        f.write("// {high, low} halves of 5^i normalised to NOVA_NUMCONV_PRINT_BITS bits.\n")
+        write_table(f, "nova_numconv_print_pow5", (print_entry(i) for i in range(PRINT_POW5_COUNT)))
+        f.write("// {high, low} halves of 2^k / 5^i rounded up, NOVA_NUMCONV_PRINT_BITS bits wide.\n")
+        write_table(f, "nova_numconv_print_pow5_inv", (print_inverse_entry(i) for i in range(PRINT_POW5_INV_COUNT)))
+
+def main():
+    repo_root = pathlib.Path(__file__).resolve().parents[1]
+    write_header(repo_root / "include" / "nova" / "generated_numconv_tables.h")
+
+if __name__ == "__main__":
+    main()
@@ -12,6 +12,38 @@ static void *nova_grow(void *ptr, size_t *capacity, size_t element_size) {
     return new_ptr;
 }
 
+const char *nova_operator_lexeme(NovaOperator op) {
+    switch (op) {
+    case NOVA_OP_ADD: return "+";
+    case NOVA_OP_SUB: return "-";
+    case NOVA_OP_MUL: return "*";
+    case NOVA_OP_DIV: return "/";
+    case NOVA_OP_MOD: return "%";
+    case NOVA_OP_LT: return "<";
+    case NOVA_OP_LE: return "<=";
+    case NOVA_OP_GT: return ">";
+    case NOVA_OP_GE: return ">=";
+    case NOVA_OP_EQ: return "==";
+    case NOVA_OP_NE: return "!=";
+    case NOVA_OP_AND: return "and";
+    case NOVA_OP_OR: return "or";
+    case NOVA_OP_NEG: return "-";
+    case NOVA_OP_NOT: return "not";
+    case NOVA_OP_TO_INT: return "Int";
+    case NOVA_OP_TO_NUMBER: return "Number";
+    case NOVA_OP_LIST_LENGTH: return "length";
+    case NOVA_OP_LIST_GET: return "get";
+    case NOVA_OP_LIST_PUSH: return "push";
+    case NOVA_OP_MAP_NEW: return "Map";
+    case NOVA_OP_MAP_LENGTH: return "length";
+    case NOVA_OP_MAP_GET: return "get";
+    case NOVA_OP_MAP_HAS: return "has";
+    case NOVA_OP_MAP_PUT: return "put";
+    case NOVA_OP_MAP_REMOVE: return "remove";
+    }
+    return "?";
+}
+
 void nova_param_list_init(NovaParamList *list) {
     list->items = NULL;
     list->count = 0;
@@ -84,6 +116,52 @@ void nova_expr_list_free(NovaExprList *list) {
     list->capacity = 0;
 }
 
+NovaPattern *nova_pattern_new(NovaPatternKind kind, NovaToken token) {
+    NovaPattern *pattern = static_cast<NovaPattern *>(calloc(1, sizeof(NovaPattern)));
+    if (!pattern) {
+        return NULL;
+    }
+    pattern->kind = kind;
+    pattern->token = token;
+    nova_pattern_list_init(&pattern->args);
+    return pattern;
+}
+
+void nova_pattern_free(NovaPattern *pattern) {
+    if (!pattern) {
+        return;
+    }
+    for (size_t i = 0; i < pattern->args.count; ++i) {
+        nova_pattern_free(pattern->args.items[i]);
+    }
+    nova_pattern_list_free(&pattern->args);
+    free(pattern);
+}
+
+void nova_pattern_list_init(NovaPatternList *list) {
+    list->items = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+void nova_pattern_list_push(NovaPatternList *list, NovaPattern *pattern) {
+    if (list->count == list->capacity) {
+        NovaPattern **items = static_cast<NovaPattern **>(nova_grow(list->items, &list->capacity, sizeof(NovaPattern *)));
+        if (!items) {
+            return;
+        }
+        list->items = items;
+    }
+    list->items[list->count++] = pattern;
+}
+
+void nova_pattern_list_free(NovaPatternList *list) {
+    free(list->items);
+    list->items = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
 void nova_match_arm_list_init(NovaMatchArmList *list) {
     list->items = NULL;
     list->count = 0;
@@ -103,7 +181,7 @@ void nova_match_arm_list_push(NovaMatchArmList *list, NovaMatchArm arm) {
 
 void nova_match_arm_list_free(NovaMatchArmList *list) {
     for (size_t i = 0; i < list->count; ++i) {
-        nova_param_list_free(&list->items[i].bindings);
+        nova_pattern_free(list->items[i].pattern);
     }
     free(list->items);
     list->items = NULL;
@@ -191,6 +269,7 @@ static void nova_expr_free(NovaExpr *expr) {
         nova_expr_free(expr->as.match_expr.scrutinee);
         for (size_t i = 0; i < expr->as.match_expr.arms.count; ++i) {
             NovaMatchArm *arm = &expr->as.match_expr.arms.items[i];
+            nova_expr_free(arm->guard);
             nova_expr_free(arm->body);
         }
         nova_match_arm_list_free(&expr->as.match_expr.arms);
@@ -231,6 +310,10 @@ static void nova_expr_free(NovaExpr *expr) {
     case NOVA_EXPR_PAREN:
         nova_expr_free(expr->as.inner);
         break;
+    case NOVA_EXPR_OPERATOR:
+        nova_expr_free(expr->as.op.left);
+        nova_expr_free(expr->as.op.right);
+        break;
     case NOVA_EXPR_IDENTIFIER:
         break;
     }
@@ -1,44 +1,72 @@
 #include "nova/codegen.h"
 
+#include "nova/layout.h"
+#include "nova/match.h"
+#include "nova/native.h"
+#include "nova/numconv.h"
+#include "nova/profile.h"
+#include "nova/runtime.h"
+
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
 #include <limits.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
 
-#ifndef PATH_MAX
-#define PATH_MAX 4096
-#endif
-
-static void derive_c_path(const char *object_path, char *buffer, size_t size) {
-    size_t len = strlen(object_path);
-    if (len > 2 && strcmp(object_path + len - 2, ".o") == 0) {
-        size_t base_len = len - 2;
-        if (base_len + 3 >= size) base_len = size - 4;
-        memcpy(buffer, object_path, base_len);
-        buffer[base_len] = '\0';
-        strncat(buffer, ".c", size - base_len - 1);
-    } else {
-        snprintf(buffer, size, "%s.c", object_path);
-    }
+static void emit_token(FILE *out, NovaToken token) {
+    fwrite(token.lexeme, 1, token.length, out);
 }
 
-static void derive_wrapper_path(const char *output_path, char *buffer, size_t size) {
-    snprintf(buffer, size, "%s.wrapper.c", output_path);
+static void emit_indent(FILE *out, int indent) {
+    for (int i = 0; i < indent; ++i) {
+        fputs("    ", out);
+    }
 }
 
-static void derive_ir_path(const char *output_path, char *buffer, size_t size) {
-    snprintf(buffer, size, "%s.ll", output_path);
+// Number constants are printed as the shortest decimal that reads back to
+// the same bits, and always as doubles, so `1 / 2` divides in floating point;
+// folding can produce non-finite values, which neither C nor LLVM spells as a
+// plain literal. buffer holds at least NOVA_NUMBER_BUFFER_SIZE bytes.
+static void format_number_c(double value, char *buffer, size_t size) {
+    if (isnan(value)) {
+        snprintf(buffer, size, "NAN");
+    } else if (isinf(value)) {
+        snprintf(buffer, size, value > 0 ? "HUGE_VAL" : "(-HUGE_VAL)");
+    } else {
+        nova_number_format(value, buffer);
+    }
 }
 
-static void emit_token(FILE *out, NovaToken token) {
-    fwrite(token.lexeme, 1, token.length, out);
+// INT64_MIN has no literal spelling in C: 9223372036854775808 is out of range.
+static void emit_int_literal_c(FILE *out, int64_t value) {
+    if (value == INT64_MIN) {
+        fputs("INT64_MIN", out);
+    } else {
+        fprintf(out, value < 0 ? "(%lld)" : "%lld", (long long)value);
+    }
 }
 
-static void emit_indent(FILE *out, int indent) {
-    for (int i = 0; i < indent; ++i) {
-        fputs("    ", out);
+static void format_number_llvm(double value, char *buffer, size_t size) {
+    if (isfinite(value)) {
+        nova_number_format(value, buffer);
+        return;
     }
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    snprintf(buffer, size, "0x%016llX", (unsigned long long)bits);
 }
 
 static const char *type_to_c(const NovaSemanticContext *semantics, NovaTypeId type) {
@@ -47,15 +75,22 @@ static const char *type_to_c(const NovaSemanticContext *semantics, NovaTypeId ty
     switch (info->kind) {
     case NOVA_TYPE_KIND_NUMBER:
         return "double";
+    case NOVA_TYPE_KIND_INT:
+        return "int64_t";
     case NOVA_TYPE_KIND_BOOL:
         return "bool";
     case NOVA_TYPE_KIND_STRING:
-        return "const char *";
+        return "const void *";
     case NOVA_TYPE_KIND_UNIT:
         return "void";
+    case NOVA_TYPE_KIND_CUSTOM: {
+        const NovaTypeLayout *layout = nova_layout_of(semantics, type);
+        return layout ? layout->c_type : "double";
+    }
     case NOVA_TYPE_KIND_FUNCTION:
     case NOVA_TYPE_KIND_LIST:
-    case NOVA_TYPE_KIND_CUSTOM:
+    case NOVA_TYPE_KIND_MAP:
+        return "const void *";
     case NOVA_TYPE_KIND_UNKNOWN:
     default:
         return "double";
@@ -68,26 +103,255 @@ static const char *type_to_llvm(const NovaSemanticContext *semantics, NovaTypeId
     switch (info->kind) {
     case NOVA_TYPE_KIND_NUMBER:
         return "double";
+    case NOVA_TYPE_KIND_INT:
+        return "i64";
     case NOVA_TYPE_KIND_BOOL:
         return "i1";
     case NOVA_TYPE_KIND_STRING:
         return "ptr";
     case NOVA_TYPE_KIND_UNIT:
         return "void";
+    case NOVA_TYPE_KIND_CUSTOM: {
+        const NovaTypeLayout *layout = nova_layout_of(semantics, type);
+        return layout ? layout->llvm_type : "double";
+    }
     case NOVA_TYPE_KIND_FUNCTION:
     case NOVA_TYPE_KIND_LIST:
-    case NOVA_TYPE_KIND_CUSTOM:
+    case NOVA_TYPE_KIND_MAP:
+        return "ptr";
     case NOVA_TYPE_KIND_UNKNOWN:
     default:
         return "double";
     }
 }
 
+// Function values point at an environment whose first word is the entry
+// thunk; the thunk unpacks the captures and calls the lifted function.
+typedef struct {
+    const NovaIRProgram *program;
+    bool *marks; // per function: some closure refers to it
+} ClosureMarker;
+
+static void mark_closure_functions(NovaIRExpr **slot, void *ctx) {
+    ClosureMarker *marker = static_cast<ClosureMarker *>(ctx);
+    if (!*slot) return;
+    if ((*slot)->kind == NOVA_IR_EXPR_CLOSURE) {
+        size_t index = nova_ir_find_function(marker->program, &(*slot)->as.closure.function);
+        if (index != SIZE_MAX) marker->marks[index] = true;
+    }
+    nova_ir_expr_for_each_child(*slot, mark_closure_functions, ctx);
+}
+
+static bool *closure_functions(const NovaIRProgram *program) {
+    ClosureMarker marker = {program, static_cast<bool *>(calloc(program->function_count ? program->function_count : 1, sizeof(bool)))};
+    if (!marker.marks) return NULL;
+    for (size_t i = 0; i < program->function_count; ++i) {
+        NovaIRExpr *body = program->functions[i].body;
+        mark_closure_functions(&body, &marker);
+    }
+    return marker.marks;
+}
+
+// What effect analysis and the call graph let the backends promise about a
+// function. Functions without NOVA_EFFECT_IMPURE are pure. A pure function
+// whose parameters, result and intermediate values are all scalars, and which
+// calls only such functions, reads no memory at all; if it also has no loop,
+// match, Int division or recursion it cannot trap or hang, so it always
+// returns. Internal functions no other translation unit refers to get
+// internal linkage. A function with a loop and Number arithmetic is loop
+// heavy, unless a profile saw it never run.
+typedef struct {
+    bool local;
+    bool pure;
+    bool readnone;
+    bool willreturn;
+    bool loop_heavy;
+} FunctionTraits;
+
+typedef struct {
+    const NovaSemanticContext *semantics;
+    bool scalar;
+    bool returns;
+    bool loop;
+    bool arithmetic; // on Number
+} TraitScanner;
+
+static bool type_is_scalar(const NovaSemanticContext *semantics, NovaTypeId type) {
+    const NovaTypeInfo *info = nova_semantic_type_info(semantics, type);
+    return info && (info->kind == NOVA_TYPE_KIND_NUMBER || info->kind == NOVA_TYPE_KIND_INT || info->kind == NOVA_TYPE_KIND_BOOL ||
+                    info->kind == NOVA_TYPE_KIND_UNIT);
+}
+
+static void scan_traits(NovaIRExpr **slot, void *ctx) {
+    TraitScanner *scanner = static_cast<TraitScanner *>(ctx);
+    const NovaIRExpr *expr = *slot;
+    if (!expr) return;
+    if (!type_is_scalar(scanner->semantics, expr->type)) scanner->scalar = false;
+    if (expr->kind == NOVA_IR_EXPR_WHILE || expr->kind == NOVA_IR_EXPR_MATCH) scanner->returns = false;
+    if (expr->kind == NOVA_IR_EXPR_WHILE) scanner->loop = true;
+    // NOVA_OP_ADD through NOVA_OP_MOD are the arithmetic operators.
+    if (expr->kind == NOVA_IR_EXPR_OPERATOR && expr->as.op.op <= NOVA_OP_MOD) {
+        const NovaTypeInfo *info = nova_semantic_type_info(scanner->semantics, expr->type);
+        if (info && info->kind == NOVA_TYPE_KIND_INT && (expr->as.op.op == NOVA_OP_DIV || expr->as.op.op == NOVA_OP_MOD)) scanner->returns = false;
+        if (info && info->kind == NOVA_TYPE_KIND_NUMBER) scanner->arithmetic = true;
+    }
+    nova_ir_expr_for_each_child(*slot, scan_traits, ctx);
+}
+
+// unit_of is NULL when the whole program is one translation unit.
+static FunctionTraits *function_traits(const NovaIRProgram *program, const NovaSemanticContext *semantics, const NovaIRCallGraph *graph, const size_t *unit_of) {
+    size_t n = program->function_count;
+    FunctionTraits *traits = static_cast<FunctionTraits *>(calloc(n ? n : 1, sizeof(FunctionTraits)));
+    if (!traits) return NULL;
+    for (size_t i = 0; i < n; ++i) {
+        const NovaIRFunction *fn = &program->functions[i];
+        TraitScanner scanner = {semantics, type_is_scalar(semantics, fn->return_type), true, false, false};
+        for (size_t p = 0; p < fn->param_count; ++p) {
+            if (!type_is_scalar(semantics, fn->params[p].type)) scanner.scalar = false;
+        }
+        NovaIRExpr *body = fn->body;
+        scan_traits(&body, &scanner);
+        traits[i].local = fn->internal;
+        traits[i].pure = (fn->effects & NOVA_EFFECT_IMPURE) == 0;
+        traits[i].readnone = traits[i].pure && scanner.scalar;
+        traits[i].willreturn = scanner.returns && !graph->nodes[i].recursive;
+        traits[i].loop_heavy = scanner.loop && scanner.arithmetic && (!program->profiled || fn->profile_calls > 0);
+    }
+    // Calling a function that reads memory reads memory; cycles need a fixpoint.
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t i = 0; i < n; ++i) {
+            if (!traits[i].readnone) continue;
+            for (size_t c = 0; c < graph->nodes[i].callee_count; ++c) {
+                if (traits[graph->nodes[i].callees[c]].readnone) continue;
+                traits[i].readnone = false;
+                changed = true;
+                break;
+            }
+        }
+    }
+    for (size_t k = 0; k < n; ++k) {
+        size_t i = graph->bottom_up[k];
+        traits[i].willreturn = traits[i].willreturn && traits[i].readnone;
+        for (size_t c = 0; c < graph->nodes[i].callee_count; ++c) {
+            if (!traits[graph->nodes[i].callees[c]].willreturn) traits[i].willreturn = false;
+        }
+    }
+    if (unit_of) {
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t c = 0; c < graph->nodes[i].callee_count; ++c) {
+                size_t callee = graph->nodes[i].callees[c];
+                if (unit_of[callee] != unit_of[i]) traits[callee].local = false;
+            }
+        }
+    }
+    return traits;
+}
+
+// Closure environments, lists, maps and boxes live on the managed heap. A
+// value holds references into it when it is a function value, a list, a
+// map or a sum value with a boxed field, directly or in a field it embeds;
+// each such sum type gets a generated trace function. Embedded fields never
+// form a cycle, boxes do.
+static bool variant_is_traced(const NovaSemanticContext *semantics, const NovaVariantLayout *variant);
+
+static bool type_is_traced(const NovaSemanticContext *semantics, NovaTypeId type) {
+    const NovaTypeInfo *info = nova_semantic_type_info(semantics, type);
+    if (info && (info->kind == NOVA_TYPE_KIND_FUNCTION || info->kind == NOVA_TYPE_KIND_LIST || info->kind == NOVA_TYPE_KIND_MAP ||
+                 info->kind == NOVA_TYPE_KIND_STRING)) return true;
+    const NovaTypeLayout *layout = nova_layout_of(semantics, type);
+    if (!layout) return false;
+    for (size_t v = 0; v < layout->variant_count; ++v) {
+        if (variant_is_traced(semantics, &layout->variants[v])) return true;
+    }
+    return false;
+}
+
+static bool variant_is_traced(const NovaSemanticContext *semantics, const NovaVariantLayout *variant) {
+    for (size_t f = 0; f < variant->field_count; ++f) {
+        if (variant->fields[f].boxed || type_is_traced(semantics, variant->fields[f].type)) return true;
+    }
+    return false;
+}
+
+static bool is_list_operator(NovaOperator op) {
+    return op == NOVA_OP_LIST_LENGTH || op == NOVA_OP_LIST_GET || op == NOVA_OP_LIST_PUSH;
+}
+
+static NovaTypeId list_element_type(const NovaSemanticContext *semantics, NovaTypeId list) {
+    const NovaTypeInfo *info = nova_semantic_type_info(semantics, list);
+    return info && info->kind == NOVA_TYPE_KIND_LIST ? info->as.list.element : semantics->type_unknown;
+}
+
+static bool is_map_operator(NovaOperator op) {
+    return op == NOVA_OP_MAP_NEW || op == NOVA_OP_MAP_LENGTH || op == NOVA_OP_MAP_GET || op == NOVA_OP_MAP_HAS ||
+           op == NOVA_OP_MAP_PUT || op == NOVA_OP_MAP_REMOVE;
+}
+
+static NovaTypeId map_key_type(const NovaSemanticContext *semantics, NovaTypeId map) {
+    const NovaTypeInfo *info = nova_semantic_type_info(semantics, map);
+    return info && info->kind == NOVA_TYPE_KIND_MAP ? info->as.map.key : semantics->type_unknown;
+}
+
+static NovaTypeId map_value_type(const NovaSemanticContext *semantics, NovaTypeId map) {
+    const NovaTypeInfo *info = nova_semantic_type_info(semantics, map);
+    return info && info->kind == NOVA_TYPE_KIND_MAP ? info->as.map.value : semantics->type_unknown;
+}
+
+// The runtime hashes and compares String keys by content, Int keys as words.
+static bool map_has_string_keys(const NovaSemanticContext *semantics, NovaTypeId map) {
+    const NovaTypeInfo *info = nova_semantic_type_info(semantics, map_key_type(semantics, map));
+    return info && info->kind == NOVA_TYPE_KIND_STRING;
+}
+
+// Concatenation, and length applied to a String rather than a list.
+static bool is_string_operator(const NovaSemanticContext *semantics, const NovaIRExpr *expr) {
+    if (expr->as.op.op != NOVA_OP_ADD && expr->as.op.op != NOVA_OP_LIST_LENGTH) return false;
+    const NovaTypeInfo *info = expr->as.op.left ? nova_semantic_type_info(semantics, expr->as.op.left->type) : NULL;
+    return info && info->kind == NOVA_TYPE_KIND_STRING;
+}
+
+static char *decode_string_literal(const NovaIRExpr *literal, size_t *length) {
+    const char *text = literal->as.string_value.text;
+    return nova_match_decode_string(text ? text : "\"\"", text ? strlen(text) : 2, length);
+}
+
+// A literal of up to NOVA_STRING_INLINE_MAX bytes is an inline String word
+// (see nova/runtime.h); a longer one is entry string_value.index of the
+// module's string table.
+static uint64_t string_inline_word(const char *bytes, size_t length) {
+    uint64_t word = 1 | (uint64_t)length << 1;
+    for (size_t i = 0; i < length; ++i) word |= (uint64_t)(unsigned char)bytes[i] << (8 * (i + 1));
+    return word;
+}
+
+typedef struct {
+    NovaToken name;
+    char value[64];
+    char type[64];
+    bool is_slot; // value names an alloca that holds the current value
+} LLVMBinding;
+
 typedef struct {
     FILE *out;
     const NovaSemanticContext *semantics;
+    const NovaIRProgram *program;
+    const NovaIRFunction *function; // function being emitted
+    const FunctionTraits *traits; // per program function
     size_t temp_counter;
     size_t label_counter;
+    char block[48]; // label of the block instructions are currently emitted into
+    LLVMBinding *bindings; // let-bound names visible at the current emission point
+    size_t binding_count;
+    size_t binding_capacity;
+    char *globals; // module-level constants requested while emitting functions
+    size_t globals_length;
+    size_t globals_capacity;
+    size_t global_counter;
+    size_t *string_fields; // field of each program string in @nova.strings; SIZE_MAX for inline ones
+    bool uses_string_hash;
+    bool uses_int_helpers;
+    bool ok;
 } LLVMEmitter;
 
 static const char *llvm_expr_type(const NovaSemanticContext *semantics, const NovaIRExpr *expr) {
@@ -110,12 +374,139 @@ static void llvm_emitf(LLVMEmitter *emitter, const char *fmt, ...) {
     va_end(args);
 }
 
+static void llvm_globalf(LLVMEmitter *emitter, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    va_list copy;
+    va_copy(copy, args);
+    int needed = vsnprintf(NULL, 0, fmt, copy);
+    va_end(copy);
+    if (needed < 0) {
+        emitter->ok = false;
+        va_end(args);
+        return;
+    }
+    size_t required = emitter->globals_length + (size_t)needed + 1;
+    if (required > emitter->globals_capacity) {
+        size_t new_capacity = emitter->globals_capacity == 0 ? 256 : emitter->globals_capacity;
+        while (new_capacity < required) new_capacity *= 2;
+        char *globals = static_cast<char *>(realloc(emitter->globals, new_capacity));
+        if (!globals) {
+            emitter->ok = false;
+            va_end(args);
+            return;
+        }
+        emitter->globals = globals;
+        emitter->globals_capacity = new_capacity;
+    }
+    vsnprintf(emitter->globals + emitter->globals_length, (size_t)needed + 1, fmt, args);
+    emitter->globals_length += (size_t)needed;
+    va_end(args);
+}
+
+static void llvm_begin_block(LLVMEmitter *emitter, const char *label) {
+    llvm_emitf(emitter, "%s:\n", label);
+    snprintf(emitter->block, sizeof(emitter->block), "%s", label);
+}
+
 static bool emit_expr_llvm(LLVMEmitter *emitter, const NovaIRExpr *expr, char *value_buffer, size_t value_buffer_size);
+static bool emit_statement_llvm(LLVMEmitter *emitter, const NovaIRExpr *expr);
+
+static bool llvm_push_binding(LLVMEmitter *emitter, NovaToken name, const char *value, const char *type, bool is_slot) {
+    if (emitter->binding_count == emitter->binding_capacity) {
+        size_t new_capacity = emitter->binding_capacity == 0 ? 8 : emitter->binding_capacity * 2;
+        LLVMBinding *bindings = static_cast<LLVMBinding *>(realloc(emitter->bindings, new_capacity * sizeof(LLVMBinding)));
+        if (!bindings) return false;
+        emitter->bindings = bindings;
+        emitter->binding_capacity = new_capacity;
+    }
+    LLVMBinding *binding = &emitter->bindings[emitter->binding_count++];
+    binding->name = name;
+    snprintf(binding->value, sizeof(binding->value), "%s", value);
+    snprintf(binding->type, sizeof(binding->type), "%s", type);
+    binding->is_slot = is_slot;
+    return true;
+}
+
+static const LLVMBinding *llvm_find_binding(const LLVMEmitter *emitter, const NovaToken *name) {
+    for (size_t i = emitter->binding_count; i > 0; --i) {
+        const LLVMBinding *binding = &emitter->bindings[i - 1];
+        if (binding->name.length == name->length && strncmp(binding->name.lexeme, name->lexeme, name->length) == 0) {
+            return binding;
+        }
+    }
+    return NULL;
+}
+
+static bool llvm_is_param(const NovaIRFunction *fn, const NovaToken *name, size_t *index) {
+    for (size_t p = 0; p < fn->param_count; ++p) {
+        if (fn->params[p].name.length == name->length && strncmp(fn->params[p].name.lexeme, name->lexeme, name->length) == 0) {
+            *index = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Mutable names live in entry-block allocas so the optimizer can promote
+// them back to registers; everything else stays in SSA form.
+static void llvm_declare_slots(NovaIRExpr **slot, void *ctx) {
+    LLVMEmitter *emitter = static_cast<LLVMEmitter *>(ctx);
+    const NovaIRExpr *expr = *slot;
+    if (!expr || !emitter->ok) return;
+    if (expr->kind == NOVA_IR_EXPR_LET && expr->as.let_expr.is_mutable) {
+        const NovaToken *name = &expr->as.let_expr.name;
+        const char *type = llvm_expr_type(emitter->semantics, expr->as.let_expr.value);
+        llvm_emitf(emitter, "  %%%.*s.slot = alloca %s\n", (int)name->length, name->lexeme, type);
+    } else if (expr->kind == NOVA_IR_EXPR_ASSIGN) {
+        const NovaToken *name = &expr->as.assign.target;
+        size_t index = 0;
+        if (!llvm_find_binding(emitter, name) && llvm_is_param(emitter->function, name, &index)) {
+            const char *type = type_to_llvm(emitter->semantics, emitter->function->params[index].type);
+            char slot_name[64];
+            snprintf(slot_name, sizeof(slot_name), "%%%.*s.slot", (int)name->length, name->lexeme);
+            llvm_emitf(emitter, "  %s = alloca %s\n", slot_name, type);
+            llvm_emitf(emitter, "  store %s %%%.*s, ptr %s\n", type, (int)name->length, name->lexeme, slot_name);
+            if (!llvm_push_binding(emitter, *name, slot_name, type, true)) emitter->ok = false;
+        }
+    }
+    nova_ir_expr_for_each_child(*slot, llvm_declare_slots, ctx);
+}
+
+// Let values are already SSA values, so binding an immutable name is pure
+// bookkeeping; mutable names store into the slot declared at function entry.
+static bool llvm_bind_let(LLVMEmitter *emitter, const NovaIRExpr *expr) {
+    char bound[64];
+    const NovaIRExpr *value = expr->as.let_expr.value;
+    const char *type = llvm_expr_type(emitter->semantics, value);
+    if (value && strcmp(type, "void") == 0) {
+        if (!emit_statement_llvm(emitter, value)) return false;
+        snprintf(bound, sizeof(bound), "0");
+    } else if (!emit_expr_llvm(emitter, value, bound, sizeof(bound))) {
+        return false;
+    }
+    if (expr->as.let_expr.is_mutable) {
+        char slot_name[64];
+        snprintf(slot_name, sizeof(slot_name), "%%%.*s.slot", (int)expr->as.let_expr.name.length, expr->as.let_expr.name.lexeme);
+        llvm_emitf(emitter, "  store %s %s, ptr %s\n", type, bound, slot_name);
+        return llvm_push_binding(emitter, expr->as.let_expr.name, slot_name, type, true);
+    }
+    return llvm_push_binding(emitter, expr->as.let_expr.name, bound, type, false);
+}
+
+static bool emit_let_llvm(LLVMEmitter *emitter, const NovaIRExpr *expr, char *value_buffer, size_t value_buffer_size) {
+    if (!llvm_bind_let(emitter, expr)) return false;
+    bool ok = value_buffer ? emit_expr_llvm(emitter, expr->as.let_expr.body, value_buffer, value_buffer_size)
+                           : emit_statement_llvm(emitter, expr->as.let_expr.body);
+    emitter->binding_count--;
+    return ok;
+}
 
 static const char *llvm_zero_literal(const char *type_name) {
     if (strcmp(type_name, "double") == 0) return "0.0";
     if (strcmp(type_name, "i1") == 0) return "0";
     if (strcmp(type_name, "ptr") == 0) return "null";
+    if (type_name[0] == '%') return "zeroinitializer";
     return "0";
 }
 
@@ -133,190 +524,2274 @@ static bool emit_statement_llvm(LLVMEmitter *emitter, const NovaIRExpr *expr) {
         llvm_new_label(emitter, body_label, sizeof(body_label), "while.body.");
         llvm_new_label(emitter, end_label, sizeof(end_label), "while.end.");
         llvm_emitf(emitter, "  br label %%%s\n", cond_label);
-        llvm_emitf(emitter, "%s:\n", cond_label);
+        llvm_begin_block(emitter, cond_label);
         if (!emit_expr_llvm(emitter, expr->as.while_expr.condition, cond_value, sizeof(cond_value))) return false;
         llvm_emitf(emitter, "  br i1 %s, label %%%s, label %%%s\n", cond_value, body_label, end_label);
-        llvm_emitf(emitter, "%s:\n", body_label);
+        llvm_begin_block(emitter, body_label);
         if (!emit_statement_llvm(emitter, expr->as.while_expr.body)) return false;
         llvm_emitf(emitter, "  br label %%%s\n", cond_label);
-        llvm_emitf(emitter, "%s:\n", end_label);
+        llvm_begin_block(emitter, end_label);
         return true;
     }
+    if (expr->kind == NOVA_IR_EXPR_LET) {
+        return emit_let_llvm(emitter, expr, NULL, 0);
+    }
     char ignored[32];
     return emit_expr_llvm(emitter, expr, ignored, sizeof(ignored));
 }
 
-static bool emit_expr_llvm(LLVMEmitter *emitter, const NovaIRExpr *expr, char *value_buffer, size_t value_buffer_size) {
-    if (!expr) {
-        snprintf(value_buffer, value_buffer_size, "0.0");
-        return true;
+// String literal arms dispatch through a perfect hash of their keys, so a
+// match costs one hash of the subject and a single comparison.
+typedef struct {
+    char **keys; // decoded literal values, one per literal arm
+    size_t *lengths;
+    size_t count;
+    NovaPerfectHash hash;
+} StringDispatch;
+
+static void string_dispatch_free(StringDispatch *dispatch) {
+    for (size_t i = 0; i < dispatch->count; ++i) free(dispatch->keys[i]);
+    free(dispatch->keys);
+    free(dispatch->lengths);
+    nova_perfect_hash_free(&dispatch->hash);
+}
+
+static bool string_dispatch_build(const NovaIRMatchArm *const *arms, size_t count, StringDispatch *dispatch) {
+    memset(dispatch, 0, sizeof(*dispatch));
+    dispatch->keys = static_cast<char **>(calloc(count, sizeof(char *)));
+    dispatch->lengths = static_cast<size_t *>(calloc(count, sizeof(size_t)));
+    if (!dispatch->keys || !dispatch->lengths) {
+        string_dispatch_free(dispatch);
+        return false;
     }
-    switch (expr->kind) {
-    case NOVA_IR_EXPR_NUMBER:
-        snprintf(value_buffer, value_buffer_size, "%#.17g", expr->as.number_value);
-        return true;
-    case NOVA_IR_EXPR_BOOL:
-        snprintf(value_buffer, value_buffer_size, "%d", expr->as.bool_value ? 1 : 0);
-        return true;
-    case NOVA_IR_EXPR_UNIT:
-        snprintf(value_buffer, value_buffer_size, "0");
-        return true;
-    case NOVA_IR_EXPR_IDENTIFIER:
-        snprintf(value_buffer, value_buffer_size, "%%%.*s", (int)expr->as.identifier.length, expr->as.identifier.lexeme);
-        return true;
-    case NOVA_IR_EXPR_CALL: {
-        const char *ret_type = llvm_expr_type(emitter->semantics, expr);
-        char args_buffer[1024] = {0};
-        size_t used = 0;
-        for (size_t i = 0; i < expr->as.call.arg_count; ++i) {
-            char arg_val[64];
-            const NovaIRExpr *arg_expr = expr->as.call.args[i];
-            if (!emit_expr_llvm(emitter, arg_expr, arg_val, sizeof(arg_val))) return false;
-            const char *arg_type = llvm_expr_type(emitter->semantics, arg_expr);
-            int written = snprintf(args_buffer + used, sizeof(args_buffer) - used, "%s%s %s", i == 0 ? "" : ", ", arg_type, arg_val);
-            if (written < 0 || (size_t)written >= sizeof(args_buffer) - used) return false;
-            used += (size_t)written;
-        }
-        if (strcmp(ret_type, "void") == 0) {
-            llvm_emitf(emitter, "  call void @%.*s(%s)\n", (int)expr->as.call.callee.length, expr->as.call.callee.lexeme, args_buffer);
-            snprintf(value_buffer, value_buffer_size, "0");
-        } else {
-            llvm_new_temp(emitter, value_buffer, value_buffer_size);
-            llvm_emitf(emitter, "  %s = call %s @%.*s(%s)\n", value_buffer, ret_type, (int)expr->as.call.callee.length, expr->as.call.callee.lexeme, args_buffer);
+    for (size_t i = 0; i < count; ++i) {
+        dispatch->keys[i] = decode_string_literal(arms[i]->literal, &dispatch->lengths[i]);
+        dispatch->count++;
+        if (!dispatch->keys[i]) {
+            string_dispatch_free(dispatch);
+            return false;
         }
-        return true;
     }
-    case NOVA_IR_EXPR_SEQUENCE: {
-        if (expr->as.sequence.count == 0) {
-            snprintf(value_buffer, value_buffer_size, "0");
-            return true;
-        }
-        for (size_t i = 0; i + 1 < expr->as.sequence.count; ++i) {
-            if (!emit_statement_llvm(emitter, expr->as.sequence.items[i])) return false;
-        }
-        return emit_expr_llvm(emitter, expr->as.sequence.items[expr->as.sequence.count - 1], value_buffer, value_buffer_size);
+    if (!nova_match_perfect_hash(dispatch->keys, dispatch->lengths, count, &dispatch->hash)) {
+        string_dispatch_free(dispatch);
+        return false;
     }
-    case NOVA_IR_EXPR_IF: {
-        char cond_value[64];
-        if (!emit_expr_llvm(emitter, expr->as.if_expr.condition, cond_value, sizeof(cond_value))) return false;
+    return true;
+}
 
-        char then_label[32], else_label[32], end_label[32];
-        llvm_new_label(emitter, then_label, sizeof(then_label), "if.then.");
-        llvm_new_label(emitter, else_label, sizeof(else_label), "if.else.");
-        llvm_new_label(emitter, end_label, sizeof(end_label), "if.end.");
+static bool is_literal_match_type(const NovaSemanticContext *semantics, NovaTypeId type) {
+    const NovaTypeInfo *info = nova_semantic_type_info(semantics, type);
+    return info && (info->kind == NOVA_TYPE_KIND_NUMBER || info->kind == NOVA_TYPE_KIND_INT || info->kind == NOVA_TYPE_KIND_BOOL ||
+                    info->kind == NOVA_TYPE_KIND_STRING);
+}
 
-        llvm_emitf(emitter, "  br i1 %s, label %%%s, label %%%s\n", cond_value, then_label, else_label);
-        llvm_emitf(emitter, "%s:\n", then_label);
-        char then_value[64];
-        if (!emit_expr_llvm(emitter, expr->as.if_expr.then_branch, then_value, sizeof(then_value))) return false;
-        llvm_emitf(emitter, "  br label %%%s\n", end_label);
+static const char *field_type_to_llvm(const NovaSemanticContext *semantics, NovaTypeId type) {
+    const char *name = type_to_llvm(semantics, type);
+    return strcmp(name, "void") == 0 ? "i8" : name;
+}
 
-        llvm_emitf(emitter, "%s:\n", else_label);
-        char else_value[64];
-        if (expr->as.if_expr.else_branch) {
-            if (!emit_expr_llvm(emitter, expr->as.if_expr.else_branch, else_value, sizeof(else_value))) return false;
-        } else {
-            snprintf(else_value, sizeof(else_value), "%s", llvm_zero_literal(llvm_expr_type(emitter->semantics, expr)));
+static void llvm_variant_name(const NovaTypeRecord *record, size_t tag, char *buffer, size_t size) {
+    snprintf(buffer,
+             size,
+             "nova.%.*s.%.*s",
+             (int)record->decl->name.length,
+             record->decl->name.lexeme,
+             (int)record->variants[tag].variant->name.length,
+             record->variants[tag].variant->name.lexeme);
+}
+
+// Layouts are emitted in the order they were computed, so each type follows
+// the types it embeds.
+static const NovaTypeLayout **program_layouts(const NovaIRProgram *program, const NovaSemanticContext *semantics, size_t *count) {
+    *count = 0;
+    const NovaTypeLayout **layouts = static_cast<const NovaTypeLayout **>(calloc(program->type_count + 1, sizeof(*layouts)));
+    if (!layouts) return NULL;
+    for (size_t i = 0; i < program->type_count; ++i) {
+        const NovaTypeLayout *layout = nova_layout_of(semantics, program->types[i]);
+        if (!layout || layout->variant_count == 0) continue;
+        size_t at = (*count)++;
+        while (at > 0 && layouts[at - 1]->order > layout->order) {
+            layouts[at] = layouts[at - 1];
+            at--;
         }
-        llvm_emitf(emitter, "  br label %%%s\n", end_label);
+        layouts[at] = layout;
+    }
+    return layouts;
+}
 
-        llvm_emitf(emitter, "%s:\n", end_label);
-        const char *result_type = llvm_expr_type(emitter->semantics, expr);
-        if (strcmp(result_type, "void") == 0) {
-            snprintf(value_buffer, value_buffer_size, "0");
-            return true;
+static void llvm_payload_type(const NovaTypeLayout *layout, char *buffer, size_t size) {
+    size_t count = layout->payload_size / layout->payload_align;
+    snprintf(buffer, size, "[%zu x i%zu]", count > 0 ? count : 1, layout->payload_align * 8);
+}
+
+// A spare value of a niche layout as an LLVM constant of the layout's type.
+static void llvm_niche_constant(const NovaSemanticContext *semantics, const NovaTypeLayout *layout, uint64_t code, char *buffer, size_t size) {
+    unsigned long long value = (unsigned long long)code;
+    switch (layout->repr.kind) {
+    case NOVA_REPR_F64:
+        snprintf(buffer, size, "0x%016llX", value);
+        break;
+    case NOVA_REPR_PTR:
+        if (value == 0) {
+            snprintf(buffer, size, "null");
+        } else {
+            snprintf(buffer, size, "inttoptr (i64 %llu to ptr)", value);
         }
-        llvm_new_temp(emitter, value_buffer, value_buffer_size);
-        llvm_emitf(emitter,
-                   "  %s = phi %s [ %s, %%%s ], [ %s, %%%s ]\n",
-                   value_buffer,
-                   result_type,
-                   then_value,
-                   then_label,
-                   else_value,
-                   else_label);
-        return true;
+        break;
+    case NOVA_REPR_STRUCT: {
+        const NovaTypeLayout *host = nova_layout_niche_host(semantics, layout);
+        char payload[32] = "[1 x i8]";
+        if (host) llvm_payload_type(host, payload, sizeof(payload));
+        snprintf(buffer, size, "{ i%zu %llu, %s zeroinitializer }", host ? host->tag_size * 8 : 8, value, payload);
+        break;
     }
-    case NOVA_IR_EXPR_WHILE:
-        return emit_statement_llvm(emitter, expr);
-    case NOVA_IR_EXPR_STRING:
-    case NOVA_IR_EXPR_LIST:
-    case NOVA_IR_EXPR_MATCH:
+    case NOVA_REPR_BOOL:
+    case NOVA_REPR_INT:
     default:
-        return false;
+        snprintf(buffer, size, "%llu", value);
+        break;
     }
 }
 
-static bool emit_program_llvm(const NovaIRProgram *program, const NovaSemanticContext *semantics, const char *ir_path, char *error_buffer, size_t error_buffer_size) {
-    FILE *out = fopen(ir_path, "w");
-    if (!out) {
-        if (error_buffer && error_buffer_size > 0) {
-            snprintf(error_buffer, error_buffer_size, "failed to open %s", ir_path);
+// The trace function of a traced type, as an LLVM constant operand. Heap
+// cells holding a function value or a list trace the one reference.
+static void llvm_trace_name(const NovaSemanticContext *semantics, NovaTypeId type, char *buffer, size_t size) {
+    const NovaTypeRecord *record = nova_semantic_type_record(semantics, type);
+    if (!type_is_traced(semantics, type)) {
+        snprintf(buffer, size, "null");
+        return;
+    }
+    if (!record) {
+        snprintf(buffer, size, "@nova_rt_trace_ref");
+        return;
+    }
+    snprintf(buffer, size, "@nova.trace.%.*s", (int)record->decl->name.length, record->decl->name.lexeme);
+}
+
+// Marks what the field at addr refers to; addr names a ptr in the trace
+// function being written and prefix keeps the field's temporaries apart.
+static void emit_trace_field_llvm(FILE *out, const NovaSemanticContext *semantics, NovaTypeId type, bool boxed, const char *addr, const char *prefix) {
+    const NovaTypeRecord *record = nova_semantic_type_record(semantics, type);
+    if (!boxed && !type_is_traced(semantics, type)) return;
+    if (boxed || !record || !record->layout) {
+        fprintf(out, "  %%%s.ref = load ptr, ptr %s\n  call void @nova_rt_mark(ptr %%gc, ptr %%%s.ref)\n", prefix, addr, prefix);
+        return;
+    }
+    char trace[160];
+    llvm_trace_name(semantics, type, trace, sizeof(trace));
+    fprintf(out, "  call void %s(ptr %%gc, ptr %s)\n", trace, addr);
+}
+
+// Mirrors emit_trace_function_c: mark the references of the variant the
+// tag selects. Also the trace function of the type's boxes.
+static void emit_trace_function_llvm(FILE *out, const NovaSemanticContext *semantics, const NovaTypeLayout *layout) {
+    char trace[160], addr[64], prefix[64];
+    llvm_trace_name(semantics, layout->type, trace, sizeof(trace));
+    fprintf(out, "define private void %s(ptr %%gc, ptr %%value) {\nentry:\n", trace);
+    if (layout->kind == NOVA_LAYOUT_NICHE) {
+        const NovaFieldLayout *field = &layout->variants[layout->dataful].fields[0];
+        emit_trace_field_llvm(out, semantics, field->type, field->boxed, "%value", "f0");
+        fputs("  ret void\n}\n\n", out);
+        return;
+    }
+    if (layout->kind == NOVA_LAYOUT_STRUCT) {
+        for (size_t f = 0; f < layout->variants[0].field_count; ++f) {
+            const NovaFieldLayout *field = &layout->variants[0].fields[f];
+            if (!field->boxed && !type_is_traced(semantics, field->type)) continue;
+            snprintf(addr, sizeof(addr), "%%f%zu.addr", f);
+            snprintf(prefix, sizeof(prefix), "f%zu", f);
+            fprintf(out, "  %s = getelementptr inbounds %s, ptr %%value, i32 0, i32 %zu\n", addr, layout->llvm_type, f);
+            emit_trace_field_llvm(out, semantics, field->type, field->boxed, addr, prefix);
         }
-        return false;
+        fputs("  ret void\n}\n\n", out);
+        return;
     }
-    LLVMEmitter emitter = {.out = out, .semantics = semantics, .temp_counter = 0, .label_counter = 0};
-    fputs("target triple = \"x86_64-unknown-linux-gnu\"\n\n", out);
-    for (size_t i = 0; i < program->function_count; ++i) {
-        const NovaIRFunction *fn = &program->functions[i];
-        const char *ret_type = type_to_llvm(semantics, fn->return_type);
-        llvm_emitf(&emitter, "define %s @%.*s(", ret_type, (int)fn->name.length, fn->name.lexeme);
-        for (size_t p = 0; p < fn->param_count; ++p) {
-            if (p > 0) fputs(", ", out);
-            llvm_emitf(&emitter, "%s %%%.*s", type_to_llvm(semantics, fn->params[p].type), (int)fn->params[p].name.length, fn->params[p].name.lexeme);
-        }
-        fputs(") {\nentry:\n", out);
-        if (strcmp(ret_type, "void") == 0) {
-            if (!emit_statement_llvm(&emitter, fn->body)) {
-                if (error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "unsupported LLVM statement");
-                fclose(out);
-                remove(ir_path);
-                return false;
+    size_t tag_bits = layout->tag_size * 8;
+    fprintf(out, "  %%tag = load i%zu, ptr %%value\n  switch i%zu %%tag, label %%done [", tag_bits, tag_bits);
+    for (size_t v = 0; v < layout->variant_count; ++v) {
+        const NovaVariantLayout *variant = &layout->variants[v];
+        if (variant_is_traced(semantics, variant)) fprintf(out, " i%zu %zu, label %%v%zu", tag_bits, v, v);
+    }
+    fputs(" ]\n", out);
+    for (size_t v = 0; v < layout->variant_count; ++v) {
+        const NovaVariantLayout *variant = &layout->variants[v];
+        if (!variant_is_traced(semantics, variant)) continue;
+        fprintf(out, "v%zu:\n", v);
+        for (size_t f = 0; f < variant->field_count; ++f) {
+            const NovaFieldLayout *field = &variant->fields[f];
+            if (!field->boxed && !type_is_traced(semantics, field->type)) continue;
+            snprintf(addr, sizeof(addr), "%%v%zu.f%zu.addr", v, f);
+            snprintf(prefix, sizeof(prefix), "v%zu.f%zu", v, f);
+            fprintf(out, "  %s = getelementptr inbounds i8, ptr %%value, i64 %zu\n", addr, layout->payload_offset + field->offset);
+            emit_trace_field_llvm(out, semantics, field->type, field->boxed, addr, prefix);
+        }
+        fputs("  br label %done\n", out);
+    }
+    fputs("done:\n  ret void\n}\n\n", out);
+}
+
+// Tagged layouts become a tag and an integer array wide enough for the
+// largest payload. Constructors and field readers go through a stack cell
+// that SROA removes once they are inlined.
+static void emit_type_layout_llvm(LLVMEmitter *emitter, const NovaTypeRecord *record, const NovaTypeLayout *layout) {
+    char name[160], payload[32];
+    if (layout->kind == NOVA_LAYOUT_STRUCT) {
+        // Struct layouts are first-class aggregates built and read in place.
+        const NovaVariantLayout *variant = &layout->variants[0];
+        llvm_emitf(emitter, "%s = type { ", layout->llvm_type);
+        for (size_t f = 0; f < variant->field_count; ++f) {
+            const NovaFieldLayout *field = &variant->fields[f];
+            llvm_emitf(emitter, "%s%s", f > 0 ? ", " : "", field->boxed ? "ptr" : field_type_to_llvm(emitter->semantics, field->type));
+        }
+        llvm_emitf(emitter, " }\n\n");
+        return;
+    }
+    llvm_payload_type(layout, payload, sizeof(payload));
+    llvm_emitf(emitter, "%s = type { i%zu, %s }\n", layout->llvm_type, layout->tag_size * 8, payload);
+    for (size_t v = 0; v < layout->variant_count; ++v) {
+        const NovaVariantLayout *variant = &layout->variants[v];
+        llvm_variant_name(record, v, name, sizeof(name));
+        llvm_emitf(emitter, "define private %s @%s(", layout->llvm_type, name);
+        for (size_t f = 0; f < variant->field_count; ++f) {
+            llvm_emitf(emitter, "%s%s %%f%zu", f > 0 ? ", " : "", field_type_to_llvm(emitter->semantics, variant->fields[f].type), f);
+        }
+        llvm_emitf(emitter, ") alwaysinline {\nentry:\n  %%cell = alloca %s\n  store %s zeroinitializer, ptr %%cell\n", layout->llvm_type, layout->llvm_type);
+        llvm_emitf(emitter, "  store i%zu %zu, ptr %%cell\n", layout->tag_size * 8, v);
+        for (size_t f = 0; f < variant->field_count; ++f) {
+            const NovaFieldLayout *field = &variant->fields[f];
+            const char *type = field_type_to_llvm(emitter->semantics, field->type);
+            llvm_emitf(emitter, "  %%f%zu.addr = getelementptr inbounds i8, ptr %%cell, i64 %zu\n", f, layout->payload_offset + field->offset);
+            if (field->boxed) {
+                char trace[160];
+                llvm_trace_name(emitter->semantics, field->type, trace, sizeof(trace));
+                llvm_emitf(emitter, "  %%f%zu.box = call ptr @nova_rt_alloc(i64 %zu, ptr %s)\n", f, nova_layout_repr(emitter->semantics, field->type).size, trace);
+                llvm_emitf(emitter, "  store %s %%f%zu, ptr %%f%zu.box\n  store ptr %%f%zu.box, ptr %%f%zu.addr\n", type, f, f, f, f);
+            } else {
+                llvm_emitf(emitter, "  store %s %%f%zu, ptr %%f%zu.addr\n", type, f, f);
             }
-            fputs("  ret void\n", out);
-        } else {
-            char result[64];
-            if (!emit_expr_llvm(&emitter, fn->body, result, sizeof(result))) {
-                if (error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "unsupported LLVM expression");
-                fclose(out);
-                remove(ir_path);
-                return false;
+        }
+        llvm_emitf(emitter, "  %%value = load %s, ptr %%cell\n  ret %s %%value\n}\n", layout->llvm_type, layout->llvm_type);
+        for (size_t f = 0; f < variant->field_count; ++f) {
+            const NovaFieldLayout *field = &variant->fields[f];
+            const char *type = field_type_to_llvm(emitter->semantics, field->type);
+            llvm_emitf(emitter, "define private %s @%s.%zu(%s %%value) alwaysinline {\nentry:\n", type, name, f, layout->llvm_type);
+            llvm_emitf(emitter, "  %%cell = alloca %s\n  store %s %%value, ptr %%cell\n", layout->llvm_type, layout->llvm_type);
+            llvm_emitf(emitter, "  %%addr = getelementptr inbounds i8, ptr %%cell, i64 %zu\n", layout->payload_offset + field->offset);
+            if (field->boxed) {
+                llvm_emitf(emitter, "  %%box = load ptr, ptr %%addr\n  %%field = load %s, ptr %%box\n", type);
+            } else {
+                llvm_emitf(emitter, "  %%field = load %s, ptr %%addr\n", type);
             }
-            llvm_emitf(&emitter, "  ret %s %s\n", ret_type, result);
+            llvm_emitf(emitter, "  ret %s %%field\n}\n", type);
         }
-        fputs("}\n\n", out);
     }
-    fclose(out);
-    return true;
+    llvm_emitf(emitter, "\n");
 }
 
-static bool emit_expr(FILE *out, const NovaSemanticContext *semantics, const NovaIRExpr *expr);
-
-static bool emit_statement(FILE *out, const NovaSemanticContext *semantics, const NovaIRExpr *expr, int indent) {
-    if (!expr) {
-        emit_indent(out, indent);
-        fputs(";", out);
+static bool emit_construct_llvm(LLVMEmitter *emitter, const NovaIRExpr *expr, char *value_buffer, size_t value_buffer_size) {
+    const NovaTypeRecord *record = nova_semantic_type_record(emitter->semantics, expr->type);
+    const NovaTypeLayout *layout = record ? record->layout : NULL;
+    size_t tag = expr->as.construct.tag;
+    if (!layout || tag >= layout->variant_count) return false;
+    const NovaVariantLayout *variant = &layout->variants[tag];
+    if (layout->kind == NOVA_LAYOUT_ENUM) {
+        snprintf(value_buffer, value_buffer_size, "%zu", tag);
         return true;
     }
-    if (expr->kind == NOVA_IR_EXPR_SEQUENCE) {
-        for (size_t i = 0; i < expr->as.sequence.count; ++i) {
-            if (!emit_statement(out, semantics, expr->as.sequence.items[i], indent)) return false;
-            if (i + 1 < expr->as.sequence.count) {
-                fputc('\n', out);
+    if (layout->kind == NOVA_LAYOUT_NICHE && tag != layout->dataful) {
+        llvm_niche_constant(emitter->semantics, layout, variant->niche_code, value_buffer, value_buffer_size);
+        return true;
+    }
+    if (layout->kind == NOVA_LAYOUT_STRUCT) {
+        char aggregate[64] = "undef";
+        for (size_t i = 0; i < expr->as.construct.arg_count && i < variant->field_count; ++i) {
+            char arg_val[64], next[64];
+            const NovaFieldLayout *field = &variant->fields[i];
+            if (!emit_expr_llvm(emitter, expr->as.construct.args[i], arg_val, sizeof(arg_val))) return false;
+            const char *arg_type = field_type_to_llvm(emitter->semantics, field->type);
+            if (field->boxed) {
+                char box[64], trace[160];
+                llvm_new_temp(emitter, box, sizeof(box));
+                llvm_trace_name(emitter->semantics, field->type, trace, sizeof(trace));
+                llvm_emitf(emitter, "  %s = call ptr @nova_rt_alloc(i64 %zu, ptr %s)\n", box, nova_layout_repr(emitter->semantics, field->type).size, trace);
+                llvm_emitf(emitter, "  store %s %s, ptr %s\n", arg_type, arg_val, box);
+                snprintf(arg_val, sizeof(arg_val), "%s", box);
+                arg_type = "ptr";
             }
+            llvm_new_temp(emitter, next, sizeof(next));
+            llvm_emitf(emitter, "  %s = insertvalue %s %s, %s %s, %zu\n", next, layout->llvm_type, aggregate, arg_type, arg_val, i);
+            snprintf(aggregate, sizeof(aggregate), "%s", next);
         }
+        snprintf(value_buffer, value_buffer_size, "%s", aggregate);
         return true;
     }
-    if (expr->kind == NOVA_IR_EXPR_WHILE) {
-        emit_indent(out, indent);
-        fputs("while (", out);
-        if (!emit_expr(out, semantics, expr->as.while_expr.condition)) return false;
-        fputs(") {\n", out);
-        if (!emit_statement(out, semantics, expr->as.while_expr.body, indent + 1)) return false;
-        fputc('\n', out);
-        emit_indent(out, indent);
-        fputs("}", out);
-        return true;
+    char args_buffer[1024] = {0};
+    size_t used = 0;
+    for (size_t i = 0; i < expr->as.construct.arg_count && i < variant->field_count; ++i) {
+        char arg_val[64];
+        const NovaIRExpr *arg_expr = expr->as.construct.args[i];
+        if (!emit_expr_llvm(emitter, arg_expr, arg_val, sizeof(arg_val))) return false;
+        const char *arg_type = field_type_to_llvm(emitter->semantics, variant->fields[i].type);
+        if (layout->kind == NOVA_LAYOUT_NICHE) {
+            // The value is the field itself, widened or boxed to the layout's type.
+            const NovaTypeInfo *info = nova_semantic_type_info(emitter->semantics, variant->fields[i].type);
+            if (variant->fields[i].boxed) {
+                char trace[160];
+                llvm_trace_name(emitter->semantics, variant->fields[i].type, trace, sizeof(trace));
+                llvm_new_temp(emitter, value_buffer, value_buffer_size);
+                llvm_emitf(emitter, "  %s = call ptr @nova_rt_alloc(i64 %zu, ptr %s)\n", value_buffer, nova_layout_repr(emitter->semantics, variant->fields[i].type).size, trace);
+                llvm_emitf(emitter, "  store %s %s, ptr %s\n", arg_type, arg_val, value_buffer);
+            } else if (info && info->kind == NOVA_TYPE_KIND_NUMBER) {
+                llvm_new_temp(emitter, value_buffer, value_buffer_size);
+                llvm_emitf(emitter, "  %s = call double @nova.f64.clear_niche(double %s)\n", value_buffer, arg_val);
+            } else if (info && info->kind == NOVA_TYPE_KIND_BOOL) {
+                llvm_new_temp(emitter, value_buffer, value_buffer_size);
+                llvm_emitf(emitter, "  %s = zext i1 %s to i8\n", value_buffer, arg_val);
+            } else {
+                snprintf(value_buffer, value_buffer_size, "%s", arg_val);
+            }
+            return true;
+        }
+        int written = snprintf(args_buffer + used, sizeof(args_buffer) - used, "%s%s %s", i == 0 ? "" : ", ", arg_type, arg_val);
+        if (written < 0 || (size_t)written >= sizeof(args_buffer) - used) return false;
+        used += (size_t)written;
+    }
+    if (layout->kind == NOVA_LAYOUT_NICHE) return false;
+    char name[160];
+    llvm_variant_name(record, tag, name, sizeof(name));
+    llvm_new_temp(emitter, value_buffer, value_buffer_size);
+    llvm_emitf(emitter, "  %s = call %s @%s(%s)\n", value_buffer, layout->llvm_type, name, args_buffer);
+    return true;
+}
+
+// Computes the variant tag of subject as an i32 switch selector.
+static void emit_tag_llvm(LLVMEmitter *emitter, const NovaTypeLayout *layout, const char *subject, char *selector, size_t selector_size) {
+    char raw[64], code[32], index[32], niche[32], below[32], shifted[32], picked[32], narrow[32];
+    if (layout->kind == NOVA_LAYOUT_STRUCT) {
+        snprintf(selector, selector_size, "0");
+        return;
+    }
+    if (layout->kind == NOVA_LAYOUT_ENUM || layout->kind == NOVA_LAYOUT_TAGGED) {
+        snprintf(raw, sizeof(raw), "%s", subject);
+        if (layout->kind == NOVA_LAYOUT_TAGGED) {
+            llvm_new_temp(emitter, raw, sizeof(raw));
+            llvm_emitf(emitter, "  %s = extractvalue %s %s, 0\n", raw, layout->llvm_type, subject);
+        }
+        if (layout->tag_size == 4) {
+            snprintf(selector, selector_size, "%s", raw);
+            return;
+        }
+        llvm_new_temp(emitter, selector, selector_size);
+        llvm_emitf(emitter, "  %s = zext i%zu %s to i32\n", selector, layout->tag_size * 8, raw);
+        return;
+    }
+    size_t spare = layout->variant_count - 1;
+    if (spare == 0) {
+        snprintf(selector, selector_size, "%zu", layout->dataful);
+        return;
+    }
+    llvm_new_temp(emitter, code, sizeof(code));
+    switch (layout->repr.kind) {
+    case NOVA_REPR_F64:
+        llvm_emitf(emitter, "  %s = bitcast double %s to i64\n", code, subject);
+        break;
+    case NOVA_REPR_PTR:
+        llvm_emitf(emitter, "  %s = ptrtoint ptr %s to i64\n", code, subject);
+        break;
+    case NOVA_REPR_STRUCT: {
+        const NovaTypeLayout *host = nova_layout_niche_host(emitter->semantics, layout);
+        llvm_new_temp(emitter, raw, sizeof(raw));
+        llvm_emitf(emitter, "  %s = extractvalue %s %s, 0\n", raw, layout->llvm_type, subject);
+        llvm_emitf(emitter, "  %s = zext i%zu %s to i64\n", code, host ? host->tag_size * 8 : 8, raw);
+        break;
+    }
+    case NOVA_REPR_BOOL:
+    case NOVA_REPR_INT:
+    default:
+        llvm_emitf(emitter, "  %s = zext %s %s to i64\n", code, layout->llvm_type, subject);
+        break;
+    }
+    llvm_new_temp(emitter, index, sizeof(index));
+    llvm_emitf(emitter, "  %s = sub i64 %s, %llu\n", index, code, (unsigned long long)(layout->repr.niche_start - spare));
+    llvm_new_temp(emitter, niche, sizeof(niche));
+    llvm_emitf(emitter, "  %s = icmp ult i64 %s, %zu\n", niche, index, spare);
+    // Spare values name the payload-free variants in order, skipping the dataful tag.
+    if (layout->dataful < spare) {
+        llvm_new_temp(emitter, shifted, sizeof(shifted));
+        llvm_emitf(emitter, "  %s = add i64 %s, 1\n", shifted, index);
+    }
+    if (layout->dataful == 0) {
+        snprintf(picked, sizeof(picked), "%s", shifted);
+    } else if (layout->dataful >= spare) {
+        snprintf(picked, sizeof(picked), "%s", index);
+    } else {
+        llvm_new_temp(emitter, below, sizeof(below));
+        llvm_emitf(emitter, "  %s = icmp ult i64 %s, %zu\n", below, index, layout->dataful);
+        llvm_new_temp(emitter, picked, sizeof(picked));
+        llvm_emitf(emitter, "  %s = select i1 %s, i64 %s, i64 %s\n", picked, below, index, shifted);
+    }
+    llvm_new_temp(emitter, narrow, sizeof(narrow));
+    llvm_emitf(emitter, "  %s = trunc i64 %s to i32\n", narrow, picked);
+    llvm_new_temp(emitter, selector, selector_size);
+    llvm_emitf(emitter, "  %s = select i1 %s, i32 %s, i32 %zu\n", selector, niche, narrow, layout->dataful);
+}
+
+// Reads payload field index of variant tag out of subject.
+static void emit_field_read_llvm(LLVMEmitter *emitter, const NovaTypeRecord *record, size_t tag, size_t index, const char *subject, char *value, size_t value_size) {
+    const NovaTypeLayout *layout = record->layout;
+    const NovaFieldLayout *field = &layout->variants[tag].fields[index];
+    const char *type = field_type_to_llvm(emitter->semantics, field->type);
+    const NovaTypeInfo *info = nova_semantic_type_info(emitter->semantics, field->type);
+    if (layout->kind == NOVA_LAYOUT_TAGGED) {
+        char name[160];
+        llvm_variant_name(record, tag, name, sizeof(name));
+        llvm_new_temp(emitter, value, value_size);
+        llvm_emitf(emitter, "  %s = call %s @%s.%zu(%s %s)\n", value, type, name, index, layout->llvm_type, subject);
+    } else if (layout->kind == NOVA_LAYOUT_STRUCT) {
+        char field_value[64];
+        llvm_new_temp(emitter, field_value, sizeof(field_value));
+        llvm_emitf(emitter, "  %s = extractvalue %s %s, %zu\n", field_value, layout->llvm_type, subject, index);
+        if (field->boxed) {
+            llvm_new_temp(emitter, value, value_size);
+            llvm_emitf(emitter, "  %s = load %s, ptr %s\n", value, type, field_value);
+        } else {
+            snprintf(value, value_size, "%s", field_value);
+        }
+    } else if (field->boxed) {
+        llvm_new_temp(emitter, value, value_size);
+        llvm_emitf(emitter, "  %s = load %s, ptr %s\n", value, type, subject);
+    } else if (info && info->kind == NOVA_TYPE_KIND_BOOL) {
+        llvm_new_temp(emitter, value, value_size);
+        llvm_emitf(emitter, "  %s = trunc i8 %s to i1\n", value, subject);
+    } else {
+        snprintf(value, value_size, "%s", subject);
+    }
+}
+
+typedef struct {
+    char value[64];
+    char block[48];
+} LLVMIncoming;
+
+static bool emit_tail_llvm(LLVMEmitter *emitter, const NovaIRExpr *expr, const char *ret_type);
+
+// Emits one match arm: payload loads, then the body either as a value that
+// flows to end_label or, when ret_type is set, in tail position.
+static bool emit_match_arm_llvm(LLVMEmitter *emitter,
+                                const NovaTypeRecord *record,
+                                const NovaIRMatchArm *arm,
+                                const char *subject,
+                                const char *ret_type,
+                                const char *end_label,
+                                LLVMIncoming *incoming) {
+    size_t pushed = 0;
+    if (arm->tag != SIZE_MAX) {
+        const NovaVariantRecord *variant = &record->variants[arm->tag];
+        for (size_t b = 0; b < arm->binding_count && b < variant->arity; ++b) {
+            if (arm->bindings[b].length == 1 && arm->bindings[b].lexeme[0] == '_') continue;
+            const char *type = field_type_to_llvm(emitter->semantics, variant->payload_types[b]);
+            char value[64];
+            emit_field_read_llvm(emitter, record, arm->tag, b, subject, value, sizeof(value));
+            if (!llvm_push_binding(emitter, arm->bindings[b], value, type, false)) return false;
+            pushed++;
+        }
+    }
+    bool ok;
+    if (ret_type) {
+        ok = emit_tail_llvm(emitter, arm->body, ret_type);
+    } else {
+        ok = emit_expr_llvm(emitter, arm->body, incoming->value, sizeof(incoming->value));
+        snprintf(incoming->block, sizeof(incoming->block), "%s", emitter->block);
+        llvm_emitf(emitter, "  br label %%%s\n", end_label);
+    }
+    emitter->binding_count -= pushed;
+    return ok;
+}
+
+static void llvm_string_hash_helpers(LLVMEmitter *emitter) {
+    if (emitter->uses_string_hash) return;
+    emitter->uses_string_hash = true;
+    // The murmur3 finaliser; it must agree with nova_match_hash_mix.
+    llvm_globalf(emitter,
+                 "define private i32 @nova.hash.mix(i32 %%hash) {\n"
+                 "  %%a = lshr i32 %%hash, 16\n"
+                 "  %%b = xor i32 %%hash, %%a\n"
+                 "  %%c = mul i32 %%b, -2048144789\n"
+                 "  %%d = lshr i32 %%c, 13\n"
+                 "  %%e = xor i32 %%c, %%d\n"
+                 "  %%f = mul i32 %%e, -1028477387\n"
+                 "  %%g = lshr i32 %%f, 16\n"
+                 "  %%h = xor i32 %%f, %%g\n"
+                 "  ret i32 %%h\n"
+                 "}\n\n");
+}
+
+static void llvm_global_bytes(LLVMEmitter *emitter, const char *bytes, size_t length) {
+    llvm_globalf(emitter, "c\"");
+    for (size_t i = 0; i < length; ++i) {
+        unsigned char c = (unsigned char)bytes[i];
+        if (c < 0x20 || c >= 0x7f || c == '"' || c == '\\') {
+            llvm_globalf(emitter, "\\%02X", c);
+        } else {
+            llvm_globalf(emitter, "%c", c);
+        }
+    }
+    llvm_globalf(emitter, "\\00\"");
+}
+
+// A string literal as an LLVM constant expression.
+static bool llvm_string_constant(LLVMEmitter *emitter, const NovaIRExpr *literal, char *buffer, size_t size) {
+    size_t length = 0;
+    char *bytes = decode_string_literal(literal, &length);
+    if (!bytes) return false;
+    if (length <= NOVA_STRING_INLINE_MAX) {
+        snprintf(buffer, size, "inttoptr (i64 %llu to ptr)", (unsigned long long)string_inline_word(bytes, length));
+    } else {
+        snprintf(buffer, size, "getelementptr inbounds (%%nova.strings, ptr @nova.strings, i32 0, i32 %zu)", emitter->string_fields[literal->as.string_value.index]);
+    }
+    free(bytes);
+    return true;
+}
+
+// Literals too long to be inline words share one read-only table of
+// NovaString headers, each followed by its bytes. The table's type must be
+// defined before functions index it; its contents follow the functions.
+static void emit_string_table_type_llvm(LLVMEmitter *emitter) {
+    const NovaIRProgram *program = emitter->program;
+    size_t count = 0;
+    for (size_t i = 0; i < program->string_count; ++i) {
+        if (emitter->string_fields[i] == SIZE_MAX) continue;
+        fprintf(emitter->out, "%s{ i64, i32, i32, [%zu x i8] }", count++ == 0 ? "%nova.strings = type { " : ", ", program->strings[i].length + 1);
+    }
+    if (count > 0) fputs(" }\n\n", emitter->out);
+}
+
+static void emit_string_table_llvm(LLVMEmitter *emitter) {
+    const NovaIRProgram *program = emitter->program;
+    size_t count = 0;
+    for (size_t i = 0; i < program->string_count; ++i) {
+        if (emitter->string_fields[i] != SIZE_MAX) count++;
+    }
+    if (count == 0) return;
+    llvm_globalf(emitter, "@nova.strings = private unnamed_addr constant %%nova.strings { ");
+    count = 0;
+    for (size_t i = 0; i < program->string_count; ++i) {
+        if (emitter->string_fields[i] == SIZE_MAX) continue;
+        const NovaIRString *entry = &program->strings[i];
+        llvm_globalf(emitter,
+                     "%s{ i64, i32, i32, [%zu x i8] } { i64 %zu, i32 %d, i32 0, [%zu x i8] ",
+                     count++ == 0 ? "" : ", ",
+                     entry->length + 1,
+                     entry->length,
+                     NOVA_STRING_FLAT,
+                     entry->length + 1);
+        llvm_global_bytes(emitter, entry->bytes, entry->length);
+        llvm_globalf(emitter, " }");
+    }
+    llvm_globalf(emitter, " }\n\n");
+}
+
+// Computes the index of the literal arm that matches subject into selector, or -1.
+static bool emit_literal_selector_llvm(LLVMEmitter *emitter,
+                                       NovaTypeKind kind,
+                                       const char *subject,
+                                       const NovaIRMatchArm *const *arms,
+                                       size_t case_count,
+                                       char *selector,
+                                       size_t selector_size) {
+    snprintf(selector, selector_size, "-1");
+    if (case_count == 0) return true;
+    if (kind != NOVA_TYPE_KIND_STRING) {
+        for (size_t i = case_count; i > 0; --i) {
+            const NovaIRExpr *literal = arms[i - 1]->literal;
+            char test[32], chosen[32];
+            llvm_new_temp(emitter, test, sizeof(test));
+            if (kind == NOVA_TYPE_KIND_NUMBER) {
+                char number[NOVA_NUMBER_BUFFER_SIZE];
+                format_number_llvm(literal->as.number_value, number, sizeof(number));
+                llvm_emitf(emitter, "  %s = fcmp oeq double %s, %s\n", test, subject, number);
+            } else if (kind == NOVA_TYPE_KIND_INT) {
+                llvm_emitf(emitter, "  %s = icmp eq i64 %s, %lld\n", test, subject, (long long)literal->as.int_value);
+            } else {
+                llvm_emitf(emitter, "  %s = icmp eq i1 %s, %d\n", test, subject, literal->as.bool_value ? 1 : 0);
+            }
+            llvm_new_temp(emitter, chosen, sizeof(chosen));
+            llvm_emitf(emitter, "  %s = select i1 %s, i32 %zu, i32 %s\n", chosen, test, i - 1, selector);
+            snprintf(selector, selector_size, "%s", chosen);
+        }
+        return true;
+    }
+    StringDispatch dispatch;
+    if (!string_dispatch_build(arms, case_count, &dispatch)) return false;
+    llvm_string_hash_helpers(emitter);
+    size_t id = emitter->global_counter++;
+    llvm_globalf(emitter, "@nova.match.%zu.keys = private unnamed_addr constant [%zu x ptr] [", id, dispatch.count);
+    for (size_t i = 0; i < dispatch.count; ++i) {
+        char key[128];
+        if (!llvm_string_constant(emitter, arms[i]->literal, key, sizeof(key))) {
+            string_dispatch_free(&dispatch);
+            return false;
+        }
+        llvm_globalf(emitter, "%sptr %s", i > 0 ? ", " : "", key);
+    }
+    llvm_globalf(emitter, "]\n@nova.match.%zu.displacements = private unnamed_addr constant [%zu x i32] [", id, dispatch.hash.bucket_count);
+    for (size_t i = 0; i < dispatch.hash.bucket_count; ++i) {
+        llvm_globalf(emitter, "%si32 %d", i > 0 ? ", " : "", (int32_t)dispatch.hash.displacements[i]);
+    }
+    llvm_globalf(emitter, "]\n@nova.match.%zu.slots = private unnamed_addr constant [%zu x i32] [", id, dispatch.hash.slot_count);
+    for (size_t i = 0; i < dispatch.hash.slot_count; ++i) {
+        llvm_globalf(emitter, "%si32 %u", i > 0 ? ", " : "", dispatch.hash.slots[i]);
+    }
+    llvm_globalf(emitter, "]\n\n");
+
+    char hash[32], bucket[32], bucket_at[32], displacement[32], displaced[32], mixed[32], slot[32], slot_at[32], key_index[32], key_at[32], key[32], hit[32];
+    llvm_new_temp(emitter, hash, sizeof(hash));
+    llvm_emitf(emitter, "  %s = call i32 @nova_string_hash(ptr %s, i32 %d)\n", hash, subject, (int32_t)dispatch.hash.seed);
+    llvm_new_temp(emitter, bucket, sizeof(bucket));
+    llvm_emitf(emitter, "  %s = and i32 %s, %zu\n", bucket, hash, dispatch.hash.bucket_count - 1);
+    llvm_new_temp(emitter, bucket_at, sizeof(bucket_at));
+    llvm_emitf(emitter, "  %s = getelementptr inbounds [%zu x i32], ptr @nova.match.%zu.displacements, i32 0, i32 %s\n", bucket_at, dispatch.hash.bucket_count, id, bucket);
+    llvm_new_temp(emitter, displacement, sizeof(displacement));
+    llvm_emitf(emitter, "  %s = load i32, ptr %s\n", displacement, bucket_at);
+    llvm_new_temp(emitter, displaced, sizeof(displaced));
+    llvm_emitf(emitter, "  %s = xor i32 %s, %s\n", displaced, hash, displacement);
+    llvm_new_temp(emitter, mixed, sizeof(mixed));
+    llvm_emitf(emitter, "  %s = call i32 @nova.hash.mix(i32 %s)\n", mixed, displaced);
+    llvm_new_temp(emitter, slot, sizeof(slot));
+    llvm_emitf(emitter, "  %s = and i32 %s, %zu\n", slot, mixed, dispatch.hash.slot_count - 1);
+    llvm_new_temp(emitter, slot_at, sizeof(slot_at));
+    llvm_emitf(emitter, "  %s = getelementptr inbounds [%zu x i32], ptr @nova.match.%zu.slots, i32 0, i32 %s\n", slot_at, dispatch.hash.slot_count, id, slot);
+    llvm_new_temp(emitter, key_index, sizeof(key_index));
+    llvm_emitf(emitter, "  %s = load i32, ptr %s\n", key_index, slot_at);
+    llvm_new_temp(emitter, key_at, sizeof(key_at));
+    llvm_emitf(emitter, "  %s = getelementptr inbounds [%zu x ptr], ptr @nova.match.%zu.keys, i32 0, i32 %s\n", key_at, dispatch.count, id, key_index);
+    llvm_new_temp(emitter, key, sizeof(key));
+    llvm_emitf(emitter, "  %s = load ptr, ptr %s\n", key, key_at);
+    llvm_new_temp(emitter, hit, sizeof(hit));
+    llvm_emitf(emitter, "  %s = call i1 @nova_string_equal(ptr %s, ptr %s)\n", hit, subject, key);
+    llvm_new_temp(emitter, selector, selector_size);
+    llvm_emitf(emitter, "  %s = select i1 %s, i32 %s, i32 -1\n", selector, hit, key_index);
+    string_dispatch_free(&dispatch);
+    return true;
+}
+
+// Variant tags are dense indices and literal arms are numbered in order, so
+// LLVM lowers the switch to a jump table.
+static bool emit_match_llvm(LLVMEmitter *emitter, const NovaIRExpr *expr, const char *ret_type, char *value_buffer, size_t value_buffer_size) {
+    const NovaIRExpr *scrutinee = expr->as.match_expr.scrutinee;
+    if (!scrutinee) return false;
+    const NovaTypeRecord *record = nova_semantic_type_record(emitter->semantics, scrutinee->type);
+    bool literal = record == NULL;
+    if (record && (record->variant_count == 0 || !record->layout)) return false;
+    if (literal && !is_literal_match_type(emitter->semantics, scrutinee->type)) return false;
+    NovaTypeKind kind = nova_semantic_type_info(emitter->semantics, scrutinee->type)->kind;
+    char subject[64], selector[64];
+    if (!emit_expr_llvm(emitter, scrutinee, subject, sizeof(subject))) return false;
+
+    size_t arm_count = expr->as.match_expr.arm_count;
+    const NovaIRMatchArm **arms = static_cast<const NovaIRMatchArm **>(calloc(arm_count + 1, sizeof(*arms)));
+    size_t *case_values = static_cast<size_t *>(calloc(arm_count + 1, sizeof(size_t)));
+    LLVMIncoming *incoming = static_cast<LLVMIncoming *>(calloc(arm_count + 1, sizeof(LLVMIncoming)));
+    bool *seen = static_cast<bool *>(calloc(record ? record->variant_count : 1, sizeof(bool)));
+    if (!arms || !case_values || !incoming || !seen) {
+        free(arms);
+        free(case_values);
+        free(incoming);
+        free(seen);
+        return false;
+    }
+    size_t case_count = 0;
+    const NovaIRMatchArm *fallback = NULL;
+    for (size_t i = 0; i < arm_count; ++i) {
+        const NovaIRMatchArm *arm = &expr->as.match_expr.arms[i];
+        if (arm->tag == SIZE_MAX && !arm->literal) {
+            fallback = arm;
+            break;
+        }
+        if (literal) {
+            if (!arm->literal) continue;
+            case_values[case_count] = case_count;
+        } else {
+            if (arm->tag >= record->variant_count || seen[arm->tag]) continue;
+            seen[arm->tag] = true;
+            case_values[case_count] = arm->tag;
+        }
+        arms[case_count++] = arm;
+    }
+    bool complete = literal ? kind == NOVA_TYPE_KIND_BOOL && case_count == 2 : case_count == record->variant_count;
+
+    bool ok = true;
+    if (literal) {
+        ok = emit_literal_selector_llvm(emitter, kind, subject, arms, case_count, selector, sizeof(selector));
+    } else {
+        emit_tag_llvm(emitter, record->layout, subject, selector, sizeof(selector));
+    }
+    size_t label_base = emitter->label_counter;
+    emitter->label_counter += 2;
+    if (ok) {
+        llvm_emitf(emitter, "  switch i32 %s, label %%match.default.%zu [", selector, label_base);
+        for (size_t i = 0; i < case_count; ++i) {
+            llvm_emitf(emitter, " i32 %zu, label %%match.arm.%zu.%zu", case_values[i], label_base, i);
+        }
+        llvm_emitf(emitter, " ]\n");
+    }
+
+    char end_label[32], label[48];
+    snprintf(end_label, sizeof(end_label), "match.end.%zu", label_base + 1);
+    size_t incoming_count = 0;
+    for (size_t i = 0; ok && i < case_count; ++i) {
+        snprintf(label, sizeof(label), "match.arm.%zu.%zu", label_base, i);
+        llvm_begin_block(emitter, label);
+        ok = emit_match_arm_llvm(emitter, record, arms[i], subject, ret_type, end_label, &incoming[incoming_count++]);
+    }
+    snprintf(label, sizeof(label), "match.default.%zu", label_base);
+    if (ok) llvm_begin_block(emitter, label);
+    if (ok && fallback) {
+        ok = emit_match_arm_llvm(emitter, record, fallback, subject, ret_type, end_label, &incoming[incoming_count++]);
+    } else if (ok && !complete) {
+        // Matches that may be non-exhaustive only warn, so a miss stops the program.
+        llvm_emitf(emitter, "  call void @abort()\n  unreachable\n");
+    } else if (ok) {
+        llvm_emitf(emitter, "  unreachable\n");
+    }
+    free(arms);
+    free(case_values);
+    free(seen);
+    if (!ok || ret_type) {
+        free(incoming);
+        return ok;
+    }
+
+    llvm_begin_block(emitter, end_label);
+    const char *result_type = llvm_expr_type(emitter->semantics, expr);
+    if (strcmp(result_type, "void") == 0 || incoming_count == 0) {
+        snprintf(value_buffer, value_buffer_size, "%s", llvm_zero_literal(result_type));
+        if (incoming_count == 0) llvm_emitf(emitter, "  unreachable\n");
+        free(incoming);
+        return true;
+    }
+    llvm_new_temp(emitter, value_buffer, value_buffer_size);
+    llvm_emitf(emitter, "  %s = phi %s", value_buffer, result_type);
+    for (size_t i = 0; i < incoming_count; ++i) {
+        llvm_emitf(emitter, "%s [ %s, %%%s ]", i > 0 ? "," : "", incoming[i].value, incoming[i].block);
+    }
+    llvm_emitf(emitter, "\n");
+    free(incoming);
+    return true;
+}
+
+// Internal functions use the fast calling convention.
+static const char *llvm_calling_convention(const LLVMEmitter *emitter, size_t index) {
+    return index != SIZE_MAX && emitter->traits[index].local ? "fastcc " : "";
+}
+
+// musttail needs identical prototypes and calling conventions; anything else
+// only gets the tail hint.
+// Sum types held by value are LLVM structs, which the backend may pass or
+// return through memory; a call using the caller's stack that way cannot be
+// a guaranteed tail call, and llc aborts on such a `musttail`.
+static bool llvm_type_in_registers(const char *type) {
+    return type[0] != '%' && type[0] != '{' && type[0] != '[';
+}
+
+static const char *llvm_tail_marker(const LLVMEmitter *emitter, const NovaIRExpr *call) {
+    const NovaIRFunction *caller = emitter->function;
+    size_t index = nova_ir_find_function(emitter->program, &call->as.call.callee);
+    if (!caller || index == SIZE_MAX) return "tail ";
+    const NovaIRFunction *callee = &emitter->program->functions[index];
+    const char *return_type = type_to_llvm(emitter->semantics, caller->return_type);
+    if (emitter->traits[index].local != emitter->traits[caller - emitter->program->functions].local ||
+        callee->param_count != caller->param_count || !llvm_type_in_registers(return_type) ||
+        strcmp(type_to_llvm(emitter->semantics, callee->return_type), return_type) != 0) {
+        return "tail ";
+    }
+    for (size_t p = 0; p < caller->param_count; ++p) {
+        const char *param_type = type_to_llvm(emitter->semantics, caller->params[p].type);
+        if (!llvm_type_in_registers(param_type) || strcmp(type_to_llvm(emitter->semantics, callee->params[p].type), param_type) != 0) {
+            return "tail ";
+        }
+    }
+    return "musttail ";
+}
+
+static bool emit_call_llvm(LLVMEmitter *emitter, const NovaIRExpr *expr, const char *marker, char *value_buffer, size_t value_buffer_size) {
+    const char *ret_type = llvm_expr_type(emitter->semantics, expr);
+    char args_buffer[1024] = {0};
+    size_t used = 0;
+    for (size_t i = 0; i < expr->as.call.arg_count; ++i) {
+        char arg_val[64];
+        const NovaIRExpr *arg_expr = expr->as.call.args[i];
+        if (!emit_expr_llvm(emitter, arg_expr, arg_val, sizeof(arg_val))) return false;
+        const char *arg_type = llvm_expr_type(emitter->semantics, arg_expr);
+        int written = snprintf(args_buffer + used, sizeof(args_buffer) - used, "%s%s %s", i == 0 ? "" : ", ", arg_type, arg_val);
+        if (written < 0 || (size_t)written >= sizeof(args_buffer) - used) return false;
+        used += (size_t)written;
+    }
+    const char *cc = llvm_calling_convention(emitter, nova_ir_find_function(emitter->program, &expr->as.call.callee));
+    if (strcmp(ret_type, "void") == 0) {
+        llvm_emitf(emitter, "  %scall %svoid @%.*s(%s)\n", marker, cc, (int)expr->as.call.callee.length, expr->as.call.callee.lexeme, args_buffer);
+        snprintf(value_buffer, value_buffer_size, "0");
+    } else {
+        llvm_new_temp(emitter, value_buffer, value_buffer_size);
+        llvm_emitf(emitter, "  %s = %scall %s%s @%.*s(%s)\n", value_buffer, marker, cc, ret_type, (int)expr->as.call.callee.length, expr->as.call.callee.lexeme, args_buffer);
+    }
+    return true;
+}
+
+static void llvm_emit_ret(LLVMEmitter *emitter, const char *ret_type, const char *value) {
+    if (strcmp(ret_type, "void") == 0) {
+        llvm_emitf(emitter, "  ret void\n");
+    } else {
+        llvm_emitf(emitter, "  ret %s %s\n", ret_type, value);
+    }
+}
+
+// A profile's branch hint becomes llvm.expect on the condition.
+static void llvm_expect_branch(LLVMEmitter *emitter, const NovaIRExpr *expr, char *cond_value, size_t cond_value_size) {
+    NovaIRBranchHint hint = expr->as.if_expr.hint;
+    if (hint == NOVA_IR_BRANCH_UNKNOWN) return;
+    char expected[64];
+    llvm_new_temp(emitter, expected, sizeof(expected));
+    llvm_emitf(emitter, "  %s = call i1 @llvm.expect.i1(i1 %s, i1 %s)\n", expected, cond_value, hint == NOVA_IR_BRANCH_LIKELY ? "true" : "false");
+    snprintf(cond_value, cond_value_size, "%s", expected);
+}
+
+// Emits expr in tail position: every path ends in its own ret, so branches
+// need no merge block and calls can be marked as tail calls.
+static bool emit_tail_llvm(LLVMEmitter *emitter, const NovaIRExpr *expr, const char *ret_type) {
+    char value[64];
+    if (expr && expr->kind == NOVA_IR_EXPR_IF && expr->as.if_expr.condition) {
+        char cond_value[64], then_label[32], else_label[32];
+        if (!emit_expr_llvm(emitter, expr->as.if_expr.condition, cond_value, sizeof(cond_value))) return false;
+        llvm_expect_branch(emitter, expr, cond_value, sizeof(cond_value));
+        llvm_new_label(emitter, then_label, sizeof(then_label), "if.then.");
+        llvm_new_label(emitter, else_label, sizeof(else_label), "if.else.");
+        llvm_emitf(emitter, "  br i1 %s, label %%%s, label %%%s\n", cond_value, then_label, else_label);
+        llvm_begin_block(emitter, then_label);
+        if (!emit_tail_llvm(emitter, expr->as.if_expr.then_branch, ret_type)) return false;
+        llvm_begin_block(emitter, else_label);
+        if (expr->as.if_expr.else_branch) {
+            return emit_tail_llvm(emitter, expr->as.if_expr.else_branch, ret_type);
+        }
+        llvm_emit_ret(emitter, ret_type, llvm_zero_literal(ret_type));
+        return true;
+    }
+    if (expr && expr->kind == NOVA_IR_EXPR_MATCH) {
+        return emit_match_llvm(emitter, expr, ret_type, value, sizeof(value));
+    }
+    if (expr && expr->kind == NOVA_IR_EXPR_LET) {
+        if (!llvm_bind_let(emitter, expr)) return false;
+        bool ok = emit_tail_llvm(emitter, expr->as.let_expr.body, ret_type);
+        emitter->binding_count--;
+        return ok;
+    }
+    if (expr && expr->kind == NOVA_IR_EXPR_SEQUENCE && expr->as.sequence.count > 0) {
+        for (size_t i = 0; i + 1 < expr->as.sequence.count; ++i) {
+            if (!emit_statement_llvm(emitter, expr->as.sequence.items[i])) return false;
+        }
+        return emit_tail_llvm(emitter, expr->as.sequence.items[expr->as.sequence.count - 1], ret_type);
+    }
+    if (expr && expr->kind == NOVA_IR_EXPR_CALL && strcmp(llvm_expr_type(emitter->semantics, expr), ret_type) == 0) {
+        if (!emit_call_llvm(emitter, expr, llvm_tail_marker(emitter, expr), value, sizeof(value))) return false;
+        llvm_emit_ret(emitter, ret_type, value);
+        return true;
+    }
+    if (strcmp(ret_type, "void") == 0) {
+        if (!emit_statement_llvm(emitter, expr)) return false;
+    } else if (!emit_expr_llvm(emitter, expr, value, sizeof(value))) {
+        return false;
+    }
+    llvm_emit_ret(emitter, ret_type, value);
+    return true;
+}
+
+// Int division traps on a zero divisor and wraps INT64_MIN / -1, which sdiv
+// leaves undefined; the helpers inline away wherever the divisor is known.
+static void llvm_int_helpers(LLVMEmitter *emitter) {
+    if (emitter->uses_int_helpers) return;
+    emitter->uses_int_helpers = true;
+    llvm_globalf(emitter,
+                 "declare i64 @llvm.fptosi.sat.i64.f64(double)\n\n"
+                 "define private i64 @nova.int.div(i64 %%a, i64 %%b) alwaysinline {\n"
+                 "entry:\n"
+                 "  %%zero = icmp eq i64 %%b, 0\n"
+                 "  br i1 %%zero, label %%trap, label %%check\n"
+                 "trap:\n"
+                 "  call void @abort()\n"
+                 "  unreachable\n"
+                 "check:\n"
+                 "  %%minus = icmp eq i64 %%b, -1\n"
+                 "  br i1 %%minus, label %%negate, label %%divide\n"
+                 "negate:\n"
+                 "  %%negated = sub i64 0, %%a\n"
+                 "  ret i64 %%negated\n"
+                 "divide:\n"
+                 "  %%quotient = sdiv i64 %%a, %%b\n"
+                 "  ret i64 %%quotient\n"
+                 "}\n\n"
+                 "define private i64 @nova.int.rem(i64 %%a, i64 %%b) alwaysinline {\n"
+                 "entry:\n"
+                 "  %%zero = icmp eq i64 %%b, 0\n"
+                 "  br i1 %%zero, label %%trap, label %%check\n"
+                 "trap:\n"
+                 "  call void @abort()\n"
+                 "  unreachable\n"
+                 "check:\n"
+                 "  %%minus = icmp eq i64 %%b, -1\n"
+                 "  br i1 %%minus, label %%done, label %%divide\n"
+                 "done:\n"
+                 "  ret i64 0\n"
+                 "divide:\n"
+                 "  %%remainder = srem i64 %%a, %%b\n"
+                 "  ret i64 %%remainder\n"
+                 "}\n\n");
+}
+
+// Int arithmetic wraps, so no nsw flags; conversions saturate like Int(x).
+static bool emit_int_operator_llvm(LLVMEmitter *emitter, const NovaIRExpr *expr, const char *left, const char *right, char *value_buffer, size_t value_buffer_size) {
+    const char *instruction = NULL;
+    switch (expr->as.op.op) {
+    case NOVA_OP_ADD: instruction = "add i64"; break;
+    case NOVA_OP_SUB: instruction = "sub i64"; break;
+    case NOVA_OP_MUL: instruction = "mul i64"; break;
+    case NOVA_OP_LT: instruction = "icmp slt i64"; break;
+    case NOVA_OP_LE: instruction = "icmp sle i64"; break;
+    case NOVA_OP_GT: instruction = "icmp sgt i64"; break;
+    case NOVA_OP_GE: instruction = "icmp sge i64"; break;
+    case NOVA_OP_EQ: instruction = "icmp eq i64"; break;
+    case NOVA_OP_NE: instruction = "icmp ne i64"; break;
+    case NOVA_OP_DIV:
+    case NOVA_OP_MOD:
+        llvm_int_helpers(emitter);
+        llvm_new_temp(emitter, value_buffer, value_buffer_size);
+        llvm_emitf(emitter, "  %s = call i64 @nova.int.%s(i64 %s, i64 %s)\n", value_buffer, expr->as.op.op == NOVA_OP_DIV ? "div" : "rem", left, right);
+        return true;
+    case NOVA_OP_NEG:
+        llvm_new_temp(emitter, value_buffer, value_buffer_size);
+        llvm_emitf(emitter, "  %s = sub i64 0, %s\n", value_buffer, left);
+        return true;
+    case NOVA_OP_TO_NUMBER:
+        llvm_new_temp(emitter, value_buffer, value_buffer_size);
+        llvm_emitf(emitter, "  %s = sitofp i64 %s to double\n", value_buffer, left);
+        return true;
+    case NOVA_OP_TO_INT:
+        snprintf(value_buffer, value_buffer_size, "%s", left);
+        return true;
+    case NOVA_OP_NOT:
+    case NOVA_OP_AND:
+    case NOVA_OP_OR:
+    case NOVA_OP_LIST_LENGTH:
+    case NOVA_OP_LIST_GET:
+    case NOVA_OP_LIST_PUSH:
+    case NOVA_OP_MAP_NEW:
+    case NOVA_OP_MAP_LENGTH:
+    case NOVA_OP_MAP_GET:
+    case NOVA_OP_MAP_HAS:
+    case NOVA_OP_MAP_PUT:
+    case NOVA_OP_MAP_REMOVE:
+        return false;
+    }
+    llvm_new_temp(emitter, value_buffer, value_buffer_size);
+    llvm_emitf(emitter, "  %s = %s %s, %s\n", value_buffer, instruction, left, right);
+    return true;
+}
+
+// Literals and pushes go through a helper per site that stages the
+// elements in a stack cell, like constructors; once the helper is inlined
+// the cell sits in the caller's entry block.
+static bool emit_list_literal_llvm(LLVMEmitter *emitter, const NovaIRExpr *expr, char *value_buffer, size_t value_buffer_size) {
+    size_t count = expr->as.list.count;
+    if (count == 0) {
+        llvm_new_temp(emitter, value_buffer, value_buffer_size);
+        llvm_emitf(emitter, "  %s = call ptr @nova_list_new(i64 0, ptr null, i64 0, ptr null)\n", value_buffer);
+        return true;
+    }
+    char (*values)[64] = static_cast<char (*)[64]>(malloc(count * sizeof(*values)));
+    if (!values) return false;
+    for (size_t i = 0; i < count; ++i) {
+        if (!emit_expr_llvm(emitter, expr->as.list.elements[i], values[i], sizeof(values[i]))) {
+            free(values);
+            return false;
+        }
+    }
+    NovaTypeId element = list_element_type(emitter->semantics, expr->type);
+    const char *type = field_type_to_llvm(emitter->semantics, element);
+    char trace[160];
+    llvm_trace_name(emitter->semantics, element, trace, sizeof(trace));
+    size_t id = emitter->global_counter++;
+    llvm_globalf(emitter, "define private ptr @nova.list.%zu(", id);
+    for (size_t i = 0; i < count; ++i) {
+        llvm_globalf(emitter, "%s%s %%e%zu", i > 0 ? ", " : "", type, i);
+    }
+    llvm_globalf(emitter, ") alwaysinline {\nentry:\n  %%items = alloca [%zu x %s]\n", count, type);
+    for (size_t i = 0; i < count; ++i) {
+        llvm_globalf(emitter, "  %%p%zu = getelementptr [%zu x %s], ptr %%items, i64 0, i64 %zu\n  store %s %%e%zu, ptr %%p%zu\n", i, count, type, i, type, i, i);
+    }
+    llvm_globalf(emitter,
+                 "  %%list = call ptr @nova_list_new(i64 ptrtoint (ptr getelementptr (%s, ptr null, i32 1) to i64), ptr %s, i64 %zu, ptr %%items)\n"
+                 "  ret ptr %%list\n"
+                 "}\n\n",
+                 type, trace, count);
+    llvm_new_temp(emitter, value_buffer, value_buffer_size);
+    llvm_emitf(emitter, "  %s = call ptr @nova.list.%zu(", value_buffer, id);
+    for (size_t i = 0; i < count; ++i) {
+        llvm_emitf(emitter, "%s%s %s", i > 0 ? ", " : "", type, values[i]);
+    }
+    llvm_emitf(emitter, ")\n");
+    free(values);
+    return true;
+}
+
+static bool emit_list_operator_llvm(LLVMEmitter *emitter, const NovaIRExpr *expr, const char *list, const char *operand, char *value_buffer, size_t value_buffer_size) {
+    llvm_new_temp(emitter, value_buffer, value_buffer_size);
+    switch (expr->as.op.op) {
+    case NOVA_OP_LIST_LENGTH:
+        llvm_emitf(emitter, "  %s = call i64 @nova_list_length(ptr %s)\n", value_buffer, list);
+        return true;
+    case NOVA_OP_LIST_GET: {
+        char slot[64];
+        llvm_new_temp(emitter, slot, sizeof(slot));
+        llvm_emitf(emitter,
+                   "  %s = call ptr @nova_list_at(ptr %s, i64 %s)\n  %s = load %s, ptr %s\n",
+                   slot, list, operand, value_buffer, field_type_to_llvm(emitter->semantics, expr->type), slot);
+        return true;
+    }
+    case NOVA_OP_LIST_PUSH: {
+        // The result's element type: the operand may be an empty literal whose elements have no type.
+        NovaTypeId element = list_element_type(emitter->semantics, expr->type);
+        const char *type = field_type_to_llvm(emitter->semantics, element);
+        char trace[160];
+        llvm_trace_name(emitter->semantics, element, trace, sizeof(trace));
+        size_t id = emitter->global_counter++;
+        llvm_globalf(emitter,
+                     "define private ptr @nova.push.%zu(ptr %%list, %s %%value) alwaysinline {\n"
+                     "entry:\n"
+                     "  %%cell = alloca %s\n"
+                     "  store %s %%value, ptr %%cell\n"
+                     "  %%pushed = call ptr @nova_list_push(ptr %%list, i64 ptrtoint (ptr getelementptr (%s, ptr null, i32 1) to i64), ptr %s, ptr %%cell)\n"
+                     "  ret ptr %%pushed\n"
+                     "}\n\n",
+                     id, type, type, type, type, trace);
+        llvm_emitf(emitter, "  %s = call ptr @nova.push.%zu(ptr %s, %s %s)\n", value_buffer, id, list, type, operand);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+static bool is_empty_list_literal(const NovaIRExpr *expr) {
+    return expr->kind == NOVA_IR_EXPR_LIST && expr->as.list.count == 0;
+}
+
+// Keys travel to the runtime as one word: an Int as itself, a String as
+// its pointer.
+static bool emit_map_key_llvm(LLVMEmitter *emitter, const NovaIRExpr *key, char *value_buffer, size_t value_buffer_size) {
+    char value[64];
+    if (!emit_expr_llvm(emitter, key, value, sizeof(value))) return false;
+    if (strcmp(llvm_expr_type(emitter->semantics, key), "ptr") != 0) {
+        snprintf(value_buffer, value_buffer_size, "%s", value);
+        return true;
+    }
+    llvm_new_temp(emitter, value_buffer, value_buffer_size);
+    llvm_emitf(emitter, "  %s = ptrtoint ptr %s to i64\n", value_buffer, value);
+    return true;
+}
+
+// Map operators evaluate their own operands: Map() needs none and the key
+// of a lookup is widened to a word first. Puts stage the value in a stack
+// cell through a helper per site, like list pushes.
+static bool emit_map_operator_llvm(LLVMEmitter *emitter, const NovaIRExpr *expr, char *value_buffer, size_t value_buffer_size) {
+    const NovaSemanticContext *semantics = emitter->semantics;
+    const NovaIRExpr *left = expr->as.op.left;
+    char map[64], key[64], value[64];
+    if (expr->as.op.op == NOVA_OP_MAP_NEW) {
+        if (is_empty_list_literal(left) && is_empty_list_literal(expr->as.op.right)) {
+            llvm_new_temp(emitter, value_buffer, value_buffer_size);
+            llvm_emitf(emitter, "  %s = call ptr @nova_map_new()\n", value_buffer);
+            return true;
+        }
+        if (!emit_expr_llvm(emitter, left, map, sizeof(map))) return false;
+        if (!emit_expr_llvm(emitter, expr->as.op.right, value, sizeof(value))) return false;
+        NovaTypeId element = map_value_type(semantics, expr->type);
+        const char *type = field_type_to_llvm(semantics, element);
+        char trace[160];
+        llvm_trace_name(semantics, element, trace, sizeof(trace));
+        llvm_new_temp(emitter, value_buffer, value_buffer_size);
+        llvm_emitf(emitter,
+                   "  %s = call ptr @nova_map_from_lists(i32 %d, i64 ptrtoint (ptr getelementptr (%s, ptr null, i32 1) to i64), ptr %s, ptr %s, ptr %s)\n",
+                   value_buffer, map_has_string_keys(semantics, expr->type) ? 1 : 0, type, trace, map, value);
+        return true;
+    }
+    if (!emit_expr_llvm(emitter, left, map, sizeof(map))) return false;
+    if (expr->as.op.op == NOVA_OP_MAP_LENGTH) {
+        llvm_new_temp(emitter, value_buffer, value_buffer_size);
+        llvm_emitf(emitter, "  %s = call i64 @nova_map_length(ptr %s)\n", value_buffer, map);
+        return true;
+    }
+    if (!emit_map_key_llvm(emitter, expr->as.op.right, key, sizeof(key))) return false;
+    switch (expr->as.op.op) {
+    case NOVA_OP_MAP_GET: {
+        char slot[64];
+        llvm_new_temp(emitter, slot, sizeof(slot));
+        llvm_new_temp(emitter, value_buffer, value_buffer_size);
+        llvm_emitf(emitter,
+                   "  %s = call ptr @nova_map_at(ptr %s, i64 %s)\n  %s = load %s, ptr %s\n",
+                   slot, map, key, value_buffer, field_type_to_llvm(semantics, expr->type), slot);
+        return true;
+    }
+    case NOVA_OP_MAP_HAS: {
+        char slot[64];
+        llvm_new_temp(emitter, slot, sizeof(slot));
+        llvm_new_temp(emitter, value_buffer, value_buffer_size);
+        llvm_emitf(emitter, "  %s = call ptr @nova_map_find(ptr %s, i64 %s)\n  %s = icmp ne ptr %s, null\n", slot, map, key, value_buffer, slot);
+        return true;
+    }
+    case NOVA_OP_MAP_REMOVE:
+        llvm_new_temp(emitter, value_buffer, value_buffer_size);
+        llvm_emitf(emitter, "  %s = call ptr @nova_map_remove(ptr %s, i64 %s)\n", value_buffer, map, key);
+        return true;
+    case NOVA_OP_MAP_PUT: {
+        if (!emit_expr_llvm(emitter, expr->as.op.third, value, sizeof(value))) return false;
+        // The result's value type: the operand may be Map(), whose values have no type.
+        NovaTypeId element = map_value_type(semantics, expr->type);
+        const char *type = field_type_to_llvm(semantics, element);
+        char trace[160];
+        llvm_trace_name(semantics, element, trace, sizeof(trace));
+        size_t id = emitter->global_counter++;
+        llvm_globalf(emitter,
+                     "define private ptr @nova.put.%zu(ptr %%map, i64 %%key, %s %%value) alwaysinline {\n"
+                     "entry:\n"
+                     "  %%cell = alloca %s\n"
+                     "  store %s %%value, ptr %%cell\n"
+                     "  %%updated = call ptr @nova_map_put(ptr %%map, i32 %d, i64 ptrtoint (ptr getelementptr (%s, ptr null, i32 1) to i64), ptr %s, i64 %%key, ptr %%cell)\n"
+                     "  ret ptr %%updated\n"
+                     "}\n\n",
+                     id, type, type, type, map_has_string_keys(semantics, expr->type) ? 1 : 0, type, trace);
+        llvm_new_temp(emitter, value_buffer, value_buffer_size);
+        llvm_emitf(emitter, "  %s = call ptr @nova.put.%zu(ptr %s, i64 %s, %s %s)\n", value_buffer, id, map, key, type, value);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+static bool emit_operator_llvm(LLVMEmitter *emitter, const NovaIRExpr *expr, char *value_buffer, size_t value_buffer_size) {
+    if (is_map_operator(expr->as.op.op)) return emit_map_operator_llvm(emitter, expr, value_buffer, value_buffer_size);
+    char left[64], right[64];
+    if (!emit_expr_llvm(emitter, expr->as.op.left, left, sizeof(left))) return false;
+    if (expr->as.op.right && !emit_expr_llvm(emitter, expr->as.op.right, right, sizeof(right))) return false;
+    if (is_string_operator(emitter->semantics, expr)) {
+        llvm_new_temp(emitter, value_buffer, value_buffer_size);
+        if (expr->as.op.op == NOVA_OP_ADD) {
+            llvm_emitf(emitter, "  %s = call ptr @nova_string_concat(ptr %s, ptr %s)\n", value_buffer, left, right);
+        } else {
+            llvm_emitf(emitter, "  %s = call i64 @nova_string_length(ptr %s)\n", value_buffer, left);
+        }
+        return true;
+    }
+    if (is_list_operator(expr->as.op.op)) {
+        return emit_list_operator_llvm(emitter, expr, left, right, value_buffer, value_buffer_size);
+    }
+    const char *operand_type = llvm_expr_type(emitter->semantics, expr->as.op.left);
+    if (strcmp(operand_type, "i64") == 0) {
+        return emit_int_operator_llvm(emitter, expr, left, right, value_buffer, value_buffer_size);
+    }
+    bool bool_operands = strcmp(operand_type, "i1") == 0;
+    const char *instruction = NULL;
+    switch (expr->as.op.op) {
+    case NOVA_OP_ADD: instruction = "fadd double"; break;
+    case NOVA_OP_SUB: instruction = "fsub double"; break;
+    case NOVA_OP_MUL: instruction = "fmul double"; break;
+    case NOVA_OP_DIV: instruction = "fdiv double"; break;
+    case NOVA_OP_MOD: instruction = "frem double"; break;
+    case NOVA_OP_LT: instruction = "fcmp olt double"; break;
+    case NOVA_OP_LE: instruction = "fcmp ole double"; break;
+    case NOVA_OP_GT: instruction = "fcmp ogt double"; break;
+    case NOVA_OP_GE: instruction = "fcmp oge double"; break;
+    case NOVA_OP_EQ: instruction = bool_operands ? "icmp eq i1" : "fcmp oeq double"; break;
+    case NOVA_OP_NE: instruction = bool_operands ? "icmp ne i1" : "fcmp une double"; break;
+    case NOVA_OP_NEG:
+        llvm_new_temp(emitter, value_buffer, value_buffer_size);
+        llvm_emitf(emitter, "  %s = fneg double %s\n", value_buffer, left);
+        return true;
+    case NOVA_OP_NOT:
+        llvm_new_temp(emitter, value_buffer, value_buffer_size);
+        llvm_emitf(emitter, "  %s = xor i1 %s, true\n", value_buffer, left);
+        return true;
+    case NOVA_OP_TO_INT:
+        llvm_int_helpers(emitter);
+        llvm_new_temp(emitter, value_buffer, value_buffer_size);
+        llvm_emitf(emitter, "  %s = call i64 @llvm.fptosi.sat.i64.f64(double %s)\n", value_buffer, left);
+        return true;
+    case NOVA_OP_TO_NUMBER:
+        snprintf(value_buffer, value_buffer_size, "%s", left);
+        return true;
+    case NOVA_OP_AND:
+    case NOVA_OP_OR:
+    case NOVA_OP_LIST_LENGTH:
+    case NOVA_OP_LIST_GET:
+    case NOVA_OP_LIST_PUSH:
+    case NOVA_OP_MAP_NEW:
+    case NOVA_OP_MAP_LENGTH:
+    case NOVA_OP_MAP_GET:
+    case NOVA_OP_MAP_HAS:
+    case NOVA_OP_MAP_PUT:
+    case NOVA_OP_MAP_REMOVE:
+        return false;
+    }
+    llvm_new_temp(emitter, value_buffer, value_buffer_size);
+    llvm_emitf(emitter, "  %s = %s %s, %s\n", value_buffer, instruction, left, right);
+    return true;
+}
+
+static bool emit_closure_llvm(LLVMEmitter *emitter, const NovaIRExpr *expr, char *value_buffer, size_t value_buffer_size) {
+    const NovaToken *name = &expr->as.closure.function;
+    if (expr->as.closure.capture_count == 0) {
+        snprintf(value_buffer, value_buffer_size, "@nova.closure.%.*s", (int)name->length, name->lexeme);
+        return true;
+    }
+    char values[16][64];
+    if (expr->as.closure.capture_count > 16) return false;
+    for (size_t i = 0; i < expr->as.closure.capture_count; ++i) {
+        if (!emit_expr_llvm(emitter, expr->as.closure.captures[i], values[i], sizeof(values[i]))) return false;
+    }
+    llvm_new_temp(emitter, value_buffer, value_buffer_size);
+    llvm_emitf(emitter,
+               "  %s = call ptr @nova_rt_alloc(i64 ptrtoint (ptr getelementptr (%%nova.env.%.*s, ptr null, i32 1) to i64), ptr @nova.trace.env.%.*s)\n",
+               value_buffer, (int)name->length, name->lexeme, (int)name->length, name->lexeme);
+    llvm_emitf(emitter, "  store ptr @nova.entry.%.*s, ptr %s\n", (int)name->length, name->lexeme, value_buffer);
+    for (size_t i = 0; i < expr->as.closure.capture_count; ++i) {
+        char field[64];
+        llvm_new_temp(emitter, field, sizeof(field));
+        llvm_emitf(emitter, "  %s = getelementptr %%nova.env.%.*s, ptr %s, i32 0, i32 %zu\n", field, (int)name->length, name->lexeme, value_buffer, i + 1);
+        llvm_emitf(emitter, "  store %s %s, ptr %s\n", llvm_expr_type(emitter->semantics, expr->as.closure.captures[i]), values[i], field);
+    }
+    return true;
+}
+
+static bool emit_apply_llvm(LLVMEmitter *emitter, const NovaIRExpr *expr, char *value_buffer, size_t value_buffer_size) {
+    char callee[64];
+    if (!emit_expr_llvm(emitter, expr->as.apply.callee, callee, sizeof(callee))) return false;
+    char args_buffer[1024];
+    int used = snprintf(args_buffer, sizeof(args_buffer), "ptr %s", callee);
+    for (size_t i = 0; i < expr->as.apply.arg_count; ++i) {
+        char arg_val[64];
+        const NovaIRExpr *arg_expr = expr->as.apply.args[i];
+        if (!emit_expr_llvm(emitter, arg_expr, arg_val, sizeof(arg_val))) return false;
+        int written = snprintf(args_buffer + used, sizeof(args_buffer) - (size_t)used, ", %s %s", llvm_expr_type(emitter->semantics, arg_expr), arg_val);
+        if (written < 0 || (size_t)written >= sizeof(args_buffer) - (size_t)used) return false;
+        used += written;
+    }
+    char code[64];
+    llvm_new_temp(emitter, code, sizeof(code));
+    llvm_emitf(emitter, "  %s = load ptr, ptr %s\n", code, callee);
+    const char *ret_type = llvm_expr_type(emitter->semantics, expr);
+    if (strcmp(ret_type, "void") == 0) {
+        llvm_emitf(emitter, "  call void %s(%s)\n", code, args_buffer);
+        snprintf(value_buffer, value_buffer_size, "0");
+    } else {
+        llvm_new_temp(emitter, value_buffer, value_buffer_size);
+        llvm_emitf(emitter, "  %s = call %s %s(%s)\n", value_buffer, ret_type, code, args_buffer);
+    }
+    return true;
+}
+
+// Environment type and entry thunk of a function used as a value; functions
+// without captures share one constant environment.
+static void emit_closure_entry_llvm(LLVMEmitter *emitter, const NovaIRFunction *fn) {
+    FILE *out = emitter->out;
+    const NovaSemanticContext *semantics = emitter->semantics;
+    int length = (int)fn->name.length;
+    const char *name = fn->name.lexeme;
+    fprintf(out, "%%nova.env.%.*s = type { ptr", length, name);
+    for (size_t p = 0; p < fn->capture_count; ++p) fprintf(out, ", %s", type_to_llvm(semantics, fn->params[p].type));
+    fputs(" }\n", out);
+    const char *ret_type = type_to_llvm(semantics, fn->return_type);
+    fprintf(out, "define private %s @nova.entry.%.*s(ptr %%env", ret_type, length, name);
+    for (size_t p = fn->capture_count; p < fn->param_count; ++p) fprintf(out, ", %s %%a%zu", type_to_llvm(semantics, fn->params[p].type), p);
+    fputs(") {\nentry:\n", out);
+    for (size_t p = 0; p < fn->capture_count; ++p) {
+        const char *type = type_to_llvm(semantics, fn->params[p].type);
+        fprintf(out, "  %%c%zu.addr = getelementptr %%nova.env.%.*s, ptr %%env, i32 0, i32 %zu\n", p, length, name, p + 1);
+        fprintf(out, "  %%c%zu = load %s, ptr %%c%zu.addr\n", p, type, p);
+    }
+    bool is_void = strcmp(ret_type, "void") == 0;
+    fprintf(out, "  %stail call %s%s @%.*s(", is_void ? "" : "%result = ", llvm_calling_convention(emitter, (size_t)(fn - emitter->program->functions)), ret_type, length, name);
+    for (size_t p = 0; p < fn->param_count; ++p) {
+        fprintf(out, "%s%s %%%s%zu", p > 0 ? ", " : "", type_to_llvm(semantics, fn->params[p].type), p < fn->capture_count ? "c" : "a", p);
+    }
+    fputs(")\n", out);
+    if (is_void) {
+        fputs("  ret void\n}\n", out);
+    } else {
+        fprintf(out, "  ret %s %%result\n}\n", ret_type);
+    }
+    if (fn->capture_count == 0) {
+        fprintf(out, "@nova.closure.%.*s = private unnamed_addr constant %%nova.env.%.*s { ptr @nova.entry.%.*s }\n", length, name, length, name, length, name);
+    } else {
+        fprintf(out, "define private void @nova.trace.env.%.*s(ptr %%gc, ptr %%env) {\nentry:\n", length, name);
+        for (size_t p = 0; p < fn->capture_count; ++p) {
+            if (!type_is_traced(semantics, fn->params[p].type)) continue;
+            char addr[32], prefix[32];
+            snprintf(addr, sizeof(addr), "%%c%zu.addr", p);
+            snprintf(prefix, sizeof(prefix), "c%zu", p);
+            fprintf(out, "  %s = getelementptr %%nova.env.%.*s, ptr %%env, i32 0, i32 %zu\n", addr, length, name, p + 1);
+            emit_trace_field_llvm(out, semantics, fn->params[p].type, false, addr, prefix);
+        }
+        fputs("  ret void\n}\n", out);
+    }
+    fputc('\n', out);
+}
+
+static bool emit_expr_llvm(LLVMEmitter *emitter, const NovaIRExpr *expr, char *value_buffer, size_t value_buffer_size) {
+    if (!expr) {
+        snprintf(value_buffer, value_buffer_size, "0.0");
+        return true;
+    }
+    switch (expr->kind) {
+    case NOVA_IR_EXPR_NUMBER:
+        // Zero placeholders for other types (such as an unset loop result) use their own zero.
+        if (strcmp(llvm_expr_type(emitter->semantics, expr), "double") != 0) {
+            snprintf(value_buffer, value_buffer_size, "%s", llvm_zero_literal(llvm_expr_type(emitter->semantics, expr)));
+            return true;
+        }
+        format_number_llvm(expr->as.number_value, value_buffer, value_buffer_size);
+        return true;
+    case NOVA_IR_EXPR_INT:
+        snprintf(value_buffer, value_buffer_size, "%lld", (long long)expr->as.int_value);
+        return true;
+    case NOVA_IR_EXPR_BOOL:
+        snprintf(value_buffer, value_buffer_size, "%d", expr->as.bool_value ? 1 : 0);
+        return true;
+    case NOVA_IR_EXPR_UNIT:
+        snprintf(value_buffer, value_buffer_size, "0");
+        return true;
+    case NOVA_IR_EXPR_IDENTIFIER: {
+        const LLVMBinding *binding = llvm_find_binding(emitter, &expr->as.identifier);
+        if (binding && binding->is_slot) {
+            llvm_new_temp(emitter, value_buffer, value_buffer_size);
+            llvm_emitf(emitter, "  %s = load %s, ptr %s\n", value_buffer, binding->type, binding->value);
+            return true;
+        }
+        if (binding) {
+            snprintf(value_buffer, value_buffer_size, "%s", binding->value);
+            return true;
+        }
+        snprintf(value_buffer, value_buffer_size, "%%%.*s", (int)expr->as.identifier.length, expr->as.identifier.lexeme);
+        return true;
+    }
+    case NOVA_IR_EXPR_LET:
+        return emit_let_llvm(emitter, expr, value_buffer, value_buffer_size);
+    case NOVA_IR_EXPR_ASSIGN: {
+        const LLVMBinding *binding = llvm_find_binding(emitter, &expr->as.assign.target);
+        if (!binding || !binding->is_slot) return false;
+        char slot_name[64], type[64], value[64];
+        snprintf(slot_name, sizeof(slot_name), "%s", binding->value);
+        snprintf(type, sizeof(type), "%s", binding->type);
+        if (!emit_expr_llvm(emitter, expr->as.assign.value, value, sizeof(value))) return false;
+        llvm_emitf(emitter, "  store %s %s, ptr %s\n", type, value, slot_name);
+        snprintf(value_buffer, value_buffer_size, "0");
+        return true;
+    }
+    case NOVA_IR_EXPR_CALL:
+        return emit_call_llvm(emitter, expr, "", value_buffer, value_buffer_size);
+    case NOVA_IR_EXPR_CLOSURE:
+        return emit_closure_llvm(emitter, expr, value_buffer, value_buffer_size);
+    case NOVA_IR_EXPR_APPLY:
+        return emit_apply_llvm(emitter, expr, value_buffer, value_buffer_size);
+    case NOVA_IR_EXPR_SEQUENCE: {
+        if (expr->as.sequence.count == 0) {
+            snprintf(value_buffer, value_buffer_size, "0");
+            return true;
+        }
+        for (size_t i = 0; i + 1 < expr->as.sequence.count; ++i) {
+            if (!emit_statement_llvm(emitter, expr->as.sequence.items[i])) return false;
+        }
+        return emit_expr_llvm(emitter, expr->as.sequence.items[expr->as.sequence.count - 1], value_buffer, value_buffer_size);
+    }
+    case NOVA_IR_EXPR_IF: {
+        char cond_value[64];
+        if (!emit_expr_llvm(emitter, expr->as.if_expr.condition, cond_value, sizeof(cond_value))) return false;
+        llvm_expect_branch(emitter, expr, cond_value, sizeof(cond_value));
+
+        char then_label[32], else_label[32], end_label[32];
+        llvm_new_label(emitter, then_label, sizeof(then_label), "if.then.");
+        llvm_new_label(emitter, else_label, sizeof(else_label), "if.else.");
+        llvm_new_label(emitter, end_label, sizeof(end_label), "if.end.");
+
+        // Nested control flow moves the branch end into a later block, so
+        // the phi names whichever block each branch finished in.
+        llvm_emitf(emitter, "  br i1 %s, label %%%s, label %%%s\n", cond_value, then_label, else_label);
+        llvm_begin_block(emitter, then_label);
+        char then_value[64], then_block[48];
+        if (!emit_expr_llvm(emitter, expr->as.if_expr.then_branch, then_value, sizeof(then_value))) return false;
+        snprintf(then_block, sizeof(then_block), "%s", emitter->block);
+        llvm_emitf(emitter, "  br label %%%s\n", end_label);
+
+        llvm_begin_block(emitter, else_label);
+        char else_value[64], else_block[48];
+        if (expr->as.if_expr.else_branch) {
+            if (!emit_expr_llvm(emitter, expr->as.if_expr.else_branch, else_value, sizeof(else_value))) return false;
+        } else {
+            snprintf(else_value, sizeof(else_value), "%s", llvm_zero_literal(llvm_expr_type(emitter->semantics, expr)));
+        }
+        snprintf(else_block, sizeof(else_block), "%s", emitter->block);
+        llvm_emitf(emitter, "  br label %%%s\n", end_label);
+
+        llvm_begin_block(emitter, end_label);
+        const char *result_type = llvm_expr_type(emitter->semantics, expr);
+        if (strcmp(result_type, "void") == 0) {
+            snprintf(value_buffer, value_buffer_size, "0");
+            return true;
+        }
+        llvm_new_temp(emitter, value_buffer, value_buffer_size);
+        llvm_emitf(emitter,
+                   "  %s = phi %s [ %s, %%%s ], [ %s, %%%s ]\n",
+                   value_buffer,
+                   result_type,
+                   then_value,
+                   then_block,
+                   else_value,
+                   else_block);
+        return true;
+    }
+    case NOVA_IR_EXPR_WHILE:
+        return emit_statement_llvm(emitter, expr);
+    case NOVA_IR_EXPR_MATCH:
+        return emit_match_llvm(emitter, expr, NULL, value_buffer, value_buffer_size);
+    case NOVA_IR_EXPR_CONSTRUCT:
+        return emit_construct_llvm(emitter, expr, value_buffer, value_buffer_size);
+    case NOVA_IR_EXPR_OPERATOR:
+        return emit_operator_llvm(emitter, expr, value_buffer, value_buffer_size);
+    case NOVA_IR_EXPR_STRING: {
+        size_t length = 0;
+        char *bytes = decode_string_literal(expr, &length);
+        if (!bytes) return false;
+        llvm_new_temp(emitter, value_buffer, value_buffer_size);
+        if (length <= NOVA_STRING_INLINE_MAX) {
+            llvm_emitf(emitter, "  %s = inttoptr i64 %llu to ptr\n", value_buffer, (unsigned long long)string_inline_word(bytes, length));
+        } else {
+            llvm_emitf(emitter,
+                       "  %s = getelementptr inbounds %%nova.strings, ptr @nova.strings, i32 0, i32 %zu\n",
+                       value_buffer,
+                       emitter->string_fields[expr->as.string_value.index]);
+        }
+        free(bytes);
+        return true;
+    }
+    case NOVA_IR_EXPR_LIST:
+        return emit_list_literal_llvm(emitter, expr, value_buffer, value_buffer_size);
+    default:
+        return false;
+    }
+}
+
+static bool emit_function_llvm(LLVMEmitter *emitter, const NovaIRFunction *fn) {
+    const char *ret_type = type_to_llvm(emitter->semantics, fn->return_type);
+    const FunctionTraits *traits = &emitter->traits[fn - emitter->program->functions];
+    llvm_emitf(emitter, "define %s%s%s @%.*s(", traits->local ? "internal " : "", traits->local ? "fastcc " : "", ret_type, (int)fn->name.length, fn->name.lexeme);
+    for (size_t p = 0; p < fn->param_count; ++p) {
+        if (p > 0) fputs(", ", emitter->out);
+        llvm_emitf(emitter, "%s %%%.*s", type_to_llvm(emitter->semantics, fn->params[p].type), (int)fn->params[p].name.length, fn->params[p].name.lexeme);
+    }
+    // Nova has no exceptions, and a miss or a trap aborts.
+    fprintf(emitter->out, ") nounwind%s%s {\n", traits->readnone ? " readnone" : "", traits->willreturn ? " willreturn" : "");
+    emitter->function = fn;
+    emitter->binding_count = 0;
+    emitter->ok = true;
+    llvm_begin_block(emitter, "entry");
+    NovaIRExpr *body = fn->body;
+    llvm_declare_slots(&body, emitter);
+    bool ok = emitter->ok && emit_tail_llvm(emitter, fn->body, ret_type);
+    fputs("}\n\n", emitter->out);
+    emitter->binding_count = 0;
+    return ok;
+}
+
+static bool emit_program_llvm(const NovaIRProgram *program, const NovaSemanticContext *semantics, FILE *out, char *error_buffer, size_t error_buffer_size) {
+    LLVMEmitter emitter{};
+    emitter.out = out;
+    emitter.semantics = semantics;
+    emitter.program = program;
+    NovaIRCallGraph graph;
+    if (!nova_ir_call_graph_build(program, &graph)) {
+        if (error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "out of memory building call graph");
+        return false;
+    }
+    FunctionTraits *traits = function_traits(program, semantics, &graph, NULL);
+    nova_ir_call_graph_free(&graph);
+    if (!traits) {
+        if (error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "out of memory");
+        return false;
+    }
+    emitter.traits = traits;
+    fputs("target triple = \"x86_64-unknown-linux-gnu\"\n\n", out);
+    fputs("declare void @abort()\n", out);
+    fputs("declare i1 @llvm.expect.i1(i1, i1)\n", out);
+    // libnovart, linked into every executable; see include/nova/runtime.h.
+    fputs("declare void @nova_rt_init(ptr)\n"
+          "declare void @nova_rt_shutdown()\n"
+          "declare ptr @nova_rt_alloc(i64, ptr)\n"
+          "declare void @nova_rt_mark(ptr, ptr)\n"
+          "declare void @nova_rt_trace_ref(ptr, ptr)\n"
+          "declare ptr @nova_list_new(i64, ptr, i64, ptr)\n"
+          "declare i64 @nova_list_length(ptr) readonly nounwind\n"
+          "declare ptr @nova_list_at(ptr, i64) readonly nounwind\n"
+          "declare ptr @nova_list_push(ptr, i64, ptr, ptr)\n"
+          "declare ptr @nova_map_new()\n"
+          "declare i64 @nova_map_length(ptr) readonly nounwind\n"
+          "declare ptr @nova_map_find(ptr, i64) readonly nounwind\n"
+          "declare ptr @nova_map_at(ptr, i64) readonly nounwind\n"
+          "declare ptr @nova_map_put(ptr, i32, i64, ptr, i64, ptr)\n"
+          "declare ptr @nova_map_remove(ptr, i64)\n"
+          "declare ptr @nova_map_from_lists(i32, i64, ptr, ptr, ptr)\n"
+          "declare i64 @nova_string_length(ptr) readonly nounwind\n"
+          "declare ptr @nova_string_concat(ptr, ptr)\n"
+          "declare i32 @nova_string_hash(ptr, i32) readonly nounwind\n"
+          "declare zeroext i1 @nova_string_equal(ptr, ptr)\n\n",
+          out);
+    emitter.string_fields = static_cast<size_t *>(calloc(program->string_count + 1, sizeof(size_t)));
+    if (!emitter.string_fields) {
+        if (error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "out of memory");
+        free(traits);
+        return false;
+    }
+    for (size_t i = 0, field = 0; i < program->string_count; ++i) {
+        emitter.string_fields[i] = program->strings[i].length > NOVA_STRING_INLINE_MAX ? field++ : SIZE_MAX;
+    }
+    emit_string_table_type_llvm(&emitter);
+    size_t layout_count = 0;
+    const NovaTypeLayout **layouts = program_layouts(program, semantics, &layout_count);
+    if (!layouts) {
+        if (error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "out of memory");
+        free(emitter.string_fields);
+        free(traits);
+        return false;
+    }
+    if (layout_count > 0) {
+        // A Number stored where its niche encodes other variants must not
+        // carry a niche pattern.
+        fprintf(out,
+                "define private double @nova.f64.clear_niche(double %%value) alwaysinline {\n"
+                "  %%bits = bitcast double %%value to i64\n"
+                "  %%high = lshr i64 %%bits, 32\n"
+                "  %%niche = icmp eq i64 %%high, %llu\n"
+                "  %%clean = select i1 %%niche, double 0x%016llX, double %%value\n"
+                "  ret double %%clean\n"
+                "}\n\n",
+                (unsigned long long)(NOVA_LAYOUT_F64_NICHE >> 32),
+                (unsigned long long)NOVA_LAYOUT_F64_QUIET_NAN);
+    }
+    for (size_t i = 0; i < layout_count; ++i) {
+        if ((layouts[i]->kind == NOVA_LAYOUT_TAGGED || layouts[i]->kind == NOVA_LAYOUT_STRUCT)) {
+            emit_type_layout_llvm(&emitter, nova_semantic_type_record(semantics, layouts[i]->type), layouts[i]);
+        }
+        if (type_is_traced(semantics, layouts[i]->type)) emit_trace_function_llvm(out, semantics, layouts[i]);
+    }
+    free(layouts);
+    bool *closures = closure_functions(program);
+    if (!closures) {
+        if (error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "out of memory");
+        free(emitter.string_fields);
+        free(traits);
+        return false;
+    }
+    for (size_t i = 0; i < program->function_count; ++i) {
+        if (closures[i]) emit_closure_entry_llvm(&emitter, &program->functions[i]);
+    }
+    free(closures);
+    for (size_t i = 0; i < program->function_count; ++i) {
+        if (!emit_function_llvm(&emitter, &program->functions[i])) {
+            if (error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "unsupported LLVM expression");
+            free(emitter.bindings);
+            free(emitter.globals);
+            free(emitter.string_fields);
+            free(traits);
+            return false;
+        }
+    }
+    emit_string_table_llvm(&emitter);
+    if (emitter.globals_length > 0) fputs(emitter.globals, out);
+    free(emitter.bindings);
+    free(emitter.globals);
+    free(emitter.string_fields);
+    free(traits);
+    return true;
+}
+
+// NOVA_PGO_GENERATE names the directory an instrumented build writes its
+// profiles to, NOVA_PGO_USE the one a build reads them back from; see
+// nova/profile.h. NULL when unset.
+static const char *profile_generate_directory(void) {
+    const char *directory = getenv("NOVA_PGO_GENERATE");
+    return directory && directory[0] != '\0' ? directory : NULL;
+}
+
+static const char *profile_use_directory(void) {
+    const char *directory = getenv("NOVA_PGO_USE");
+    return directory && directory[0] != '\0' ? directory : NULL;
+}
+
+// NOVA_TARGET_CPU is the -march the compiler builds for ("native" for the
+// build machine); NULL leaves the compiler's default, generic x86-64.
+static const char *target_cpu(void) {
+    const char *cpu = getenv("NOVA_TARGET_CPU");
+    return cpu && cpu[0] != '\0' ? cpu : NULL;
+}
+
+// With NOVA_MULTIVERSION set, the C backend compiles loop-heavy functions
+// once per vector ISA level and picks a clone at load time from CPUID, so
+// one executable runs at full speed on AVX2 and on AVX-512 machines.
+#define NOVA_TARGET_CLONES "\"arch=x86-64-v4\", \"arch=x86-64-v3\", \"default\""
+
+static bool multiversion_enabled(void) {
+    const char *multiversion = getenv("NOVA_MULTIVERSION");
+    return multiversion && multiversion[0] != '\0' && strcmp(multiversion, "0") != 0;
+}
+
+static bool emit_expr(FILE *out, const NovaSemanticContext *semantics, const NovaIRExpr *expr);
+
+// Instrumented builds count which way each branch goes; in other builds a
+// profile's hint becomes __builtin_expect.
+static bool emit_condition(FILE *out, const NovaSemanticContext *semantics, const NovaIRExpr *expr) {
+    const NovaIRExpr *condition = expr->as.if_expr.condition;
+    if (profile_generate_directory() && expr->as.if_expr.site > 0) {
+        fprintf(out, "nova_profile_branch(%zu, ", expr->as.if_expr.site - 1);
+        if (!emit_expr(out, semantics, condition)) return false;
+        fputc(')', out);
+        return true;
+    }
+    if (expr->as.if_expr.hint == NOVA_IR_BRANCH_UNKNOWN) return emit_expr(out, semantics, condition);
+    fputs("__builtin_expect(", out);
+    if (!emit_expr(out, semantics, condition)) return false;
+    fputs(expr->as.if_expr.hint == NOVA_IR_BRANCH_LIKELY ? ", 1)" : ", 0)", out);
+    return true;
+}
+
+static bool emit_let_binding(FILE *out, const NovaSemanticContext *semantics, const NovaIRExpr *expr) {
+    const NovaIRExpr *value = expr->as.let_expr.value;
+    const char *value_type = type_to_c(semantics, value ? value->type : expr->type);
+    if (strcmp(value_type, "void") != 0) {
+        fprintf(out, "%s ", value_type);
+        emit_token(out, expr->as.let_expr.name);
+        fputs(" = ", out);
+    }
+    if (!emit_expr(out, semantics, value)) return false;
+    fputc(';', out);
+    return true;
+}
+
+static bool emit_statement(FILE *out, const NovaSemanticContext *semantics, const NovaIRExpr *expr, int indent);
+
+static const char *field_type_to_c(const NovaSemanticContext *semantics, NovaTypeId type) {
+    const char *name = type_to_c(semantics, type);
+    return strcmp(name, "void") == 0 ? "char" : name;
+}
+
+static void emit_variant_name(FILE *out, const NovaTypeRecord *record, size_t tag) {
+    fputs("nova_", out);
+    emit_token(out, record->decl->name);
+    fputc('_', out);
+    emit_token(out, record->variants[tag].variant->name);
+}
+
+static void emit_type_prefix(FILE *out, const NovaTypeRecord *record) {
+    fputs("nova_", out);
+    emit_token(out, record->decl->name);
+}
+
+static const char *layout_field_c_type(const NovaSemanticContext *semantics, const NovaFieldLayout *field) {
+    return field->boxed ? "const void *" : field_type_to_c(semantics, field->type);
+}
+
+// The bit pattern a niche layout compares against its spare values.
+static void emit_niche_code_c(FILE *out, const NovaTypeLayout *layout, const char *value) {
+    switch (layout->repr.kind) {
+    case NOVA_REPR_F64:
+        fprintf(out, "nova_f64_bits(%s)", value);
+        break;
+    case NOVA_REPR_PTR:
+        fprintf(out, "(uint64_t)(uintptr_t)%s", value);
+        break;
+    case NOVA_REPR_STRUCT:
+        fprintf(out, "(uint64_t)%s.tag", value);
+        break;
+    case NOVA_REPR_BOOL:
+    case NOVA_REPR_INT:
+    default:
+        fprintf(out, "(uint64_t)%s", value);
+        break;
+    }
+}
+
+// Marks what a field refers to; lvalue reads the field, as const void *
+// when it is boxed.
+static void emit_trace_field_c(FILE *out, const NovaSemanticContext *semantics, NovaTypeId type, bool boxed, const char *lvalue, int indent) {
+    const NovaTypeRecord *record = nova_semantic_type_record(semantics, type);
+    if (!boxed && !type_is_traced(semantics, type)) return;
+    emit_indent(out, indent);
+    if (boxed || !record || !record->layout) {
+        fprintf(out, "nova_rt_mark(gc, %s);\n", lvalue);
+        return;
+    }
+    emit_type_prefix(out, record);
+    fprintf(out, "__trace(gc, (void *)&%s);\n", lvalue);
+}
+
+static void emit_trace_name_c(FILE *out, const NovaSemanticContext *semantics, NovaTypeId type) {
+    const NovaTypeRecord *record = nova_semantic_type_record(semantics, type);
+    if (!type_is_traced(semantics, type)) {
+        fputs("NULL", out);
+        return;
+    }
+    if (!record) {
+        fputs("nova_rt_trace_ref", out);
+        return;
+    }
+    emit_type_prefix(out, record);
+    fputs("__trace", out);
+}
+
+static void emit_constructor_c(FILE *out, const NovaSemanticContext *semantics, const NovaTypeRecord *record, const NovaTypeLayout *layout, size_t tag) {
+    const NovaVariantLayout *variant = &layout->variants[tag];
+    fprintf(out, "static inline %s ", layout->c_type);
+    emit_variant_name(out, record, tag);
+    fputc('(', out);
+    if (variant->field_count == 0) fputs("void", out);
+    for (size_t f = 0; f < variant->field_count; ++f) {
+        fprintf(out, "%s%s f%zu", f > 0 ? ", " : "", field_type_to_c(semantics, variant->fields[f].type), f);
+    }
+    fputs(") {\n", out);
+    if (layout->kind == NOVA_LAYOUT_ENUM) {
+        fprintf(out, "    return %zu;\n", tag);
+    } else if (layout->kind == NOVA_LAYOUT_NICHE && tag == layout->dataful) {
+        const NovaTypeInfo *info = nova_semantic_type_info(semantics, variant->fields[0].type);
+        if (variant->fields[0].boxed) {
+            fputs("    return nova_box(&f0, sizeof f0, ", out);
+            emit_trace_name_c(out, semantics, variant->fields[0].type);
+            fputs(");\n", out);
+        } else if (info && info->kind == NOVA_TYPE_KIND_NUMBER) {
+            fputs("    return nova_f64_clear_niche(f0);\n", out);
+        } else {
+            fputs("    return f0;\n", out);
+        }
+    } else if (layout->kind == NOVA_LAYOUT_NICHE) {
+        unsigned long long code = (unsigned long long)variant->niche_code;
+        switch (layout->repr.kind) {
+        case NOVA_REPR_F64:
+            fprintf(out, "    return nova_f64_from_bits(0x%llxull);\n", code);
+            break;
+        case NOVA_REPR_PTR:
+            fprintf(out, "    return (%s)(uintptr_t)%lluu;\n", layout->c_type, code);
+            break;
+        case NOVA_REPR_STRUCT:
+            fprintf(out, "    %s value;\n    memset(&value, 0, sizeof value);\n    value.tag = %lluu;\n    return value;\n", layout->c_type, code);
+            break;
+        case NOVA_REPR_BOOL:
+        case NOVA_REPR_INT:
+        default:
+            fprintf(out, "    return (%s)%lluu;\n", layout->c_type, code);
+            break;
+        }
+    } else if (layout->kind == NOVA_LAYOUT_STRUCT) {
+        fprintf(out, "    %s value;\n", layout->c_type);
+        for (size_t f = 0; f < variant->field_count; ++f) {
+            if (variant->fields[f].boxed) {
+                fprintf(out, "    value.f%zu = nova_box(&f%zu, sizeof f%zu, ", f, f, f);
+                emit_trace_name_c(out, semantics, variant->fields[f].type);
+                fputs(");\n", out);
+            } else {
+                fprintf(out, "    value.f%zu = f%zu;\n", f, f);
+            }
+        }
+        fputs("    return value;\n", out);
+    } else {
+        fprintf(out, "    %s value;\n    memset(&value, 0, sizeof value);\n    value.tag = %zu;\n", layout->c_type, tag);
+        for (size_t f = 0; f < variant->field_count; ++f) {
+            if (variant->fields[f].boxed) {
+                fprintf(out, "    value.as.v%zu.f%zu = nova_box(&f%zu, sizeof f%zu, ", tag, f, f, f);
+                emit_trace_name_c(out, semantics, variant->fields[f].type);
+                fputs(");\n", out);
+            } else {
+                fprintf(out, "    value.as.v%zu.f%zu = f%zu;\n", tag, f, f);
+            }
+        }
+        fputs("    return value;\n", out);
+    }
+    fputs("}\n", out);
+}
+
+// The trace function of a sum type marks the references held by the
+// variant the tag selects; it also serves as the trace of its boxes.
+static void emit_trace_function_c(FILE *out, const NovaSemanticContext *semantics, const NovaTypeRecord *record, const NovaTypeLayout *layout) {
+    char lvalue[64];
+    fputs("static void ", out);
+    emit_type_prefix(out, record);
+    fprintf(out, "__trace(void *gc, void *payload) {\n    %s const *value = payload;\n", layout->c_type);
+    if (layout->kind == NOVA_LAYOUT_NICHE) {
+        const NovaFieldLayout *field = &layout->variants[layout->dataful].fields[0];
+        emit_trace_field_c(out, semantics, field->type, field->boxed, "*value", 1);
+    } else if (layout->kind == NOVA_LAYOUT_STRUCT) {
+        for (size_t f = 0; f < layout->variants[0].field_count; ++f) {
+            const NovaFieldLayout *field = &layout->variants[0].fields[f];
+            snprintf(lvalue, sizeof(lvalue), "value->f%zu", f);
+            emit_trace_field_c(out, semantics, field->type, field->boxed, lvalue, 1);
+        }
+    } else {
+        fputs("    switch (value->tag) {\n", out);
+        for (size_t v = 0; v < layout->variant_count; ++v) {
+            const NovaVariantLayout *variant = &layout->variants[v];
+            if (!variant_is_traced(semantics, variant)) continue;
+            fprintf(out, "    case %zu:\n", v);
+            for (size_t f = 0; f < variant->field_count; ++f) {
+                snprintf(lvalue, sizeof(lvalue), "value->as.v%zu.f%zu", v, f);
+                emit_trace_field_c(out, semantics, variant->fields[f].type, variant->fields[f].boxed, lvalue, 2);
+            }
+            fputs("        break;\n", out);
+        }
+        fputs("    default:\n        break;\n    }\n", out);
+    }
+    fputs("}\n", out);
+}
+
+// Every variant gets an inline constructor and every type a tag reader, so
+// matches and constructions never depend on the layout that was chosen.
+static void emit_layout_functions_c(FILE *out, const NovaSemanticContext *semantics, const NovaTypeRecord *record, const NovaTypeLayout *layout) {
+    if (type_is_traced(semantics, layout->type)) emit_trace_function_c(out, semantics, record, layout);
+    for (size_t v = 0; v < layout->variant_count; ++v) {
+        emit_constructor_c(out, semantics, record, layout, v);
+    }
+    fputs("static inline uint32_t ", out);
+    emit_type_prefix(out, record);
+    fprintf(out, "__tag(%s value) {\n", layout->c_type);
+    size_t spare = layout->variant_count > 0 ? layout->variant_count - 1 : 0;
+    if (layout->kind == NOVA_LAYOUT_ENUM) {
+        fputs("    return value;\n", out);
+    } else if (layout->kind == NOVA_LAYOUT_TAGGED) {
+        fputs("    return value.tag;\n", out);
+    } else if (layout->kind == NOVA_LAYOUT_STRUCT) {
+        fputs("    (void)value;\n    return 0;\n", out);
+    } else if (spare == 0) {
+        fprintf(out, "    (void)value;\n    return %zu;\n", layout->dataful);
+    } else {
+        fputs("    uint64_t code = ", out);
+        emit_niche_code_c(out, layout, "value");
+        fprintf(out, " - 0x%llxull;\n", (unsigned long long)(layout->repr.niche_start - spare));
+        // Spare values name the payload-free variants in order, skipping the dataful tag.
+        fprintf(out, "    return code < %zuu ? ", spare);
+        if (layout->dataful == 0) {
+            fputs("(uint32_t)code + 1", out);
+        } else if (layout->dataful >= spare) {
+            fputs("(uint32_t)code", out);
+        } else {
+            fprintf(out, "(uint32_t)(code < %zuu ? code : code + 1)", layout->dataful);
+        }
+        fprintf(out, " : %zuu;\n", layout->dataful);
+    }
+    fputs("}\n\n", out);
+}
+
+static void emit_struct_c(FILE *out, const NovaSemanticContext *semantics, const NovaTypeLayout *layout) {
+    fprintf(out, "struct %s {\n", layout->c_type);
+    if (layout->kind == NOVA_LAYOUT_STRUCT) {
+        const NovaVariantLayout *variant = &layout->variants[0];
+        for (size_t f = 0; f < variant->field_count; ++f) {
+            fprintf(out, "    %s f%zu;\n", layout_field_c_type(semantics, &variant->fields[f]), f);
+        }
+        fputs("};\n", out);
+        return;
+    }
+    if (layout->tag_size > 0) {
+        fprintf(out, "    %s tag;\n", layout->tag_size == 1 ? "uint8_t" : layout->tag_size == 2 ? "uint16_t" : "uint32_t");
+    }
+    fputs("    union {\n", out);
+    for (size_t v = 0; v < layout->variant_count; ++v) {
+        const NovaVariantLayout *variant = &layout->variants[v];
+        if (variant->field_count == 0) continue;
+        fputs("        struct {", out);
+        for (size_t f = 0; f < variant->field_count; ++f) {
+            fprintf(out, " %s f%zu;", layout_field_c_type(semantics, &variant->fields[f]), f);
+        }
+        fprintf(out, " } v%zu;\n", v);
+    }
+    fputs("    } as;\n};\n", out);
+}
+
+static bool emit_type_layouts_c(FILE *out, const NovaIRProgram *program, const NovaSemanticContext *semantics) {
+    size_t count = 0;
+    const NovaTypeLayout **layouts = program_layouts(program, semantics, &count);
+    if (!layouts) return false;
+    for (size_t i = 0; i < count; ++i) {
+        if ((layouts[i]->kind == NOVA_LAYOUT_TAGGED || layouts[i]->kind == NOVA_LAYOUT_STRUCT)) fprintf(out, "typedef struct %s %s;\n", layouts[i]->c_type, layouts[i]->c_type);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if ((layouts[i]->kind == NOVA_LAYOUT_TAGGED || layouts[i]->kind == NOVA_LAYOUT_STRUCT)) emit_struct_c(out, semantics, layouts[i]);
+    }
+    if (count > 0) fputc('\n', out);
+    // Boxes of a type may be built before its trace function is defined.
+    for (size_t i = 0; i < count; ++i) {
+        if (!type_is_traced(semantics, layouts[i]->type)) continue;
+        fputs("static void ", out);
+        emit_type_prefix(out, nova_semantic_type_record(semantics, layouts[i]->type));
+        fputs("__trace(void *gc, void *payload);\n", out);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        emit_layout_functions_c(out, semantics, nova_semantic_type_record(semantics, layouts[i]->type), layouts[i]);
+    }
+    free(layouts);
+    return true;
+}
+
+// Reads payload field index of variant tag out of nova_subject.
+static void emit_field_read_c(FILE *out, const NovaSemanticContext *semantics, const NovaTypeLayout *layout, size_t tag, size_t index) {
+    const NovaFieldLayout *field = &layout->variants[tag].fields[index];
+    const NovaTypeInfo *info = nova_semantic_type_info(semantics, field->type);
+    if (field->boxed) fprintf(out, "*(const %s *)", field_type_to_c(semantics, field->type));
+    if (layout->kind == NOVA_LAYOUT_TAGGED) {
+        fprintf(out, "nova_subject.as.v%zu.f%zu", tag, index);
+    } else if (layout->kind == NOVA_LAYOUT_STRUCT) {
+        fprintf(out, "nova_subject.f%zu", index);
+    } else if (!field->boxed && info && info->kind == NOVA_TYPE_KIND_BOOL) {
+        fputs("(nova_subject != 0)", out);
+    } else {
+        fputs("nova_subject", out);
+    }
+}
+
+typedef enum {
+    MATCH_EMIT_VALUE, // stores the arm's value into nova_match_result
+    MATCH_EMIT_STATEMENT,
+    MATCH_EMIT_RETURN,
+} MatchEmitMode;
+
+static bool emit_return(FILE *out, const NovaSemanticContext *semantics, const NovaIRExpr *expr, int indent);
+
+static bool emit_match_arm_body(FILE *out, const NovaSemanticContext *semantics, const NovaIRExpr *match, const NovaIRExpr *body, MatchEmitMode mode, int indent) {
+    if (mode == MATCH_EMIT_RETURN) {
+        return emit_return(out, semantics, body, indent);
+    }
+    if (mode == MATCH_EMIT_STATEMENT || strcmp(type_to_c(semantics, match->type), "void") == 0) {
+        if (!emit_statement(out, semantics, body, indent)) return false;
+        fputc('\n', out);
+    } else {
+        emit_indent(out, indent);
+        fputs("nova_match_result = ", out);
+        if (!emit_expr(out, semantics, body)) return false;
+        fputs(";\n", out);
+    }
+    emit_indent(out, indent);
+    fputs("break;\n", out);
+    return true;
+}
+
+static void emit_c_string(FILE *out, const char *bytes, size_t length) {
+    fputc('"', out);
+    for (size_t i = 0; i < length; ++i) {
+        unsigned char c = (unsigned char)bytes[i];
+        if (c == '"' || c == '\\') {
+            fprintf(out, "\\%c", c);
+        } else if (c < 0x20 || c >= 0x7f) {
+            fprintf(out, "\\%03o", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static bool emit_string_literal_c(FILE *out, const NovaIRExpr *expr) {
+    size_t length = 0;
+    char *bytes = decode_string_literal(expr, &length);
+    if (!bytes) return false;
+    if (length <= NOVA_STRING_INLINE_MAX) {
+        fprintf(out, "((const void *)(uintptr_t)0x%llxull)", (unsigned long long)string_inline_word(bytes, length));
+    } else {
+        fprintf(out, "((const void *)&nova_strings.s%zu)", expr->as.string_value.index);
+    }
+    free(bytes);
+    return true;
+}
+
+// Literals too long to be inline words share one read-only table of
+// NovaString headers, each followed by its bytes; fields are named after
+// their index in the program's strings.
+static void emit_string_table_c(FILE *out, const NovaIRProgram *program) {
+    bool any = false;
+    for (size_t i = 0; i < program->string_count; ++i) {
+        size_t length = program->strings[i].length;
+        if (length <= NOVA_STRING_INLINE_MAX) continue;
+        if (!any) fputs("static const struct {\n", out);
+        any = true;
+        fprintf(out, "    struct { uint64_t length; uint32_t kind; uint32_t depth; char bytes[%zu]; } s%zu;\n", length + 1, i);
+    }
+    if (!any) return;
+    fputs("} nova_strings = {\n", out);
+    for (size_t i = 0; i < program->string_count; ++i) {
+        const NovaIRString *entry = &program->strings[i];
+        if (entry->length <= NOVA_STRING_INLINE_MAX) continue;
+        fprintf(out, "    {%zu, %d, 0, ", entry->length, NOVA_STRING_FLAT);
+        emit_c_string(out, entry->bytes, entry->length);
+        fputs("},\n", out);
+    }
+    fputs("};\n\n", out);
+}
+
+// Literal arms are numbered in order and the switch runs on that number:
+// numbers and booleans compare in turn, strings go through a perfect hash
+// and a single comparison.
+static bool emit_match_literal_switch(FILE *out, const NovaSemanticContext *semantics, const NovaIRExpr *expr, MatchEmitMode mode, int indent) {
+    const NovaIRExpr *scrutinee = expr->as.match_expr.scrutinee;
+    NovaTypeKind kind = nova_semantic_type_info(semantics, scrutinee->type)->kind;
+    size_t arm_count = expr->as.match_expr.arm_count;
+    const NovaIRMatchArm **arms = static_cast<const NovaIRMatchArm **>(calloc(arm_count + 1, sizeof(*arms)));
+    if (!arms) return false;
+    size_t case_count = 0;
+    const NovaIRMatchArm *fallback = NULL;
+    for (size_t i = 0; i < arm_count; ++i) {
+        const NovaIRMatchArm *arm = &expr->as.match_expr.arms[i];
+        if (!arm->literal) {
+            fallback = arm;
+            break;
+        }
+        arms[case_count++] = arm;
+    }
+    bool ok = true;
+    emit_indent(out, indent);
+    fputs("{\n", out);
+    emit_indent(out, indent + 1);
+    fprintf(out, "%s nova_subject = ", type_to_c(semantics, scrutinee->type));
+    ok = emit_expr(out, semantics, scrutinee);
+    fputs(";\n", out);
+    emit_indent(out, indent + 1);
+    if (case_count > 0 && kind == NOVA_TYPE_KIND_STRING) {
+        StringDispatch dispatch;
+        ok = ok && string_dispatch_build(arms, case_count, &dispatch);
+        if (ok) {
+            fputs("static const void *const nova_keys[] = {", out);
+            for (size_t i = 0; ok && i < dispatch.count; ++i) {
+                if (i > 0) fputs(", ", out);
+                ok = emit_string_literal_c(out, arms[i]->literal);
+            }
+            fputs("};\n", out);
+            emit_indent(out, indent + 1);
+            fputs("static const uint32_t nova_displacements[] = {", out);
+            for (size_t i = 0; i < dispatch.hash.bucket_count; ++i) {
+                fprintf(out, "%s%uu", i > 0 ? ", " : "", dispatch.hash.displacements[i]);
+            }
+            fputs("};\n", out);
+            emit_indent(out, indent + 1);
+            fputs("static const uint32_t nova_slots[] = {", out);
+            for (size_t i = 0; i < dispatch.hash.slot_count; ++i) {
+                fprintf(out, "%s%u", i > 0 ? ", " : "", dispatch.hash.slots[i]);
+            }
+            fputs("};\n", out);
+            emit_indent(out, indent + 1);
+            fprintf(out, "uint32_t nova_hash = nova_string_hash(nova_subject, %uu);\n", dispatch.hash.seed);
+            emit_indent(out, indent + 1);
+            fprintf(out, "int nova_case = (int)nova_slots[nova_hash_mix(nova_hash ^ nova_displacements[nova_hash & %zuu]) & %zuu];\n",
+                    dispatch.hash.bucket_count - 1, dispatch.hash.slot_count - 1);
+            emit_indent(out, indent + 1);
+            fputs("if (!nova_string_equal(nova_subject, nova_keys[nova_case])) nova_case = -1;\n", out);
+            string_dispatch_free(&dispatch);
+        }
+    } else {
+        fputs("int nova_case =", out);
+        for (size_t i = 0; i < case_count; ++i) {
+            if (kind == NOVA_TYPE_KIND_NUMBER) {
+                char number[NOVA_NUMBER_BUFFER_SIZE];
+                format_number_c(arms[i]->literal->as.number_value, number, sizeof(number));
+                fprintf(out, " nova_subject == %s ?", number);
+            } else if (kind == NOVA_TYPE_KIND_INT) {
+                fputs(" nova_subject == ", out);
+                emit_int_literal_c(out, arms[i]->literal->as.int_value);
+                fputs(" ?", out);
+            } else {
+                fprintf(out, " nova_subject == %s ?", arms[i]->literal->as.bool_value ? "true" : "false");
+            }
+            fprintf(out, " %zu :", i);
+        }
+        fputs(" -1;\n", out);
+    }
+    emit_indent(out, indent + 1);
+    fputs("switch (nova_case) {\n", out);
+    for (size_t i = 0; ok && i < case_count; ++i) {
+        emit_indent(out, indent + 1);
+        fprintf(out, "case %zu: {\n", i);
+        ok = emit_match_arm_body(out, semantics, expr, arms[i]->body, mode, indent + 2);
+        emit_indent(out, indent + 1);
+        fputs("}\n", out);
+    }
+    emit_indent(out, indent + 1);
+    if (ok && fallback) {
+        fputs("default: {\n", out);
+        ok = emit_match_arm_body(out, semantics, expr, fallback->body, mode, indent + 2);
+        emit_indent(out, indent + 1);
+        fputs("}\n", out);
+    } else if (kind == NOVA_TYPE_KIND_BOOL && case_count == 2) {
+        fputs("default:\n", out);
+        emit_indent(out, indent + 2);
+        fputs("__builtin_unreachable();\n", out);
+    } else {
+        fputs("default:\n", out);
+        emit_indent(out, indent + 2);
+        fputs("abort();\n", out);
+    }
+    emit_indent(out, indent + 1);
+    fputs("}\n", out);
+    emit_indent(out, indent);
+    fputs("}", out);
+    free(arms);
+    return ok;
+}
+
+// Tags are dense variant indices, so the switch compiles to a jump table;
+// the type's tag reader hides whether the tag is stored or read off a niche.
+static bool emit_match_switch(FILE *out, const NovaSemanticContext *semantics, const NovaIRExpr *expr, MatchEmitMode mode, int indent) {
+    if (!expr->as.match_expr.scrutinee) return false;
+    const NovaTypeRecord *record = nova_semantic_type_record(semantics, expr->as.match_expr.scrutinee->type);
+    if (!record && is_literal_match_type(semantics, expr->as.match_expr.scrutinee->type)) {
+        return emit_match_literal_switch(out, semantics, expr, mode, indent);
+    }
+    const NovaTypeLayout *layout = record ? record->layout : NULL;
+    if (!layout || record->variant_count == 0) return false;
+    bool *seen = static_cast<bool *>(calloc(record->variant_count, sizeof(bool)));
+    if (!seen) return false;
+    bool ok = true;
+    emit_indent(out, indent);
+    fputs("{\n", out);
+    emit_indent(out, indent + 1);
+    fprintf(out, "%s nova_subject = ", layout->c_type);
+    ok = emit_expr(out, semantics, expr->as.match_expr.scrutinee);
+    fputs(";\n", out);
+    emit_indent(out, indent + 1);
+    fputs("switch (", out);
+    emit_type_prefix(out, record);
+    fputs("__tag(nova_subject)) {\n", out);
+    size_t covered = 0;
+    const NovaIRMatchArm *fallback = NULL;
+    for (size_t i = 0; ok && i < expr->as.match_expr.arm_count && !fallback; ++i) {
+        const NovaIRMatchArm *arm = &expr->as.match_expr.arms[i];
+        if (arm->tag == SIZE_MAX) {
+            fallback = arm;
+            break;
+        }
+        // A repeated variant can never be reached; C rejects duplicate case labels.
+        if (arm->tag >= record->variant_count || seen[arm->tag]) continue;
+        seen[arm->tag] = true;
+        covered++;
+        const NovaVariantRecord *variant = &record->variants[arm->tag];
+        emit_indent(out, indent + 1);
+        fprintf(out, "case %zu: {\n", arm->tag);
+        for (size_t b = 0; b < arm->binding_count && b < variant->arity; ++b) {
+            if (arm->bindings[b].length == 1 && arm->bindings[b].lexeme[0] == '_') continue;
+            emit_indent(out, indent + 2);
+            fprintf(out, "%s ", field_type_to_c(semantics, variant->payload_types[b]));
+            emit_token(out, arm->bindings[b]);
+            fputs(" = ", out);
+            emit_field_read_c(out, semantics, layout, arm->tag, b);
+            fputs(";\n", out);
+        }
+        ok = emit_match_arm_body(out, semantics, expr, arm->body, mode, indent + 2);
+        emit_indent(out, indent + 1);
+        fputs("}\n", out);
+    }
+    emit_indent(out, indent + 1);
+    if (ok && fallback) {
+        fputs("default: {\n", out);
+        ok = emit_match_arm_body(out, semantics, expr, fallback->body, mode, indent + 2);
+        emit_indent(out, indent + 1);
+        fputs("}\n", out);
+    } else if (covered == record->variant_count) {
+        fputs("default:\n", out);
+        emit_indent(out, indent + 2);
+        fputs("__builtin_unreachable();\n", out);
+    } else {
+        // Matches that may be non-exhaustive only warn, so a miss stops the program.
+        fputs("default:\n", out);
+        emit_indent(out, indent + 2);
+        fputs("abort();\n", out);
+    }
+    emit_indent(out, indent + 1);
+    fputs("}\n", out);
+    emit_indent(out, indent);
+    fputs("}", out);
+    free(seen);
+    return ok;
+}
+
+static bool emit_construct(FILE *out, const NovaSemanticContext *semantics, const NovaIRExpr *expr) {
+    const NovaTypeRecord *record = nova_semantic_type_record(semantics, expr->type);
+    if (!record || !record->layout || expr->as.construct.tag >= record->variant_count) return false;
+    emit_variant_name(out, record, expr->as.construct.tag);
+    fputc('(', out);
+    for (size_t i = 0; i < expr->as.construct.arg_count; ++i) {
+        if (i > 0) fputs(", ", out);
+        if (!emit_expr(out, semantics, expr->as.construct.args[i])) return false;
+    }
+    fputc(')', out);
+    return true;
+}
+
+static bool emit_statement(FILE *out, const NovaSemanticContext *semantics, const NovaIRExpr *expr, int indent) {
+    if (!expr) {
+        emit_indent(out, indent);
+        fputs(";", out);
+        return true;
+    }
+    if (expr->kind == NOVA_IR_EXPR_SEQUENCE) {
+        for (size_t i = 0; i < expr->as.sequence.count; ++i) {
+            if (!emit_statement(out, semantics, expr->as.sequence.items[i], indent)) return false;
+            if (i + 1 < expr->as.sequence.count) {
+                fputc('\n', out);
+            }
+        }
+        return true;
+    }
+    if (expr->kind == NOVA_IR_EXPR_WHILE) {
+        emit_indent(out, indent);
+        fputs("while (", out);
+        if (!emit_expr(out, semantics, expr->as.while_expr.condition)) return false;
+        fputs(") {\n", out);
+        if (!emit_statement(out, semantics, expr->as.while_expr.body, indent + 1)) return false;
+        fputc('\n', out);
+        emit_indent(out, indent);
+        fputs("}", out);
+        return true;
+    }
+    if (expr->kind == NOVA_IR_EXPR_LET) {
+        emit_indent(out, indent);
+        fputs("{\n", out);
+        emit_indent(out, indent + 1);
+        if (!emit_let_binding(out, semantics, expr)) return false;
+        fputc('\n', out);
+        if (!emit_statement(out, semantics, expr->as.let_expr.body, indent + 1)) return false;
+        fputc('\n', out);
+        emit_indent(out, indent);
+        fputs("}", out);
+        return true;
+    }
+    if (expr->kind == NOVA_IR_EXPR_MATCH) {
+        return emit_match_switch(out, semantics, expr, MATCH_EMIT_STATEMENT, indent);
+    }
+    if (expr->kind == NOVA_IR_EXPR_IF && expr->as.if_expr.condition) {
+        emit_indent(out, indent);
+        fputs("if (", out);
+        if (!emit_condition(out, semantics, expr)) return false;
+        fputs(") {\n", out);
+        if (!emit_statement(out, semantics, expr->as.if_expr.then_branch, indent + 1)) return false;
+        fputc('\n', out);
+        emit_indent(out, indent);
+        fputs("}", out);
+        if (expr->as.if_expr.else_branch) {
+            fputs(" else {\n", out);
+            if (!emit_statement(out, semantics, expr->as.if_expr.else_branch, indent + 1)) return false;
+            fputc('\n', out);
+            emit_indent(out, indent);
+            fputs("}", out);
+        }
+        return true;
     }
     emit_indent(out, indent);
     if (!emit_expr(out, semantics, expr)) return false;
@@ -324,25 +2799,185 @@ static bool emit_statement(FILE *out, const NovaSemanticContext *semantics, cons
     return true;
 }
 
+// Int arithmetic wraps, so it is done on uint64_t, where overflow is defined.
+static bool emit_int_operator_c(FILE *out, const NovaSemanticContext *semantics, const NovaIRExpr *expr) {
+    NovaOperator op = expr->as.op.op;
+    const char *call = op == NOVA_OP_DIV ? "nova_int_div(" : op == NOVA_OP_MOD ? "nova_int_rem(" : NULL;
+    if (call) {
+        fputs(call, out);
+        if (!emit_expr(out, semantics, expr->as.op.left)) return false;
+        fputs(", ", out);
+        if (!emit_expr(out, semantics, expr->as.op.right)) return false;
+        fputc(')', out);
+        return true;
+    }
+    if (op == NOVA_OP_TO_INT) return emit_expr(out, semantics, expr->as.op.left);
+    if (op == NOVA_OP_TO_NUMBER || op == NOVA_OP_NEG) {
+        fputs(op == NOVA_OP_NEG ? "(int64_t)(0 - (uint64_t)" : "(double)(", out);
+        if (!emit_expr(out, semantics, expr->as.op.left)) return false;
+        fputc(')', out);
+        return true;
+    }
+    bool wraps = op == NOVA_OP_ADD || op == NOVA_OP_SUB || op == NOVA_OP_MUL;
+    fputs(wraps ? "(int64_t)((uint64_t)" : "(", out);
+    if (!emit_expr(out, semantics, expr->as.op.left)) return false;
+    fprintf(out, wraps ? " %s (uint64_t)" : " %s ", nova_operator_lexeme(op));
+    if (!emit_expr(out, semantics, expr->as.op.right)) return false;
+    fputc(')', out);
+    return true;
+}
+
+// Elements are stored as sum fields are, so Unit elements take a byte.
+static const char *list_element_type_c(const NovaSemanticContext *semantics, NovaTypeId list) {
+    return field_type_to_c(semantics, list_element_type(semantics, list));
+}
+
+// A literal is built in one allocation of its final size.
+static bool emit_list_literal_c(FILE *out, const NovaSemanticContext *semantics, const NovaIRExpr *expr) {
+    if (expr->as.list.count == 0) {
+        fputs("((const void *)nova_list_new(0, NULL, 0, NULL))", out);
+        return true;
+    }
+    const char *element = list_element_type_c(semantics, expr->type);
+    fprintf(out, "({ %s nova_items[] = {", element);
+    for (size_t i = 0; i < expr->as.list.count; ++i) {
+        if (i > 0) fputs(", ", out);
+        if (!emit_expr(out, semantics, expr->as.list.elements[i])) return false;
+    }
+    fprintf(out, "}; (const void *)nova_list_new(sizeof(%s), ", element);
+    emit_trace_name_c(out, semantics, list_element_type(semantics, expr->type));
+    fprintf(out, ", %zu, nova_items); })", expr->as.list.count);
+    return true;
+}
+
+static bool emit_list_operator_c(FILE *out, const NovaSemanticContext *semantics, const NovaIRExpr *expr) {
+    const NovaIRExpr *list = expr->as.op.left;
+    switch (expr->as.op.op) {
+    case NOVA_OP_LIST_LENGTH:
+        fputs("nova_list_length(", out);
+        if (!emit_expr(out, semantics, list)) return false;
+        fputc(')', out);
+        return true;
+    case NOVA_OP_LIST_GET:
+        fprintf(out, "(*(const %s *)nova_list_at(", list_element_type_c(semantics, list->type));
+        if (!emit_expr(out, semantics, list)) return false;
+        fputs(", ", out);
+        if (!emit_expr(out, semantics, expr->as.op.right)) return false;
+        fputs("))", out);
+        return true;
+    case NOVA_OP_LIST_PUSH: {
+        // The result's element type: the operand may be an empty literal whose elements have no type.
+        const char *element = list_element_type_c(semantics, expr->type);
+        fprintf(out, "({ %s nova_item = ", element);
+        if (!emit_expr(out, semantics, expr->as.op.right)) return false;
+        fputs("; (const void *)nova_list_push(", out);
+        if (!emit_expr(out, semantics, list)) return false;
+        fputs(", sizeof nova_item, ", out);
+        emit_trace_name_c(out, semantics, list_element_type(semantics, expr->type));
+        fputs(", &nova_item); })", out);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+// Keys travel to the runtime as one word: an Int as itself, a String as
+// its pointer.
+static bool emit_map_key_c(FILE *out, const NovaSemanticContext *semantics, const NovaIRExpr *key) {
+    fputs(strcmp(type_to_c(semantics, key->type), "int64_t") == 0 ? "(uint64_t)(" : "(uint64_t)(uintptr_t)(", out);
+    if (!emit_expr(out, semantics, key)) return false;
+    fputc(')', out);
+    return true;
+}
+
+static bool emit_map_operator_c(FILE *out, const NovaSemanticContext *semantics, const NovaIRExpr *expr) {
+    const NovaIRExpr *map = expr->as.op.left;
+    int key_kind = map_has_string_keys(semantics, expr->type) ? 1 : 0;
+    switch (expr->as.op.op) {
+    case NOVA_OP_MAP_NEW: {
+        if (is_empty_list_literal(map) && is_empty_list_literal(expr->as.op.right)) {
+            fputs("((const void *)nova_map_new())", out);
+            return true;
+        }
+        NovaTypeId value = map_value_type(semantics, expr->type);
+        fprintf(out, "((const void *)nova_map_from_lists(%d, sizeof(%s), ", key_kind, field_type_to_c(semantics, value));
+        emit_trace_name_c(out, semantics, value);
+        fputs(", ", out);
+        if (!emit_expr(out, semantics, map)) return false;
+        fputs(", ", out);
+        if (!emit_expr(out, semantics, expr->as.op.right)) return false;
+        fputs("))", out);
+        return true;
+    }
+    case NOVA_OP_MAP_LENGTH:
+        fputs("nova_map_length(", out);
+        if (!emit_expr(out, semantics, map)) return false;
+        fputc(')', out);
+        return true;
+    case NOVA_OP_MAP_GET:
+    case NOVA_OP_MAP_HAS:
+    case NOVA_OP_MAP_REMOVE:
+        if (expr->as.op.op == NOVA_OP_MAP_GET) {
+            fprintf(out, "(*(const %s *)nova_map_at(", field_type_to_c(semantics, expr->type));
+        } else {
+            fputs(expr->as.op.op == NOVA_OP_MAP_HAS ? "(nova_map_find(" : "((const void *)nova_map_remove(", out);
+        }
+        if (!emit_expr(out, semantics, map)) return false;
+        fputs(", ", out);
+        if (!emit_map_key_c(out, semantics, expr->as.op.right)) return false;
+        fputs(expr->as.op.op == NOVA_OP_MAP_HAS ? ") != NULL)" : "))", out);
+        return true;
+    case NOVA_OP_MAP_PUT: {
+        // The result's value type: the operand may be Map(), whose values have no type.
+        NovaTypeId value = map_value_type(semantics, expr->type);
+        fprintf(out, "({ %s nova_item = ", field_type_to_c(semantics, value));
+        if (!emit_expr(out, semantics, expr->as.op.third)) return false;
+        fputs("; (const void *)nova_map_put(", out);
+        if (!emit_expr(out, semantics, map)) return false;
+        fprintf(out, ", %d, sizeof nova_item, ", key_kind);
+        emit_trace_name_c(out, semantics, value);
+        fputs(", ", out);
+        if (!emit_map_key_c(out, semantics, expr->as.op.right)) return false;
+        fputs(", &nova_item); })", out);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
 static bool emit_expr(FILE *out, const NovaSemanticContext *semantics, const NovaIRExpr *expr) {
     if (!expr) {
         fputs("0", out);
         return true;
     }
     switch (expr->kind) {
-    case NOVA_IR_EXPR_NUMBER:
-        fprintf(out, "%g", expr->as.number_value);
+    case NOVA_IR_EXPR_NUMBER: {
+        // Zero placeholders for other types (such as an unset loop result) use their own zero.
+        const char *c_type = type_to_c(semantics, expr->type);
+        if (strcmp(c_type, "double") != 0) {
+            const NovaTypeLayout *layout = nova_layout_of(semantics, expr->type);
+            if (layout && (layout->kind == NOVA_LAYOUT_TAGGED || layout->kind == NOVA_LAYOUT_STRUCT)) {
+                fprintf(out, "(%s){0}", c_type);
+            } else {
+                fputs("0", out);
+            }
+            return true;
+        }
+        char number[NOVA_NUMBER_BUFFER_SIZE];
+        format_number_c(expr->as.number_value, number, sizeof(number));
+        fputs(number, out);
+        return true;
+    }
+    case NOVA_IR_EXPR_INT:
+        emit_int_literal_c(out, expr->as.int_value);
         return true;
     case NOVA_IR_EXPR_BOOL:
         fputs(expr->as.bool_value ? "true" : "false", out);
         return true;
     case NOVA_IR_EXPR_STRING:
-        if (expr->as.string_value.text) {
-            fputs(expr->as.string_value.text, out);
-        } else {
-            fputs("\"\"", out);
-        }
-        return true;
+        return emit_string_literal_c(out, expr);
     case NOVA_IR_EXPR_UNIT:
         fputs("0", out);
         return true;
@@ -358,6 +2993,37 @@ static bool emit_expr(FILE *out, const NovaSemanticContext *semantics, const Nov
         }
         fputc(')', out);
         return true;
+    case NOVA_IR_EXPR_CLOSURE: {
+        const NovaToken *name = &expr->as.closure.function;
+        if (expr->as.closure.capture_count == 0) {
+            fprintf(out, "((const void *)&nova_closure_%.*s)", (int)name->length, name->lexeme);
+            return true;
+        }
+        fprintf(out, "({ struct nova_env_%.*s *nova_env = nova_rt_alloc(sizeof(struct nova_env_%.*s), nova_trace_%.*s); ",
+                (int)name->length, name->lexeme, (int)name->length, name->lexeme, (int)name->length, name->lexeme);
+        fprintf(out, "nova_env->code = (void (*)(void))nova_entry_%.*s; ", (int)name->length, name->lexeme);
+        for (size_t i = 0; i < expr->as.closure.capture_count; ++i) {
+            fprintf(out, "nova_env->c%zu = ", i);
+            if (!emit_expr(out, semantics, expr->as.closure.captures[i])) return false;
+            fputs("; ", out);
+        }
+        fputs("(const void *)nova_env; })", out);
+        return true;
+    }
+    case NOVA_IR_EXPR_APPLY:
+        fputs("({ const void *nova_fn = ", out);
+        if (!emit_expr(out, semantics, expr->as.apply.callee)) return false;
+        fprintf(out, "; ((%s (*)(const void *", type_to_c(semantics, expr->type));
+        for (size_t i = 0; i < expr->as.apply.arg_count; ++i) {
+            fprintf(out, ", %s", type_to_c(semantics, expr->as.apply.args[i]->type));
+        }
+        fputs("))((const nova_closure *)nova_fn)->code)(nova_fn", out);
+        for (size_t i = 0; i < expr->as.apply.arg_count; ++i) {
+            fputs(", ", out);
+            if (!emit_expr(out, semantics, expr->as.apply.args[i])) return false;
+        }
+        fputs("); })", out);
+        return true;
     case NOVA_IR_EXPR_SEQUENCE:
         if (expr->as.sequence.count == 0) {
             fputs("0", out);
@@ -386,7 +3052,7 @@ static bool emit_expr(FILE *out, const NovaSemanticContext *semantics, const Nov
             return true;
         }
         fputc('(', out);
-        if (!emit_expr(out, semantics, expr->as.if_expr.condition)) return false;
+        if (!emit_condition(out, semantics, expr)) return false;
         fputs(" ? ", out);
         if (!emit_expr(out, semantics, expr->as.if_expr.then_branch)) return false;
         fputs(" : ", out);
@@ -398,18 +3064,135 @@ static bool emit_expr(FILE *out, const NovaSemanticContext *semantics, const Nov
         fputc(')', out);
         return true;
     }
-    case NOVA_IR_EXPR_WHILE:
+    case NOVA_IR_EXPR_ASSIGN:
+        fputc('(', out);
+        emit_token(out, expr->as.assign.target);
+        fputs(" = ", out);
+        if (!emit_expr(out, semantics, expr->as.assign.value)) return false;
+        fputc(')', out);
+        return true;
+    case NOVA_IR_EXPR_LET:
+        // GNU statement expression; both gcc and clang accept it in C11 mode.
+        fputs("({ ", out);
+        if (!emit_let_binding(out, semantics, expr)) return false;
+        fputc(' ', out);
+        if (!emit_expr(out, semantics, expr->as.let_expr.body)) return false;
+        fputs("; })", out);
+        return true;
+    case NOVA_IR_EXPR_CONSTRUCT:
+        return emit_construct(out, semantics, expr);
+    case NOVA_IR_EXPR_OPERATOR:
+        if (is_string_operator(semantics, expr)) {
+            fputs(expr->as.op.op == NOVA_OP_ADD ? "nova_string_concat(" : "nova_string_length(", out);
+            if (!emit_expr(out, semantics, expr->as.op.left)) return false;
+            if (expr->as.op.op == NOVA_OP_ADD) {
+                fputs(", ", out);
+                if (!emit_expr(out, semantics, expr->as.op.right)) return false;
+            }
+            fputc(')', out);
+            return true;
+        }
+        if (is_list_operator(expr->as.op.op)) {
+            return emit_list_operator_c(out, semantics, expr);
+        }
+        if (is_map_operator(expr->as.op.op)) {
+            return emit_map_operator_c(out, semantics, expr);
+        }
+        if (strcmp(type_to_c(semantics, expr->as.op.left->type), "int64_t") == 0) {
+            return emit_int_operator_c(out, semantics, expr);
+        }
+        if (expr->as.op.op == NOVA_OP_TO_INT) {
+            fputs("nova_int_from_f64(", out);
+            if (!emit_expr(out, semantics, expr->as.op.left)) return false;
+            fputc(')', out);
+            return true;
+        }
+        if (expr->as.op.op == NOVA_OP_TO_NUMBER) return emit_expr(out, semantics, expr->as.op.left);
+        if (expr->as.op.op == NOVA_OP_MOD) {
+            fputs("fmod(", out);
+            if (!emit_expr(out, semantics, expr->as.op.left)) return false;
+            fputs(", ", out);
+            if (!emit_expr(out, semantics, expr->as.op.right)) return false;
+            fputc(')', out);
+            return true;
+        }
+        if (!expr->as.op.right) {
+            // The space keeps a negative literal operand from reading as `--`.
+            fputs(expr->as.op.op == NOVA_OP_NEG ? "(- " : "(!", out);
+            if (!emit_expr(out, semantics, expr->as.op.left)) return false;
+            fputc(')', out);
+            return true;
+        }
+        fputc('(', out);
+        if (!emit_expr(out, semantics, expr->as.op.left)) return false;
+        fprintf(out, " %s ", nova_operator_lexeme(expr->as.op.op));
+        if (!emit_expr(out, semantics, expr->as.op.right)) return false;
+        fputc(')', out);
+        return true;
+    case NOVA_IR_EXPR_MATCH: {
+        const char *result_type = type_to_c(semantics, expr->type);
+        fputs("({\n", out);
+        if (strcmp(result_type, "void") != 0) {
+            fprintf(out, "%s nova_match_result;\n", result_type);
+        }
+        if (!emit_match_switch(out, semantics, expr, MATCH_EMIT_VALUE, 0)) return false;
+        fputs(strcmp(result_type, "void") != 0 ? "\nnova_match_result; })" : "\n})", out);
+        return true;
+    }
     case NOVA_IR_EXPR_LIST:
-    case NOVA_IR_EXPR_MATCH:
+        return emit_list_literal_c(out, semantics, expr);
+    case NOVA_IR_EXPR_WHILE:
         return false;
     default:
         return false;
     }
 }
 
-static bool emit_function(FILE *out, const NovaSemanticContext *semantics, const NovaIRFunction *fn) {
-    const char *return_type = type_to_c(semantics, fn->return_type);
-    fprintf(out, "%s ", return_type);
+// Emits the body of a value-returning function as statements, so loops and
+// branches in tail position need no statement expressions.
+static bool emit_return(FILE *out, const NovaSemanticContext *semantics, const NovaIRExpr *expr, int indent) {
+    if (expr && expr->kind == NOVA_IR_EXPR_LET) {
+        emit_indent(out, indent);
+        fputs("{\n", out);
+        emit_indent(out, indent + 1);
+        if (!emit_let_binding(out, semantics, expr)) return false;
+        fputc('\n', out);
+        if (!emit_return(out, semantics, expr->as.let_expr.body, indent + 1)) return false;
+        emit_indent(out, indent);
+        fputs("}\n", out);
+        return true;
+    }
+    if (expr && expr->kind == NOVA_IR_EXPR_SEQUENCE && expr->as.sequence.count > 1) {
+        for (size_t i = 0; i + 1 < expr->as.sequence.count; ++i) {
+            if (!emit_statement(out, semantics, expr->as.sequence.items[i], indent)) return false;
+            fputc('\n', out);
+        }
+        return emit_return(out, semantics, expr->as.sequence.items[expr->as.sequence.count - 1], indent);
+    }
+    if (expr && expr->kind == NOVA_IR_EXPR_MATCH) {
+        if (!emit_match_switch(out, semantics, expr, MATCH_EMIT_RETURN, indent)) return false;
+        fputc('\n', out);
+        return true;
+    }
+    if (expr && expr->kind == NOVA_IR_EXPR_IF && expr->as.if_expr.condition && expr->as.if_expr.condition->kind != NOVA_IR_EXPR_BOOL) {
+        emit_indent(out, indent);
+        fputs("if (", out);
+        if (!emit_condition(out, semantics, expr)) return false;
+        fputs(") {\n", out);
+        if (!emit_return(out, semantics, expr->as.if_expr.then_branch, indent + 1)) return false;
+        emit_indent(out, indent);
+        fputs("}\n", out);
+        return emit_return(out, semantics, expr->as.if_expr.else_branch, indent);
+    }
+    emit_indent(out, indent);
+    fputs("return ", out);
+    if (!emit_expr(out, semantics, expr)) return false;
+    fputs(";\n", out);
+    return true;
+}
+
+static void emit_function_signature(FILE *out, const NovaSemanticContext *semantics, const NovaIRFunction *fn, const char *specifiers) {
+    fprintf(out, "%s%s ", specifiers, type_to_c(semantics, fn->return_type));
     emit_token(out, fn->name);
     fputc('(', out);
     if (fn->param_count == 0) {
@@ -422,12 +3205,18 @@ static bool emit_function(FILE *out, const NovaSemanticContext *semantics, const
             emit_token(out, fn->params[i].name);
         }
     }
-    fputs(") {\n", out);
+    fputc(')', out);
+}
+
+// profile_index is the function's call counter in instrumented builds, SIZE_MAX otherwise.
+static bool emit_function(FILE *out, const NovaSemanticContext *semantics, const NovaIRFunction *fn, bool local, bool clones, size_t profile_index) {
+    const char *return_type = type_to_c(semantics, fn->return_type);
+    if (clones) fputs("__attribute__((target_clones(" NOVA_TARGET_CLONES ")))\n", out);
+    emit_function_signature(out, semantics, fn, local ? "static " : "");
+    fputs(" {\n", out);
+    if (profile_index != SIZE_MAX) fprintf(out, "    nova_profile_calls[%zu]++;\n", profile_index);
     if (strcmp(return_type, "void") != 0) {
-        emit_indent(out, 1);
-        fputs("return ", out);
-        if (!emit_expr(out, semantics, fn->body)) return false;
-        fputs(";\n", out);
+        if (!emit_return(out, semantics, fn->body, 1)) return false;
     } else if (fn->body) {
         if (!emit_statement(out, semantics, fn->body, 1)) return false;
         fputc('\n', out);
@@ -436,226 +3225,1061 @@ static bool emit_function(FILE *out, const NovaSemanticContext *semantics, const
     return true;
 }
 
-static bool emit_program_c(const NovaIRProgram *program, const NovaSemanticContext *semantics, const char *c_path, char *error_buffer, size_t error_buffer_size) {
-    FILE *out = fopen(c_path, "w");
-    if (!out) {
-        if (error_buffer && error_buffer_size > 0) {
-            snprintf(error_buffer, error_buffer_size, "failed to open %s", c_path);
+static void emit_closure_entry_c(FILE *out, const NovaSemanticContext *semantics, const NovaIRFunction *fn) {
+    int length = (int)fn->name.length;
+    const char *name = fn->name.lexeme;
+    fprintf(out, "struct nova_env_%.*s {\n    void (*code)(void);\n", length, name);
+    for (size_t p = 0; p < fn->capture_count; ++p) {
+        fprintf(out, "    %s c%zu;\n", type_to_c(semantics, fn->params[p].type), p);
+    }
+    fputs("};\n", out);
+    if (fn->capture_count > 0) {
+        fprintf(out, "static void nova_trace_%.*s(void *gc, void *payload) {\n", length, name);
+        fprintf(out, "    const struct nova_env_%.*s *env = payload;\n", length, name);
+        for (size_t p = 0; p < fn->capture_count; ++p) {
+            char lvalue[32];
+            snprintf(lvalue, sizeof(lvalue), "env->c%zu", p);
+            emit_trace_field_c(out, semantics, fn->params[p].type, false, lvalue, 1);
+        }
+        fputs("}\n", out);
+    }
+    const char *return_type = type_to_c(semantics, fn->return_type);
+    fprintf(out, "static %s nova_entry_%.*s(const void *nova_env", return_type, length, name);
+    for (size_t p = fn->capture_count; p < fn->param_count; ++p) {
+        fprintf(out, ", %s a%zu", type_to_c(semantics, fn->params[p].type), p);
+    }
+    fputs(") {\n", out);
+    if (fn->capture_count > 0) {
+        fprintf(out, "    const struct nova_env_%.*s *env = nova_env;\n", length, name);
+    } else {
+        fputs("    (void)nova_env;\n", out);
+    }
+    fprintf(out, "    %s%.*s(", strcmp(return_type, "void") == 0 ? "" : "return ", length, name);
+    for (size_t p = 0; p < fn->param_count; ++p) {
+        fprintf(out, p < fn->capture_count ? "%senv->c%zu" : "%sa%zu", p > 0 ? ", " : "", p);
+    }
+    fputs(");\n}\n", out);
+    if (fn->capture_count == 0) {
+        fprintf(out, "static const struct nova_env_%.*s nova_closure_%.*s = {(void (*)(void))nova_entry_%.*s};\n", length, name, length, name, length, name);
+    }
+    fputc('\n', out);
+}
+
+// An instrumented build's counters, appended to the profile at exit; see
+// nova/profile.h for the records. A function optimisation removed still gets
+// a record when it had branches, which may have run inlined elsewhere.
+static void emit_profile_counters_c(FILE *out, const NovaIRProgram *program) {
+    fprintf(out,
+            "static uint64_t nova_profile_calls[%zu];\n"
+            "static uint64_t nova_profile_branches[%zu][2];\n"
+            "static inline bool nova_profile_branch(size_t site, bool taken) {\n"
+            "    nova_profile_branches[site][taken]++;\n"
+            "    return taken;\n"
+            "}\n\n",
+            program->function_count ? program->function_count : 1,
+            program->branch_site_count ? program->branch_site_count : 1);
+}
+
+static bool emit_profile_writer_c(FILE *out, const NovaIRProgram *program, const char *path) {
+    size_t *site_counts = static_cast<size_t *>(calloc(program->function_count ? program->function_count : 1, sizeof(size_t)));
+    if (!site_counts) return false;
+    fputs("__attribute__((destructor)) static void nova_profile_write(void) {\n    FILE *file = fopen(", out);
+    emit_c_string(out, path, strlen(path));
+    fputs(", \"a\");\n    if (!file) return;\n", out);
+    // Sites are numbered function by function, so each function's are one run.
+    for (size_t start = 0, end; start < program->branch_site_count; start = end) {
+        NovaToken name = program->branch_sites[start].function;
+        for (end = start + 1; end < program->branch_site_count && program->branch_sites[end].ordinal > 0; ++end) {
+        }
+        size_t i = 0;
+        while (i < program->function_count && (program->functions[i].name.length != name.length || strncmp(program->functions[i].name.lexeme, name.lexeme, name.length) != 0)) i++;
+        if (i < program->function_count) {
+            site_counts[i] = end - start;
+        } else {
+            fprintf(out, "    fputs(\"function %.*s 0 %zu\\n\", file);\n", (int)name.length, name.lexeme, end - start);
+        }
+    }
+    for (size_t i = 0; i < program->function_count; ++i) {
+        const NovaToken *name = &program->functions[i].name;
+        fprintf(out, "    fprintf(file, \"function %.*s %%llu %zu\\n\", (unsigned long long)nova_profile_calls[%zu]);\n", (int)name->length, name->lexeme, site_counts[i], i);
+    }
+    for (size_t k = 0; k < program->branch_site_count; ++k) {
+        const NovaIRBranchSite *site = &program->branch_sites[k];
+        fprintf(out,
+                "    fprintf(file, \"branch %.*s %zu %%llu %%llu\\n\", (unsigned long long)nova_profile_branches[%zu][1], (unsigned long long)nova_profile_branches[%zu][0]);\n",
+                (int)site->function.length,
+                site->function.lexeme,
+                site->ordinal,
+                k,
+                k);
+    }
+    fputs("    fclose(file);\n}\n", out);
+    free(site_counts);
+    return true;
+}
+
+// Emits the translation unit holding the functions unit_of assigns to unit,
+// or the whole program when unit_of is NULL. Every unit repeats the prelude,
+// the type layouts and the string table, which are all static. Internal
+// functions only one unit refers to are static too; partitioning keeps lifted
+// functions in the unit of every function that refers to them.
+static bool emit_unit_c(const NovaIRProgram *program, const NovaSemanticContext *semantics, const size_t *unit_of, size_t unit, FILE *out, char *error_buffer, size_t error_buffer_size) {
+    // Instrumented builds are never partitioned; their profile path is
+    // absolute so the executable may run from anywhere.
+    const char *profile_directory = unit_of ? NULL : profile_generate_directory();
+    char profile_path[PATH_MAX];
+    if (profile_directory) {
+        char resolved[PATH_MAX - sizeof(NOVA_PROFILE_FILE) - 1];
+        if ((mkdir(profile_directory, 0777) != 0 && errno != EEXIST) || !realpath(profile_directory, resolved)) {
+            if (error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "cannot create profile directory %s", profile_directory);
+            return false;
+        }
+        snprintf(profile_path, sizeof(profile_path), "%s/%s", resolved, NOVA_PROFILE_FILE);
+    }
+    fputs("#include <math.h>\n#include <stdbool.h>\n#include <stdint.h>\n#include <stdlib.h>\n#include <string.h>\n", out);
+    fputs(profile_directory ? "#include <stdio.h>\n\n" : "\n", out);
+    // The murmur3 finaliser behind string match dispatch; it must agree with
+    // nova_match_hash_mix.
+    fputs("static inline uint32_t nova_hash_mix(uint32_t hash) {\n"
+          "    hash ^= hash >> 16;\n"
+          "    hash *= 0x85ebca6bu;\n"
+          "    hash ^= hash >> 13;\n"
+          "    hash *= 0xc2b2ae35u;\n"
+          "    return hash ^ (hash >> 16);\n"
+          "}\n",
+          out);
+    // libnovart, linked into every executable; see include/nova/runtime.h.
+    fputs("void nova_rt_init(void *stack_base);\n"
+          "void nova_rt_shutdown(void);\n"
+          "void *nova_rt_alloc(size_t size, void (*trace)(void *gc, void *payload));\n"
+          "void nova_rt_mark(void *gc, const void *payload);\n"
+          "void nova_rt_trace_ref(void *gc, void *payload);\n"
+          "void *nova_list_new(size_t elem_size, void (*elem_trace)(void *gc, void *payload), size_t count, const void *elements);\n"
+          "__attribute__((pure)) int64_t nova_list_length(const void *list);\n"
+          "__attribute__((pure)) const void *nova_list_at(const void *list, int64_t index);\n"
+          "void *nova_list_push(const void *list, size_t elem_size, void (*elem_trace)(void *gc, void *payload), const void *element);\n"
+          "void *nova_map_new(void);\n"
+          "__attribute__((pure)) int64_t nova_map_length(const void *map);\n"
+          "__attribute__((pure)) const void *nova_map_find(const void *map, uint64_t key);\n"
+          "__attribute__((pure)) const void *nova_map_at(const void *map, uint64_t key);\n"
+          "void *nova_map_put(const void *map, uint32_t key_kind, size_t value_size, void (*value_trace)(void *gc, void *payload), uint64_t key, const void *value);\n"
+          "void *nova_map_remove(const void *map, uint64_t key);\n"
+          "void *nova_map_from_lists(uint32_t key_kind, size_t value_size, void (*value_trace)(void *gc, void *payload), const void *keys, const void *values);\n"
+          "__attribute__((pure)) int64_t nova_string_length(const void *string);\n"
+          "const void *nova_string_concat(const void *left, const void *right);\n"
+          "__attribute__((pure)) uint32_t nova_string_hash(const void *string, uint32_t seed);\n"
+          "bool nova_string_equal(const void *left, const void *right);\n\n",
+          out);
+    // Sum value helpers: recursive fields live in boxes, and a Number stored
+    // where its niche encodes other variants must not carry a niche pattern.
+    fputs("static inline void *nova_box(const void *value, size_t size, void (*trace)(void *gc, void *payload)) {\n"
+          "    return memcpy(nova_rt_alloc(size, trace), value, size);\n"
+          "}\n"
+          "static inline uint64_t nova_f64_bits(double value) {\n"
+          "    uint64_t bits;\n"
+          "    memcpy(&bits, &value, sizeof bits);\n"
+          "    return bits;\n"
+          "}\n"
+          "static inline double nova_f64_from_bits(uint64_t bits) {\n"
+          "    double value;\n"
+          "    memcpy(&value, &bits, sizeof value);\n"
+          "    return value;\n"
+          "}\n",
+          out);
+    fprintf(out,
+            "static inline double nova_f64_clear_niche(double value) {\n"
+            "    return nova_f64_bits(value) >> 32 == 0x%llxu ? nova_f64_from_bits(0x%llxull) : value;\n"
+            "}\n\n",
+            (unsigned long long)(NOVA_LAYOUT_F64_NICHE >> 32),
+            (unsigned long long)NOVA_LAYOUT_F64_QUIET_NAN);
+    // Int division traps on zero and wraps INT64_MIN / -1; Int(x) saturates.
+    fputs("static inline int64_t nova_int_div(int64_t a, int64_t b) {\n"
+          "    if (b == 0) abort();\n"
+          "    return b == -1 ? (int64_t)(0 - (uint64_t)a) : a / b;\n"
+          "}\n"
+          "static inline int64_t nova_int_rem(int64_t a, int64_t b) {\n"
+          "    if (b == 0) abort();\n"
+          "    return b == -1 ? 0 : a % b;\n"
+          "}\n"
+          "static inline int64_t nova_int_from_f64(double value) {\n"
+          "    if (value != value) return 0;\n"
+          "    if (value >= 9223372036854775808.0) return INT64_MAX;\n"
+          "    if (value < -9223372036854775808.0) return INT64_MIN;\n"
+          "    return (int64_t)value;\n"
+          "}\n\n",
+          out);
+    // A function value points at its environment, which starts with the entry thunk.
+    fputs("typedef struct {\n"
+          "    void (*code)(void);\n"
+          "} nova_closure;\n\n",
+          out);
+    if (profile_directory) emit_profile_counters_c(out, program);
+    if (!emit_type_layouts_c(out, program, semantics)) {
+        if (error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "out of memory");
+        return false;
+    }
+    emit_string_table_c(out, program);
+    NovaIRCallGraph graph;
+    if (!nova_ir_call_graph_build(program, &graph)) {
+        if (error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "out of memory building call graph");
+        return false;
+    }
+    FunctionTraits *traits = function_traits(program, semantics, &graph, unit_of);
+    bool *closures = traits ? closure_functions(program) : NULL;
+    // A unit declares only its own functions and what they refer to, so
+    // editing one unit leaves the text of the others unchanged.
+    bool *needed = closures ? static_cast<bool *>(calloc(program->function_count ? program->function_count : 1, sizeof(bool))) : NULL;
+    if (needed) {
+        for (size_t i = 0; i < program->function_count; ++i) {
+            if (unit_of && unit_of[i] != unit) continue;
+            needed[i] = true;
+            for (size_t c = 0; c < graph.nodes[i].callee_count; ++c) needed[graph.nodes[i].callees[c]] = true;
         }
+    }
+    if (!needed) {
+        free(closures);
+        free(traits);
+        nova_ir_call_graph_free(&graph);
+        if (error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "out of memory");
         return false;
     }
-    fputs("#include <stdbool.h>\n\n", out);
+    // Prototypes let functions call each other in any order; they list callees
+    // before their callers and carry what effect analysis proved, unless
+    // call counters make every function impure.
+    for (size_t k = 0; k < program->function_count; ++k) {
+        size_t i = graph.bottom_up[k];
+        const NovaIRFunction *fn = &program->functions[i];
+        if (!needed[i]) continue;
+        const char *specifiers = traits[i].local ? "static " : "";
+        bool annotate = !profile_directory && strcmp(type_to_c(semantics, fn->return_type), "void") != 0;
+        if (annotate && traits[i].readnone) {
+            specifiers = traits[i].local ? "static __attribute__((const)) " : "__attribute__((const)) ";
+        } else if (annotate && traits[i].pure) {
+            specifiers = traits[i].local ? "static __attribute__((pure)) " : "__attribute__((pure)) ";
+        }
+        emit_function_signature(out, semantics, fn, specifiers);
+        fputs(";\n", out);
+    }
+    nova_ir_call_graph_free(&graph);
+    if (program->function_count > 0) fputc('\n', out);
+    for (size_t i = 0; i < program->function_count; ++i) {
+        if (needed[i] && closures[i]) emit_closure_entry_c(out, semantics, &program->functions[i]);
+    }
+    free(closures);
+    free(needed);
     for (size_t i = 0; i < program->function_count; ++i) {
-        if (!emit_function(out, semantics, &program->functions[i])) {
+        if (unit_of && unit_of[i] != unit) continue;
+        bool clones = traits[i].loop_heavy && multiversion_enabled();
+        if (!emit_function(out, semantics, &program->functions[i], traits[i].local, clones, profile_directory ? i : SIZE_MAX)) {
             if (error_buffer && error_buffer_size > 0) {
                 snprintf(error_buffer, error_buffer_size, "unsupported expression in function");
             }
-            fclose(out);
-            remove(c_path);
+            free(traits);
             return false;
         }
     }
-    fclose(out);
+    free(traits);
+    if (profile_directory && !emit_profile_writer_c(out, program, profile_path)) {
+        if (error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "out of memory");
+        return false;
+    }
     return true;
 }
 
-static int invoke_cc(const char *source_path, const char *output_path, bool link_executable) {
-    const char *cc = getenv("NOVA_CC");
-    if (!cc || cc[0] == '\0') {
-        cc = "cc";
-    }
-    const char *common_flags = "-std=c11 -O3 -flto -fno-plt -fomit-frame-pointer -DNDEBUG";
-    char command[PATH_MAX * 4];
-    if (link_executable) {
-        snprintf(command,
-                 sizeof(command),
-                 "%s %s -Wl,--gc-sections %s -o %s",
-                 cc,
-                 common_flags,
-                 source_path,
-                 output_path);
-    } else {
-        snprintf(command,
-                 sizeof(command),
-                 "%s %s -c %s -o %s",
-                 cc,
-                 common_flags,
-                 source_path,
-                 output_path);
+static bool emit_program_c(const NovaIRProgram *program, const NovaSemanticContext *semantics, FILE *out, char *error_buffer, size_t error_buffer_size) {
+    return emit_unit_c(program, semantics, NULL, 0, out, error_buffer, error_buffer_size);
+}
+
+static size_t partition_find(size_t *parent, size_t i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
     }
-    return system(command);
+    return i;
 }
 
-static int invoke_llvm_cc(const char *ir_path, const char *output_path, bool link_executable) {
-    const char *cc = getenv("NOVA_CC");
-    if (!cc || cc[0] == '\0') {
-        cc = "clang";
+// Object-cache builds cut units where a function's name says so rather than
+// by size, so an edit leaves the boundaries elsewhere in the program alone.
+// Units average this many call-graph groups and never hold four times as many.
+#define NOVA_CACHE_UNIT_FUNCTIONS 32
+
+static uint64_t hash_bytes(uint64_t hash, const char *bytes, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= (unsigned char)bytes[i];
+        hash *= 1099511628211ull;
     }
-    const char *common_flags = "-O3 -ffast-math -funroll-loops -fvectorize -fslp-vectorize -fno-plt -fomit-frame-pointer -DNDEBUG";
-    char command[PATH_MAX * 4];
-    if (link_executable) {
-        snprintf(command, sizeof(command), "%s %s -x ir %s -Wl,--gc-sections -o %s", cc, common_flags, ir_path, output_path);
-    } else {
-        snprintf(command, sizeof(command), "%s %s -c -x ir %s -o %s", cc, common_flags, ir_path, output_path);
+    return hash;
+}
+
+// stable selects the cache builds' cuts; units is then ignored.
+static size_t partition_units(const NovaIRProgram *program, size_t units, bool stable, size_t *unit_of) {
+    if (!program || !unit_of) return 0;
+    size_t count = program->function_count;
+    for (size_t i = 0; i < count; ++i) unit_of[i] = 0;
+    if ((!stable && units < 2) || count < 2) return 1;
+    NovaIRCallGraph graph;
+    if (!nova_ir_call_graph_build(program, &graph)) return 1;
+    size_t *parent = static_cast<size_t *>(malloc(count * sizeof(size_t)));
+    size_t *next_in_group = static_cast<size_t *>(malloc(count * sizeof(size_t)));
+    size_t *group_head = static_cast<size_t *>(malloc(count * sizeof(size_t)));
+    size_t *order = static_cast<size_t *>(malloc(count * sizeof(size_t)));
+    size_t *stack = static_cast<size_t *>(malloc((count + 1) * sizeof(size_t)));
+    bool *seen = static_cast<bool *>(calloc(count, sizeof(bool)));
+    bool *placed = static_cast<bool *>(calloc(count, sizeof(bool)));
+    size_t used = 1;
+    if (parent && next_in_group && group_head && order && stack && seen && placed) {
+        // A lifted function joins the group of everything that calls it or
+        // takes it as a value.
+        for (size_t i = 0; i < count; ++i) parent[i] = i;
+        for (size_t i = 0; i < count; ++i) {
+            const NovaIRCallGraphNode *node = &graph.nodes[i];
+            for (size_t c = 0; c < node->callee_count; ++c) {
+                if (!program->functions[node->callees[c]].lifted) continue;
+                size_t a = partition_find(parent, i);
+                size_t b = partition_find(parent, node->callees[c]);
+                if (a != b) parent[b] = a;
+            }
+        }
+        for (size_t i = 0; i < count; ++i) group_head[i] = SIZE_MAX;
+        for (size_t i = count; i > 0; --i) {
+            size_t root = partition_find(parent, i - 1);
+            next_in_group[i - 1] = group_head[root];
+            group_head[root] = i - 1;
+        }
+        // Depth-first from each function in program order, so callees
+        // follow their callers.
+        size_t order_count = 0;
+        for (size_t start = 0; start < count; ++start) {
+            if (seen[start]) continue;
+            size_t depth = 0;
+            stack[depth++] = start;
+            seen[start] = true;
+            while (depth > 0) {
+                size_t f = stack[--depth];
+                order[order_count++] = f;
+                const NovaIRCallGraphNode *node = &graph.nodes[f];
+                for (size_t c = node->callee_count; c > 0; --c) {
+                    size_t callee = node->callees[c - 1];
+                    if (seen[callee]) continue;
+                    seen[callee] = true;
+                    stack[depth++] = callee;
+                }
+            }
+        }
+        // Whole groups are dealt out in that order, cutting a new unit once
+        // the current one holds its share of the program.
+        size_t total = 0;
+        for (size_t i = 0; i < count; ++i) total += program->functions[i].body ? nova_ir_expr_size(program->functions[i].body) + 1 : 1;
+        size_t unit = 0;
+        size_t filled = 0;
+        size_t groups = 0; // in the current unit
+        for (size_t i = 0; i < order_count; ++i) {
+            size_t root = partition_find(parent, order[i]);
+            if (placed[root]) continue;
+            placed[root] = true;
+            for (size_t f = group_head[root]; f != SIZE_MAX; f = next_in_group[f]) {
+                unit_of[f] = unit;
+                filled += program->functions[f].body ? nova_ir_expr_size(program->functions[f].body) + 1 : 1;
+            }
+            groups++;
+            if (stable) {
+                const NovaToken *name = &program->functions[order[i]].name;
+                if (hash_bytes(1469598103934665603ull, name->lexeme, name->length) % NOVA_CACHE_UNIT_FUNCTIONS == 0 ||
+                    groups >= 4 * NOVA_CACHE_UNIT_FUNCTIONS) {
+                    unit++;
+                    groups = 0;
+                }
+            } else if (unit + 1 < units && filled * units >= total * (unit + 1)) {
+                unit++;
+            }
+        }
+        used = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (unit_of[i] + 1 > used) used = unit_of[i] + 1;
+        }
     }
-    return system(command);
+    free(parent);
+    free(next_in_group);
+    free(group_head);
+    free(order);
+    free(stack);
+    free(seen);
+    free(placed);
+    nova_ir_call_graph_free(&graph);
+    return used;
 }
 
-static bool use_llvm_backend(void) {
-    const char *backend = getenv("NOVA_CODEGEN_BACKEND");
-    return backend && strcmp(backend, "llvm") == 0;
+size_t nova_codegen_partition(const NovaIRProgram *program, size_t units, size_t *unit_of) {
+    return partition_units(program, units, false, unit_of);
 }
 
-bool nova_codegen_emit_object(const NovaIRProgram *program, const NovaSemanticContext *semantics, const char *object_path, char *error_buffer, size_t error_buffer_size) {
-    if (!program || !object_path) {
-        return false;
+#ifndef NOVA_RUNTIME_LIBRARY
+#define NOVA_RUNTIME_LIBRARY "build/libnovart.a"
+#endif
+
+// Executables link libnovart statically; NOVA_RUNTIME overrides where it is.
+static const char *runtime_library(void) {
+    const char *path = getenv("NOVA_RUNTIME");
+    return path && path[0] != '\0' ? path : NOVA_RUNTIME_LIBRARY;
+}
+
+// Generated code is written into memory and handed to the compiler whole.
+typedef struct {
+    FILE *out;
+    char *data;
+    size_t length;
+} CodeBuffer;
+
+static bool code_buffer_open(CodeBuffer *buffer, char *error_buffer, size_t error_buffer_size) {
+    buffer->data = NULL;
+    buffer->length = 0;
+    buffer->out = open_memstream(&buffer->data, &buffer->length);
+    if (!buffer->out && error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "out of memory");
+    return buffer->out != NULL;
+}
+
+// Finishes the text; data and length are valid afterwards.
+static bool code_buffer_close(CodeBuffer *buffer, char *error_buffer, size_t error_buffer_size) {
+    bool ok = fclose(buffer->out) == 0;
+    buffer->out = NULL;
+    if (!ok && error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "out of memory");
+    return ok;
+}
+
+// Runs argv with input on its stdin and collects its stderr into
+// diagnostics. Both pipes are serviced by one poll loop so a compiler that
+// reports errors before reading all of its input cannot deadlock against
+// us. SIGPIPE stays blocked in this thread while writing, for compilers
+// that exit early, and the child gets the caller's mask back. Returns the
+// exit status, 128 plus the signal if the compiler was killed, or -1 if it
+// could not be started.
+static int run_compiler(const char *const *argv, const char *input, size_t input_length, FILE *diagnostics) {
+    int in_pipe[2], err_pipe[2];
+    if (pipe2(in_pipe, O_CLOEXEC) != 0) return -1;
+    if (pipe2(err_pipe, O_CLOEXEC) != 0) {
+        close(in_pipe[0]);
+        close(in_pipe[1]);
+        return -1;
     }
+    sigset_t pipe_signal, saved_mask;
+    sigemptyset(&pipe_signal);
+    sigaddset(&pipe_signal, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe_signal, &saved_mask);
 
-    if (use_llvm_backend()) {
-        char ir_path[PATH_MAX];
-        derive_ir_path(object_path, ir_path, sizeof(ir_path));
-        if (!emit_program_llvm(program, semantics, ir_path, error_buffer, error_buffer_size)) {
-            return false;
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, in_pipe[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, err_pipe[1], STDERR_FILENO);
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    posix_spawnattr_setsigmask(&attributes, &saved_mask);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGMASK);
+    pid_t pid;
+    int spawned = posix_spawnp(&pid, argv[0], &actions, &attributes, const_cast<char *const *>(argv), environ);
+    posix_spawnattr_destroy(&attributes);
+    posix_spawn_file_actions_destroy(&actions);
+    close(in_pipe[0]);
+    close(err_pipe[1]);
+
+    int status = -1;
+    if (spawned != 0) {
+        fprintf(diagnostics, "%s: %s", argv[0], strerror(spawned));
+        close(in_pipe[1]);
+        close(err_pipe[0]);
+    } else {
+        int in_fd = in_pipe[1];
+        int err_fd = err_pipe[0];
+        fcntl(in_fd, F_SETFL, O_NONBLOCK);
+        size_t written = 0;
+        if (input_length == 0) {
+            close(in_fd);
+            in_fd = -1;
         }
-        int result = invoke_llvm_cc(ir_path, object_path, false);
-        remove(ir_path);
-        if (result != 0) {
-            if (error_buffer && error_buffer_size > 0) {
-                snprintf(error_buffer, error_buffer_size, "LLVM code generation failed (clang exit %d)", result);
+        while (in_fd >= 0 || err_fd >= 0) {
+            struct pollfd fds[2] = {{err_fd, POLLIN, 0}, {in_fd, POLLOUT, 0}};
+            if (poll(fds, 2, -1) < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            if (fds[1].revents) {
+                ssize_t n = write(in_fd, input + written, input_length - written);
+                if (n > 0) written += (size_t)n;
+                // EPIPE: the compiler stopped reading; its status says why.
+                if ((n < 0 && errno != EAGAIN && errno != EINTR) || written == input_length) {
+                    close(in_fd);
+                    in_fd = -1;
+                }
+            }
+            if (fds[0].revents) {
+                char chunk[4096];
+                ssize_t n = read(err_fd, chunk, sizeof(chunk));
+                if (n > 0) {
+                    fwrite(chunk, 1, (size_t)n, diagnostics);
+                } else if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+                    close(err_fd);
+                    err_fd = -1;
+                }
             }
-            return false;
         }
-        return true;
+        if (in_fd >= 0) close(in_fd);
+        if (err_fd >= 0) close(err_fd);
+        int wait_status;
+        while (waitpid(pid, &wait_status, 0) < 0 && errno == EINTR) {
+        }
+        status = WIFEXITED(wait_status) ? WEXITSTATUS(wait_status) : 128 + WTERMSIG(wait_status);
+    }
+
+    struct timespec no_wait = {0, 0};
+    while (sigtimedwait(&pipe_signal, NULL, &no_wait) > 0) {
     }
+    pthread_sigmask(SIG_SETMASK, &saved_mask, NULL);
+    return status;
+}
+
+// Reports "<what> (<tool> exit N)" followed by as much of the compiler's
+// own diagnostics as fits.
+static void report_compiler_failure(char *error_buffer, size_t error_buffer_size, const char *what, const char *tool, int status, const char *diagnostics, size_t diagnostics_length) {
+    if (!error_buffer || error_buffer_size == 0) return;
+    int length = status < 0 ? snprintf(error_buffer, error_buffer_size, "%s (cannot run %s)", what, tool)
+                            : snprintf(error_buffer, error_buffer_size, "%s (%s exit %d)", what, tool, status);
+    while (diagnostics_length > 0 && (diagnostics[diagnostics_length - 1] == '\n' || diagnostics[diagnostics_length - 1] == ' ')) {
+        diagnostics_length--;
+    }
+    if (length < 0 || (size_t)length + 2 >= error_buffer_size || diagnostics_length == 0) return;
+    snprintf(error_buffer + length, error_buffer_size - (size_t)length, ": %.*s", (int)diagnostics_length, diagnostics);
+}
 
-    char c_path[PATH_MAX];
-    derive_c_path(object_path, c_path, sizeof(c_path));
-    if (!emit_program_c(program, semantics, c_path, error_buffer, error_buffer_size)) {
+// Feeds source to the compiler; the C backend's cc reads it as C, the LLVM
+// backend's clang as textual IR.
+static bool compile_source(const char *const *argv, const char *tool, const char *source, size_t source_length, const char *what, char *error_buffer, size_t error_buffer_size) {
+    CodeBuffer diagnostics;
+    if (!code_buffer_open(&diagnostics, error_buffer, error_buffer_size)) return false;
+    int status = run_compiler(argv, source, source_length, diagnostics.out);
+    if (!code_buffer_close(&diagnostics, error_buffer, error_buffer_size)) {
+        free(diagnostics.data);
         return false;
     }
+    if (status != 0) report_compiler_failure(error_buffer, error_buffer_size, what, tool, status, diagnostics.data, diagnostics.length);
+    free(diagnostics.data);
+    return status == 0;
+}
 
-    int result = invoke_cc(c_path, object_path, false);
-    if (result != 0) {
-        if (error_buffer && error_buffer_size > 0) {
-            snprintf(error_buffer, error_buffer_size, "code generation failed (cc exit %d)", result);
+static const char *c_compiler(void) {
+    const char *cc = getenv("NOVA_CC");
+    return cc && cc[0] != '\0' ? cc : "cc";
+}
+
+static const char *llvm_compiler(void) {
+    const char *cc = getenv("NOVA_CC");
+    return cc && cc[0] != '\0' ? cc : "clang";
+}
+
+// Clang's ThinLTO keeps the link parallel; GCC parallelises its LTO link with -flto=N.
+static bool c_compiler_is_clang(void) {
+    const char *cc = c_compiler();
+    const char *base = strrchr(cc, '/');
+    return strstr(base ? base + 1 : cc, "clang") != NULL;
+}
+
+// The C compiler's own profile-guided optimisation, alongside Nova's.
+typedef struct {
+    char option[PATH_MAX + 32];
+    const char *flags[8];
+    size_t count;
+} ProfileFlags;
+
+// Clang reads a profile only once llvm-profdata has merged its raw profiles;
+// NOVA_PROFDATA names the tool. A directory without raw profiles is left alone.
+static bool merge_llvm_profiles(const char *directory, const char *merged, char *error_buffer, size_t error_buffer_size) {
+    DIR *dir = opendir(directory);
+    if (!dir) {
+        if (error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "cannot read %s", directory);
+        return false;
+    }
+    size_t count = 0;
+    size_t capacity = 16;
+    char **inputs = static_cast<char **>(malloc(capacity * sizeof(char *)));
+    for (struct dirent *entry = readdir(dir); inputs && entry; entry = readdir(dir)) {
+        size_t length = strlen(entry->d_name);
+        if (length < 8 || strcmp(entry->d_name + length - 7, ".profraw") != 0) continue;
+        if (count == capacity) {
+            char **grown = static_cast<char **>(realloc(inputs, 2 * capacity * sizeof(char *)));
+            if (!grown) break;
+            inputs = grown;
+            capacity *= 2;
         }
-        remove(c_path);
+        size_t size = strlen(directory) + length + 2;
+        inputs[count] = static_cast<char *>(malloc(size));
+        if (inputs[count]) snprintf(inputs[count++], size, "%s/%s", directory, entry->d_name);
+    }
+    closedir(dir);
+    const char **argv = inputs && count > 0 ? static_cast<const char **>(malloc((count + 6) * sizeof(const char *))) : NULL;
+    bool ok = inputs && count == 0;
+    if (argv) {
+        const char *tool = getenv("NOVA_PROFDATA");
+        size_t argc = 0;
+        argv[argc++] = tool && tool[0] != '\0' ? tool : "llvm-profdata";
+        argv[argc++] = "merge";
+        argv[argc++] = "-o";
+        argv[argc++] = merged;
+        for (size_t i = 0; i < count; ++i) argv[argc++] = inputs[i];
+        argv[argc] = NULL;
+        ok = compile_source(argv, "llvm-profdata", "", 0, "merging profiles failed", error_buffer, error_buffer_size);
+    }
+    for (size_t i = 0; i < count; ++i) free(inputs[i]);
+    free(inputs);
+    free(argv);
+    if (!ok && !argv && error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "out of memory");
+    return ok;
+}
+
+// Instrumented builds write the compiler's profile next to Nova's. GCC names
+// its data file after the output unless -dumpbase fixes it, so every build
+// of a program shares one file. A profile-guided build tolerates functions
+// the profile no longer matches, since Nova's own decisions change the code.
+static bool profile_flags(ProfileFlags *profile, bool clang, char *error_buffer, size_t error_buffer_size) {
+    profile->count = 0;
+    const char *generate = profile_generate_directory();
+    const char *use = generate ? NULL : profile_use_directory();
+    if (!generate && !use) return true;
+    char directory[PATH_MAX];
+    if ((generate && mkdir(generate, 0777) != 0 && errno != EEXIST) || !realpath(generate ? generate : use, directory)) {
+        if (error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "cannot open profile directory %s", generate ? generate : use);
         return false;
     }
-    remove(c_path);
+    if (generate) {
+        snprintf(profile->option, sizeof(profile->option), "-fprofile-generate=%s", directory);
+        profile->flags[profile->count++] = profile->option;
+    } else if (clang) {
+        char merged[PATH_MAX + 16];
+        snprintf(merged, sizeof(merged), "%s/nova.profdata", directory);
+        if (!merge_llvm_profiles(directory, merged, error_buffer, error_buffer_size)) return false;
+        if (access(merged, R_OK) != 0) return true;
+        snprintf(profile->option, sizeof(profile->option), "-fprofile-use=%s", merged);
+        profile->flags[profile->count++] = profile->option;
+        profile->flags[profile->count++] = "-Wno-profile-instr-out-of-date";
+        profile->flags[profile->count++] = "-Wno-profile-instr-unprofiled";
+    } else {
+        snprintf(profile->option, sizeof(profile->option), "-fprofile-use=%s", directory);
+        profile->flags[profile->count++] = profile->option;
+        profile->flags[profile->count++] = "-fprofile-partial-training";
+        profile->flags[profile->count++] = "-Wno-coverage-mismatch";
+    }
+    if (!clang) {
+        profile->flags[profile->count++] = "-dumpdir";
+        profile->flags[profile->count++] = "/";
+        profile->flags[profile->count++] = "-dumpbase";
+        profile->flags[profile->count++] = "nova";
+    }
     return true;
 }
 
-bool nova_codegen_emit_executable(const NovaIRProgram *program, const NovaSemanticContext *semantics, const char *executable_path, const char *entry_function, char *error_buffer, size_t error_buffer_size) {
-    if (!program || !executable_path || !entry_function || entry_function[0] == '\0') {
-        return false;
+// Writes the -march option for NOVA_TARGET_CPU into buffer; NULL when unset.
+static const char *march_flag(char *buffer, size_t size) {
+    const char *cpu = target_cpu();
+    if (!cpu) return NULL;
+    snprintf(buffer, size, "-march=%s", cpu);
+    return buffer;
+}
+
+// Fills flags with the options every C compile uses and returns how many.
+// Cached objects are plain machine code: an LTO object would be compiled
+// again by every link.
+static size_t c_compile_flags(bool lto, const char *march, const char **flags) {
+    size_t count = 0;
+    flags[count++] = "-std=c11";
+    flags[count++] = "-O3";
+    if (march) flags[count++] = march;
+    if (lto) flags[count++] = c_compiler_is_clang() ? "-flto=thin" : "-flto";
+    flags[count++] = "-fno-plt";
+    flags[count++] = "-fomit-frame-pointer";
+    flags[count++] = "-DNDEBUG";
+    return count;
+}
+
+static bool invoke_cc(const char *source, size_t source_length, const char *output_path, bool link_executable, bool lto, const char *what, char *error_buffer, size_t error_buffer_size) {
+    ProfileFlags profile;
+    if (!profile_flags(&profile, c_compiler_is_clang(), error_buffer, error_buffer_size)) return false;
+    const char *argv[32];
+    size_t argc = 0;
+    char march[96];
+    argv[argc++] = c_compiler();
+    argc += c_compile_flags(lto, march_flag(march, sizeof(march)), argv + argc);
+    for (size_t i = 0; i < profile.count; ++i) argv[argc++] = profile.flags[i];
+    if (link_executable) {
+        argv[argc++] = "-Wl,--gc-sections";
+    } else {
+        argv[argc++] = "-c";
+    }
+    argv[argc++] = "-x";
+    argv[argc++] = "c";
+    argv[argc++] = "-";
+    if (link_executable) {
+        argv[argc++] = "-x";
+        argv[argc++] = "none";
+        argv[argc++] = runtime_library();
+        argv[argc++] = "-lm";
     }
+    argv[argc++] = "-o";
+    argv[argc++] = output_path;
+    argv[argc] = NULL;
+    return compile_source(argv, "cc", source, source_length, what, error_buffer, error_buffer_size);
+}
 
-    if (use_llvm_backend()) {
-        char ir_path[PATH_MAX];
-        derive_ir_path(executable_path, ir_path, sizeof(ir_path));
-        if (!emit_program_llvm(program, semantics, ir_path, error_buffer, error_buffer_size)) {
-            return false;
-        }
-        FILE *out = fopen(ir_path, "a");
-        if (!out) {
-            if (error_buffer && error_buffer_size > 0) {
-                snprintf(error_buffer, error_buffer_size, "failed to update %s", ir_path);
-            }
-            remove(ir_path);
-            return false;
-        }
-        fprintf(out,
-                "define i32 @main() {\nentry:\n  %%result = call double @%s()\n  %%int = fptosi double %%result to i32\n  ret i32 %%int\n}\n",
-                entry_function);
-        fclose(out);
+// Programs with at least this many functions per unit are split across
+// translation units when more than one compiler job may run.
+#define NOVA_CODEGEN_UNIT_FUNCTIONS 64
 
-        int result = invoke_llvm_cc(ir_path, executable_path, true);
-        remove(ir_path);
-        if (result != 0) {
-            if (error_buffer && error_buffer_size > 0) {
-                snprintf(error_buffer, error_buffer_size, "LLVM AOT executable generation failed (clang exit %d)", result);
-            }
-            return false;
+// NOVA_CODEGEN_JOBS caps the compilers run at once; it defaults to the
+// number of online processors.
+static size_t codegen_jobs(void) {
+    const char *jobs = getenv("NOVA_CODEGEN_JOBS");
+    long count = jobs && jobs[0] != '\0' ? strtol(jobs, NULL, 10) : sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 1 ? (size_t)count : 1;
+}
+
+typedef struct {
+    CodeBuffer code;
+    char object_path[PATH_MAX];
+    char temporary_path[PATH_MAX]; // compiled here and renamed to object_path; empty outside the cache
+    bool cached; // object_path already holds this unit's object
+    bool ok;
+    char error[512];
+} CodegenUnit;
+
+typedef struct {
+    CodegenUnit *units;
+    size_t count;
+    size_t next; // claimed atomically by the workers
+    bool lto;
+    const char *what;
+} CodegenQueue;
+
+static void *compile_units(void *arg) {
+    CodegenQueue *queue = static_cast<CodegenQueue *>(arg);
+    for (;;) {
+        size_t index = __atomic_fetch_add(&queue->next, 1, __ATOMIC_RELAXED);
+        if (index >= queue->count) return NULL;
+        CodegenUnit *unit = &queue->units[index];
+        if (unit->cached) {
+            unit->ok = true;
+            continue;
+        }
+        // Renaming publishes a cached object only once it is complete, so
+        // concurrent builds sharing the cache never see half an object.
+        const char *output = unit->temporary_path[0] != '\0' ? unit->temporary_path : unit->object_path;
+        unit->ok = invoke_cc(unit->code.data, unit->code.length, output, false, queue->lto, queue->what, unit->error, sizeof(unit->error));
+        if (output == unit->temporary_path && (!unit->ok || rename(output, unit->object_path) != 0)) {
+            if (unit->ok) snprintf(unit->error, sizeof(unit->error), "cannot store %.480s", unit->object_path);
+            remove(output);
+            unit->ok = false;
         }
-        return true;
     }
+}
 
-    char c_path[PATH_MAX];
-    derive_c_path(executable_path, c_path, sizeof(c_path));
-    if (!emit_program_c(program, semantics, c_path, error_buffer, error_buffer_size)) {
+// Links the unit objects into an executable, or combines them into one
+// relocatable object that still carries their LTO code.
+static bool link_units(const CodegenUnit *units, size_t count, size_t jobs, bool lto, const char *output_path, bool link_executable, const char *what, char *error_buffer, size_t error_buffer_size) {
+    const char **argv = static_cast<const char **>(malloc((count + 16) * sizeof(const char *)));
+    if (!argv) {
+        if (error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "out of memory");
         return false;
     }
+    char lto_flag[32];
+    if (c_compiler_is_clang()) {
+        snprintf(lto_flag, sizeof(lto_flag), "-flto=thin");
+    } else {
+        snprintf(lto_flag, sizeof(lto_flag), "-flto=%zu", jobs);
+    }
+    char march[96];
+    const char *cpu_flag = march_flag(march, sizeof(march));
+    size_t argc = 0;
+    argv[argc++] = c_compiler();
+    argv[argc++] = "-O3";
+    // An LTO link generates the code, so it needs the target too.
+    if (cpu_flag) argv[argc++] = cpu_flag;
+    if (lto) argv[argc++] = lto_flag;
+    argv[argc++] = "-fno-plt";
+    argv[argc++] = "-fomit-frame-pointer";
+    if (link_executable) {
+        argv[argc++] = "-Wl,--gc-sections";
+    } else {
+        argv[argc++] = "-r";
+        argv[argc++] = "-nostdlib";
+    }
+    for (size_t i = 0; i < count; ++i) argv[argc++] = units[i].object_path;
+    if (link_executable) {
+        argv[argc++] = runtime_library();
+        argv[argc++] = "-lm";
+    }
+    argv[argc++] = "-o";
+    argv[argc++] = output_path;
+    argv[argc] = NULL;
+    bool ok = compile_source(argv, "cc", "", 0, what, error_buffer, error_buffer_size);
+    free(argv);
+    return ok;
+}
 
-    char wrapper_path[PATH_MAX];
-    derive_wrapper_path(executable_path, wrapper_path, sizeof(wrapper_path));
-    FILE *wrapper = fopen(wrapper_path, "w");
-    if (!wrapper) {
-        if (error_buffer && error_buffer_size > 0) {
-            snprintf(error_buffer, error_buffer_size, "failed to open %s", wrapper_path);
+// NOVA_CACHE_DIR turns on the object cache; NULL when it is unset.
+static const char *object_cache_directory(void) {
+    const char *directory = getenv("NOVA_CACHE_DIR");
+    return directory && directory[0] != '\0' ? directory : NULL;
+}
+
+// A cached object is named by a hash of everything that decides its
+// contents: the compiler, its flags and the unit's source, whose prototypes
+// carry the signatures of the functions it calls.
+static void cache_object_path(const CodegenUnit *unit, const char *directory, char *path, size_t path_size) {
+    const char *flags[8];
+    char march[96];
+    size_t flag_count = c_compile_flags(false, march_flag(march, sizeof(march)), flags);
+    const char *cc = c_compiler();
+    uint64_t hash = hash_bytes(1469598103934665603ull, cc, strlen(cc) + 1);
+    for (size_t i = 0; i < flag_count; ++i) hash = hash_bytes(hash, flags[i], strlen(flags[i]) + 1);
+    hash = hash_bytes(hash, unit->code.data, unit->code.length);
+    snprintf(path, path_size, "%s/%016llx-%zu.o", directory, (unsigned long long)hash, unit->code.length);
+}
+
+static void emit_main_c(FILE *out, NovaTypeKind result_kind, const char *entry_function);
+static NovaTypeKind entry_result_kind(const NovaIRProgram *program, const NovaSemanticContext *semantics, const char *entry_function);
+
+// The C backend for large programs: functions are partitioned by call-graph
+// locality, the units compile in parallel into a private directory, and one
+// LTO link joins them. With an object cache every program is split into
+// small units, only units missing from the cache are compiled, and the link
+// joins plain objects. entry_function is NULL when building an object.
+static bool emit_partitioned_c(const NovaIRProgram *program, const NovaSemanticContext *semantics, size_t jobs, const char *cache, const char *output_path, const char *entry_function, const char *what, char *error_buffer, size_t error_buffer_size) {
+    size_t *unit_of = static_cast<size_t *>(malloc((program->function_count ? program->function_count : 1) * sizeof(size_t)));
+    size_t wanted = program->function_count / NOVA_CODEGEN_UNIT_FUNCTIONS;
+    size_t count = unit_of ? partition_units(program, wanted < jobs ? wanted : jobs, cache != NULL, unit_of) : 0;
+    CodegenUnit *units = count ? static_cast<CodegenUnit *>(calloc(count, sizeof(CodegenUnit))) : NULL;
+    const char *tmp = getenv("TMPDIR");
+    char directory[PATH_MAX - 64]; // leaves room for the unit file names
+    if (cache) {
+        snprintf(directory, sizeof(directory), "%s", cache);
+    } else {
+        snprintf(directory, sizeof(directory), "%s/nova-codegen-XXXXXX", tmp && tmp[0] != '\0' ? tmp : "/tmp");
+    }
+    bool have_directory = units && !cache && mkdtemp(directory) != NULL;
+    bool ok = units && (cache ? mkdir(directory, 0777) == 0 || errno == EEXIST : have_directory);
+    if (!ok && error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, units ? "cannot create %s" : "out of memory", directory);
+    size_t emitted = 0;
+    for (; ok && emitted < count; ++emitted) {
+        CodegenUnit *unit = &units[emitted];
+        if (!code_buffer_open(&unit->code, error_buffer, error_buffer_size)) {
+            ok = false;
+            break;
         }
-        remove(c_path);
-        return false;
+        ok = emit_unit_c(program, semantics, unit_of, emitted, unit->code.out, error_buffer, error_buffer_size);
+        if (ok && entry_function && emitted == 0) emit_main_c(unit->code.out, entry_result_kind(program, semantics, entry_function), entry_function);
+        if (!code_buffer_close(&unit->code, error_buffer, error_buffer_size)) ok = false;
+        if (!ok) break;
+        if (cache) {
+            cache_object_path(unit, directory, unit->object_path, sizeof(unit->object_path));
+            snprintf(unit->temporary_path, sizeof(unit->temporary_path), "%s/unit%zu.%ld.tmp", directory, emitted, (long)getpid());
+            unit->cached = access(unit->object_path, R_OK) == 0;
+        } else {
+            snprintf(unit->object_path, sizeof(unit->object_path), "%s/unit%zu.o", directory, emitted);
+        }
+    }
+    if (ok) {
+        CodegenQueue queue = {units, count, 0, cache == NULL, what};
+        size_t workers = (jobs < count ? jobs : count) - 1;
+        pthread_t *threads = static_cast<pthread_t *>(calloc(workers + 1, sizeof(pthread_t)));
+        size_t started = 0;
+        while (threads && started < workers && pthread_create(&threads[started], NULL, compile_units, &queue) == 0) started++;
+        compile_units(&queue);
+        for (size_t i = 0; i < started; ++i) pthread_join(threads[i], NULL);
+        free(threads);
+        for (size_t i = 0; ok && i < count; ++i) {
+            if (units[i].ok) continue;
+            if (error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "%s", units[i].error);
+            ok = false;
+        }
+    }
+    if (ok) ok = link_units(units, count, jobs, cache == NULL, output_path, entry_function != NULL, what, error_buffer, error_buffer_size);
+    for (size_t i = 0; i < emitted && i < count; ++i) {
+        free(units[i].code.data);
+        if (!cache) remove(units[i].object_path);
     }
+    if (have_directory) rmdir(directory);
+    free(units);
+    free(unit_of);
+    return ok;
+}
 
-    fprintf(wrapper,
-            "double %s(void);\n"
-            "int main(void) {\n"
-            "    return (int)%s();\n"
-            "}\n",
-            entry_function,
-            entry_function);
-    fclose(wrapper);
+// Profiles describe the program as one unit, so profile-guided builds are
+// never split.
+static bool use_partitioned_c(const NovaIRProgram *program, size_t jobs) {
+    if (profile_generate_directory() || profile_use_directory()) return false;
+    return object_cache_directory() || (jobs > 1 && program->function_count >= 2 * NOVA_CODEGEN_UNIT_FUNCTIONS);
+}
 
-    char merge_path[PATH_MAX];
-    snprintf(merge_path, sizeof(merge_path), "%s.merge.c", executable_path);
-    FILE *merged = fopen(merge_path, "w");
-    if (!merged) {
+static bool invoke_llvm_cc(const char *ir, size_t ir_length, const char *output_path, bool link_executable, const char *what, char *error_buffer, size_t error_buffer_size) {
+    ProfileFlags profile;
+    if (!profile_flags(&profile, true, error_buffer, error_buffer_size)) return false;
+    const char *argv[32];
+    size_t argc = 0;
+    argv[argc++] = llvm_compiler();
+    const char *common_flags[] = {"-O3", "-ffast-math", "-funroll-loops", "-fvectorize", "-fslp-vectorize", "-fno-plt", "-fomit-frame-pointer", "-DNDEBUG"};
+    for (size_t i = 0; i < sizeof(common_flags) / sizeof(common_flags[0]); ++i) argv[argc++] = common_flags[i];
+    char march[96];
+    if (march_flag(march, sizeof(march))) argv[argc++] = march;
+    for (size_t i = 0; i < profile.count; ++i) argv[argc++] = profile.flags[i];
+    if (!link_executable) argv[argc++] = "-c";
+    argv[argc++] = "-x";
+    argv[argc++] = "ir";
+    argv[argc++] = "-";
+    if (link_executable) {
+        argv[argc++] = "-x";
+        argv[argc++] = "none";
+        argv[argc++] = runtime_library();
+        argv[argc++] = "-Wl,--gc-sections";
+        argv[argc++] = "-lm";
+    }
+    argv[argc++] = "-o";
+    argv[argc++] = output_path;
+    argv[argc] = NULL;
+    return compile_source(argv, "clang", ir, ir_length, what, error_buffer, error_buffer_size);
+}
+
+static bool use_llvm_backend(void) {
+    const char *backend = getenv("NOVA_CODEGEN_BACKEND");
+    return backend && strcmp(backend, "llvm") == 0;
+}
+
+static bool use_native_backend(void) {
+    const char *backend = getenv("NOVA_CODEGEN_BACKEND");
+    return backend && strcmp(backend, "native") == 0;
+}
+
+// Points programs outside the native backend's subset at the other backends.
+static bool native_backend_result(bool ok, char *error_buffer, size_t error_buffer_size) {
+    if (!ok && error_buffer && strstr(error_buffer, "does not support")) {
+        size_t used = strlen(error_buffer);
+        if (used < error_buffer_size) snprintf(error_buffer + used, error_buffer_size - used, "; use NOVA_CODEGEN_BACKEND=c or llvm");
+    }
+    return ok;
+}
+
+bool nova_codegen_emit_llvm_ir(const NovaIRProgram *program, const NovaSemanticContext *semantics, const char *ir_path, char *error_buffer, size_t error_buffer_size) {
+    if (!program || !ir_path) {
+        return false;
+    }
+    FILE *out = fopen(ir_path, "w");
+    if (!out) {
         if (error_buffer && error_buffer_size > 0) {
-            snprintf(error_buffer, error_buffer_size, "failed to open %s", merge_path);
+            snprintf(error_buffer, error_buffer_size, "failed to open %s", ir_path);
         }
-        remove(c_path);
-        remove(wrapper_path);
         return false;
     }
+    bool ok = emit_program_llvm(program, semantics, out, error_buffer, error_buffer_size);
+    if (fclose(out) != 0 && ok) {
+        if (error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "failed to write %s", ir_path);
+        ok = false;
+    }
+    if (!ok) remove(ir_path);
+    return ok;
+}
 
-    FILE *source = fopen(c_path, "r");
-    FILE *entry = fopen(wrapper_path, "r");
-    if (!source || !entry) {
-        if (error_buffer && error_buffer_size > 0) {
-            snprintf(error_buffer, error_buffer_size, "failed to read generated sources");
-        }
-        if (source) fclose(source);
-        if (entry) fclose(entry);
-        fclose(merged);
-        remove(c_path);
-        remove(wrapper_path);
-        remove(merge_path);
+bool nova_codegen_emit_object(const NovaIRProgram *program, const NovaSemanticContext *semantics, const char *object_path, char *error_buffer, size_t error_buffer_size) {
+    if (!program || !object_path) {
         return false;
     }
+    if (use_native_backend()) return native_backend_result(nova_native_emit_object(program, semantics, object_path, error_buffer, error_buffer_size), error_buffer, error_buffer_size);
 
-    int ch;
-    while ((ch = fgetc(source)) != EOF) {
-        fputc(ch, merged);
+    bool llvm = use_llvm_backend();
+    size_t jobs = codegen_jobs();
+    if (!llvm && use_partitioned_c(program, jobs)) return emit_partitioned_c(program, semantics, jobs, object_cache_directory(), object_path, NULL, "code generation failed", error_buffer, error_buffer_size);
+    CodeBuffer code;
+    if (!code_buffer_open(&code, error_buffer, error_buffer_size)) return false;
+    bool ok = llvm ? emit_program_llvm(program, semantics, code.out, error_buffer, error_buffer_size)
+                   : emit_program_c(program, semantics, code.out, error_buffer, error_buffer_size);
+    if (!code_buffer_close(&code, error_buffer, error_buffer_size)) ok = false;
+    if (ok) {
+        ok = llvm ? invoke_llvm_cc(code.data, code.length, object_path, false, "LLVM code generation failed", error_buffer, error_buffer_size)
+                  : invoke_cc(code.data, code.length, object_path, false, true, "code generation failed", error_buffer, error_buffer_size);
     }
-    fputc('\n', merged);
-    while ((ch = fgetc(entry)) != EOF) {
-        fputc(ch, merged);
+    free(code.data);
+    return ok;
+}
+
+// The generated main returns the entry function's result as the exit status;
+// only Number, Int and Bool results are converted, anything else is read as a Number.
+// It brackets the entry call with libnovart's hooks, handing over its own frame
+// address as the stack base: the entry function may be inlined into main, so
+// the address of a local there could sit below live frames.
+static NovaTypeKind entry_result_kind(const NovaIRProgram *program, const NovaSemanticContext *semantics, const char *entry_function) {
+    for (size_t i = 0; i < program->function_count; ++i) {
+        const NovaIRFunction *fn = &program->functions[i];
+        if (fn->name.length != strlen(entry_function) || strncmp(fn->name.lexeme, entry_function, fn->name.length) != 0) continue;
+        const NovaTypeInfo *info = nova_semantic_type_info(semantics, fn->return_type);
+        if (info && (info->kind == NOVA_TYPE_KIND_INT || info->kind == NOVA_TYPE_KIND_BOOL)) return info->kind;
+        break;
     }
-    fclose(source);
-    fclose(entry);
-    fclose(merged);
+    return NOVA_TYPE_KIND_NUMBER;
+}
 
-    int result = invoke_cc(merge_path, executable_path, true);
-    remove(c_path);
-    remove(wrapper_path);
-    remove(merge_path);
-    if (result != 0) {
-        if (error_buffer && error_buffer_size > 0) {
-            snprintf(error_buffer, error_buffer_size, "AOT executable generation failed (cc exit %d)", result);
-        }
+static void emit_main_llvm(FILE *out, NovaTypeKind result_kind, const char *entry_function) {
+    const char *result_type = result_kind == NOVA_TYPE_KIND_INT ? "i64" : result_kind == NOVA_TYPE_KIND_BOOL ? "i1" : "double";
+    const char *conversion = result_kind == NOVA_TYPE_KIND_INT ? "trunc" : result_kind == NOVA_TYPE_KIND_BOOL ? "zext" : "fptosi";
+    fprintf(out,
+            "define i32 @main() {\n"
+            "entry:\n"
+            "  %%stack.base = call ptr @llvm.frameaddress.p0(i32 0)\n"
+            "  call void @nova_rt_init(ptr %%stack.base)\n"
+            "  %%result = call %s @%s()\n"
+            "  %%int = %s %s %%result to i32\n"
+            "  call void @nova_rt_shutdown()\n"
+            "  ret i32 %%int\n"
+            "}\n"
+            "declare ptr @llvm.frameaddress.p0(i32)\n",
+            result_type,
+            entry_function,
+            conversion,
+            result_type);
+}
+
+static void emit_main_c(FILE *out, NovaTypeKind result_kind, const char *entry_function) {
+    fprintf(out,
+            "\n%s %s(void);\n"
+            "int main(void) {\n"
+            "    nova_rt_init(__builtin_frame_address(0));\n"
+            "    int status = (int)%s();\n"
+            "    nova_rt_shutdown();\n"
+            "    return status;\n"
+            "}\n",
+            result_kind == NOVA_TYPE_KIND_INT ? "int64_t" : result_kind == NOVA_TYPE_KIND_BOOL ? "bool" : "double",
+            entry_function,
+            entry_function);
+}
+
+bool nova_codegen_emit_executable(const NovaIRProgram *program, const NovaSemanticContext *semantics, const char *executable_path, const char *entry_function, char *error_buffer, size_t error_buffer_size) {
+    if (!program || !executable_path || !entry_function || entry_function[0] == '\0') {
         return false;
     }
+    if (use_native_backend()) return native_backend_result(nova_native_emit_executable(program, semantics, executable_path, entry_function, error_buffer, error_buffer_size), error_buffer, error_buffer_size);
 
-    return true;
+    bool llvm = use_llvm_backend();
+    size_t jobs = codegen_jobs();
+    if (!llvm && use_partitioned_c(program, jobs)) return emit_partitioned_c(program, semantics, jobs, object_cache_directory(), executable_path, entry_function, "AOT executable generation failed", error_buffer, error_buffer_size);
+    NovaTypeKind result_kind = entry_result_kind(program, semantics, entry_function);
+    CodeBuffer code;
+    if (!code_buffer_open(&code, error_buffer, error_buffer_size)) return false;
+    bool ok = llvm ? emit_program_llvm(program, semantics, code.out, error_buffer, error_buffer_size)
+                   : emit_program_c(program, semantics, code.out, error_buffer, error_buffer_size);
+    if (ok) {
+        if (llvm) {
+            emit_main_llvm(code.out, result_kind, entry_function);
+        } else {
+            emit_main_c(code.out, result_kind, entry_function);
+        }
+    }
+    if (!code_buffer_close(&code, error_buffer, error_buffer_size)) ok = false;
+    if (ok) {
+        ok = llvm ? invoke_llvm_cc(code.data, code.length, executable_path, true, "LLVM AOT executable generation failed", error_buffer, error_buffer_size)
+                  : invoke_cc(code.data, code.length, executable_path, true, true, "AOT executable generation failed", error_buffer, error_buffer_size);
+    }
+    free(code.data);
+    return ok;
 }
@@ -4,20 +4,38 @@
 #include <string.h>
 
 typedef struct NovaGCObject {
-    struct NovaGCObject *next;
-    size_t payload_size;
+    struct NovaGCObject *next; // in a chunk's free slots
+    size_t payload_size; // 0 while the slot is free
     NovaGCTraceFn trace;
     NovaGCFinalizerFn finalizer;
-    uint8_t marked;
+    uint8_t marked; // the epoch of the collection that last marked it
     uint8_t _padding[7];
 } NovaGCObject;
 
+// Payloads up to NOVA_GC_CLASS_COUNT * 16 bytes share chunks of equal slots;
+// larger ones get a chunk of their own. Chunks are what the allocator
+// callbacks see, so allocating and freeing an object is a free-list pop or
+// push, and the sweep walks each chunk's slots in address order.
+#define NOVA_GC_CLASS_COUNT 64
+#define NOVA_GC_CHUNK_BYTES (64 * 1024)
+
+typedef struct NovaGCChunk {
+    uint8_t *slots;
+    size_t slot_size; // header included
+    size_t capacity;
+    size_t used; // slots handed out at least once
+    size_t live;
+    size_t size_class; // NOVA_GC_CLASS_COUNT for a chunk of one large object
+    NovaGCObject *free_slots;
+    struct NovaGCChunk *next_partial;
+    bool partial; // on its class's list of chunks with room
+} NovaGCChunk;
+
 struct NovaGC {
     NovaGCAllocFn alloc;
     NovaGCFreeFn free;
     void *alloc_ctx;
 
-    NovaGCObject *objects;
     size_t object_count;
     size_t bytes_allocated;
     size_t bytes_live;
@@ -39,7 +57,22 @@ struct NovaGC {
 
     bool collect_in_progress;
     bool roots_scanned;
-    NovaGCObject **sweep_cursor;
+    bool sweeping;
+    // Marks alternate between 1 and 2, so the sweep never has to clear them;
+    // objects allocated outside a collection start at 0.
+    uint8_t epoch;
+    size_t sweep_chunk;
+    size_t sweep_slot;
+
+    NovaGCRootScanFn root_scanner;
+    void *root_scanner_ctx;
+
+    // Sorted by address, so that words which only might be pointers can be
+    // checked before they are marked. Only changes when a chunk comes or goes.
+    NovaGCChunk **chunks;
+    size_t chunk_count;
+    size_t chunk_capacity;
+    NovaGCChunk *partial[NOVA_GC_CLASS_COUNT];
 };
 
 static void *default_alloc(void *ctx, size_t size) {
@@ -101,10 +134,139 @@ static NovaGCObject *header_from_payload(void *payload) {
     return ((NovaGCObject *)payload) - 1;
 }
 
+// The last chunk starting at or below address, or SIZE_MAX.
+static size_t chunk_search(const NovaGC *gc, const void *address) {
+    size_t low = 0, high = gc->chunk_count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if ((const void *)gc->chunks[mid] <= address) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low == 0 ? SIZE_MAX : low - 1;
+}
+
+static NovaGCChunk *chunk_create(NovaGC *gc, size_t slot_size, size_t capacity, size_t size_class) {
+    if (gc->chunk_count == gc->chunk_capacity) {
+        size_t next_capacity = gc->chunk_capacity == 0 ? 16 : gc->chunk_capacity * 2;
+        NovaGCChunk **next = static_cast<NovaGCChunk **>(gc->alloc(gc->alloc_ctx, next_capacity * sizeof(NovaGCChunk *)));
+        if (!next) {
+            return NULL;
+        }
+        if (gc->chunks) {
+            memcpy(next, gc->chunks, gc->chunk_count * sizeof(NovaGCChunk *));
+            gc->free(gc->alloc_ctx, gc->chunks);
+        }
+        gc->chunks = next;
+        gc->chunk_capacity = next_capacity;
+    }
+    size_t header = (sizeof(NovaGCChunk) + 15) & ~(size_t)15;
+    NovaGCChunk *chunk = static_cast<NovaGCChunk *>(gc->alloc(gc->alloc_ctx, header + slot_size * capacity));
+    if (!chunk) {
+        return NULL;
+    }
+    memset(chunk, 0, sizeof(*chunk));
+    chunk->slots = (uint8_t *)chunk + header;
+    chunk->slot_size = slot_size;
+    chunk->capacity = capacity;
+    chunk->size_class = size_class;
+    size_t at = chunk_search(gc, chunk) + 1; // SIZE_MAX wraps to 0
+    memmove(gc->chunks + at + 1, gc->chunks + at, (gc->chunk_count - at) * sizeof(NovaGCChunk *));
+    gc->chunks[at] = chunk;
+    gc->chunk_count += 1;
+    return chunk;
+}
+
+static void chunk_destroy(NovaGC *gc, size_t at) {
+    NovaGCChunk *chunk = gc->chunks[at];
+    memmove(gc->chunks + at, gc->chunks + at + 1, (gc->chunk_count - at - 1) * sizeof(NovaGCChunk *));
+    gc->chunk_count -= 1;
+    gc->free(gc->alloc_ctx, chunk);
+}
+
+static NovaGCObject *slot_alloc(NovaGC *gc, size_t payload_size) {
+    size_t size_class = (payload_size + 15) / 16 - 1;
+    if (size_class >= NOVA_GC_CLASS_COUNT) {
+        NovaGCChunk *chunk = chunk_create(gc, sizeof(NovaGCObject) + payload_size, 1, NOVA_GC_CLASS_COUNT);
+        if (!chunk) {
+            return NULL;
+        }
+        chunk->used = 1;
+        chunk->live = 1;
+        return (NovaGCObject *)chunk->slots;
+    }
+    NovaGCChunk *chunk = gc->partial[size_class];
+    while (chunk && !chunk->free_slots && chunk->used == chunk->capacity) {
+        chunk->partial = false;
+        chunk = gc->partial[size_class] = chunk->next_partial;
+    }
+    if (!chunk) {
+        size_t slot_size = sizeof(NovaGCObject) + 16 * (size_class + 1);
+        chunk = chunk_create(gc, slot_size, NOVA_GC_CHUNK_BYTES / slot_size, size_class);
+        if (!chunk) {
+            return NULL;
+        }
+        chunk->partial = true;
+        gc->partial[size_class] = chunk;
+    }
+    NovaGCObject *object = chunk->free_slots;
+    if (object) {
+        chunk->free_slots = object->next;
+    } else {
+        object = (NovaGCObject *)(chunk->slots + chunk->used++ * chunk->slot_size);
+    }
+    chunk->live += 1;
+    return object;
+}
+
+// Frees object, which sits in the chunk at index at.
+static void slot_free(NovaGC *gc, size_t at, NovaGCObject *object) {
+    NovaGCChunk *chunk = gc->chunks[at];
+    if (chunk->size_class == NOVA_GC_CLASS_COUNT) {
+        chunk_destroy(gc, at);
+        return;
+    }
+    object->payload_size = 0;
+    object->next = chunk->free_slots;
+    chunk->free_slots = object;
+    chunk->live -= 1;
+    if (!chunk->partial) {
+        chunk->partial = true;
+        chunk->next_partial = gc->partial[chunk->size_class];
+        gc->partial[chunk->size_class] = chunk;
+    }
+}
+
+// Once a collection has swept everything, chunks left empty go back to the
+// allocator and the lists of chunks with room are rebuilt without them.
+static void release_empty_chunks(NovaGC *gc) {
+    memset(gc->partial, 0, sizeof(gc->partial));
+    size_t kept = 0;
+    for (size_t i = 0; i < gc->chunk_count; ++i) {
+        NovaGCChunk *chunk = gc->chunks[i];
+        if (chunk->live == 0) {
+            gc->free(gc->alloc_ctx, chunk);
+            continue;
+        }
+        gc->chunks[kept++] = chunk;
+        chunk->partial = chunk->size_class < NOVA_GC_CLASS_COUNT && (chunk->free_slots || chunk->used < chunk->capacity);
+        if (chunk->partial) {
+            chunk->next_partial = gc->partial[chunk->size_class];
+            gc->partial[chunk->size_class] = chunk;
+        }
+    }
+    gc->chunk_count = kept;
+}
+
 static void begin_collection(NovaGC *gc) {
     gc->collect_in_progress = true;
     gc->roots_scanned = false;
-    gc->sweep_cursor = &gc->objects;
+    gc->sweeping = false;
+    gc->epoch = gc->epoch == 1 ? 2 : 1;
+    gc->sweep_chunk = 0;
+    gc->sweep_slot = 0;
     gc->objects_marked = 0;
     gc->objects_swept = 0;
     gc->collections += 1;
@@ -120,6 +282,9 @@ static void scan_roots(NovaGC *gc) {
             nova_gc_mark_ptr(gc, *slot);
         }
     }
+    if (gc->root_scanner) {
+        gc->root_scanner(gc, gc->root_scanner_ctx);
+    }
     gc->roots_scanned = true;
 }
 
@@ -134,27 +299,38 @@ static void trace_some(NovaGC *gc, size_t budget) {
     }
 }
 
+// Chunks created while the sweep is under way may shift the cursor back
+// onto a chunk already swept; everything left there is live or free, so
+// sweeping it again changes nothing.
 static void sweep_some(NovaGC *gc, size_t budget) {
     size_t swept = 0;
-    while (*gc->sweep_cursor && swept < budget) {
-        NovaGCObject *object = *gc->sweep_cursor;
-        if (object->marked) {
-            object->marked = 0;
+    while (gc->sweep_chunk < gc->chunk_count && swept < budget) {
+        NovaGCChunk *chunk = gc->chunks[gc->sweep_chunk];
+        if (gc->sweep_slot >= chunk->used) {
+            gc->sweep_chunk += 1;
+            gc->sweep_slot = 0;
+            continue;
+        }
+        NovaGCObject *object = (NovaGCObject *)(chunk->slots + gc->sweep_slot++ * chunk->slot_size);
+        swept += 1;
+        if (object->payload_size == 0) {
+            continue;
+        }
+        if (object->marked == gc->epoch) {
             gc->bytes_live += object->payload_size;
-            gc->sweep_cursor = &object->next;
-            swept += 1;
             continue;
         }
-
-        *gc->sweep_cursor = object->next;
         if (object->finalizer) {
             object->finalizer((void *)(object + 1));
         }
         gc->bytes_allocated -= object->payload_size;
         gc->object_count -= 1;
         gc->objects_swept += 1;
-        gc->free(gc->alloc_ctx, object);
-        swept += 1;
+        if (chunk->size_class == NOVA_GC_CLASS_COUNT) {
+            // The chunk goes with its object and the next one slides into place.
+            gc->sweep_slot = 0;
+        }
+        slot_free(gc, gc->sweep_chunk, object);
     }
 }
 
@@ -199,18 +375,20 @@ void nova_gc_destroy(NovaGC *gc) {
         return;
     }
 
-    NovaGCObject *current = gc->objects;
-    while (current) {
-        NovaGCObject *next = current->next;
-        if (current->finalizer) {
-            current->finalizer((void *)(current + 1));
+    for (size_t i = 0; i < gc->chunk_count; ++i) {
+        NovaGCChunk *chunk = gc->chunks[i];
+        for (size_t slot = 0; slot < chunk->used; ++slot) {
+            NovaGCObject *object = (NovaGCObject *)(chunk->slots + slot * chunk->slot_size);
+            if (object->payload_size != 0 && object->finalizer) {
+                object->finalizer((void *)(object + 1));
+            }
         }
-        gc->free(gc->alloc_ctx, current);
-        current = next;
+        gc->free(gc->alloc_ctx, chunk);
     }
 
     gc->free(gc->alloc_ctx, gc->roots);
     gc->free(gc->alloc_ctx, gc->mark_stack);
+    gc->free(gc->alloc_ctx, gc->chunks);
     gc->free(gc->alloc_ctx, gc);
 }
 
@@ -222,25 +400,27 @@ void *nova_gc_alloc(NovaGC *gc,
         return NULL;
     }
 
-    size_t total = sizeof(NovaGCObject) + payload_size;
-    NovaGCObject *object = static_cast<NovaGCObject *>(gc->alloc(gc->alloc_ctx, total));
+    // Step before the object exists, so a collection starting here cannot
+    // sweep it before the caller has stored it anywhere.
+    if (gc->bytes_allocated + payload_size > gc->threshold_bytes) {
+        nova_gc_collect_step(gc, 128);
+    }
+
+    NovaGCObject *object = slot_alloc(gc, payload_size);
     if (!object) {
         return NULL;
     }
 
-    memset(object, 0, total);
+    memset(object, 0, sizeof(NovaGCObject) + payload_size);
     object->payload_size = payload_size;
     object->trace = trace;
     object->finalizer = finalizer;
-    object->next = gc->objects;
-    gc->objects = object;
+    // Objects allocated while a collection is under way are black: its sweep
+    // would otherwise free them, since no traced object points at them yet.
+    object->marked = gc->collect_in_progress ? gc->epoch : 0;
     gc->object_count += 1;
     gc->bytes_allocated += payload_size;
 
-    if (gc->bytes_allocated > gc->threshold_bytes) {
-        nova_gc_collect_step(gc, 128);
-    }
-
     return (void *)(object + 1);
 }
 
@@ -268,16 +448,41 @@ void nova_gc_remove_root(NovaGC *gc, void **slot) {
     }
 }
 
+void nova_gc_set_root_scanner(NovaGC *gc, NovaGCRootScanFn scan, void *ctx) {
+    if (!gc) {
+        return;
+    }
+    gc->root_scanner = scan;
+    gc->root_scanner_ctx = ctx;
+}
+
+bool nova_gc_owns(const NovaGC *gc, const void *payload) {
+    if (!gc || !payload) {
+        return false;
+    }
+    size_t at = chunk_search(gc, payload);
+    if (at == SIZE_MAX) {
+        return false;
+    }
+    const NovaGCChunk *chunk = gc->chunks[at];
+    uintptr_t offset = (uintptr_t)payload - (uintptr_t)chunk->slots;
+    if ((uintptr_t)payload < (uintptr_t)chunk->slots || offset >= chunk->used * chunk->slot_size ||
+        offset % chunk->slot_size != sizeof(NovaGCObject)) {
+        return false;
+    }
+    return header_from_payload(const_cast<void *>(payload))->payload_size != 0;
+}
+
 void nova_gc_mark_ptr(NovaGC *gc, void *payload) {
     if (!gc || !payload) {
         return;
     }
 
     NovaGCObject *object = header_from_payload(payload);
-    if (object->marked) {
+    if (object->marked == gc->epoch) {
         return;
     }
-    object->marked = 1;
+    object->marked = gc->epoch;
     gc->objects_marked += 1;
 
     if (!ensure_mark_capacity(gc, gc->mark_count + 1)) {
@@ -286,6 +491,14 @@ void nova_gc_mark_ptr(NovaGC *gc, void *payload) {
     gc->mark_stack[gc->mark_count++] = object;
 }
 
+void nova_gc_write_barrier(NovaGC *gc, void *payload) {
+    // Only the marking phase needs it; once sweeping has begun, marking an
+    // object the sweep already passed would keep it alive a cycle too long.
+    if (gc && gc->collect_in_progress && !gc->sweeping) {
+        nova_gc_mark_ptr(gc, payload);
+    }
+}
+
 void nova_gc_collect_step(NovaGC *gc, size_t budget_objects) {
     if (!gc) {
         return;
@@ -315,14 +528,18 @@ void nova_gc_collect_step(NovaGC *gc, size_t budget_objects) {
 
     trace_some(gc, trace_budget);
     if (gc->mark_count == 0) {
+        gc->sweeping = true;
         sweep_some(gc, sweep_budget);
     }
 
-    if (gc->mark_count == 0 && *gc->sweep_cursor == NULL) {
+    if (gc->mark_count == 0 && gc->sweep_chunk >= gc->chunk_count) {
         gc->collect_in_progress = false;
+        release_empty_chunks(gc);
+        // At least a chunk's worth between collections, or a heap that is
+        // mostly garbage would hand its chunks back and forth every few objects.
         size_t grown = gc->bytes_live + (gc->bytes_live * gc->growth_percent) / 100;
-        if (grown < 1024) {
-            grown = 1024;
+        if (grown < NOVA_GC_CHUNK_BYTES) {
+            grown = NOVA_GC_CHUNK_BYTES;
         }
         gc->threshold_bytes = grown;
     }
@@ -1,6 +1,12 @@
 #include "nova/ir.h"
 
+#include "nova/match.h"
+#include "nova/numconv.h"
+
+#include <math.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -17,7 +23,11 @@ static bool token_equals_cstr(const NovaToken *token, const char *text) {
     return token && token->length == len && strncmp(token->lexeme, text, len) == 0;
 }
 
-static NovaIRExpr *nova_ir_expr_new(NovaIRExprKind kind, NovaTypeId type) {
+static bool token_equals(const NovaToken *a, const NovaToken *b) {
+    return a->length == b->length && strncmp(a->lexeme, b->lexeme, a->length) == 0;
+}
+
+NovaIRExpr *nova_ir_expr_new(NovaIRExprKind kind, NovaTypeId type) {
     NovaIRExpr *expr = static_cast<NovaIRExpr *>(calloc(1, sizeof(NovaIRExpr)));
     if (!expr) return NULL;
     expr->kind = kind;
@@ -25,13 +35,24 @@ static NovaIRExpr *nova_ir_expr_new(NovaIRExprKind kind, NovaTypeId type) {
     return expr;
 }
 
-static NovaIRExpr *lower_expr(const NovaExpr *expr, const NovaSemanticContext *semantics);
-static void nova_ir_expr_free(NovaIRExpr *expr);
+static NovaIRExpr *lower_expr(const NovaExpr *expr, const NovaSemanticContext *semantics, NovaIRProgram *program);
 static void optimize_ir_expr(NovaIRExpr **expr_ptr);
+static void nova_ir_function_init(NovaIRFunction *fn);
 
 static NovaTypeId infer_type_from_token(const NovaSemanticContext *semantics, const NovaToken *token) {
     if (!token) return semantics->type_unknown;
+    NovaToken name, argument;
+    if (nova_semantic_split_type_argument(token, &name, &argument)) {
+        NovaToken key, value;
+        if (token_equals_cstr(&name, "Map") && nova_semantic_split_type_pair(&argument, &key, &value)) {
+            return nova_semantic_map_type(semantics, infer_type_from_token(semantics, &key), infer_type_from_token(semantics, &value));
+        }
+        if (!token_equals_cstr(&name, "List")) return semantics->type_unknown;
+        NovaTypeId element = infer_type_from_token(semantics, &argument);
+        return element == semantics->type_unknown ? element : nova_semantic_list_type(semantics, element);
+    }
     if (token_equals_cstr(token, "Number")) return semantics->type_number;
+    if (token_equals_cstr(token, "Int")) return semantics->type_int;
     if (token_equals_cstr(token, "String")) return semantics->type_string;
     if (token_equals_cstr(token, "Bool")) return semantics->type_bool;
     if (token_equals_cstr(token, "Unit")) return semantics->type_unit;
@@ -40,27 +61,31 @@ static NovaTypeId infer_type_from_token(const NovaSemanticContext *semantics, co
     return semantics->type_unknown;
 }
 
-static NovaIRExpr *lower_literal(const NovaExpr *expr, const NovaSemanticContext *semantics) {
+static NovaIRExpr *lower_literal(const NovaExpr *expr, const NovaSemanticContext *semantics, NovaIRProgram *program) {
     const NovaExprInfo *info = nova_semantic_lookup_expr(semantics, expr);
     NovaTypeId type = info ? info->type : 0;
     NovaIRExpr *ir = NULL;
     switch (expr->as.literal.kind) {
     case NOVA_LITERAL_NUMBER: {
-        char buffer[64];
-        size_t len = expr->as.literal.token.length;
-        len = len < sizeof(buffer) - 1 ? len : sizeof(buffer) - 1;
-        memcpy(buffer, expr->as.literal.token.lexeme, len);
-        buffer[len] = '\0';
-        ir = nova_ir_expr_new(NOVA_IR_EXPR_NUMBER, type);
-        if (ir) {
-            ir->as.number_value = strtod(buffer, NULL);
+        const NovaToken *token = &expr->as.literal.token;
+        if (type == semantics->type_int) {
+            ir = nova_ir_expr_new(NOVA_IR_EXPR_INT, type);
+            if (ir) nova_integer_parse(token->lexeme, token->length, &ir->as.int_value);
+            break;
         }
+        ir = nova_ir_expr_new(NOVA_IR_EXPR_NUMBER, type);
+        if (ir) nova_number_parse(token->lexeme, token->length, &ir->as.number_value);
         break;
     }
     case NOVA_LITERAL_STRING: {
         ir = nova_ir_expr_new(NOVA_IR_EXPR_STRING, type);
         if (ir) {
             ir->as.string_value.text = copy_token_text(&expr->as.literal.token);
+            ir->as.string_value.index = ir->as.string_value.text ? nova_ir_intern_string(program, ir->as.string_value.text) : SIZE_MAX;
+            if (ir->as.string_value.index == SIZE_MAX) {
+                nova_ir_expr_free(ir);
+                ir = NULL;
+            }
         }
         break;
     }
@@ -86,7 +111,7 @@ static NovaIRExpr *lower_literal(const NovaExpr *expr, const NovaSemanticContext
                 }
                 ir->as.list.count = count;
                 for (size_t i = 0; i < count; ++i) {
-                    ir->as.list.elements[i] = lower_expr(expr->as.literal.elements.items[i], semantics);
+                    ir->as.list.elements[i] = lower_expr(expr->as.literal.elements.items[i], semantics, program);
                     if (!ir->as.list.elements[i]) {
                         nova_ir_expr_free(ir);
                         return NULL;
@@ -100,16 +125,186 @@ static NovaIRExpr *lower_literal(const NovaExpr *expr, const NovaSemanticContext
     return ir;
 }
 
-static NovaIRExpr *lower_call(const NovaExpr *expr, const NovaSemanticContext *semantics) {
+static NovaEffectMask callee_effects(const NovaExpr *callee, const NovaSemanticContext *semantics) {
+    const NovaExprInfo *info = nova_semantic_lookup_expr(semantics, callee);
+    const NovaTypeInfo *type = info ? nova_semantic_type_info(semantics, info->type) : NULL;
+    // Pipeline stages record their result type on the callee, so leave the
+    // callee's effects to be resolved against the program's functions.
+    if (!type || type->kind != NOVA_TYPE_KIND_FUNCTION) {
+        return NOVA_EFFECT_NONE;
+    }
+    return type->as.function.effects;
+}
+
+static void mark_call_effects(NovaIRExpr **slot, void *ctx) {
+    if (!*slot) return;
+    if ((*slot)->kind == NOVA_IR_EXPR_CALL) {
+        (*slot)->as.call.effects = static_cast<NovaEffectMask>((*slot)->as.call.effects | *static_cast<NovaEffectMask *>(ctx));
+    }
+    nova_ir_expr_for_each_child(*slot, mark_call_effects, ctx);
+}
+
+// Calls to functions declared later in the module are analysed before the
+// callee's result type is inferred; the function type has it by now.
+static NovaTypeId call_result_type(const NovaExpr *expr, const NovaExpr *callee, const NovaSemanticContext *semantics) {
+    const NovaExprInfo *info = nova_semantic_lookup_expr(semantics, expr);
+    NovaTypeId type = info ? info->type : semantics->type_unknown;
+    if (type != semantics->type_unknown) {
+        return type;
+    }
+    const NovaExprInfo *callee_info = nova_semantic_lookup_expr(semantics, callee);
+    const NovaTypeInfo *callee_type = callee_info ? nova_semantic_type_info(semantics, callee_info->type) : NULL;
+    if (callee_type && callee_type->kind == NOVA_TYPE_KIND_FUNCTION) {
+        return callee_type->as.function.result;
+    }
+    return type;
+}
+
+// Returns the variant tag when name constructs a variant of type with the given arity.
+static size_t constructor_tag(const NovaSemanticContext *semantics, NovaTypeId type, const NovaToken *name, size_t arg_count) {
+    const NovaTypeRecord *record = nova_semantic_type_record(semantics, type);
+    size_t tag = nova_semantic_find_variant(record, name);
+    if (tag == SIZE_MAX || record->variants[tag].arity != arg_count) {
+        return SIZE_MAX;
+    }
+    return tag;
+}
+
+// Turns a call to a variant constructor into a CONSTRUCT node; the arguments stay in place.
+static void resolve_constructor(NovaIRExpr *call, const NovaSemanticContext *semantics) {
+    size_t tag = constructor_tag(semantics, call->type, &call->as.call.callee, call->as.call.arg_count);
+    if (tag == SIZE_MAX) return;
+    NovaToken constructor = call->as.call.callee;
+    NovaIRExpr **args = call->as.call.args;
+    size_t arg_count = call->as.call.arg_count;
+    call->kind = NOVA_IR_EXPR_CONSTRUCT;
+    call->as.construct.constructor = constructor;
+    call->as.construct.tag = tag;
+    call->as.construct.args = args;
+    call->as.construct.arg_count = arg_count;
+}
+
+static NovaIRExpr *lower_conversion(const NovaExpr *expr, const NovaSemanticContext *semantics, NovaIRProgram *program) {
+    const NovaExprInfo *info = nova_semantic_lookup_expr(semantics, expr);
+    if (!info || expr->as.call.args.count != 1) return NULL;
+    NovaIRExpr *ir = nova_ir_expr_new(NOVA_IR_EXPR_OPERATOR, info->type);
+    if (!ir) return NULL;
+    ir->as.op.op = info->type == semantics->type_int ? NOVA_OP_TO_INT : NOVA_OP_TO_NUMBER;
+    ir->as.op.left = lower_expr(expr->as.call.args.items[0].value, semantics, program);
+    if (!ir->as.op.left) {
+        nova_ir_expr_free(ir);
+        return NULL;
+    }
+    return ir;
+}
+
+// Lowers a builtin's arguments into the operands of an operator, in order.
+static NovaIRExpr *lower_builtin_operator(const NovaExpr *expr, NovaOperator op, size_t arity, const NovaSemanticContext *semantics, NovaIRProgram *program) {
+    const NovaExprInfo *info = nova_semantic_lookup_expr(semantics, expr);
+    if (!info || expr->as.call.args.count != arity) return NULL;
+    NovaIRExpr *ir = nova_ir_expr_new(NOVA_IR_EXPR_OPERATOR, info->type);
+    if (!ir) return NULL;
+    ir->as.op.op = op;
+    NovaIRExpr **operands[] = {&ir->as.op.left, &ir->as.op.right, &ir->as.op.third};
+    for (size_t i = 0; i < arity; ++i) {
+        *operands[i] = lower_expr(expr->as.call.args.items[i].value, semantics, program);
+        if (!*operands[i]) {
+            nova_ir_expr_free(ir);
+            return NULL;
+        }
+    }
+    return ir;
+}
+
+static NovaIRExpr *lower_list_builtin(const NovaExpr *expr, const NovaSemanticContext *semantics, NovaIRProgram *program) {
+    const NovaToken *name = &expr->as.call.callee->as.identifier.name;
+    NovaOperator op = token_equals_cstr(name, "length") ? NOVA_OP_LIST_LENGTH : token_equals_cstr(name, "get") ? NOVA_OP_LIST_GET : NOVA_OP_LIST_PUSH;
+    NovaIRExpr *ir = lower_builtin_operator(expr, op, op == NOVA_OP_LIST_LENGTH ? 1 : 2, semantics, program);
+    const NovaTypeInfo *operand = ir ? nova_semantic_type_info(semantics, ir->as.op.left->type) : NULL;
+    if (operand && operand->kind == NOVA_TYPE_KIND_MAP) {
+        ir->as.op.op = op == NOVA_OP_LIST_LENGTH ? NOVA_OP_MAP_LENGTH : NOVA_OP_MAP_GET;
+    }
+    return ir;
+}
+
+static NovaIRExpr *lower_map_builtin(const NovaExpr *expr, const NovaSemanticContext *semantics, NovaIRProgram *program) {
+    const NovaToken *name = &expr->as.call.callee->as.identifier.name;
+    if (token_equals_cstr(name, "put")) return lower_builtin_operator(expr, NOVA_OP_MAP_PUT, 3, semantics, program);
+    if (token_equals_cstr(name, "has")) return lower_builtin_operator(expr, NOVA_OP_MAP_HAS, 2, semantics, program);
+    if (token_equals_cstr(name, "remove")) return lower_builtin_operator(expr, NOVA_OP_MAP_REMOVE, 2, semantics, program);
+    if (expr->as.call.args.count != 0) return lower_builtin_operator(expr, NOVA_OP_MAP_NEW, 2, semantics, program);
+    // Map() pairs up two empty lists, which code generation turns into the empty map.
     const NovaExprInfo *info = nova_semantic_lookup_expr(semantics, expr);
-    NovaIRExpr *ir = nova_ir_expr_new(NOVA_IR_EXPR_CALL, info ? info->type : 0);
+    if (!info) return NULL;
+    NovaIRExpr *ir = nova_ir_expr_new(NOVA_IR_EXPR_OPERATOR, info->type);
     if (!ir) return NULL;
+    ir->as.op.op = NOVA_OP_MAP_NEW;
+    ir->as.op.left = nova_ir_expr_new(NOVA_IR_EXPR_LIST, semantics->type_unknown);
+    ir->as.op.right = nova_ir_expr_new(NOVA_IR_EXPR_LIST, semantics->type_unknown);
+    if (!ir->as.op.left || !ir->as.op.right) {
+        nova_ir_expr_free(ir);
+        return NULL;
+    }
+    return ir;
+}
+
+// Calls through a computed function value; the callee is evaluated first.
+static NovaIRExpr *lower_apply(const NovaExpr *expr, const NovaExpr *callee, NovaIRExpr *first, const NovaArgList *args, const NovaSemanticContext *semantics, NovaIRProgram *program) {
+    // The callee's function type has the result; lambda stages record no result of their own.
+    const NovaExprInfo *callee_info = nova_semantic_lookup_expr(semantics, callee);
+    const NovaTypeInfo *callee_type = callee_info ? nova_semantic_type_info(semantics, callee_info->type) : NULL;
+    NovaTypeId type = callee_type && callee_type->kind == NOVA_TYPE_KIND_FUNCTION ? callee_type->as.function.result : call_result_type(expr, callee, semantics);
+    NovaIRExpr *ir = nova_ir_expr_new(NOVA_IR_EXPR_APPLY, type);
+    if (!ir) {
+        nova_ir_expr_free(first);
+        return NULL;
+    }
+    ir->as.apply.effects = callee_effects(callee, semantics);
+    ir->as.apply.arg_count = (first ? 1 : 0) + args->count;
+    if (ir->as.apply.arg_count > 0) {
+        ir->as.apply.args = static_cast<NovaIRExpr **>(calloc(ir->as.apply.arg_count, sizeof(NovaIRExpr *)));
+        if (!ir->as.apply.args) {
+            ir->as.apply.arg_count = 0;
+            nova_ir_expr_free(first);
+            nova_ir_expr_free(ir);
+            return NULL;
+        }
+    }
+    size_t offset = 0;
+    if (first) ir->as.apply.args[offset++] = first;
+    ir->as.apply.callee = lower_expr(callee, semantics, program);
+    if (!ir->as.apply.callee) {
+        nova_ir_expr_free(ir);
+        return NULL;
+    }
+    for (size_t i = 0; i < args->count; ++i) {
+        ir->as.apply.args[offset + i] = lower_expr(args->items[i].value, semantics, program);
+        if (!ir->as.apply.args[offset + i]) {
+            nova_ir_expr_free(ir);
+            return NULL;
+        }
+    }
+    return ir;
+}
+
+static NovaIRExpr *lower_call(const NovaExpr *expr, const NovaSemanticContext *semantics, NovaIRProgram *program) {
+    if (nova_semantic_is_conversion(semantics, expr->as.call.callee)) {
+        return lower_conversion(expr, semantics, program);
+    }
+    if (nova_semantic_is_list_builtin(semantics, expr->as.call.callee)) {
+        return lower_list_builtin(expr, semantics, program);
+    }
+    if (nova_semantic_is_map_builtin(semantics, expr->as.call.callee)) {
+        return lower_map_builtin(expr, semantics, program);
+    }
     NovaExpr *callee_expr = expr->as.call.callee;
     if (callee_expr->kind != NOVA_EXPR_IDENTIFIER) {
-        free(ir);
-        return NULL;
+        return lower_apply(expr, callee_expr, NULL, &expr->as.call.args, semantics, program);
     }
+    NovaIRExpr *ir = nova_ir_expr_new(NOVA_IR_EXPR_CALL, call_result_type(expr, expr->as.call.callee, semantics));
+    if (!ir) return NULL;
     ir->as.call.callee = callee_expr->as.identifier.name;
+    ir->as.call.effects = callee_effects(callee_expr, semantics);
     ir->as.call.arg_count = expr->as.call.args.count;
     if (ir->as.call.arg_count > 0) {
         ir->as.call.args = static_cast<NovaIRExpr **>(calloc(ir->as.call.arg_count, sizeof(NovaIRExpr *)));
@@ -118,28 +313,29 @@ static NovaIRExpr *lower_call(const NovaExpr *expr, const NovaSemanticContext *s
             return NULL;
         }
         for (size_t i = 0; i < expr->as.call.args.count; ++i) {
-            ir->as.call.args[i] = lower_expr(expr->as.call.args.items[i].value, semantics);
+            ir->as.call.args[i] = lower_expr(expr->as.call.args.items[i].value, semantics, program);
         }
     }
+    resolve_constructor(ir, semantics);
     return ir;
 }
 
-static NovaIRExpr *lower_if(const NovaExpr *expr, const NovaSemanticContext *semantics) {
+static NovaIRExpr *lower_if(const NovaExpr *expr, const NovaSemanticContext *semantics, NovaIRProgram *program) {
     const NovaExprInfo *info = nova_semantic_lookup_expr(semantics, expr);
     NovaIRExpr *ir = nova_ir_expr_new(NOVA_IR_EXPR_IF, info ? info->type : 0);
     if (!ir) return NULL;
-    ir->as.if_expr.condition = lower_expr(expr->as.if_expr.condition, semantics);
+    ir->as.if_expr.condition = lower_expr(expr->as.if_expr.condition, semantics, program);
     if (!ir->as.if_expr.condition) {
         nova_ir_expr_free(ir);
         return NULL;
     }
-    ir->as.if_expr.then_branch = lower_expr(expr->as.if_expr.then_branch, semantics);
+    ir->as.if_expr.then_branch = lower_expr(expr->as.if_expr.then_branch, semantics, program);
     if (!ir->as.if_expr.then_branch) {
         nova_ir_expr_free(ir);
         return NULL;
     }
     if (expr->as.if_expr.else_branch) {
-        ir->as.if_expr.else_branch = lower_expr(expr->as.if_expr.else_branch, semantics);
+        ir->as.if_expr.else_branch = lower_expr(expr->as.if_expr.else_branch, semantics, program);
         if (!ir->as.if_expr.else_branch) {
             nova_ir_expr_free(ir);
             return NULL;
@@ -154,16 +350,16 @@ static NovaIRExpr *lower_if(const NovaExpr *expr, const NovaSemanticContext *sem
     return ir;
 }
 
-static NovaIRExpr *lower_while(const NovaExpr *expr, const NovaSemanticContext *semantics) {
+static NovaIRExpr *lower_while(const NovaExpr *expr, const NovaSemanticContext *semantics, NovaIRProgram *program) {
     const NovaExprInfo *info = nova_semantic_lookup_expr(semantics, expr);
     NovaIRExpr *ir = nova_ir_expr_new(NOVA_IR_EXPR_WHILE, info ? info->type : 0);
     if (!ir) return NULL;
-    ir->as.while_expr.condition = lower_expr(expr->as.while_expr.condition, semantics);
+    ir->as.while_expr.condition = lower_expr(expr->as.while_expr.condition, semantics, program);
     if (!ir->as.while_expr.condition) {
         nova_ir_expr_free(ir);
         return NULL;
     }
-    ir->as.while_expr.body = lower_expr(expr->as.while_expr.body, semantics);
+    ir->as.while_expr.body = lower_expr(expr->as.while_expr.body, semantics, program);
     if (!ir->as.while_expr.body) {
         nova_ir_expr_free(ir);
         return NULL;
@@ -171,8 +367,8 @@ static NovaIRExpr *lower_while(const NovaExpr *expr, const NovaSemanticContext *
     return ir;
 }
 
-static NovaIRExpr *lower_pipeline(const NovaExpr *expr, const NovaSemanticContext *semantics) {
-    NovaIRExpr *current = lower_expr(expr->as.pipe.target, semantics);
+static NovaIRExpr *lower_pipeline(const NovaExpr *expr, const NovaSemanticContext *semantics, NovaIRProgram *program) {
+    NovaIRExpr *current = lower_expr(expr->as.pipe.target, semantics, program);
     if (!current) {
         return NULL;
     }
@@ -184,17 +380,22 @@ static NovaIRExpr *lower_pipeline(const NovaExpr *expr, const NovaSemanticContex
             callee = stage->as.call.callee;
             args = stage->as.call.args;
         }
-        if (!callee || callee->kind != NOVA_EXPR_IDENTIFIER) {
+        if (!callee) {
             nova_ir_expr_free(current);
             return NULL;
         }
-        const NovaExprInfo *stage_info = nova_semantic_lookup_expr(semantics, stage);
-        NovaIRExpr *call = nova_ir_expr_new(NOVA_IR_EXPR_CALL, stage_info ? stage_info->type : 0);
+        if (callee->kind != NOVA_EXPR_IDENTIFIER) {
+            current = lower_apply(stage, callee, current, &args, semantics, program);
+            if (!current) return NULL;
+            continue;
+        }
+        NovaIRExpr *call = nova_ir_expr_new(NOVA_IR_EXPR_CALL, call_result_type(stage, callee, semantics));
         if (!call) {
             nova_ir_expr_free(current);
             return NULL;
         }
         call->as.call.callee = callee->as.identifier.name;
+        call->as.call.effects = callee_effects(callee, semantics);
         size_t arg_count = 1 + args.count;
         call->as.call.arg_count = arg_count;
         call->as.call.args = static_cast<NovaIRExpr **>(calloc(arg_count, sizeof(NovaIRExpr *)));
@@ -204,87 +405,423 @@ static NovaIRExpr *lower_pipeline(const NovaExpr *expr, const NovaSemanticContex
         }
         call->as.call.args[0] = current;
         for (size_t a = 0; a < args.count; ++a) {
-            call->as.call.args[a + 1] = lower_expr(args.items[a].value, semantics);
+            call->as.call.args[a + 1] = lower_expr(args.items[a].value, semantics, program);
             if (!call->as.call.args[a + 1]) {
                 nova_ir_expr_free(call);
                 return NULL;
             }
         }
+        resolve_constructor(call, semantics);
         current = call;
     }
     return current;
 }
 
-static NovaIRExpr *lower_match(const NovaExpr *expr, const NovaSemanticContext *semantics) {
+static size_t append_function(NovaIRProgram *program) {
+    if (program->function_count == program->function_capacity) {
+        size_t new_capacity = program->function_capacity == 0 ? 4 : program->function_capacity * 2;
+        NovaIRFunction *functions = static_cast<NovaIRFunction *>(realloc(program->functions, new_capacity * sizeof(NovaIRFunction)));
+        if (!functions) return SIZE_MAX;
+        program->functions = functions;
+        program->function_capacity = new_capacity;
+    }
+    nova_ir_function_init(&program->functions[program->function_count]);
+    return program->function_count++;
+}
+
+// Each lambda becomes a program function of its own. Its slot is taken before
+// the body is lowered, so enclosing lambdas precede the ones nested in them;
+// the captures are filled in by convert_closures once the enclosing function
+// is complete.
+static NovaIRExpr *lower_lambda(const NovaExpr *expr, const NovaSemanticContext *semantics, NovaIRProgram *program) {
     const NovaExprInfo *info = nova_semantic_lookup_expr(semantics, expr);
-    NovaIRExpr *ir = nova_ir_expr_new(NOVA_IR_EXPR_MATCH, info ? info->type : 0);
+    const NovaTypeInfo *type = info ? nova_semantic_type_info(semantics, info->type) : NULL;
+    if (!type || type->kind != NOVA_TYPE_KIND_FUNCTION) return NULL;
+    NovaToken base = expr->start_token;
+    base.lexeme = "lambda";
+    base.length = 6;
+    NovaToken name = nova_ir_fresh_name(program, &base);
+    if (!name.lexeme) return NULL;
+    size_t index = append_function(program);
+    if (index == SIZE_MAX) return NULL;
+    NovaIRFunction *fn = &program->functions[index];
+    fn->name = name;
+    fn->lifted = true;
+    fn->internal = true;
+    fn->return_type = type->as.function.result;
+    fn->effects = type->as.function.effects;
+    fn->param_count = expr->as.lambda.params.count;
+    if (fn->param_count > 0) {
+        fn->params = static_cast<NovaIRParam *>(calloc(fn->param_count, sizeof(NovaIRParam)));
+        if (!fn->params) {
+            fn->param_count = 0;
+            return NULL;
+        }
+        for (size_t p = 0; p < fn->param_count; ++p) {
+            fn->params[p].name = expr->as.lambda.params.items[p].name;
+            fn->params[p].type = p < type->as.function.param_count ? type->as.function.params[p] : semantics->type_unknown;
+        }
+    }
+    NovaIRExpr *body = lower_expr(expr->as.lambda.body, semantics, program);
+    if (!body) return NULL;
+    optimize_ir_expr(&body);
+    program->functions[index].body = body;
+    NovaIRExpr *closure = nova_ir_expr_new(NOVA_IR_EXPR_CLOSURE, info->type);
+    if (closure) closure->as.closure.function = name;
+    return closure;
+}
+
+typedef struct {
+    const NovaExpr *expr;
+    const NovaSemanticContext *semantics;
+    NovaIRProgram *program;
+    const NovaMatchPlan *plan;
+    NovaToken *names; // IR name per occurrence; "_" for payload fields nothing reads
+    NovaTypeId type;
+} MatchLowering;
+
+static NovaIRExpr *identifier_expr(NovaToken name, NovaTypeId type) {
+    NovaIRExpr *expr = nova_ir_expr_new(NOVA_IR_EXPR_IDENTIFIER, type);
+    if (expr) expr->as.identifier = name;
+    return expr;
+}
+
+static NovaIRExpr *lower_pattern_literal(const NovaSemanticContext *semantics, NovaIRProgram *program, const NovaPattern *pattern, NovaTypeId type) {
+    NovaIRExprKind kind = pattern->literal_kind == NOVA_LITERAL_NUMBER   ? NOVA_IR_EXPR_NUMBER
+                          : pattern->literal_kind == NOVA_LITERAL_STRING ? NOVA_IR_EXPR_STRING
+                                                                         : NOVA_IR_EXPR_BOOL;
+    if (kind == NOVA_IR_EXPR_NUMBER && type == semantics->type_int) kind = NOVA_IR_EXPR_INT;
+    NovaIRExpr *ir = nova_ir_expr_new(kind, type);
     if (!ir) return NULL;
-    ir->as.match_expr.scrutinee = lower_expr(expr->as.match_expr.scrutinee, semantics);
+    if (kind == NOVA_IR_EXPR_NUMBER || kind == NOVA_IR_EXPR_INT) {
+        if (kind == NOVA_IR_EXPR_INT) {
+            nova_integer_parse(pattern->token.lexeme, pattern->token.length, &ir->as.int_value);
+        } else {
+            nova_number_parse(pattern->token.lexeme, pattern->token.length, &ir->as.number_value);
+        }
+    } else if (kind == NOVA_IR_EXPR_STRING) {
+        ir->as.string_value.text = copy_token_text(&pattern->token);
+        ir->as.string_value.index = ir->as.string_value.text ? nova_ir_intern_string(program, ir->as.string_value.text) : SIZE_MAX;
+        if (ir->as.string_value.index == SIZE_MAX) {
+            nova_ir_expr_free(ir);
+            return NULL;
+        }
+    } else {
+        ir->as.bool_value = pattern->token.type == NOVA_TOKEN_TRUE;
+    }
+    return ir;
+}
+
+// A payload field can take the user's name directly when every arm reachable
+// below the test binds it under that name, which saves a copy per binding.
+static bool occurrence_alias(const NovaDecision *node, size_t occurrence, NovaToken *name, bool *found) {
+    if (!node || node->kind == NOVA_DECISION_FAIL) return true;
+    if (node->kind == NOVA_DECISION_SWITCH) {
+        for (size_t i = 0; i < node->case_count; ++i) {
+            if (!occurrence_alias(node->cases[i].next, occurrence, name, found)) return false;
+        }
+        return occurrence_alias(node->fallback, occurrence, name, found);
+    }
+    bool bound = false;
+    for (size_t b = 0; b < node->binding_count; ++b) {
+        if (node->bindings[b].occurrence != occurrence) continue;
+        if (*found && !token_equals(name, &node->bindings[b].name)) return false;
+        *name = node->bindings[b].name;
+        *found = true;
+        bound = true;
+    }
+    return bound && occurrence_alias(node->guard_failed, occurrence, name, found);
+}
+
+static NovaToken field_name(MatchLowering *lowering, const NovaDecision *next, size_t occurrence) {
+    static const char wildcard[] = "_";
+    NovaToken name{};
+    name.type = NOVA_TOKEN_IDENTIFIER;
+    if (!lowering->plan->occurrences[occurrence].used) {
+        name.lexeme = wildcard;
+        name.length = 1;
+        return name;
+    }
+    bool found = false;
+    if (occurrence_alias(next, occurrence, &name, &found) && found) {
+        // The alias must not hide an enclosing occurrence that is still read below.
+        bool clash = false;
+        for (size_t o = 0; o < occurrence && !clash; ++o) {
+            clash = lowering->names[o].lexeme && token_equals(&lowering->names[o], &name);
+        }
+        if (!clash) return name;
+    }
+    NovaToken base = name;
+    base.lexeme = "field";
+    base.length = 5;
+    return nova_ir_fresh_name(lowering->program, &base);
+}
+
+static NovaIRExpr *bind_pattern_names(MatchLowering *lowering, const NovaDecision *node, NovaIRExpr *body) {
+    for (size_t b = node->binding_count; body && b > 0; --b) {
+        const NovaDecisionBinding *binding = &node->bindings[b - 1];
+        const NovaToken *source = &lowering->names[binding->occurrence];
+        if (token_equals(source, &binding->name)) continue;
+        NovaTypeId type = lowering->plan->occurrences[binding->occurrence].type;
+        NovaIRExpr *let = nova_ir_expr_new(NOVA_IR_EXPR_LET, body->type);
+        NovaIRExpr *value = identifier_expr(*source, type);
+        if (!let || !value) {
+            nova_ir_expr_free(let);
+            nova_ir_expr_free(value);
+            nova_ir_expr_free(body);
+            return NULL;
+        }
+        let->as.let_expr.name = binding->name;
+        let->as.let_expr.value = value;
+        let->as.let_expr.body = body;
+        body = let;
+    }
+    return body;
+}
+
+static NovaIRExpr *lower_decision(MatchLowering *lowering, const NovaDecision *node);
+
+// Unmatched values reach a switch with no cases, which the backends turn into a trap.
+static NovaIRExpr *lower_match_failure(MatchLowering *lowering) {
+    NovaIRExpr *ir = nova_ir_expr_new(NOVA_IR_EXPR_MATCH, lowering->type);
+    if (!ir) return NULL;
+    ir->as.match_expr.scrutinee = identifier_expr(lowering->names[0], lowering->plan->occurrences[0].type);
     if (!ir->as.match_expr.scrutinee) {
         nova_ir_expr_free(ir);
         return NULL;
     }
-    size_t arm_count = expr->as.match_expr.arms.count;
-    ir->as.match_expr.arm_count = arm_count;
-    if (arm_count > 0) {
-        ir->as.match_expr.arms = static_cast<NovaIRMatchArm *>(calloc(arm_count, sizeof(NovaIRMatchArm)));
-        if (!ir->as.match_expr.arms) {
+    return ir;
+}
+
+static NovaIRExpr *lower_decision_arm(MatchLowering *lowering, const NovaDecision *node) {
+    const NovaMatchArm *arm = &lowering->expr->as.match_expr.arms.items[node->arm];
+    NovaIRExpr *body = bind_pattern_names(lowering, node, lower_expr(arm->body, lowering->semantics, lowering->program));
+    if (!arm->guard || !body) return body;
+    NovaIRExpr *ir = nova_ir_expr_new(NOVA_IR_EXPR_IF, lowering->type);
+    if (!ir) {
+        nova_ir_expr_free(body);
+        return NULL;
+    }
+    ir->as.if_expr.then_branch = body;
+    // The guard sees the arm's bindings, but the arms tried after it must not.
+    ir->as.if_expr.condition = bind_pattern_names(lowering, node, lower_expr(arm->guard, lowering->semantics, lowering->program));
+    ir->as.if_expr.else_branch = lower_decision(lowering, node->guard_failed);
+    if (!ir->as.if_expr.condition || !ir->as.if_expr.else_branch) {
+        nova_ir_expr_free(ir);
+        return NULL;
+    }
+    return ir;
+}
+
+static NovaIRExpr *lower_decision_switch(MatchLowering *lowering, const NovaDecision *node) {
+    const NovaMatchPlan *plan = lowering->plan;
+    NovaTypeId type = plan->occurrences[node->occurrence].type;
+    const NovaTypeRecord *record = nova_semantic_type_record(lowering->semantics, type);
+    bool has_fallback = node->fallback && node->fallback->kind != NOVA_DECISION_FAIL;
+    if (!record && type == lowering->semantics->type_bool && node->case_count + (has_fallback ? 1 : 0) == 2) {
+        NovaIRExpr *ir = nova_ir_expr_new(NOVA_IR_EXPR_IF, lowering->type);
+        if (!ir) return NULL;
+        bool first_true = node->cases[0].literal->token.type == NOVA_TOKEN_TRUE;
+        const NovaDecision *other = node->case_count == 2 ? node->cases[1].next : node->fallback;
+        ir->as.if_expr.condition = identifier_expr(lowering->names[node->occurrence], type);
+        ir->as.if_expr.then_branch = lower_decision(lowering, first_true ? node->cases[0].next : other);
+        ir->as.if_expr.else_branch = lower_decision(lowering, first_true ? other : node->cases[0].next);
+        if (!ir->as.if_expr.condition || !ir->as.if_expr.then_branch || !ir->as.if_expr.else_branch) {
             nova_ir_expr_free(ir);
             return NULL;
         }
-        for (size_t i = 0; i < arm_count; ++i) {
-            const NovaMatchArm *arm = &expr->as.match_expr.arms.items[i];
-            NovaIRMatchArm *ir_arm = &ir->as.match_expr.arms[i];
-            ir_arm->constructor = arm->name;
-            ir_arm->binding_count = arm->bindings.count;
-            if (ir_arm->binding_count > 0) {
-                ir_arm->bindings = static_cast<NovaToken *>(calloc(ir_arm->binding_count, sizeof(NovaToken)));
-                if (!ir_arm->bindings) {
+        return ir;
+    }
+    NovaIRExpr *ir = nova_ir_expr_new(NOVA_IR_EXPR_MATCH, lowering->type);
+    if (!ir) return NULL;
+    ir->as.match_expr.scrutinee = identifier_expr(lowering->names[node->occurrence], type);
+    size_t arm_count = node->case_count + (has_fallback ? 1 : 0);
+    if (arm_count > 0) {
+        ir->as.match_expr.arms = static_cast<NovaIRMatchArm *>(calloc(arm_count, sizeof(NovaIRMatchArm)));
+    }
+    if (!ir->as.match_expr.scrutinee || (arm_count > 0 && !ir->as.match_expr.arms)) {
+        nova_ir_expr_free(ir);
+        return NULL;
+    }
+    ir->as.match_expr.arm_count = arm_count;
+    for (size_t i = 0; i < node->case_count; ++i) {
+        const NovaDecisionCase *decision_case = &node->cases[i];
+        NovaIRMatchArm *arm = &ir->as.match_expr.arms[i];
+        arm->tag = decision_case->tag;
+        if (decision_case->literal) {
+            arm->constructor = decision_case->literal->token;
+            arm->literal = lower_pattern_literal(lowering->semantics, lowering->program, decision_case->literal, type);
+            if (!arm->literal) {
+                nova_ir_expr_free(ir);
+                return NULL;
+            }
+        } else {
+            const NovaVariantRecord *variant = &record->variants[decision_case->tag];
+            arm->constructor = variant->variant->name;
+            arm->binding_count = variant->arity;
+            if (variant->arity > 0) {
+                arm->bindings = static_cast<NovaToken *>(calloc(variant->arity, sizeof(NovaToken)));
+                if (!arm->bindings) {
                     nova_ir_expr_free(ir);
                     return NULL;
                 }
-                for (size_t b = 0; b < ir_arm->binding_count; ++b) {
-                    ir_arm->bindings[b] = arm->bindings.items[b].name;
-                }
             }
-            ir_arm->body = lower_expr(arm->body, semantics);
-            if (!ir_arm->body) {
-                nova_ir_expr_free(ir);
-                return NULL;
+            for (size_t f = 0; f < variant->arity; ++f) {
+                size_t occurrence = decision_case->first_field + f;
+                lowering->names[occurrence] = field_name(lowering, decision_case->next, occurrence);
+                arm->bindings[f] = lowering->names[occurrence];
             }
         }
+        arm->body = lower_decision(lowering, decision_case->next);
+        if (!arm->body) {
+            nova_ir_expr_free(ir);
+            return NULL;
+        }
+    }
+    if (has_fallback) {
+        NovaIRMatchArm *arm = &ir->as.match_expr.arms[node->case_count];
+        arm->tag = SIZE_MAX;
+        arm->constructor = lowering->names[node->occurrence];
+        arm->body = lower_decision(lowering, node->fallback);
+        if (!arm->body) {
+            nova_ir_expr_free(ir);
+            return NULL;
+        }
+    }
+    return ir;
+}
+
+static NovaIRExpr *lower_decision(MatchLowering *lowering, const NovaDecision *node) {
+    if (!node) return NULL;
+    switch (node->kind) {
+    case NOVA_DECISION_ARM:
+        return lower_decision_arm(lowering, node);
+    case NOVA_DECISION_SWITCH:
+        return lower_decision_switch(lowering, node);
+    case NOVA_DECISION_FAIL:
+    default:
+        return lower_match_failure(lowering);
+    }
+}
+
+// Nested patterns and guards become a decision tree of single-level switches;
+// arms reached on more than one path are lowered once per path.
+static NovaIRExpr *lower_match(const NovaExpr *expr, const NovaSemanticContext *semantics, NovaIRProgram *program) {
+    const NovaExprInfo *info = nova_semantic_lookup_expr(semantics, expr);
+    NovaIRExpr *scrutinee = lower_expr(expr->as.match_expr.scrutinee, semantics, program);
+    if (!scrutinee) return NULL;
+    NovaMatchPlan plan;
+    if (!nova_match_compile(semantics, &expr->as.match_expr, scrutinee->type, &plan)) {
+        nova_ir_expr_free(scrutinee);
+        return NULL;
+    }
+    MatchLowering lowering{};
+    lowering.expr = expr;
+    lowering.semantics = semantics;
+    lowering.program = program;
+    lowering.plan = &plan;
+    lowering.type = info ? info->type : 0;
+    lowering.names = static_cast<NovaToken *>(calloc(plan.occurrence_count, sizeof(NovaToken)));
+    NovaIRExpr *subject = NULL;
+    if (lowering.names && scrutinee->kind == NOVA_IR_EXPR_IDENTIFIER) {
+        lowering.names[0] = scrutinee->as.identifier;
+    } else if (lowering.names) {
+        NovaToken base = expr->start_token;
+        base.lexeme = "subject";
+        base.length = 7;
+        lowering.names[0] = nova_ir_fresh_name(program, &base);
+        subject = nova_ir_expr_new(NOVA_IR_EXPR_LET, lowering.type);
+    }
+    NovaIRExpr *ir = NULL;
+    if (lowering.names && (scrutinee->kind == NOVA_IR_EXPR_IDENTIFIER || (subject && lowering.names[0].lexeme))) {
+        ir = lower_decision(&lowering, plan.root);
+    }
+    if (subject && ir) {
+        subject->as.let_expr.name = lowering.names[0];
+        subject->as.let_expr.value = scrutinee;
+        subject->as.let_expr.body = ir;
+        ir = subject;
+    } else {
+        nova_ir_expr_free(subject);
+        nova_ir_expr_free(scrutinee);
+    }
+    free(lowering.names);
+    nova_match_plan_free(&plan);
+    return ir;
+}
+
+static NovaIRExpr *bool_expr(const NovaSemanticContext *semantics, bool value) {
+    NovaIRExpr *ir = nova_ir_expr_new(NOVA_IR_EXPR_BOOL, semantics->type_bool);
+    if (ir) ir->as.bool_value = value;
+    return ir;
+}
+
+// `and` and `or` short-circuit, so they become conditionals rather than
+// operator nodes: `a and b` is `if a { b } else { false }`.
+static NovaIRExpr *lower_operator(const NovaExpr *expr, const NovaSemanticContext *semantics, NovaIRProgram *program) {
+    const NovaExprInfo *info = nova_semantic_lookup_expr(semantics, expr);
+    const NovaOperatorExpr *op = &expr->as.op;
+    bool logical = op->op == NOVA_OP_AND || op->op == NOVA_OP_OR;
+    NovaIRExpr *ir = nova_ir_expr_new(logical ? NOVA_IR_EXPR_IF : NOVA_IR_EXPR_OPERATOR, info ? info->type : 0);
+    if (!ir) return NULL;
+    NovaIRExpr *left = lower_expr(op->left, semantics, program);
+    NovaIRExpr *right = op->right ? lower_expr(op->right, semantics, program) : NULL;
+    if (!left || (op->right && !right)) {
+        nova_ir_expr_free(left);
+        nova_ir_expr_free(right);
+        nova_ir_expr_free(ir);
+        return NULL;
+    }
+    if (!logical) {
+        ir->as.op.op = op->op;
+        ir->as.op.left = left;
+        ir->as.op.right = right;
+        return ir;
+    }
+    NovaIRExpr *constant = bool_expr(semantics, op->op == NOVA_OP_OR);
+    ir->as.if_expr.condition = left;
+    ir->as.if_expr.then_branch = op->op == NOVA_OP_AND ? right : constant;
+    ir->as.if_expr.else_branch = op->op == NOVA_OP_AND ? constant : right;
+    if (!constant) {
+        nova_ir_expr_free(ir);
+        return NULL;
     }
     return ir;
 }
 
-static NovaIRExpr *lower_expr(const NovaExpr *expr, const NovaSemanticContext *semantics) {
+static NovaIRExpr *lower_expr(const NovaExpr *expr, const NovaSemanticContext *semantics, NovaIRProgram *program) {
     if (!expr) return NULL;
     switch (expr->kind) {
     case NOVA_EXPR_LITERAL:
     case NOVA_EXPR_LIST_LITERAL:
-        return lower_literal(expr, semantics);
+        return lower_literal(expr, semantics, program);
     case NOVA_EXPR_IDENTIFIER: {
         const NovaExprInfo *info = nova_semantic_lookup_expr(semantics, expr);
-        NovaIRExpr *ir = nova_ir_expr_new(NOVA_IR_EXPR_IDENTIFIER, info ? info->type : 0);
-        if (ir) {
+        NovaTypeId type = info ? info->type : 0;
+        size_t tag = constructor_tag(semantics, type, &expr->as.identifier.name, 0);
+        NovaIRExpr *ir = nova_ir_expr_new(tag == SIZE_MAX ? NOVA_IR_EXPR_IDENTIFIER : NOVA_IR_EXPR_CONSTRUCT, type);
+        if (ir && tag == SIZE_MAX) {
             ir->as.identifier = expr->as.identifier.name;
+        } else if (ir) {
+            ir->as.construct.constructor = expr->as.identifier.name;
+            ir->as.construct.tag = tag;
         }
         return ir;
     }
     case NOVA_EXPR_CALL:
-        return lower_call(expr, semantics);
+        return lower_call(expr, semantics, program);
     case NOVA_EXPR_PIPE:
-        return lower_pipeline(expr, semantics);
+        return lower_pipeline(expr, semantics, program);
     case NOVA_EXPR_IF:
-        return lower_if(expr, semantics);
+        return lower_if(expr, semantics, program);
     case NOVA_EXPR_WHILE:
-        return lower_while(expr, semantics);
+        return lower_while(expr, semantics, program);
     case NOVA_EXPR_BLOCK: {
         if (expr->as.block.expressions.count == 0) {
             return nova_ir_expr_new(NOVA_IR_EXPR_UNIT, semantics->type_unit);
         }
         if (expr->as.block.expressions.count == 1) {
-            return lower_expr(expr->as.block.expressions.items[0], semantics);
+            return lower_expr(expr->as.block.expressions.items[0], semantics, program);
         }
         const NovaExprInfo *info = nova_semantic_lookup_expr(semantics, expr);
         NovaIRExpr *sequence = nova_ir_expr_new(NOVA_IR_EXPR_SEQUENCE, info ? info->type : 0);
@@ -297,7 +834,7 @@ static NovaIRExpr *lower_expr(const NovaExpr *expr, const NovaSemanticContext *s
             return NULL;
         }
         for (size_t i = 0; i < count; ++i) {
-            sequence->as.sequence.items[i] = lower_expr(expr->as.block.expressions.items[i], semantics);
+            sequence->as.sequence.items[i] = lower_expr(expr->as.block.expressions.items[i], semantics, program);
             if (!sequence->as.sequence.items[i]) {
                 nova_ir_expr_free(sequence);
                 return NULL;
@@ -306,13 +843,23 @@ static NovaIRExpr *lower_expr(const NovaExpr *expr, const NovaSemanticContext *s
         return sequence;
     }
     case NOVA_EXPR_PAREN:
-        return lower_expr(expr->as.inner, semantics);
+        return lower_expr(expr->as.inner, semantics, program);
     case NOVA_EXPR_MATCH:
-        return lower_match(expr, semantics);
-    case NOVA_EXPR_ASYNC:
+        return lower_match(expr, semantics, program);
+    case NOVA_EXPR_LAMBDA:
+        return lower_lambda(expr, semantics, program);
+    case NOVA_EXPR_OPERATOR:
+        return lower_operator(expr, semantics, program);
     case NOVA_EXPR_AWAIT:
-    case NOVA_EXPR_EFFECT:
-        return lower_expr(expr->as.unary.value, semantics);
+        return lower_expr(expr->as.unary.value, semantics, program);
+    case NOVA_EXPR_ASYNC:
+    case NOVA_EXPR_EFFECT: {
+        // The markers disappear from the IR, so the calls underneath carry them instead.
+        NovaIRExpr *inner = lower_expr(expr->as.unary.value, semantics, program);
+        NovaEffectMask marker = expr->kind == NOVA_EXPR_ASYNC ? NOVA_EFFECT_ASYNC : NOVA_EFFECT_IMPURE;
+        mark_call_effects(&inner, &marker);
+        return inner;
+    }
     default:
         return NULL;
     }
@@ -328,6 +875,161 @@ static bool ir_expr_is_bool_constant(const NovaIRExpr *expr, bool *value) {
     return true;
 }
 
+static bool ir_expr_is_number_constant(const NovaIRExpr *expr, double *value) {
+    if (!expr || expr->kind != NOVA_IR_EXPR_NUMBER) {
+        return false;
+    }
+    *value = expr->as.number_value;
+    return true;
+}
+
+static void replace_operator_with_constant(NovaIRExpr *expr, NovaIRExprKind kind, double number, bool boolean) {
+    nova_ir_expr_free(expr->as.op.left);
+    nova_ir_expr_free(expr->as.op.right);
+    expr->kind = kind;
+    if (kind == NOVA_IR_EXPR_NUMBER) {
+        expr->as.number_value = number;
+    } else {
+        expr->as.bool_value = boolean;
+    }
+}
+
+static bool ir_expr_is_int_constant(const NovaIRExpr *expr, int64_t *value) {
+    if (!expr || expr->kind != NOVA_IR_EXPR_INT) {
+        return false;
+    }
+    *value = expr->as.int_value;
+    return true;
+}
+
+static void replace_operator_with_int(NovaIRExpr *expr, int64_t value) {
+    nova_ir_expr_free(expr->as.op.left);
+    nova_ir_expr_free(expr->as.op.right);
+    expr->kind = NOVA_IR_EXPR_INT;
+    expr->as.int_value = value;
+}
+
+// Int(x) truncates toward zero and saturates; NaN converts to 0.
+static int64_t number_to_int(double value) {
+    if (isnan(value)) return 0;
+    if (value >= 9223372036854775808.0) return INT64_MAX;
+    if (value < -9223372036854775808.0) return INT64_MIN;
+    return (int64_t)value;
+}
+
+// Int arithmetic wraps on overflow, as the generated code does. Division and
+// remainder by zero are left for the program to trap on at run time.
+static bool fold_int_operator(NovaIRExpr *expr) {
+    int64_t a = 0, b = 0;
+    if (!ir_expr_is_int_constant(expr->as.op.left, &a)) return false;
+    if (expr->as.op.right && !ir_expr_is_int_constant(expr->as.op.right, &b)) return false;
+    uint64_t ua = (uint64_t)a, ub = (uint64_t)b;
+    switch (expr->as.op.op) {
+    case NOVA_OP_ADD: replace_operator_with_int(expr, (int64_t)(ua + ub)); return true;
+    case NOVA_OP_SUB: replace_operator_with_int(expr, (int64_t)(ua - ub)); return true;
+    case NOVA_OP_MUL: replace_operator_with_int(expr, (int64_t)(ua * ub)); return true;
+    case NOVA_OP_DIV:
+        if (b == 0) return false;
+        replace_operator_with_int(expr, b == -1 ? (int64_t)(0 - ua) : a / b);
+        return true;
+    case NOVA_OP_MOD:
+        if (b == 0) return false;
+        replace_operator_with_int(expr, b == -1 ? 0 : a % b);
+        return true;
+    case NOVA_OP_NEG: replace_operator_with_int(expr, (int64_t)(0 - ua)); return true;
+    case NOVA_OP_LT: replace_operator_with_constant(expr, NOVA_IR_EXPR_BOOL, 0, a < b); return true;
+    case NOVA_OP_LE: replace_operator_with_constant(expr, NOVA_IR_EXPR_BOOL, 0, a <= b); return true;
+    case NOVA_OP_GT: replace_operator_with_constant(expr, NOVA_IR_EXPR_BOOL, 0, a > b); return true;
+    case NOVA_OP_GE: replace_operator_with_constant(expr, NOVA_IR_EXPR_BOOL, 0, a >= b); return true;
+    case NOVA_OP_EQ: replace_operator_with_constant(expr, NOVA_IR_EXPR_BOOL, 0, a == b); return true;
+    case NOVA_OP_NE: replace_operator_with_constant(expr, NOVA_IR_EXPR_BOOL, 0, a != b); return true;
+    case NOVA_OP_TO_NUMBER: replace_operator_with_constant(expr, NOVA_IR_EXPR_NUMBER, (double)a, false); return true;
+    case NOVA_OP_TO_INT:
+    case NOVA_OP_NOT:
+    case NOVA_OP_AND:
+    case NOVA_OP_OR:
+    case NOVA_OP_LIST_LENGTH:
+    case NOVA_OP_LIST_GET:
+    case NOVA_OP_LIST_PUSH:
+    case NOVA_OP_MAP_NEW:
+    case NOVA_OP_MAP_LENGTH:
+    case NOVA_OP_MAP_GET:
+    case NOVA_OP_MAP_HAS:
+    case NOVA_OP_MAP_PUT:
+    case NOVA_OP_MAP_REMOVE:
+        return false;
+    }
+    return false;
+}
+
+// Replaces expr with its only operand.
+static void splice_operand(NovaIRExpr *expr) {
+    NovaIRExpr *inner = expr->as.op.left;
+    NovaIRExpr temp = *inner;
+    free(inner);
+    *expr = temp;
+}
+
+// Evaluates operators whose operands are constants, with the same IEEE
+// double semantics the generated code has, and cancels double negation.
+static void fold_operator(NovaIRExpr **expr_ptr) {
+    NovaIRExpr *expr = *expr_ptr;
+    NovaIRExpr *left = expr->as.op.left;
+    if (fold_int_operator(expr)) return;
+    double a = 0, b = 0;
+    bool p = false, q = false;
+    bool numbers = ir_expr_is_number_constant(left, &a) && ir_expr_is_number_constant(expr->as.op.right, &b);
+    bool bools = ir_expr_is_bool_constant(left, &p) && ir_expr_is_bool_constant(expr->as.op.right, &q);
+    switch (expr->as.op.op) {
+    case NOVA_OP_ADD: if (numbers) replace_operator_with_constant(expr, NOVA_IR_EXPR_NUMBER, a + b, false); return;
+    case NOVA_OP_SUB: if (numbers) replace_operator_with_constant(expr, NOVA_IR_EXPR_NUMBER, a - b, false); return;
+    case NOVA_OP_MUL: if (numbers) replace_operator_with_constant(expr, NOVA_IR_EXPR_NUMBER, a * b, false); return;
+    case NOVA_OP_DIV: if (numbers) replace_operator_with_constant(expr, NOVA_IR_EXPR_NUMBER, a / b, false); return;
+    case NOVA_OP_MOD: if (numbers) replace_operator_with_constant(expr, NOVA_IR_EXPR_NUMBER, fmod(a, b), false); return;
+    case NOVA_OP_LT: if (numbers) replace_operator_with_constant(expr, NOVA_IR_EXPR_BOOL, 0, a < b); return;
+    case NOVA_OP_LE: if (numbers) replace_operator_with_constant(expr, NOVA_IR_EXPR_BOOL, 0, a <= b); return;
+    case NOVA_OP_GT: if (numbers) replace_operator_with_constant(expr, NOVA_IR_EXPR_BOOL, 0, a > b); return;
+    case NOVA_OP_GE: if (numbers) replace_operator_with_constant(expr, NOVA_IR_EXPR_BOOL, 0, a >= b); return;
+    case NOVA_OP_EQ:
+        if (numbers || bools) replace_operator_with_constant(expr, NOVA_IR_EXPR_BOOL, 0, numbers ? a == b : p == q);
+        return;
+    case NOVA_OP_NE:
+        if (numbers || bools) replace_operator_with_constant(expr, NOVA_IR_EXPR_BOOL, 0, numbers ? a != b : p != q);
+        return;
+    case NOVA_OP_NEG:
+    case NOVA_OP_NOT:
+        if (ir_expr_is_number_constant(left, &a) && expr->as.op.op == NOVA_OP_NEG) {
+            replace_operator_with_constant(expr, NOVA_IR_EXPR_NUMBER, -a, false);
+        } else if (ir_expr_is_bool_constant(left, &p) && expr->as.op.op == NOVA_OP_NOT) {
+            replace_operator_with_constant(expr, NOVA_IR_EXPR_BOOL, 0, !p);
+        } else if (left && left->kind == NOVA_IR_EXPR_OPERATOR && left->as.op.op == expr->as.op.op) {
+            splice_operand(left);
+            splice_operand(expr);
+        }
+        return;
+    case NOVA_OP_TO_INT:
+    case NOVA_OP_TO_NUMBER:
+        if (left && left->type == expr->type) {
+            splice_operand(expr);
+        } else if (ir_expr_is_number_constant(left, &a)) {
+            replace_operator_with_int(expr, number_to_int(a));
+        }
+        return;
+    case NOVA_OP_AND:
+    case NOVA_OP_OR:
+    case NOVA_OP_LIST_LENGTH:
+    case NOVA_OP_LIST_GET:
+    case NOVA_OP_LIST_PUSH:
+    case NOVA_OP_MAP_NEW:
+    case NOVA_OP_MAP_LENGTH:
+    case NOVA_OP_MAP_GET:
+    case NOVA_OP_MAP_HAS:
+    case NOVA_OP_MAP_PUT:
+    case NOVA_OP_MAP_REMOVE:
+        return;
+    }
+}
+
 static void optimize_ir_expr(NovaIRExpr **expr_ptr) {
     if (!expr_ptr || !*expr_ptr) {
         return;
@@ -406,7 +1108,7 @@ static void optimize_ir_expr(NovaIRExpr **expr_ptr) {
         }
         if (expr->as.match_expr.arm_count == 1 && expr->as.match_expr.arms) {
             NovaIRMatchArm *arm = &expr->as.match_expr.arms[0];
-            if (arm->binding_count == 0) {
+            if (arm->binding_count == 0 && !arm->literal) {
                 NovaIRExpr *scrutinee = expr->as.match_expr.scrutinee;
                 NovaIRExpr *body = arm->body;
                 free(arm->bindings);
@@ -423,7 +1125,33 @@ static void optimize_ir_expr(NovaIRExpr **expr_ptr) {
             }
         }
         break;
+    case NOVA_IR_EXPR_LET:
+        optimize_ir_expr(&expr->as.let_expr.value);
+        optimize_ir_expr(&expr->as.let_expr.body);
+        break;
+    case NOVA_IR_EXPR_ASSIGN:
+        optimize_ir_expr(&expr->as.assign.value);
+        break;
+    case NOVA_IR_EXPR_CONSTRUCT:
+        for (size_t i = 0; i < expr->as.construct.arg_count; ++i) {
+            optimize_ir_expr(&expr->as.construct.args[i]);
+        }
+        break;
+    case NOVA_IR_EXPR_OPERATOR:
+        optimize_ir_expr(&expr->as.op.left);
+        optimize_ir_expr(&expr->as.op.right);
+        optimize_ir_expr(&expr->as.op.third);
+        fold_operator(expr_ptr);
+        break;
+    case NOVA_IR_EXPR_APPLY:
+        optimize_ir_expr(&expr->as.apply.callee);
+        for (size_t i = 0; i < expr->as.apply.arg_count; ++i) {
+            optimize_ir_expr(&expr->as.apply.args[i]);
+        }
+        break;
+    case NOVA_IR_EXPR_CLOSURE:
     case NOVA_IR_EXPR_NUMBER:
+    case NOVA_IR_EXPR_INT:
     case NOVA_IR_EXPR_STRING:
     case NOVA_IR_EXPR_BOOL:
     case NOVA_IR_EXPR_UNIT:
@@ -432,13 +1160,21 @@ static void optimize_ir_expr(NovaIRExpr **expr_ptr) {
     }
 }
 
+void nova_ir_fold_constants(NovaIRExpr **expr) {
+    optimize_ir_expr(expr);
+}
+
 static void nova_ir_function_init(NovaIRFunction *fn) {
+    fn->profile_calls = 0;
     fn->params = NULL;
     fn->param_count = 0;
     fn->body = NULL;
+    fn->capture_count = 0;
+    fn->lifted = false;
+    fn->internal = false;
 }
 
-static void nova_ir_expr_free(NovaIRExpr *expr) {
+void nova_ir_expr_free(NovaIRExpr *expr) {
     if (!expr) return;
     switch (expr->kind) {
     case NOVA_IR_EXPR_STRING:
@@ -468,6 +1204,14 @@ static void nova_ir_expr_free(NovaIRExpr *expr) {
             free(expr->as.call.args);
         }
         break;
+    case NOVA_IR_EXPR_CONSTRUCT:
+        if (expr->as.construct.args) {
+            for (size_t i = 0; i < expr->as.construct.arg_count; ++i) {
+                nova_ir_expr_free(expr->as.construct.args[i]);
+            }
+            free(expr->as.construct.args);
+        }
+        break;
     case NOVA_IR_EXPR_IF:
         nova_ir_expr_free(expr->as.if_expr.condition);
         nova_ir_expr_free(expr->as.if_expr.then_branch);
@@ -482,39 +1226,980 @@ static void nova_ir_expr_free(NovaIRExpr *expr) {
         if (expr->as.match_expr.arms) {
             for (size_t i = 0; i < expr->as.match_expr.arm_count; ++i) {
                 free(expr->as.match_expr.arms[i].bindings);
+                nova_ir_expr_free(expr->as.match_expr.arms[i].literal);
                 nova_ir_expr_free(expr->as.match_expr.arms[i].body);
             }
             free(expr->as.match_expr.arms);
         }
         break;
+    case NOVA_IR_EXPR_LET:
+        nova_ir_expr_free(expr->as.let_expr.value);
+        nova_ir_expr_free(expr->as.let_expr.body);
+        break;
+    case NOVA_IR_EXPR_ASSIGN:
+        nova_ir_expr_free(expr->as.assign.value);
+        break;
+    case NOVA_IR_EXPR_OPERATOR:
+        nova_ir_expr_free(expr->as.op.left);
+        nova_ir_expr_free(expr->as.op.right);
+        nova_ir_expr_free(expr->as.op.third);
+        break;
+    case NOVA_IR_EXPR_CLOSURE:
+        if (expr->as.closure.captures) {
+            for (size_t i = 0; i < expr->as.closure.capture_count; ++i) {
+                nova_ir_expr_free(expr->as.closure.captures[i]);
+            }
+            free(expr->as.closure.captures);
+        }
+        break;
+    case NOVA_IR_EXPR_APPLY:
+        nova_ir_expr_free(expr->as.apply.callee);
+        if (expr->as.apply.args) {
+            for (size_t i = 0; i < expr->as.apply.arg_count; ++i) {
+                nova_ir_expr_free(expr->as.apply.args[i]);
+            }
+            free(expr->as.apply.args);
+        }
+        break;
     default:
         break;
     }
     free(expr);
 }
 
-static void nova_ir_function_free(NovaIRFunction *fn) {
+static NovaIRExpr **clone_expr_array(NovaIRExpr *const *items, size_t count, bool *ok) {
+    if (count == 0) return NULL;
+    NovaIRExpr **copy = static_cast<NovaIRExpr **>(calloc(count, sizeof(NovaIRExpr *)));
+    if (!copy) {
+        *ok = false;
+        return NULL;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        copy[i] = nova_ir_expr_clone(items[i]);
+        if (items[i] && !copy[i]) *ok = false;
+    }
+    return copy;
+}
+
+NovaIRExpr *nova_ir_expr_clone(const NovaIRExpr *expr) {
+    if (!expr) return NULL;
+    NovaIRExpr *copy = nova_ir_expr_new(expr->kind, expr->type);
+    if (!copy) return NULL;
+    *copy = *expr;
+    bool ok = true;
+    switch (expr->kind) {
+    case NOVA_IR_EXPR_STRING:
+        if (expr->as.string_value.text) {
+            copy->as.string_value.text = strdup(expr->as.string_value.text);
+            ok = copy->as.string_value.text != NULL;
+        }
+        break;
+    case NOVA_IR_EXPR_LIST:
+        copy->as.list.elements = clone_expr_array(expr->as.list.elements, expr->as.list.count, &ok);
+        break;
+    case NOVA_IR_EXPR_SEQUENCE:
+        copy->as.sequence.items = clone_expr_array(expr->as.sequence.items, expr->as.sequence.count, &ok);
+        break;
+    case NOVA_IR_EXPR_CALL:
+        copy->as.call.args = clone_expr_array(expr->as.call.args, expr->as.call.arg_count, &ok);
+        break;
+    case NOVA_IR_EXPR_CONSTRUCT:
+        copy->as.construct.args = clone_expr_array(expr->as.construct.args, expr->as.construct.arg_count, &ok);
+        break;
+    case NOVA_IR_EXPR_IF:
+        copy->as.if_expr.condition = nova_ir_expr_clone(expr->as.if_expr.condition);
+        copy->as.if_expr.then_branch = nova_ir_expr_clone(expr->as.if_expr.then_branch);
+        copy->as.if_expr.else_branch = nova_ir_expr_clone(expr->as.if_expr.else_branch);
+        ok = copy->as.if_expr.condition && copy->as.if_expr.then_branch &&
+             (copy->as.if_expr.else_branch || !expr->as.if_expr.else_branch);
+        break;
+    case NOVA_IR_EXPR_WHILE:
+        copy->as.while_expr.condition = nova_ir_expr_clone(expr->as.while_expr.condition);
+        copy->as.while_expr.body = nova_ir_expr_clone(expr->as.while_expr.body);
+        ok = copy->as.while_expr.condition && copy->as.while_expr.body;
+        break;
+    case NOVA_IR_EXPR_MATCH:
+        copy->as.match_expr.scrutinee = nova_ir_expr_clone(expr->as.match_expr.scrutinee);
+        copy->as.match_expr.arms = NULL;
+        ok = copy->as.match_expr.scrutinee != NULL;
+        if (ok && expr->as.match_expr.arm_count > 0) {
+            copy->as.match_expr.arms = static_cast<NovaIRMatchArm *>(calloc(expr->as.match_expr.arm_count, sizeof(NovaIRMatchArm)));
+            if (!copy->as.match_expr.arms) {
+                copy->as.match_expr.arm_count = 0;
+                ok = false;
+                break;
+            }
+            for (size_t i = 0; i < expr->as.match_expr.arm_count; ++i) {
+                const NovaIRMatchArm *arm = &expr->as.match_expr.arms[i];
+                NovaIRMatchArm *arm_copy = &copy->as.match_expr.arms[i];
+                *arm_copy = *arm;
+                arm_copy->bindings = NULL;
+                if (arm->binding_count > 0) {
+                    arm_copy->bindings = static_cast<NovaToken *>(malloc(arm->binding_count * sizeof(NovaToken)));
+                    if (arm_copy->bindings) {
+                        memcpy(arm_copy->bindings, arm->bindings, arm->binding_count * sizeof(NovaToken));
+                    } else {
+                        ok = false;
+                    }
+                }
+                arm_copy->literal = arm->literal ? nova_ir_expr_clone(arm->literal) : NULL;
+                if (arm->literal && !arm_copy->literal) ok = false;
+                arm_copy->body = nova_ir_expr_clone(arm->body);
+                if (!arm_copy->body) ok = false;
+            }
+        }
+        break;
+    case NOVA_IR_EXPR_LET:
+        copy->as.let_expr.value = nova_ir_expr_clone(expr->as.let_expr.value);
+        copy->as.let_expr.body = nova_ir_expr_clone(expr->as.let_expr.body);
+        ok = copy->as.let_expr.value && copy->as.let_expr.body;
+        break;
+    case NOVA_IR_EXPR_ASSIGN:
+        copy->as.assign.value = nova_ir_expr_clone(expr->as.assign.value);
+        ok = copy->as.assign.value != NULL;
+        break;
+    case NOVA_IR_EXPR_OPERATOR:
+        copy->as.op.left = nova_ir_expr_clone(expr->as.op.left);
+        copy->as.op.right = nova_ir_expr_clone(expr->as.op.right);
+        copy->as.op.third = nova_ir_expr_clone(expr->as.op.third);
+        ok = copy->as.op.left && (copy->as.op.right || !expr->as.op.right) && (copy->as.op.third || !expr->as.op.third);
+        break;
+    case NOVA_IR_EXPR_CLOSURE:
+        copy->as.closure.captures = clone_expr_array(expr->as.closure.captures, expr->as.closure.capture_count, &ok);
+        break;
+    case NOVA_IR_EXPR_APPLY:
+        copy->as.apply.args = clone_expr_array(expr->as.apply.args, expr->as.apply.arg_count, &ok);
+        copy->as.apply.callee = nova_ir_expr_clone(expr->as.apply.callee);
+        if (!copy->as.apply.callee) ok = false;
+        break;
+    default:
+        break;
+    }
+    if (!ok) {
+        nova_ir_expr_free(copy);
+        return NULL;
+    }
+    return copy;
+}
+
+void nova_ir_expr_for_each_child(NovaIRExpr *expr, NovaIRChildFn fn, void *ctx) {
+    if (!expr) return;
+    switch (expr->kind) {
+    case NOVA_IR_EXPR_LIST:
+        for (size_t i = 0; i < expr->as.list.count; ++i) fn(&expr->as.list.elements[i], ctx);
+        break;
+    case NOVA_IR_EXPR_SEQUENCE:
+        for (size_t i = 0; i < expr->as.sequence.count; ++i) fn(&expr->as.sequence.items[i], ctx);
+        break;
+    case NOVA_IR_EXPR_CALL:
+        for (size_t i = 0; i < expr->as.call.arg_count; ++i) fn(&expr->as.call.args[i], ctx);
+        break;
+    case NOVA_IR_EXPR_CONSTRUCT:
+        for (size_t i = 0; i < expr->as.construct.arg_count; ++i) fn(&expr->as.construct.args[i], ctx);
+        break;
+    case NOVA_IR_EXPR_IF:
+        fn(&expr->as.if_expr.condition, ctx);
+        fn(&expr->as.if_expr.then_branch, ctx);
+        if (expr->as.if_expr.else_branch) fn(&expr->as.if_expr.else_branch, ctx);
+        break;
+    case NOVA_IR_EXPR_WHILE:
+        fn(&expr->as.while_expr.condition, ctx);
+        fn(&expr->as.while_expr.body, ctx);
+        break;
+    case NOVA_IR_EXPR_MATCH:
+        fn(&expr->as.match_expr.scrutinee, ctx);
+        for (size_t i = 0; i < expr->as.match_expr.arm_count; ++i) fn(&expr->as.match_expr.arms[i].body, ctx);
+        break;
+    case NOVA_IR_EXPR_LET:
+        fn(&expr->as.let_expr.value, ctx);
+        fn(&expr->as.let_expr.body, ctx);
+        break;
+    case NOVA_IR_EXPR_ASSIGN:
+        fn(&expr->as.assign.value, ctx);
+        break;
+    case NOVA_IR_EXPR_OPERATOR:
+        fn(&expr->as.op.left, ctx);
+        if (expr->as.op.right) fn(&expr->as.op.right, ctx);
+        if (expr->as.op.third) fn(&expr->as.op.third, ctx);
+        break;
+    case NOVA_IR_EXPR_CLOSURE:
+        for (size_t i = 0; i < expr->as.closure.capture_count; ++i) fn(&expr->as.closure.captures[i], ctx);
+        break;
+    case NOVA_IR_EXPR_APPLY:
+        fn(&expr->as.apply.callee, ctx);
+        for (size_t i = 0; i < expr->as.apply.arg_count; ++i) fn(&expr->as.apply.args[i], ctx);
+        break;
+    case NOVA_IR_EXPR_NUMBER:
+    case NOVA_IR_EXPR_INT:
+    case NOVA_IR_EXPR_STRING:
+    case NOVA_IR_EXPR_BOOL:
+    case NOVA_IR_EXPR_UNIT:
+    case NOVA_IR_EXPR_IDENTIFIER:
+        break;
+    }
+}
+
+static void count_child_size(NovaIRExpr **slot, void *ctx) {
+    *static_cast<size_t *>(ctx) += nova_ir_expr_size(*slot);
+}
+
+size_t nova_ir_expr_size(const NovaIRExpr *expr) {
+    if (!expr) return 0;
+    size_t size = 1;
+    nova_ir_expr_for_each_child(const_cast<NovaIRExpr *>(expr), count_child_size, &size);
+    return size;
+}
+
+NovaToken nova_ir_fresh_name(NovaIRProgram *program, const NovaToken *base) {
+    NovaToken token{};
+    token.type = NOVA_TOKEN_IDENTIFIER;
+    size_t base_length = base ? base->length : 0;
+    const char *base_text = base ? base->lexeme : "";
+    // Strip a previous "__<n>" suffix so repeated renaming keeps names short.
+    for (size_t i = base_length; i > 2; --i) {
+        char c = base_text[i - 1];
+        if (c >= '0' && c <= '9') continue;
+        if (c == '_' && base_text[i - 2] == '_' && i < base_length) {
+            base_length = i - 2;
+        }
+        break;
+    }
+    if (base_length == 0) {
+        base_text = "tmp";
+        base_length = 3;
+    }
+    if (base) {
+        token.line = base->line;
+        token.column = base->column;
+    }
+    if (program->name_count == program->name_capacity) {
+        size_t new_capacity = program->name_capacity == 0 ? 16 : program->name_capacity * 2;
+        char **names = static_cast<char **>(realloc(program->names, new_capacity * sizeof(char *)));
+        if (!names) return token;
+        program->names = names;
+        program->name_capacity = new_capacity;
+    }
+    size_t size = base_length + 24;
+    char *text = static_cast<char *>(malloc(size));
+    if (!text) return token;
+    int written = snprintf(text, size, "%.*s__%zu", (int)base_length, base_text, ++program->name_counter);
+    program->names[program->name_count++] = text;
+    token.lexeme = text;
+    token.length = written > 0 ? (size_t)written : 0;
+    return token;
+}
+
+size_t nova_ir_intern_string(NovaIRProgram *program, const char *literal) {
+    size_t length = 0;
+    char *bytes = nova_match_decode_string(literal, strlen(literal), &length);
+    if (!bytes) return SIZE_MAX;
+    for (size_t i = 0; i < program->string_count; ++i) {
+        const NovaIRString *entry = &program->strings[i];
+        if (entry->length == length && memcmp(entry->bytes, bytes, length) == 0) {
+            free(bytes);
+            return i;
+        }
+    }
+    if (program->string_count == program->string_capacity) {
+        size_t new_capacity = program->string_capacity == 0 ? 8 : program->string_capacity * 2;
+        NovaIRString *strings = static_cast<NovaIRString *>(realloc(program->strings, new_capacity * sizeof(NovaIRString)));
+        if (!strings) {
+            free(bytes);
+            return SIZE_MAX;
+        }
+        program->strings = strings;
+        program->string_capacity = new_capacity;
+    }
+    program->strings[program->string_count].bytes = bytes;
+    program->strings[program->string_count].length = length;
+    return program->string_count++;
+}
+
+size_t nova_ir_find_function(const NovaIRProgram *program, const NovaToken *name) {
+    if (!program || !name) return SIZE_MAX;
+    for (size_t i = 0; i < program->function_count; ++i) {
+        if (token_equals(&program->functions[i].name, name)) {
+            return i;
+        }
+    }
+    return SIZE_MAX;
+}
+
+typedef struct {
+    const NovaIRProgram *program;
+    NovaIRCallGraph *graph;
+    size_t caller;
+    size_t *last_caller; // last_caller[callee] == caller + 1 when the edge is already recorded
+    bool ok;
+} CallGraphBuilder;
+
+static size_t token_hash(const NovaToken *token) {
+    size_t hash = 1469598103934665603ull;
+    for (size_t i = 0; i < token->length; ++i) {
+        hash ^= (unsigned char)token->lexeme[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+size_t nova_ir_call_graph_lookup(const NovaIRCallGraph *graph, const NovaIRProgram *program, const NovaToken *name) {
+    if (!graph || !graph->name_slots || !name) return SIZE_MAX;
+    size_t slot = token_hash(name) & graph->name_mask;
+    while (graph->name_slots[slot]) {
+        size_t index = graph->name_slots[slot] - 1;
+        if (token_equals(&program->functions[index].name, name)) {
+            return index;
+        }
+        slot = (slot + 1) & graph->name_mask;
+    }
+    return SIZE_MAX;
+}
+
+static void call_graph_visit(NovaIRExpr **slot, void *ctx) {
+    CallGraphBuilder *builder = static_cast<CallGraphBuilder *>(ctx);
+    const NovaIRExpr *expr = *slot;
+    if (!expr) return;
+    // Functions passed around as values keep their definitions alive just like calls do.
+    const NovaToken *target = NULL;
+    if (expr->kind == NOVA_IR_EXPR_CALL) {
+        target = &expr->as.call.callee;
+    } else if (expr->kind == NOVA_IR_EXPR_IDENTIFIER) {
+        target = &expr->as.identifier;
+    } else if (expr->kind == NOVA_IR_EXPR_CLOSURE) {
+        target = &expr->as.closure.function;
+    }
+    if (target) {
+        size_t callee = nova_ir_call_graph_lookup(builder->graph, builder->program, target);
+        if (callee != SIZE_MAX) {
+            if (expr->kind == NOVA_IR_EXPR_CALL) {
+                builder->graph->nodes[callee].call_site_count++;
+            }
+            if (builder->last_caller[callee] != builder->caller + 1) {
+                builder->last_caller[callee] = builder->caller + 1;
+                NovaIRCallGraphNode *node = &builder->graph->nodes[builder->caller];
+                if (node->callee_count == node->callee_capacity) {
+                    size_t new_capacity = node->callee_capacity == 0 ? 4 : node->callee_capacity * 2;
+                    size_t *callees = static_cast<size_t *>(realloc(node->callees, new_capacity * sizeof(size_t)));
+                    if (!callees) {
+                        builder->ok = false;
+                        return;
+                    }
+                    node->callees = callees;
+                    node->callee_capacity = new_capacity;
+                }
+                node->callees[node->callee_count++] = callee;
+                if (callee == builder->caller) {
+                    node->recursive = true;
+                }
+            }
+        }
+    }
+    nova_ir_expr_for_each_child(*slot, call_graph_visit, ctx);
+}
+
+typedef struct {
+    NovaIRCallGraph *graph;
+    size_t *index;
+    size_t *lowlink;
+    bool *on_stack;
+    size_t *stack;
+    size_t stack_count;
+    size_t next_index;
+    size_t order_count;
+} TarjanState;
+
+// Tarjan's algorithm emits strongly connected components callees-first, which
+// is exactly the bottom-up order interprocedural passes want.
+static void tarjan_visit(TarjanState *state, size_t v) {
+    state->index[v] = state->lowlink[v] = ++state->next_index;
+    state->stack[state->stack_count++] = v;
+    state->on_stack[v] = true;
+    const NovaIRCallGraphNode *node = &state->graph->nodes[v];
+    for (size_t i = 0; i < node->callee_count; ++i) {
+        size_t w = node->callees[i];
+        if (state->index[w] == 0) {
+            tarjan_visit(state, w);
+            if (state->lowlink[w] < state->lowlink[v]) state->lowlink[v] = state->lowlink[w];
+        } else if (state->on_stack[w] && state->index[w] < state->lowlink[v]) {
+            state->lowlink[v] = state->index[w];
+        }
+    }
+    if (state->lowlink[v] != state->index[v]) {
+        return;
+    }
+    size_t first = state->order_count;
+    size_t w;
+    do {
+        w = state->stack[--state->stack_count];
+        state->on_stack[w] = false;
+        state->graph->bottom_up[state->order_count++] = w;
+    } while (w != v);
+    if (state->order_count - first > 1) {
+        for (size_t i = first; i < state->order_count; ++i) {
+            state->graph->nodes[state->graph->bottom_up[i]].recursive = true;
+        }
+    }
+}
+
+bool nova_ir_call_graph_build(const NovaIRProgram *program, NovaIRCallGraph *graph) {
+    graph->nodes = NULL;
+    graph->node_count = 0;
+    graph->bottom_up = NULL;
+    graph->name_slots = NULL;
+    graph->name_mask = 0;
+    if (!program || program->function_count == 0) {
+        return true;
+    }
+    size_t n = program->function_count;
+    graph->nodes = static_cast<NovaIRCallGraphNode *>(calloc(n, sizeof(NovaIRCallGraphNode)));
+    graph->bottom_up = static_cast<size_t *>(calloc(n, sizeof(size_t)));
+    graph->node_count = n;
+    size_t capacity = 16;
+    while (capacity < n * 2) capacity *= 2;
+    CallGraphBuilder builder{};
+    builder.program = program;
+    builder.graph = graph;
+    graph->name_slots = static_cast<size_t *>(calloc(capacity, sizeof(size_t)));
+    graph->name_mask = capacity - 1;
+    builder.last_caller = static_cast<size_t *>(calloc(n, sizeof(size_t)));
+    builder.ok = graph->nodes && graph->bottom_up && graph->name_slots && builder.last_caller;
+    if (builder.ok) {
+        for (size_t i = 0; i < n; ++i) {
+            size_t slot = token_hash(&program->functions[i].name) & graph->name_mask;
+            while (graph->name_slots[slot]) slot = (slot + 1) & graph->name_mask;
+            graph->name_slots[slot] = i + 1;
+        }
+        for (size_t i = 0; i < n && builder.ok; ++i) {
+            builder.caller = i;
+            NovaIRExpr *body = program->functions[i].body;
+            call_graph_visit(&body, &builder);
+        }
+    }
+    free(builder.last_caller);
+
+    TarjanState state{};
+    state.graph = graph;
+    state.index = static_cast<size_t *>(calloc(n, sizeof(size_t)));
+    state.lowlink = static_cast<size_t *>(calloc(n, sizeof(size_t)));
+    state.on_stack = static_cast<bool *>(calloc(n, sizeof(bool)));
+    state.stack = static_cast<size_t *>(calloc(n, sizeof(size_t)));
+    bool ok = builder.ok && state.index && state.lowlink && state.on_stack && state.stack;
+    if (ok) {
+        for (size_t i = 0; i < n; ++i) {
+            if (state.index[i] == 0) tarjan_visit(&state, i);
+        }
+    }
+    free(state.index);
+    free(state.lowlink);
+    free(state.on_stack);
+    free(state.stack);
+    if (!ok) {
+        nova_ir_call_graph_free(graph);
+        return false;
+    }
+    return true;
+}
+
+void nova_ir_call_graph_free(NovaIRCallGraph *graph) {
+    if (!graph) return;
+    for (size_t i = 0; graph->nodes && i < graph->node_count; ++i) {
+        free(graph->nodes[i].callees);
+    }
+    free(graph->nodes);
+    free(graph->bottom_up);
+    free(graph->name_slots);
+    graph->nodes = NULL;
+    graph->bottom_up = NULL;
+    graph->name_slots = NULL;
+    graph->node_count = 0;
+}
+
+typedef struct {
+    NovaToken name;
+    NovaTypeId type;
+    const NovaIRExpr *closure; // the closure a let binding is known to hold; NULL otherwise
+    size_t depth; // binders in scope where that closure was built
+} ClosureBinder;
+
+typedef struct {
+    NovaIRProgram *program;
+    const NovaSemanticContext *semantics;
+    const NovaIRExpr *root; // function body, searched for assignments
+    ClosureBinder *binders;
+    size_t count;
+    size_t capacity;
+    bool *converted; // per function: lifted lambdas whose captures are resolved
+    size_t rewritten;
+    bool ok;
+} ClosureScope;
+
+static bool closure_scope_push(ClosureScope *scope, NovaToken name, NovaTypeId type, const NovaIRExpr *closure, size_t depth) {
+    if (scope->count == scope->capacity) {
+        size_t new_capacity = scope->capacity == 0 ? 16 : scope->capacity * 2;
+        ClosureBinder *binders = static_cast<ClosureBinder *>(realloc(scope->binders, new_capacity * sizeof(ClosureBinder)));
+        if (!binders) {
+            scope->ok = false;
+            return false;
+        }
+        scope->binders = binders;
+        scope->capacity = new_capacity;
+    }
+    ClosureBinder *binder = &scope->binders[scope->count++];
+    binder->name = name;
+    binder->type = type;
+    binder->closure = closure;
+    binder->depth = depth;
+    return true;
+}
+
+// Innermost binder among the first limit ones, or SIZE_MAX.
+static size_t closure_scope_find(const ClosureScope *scope, const NovaToken *name, size_t limit) {
+    for (size_t i = limit; i > 0; --i) {
+        if (token_equals(&scope->binders[i - 1].name, name)) return i - 1;
+    }
+    return SIZE_MAX;
+}
+
+static size_t push_arm_bindings(ClosureScope *scope, const NovaIRExpr *match, const NovaIRMatchArm *arm) {
+    const NovaTypeRecord *record = arm->tag != SIZE_MAX ? nova_semantic_type_record(scope->semantics, match->as.match_expr.scrutinee->type) : NULL;
+    for (size_t b = 0; b < arm->binding_count; ++b) {
+        NovaTypeId type = record && b < record->variants[arm->tag].arity ? record->variants[arm->tag].payload_types[b] : match->as.match_expr.scrutinee->type;
+        if (!closure_scope_push(scope, arm->bindings[b], type, NULL, 0)) return b;
+    }
+    return arm->binding_count;
+}
+
+typedef struct {
+    const NovaToken *name;
+    bool found;
+} AssignSearch;
+
+static void find_assignment_to(NovaIRExpr **slot, void *ctx) {
+    AssignSearch *search = static_cast<AssignSearch *>(ctx);
+    NovaIRExpr *expr = *slot;
+    if (!expr || search->found) return;
+    if (expr->kind == NOVA_IR_EXPR_ASSIGN && token_equals(&expr->as.assign.target, search->name)) {
+        search->found = true;
+        return;
+    }
+    nova_ir_expr_for_each_child(expr, find_assignment_to, ctx);
+}
+
+static bool assigned_in(const NovaIRExpr *expr, const NovaToken *name) {
+    AssignSearch search = {name, false};
+    NovaIRExpr *root = const_cast<NovaIRExpr *>(expr);
+    find_assignment_to(&root, &search);
+    return search.found;
+}
+
+// Free names of a lifted body that resolve to binders of the enclosing function.
+typedef struct {
+    ClosureScope *outer;
+    NovaToken *locals;
+    size_t local_count;
+    size_t local_capacity;
+    size_t *captures; // binder indices in first-use order
+    size_t capture_count;
+    bool ok;
+} FreeNames;
+
+static void free_names_push(FreeNames *names, NovaToken name) {
+    if (names->local_count == names->local_capacity) {
+        size_t new_capacity = names->local_capacity == 0 ? 16 : names->local_capacity * 2;
+        NovaToken *locals = static_cast<NovaToken *>(realloc(names->locals, new_capacity * sizeof(NovaToken)));
+        if (!locals) {
+            names->ok = false;
+            return;
+        }
+        names->locals = locals;
+        names->local_capacity = new_capacity;
+    }
+    names->locals[names->local_count++] = name;
+}
+
+static void free_names_note(FreeNames *names, const NovaToken *name) {
+    for (size_t i = names->local_count; i > 0; --i) {
+        if (token_equals(&names->locals[i - 1], name)) return;
+    }
+    size_t binder = closure_scope_find(names->outer, name, names->outer->count);
+    if (binder == SIZE_MAX) return;
+    for (size_t i = 0; i < names->capture_count; ++i) {
+        if (names->captures[i] == binder) return;
+    }
+    size_t *captures = static_cast<size_t *>(realloc(names->captures, (names->capture_count + 1) * sizeof(size_t)));
+    if (!captures) {
+        names->ok = false;
+        return;
+    }
+    names->captures = captures;
+    names->captures[names->capture_count++] = binder;
+}
+
+static void free_names_visit(NovaIRExpr **slot, void *ctx) {
+    FreeNames *names = static_cast<FreeNames *>(ctx);
+    NovaIRExpr *expr = *slot;
+    if (!expr || !names->ok) return;
+    size_t mark = names->local_count;
+    switch (expr->kind) {
+    case NOVA_IR_EXPR_IDENTIFIER:
+        free_names_note(names, &expr->as.identifier);
+        return;
+    case NOVA_IR_EXPR_ASSIGN:
+        free_names_note(names, &expr->as.assign.target);
+        break;
+    case NOVA_IR_EXPR_CALL:
+        free_names_note(names, &expr->as.call.callee);
+        break;
+    case NOVA_IR_EXPR_LET:
+        free_names_visit(&expr->as.let_expr.value, ctx);
+        free_names_push(names, expr->as.let_expr.name);
+        free_names_visit(&expr->as.let_expr.body, ctx);
+        names->local_count = mark;
+        return;
+    case NOVA_IR_EXPR_MATCH:
+        free_names_visit(&expr->as.match_expr.scrutinee, ctx);
+        for (size_t i = 0; i < expr->as.match_expr.arm_count; ++i) {
+            const NovaIRMatchArm *arm = &expr->as.match_expr.arms[i];
+            for (size_t b = 0; b < arm->binding_count; ++b) free_names_push(names, arm->bindings[b]);
+            free_names_visit(&expr->as.match_expr.arms[i].body, ctx);
+            names->local_count = mark;
+        }
+        return;
+    case NOVA_IR_EXPR_CLOSURE: {
+        // A nested lambda's captures pass through this one.
+        size_t index = nova_ir_find_function(names->outer->program, &expr->as.closure.function);
+        if (index == SIZE_MAX || names->outer->converted[index]) break;
+        NovaIRFunction *fn = &names->outer->program->functions[index];
+        for (size_t p = 0; p < fn->param_count; ++p) free_names_push(names, fn->params[p].name);
+        free_names_visit(&fn->body, ctx);
+        names->local_count = mark;
+        break;
+    }
+    default:
+        break;
+    }
+    nova_ir_expr_for_each_child(expr, free_names_visit, ctx);
+}
+
+// Lambda lifting: every captured binder becomes a leading parameter of the
+// lifted function and a capture of the closure that builds its environment.
+static void capture_free_names(ClosureScope *scope, NovaIRExpr *closure, size_t index) {
+    scope->converted[index] = true;
+    FreeNames names{};
+    names.outer = scope;
+    names.ok = true;
+    NovaIRFunction *fn = &scope->program->functions[index];
+    for (size_t p = 0; p < fn->param_count; ++p) free_names_push(&names, fn->params[p].name);
+    free_names_visit(&fn->body, &names);
+    free(names.locals);
+    if (!names.ok) {
+        free(names.captures);
+        scope->ok = false;
+        return;
+    }
+    if (names.capture_count == 0) return;
+    size_t count = names.capture_count;
+    NovaIRParam *params = static_cast<NovaIRParam *>(calloc(count + fn->param_count, sizeof(NovaIRParam)));
+    NovaIRExpr **captures = static_cast<NovaIRExpr **>(calloc(count, sizeof(NovaIRExpr *)));
+    bool ok = params && captures;
+    for (size_t i = 0; ok && i < count; ++i) {
+        const ClosureBinder *binder = &scope->binders[names.captures[i]];
+        params[i].name = binder->name;
+        params[i].type = binder->type;
+        captures[i] = identifier_expr(binder->name, binder->type);
+        ok = captures[i] != NULL;
+    }
+    free(names.captures);
+    if (!ok) {
+        for (size_t i = 0; captures && i < count; ++i) nova_ir_expr_free(captures[i]);
+        free(captures);
+        free(params);
+        scope->ok = false;
+        return;
+    }
+    if (fn->param_count > 0) memcpy(params + count, fn->params, fn->param_count * sizeof(NovaIRParam));
+    free(fn->params);
+    fn->params = params;
+    fn->param_count += count;
+    fn->capture_count = count;
+    closure->as.closure.captures = captures;
+    closure->as.closure.capture_count = count;
+}
+
+static void apply_from_call(NovaIRExpr *expr, const ClosureBinder *binder) {
+    NovaIRExpr *callee = identifier_expr(binder->name, binder->type);
+    if (!callee) return;
+    NovaIRExpr **args = expr->as.call.args;
+    size_t arg_count = expr->as.call.arg_count;
+    NovaEffectMask effects = expr->as.call.effects;
+    expr->kind = NOVA_IR_EXPR_APPLY;
+    expr->as.apply.callee = callee;
+    expr->as.apply.args = args;
+    expr->as.apply.arg_count = arg_count;
+    expr->as.apply.effects = effects;
+}
+
+// Names of locally bound values are calls through closures; names of program
+// functions used as values become closures without captures.
+static void convert_visit(NovaIRExpr **slot, void *ctx) {
+    ClosureScope *scope = static_cast<ClosureScope *>(ctx);
+    NovaIRExpr *expr = *slot;
+    if (!expr || !scope->ok) return;
+    size_t mark = scope->count;
+    switch (expr->kind) {
+    case NOVA_IR_EXPR_LET:
+        convert_visit(&expr->as.let_expr.value, ctx);
+        if (!closure_scope_push(scope, expr->as.let_expr.name, expr->as.let_expr.value ? expr->as.let_expr.value->type : expr->type, NULL, 0)) return;
+        convert_visit(&expr->as.let_expr.body, ctx);
+        scope->count = mark;
+        return;
+    case NOVA_IR_EXPR_MATCH:
+        convert_visit(&expr->as.match_expr.scrutinee, ctx);
+        for (size_t i = 0; i < expr->as.match_expr.arm_count; ++i) {
+            push_arm_bindings(scope, expr, &expr->as.match_expr.arms[i]);
+            convert_visit(&expr->as.match_expr.arms[i].body, ctx);
+            scope->count = mark;
+        }
+        return;
+    case NOVA_IR_EXPR_CLOSURE: {
+        size_t index = nova_ir_find_function(scope->program, &expr->as.closure.function);
+        if (index != SIZE_MAX && scope->program->functions[index].lifted && !scope->converted[index]) {
+            capture_free_names(scope, expr, index);
+        }
+        return;
+    }
+    case NOVA_IR_EXPR_CALL: {
+        nova_ir_expr_for_each_child(expr, convert_visit, ctx);
+        size_t binder = closure_scope_find(scope, &expr->as.call.callee, scope->count);
+        if (binder != SIZE_MAX) apply_from_call(expr, &scope->binders[binder]);
+        return;
+    }
+    case NOVA_IR_EXPR_IDENTIFIER: {
+        if (closure_scope_find(scope, &expr->as.identifier, scope->count) != SIZE_MAX) return;
+        const NovaTypeInfo *type = nova_semantic_type_info(scope->semantics, expr->type);
+        if (!type || type->kind != NOVA_TYPE_KIND_FUNCTION) return;
+        if (nova_ir_find_function(scope->program, &expr->as.identifier) == SIZE_MAX) return;
+        NovaToken function = expr->as.identifier;
+        expr->kind = NOVA_IR_EXPR_CLOSURE;
+        expr->as.closure.function = function;
+        expr->as.closure.captures = NULL;
+        expr->as.closure.capture_count = 0;
+        return;
+    }
+    default:
+        nova_ir_expr_for_each_child(expr, convert_visit, ctx);
+        return;
+    }
+}
+
+// The closure a callee is known to evaluate to, provided its captures still
+// name the values they named when it was built.
+static const NovaIRExpr *known_closure(const ClosureScope *scope, const NovaIRExpr *callee, size_t *depth) {
+    if (!callee) return NULL;
+    if (callee->kind == NOVA_IR_EXPR_CLOSURE) {
+        *depth = scope->count;
+        return callee;
+    }
+    if (callee->kind != NOVA_IR_EXPR_IDENTIFIER) return NULL;
+    size_t index = closure_scope_find(scope, &callee->as.identifier, scope->count);
+    if (index == SIZE_MAX || !scope->binders[index].closure) return NULL;
+    if (assigned_in(scope->root, &callee->as.identifier)) return NULL;
+    const ClosureBinder *binder = &scope->binders[index];
+    for (size_t i = 0; i < binder->closure->as.closure.capture_count; ++i) {
+        const NovaIRExpr *capture = binder->closure->as.closure.captures[i];
+        if (capture->kind != NOVA_IR_EXPR_IDENTIFIER) {
+            if (capture->kind == NOVA_IR_EXPR_NUMBER || capture->kind == NOVA_IR_EXPR_INT ||
+                capture->kind == NOVA_IR_EXPR_BOOL || capture->kind == NOVA_IR_EXPR_UNIT) {
+                continue;
+            }
+            return NULL;
+        }
+        const NovaToken *name = &capture->as.identifier;
+        if (closure_scope_find(scope, name, scope->count) != closure_scope_find(scope, name, binder->depth)) return NULL;
+        if (assigned_in(scope->root, name)) return NULL;
+    }
+    *depth = binder->depth;
+    return binder->closure;
+}
+
+static void devirtualize_visit(NovaIRExpr **slot, void *ctx) {
+    ClosureScope *scope = static_cast<ClosureScope *>(ctx);
+    NovaIRExpr *expr = *slot;
+    if (!expr || !scope->ok) return;
+    size_t mark = scope->count;
+    switch (expr->kind) {
+    case NOVA_IR_EXPR_LET: {
+        devirtualize_visit(&expr->as.let_expr.value, ctx);
+        size_t depth = 0;
+        const NovaIRExpr *closure = known_closure(scope, expr->as.let_expr.value, &depth);
+        if (!closure_scope_push(scope, expr->as.let_expr.name, expr->type, closure, depth)) return;
+        devirtualize_visit(&expr->as.let_expr.body, ctx);
+        scope->count = mark;
+        return;
+    }
+    case NOVA_IR_EXPR_MATCH:
+        devirtualize_visit(&expr->as.match_expr.scrutinee, ctx);
+        for (size_t i = 0; i < expr->as.match_expr.arm_count; ++i) {
+            push_arm_bindings(scope, expr, &expr->as.match_expr.arms[i]);
+            devirtualize_visit(&expr->as.match_expr.arms[i].body, ctx);
+            scope->count = mark;
+        }
+        return;
+    case NOVA_IR_EXPR_APPLY: {
+        nova_ir_expr_for_each_child(expr, devirtualize_visit, ctx);
+        size_t depth = 0;
+        const NovaIRExpr *closure = known_closure(scope, expr->as.apply.callee, &depth);
+        if (!closure) return;
+        size_t capture_count = closure->as.closure.capture_count;
+        size_t arg_count = capture_count + expr->as.apply.arg_count;
+        NovaIRExpr **args = arg_count ? static_cast<NovaIRExpr **>(calloc(arg_count, sizeof(NovaIRExpr *))) : NULL;
+        if (arg_count && !args) return;
+        bool ok = true;
+        for (size_t i = 0; i < capture_count; ++i) {
+            args[i] = nova_ir_expr_clone(closure->as.closure.captures[i]);
+            if (!args[i]) ok = false;
+        }
+        if (!ok) {
+            for (size_t i = 0; i < capture_count; ++i) nova_ir_expr_free(args[i]);
+            free(args);
+            return;
+        }
+        if (expr->as.apply.arg_count) memcpy(args + capture_count, expr->as.apply.args, expr->as.apply.arg_count * sizeof(NovaIRExpr *));
+        NovaToken function = closure->as.closure.function;
+        NovaEffectMask effects = expr->as.apply.effects;
+        nova_ir_expr_free(expr->as.apply.callee);
+        free(expr->as.apply.args);
+        expr->kind = NOVA_IR_EXPR_CALL;
+        expr->as.call.callee = function;
+        expr->as.call.args = args;
+        expr->as.call.arg_count = arg_count;
+        expr->as.call.effects = effects;
+        scope->rewritten++;
+        return;
+    }
+    default:
+        nova_ir_expr_for_each_child(expr, devirtualize_visit, ctx);
+        return;
+    }
+}
+
+size_t nova_ir_devirtualize(NovaIRProgram *program, const NovaSemanticContext *semantics, NovaIRExpr **body) {
+    ClosureScope scope{};
+    scope.program = program;
+    scope.semantics = semantics;
+    scope.root = *body;
+    scope.ok = true;
+    devirtualize_visit(body, &scope);
+    free(scope.binders);
+    return scope.rewritten;
+}
+
+// Lifts the lambdas of the functions from first on, which must include every
+// function whose lambdas they are.
+static void convert_closures(NovaIRProgram *program, const NovaSemanticContext *semantics, size_t first) {
+    ClosureScope scope{};
+    scope.program = program;
+    scope.semantics = semantics;
+    scope.ok = true;
+    scope.converted = static_cast<bool *>(calloc(program->function_count ? program->function_count : 1, sizeof(bool)));
+    if (!scope.converted) return;
+    // Enclosing functions come first, so a lambda's own captures are
+    // parameters by the time its body is converted.
+    for (size_t i = first; i < program->function_count && scope.ok; ++i) {
+        NovaIRFunction *fn = &program->functions[i];
+        scope.count = 0;
+        for (size_t p = 0; p < fn->param_count; ++p) {
+            closure_scope_push(&scope, fn->params[p].name, fn->params[p].type, NULL, 0);
+        }
+        convert_visit(&fn->body, &scope);
+    }
+    free(scope.converted);
+    free(scope.binders);
+    for (size_t i = first; i < program->function_count; ++i) {
+        if (program->functions[i].body) nova_ir_devirtualize(program, semantics, &program->functions[i].body);
+    }
+}
+
+void nova_ir_function_free(NovaIRFunction *fn) {
     free(fn->params);
     nova_ir_expr_free(fn->body);
 }
 
+typedef struct {
+    NovaIRProgram *program; // NULL while counting
+    NovaToken function;
+    size_t ordinal;
+    size_t count;
+} SiteNumbering;
+
+static void number_sites_in(NovaIRExpr **slot, void *ctx) {
+    SiteNumbering *numbering = static_cast<SiteNumbering *>(ctx);
+    NovaIRExpr *expr = *slot;
+    if (!expr) return;
+    if (expr->kind == NOVA_IR_EXPR_IF) {
+        if (numbering->program) {
+            NovaIRBranchSite *site = &numbering->program->branch_sites[numbering->count];
+            site->function = numbering->function;
+            site->ordinal = numbering->ordinal++;
+            expr->as.if_expr.site = numbering->count + 1;
+        }
+        numbering->count++;
+    }
+    nova_ir_expr_for_each_child(expr, number_sites_in, ctx);
+}
+
+// Without memory for the table, branches simply go without sites.
+static void number_branch_sites(NovaIRProgram *program) {
+    SiteNumbering numbering = {NULL, {}, 0, 0};
+    for (size_t i = 0; i < program->function_count; ++i) number_sites_in(&program->functions[i].body, &numbering);
+    if (numbering.count == 0) return;
+    program->branch_sites = static_cast<NovaIRBranchSite *>(calloc(numbering.count, sizeof(NovaIRBranchSite)));
+    if (!program->branch_sites) return;
+    program->branch_site_count = numbering.count;
+    numbering.program = program;
+    numbering.count = 0;
+    for (size_t i = 0; i < program->function_count; ++i) {
+        numbering.function = program->functions[i].name;
+        numbering.ordinal = 0;
+        number_sites_in(&program->functions[i].body, &numbering);
+    }
+}
+
+// The top-level function's semantic type, whose result honours a `: T`
+// annotation where the body alone may not say.
+static const NovaTypeInfo *declared_function_type(const NovaSemanticContext *semantics, const NovaToken *name) {
+    for (const NovaScopeEntry *entry = semantics->scope ? semantics->scope->entries : NULL; entry; entry = entry->next) {
+        if (!token_equals(&entry->name, name)) continue;
+        const NovaTypeInfo *info = nova_semantic_type_info(semantics, entry->type);
+        return info && info->kind == NOVA_TYPE_KIND_FUNCTION ? info : NULL;
+    }
+    return NULL;
+}
+
 NovaIRProgram *nova_ir_lower(const NovaProgram *program, const NovaSemanticContext *semantics) {
     NovaIRProgram *ir = static_cast<NovaIRProgram *>(calloc(1, sizeof(NovaIRProgram)));
     if (!ir) return NULL;
     for (size_t i = 0; i < program->decl_count; ++i) {
         const NovaDecl *decl = &program->decls[i];
-        if (decl->kind != NOVA_DECL_FUN) continue;
-        if (ir->function_count == ir->function_capacity) {
-            size_t new_capacity = ir->function_capacity == 0 ? 4 : ir->function_capacity * 2;
-            NovaIRFunction *functions = static_cast<NovaIRFunction *>(realloc(ir->functions, new_capacity * sizeof(NovaIRFunction)));
-            if (!functions) {
-                continue;
+        if (decl->kind == NOVA_DECL_TYPE) {
+            const NovaTypeRecord *record = nova_semantic_find_type(semantics, &decl->as.type_decl.name);
+            if (!record) continue;
+            if (ir->type_count == ir->type_capacity) {
+                size_t new_capacity = ir->type_capacity == 0 ? 4 : ir->type_capacity * 2;
+                NovaTypeId *types = static_cast<NovaTypeId *>(realloc(ir->types, new_capacity * sizeof(NovaTypeId)));
+                if (!types) {
+                    continue;
+                }
+                ir->types = types;
+                ir->type_capacity = new_capacity;
             }
-            ir->functions = functions;
-            ir->function_capacity = new_capacity;
+            ir->types[ir->type_count++] = record->type_id;
+            continue;
         }
-        NovaIRFunction *fn = &ir->functions[ir->function_count++];
-        nova_ir_function_init(fn);
+        if (decl->kind != NOVA_DECL_FUN) continue;
+        size_t index = append_function(ir);
+        if (index == SIZE_MAX) continue;
+        NovaIRFunction *fn = &ir->functions[index];
         fn->name = decl->as.fun_decl.name;
         fn->param_count = decl->as.fun_decl.params.count;
         if (fn->param_count > 0) {
@@ -529,13 +2214,18 @@ NovaIRProgram *nova_ir_lower(const NovaProgram *program, const NovaSemanticConte
             }
         }
         const NovaExprInfo *body_info = nova_semantic_lookup_expr(semantics, decl->as.fun_decl.body);
-        fn->return_type = body_info ? body_info->type : semantics->type_unknown;
+        const NovaTypeInfo *fn_type = declared_function_type(semantics, &decl->as.fun_decl.name);
+        fn->return_type = fn_type ? fn_type->as.function.result : body_info ? body_info->type : semantics->type_unknown;
         fn->effects = body_info ? body_info->effects : NOVA_EFFECT_NONE;
-        fn->body = lower_expr(decl->as.fun_decl.body, semantics);
-        if (fn->body) {
-            optimize_ir_expr(&fn->body);
+        // Lowering appends the function's lambdas, which may move the array.
+        NovaIRExpr *body = lower_expr(decl->as.fun_decl.body, semantics, ir);
+        if (body) {
+            optimize_ir_expr(&body);
         }
+        ir->functions[index].body = body;
+        convert_closures(ir, semantics, index);
     }
+    number_branch_sites(ir);
     return ir;
 }
 
@@ -545,5 +2235,15 @@ void nova_ir_free(NovaIRProgram *program) {
         nova_ir_function_free(&program->functions[i]);
     }
     free(program->functions);
+    free(program->types);
+    for (size_t i = 0; i < program->name_count; ++i) {
+        free(program->names[i]);
+    }
+    free(program->names);
+    for (size_t i = 0; i < program->string_count; ++i) {
+        free(program->strings[i].bytes);
+    }
+    free(program->strings);
+    free(program->branch_sites);
     free(program);
 }
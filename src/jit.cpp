@@ -0,0 +1,288 @@
+#include "nova/jit.h"
+
+#include "nova/native.h"
+
+#include <inttypes.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define NOVA_JIT_ARENA_SIZE (64 * 1024)
+#define NOVA_JIT_STUB_SIZE 16
+#define NOVA_JIT_RESOLVER_SIZE 256 // the stubs follow the resolver
+
+typedef struct NovaJitArena {
+    uint8_t *base;
+    size_t size;
+    size_t used;
+    struct NovaJitArena *next;
+} NovaJitArena;
+
+struct NovaJit {
+    const NovaIRProgram *program;
+    const NovaSemanticContext *semantics;
+    void **slots; // per function: its stub until compiled, then its code
+    bool *compiled;
+    size_t compiled_count;
+    NovaJitArena *arenas; // newest first
+    FILE *perf_map;
+    sigjmp_buf *failure; // set while nova_jit_call runs
+    char error[256];
+};
+
+// The engine whose code is running; traps jump back to its nova_jit_call.
+static NovaJit *running_jit;
+
+static NovaJitArena *arena_new(size_t size) {
+    long page = sysconf(_SC_PAGESIZE);
+    size_t page_size = page > 0 ? (size_t)page : 4096;
+    size = (size + page_size - 1) / page_size * page_size;
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) return NULL;
+    NovaJitArena *arena = static_cast<NovaJitArena *>(calloc(1, sizeof(NovaJitArena)));
+    if (!arena) {
+        munmap(base, size);
+        return NULL;
+    }
+    arena->base = static_cast<uint8_t *>(base);
+    arena->size = size;
+    return arena;
+}
+
+// Copies code into executable memory, flipping the arena writable only for
+// the copy.
+static void *jit_install(NovaJit *jit, const uint8_t *code, size_t size) {
+    NovaJitArena *arena = jit->arenas;
+    size_t offset = arena ? (arena->used + 15) & ~(size_t)15 : 0;
+    if (!arena || offset + size > arena->size) {
+        arena = arena_new(size > NOVA_JIT_ARENA_SIZE ? size : NOVA_JIT_ARENA_SIZE);
+        if (!arena) return NULL;
+        arena->next = jit->arenas;
+        jit->arenas = arena;
+        offset = 0;
+    } else if (mprotect(arena->base, arena->size, PROT_READ | PROT_WRITE) != 0) {
+        return NULL;
+    }
+    memcpy(arena->base + offset, code, size);
+    arena->used = offset + size;
+    if (mprotect(arena->base, arena->size, PROT_READ | PROT_EXEC) != 0) return NULL;
+    return arena->base + offset;
+}
+
+static void perf_map_add(NovaJit *jit, const void *code, size_t size, const char *name, size_t name_length) {
+    if (!jit->perf_map) return;
+    fprintf(jit->perf_map, "%" PRIxPTR " %zx %.*s\n", (uintptr_t)code, size, (int)name_length, name);
+    fflush(jit->perf_map);
+}
+
+static bool jit_compile(NovaJit *jit, size_t index, char *error_buffer, size_t error_buffer_size) {
+    if (jit->compiled[index]) return true;
+    uint8_t *code = NULL;
+    size_t size = 0;
+    if (!nova_native_encode_function(jit->program, jit->semantics, index, jit->slots, &code, &size, error_buffer, error_buffer_size)) return false;
+    void *installed = jit_install(jit, code, size);
+    free(code);
+    if (!installed) {
+        if (error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "cannot map executable memory");
+        return false;
+    }
+    const NovaIRFunction *fn = &jit->program->functions[index];
+    perf_map_add(jit, installed, size, fn->name.lexeme, fn->name.length);
+    jit->slots[index] = installed;
+    jit->compiled[index] = true;
+    jit->compiled_count++;
+    return true;
+}
+
+// Called from the resolver with the index the stub loaded into r11; returns
+// the code the stub should continue into.
+static void *jit_resolve(NovaJit *jit, uint64_t index) {
+    if (jit_compile(jit, (size_t)index, jit->error, sizeof(jit->error))) return jit->slots[index];
+    if (jit->failure) siglongjmp(*jit->failure, 1);
+    fprintf(stderr, "nova jit: %s\n", jit->error);
+    abort();
+}
+
+static void put_byte(uint8_t **cursor, uint8_t byte) {
+    *(*cursor)++ = byte;
+}
+
+static void put_u64(uint8_t **cursor, uint64_t value) {
+    for (int i = 0; i < 8; ++i) put_byte(cursor, (uint8_t)(value >> (8 * i)));
+}
+
+// mov [rsp + disp] <-> reg (store) for a general or xmm register.
+static void put_frame_move(uint8_t **cursor, bool xmm, bool store, int reg, uint8_t disp) {
+    if (xmm) {
+        put_byte(cursor, 0xF2);
+        put_byte(cursor, 0x0F);
+        put_byte(cursor, store ? 0x11 : 0x10);
+    } else {
+        put_byte(cursor, (uint8_t)(0x48 | ((reg & 8) ? 4 : 0)));
+        put_byte(cursor, store ? 0x89 : 0x8B);
+    }
+    put_byte(cursor, (uint8_t)(0x44 | ((reg & 7) << 3)));
+    put_byte(cursor, 0x24);
+    put_byte(cursor, disp);
+}
+
+// The resolver keeps the caller's argument registers intact across the
+// call into jit_resolve, then tail-jumps to the compiled function. Each
+// stub is "mov r11d, index; jmp resolver".
+static bool jit_install_stubs(NovaJit *jit) {
+    static const int arguments[] = {7, 6, 2, 1, 8, 9}; // rdi, rsi, rdx, rcx, r8, r9
+    size_t count = jit->program->function_count;
+    size_t size = NOVA_JIT_RESOLVER_SIZE + count * NOVA_JIT_STUB_SIZE;
+    uint8_t *code = static_cast<uint8_t *>(calloc(size, 1));
+    if (!code) return false;
+    uint8_t *cursor = code;
+    put_byte(&cursor, 0x55); // push rbp
+    put_byte(&cursor, 0x48), put_byte(&cursor, 0x89), put_byte(&cursor, 0xE5); // mov rbp, rsp
+    put_byte(&cursor, 0x48), put_byte(&cursor, 0x83), put_byte(&cursor, 0xEC), put_byte(&cursor, 112); // sub rsp, 112
+    for (int i = 0; i < 6; ++i) put_frame_move(&cursor, false, true, arguments[i], (uint8_t)(8 * i));
+    for (int i = 0; i < 8; ++i) put_frame_move(&cursor, true, true, i, (uint8_t)(48 + 8 * i));
+    put_byte(&cursor, 0x48), put_byte(&cursor, 0xBF), put_u64(&cursor, (uint64_t)(uintptr_t)jit); // mov rdi, jit
+    put_byte(&cursor, 0x4C), put_byte(&cursor, 0x89), put_byte(&cursor, 0xDE); // mov rsi, r11
+    put_byte(&cursor, 0x48), put_byte(&cursor, 0xB8), put_u64(&cursor, (uint64_t)(uintptr_t)&jit_resolve); // mov rax, jit_resolve
+    put_byte(&cursor, 0xFF), put_byte(&cursor, 0xD0); // call rax
+    put_byte(&cursor, 0x49), put_byte(&cursor, 0x89), put_byte(&cursor, 0xC3); // mov r11, rax
+    for (int i = 0; i < 6; ++i) put_frame_move(&cursor, false, false, arguments[i], (uint8_t)(8 * i));
+    for (int i = 0; i < 8; ++i) put_frame_move(&cursor, true, false, i, (uint8_t)(48 + 8 * i));
+    put_byte(&cursor, 0xC9); // leave
+    put_byte(&cursor, 0x41), put_byte(&cursor, 0xFF), put_byte(&cursor, 0xE3); // jmp r11
+    size_t resolver_size = (size_t)(cursor - code);
+    size_t stubs = NOVA_JIT_RESOLVER_SIZE;
+    for (size_t i = 0; i < count; ++i) {
+        cursor = code + stubs + i * NOVA_JIT_STUB_SIZE;
+        put_byte(&cursor, 0x41), put_byte(&cursor, 0xBB); // mov r11d, index
+        for (int b = 0; b < 4; ++b) put_byte(&cursor, (uint8_t)(i >> (8 * b)));
+        int32_t rel = -(int32_t)(stubs + i * NOVA_JIT_STUB_SIZE + 11);
+        put_byte(&cursor, 0xE9); // jmp resolver
+        for (int b = 0; b < 4; ++b) put_byte(&cursor, (uint8_t)((uint32_t)rel >> (8 * b)));
+    }
+    uint8_t *installed = static_cast<uint8_t *>(jit_install(jit, code, size));
+    if (installed) {
+        perf_map_add(jit, installed, resolver_size, "nova_jit_resolver", strlen("nova_jit_resolver"));
+        for (size_t i = 0; i < count; ++i) jit->slots[i] = installed + stubs + i * NOVA_JIT_STUB_SIZE;
+    }
+    free(code);
+    return installed != NULL;
+}
+
+NovaJit *nova_jit_create(const NovaIRProgram *program, const NovaSemanticContext *semantics) {
+    if (!program || !semantics) return NULL;
+    NovaJit *jit = static_cast<NovaJit *>(calloc(1, sizeof(NovaJit)));
+    if (!jit) return NULL;
+    jit->program = program;
+    jit->semantics = semantics;
+    jit->slots = static_cast<void **>(calloc(program->function_count + 1, sizeof(void *)));
+    jit->compiled = static_cast<bool *>(calloc(program->function_count + 1, sizeof(bool)));
+    char perf_path[64];
+    snprintf(perf_path, sizeof(perf_path), "/tmp/perf-%ld.map", (long)getpid());
+    jit->perf_map = fopen(perf_path, "a");
+    if (!jit->slots || !jit->compiled || !jit_install_stubs(jit)) {
+        nova_jit_free(jit);
+        return NULL;
+    }
+    return jit;
+}
+
+void nova_jit_free(NovaJit *jit) {
+    if (!jit) return;
+    NovaJitArena *arena = jit->arenas;
+    while (arena) {
+        NovaJitArena *next = arena->next;
+        munmap(arena->base, arena->size);
+        free(arena);
+        arena = next;
+    }
+    if (jit->perf_map) fclose(jit->perf_map);
+    free(jit->slots);
+    free(jit->compiled);
+    free(jit);
+}
+
+size_t nova_jit_compiled_count(const NovaJit *jit) {
+    return jit ? jit->compiled_count : 0;
+}
+
+static size_t jit_find(const NovaJit *jit, const char *function, char *error_buffer, size_t error_buffer_size) {
+    NovaToken name = {};
+    name.lexeme = function;
+    name.length = strlen(function);
+    size_t index = nova_ir_find_function(jit->program, &name);
+    if (index == SIZE_MAX && error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "unknown function %s", function);
+    return index;
+}
+
+void *nova_jit_function(NovaJit *jit, const char *function, char *error_buffer, size_t error_buffer_size) {
+    if (!jit || !function) return NULL;
+    size_t index = jit_find(jit, function, error_buffer, error_buffer_size);
+    if (index == SIZE_MAX || !jit_compile(jit, index, error_buffer, error_buffer_size)) return NULL;
+    return jit->slots[index];
+}
+
+// ud2, which compiled code executes for division by zero and unmatched
+// values, lands here instead of killing the process.
+static void jit_trap_handler(int signal_number) {
+    (void)signal_number;
+    if (running_jit && running_jit->failure) {
+        snprintf(running_jit->error, sizeof(running_jit->error), "program trapped (division by zero or unmatched value)");
+        siglongjmp(*running_jit->failure, 1);
+    }
+    abort();
+}
+
+bool nova_jit_call(NovaJit *jit, const char *function, NovaJitValue *result, char *error_buffer, size_t error_buffer_size) {
+    if (!jit || !function || !result) return false;
+    size_t index = jit_find(jit, function, error_buffer, error_buffer_size);
+    if (index == SIZE_MAX) return false;
+    const NovaIRFunction *fn = &jit->program->functions[index];
+    if (fn->param_count != 0) {
+        if (error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "%s takes parameters", function);
+        return false;
+    }
+    if (!jit_compile(jit, index, error_buffer, error_buffer_size)) return false;
+    const NovaTypeInfo *info = nova_semantic_type_info(jit->semantics, fn->return_type);
+    NovaTypeKind kind = info ? info->kind : NOVA_TYPE_KIND_NUMBER;
+    if (kind == NOVA_TYPE_KIND_UNKNOWN) kind = NOVA_TYPE_KIND_NUMBER;
+    void *code = jit->slots[index];
+
+    sigjmp_buf failure;
+    struct sigaction trap = {}, previous = {};
+    trap.sa_handler = jit_trap_handler;
+    sigemptyset(&trap.sa_mask);
+    sigaction(SIGILL, &trap, &previous);
+    NovaJit *outer = running_jit;
+    running_jit = jit;
+    jit->failure = &failure;
+    bool ok = true;
+    if (sigsetjmp(failure, 1) == 0) {
+        result->kind = kind;
+        switch (kind) {
+        case NOVA_TYPE_KIND_INT:
+            result->as.int_value = reinterpret_cast<int64_t (*)(void)>(code)();
+            break;
+        case NOVA_TYPE_KIND_BOOL:
+            result->as.bool_value = reinterpret_cast<bool (*)(void)>(code)();
+            break;
+        case NOVA_TYPE_KIND_UNIT:
+            reinterpret_cast<void (*)(void)>(code)();
+            break;
+        default:
+            result->as.number = reinterpret_cast<double (*)(void)>(code)();
+            break;
+        }
+    } else {
+        ok = false;
+        if (error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "%s", jit->error);
+    }
+    jit->failure = NULL;
+    running_jit = outer;
+    sigaction(SIGILL, &previous, NULL);
+    return ok;
+}
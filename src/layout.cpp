@@ -0,0 +1,297 @@
+#include "nova/layout.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Records are laid out depth first so embedded types are finished before the
+// types that hold them. A field whose type is still being laid out closes a
+// cycle and would have unbounded size, so it is boxed instead.
+typedef enum {
+    LAYOUT_PENDING,
+    LAYOUT_ACTIVE,
+    LAYOUT_DONE,
+} LayoutState;
+
+typedef struct {
+    NovaSemanticContext *ctx;
+    LayoutState *states; // indexed like ctx->type_records
+    size_t next_order;
+} LayoutBuilder;
+
+static size_t align_up(size_t value, size_t align) {
+    return (value + align - 1) / align * align;
+}
+
+static char *format_name(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    va_list copy;
+    va_copy(copy, args);
+    int needed = vsnprintf(NULL, 0, fmt, copy);
+    va_end(copy);
+    char *name = needed < 0 ? NULL : static_cast<char *>(malloc((size_t)needed + 1));
+    if (name) vsnprintf(name, (size_t)needed + 1, fmt, args);
+    va_end(args);
+    return name;
+}
+
+static size_t tag_size_for(size_t variant_count) {
+    if (variant_count <= 0x100) return 1;
+    if (variant_count <= 0x10000) return 2;
+    return 4;
+}
+
+static NovaRepr int_repr(size_t size, uint64_t used) {
+    uint64_t values = size >= 8 ? UINT64_MAX : (1ull << (size * 8));
+    NovaRepr repr = {NOVA_REPR_INT, size, size, used, used < values ? values - used : 0};
+    return repr;
+}
+
+static const char *int_c_type(size_t size) {
+    return size == 1 ? "uint8_t" : size == 2 ? "uint16_t" : "uint32_t";
+}
+
+static const char *int_llvm_type(size_t size) {
+    return size == 1 ? "i8" : size == 2 ? "i16" : "i32";
+}
+
+static const NovaRepr boxed_repr = {NOVA_REPR_PTR, 8, 8, 0, 1};
+
+NovaRepr nova_layout_repr(const NovaSemanticContext *ctx, NovaTypeId type) {
+    const NovaTypeInfo *info = nova_semantic_type_info(ctx, type);
+    NovaRepr repr = {NOVA_REPR_F64, 8, 8, 0, 0};
+    if (!info) return repr;
+    switch (info->kind) {
+    case NOVA_TYPE_KIND_NUMBER:
+        repr.niche_start = NOVA_LAYOUT_F64_NICHE;
+        repr.niche_count = 1ull << 32;
+        return repr;
+    case NOVA_TYPE_KIND_INT: {
+        // Every bit pattern is a valid Int, so there is no niche.
+        NovaRepr word = {NOVA_REPR_INT, 8, 8, 0, 0};
+        return word;
+    }
+    case NOVA_TYPE_KIND_BOOL: {
+        NovaRepr flag = {NOVA_REPR_BOOL, 1, 1, 2, 254};
+        return flag;
+    }
+    case NOVA_TYPE_KIND_STRING:
+    case NOVA_TYPE_KIND_FUNCTION: // function values point at their environment
+    case NOVA_TYPE_KIND_LIST:
+    case NOVA_TYPE_KIND_MAP:
+        return boxed_repr;
+    case NOVA_TYPE_KIND_UNIT:
+        return int_repr(1, UINT64_MAX);
+    case NOVA_TYPE_KIND_CUSTOM: {
+        const NovaTypeLayout *layout = nova_layout_of(ctx, type);
+        return layout ? layout->repr : repr;
+    }
+    case NOVA_TYPE_KIND_UNKNOWN:
+    default:
+        return repr;
+    }
+}
+
+const NovaTypeLayout *nova_layout_of(const NovaSemanticContext *ctx, NovaTypeId type) {
+    const NovaTypeRecord *record = nova_semantic_type_record(ctx, type);
+    return record ? record->layout : NULL;
+}
+
+const NovaTypeLayout *nova_layout_niche_host(const NovaSemanticContext *ctx, const NovaTypeLayout *layout) {
+    while (layout && layout->kind == NOVA_LAYOUT_NICHE) {
+        const NovaFieldLayout *field = &layout->variants[layout->dataful].fields[0];
+        if (field->boxed) return NULL;
+        layout = nova_layout_of(ctx, field->type);
+    }
+    return layout && layout->kind == NOVA_LAYOUT_TAGGED ? layout : NULL;
+}
+
+// A niche layout is spelled like its field, except that Bool widens to a
+// byte so the spare values 2..255 exist.
+static bool name_like_field(const NovaSemanticContext *ctx, NovaTypeLayout *layout, const NovaFieldLayout *field) {
+    const NovaTypeInfo *info = nova_semantic_type_info(ctx, field->type);
+    const char *c_type = "double";
+    const char *llvm_type = "double";
+    if (field->boxed ||
+        (info && (info->kind == NOVA_TYPE_KIND_FUNCTION || info->kind == NOVA_TYPE_KIND_LIST || info->kind == NOVA_TYPE_KIND_MAP ||
+                  info->kind == NOVA_TYPE_KIND_STRING))) {
+        c_type = "const void *";
+        llvm_type = "ptr";
+    } else if (info && info->kind == NOVA_TYPE_KIND_BOOL) {
+        c_type = "uint8_t";
+        llvm_type = "i8";
+    } else if (info && info->kind == NOVA_TYPE_KIND_INT) {
+        c_type = "int64_t";
+        llvm_type = "i64";
+    } else if (info && info->kind == NOVA_TYPE_KIND_UNIT) {
+        c_type = "char";
+        llvm_type = "i8";
+    } else if (info && info->kind == NOVA_TYPE_KIND_CUSTOM) {
+        const NovaTypeLayout *inner = nova_layout_of(ctx, field->type);
+        if (!inner) return false;
+        c_type = inner->c_type;
+        llvm_type = inner->llvm_type;
+    }
+    layout->c_type = format_name("%s", c_type);
+    layout->llvm_type = format_name("%s", llvm_type);
+    return layout->c_type && layout->llvm_type;
+}
+
+static void classify_enum(NovaTypeLayout *layout) {
+    layout->kind = NOVA_LAYOUT_ENUM;
+    layout->tag_size = tag_size_for(layout->variant_count);
+    layout->repr = int_repr(layout->tag_size, layout->variant_count);
+    layout->c_type = format_name("%s", int_c_type(layout->tag_size));
+    layout->llvm_type = format_name("%s", int_llvm_type(layout->tag_size));
+}
+
+// Only one variant carries data and its field has enough spare bit patterns
+// to name every other variant, so no tag is needed.
+static bool classify_niche(const NovaSemanticContext *ctx, NovaTypeLayout *layout) {
+    size_t dataful = SIZE_MAX;
+    for (size_t v = 0; v < layout->variant_count; ++v) {
+        if (layout->variants[v].field_count == 0) continue;
+        if (dataful != SIZE_MAX || layout->variants[v].field_count != 1) return false;
+        dataful = v;
+    }
+    if (dataful == SIZE_MAX) return false;
+    const NovaFieldLayout *field = &layout->variants[dataful].fields[0];
+    NovaRepr repr = field->boxed ? boxed_repr : nova_layout_repr(ctx, field->type);
+    uint64_t spare = layout->variant_count - 1;
+    if (repr.niche_count < spare) return false;
+    if (repr.kind == NOVA_REPR_BOOL) repr.kind = NOVA_REPR_INT;
+    uint64_t code = repr.niche_start;
+    for (size_t v = 0; v < layout->variant_count; ++v) {
+        if (v != dataful) layout->variants[v].niche_code = code++;
+    }
+    layout->variants[dataful].size = repr.size;
+    layout->variants[dataful].align = repr.align;
+    repr.niche_start += spare;
+    repr.niche_count -= spare;
+    layout->kind = NOVA_LAYOUT_NICHE;
+    layout->dataful = dataful;
+    layout->repr = repr;
+    return name_like_field(ctx, layout, field);
+}
+
+static void classify_tagged(const NovaSemanticContext *ctx, const NovaTypeRecord *record, NovaTypeLayout *layout) {
+    size_t payload_size = 0;
+    size_t payload_align = 1;
+    for (size_t v = 0; v < layout->variant_count; ++v) {
+        NovaVariantLayout *variant = &layout->variants[v];
+        size_t offset = 0;
+        variant->align = 1;
+        for (size_t f = 0; f < variant->field_count; ++f) {
+            NovaFieldLayout *field = &variant->fields[f];
+            NovaRepr repr = field->boxed ? boxed_repr : nova_layout_repr(ctx, field->type);
+            offset = align_up(offset, repr.align);
+            field->offset = offset;
+            offset += repr.size;
+            if (repr.align > variant->align) variant->align = repr.align;
+        }
+        variant->size = align_up(offset, variant->align);
+        if (variant->size > payload_size) payload_size = variant->size;
+        if (variant->align > payload_align) payload_align = variant->align;
+    }
+    // A lone variant needs no tag, so its fields become the whole value.
+    layout->kind = layout->variant_count > 1 ? NOVA_LAYOUT_TAGGED : NOVA_LAYOUT_STRUCT;
+    layout->tag_size = layout->variant_count > 1 ? tag_size_for(layout->variant_count) : 0;
+    layout->payload_align = payload_align;
+    layout->payload_size = align_up(payload_size, payload_align);
+    layout->payload_offset = align_up(layout->tag_size, payload_align);
+    size_t align = payload_align > layout->tag_size ? payload_align : layout->tag_size;
+    layout->repr.kind = NOVA_REPR_STRUCT;
+    layout->repr.size = align_up(layout->payload_offset + layout->payload_size, align);
+    layout->repr.align = align;
+    if (layout->tag_size > 0) {
+        NovaRepr tag = int_repr(layout->tag_size, layout->variant_count);
+        layout->repr.niche_start = tag.niche_start;
+        layout->repr.niche_count = tag.niche_count;
+    }
+    const NovaToken *name = &record->decl->name;
+    layout->c_type = format_name("nova_%.*s", (int)name->length, name->lexeme);
+    layout->llvm_type = format_name("%%nova.%.*s", (int)name->length, name->lexeme);
+}
+
+static void layout_record(LayoutBuilder *builder, size_t index) {
+    NovaSemanticContext *ctx = builder->ctx;
+    NovaTypeRecord *record = &ctx->type_records.items[index];
+    builder->states[index] = LAYOUT_ACTIVE;
+    NovaTypeLayout *layout = static_cast<NovaTypeLayout *>(calloc(1, sizeof(NovaTypeLayout)));
+    if (!layout) return;
+    layout->type = record->type_id;
+    layout->variant_count = record->variant_count;
+    layout->variants = static_cast<NovaVariantLayout *>(calloc(record->variant_count + 1, sizeof(NovaVariantLayout)));
+    bool ok = layout->variants != NULL;
+    bool has_payload = false;
+    for (size_t v = 0; ok && v < record->variant_count; ++v) {
+        const NovaVariantRecord *variant = &record->variants[v];
+        if (variant->arity == 0) continue;
+        has_payload = true;
+        NovaVariantLayout *variant_layout = &layout->variants[v];
+        variant_layout->fields = static_cast<NovaFieldLayout *>(calloc(variant->arity, sizeof(NovaFieldLayout)));
+        if (!variant_layout->fields) {
+            ok = false;
+            break;
+        }
+        variant_layout->field_count = variant->arity;
+        for (size_t p = 0; p < variant->arity; ++p) {
+            NovaFieldLayout *field = &variant_layout->fields[p];
+            field->type = variant->payload_types[p];
+            const NovaTypeRecord *inner = nova_semantic_type_record(ctx, field->type);
+            if (!inner) continue;
+            size_t inner_index = (size_t)(inner - ctx->type_records.items);
+            if (builder->states[inner_index] == LAYOUT_PENDING) layout_record(builder, inner_index);
+            field->boxed = builder->states[inner_index] == LAYOUT_ACTIVE;
+        }
+    }
+    if (ok) {
+        if (!has_payload) {
+            classify_enum(layout);
+        } else if (!classify_niche(ctx, layout)) {
+            free(layout->c_type);
+            free(layout->llvm_type);
+            layout->c_type = NULL;
+            layout->llvm_type = NULL;
+            classify_tagged(ctx, record, layout);
+        }
+        ok = layout->c_type && layout->llvm_type;
+    }
+    builder->states[index] = LAYOUT_DONE;
+    if (!ok) {
+        nova_layout_free(layout);
+        return;
+    }
+    layout->order = builder->next_order++;
+    record->layout = layout;
+}
+
+void nova_layout_compute(NovaSemanticContext *ctx) {
+    size_t count = ctx->type_records.count;
+    if (count == 0) return;
+    LayoutBuilder builder = {ctx, static_cast<LayoutState *>(calloc(count, sizeof(LayoutState))), 0};
+    if (!builder.states) return;
+    for (size_t i = 0; i < count; ++i) {
+        const NovaTypeLayout *layout = ctx->type_records.items[i].layout;
+        if (!layout) continue;
+        builder.states[i] = LAYOUT_DONE;
+        if (layout->order >= builder.next_order) builder.next_order = layout->order + 1;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (builder.states[i] == LAYOUT_PENDING) layout_record(&builder, i);
+    }
+    free(builder.states);
+}
+
+void nova_layout_free(NovaTypeLayout *layout) {
+    if (!layout) return;
+    for (size_t v = 0; layout->variants && v < layout->variant_count; ++v) {
+        free(layout->variants[v].fields);
+    }
+    free(layout->variants);
+    free(layout->c_type);
+    free(layout->llvm_type);
+    free(layout);
+}
@@ -24,6 +24,10 @@ static bool nova_match_keyword(const char *lexeme, size_t length, NovaTokenType
 
     switch (lexeme[0]) {
     case 'a':
+        if (length == 3 && memcmp(lexeme, "and", 3) == 0) {
+            *type = NOVA_TOKEN_AND;
+            return true;
+        }
         if (length == 5 && memcmp(lexeme, "async", 5) == 0) {
             *type = NOVA_TOKEN_ASYNC;
             return true;
@@ -75,6 +79,18 @@ static bool nova_match_keyword(const char *lexeme, size_t length, NovaTokenType
             return true;
         }
         return false;
+    case 'n':
+        if (length == 3 && memcmp(lexeme, "not", 3) == 0) {
+            *type = NOVA_TOKEN_NOT;
+            return true;
+        }
+        return false;
+    case 'o':
+        if (length == 2 && memcmp(lexeme, "or", 2) == 0) {
+            *type = NOVA_TOKEN_OR;
+            return true;
+        }
+        return false;
     case 't':
         if (length == 4 && memcmp(lexeme, "type", 4) == 0) {
             *type = NOVA_TOKEN_TYPE;
@@ -263,10 +279,36 @@ NovaToken nova_lexer_next(NovaLexer *lexer) {
             advance(lexer);
             return make_token(lexer, NOVA_TOKEN_ARROW_FN, start, 2, line, column);
         }
+        if (peek(lexer) == '=') {
+            advance(lexer);
+            return make_token(lexer, NOVA_TOKEN_EQUAL_EQUAL, start, 2, line, column);
+        }
         return make_token(lexer, NOVA_TOKEN_EQUAL, start, 1, line, column);
     case '!':
         advance(lexer);
+        if (peek(lexer) == '=') {
+            advance(lexer);
+            return make_token(lexer, NOVA_TOKEN_BANG_EQUAL, start, 2, line, column);
+        }
         return make_token(lexer, NOVA_TOKEN_BANG, start, 1, line, column);
+    case '<':
+        advance(lexer);
+        if (peek(lexer) == '=') {
+            advance(lexer);
+            return make_token(lexer, NOVA_TOKEN_LESS_EQUAL, start, 2, line, column);
+        }
+        return make_token(lexer, NOVA_TOKEN_LESS, start, 1, line, column);
+    case '>':
+        advance(lexer);
+        if (peek(lexer) == '=') {
+            advance(lexer);
+            return make_token(lexer, NOVA_TOKEN_GREATER_EQUAL, start, 2, line, column);
+        }
+        return make_token(lexer, NOVA_TOKEN_GREATER, start, 1, line, column);
+    case '+': advance(lexer); return make_token(lexer, NOVA_TOKEN_PLUS, start, 1, line, column);
+    case '*': advance(lexer); return make_token(lexer, NOVA_TOKEN_STAR, start, 1, line, column);
+    case '/': advance(lexer); return make_token(lexer, NOVA_TOKEN_SLASH, start, 1, line, column);
+    case '%': advance(lexer); return make_token(lexer, NOVA_TOKEN_PERCENT, start, 1, line, column);
     case '|':
         advance(lexer);
         if (peek(lexer) == '>') {
@@ -280,7 +322,7 @@ NovaToken nova_lexer_next(NovaLexer *lexer) {
             advance(lexer);
             return make_token(lexer, NOVA_TOKEN_ARROW, start, 2, line, column);
         }
-        break;
+        return make_token(lexer, NOVA_TOKEN_MINUS, start, 1, line, column);
     case '"':
         return lex_string(lexer);
     default:
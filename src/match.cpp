@@ -0,0 +1,558 @@
+#include "nova/match.h"
+
+#include "nova/numconv.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Decision trees follow Maranget, "Compiling Pattern Matching to Good Decision
+// Trees": rows are arms, columns are occurrences (the scrutinee and the payload
+// fields reached so far). Each switch tests one occurrence and specialises the
+// matrix per case, so no occurrence is tested twice on any path.
+
+typedef struct MatchBinding {
+    NovaToken name;
+    size_t occurrence;
+    struct MatchBinding *next;
+} MatchBinding;
+
+typedef struct {
+    const NovaPattern **patterns; // one per column; NULL where specialisation introduced a wildcard
+    size_t arm;
+    MatchBinding *bindings; // bound by columns that were already removed
+} MatchRow;
+
+typedef struct {
+    MatchRow *rows;
+    size_t row_count;
+    size_t *columns; // occurrence per column
+    size_t column_count;
+} MatchMatrix;
+
+typedef struct {
+    const NovaSemanticContext *ctx;
+    const NovaMatchExpr *match;
+    NovaMatchPlan *plan;
+    MatchBinding **pool;
+    size_t pool_count;
+    size_t pool_capacity;
+    bool ok;
+} MatchCompiler;
+
+size_t nova_match_pattern_variant(const NovaSemanticContext *ctx, const NovaPattern *pattern, NovaTypeId type) {
+    if (!pattern || (pattern->kind != NOVA_PATTERN_NAME && pattern->kind != NOVA_PATTERN_CONSTRUCTOR)) return SIZE_MAX;
+    return nova_semantic_find_variant(nova_semantic_type_record(ctx, type), &pattern->token);
+}
+
+char *nova_match_decode_string(const char *literal, size_t length, size_t *out_length) {
+    const char *text = literal;
+    size_t text_length = length;
+    bool raw = false;
+    if (length >= 6 && strncmp(literal, "\"\"\"", 3) == 0) {
+        text += 3;
+        text_length -= 6;
+        raw = true;
+    } else if (length >= 2 && literal[0] == '"') {
+        text += 1;
+        text_length -= 2;
+    }
+    char *value = static_cast<char *>(malloc(text_length + 1));
+    if (!value) return NULL;
+    size_t used = 0;
+    for (size_t i = 0; i < text_length; ++i) {
+        char c = text[i];
+        if (!raw && c == '\\' && i + 1 < text_length) {
+            char escaped = text[++i];
+            switch (escaped) {
+            case 'n': c = '\n'; break;
+            case 't': c = '\t'; break;
+            case 'r': c = '\r'; break;
+            case '0': c = '\0'; break;
+            default: c = escaped; break;
+            }
+        }
+        value[used++] = c;
+    }
+    value[used] = '\0';
+    if (out_length) *out_length = used;
+    return value;
+}
+
+static bool literal_equals(const NovaPattern *a, const NovaPattern *b) {
+    if (a->literal_kind != b->literal_kind) return false;
+    switch (a->literal_kind) {
+    case NOVA_LITERAL_NUMBER: {
+        // Integral literals may be Ints beyond the range doubles hold exactly.
+        int64_t left_int, right_int;
+        if (nova_integer_parse(a->token.lexeme, a->token.length, &left_int) && nova_integer_parse(b->token.lexeme, b->token.length, &right_int)) {
+            return left_int == right_int;
+        }
+        double left = 0.0, right = 0.0;
+        nova_number_parse(a->token.lexeme, a->token.length, &left);
+        nova_number_parse(b->token.lexeme, b->token.length, &right);
+        return left == right;
+    }
+    case NOVA_LITERAL_BOOL:
+        return a->token.type == b->token.type;
+    case NOVA_LITERAL_STRING: {
+        size_t left_length = 0, right_length = 0;
+        char *left = nova_match_decode_string(a->token.lexeme, a->token.length, &left_length);
+        char *right = nova_match_decode_string(b->token.lexeme, b->token.length, &right_length);
+        bool equal = left && right && left_length == right_length && memcmp(left, right, left_length) == 0;
+        free(left);
+        free(right);
+        return equal;
+    }
+    default:
+        return false;
+    }
+}
+
+// Literals and variants of the column's type need a test; everything else,
+// including constructors the type does not have (already reported), matches.
+static bool is_refutable(const MatchCompiler *compiler, const NovaPattern *pattern, NovaTypeId type) {
+    if (!pattern) return false;
+    if (pattern->kind == NOVA_PATTERN_LITERAL) return true;
+    return nova_match_pattern_variant(compiler->ctx, pattern, type) != SIZE_MAX;
+}
+
+static bool same_head(const MatchCompiler *compiler, const NovaPattern *a, const NovaPattern *b, NovaTypeId type) {
+    if (a->kind == NOVA_PATTERN_LITERAL || b->kind == NOVA_PATTERN_LITERAL) {
+        return a->kind == b->kind && literal_equals(a, b);
+    }
+    return nova_match_pattern_variant(compiler->ctx, a, type) == nova_match_pattern_variant(compiler->ctx, b, type);
+}
+
+static bool is_binding(const MatchCompiler *compiler, const NovaPattern *pattern, NovaTypeId type) {
+    return pattern && pattern->kind == NOVA_PATTERN_NAME && nova_match_pattern_variant(compiler->ctx, pattern, type) == SIZE_MAX;
+}
+
+static MatchBinding *push_binding(MatchCompiler *compiler, MatchBinding *next, NovaToken name, size_t occurrence) {
+    if (compiler->pool_count == compiler->pool_capacity) {
+        size_t new_capacity = compiler->pool_capacity == 0 ? 16 : compiler->pool_capacity * 2;
+        MatchBinding **pool = static_cast<MatchBinding **>(realloc(compiler->pool, new_capacity * sizeof(MatchBinding *)));
+        if (!pool) {
+            compiler->ok = false;
+            return next;
+        }
+        compiler->pool = pool;
+        compiler->pool_capacity = new_capacity;
+    }
+    MatchBinding *binding = static_cast<MatchBinding *>(malloc(sizeof(MatchBinding)));
+    if (!binding) {
+        compiler->ok = false;
+        return next;
+    }
+    binding->name = name;
+    binding->occurrence = occurrence;
+    binding->next = next;
+    compiler->pool[compiler->pool_count++] = binding;
+    return binding;
+}
+
+static size_t add_occurrence(MatchCompiler *compiler, NovaTypeId type, size_t parent, size_t field) {
+    NovaMatchPlan *plan = compiler->plan;
+    if (plan->occurrence_count == plan->occurrence_capacity) {
+        size_t new_capacity = plan->occurrence_capacity == 0 ? 8 : plan->occurrence_capacity * 2;
+        NovaMatchOccurrence *occurrences = static_cast<NovaMatchOccurrence *>(realloc(plan->occurrences, new_capacity * sizeof(NovaMatchOccurrence)));
+        if (!occurrences) {
+            compiler->ok = false;
+            return 0;
+        }
+        plan->occurrences = occurrences;
+        plan->occurrence_capacity = new_capacity;
+    }
+    NovaMatchOccurrence *occurrence = &plan->occurrences[plan->occurrence_count];
+    occurrence->type = type;
+    occurrence->parent = parent;
+    occurrence->field = field;
+    occurrence->used = false;
+    return plan->occurrence_count++;
+}
+
+static NovaDecision *decision_new(MatchCompiler *compiler, NovaDecisionKind kind) {
+    NovaDecision *node = static_cast<NovaDecision *>(calloc(1, sizeof(NovaDecision)));
+    if (!node) {
+        compiler->ok = false;
+        return NULL;
+    }
+    node->kind = kind;
+    return node;
+}
+
+static void decision_free(NovaDecision *node) {
+    if (!node) return;
+    for (size_t i = 0; i < node->case_count; ++i) {
+        decision_free(node->cases[i].next);
+    }
+    free(node->cases);
+    decision_free(node->fallback);
+    free(node->bindings);
+    decision_free(node->guard_failed);
+    free(node);
+}
+
+static bool matrix_alloc(MatchMatrix *matrix, size_t row_count, size_t column_count) {
+    matrix->row_count = row_count;
+    matrix->column_count = column_count;
+    matrix->rows = static_cast<MatchRow *>(calloc(row_count ? row_count : 1, sizeof(MatchRow)));
+    matrix->columns = static_cast<size_t *>(calloc(column_count ? column_count : 1, sizeof(size_t)));
+    const NovaPattern **cells = static_cast<const NovaPattern **>(calloc(row_count * column_count != 0 ? row_count * column_count : 1, sizeof(NovaPattern *)));
+    if (!matrix->rows || !matrix->columns || !cells) {
+        free(matrix->rows);
+        free(matrix->columns);
+        free(cells);
+        matrix->rows = NULL;
+        matrix->columns = NULL;
+        return false;
+    }
+    for (size_t r = 0; r < row_count; ++r) {
+        matrix->rows[r].patterns = cells + r * column_count;
+    }
+    if (row_count == 0) free(cells);
+    return true;
+}
+
+static void matrix_free(MatchMatrix *matrix) {
+    if (matrix->rows && matrix->row_count > 0) free(matrix->rows[0].patterns);
+    free(matrix->rows);
+    free(matrix->columns);
+}
+
+static NovaDecision *compile_matrix(MatchCompiler *compiler, const MatchMatrix *matrix);
+
+static NovaDecision *compile_arm(MatchCompiler *compiler, const MatchMatrix *matrix) {
+    NovaMatchPlan *plan = compiler->plan;
+    const MatchRow *row = &matrix->rows[0];
+    NovaDecision *node = decision_new(compiler, NOVA_DECISION_ARM);
+    if (!node) return NULL;
+    node->arm = row->arm;
+    plan->arm_reachable[row->arm] = true;
+    size_t list_count = 0;
+    for (const MatchBinding *binding = row->bindings; binding; binding = binding->next) list_count++;
+    size_t count = list_count;
+    for (size_t c = 0; c < matrix->column_count; ++c) {
+        if (is_binding(compiler, row->patterns[c], plan->occurrences[matrix->columns[c]].type)) count++;
+    }
+    if (count > 0) {
+        node->bindings = static_cast<NovaDecisionBinding *>(calloc(count, sizeof(NovaDecisionBinding)));
+        if (!node->bindings) {
+            compiler->ok = false;
+            return node;
+        }
+        // The list runs newest first; store bindings in pattern order.
+        size_t index = list_count;
+        for (const MatchBinding *binding = row->bindings; binding; binding = binding->next) {
+            node->bindings[--index] = NovaDecisionBinding{binding->name, binding->occurrence};
+        }
+        index = list_count;
+        for (size_t c = 0; c < matrix->column_count; ++c) {
+            if (is_binding(compiler, row->patterns[c], plan->occurrences[matrix->columns[c]].type)) {
+                node->bindings[index++] = NovaDecisionBinding{row->patterns[c]->token, matrix->columns[c]};
+            }
+        }
+        node->binding_count = count;
+        for (size_t b = 0; b < count; ++b) {
+            plan->occurrences[node->bindings[b].occurrence].used = true;
+        }
+    }
+    if (compiler->match->arms.items[row->arm].guard) {
+        MatchMatrix rest = *matrix;
+        rest.rows = matrix->rows + 1;
+        rest.row_count = matrix->row_count - 1;
+        node->guard_failed = compile_matrix(compiler, &rest);
+    }
+    return node;
+}
+
+// Builds the matrix for values whose occurrence at column matches head (or,
+// when head is NULL, matches none of the heads): the column is replaced by
+// the head's payload fields, and rows with a different head are dropped.
+static bool specialise(MatchCompiler *compiler,
+                       const MatchMatrix *matrix,
+                       size_t column,
+                       const NovaPattern *head,
+                       size_t arity,
+                       size_t first_field,
+                       MatchMatrix *out) {
+    size_t occurrence = matrix->columns[column];
+    NovaTypeId type = compiler->plan->occurrences[occurrence].type;
+    size_t row_count = 0;
+    for (size_t r = 0; r < matrix->row_count; ++r) {
+        const NovaPattern *pattern = matrix->rows[r].patterns[column];
+        if (!is_refutable(compiler, pattern, type) || (head && same_head(compiler, pattern, head, type))) row_count++;
+    }
+    size_t column_count = matrix->column_count - 1 + arity;
+    if (!matrix_alloc(out, row_count, column_count)) {
+        compiler->ok = false;
+        return false;
+    }
+    for (size_t c = 0; c < column; ++c) out->columns[c] = matrix->columns[c];
+    for (size_t f = 0; f < arity; ++f) out->columns[column + f] = first_field + f;
+    for (size_t c = column + 1; c < matrix->column_count; ++c) out->columns[c - 1 + arity] = matrix->columns[c];
+    size_t index = 0;
+    for (size_t r = 0; r < matrix->row_count; ++r) {
+        const MatchRow *row = &matrix->rows[r];
+        const NovaPattern *pattern = row->patterns[column];
+        bool refutable = is_refutable(compiler, pattern, type);
+        if (refutable && !(head && same_head(compiler, pattern, head, type))) continue;
+        MatchRow *target = &out->rows[index++];
+        target->arm = row->arm;
+        target->bindings = row->bindings;
+        if (is_binding(compiler, pattern, type)) {
+            target->bindings = push_binding(compiler, row->bindings, pattern->token, occurrence);
+            compiler->plan->occurrences[occurrence].used = true;
+        }
+        for (size_t c = 0; c < column; ++c) target->patterns[c] = row->patterns[c];
+        for (size_t f = 0; f < arity; ++f) {
+            bool has_arg = refutable && pattern->kind == NOVA_PATTERN_CONSTRUCTOR && f < pattern->args.count;
+            target->patterns[column + f] = has_arg ? pattern->args.items[f] : NULL;
+        }
+        for (size_t c = column + 1; c < matrix->column_count; ++c) target->patterns[c - 1 + arity] = row->patterns[c];
+    }
+    return true;
+}
+
+static NovaDecision *compile_switch(MatchCompiler *compiler, const MatchMatrix *matrix, size_t column) {
+    NovaMatchPlan *plan = compiler->plan;
+    size_t occurrence = matrix->columns[column];
+    NovaTypeId type = plan->occurrences[occurrence].type;
+    const NovaTypeRecord *record = nova_semantic_type_record(compiler->ctx, type);
+    NovaDecision *node = decision_new(compiler, NOVA_DECISION_SWITCH);
+    if (!node) return NULL;
+    node->occurrence = occurrence;
+    plan->occurrences[occurrence].used = true;
+
+    const NovaPattern **heads = static_cast<const NovaPattern **>(calloc(matrix->row_count, sizeof(NovaPattern *)));
+    node->cases = static_cast<NovaDecisionCase *>(calloc(matrix->row_count, sizeof(NovaDecisionCase)));
+    if (!heads || !node->cases) {
+        free(heads);
+        compiler->ok = false;
+        return node;
+    }
+    size_t head_count = 0;
+    bool has_variant = false;
+    for (size_t r = 0; r < matrix->row_count; ++r) {
+        const NovaPattern *pattern = matrix->rows[r].patterns[column];
+        if (!is_refutable(compiler, pattern, type)) continue;
+        bool seen = false;
+        for (size_t h = 0; h < head_count && !seen; ++h) seen = same_head(compiler, heads[h], pattern, type);
+        if (seen) continue;
+        heads[head_count++] = pattern;
+        if (pattern->kind != NOVA_PATTERN_LITERAL) has_variant = true;
+    }
+
+    for (size_t h = 0; h < head_count && compiler->ok; ++h) {
+        NovaDecisionCase *decision_case = &node->cases[node->case_count++];
+        size_t arity = 0;
+        if (heads[h]->kind == NOVA_PATTERN_LITERAL) {
+            decision_case->tag = SIZE_MAX;
+            decision_case->literal = heads[h];
+        } else {
+            decision_case->tag = nova_match_pattern_variant(compiler->ctx, heads[h], type);
+            arity = record->variants[decision_case->tag].arity;
+        }
+        decision_case->first_field = plan->occurrence_count;
+        for (size_t f = 0; f < arity; ++f) {
+            add_occurrence(compiler, record->variants[decision_case->tag].payload_types[f], occurrence, f);
+        }
+        MatchMatrix specialised{};
+        if (!specialise(compiler, matrix, column, heads[h], arity, decision_case->first_field, &specialised)) break;
+        decision_case->next = compile_matrix(compiler, &specialised);
+        matrix_free(&specialised);
+    }
+
+    bool complete = false;
+    if (has_variant && record) {
+        complete = head_count == record->variant_count;
+    } else if (type == compiler->ctx->type_bool) {
+        complete = head_count == 2;
+    }
+    if (!complete && compiler->ok) {
+        MatchMatrix rest{};
+        if (specialise(compiler, matrix, column, NULL, 0, 0, &rest)) {
+            node->fallback = compile_matrix(compiler, &rest);
+            matrix_free(&rest);
+        }
+    }
+    free(heads);
+    return node;
+}
+
+static NovaDecision *compile_matrix(MatchCompiler *compiler, const MatchMatrix *matrix) {
+    if (!compiler->ok) return NULL;
+    if (matrix->row_count == 0) {
+        compiler->plan->exhaustive = false;
+        return decision_new(compiler, NOVA_DECISION_FAIL);
+    }
+    // Test the column the first row needs that the most leading rows also
+    // test, which keeps trees small for the common shapes of match.
+    const MatchRow *first = &matrix->rows[0];
+    size_t best = SIZE_MAX;
+    size_t best_score = 0;
+    for (size_t c = 0; c < matrix->column_count; ++c) {
+        NovaTypeId type = compiler->plan->occurrences[matrix->columns[c]].type;
+        if (!is_refutable(compiler, first->patterns[c], type)) continue;
+        size_t score = 0;
+        while (score < matrix->row_count && is_refutable(compiler, matrix->rows[score].patterns[c], type)) score++;
+        if (best == SIZE_MAX || score > best_score) {
+            best = c;
+            best_score = score;
+        }
+    }
+    if (best == SIZE_MAX) return compile_arm(compiler, matrix);
+    return compile_switch(compiler, matrix, best);
+}
+
+bool nova_match_compile(const NovaSemanticContext *ctx, const NovaMatchExpr *match, NovaTypeId scrutinee_type, NovaMatchPlan *plan) {
+    memset(plan, 0, sizeof(*plan));
+    plan->exhaustive = true;
+    plan->arm_count = match->arms.count;
+    plan->arm_reachable = static_cast<bool *>(calloc(match->arms.count ? match->arms.count : 1, sizeof(bool)));
+    MatchCompiler compiler{};
+    compiler.ctx = ctx;
+    compiler.match = match;
+    compiler.plan = plan;
+    compiler.ok = plan->arm_reachable != NULL;
+    if (compiler.ok) add_occurrence(&compiler, scrutinee_type, SIZE_MAX, 0);
+    MatchMatrix matrix{};
+    if (compiler.ok && matrix_alloc(&matrix, match->arms.count, 1)) {
+        matrix.columns[0] = 0;
+        for (size_t i = 0; i < match->arms.count; ++i) {
+            matrix.rows[i].patterns[0] = match->arms.items[i].pattern;
+            matrix.rows[i].arm = i;
+        }
+        plan->root = compile_matrix(&compiler, &matrix);
+        matrix_free(&matrix);
+    } else {
+        compiler.ok = false;
+    }
+    for (size_t i = 0; i < compiler.pool_count; ++i) free(compiler.pool[i]);
+    free(compiler.pool);
+    if (!compiler.ok) {
+        nova_match_plan_free(plan);
+        return false;
+    }
+    return true;
+}
+
+void nova_match_plan_free(NovaMatchPlan *plan) {
+    if (!plan) return;
+    decision_free(plan->root);
+    free(plan->occurrences);
+    free(plan->arm_reachable);
+    memset(plan, 0, sizeof(*plan));
+}
+
+uint32_t nova_match_string_hash(const char *text, size_t length, uint32_t seed) {
+    uint32_t hash = 2166136261u ^ seed;
+    for (size_t i = 0; i < length; ++i) {
+        hash = (hash ^ (unsigned char)text[i]) * 16777619u;
+    }
+    return hash;
+}
+
+uint32_t nova_match_hash_mix(uint32_t hash) {
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+typedef struct {
+    size_t bucket;
+    size_t size;
+} HashBucket;
+
+static int compare_buckets(const void *left, const void *right) {
+    const HashBucket *a = static_cast<const HashBucket *>(left);
+    const HashBucket *b = static_cast<const HashBucket *>(right);
+    if (a->size != b->size) return a->size > b->size ? -1 : 1;
+    return a->bucket < b->bucket ? -1 : (a->bucket > b->bucket ? 1 : 0);
+}
+
+// Hash and displace: keys are grouped into buckets by their hash, and the
+// largest buckets pick a displacement first that moves all of their keys into
+// free slots. Keys must be distinct.
+static bool build_perfect_hash(const uint32_t *hashes, size_t count, size_t bucket_count, size_t slot_count, NovaPerfectHash *out) {
+    HashBucket *buckets = static_cast<HashBucket *>(calloc(bucket_count, sizeof(HashBucket)));
+    size_t *members = static_cast<size_t *>(malloc(count * sizeof(size_t)));
+    size_t *placed = static_cast<size_t *>(malloc(count * sizeof(size_t)));
+    bool *taken = static_cast<bool *>(calloc(slot_count, sizeof(bool)));
+    out->displacements = static_cast<uint32_t *>(calloc(bucket_count, sizeof(uint32_t)));
+    out->slots = static_cast<uint32_t *>(calloc(slot_count, sizeof(uint32_t)));
+    bool ok = buckets && members && placed && taken && out->displacements && out->slots;
+    for (size_t b = 0; ok && b < bucket_count; ++b) buckets[b].bucket = b;
+    for (size_t k = 0; ok && k < count; ++k) buckets[hashes[k] & (bucket_count - 1)].size++;
+    if (ok) qsort(buckets, bucket_count, sizeof(HashBucket), compare_buckets);
+    for (size_t b = 0; ok && b < bucket_count && buckets[b].size > 0; ++b) {
+        size_t member_count = 0;
+        for (size_t k = 0; k < count; ++k) {
+            if ((hashes[k] & (bucket_count - 1)) == buckets[b].bucket) members[member_count++] = k;
+        }
+        bool found = false;
+        for (uint32_t displacement = 0; displacement < (1u << 16) && !found; ++displacement) {
+            size_t placed_count = 0;
+            for (; placed_count < member_count; ++placed_count) {
+                size_t slot = nova_match_hash_mix(hashes[members[placed_count]] ^ displacement) & (slot_count - 1);
+                if (taken[slot]) break;
+                taken[slot] = true;
+                placed[placed_count] = slot;
+            }
+            if (placed_count == member_count) {
+                found = true;
+                out->displacements[buckets[b].bucket] = displacement;
+                for (size_t m = 0; m < member_count; ++m) out->slots[placed[m]] = (uint32_t)members[m];
+            } else {
+                for (size_t m = 0; m < placed_count; ++m) taken[placed[m]] = false;
+            }
+        }
+        ok = found;
+    }
+    free(buckets);
+    free(members);
+    free(placed);
+    free(taken);
+    if (ok) {
+        out->bucket_count = bucket_count;
+        out->slot_count = slot_count;
+    } else {
+        free(out->displacements);
+        free(out->slots);
+        out->displacements = NULL;
+        out->slots = NULL;
+    }
+    return ok;
+}
+
+bool nova_match_perfect_hash(const char *const *keys, const size_t *lengths, size_t count, NovaPerfectHash *hash) {
+    memset(hash, 0, sizeof(*hash));
+    if (count == 0) return false;
+    uint32_t *hashes = static_cast<uint32_t *>(malloc(count * sizeof(uint32_t)));
+    if (!hashes) return false;
+    size_t slot_count = 1;
+    while (slot_count < count) slot_count <<= 1;
+    size_t bucket_count = 1;
+    while (bucket_count * 4 < count) bucket_count <<= 1;
+    bool ok = false;
+    // A new seed separates keys whose full hashes collide; a larger table
+    // makes displacements easier to find.
+    for (uint32_t attempt = 0; attempt < 8 && !ok; ++attempt) {
+        hash->seed = attempt * 0x9e3779b9u;
+        for (size_t k = 0; k < count; ++k) hashes[k] = nova_match_string_hash(keys[k], lengths[k], hash->seed);
+        ok = build_perfect_hash(hashes, count, bucket_count, slot_count, hash);
+        if (attempt % 2 == 1) slot_count <<= 1;
+    }
+    free(hashes);
+    return ok;
+}
+
+void nova_perfect_hash_free(NovaPerfectHash *hash) {
+    if (!hash) return;
+    free(hash->displacements);
+    free(hash->slots);
+    memset(hash, 0, sizeof(*hash));
+}
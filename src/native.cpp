@@ -0,0 +1,1747 @@
+#include "nova/native.h"
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// Each function is lowered to a linear list of instructions over virtual
+// registers (LIR), every virtual register gets one location for its whole
+// live interval by linear scan, and the LIR is then encoded instruction by
+// instruction. Operands that were spilled go through the scratch registers
+// rax/r11 and xmm15/xmm14, which the allocator never hands out; rdx is kept
+// free for idiv. Calls and the parameter copy at entry stage their values in
+// a small area at the bottom of the frame, which turns the argument shuffle
+// into plain loads and stores. Values live across a call only in
+// callee-saved registers or stack slots.
+
+#define NATIVE_NONE (-1)
+
+enum {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15,
+};
+
+enum {
+    XMM0 = 0,
+    XMM14 = 14,
+    XMM15 = 15,
+};
+
+enum {
+    CC_B = 0x2,
+    CC_E = 0x4,
+    CC_NE = 0x5,
+    CC_AE = 0x3,
+    CC_A = 0x7,
+    CC_P = 0xA,
+    CC_NP = 0xB,
+    CC_L = 0xC,
+    CC_GE = 0xD,
+    CC_LE = 0xE,
+    CC_G = 0xF,
+};
+
+static const int gpr_argument_registers[] = {RDI, RSI, RDX, RCX, R8, R9};
+#define NATIVE_GPR_ARGUMENTS 6
+#define NATIVE_XMM_ARGUMENTS 8
+// Allocation order: caller-saved first, so callee-saved registers are left
+// for values that live across calls and cost a push only when used.
+static const int allocatable_caller_saved[] = {RSI, RDI, RCX, R8, R9, R10};
+static const int allocatable_callee_saved[] = {RBX, R12, R13, R14, R15};
+#define NATIVE_ALLOCATABLE_XMM 14
+
+typedef enum {
+    NATIVE_GPR, // Int, Bool
+    NATIVE_XMM, // Number
+} NativeClass;
+
+typedef enum {
+    LIR_PARAMS, // defines the parameters' vregs (the argument pool) from the incoming registers
+    LIR_CONST, // dst = imm, the value's bits
+    LIR_MOVE,
+    LIR_INT_ARITH, // dst = a op b for op ADD, SUB or MUL, wrapping
+    LIR_INT_DIV,
+    LIR_INT_REM,
+    LIR_INT_NEG,
+    LIR_INT_COMPARE, // dst = a op b, also for Bool operands
+    LIR_NOT,
+    LIR_F64_ARITH, // ADD, SUB, MUL or DIV
+    LIR_F64_REM,
+    LIR_F64_NEG,
+    LIR_F64_COMPARE,
+    LIR_INT_TO_F64,
+    LIR_F64_TO_INT, // saturating, NaN becomes 0
+    LIR_LABEL, // imm is the label
+    LIR_JUMP,
+    LIR_BRANCH_FALSE, // to label imm when a is zero
+    LIR_CALL, // dst = function imm applied to the argument pool slice
+    LIR_TAIL_CALL, // returns what function imm returns, reusing the frame's return address
+    LIR_RETURN, // a, or nothing for Unit
+    LIR_TRAP,
+} LirOp;
+
+typedef struct {
+    LirOp op;
+    NovaOperator arith;
+    int32_t dst;
+    int32_t a;
+    int32_t b;
+    uint64_t imm;
+    size_t first_arg;
+    size_t arg_count;
+} LirInst;
+
+typedef struct {
+    NativeClass cls;
+    int32_t start; // first and last instruction touching the vreg; start > end while unused
+    int32_t end;
+    bool crosses_call;
+    bool boolean; // a Bool parameter, whose caller only defines the low byte
+    int reg; // physical register, or NATIVE_NONE when spilled
+    int32_t slot; // spill slot when reg is NATIVE_NONE
+} NativeVReg;
+
+typedef struct {
+    NovaToken name;
+    int32_t vreg;
+    bool assigned; // the target of some assignment: reads take a copy
+} NativeBinding;
+
+typedef struct {
+    size_t head; // instruction index of the loop's first instruction
+    size_t back_edge; // instruction index of the jump back to it
+} NativeLoop;
+
+typedef struct {
+    const NovaIRProgram *program;
+    const NovaSemanticContext *semantics;
+    const NovaIRFunction *fn;
+    size_t fn_index;
+    LirInst *insts;
+    size_t inst_count;
+    size_t inst_capacity;
+    int32_t *args; // operand lists of calls and LIR_PARAMS
+    size_t arg_count;
+    size_t arg_capacity;
+    NativeVReg *vregs;
+    size_t vreg_count;
+    size_t vreg_capacity;
+    NativeBinding *bindings;
+    size_t binding_count;
+    size_t binding_capacity;
+    NativeLoop *loops;
+    size_t loop_count;
+    size_t loop_capacity;
+    size_t label_count;
+    size_t entry_label; // self tail calls jump here
+    size_t params_inst;
+    bool ok;
+    char *error_buffer;
+    size_t error_buffer_size;
+} NativeFunction;
+
+static bool native_reserve(void **items, size_t *capacity, size_t needed, size_t item_size) {
+    if (needed <= *capacity) return true;
+    size_t next = *capacity ? *capacity * 2 : 16;
+    while (next < needed) next *= 2;
+    void *grown = realloc(*items, next * item_size);
+    if (!grown) return false;
+    *items = grown;
+    *capacity = next;
+    return true;
+}
+
+static void native_fail(NativeFunction *nf, const char *format, ...) {
+    if (nf->ok && nf->error_buffer && nf->error_buffer_size > 0) {
+        va_list args;
+        va_start(args, format);
+        vsnprintf(nf->error_buffer, nf->error_buffer_size, format, args);
+        va_end(args);
+    }
+    nf->ok = false;
+}
+
+static void native_unsupported(NativeFunction *nf, const char *what) {
+    native_fail(nf, "native backend does not support %s (in %.*s)", what, (int)nf->fn->name.length, nf->fn->name.lexeme);
+}
+
+static const char *type_kind_description(NovaTypeKind kind) {
+    switch (kind) {
+    case NOVA_TYPE_KIND_STRING: return "String values";
+    case NOVA_TYPE_KIND_LIST: return "List values";
+    case NOVA_TYPE_KIND_MAP: return "Map values";
+    case NOVA_TYPE_KIND_FUNCTION: return "function values";
+    case NOVA_TYPE_KIND_CUSTOM: return "sum and tuple values";
+    default: return "values of this type";
+    }
+}
+
+// Number and untyped values are doubles, as in the C backend.
+static bool native_class_of(NativeFunction *nf, NovaTypeId type, NativeClass *cls, bool *unit) {
+    const NovaTypeInfo *info = nova_semantic_type_info(nf->semantics, type);
+    NovaTypeKind kind = info ? info->kind : NOVA_TYPE_KIND_UNKNOWN;
+    *unit = kind == NOVA_TYPE_KIND_UNIT;
+    switch (kind) {
+    case NOVA_TYPE_KIND_UNKNOWN:
+    case NOVA_TYPE_KIND_NUMBER:
+        *cls = NATIVE_XMM;
+        return true;
+    case NOVA_TYPE_KIND_INT:
+    case NOVA_TYPE_KIND_BOOL:
+    case NOVA_TYPE_KIND_UNIT:
+        *cls = NATIVE_GPR;
+        return true;
+    default:
+        native_unsupported(nf, type_kind_description(kind));
+        return false;
+    }
+}
+
+static int32_t native_new_vreg(NativeFunction *nf, NativeClass cls) {
+    if (!native_reserve(reinterpret_cast<void **>(&nf->vregs), &nf->vreg_capacity, nf->vreg_count + 1, sizeof(NativeVReg))) {
+        native_fail(nf, "out of memory");
+        return NATIVE_NONE;
+    }
+    NativeVReg *vreg = &nf->vregs[nf->vreg_count];
+    vreg->cls = cls;
+    vreg->start = INT32_MAX;
+    vreg->end = -1;
+    vreg->crosses_call = false;
+    vreg->boolean = false;
+    vreg->reg = NATIVE_NONE;
+    vreg->slot = 0;
+    return (int32_t)nf->vreg_count++;
+}
+
+static LirInst *native_emit(NativeFunction *nf, LirOp op) {
+    static LirInst sink;
+    if (!native_reserve(reinterpret_cast<void **>(&nf->insts), &nf->inst_capacity, nf->inst_count + 1, sizeof(LirInst))) {
+        native_fail(nf, "out of memory");
+        return &sink;
+    }
+    LirInst *inst = &nf->insts[nf->inst_count++];
+    memset(inst, 0, sizeof(*inst));
+    inst->op = op;
+    inst->dst = NATIVE_NONE;
+    inst->a = NATIVE_NONE;
+    inst->b = NATIVE_NONE;
+    return inst;
+}
+
+static size_t native_new_label(NativeFunction *nf) {
+    return nf->label_count++;
+}
+
+static void native_place_label(NativeFunction *nf, size_t label) {
+    native_emit(nf, LIR_LABEL)->imm = label;
+}
+
+static void native_jump(NativeFunction *nf, LirOp op, size_t label, int32_t condition) {
+    LirInst *inst = native_emit(nf, op);
+    inst->imm = label;
+    inst->a = condition;
+}
+
+static void native_move(NativeFunction *nf, int32_t dst, int32_t src) {
+    if (dst == NATIVE_NONE || src == NATIVE_NONE || dst == src) return;
+    LirInst *inst = native_emit(nf, LIR_MOVE);
+    inst->dst = dst;
+    inst->a = src;
+}
+
+static int32_t native_const(NativeFunction *nf, NativeClass cls, uint64_t bits) {
+    int32_t dst = native_new_vreg(nf, cls);
+    LirInst *inst = native_emit(nf, LIR_CONST);
+    inst->dst = dst;
+    inst->imm = bits;
+    return dst;
+}
+
+static uint64_t double_bits(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static int32_t native_binary(NativeFunction *nf, LirOp op, NovaOperator arith, NativeClass cls, int32_t a, int32_t b) {
+    int32_t dst = native_new_vreg(nf, cls);
+    LirInst *inst = native_emit(nf, op);
+    inst->arith = arith;
+    inst->dst = dst;
+    inst->a = a;
+    inst->b = b;
+    return dst;
+}
+
+static size_t native_push_args(NativeFunction *nf, const int32_t *vregs, size_t count) {
+    if (!native_reserve(reinterpret_cast<void **>(&nf->args), &nf->arg_capacity, nf->arg_count + count, sizeof(int32_t))) {
+        native_fail(nf, "out of memory");
+        return 0;
+    }
+    size_t first = nf->arg_count;
+    if (count > 0) memcpy(nf->args + first, vregs, count * sizeof(int32_t));
+    nf->arg_count += count;
+    return first;
+}
+
+static bool native_bind(NativeFunction *nf, NovaToken name, int32_t vreg, bool assigned) {
+    if (!native_reserve(reinterpret_cast<void **>(&nf->bindings), &nf->binding_capacity, nf->binding_count + 1, sizeof(NativeBinding))) {
+        native_fail(nf, "out of memory");
+        return false;
+    }
+    nf->bindings[nf->binding_count].name = name;
+    nf->bindings[nf->binding_count].vreg = vreg;
+    nf->bindings[nf->binding_count].assigned = assigned;
+    nf->binding_count++;
+    return true;
+}
+
+static const NativeBinding *native_lookup(const NativeFunction *nf, const NovaToken *name) {
+    for (size_t i = nf->binding_count; i > 0; --i) {
+        const NativeBinding *binding = &nf->bindings[i - 1];
+        if (binding->name.length == name->length && memcmp(binding->name.lexeme, name->lexeme, name->length) == 0) return binding;
+    }
+    return NULL;
+}
+
+static void native_add_loop(NativeFunction *nf, size_t head, size_t back_edge) {
+    if (!native_reserve(reinterpret_cast<void **>(&nf->loops), &nf->loop_capacity, nf->loop_count + 1, sizeof(NativeLoop))) {
+        native_fail(nf, "out of memory");
+        return;
+    }
+    nf->loops[nf->loop_count].head = head;
+    nf->loops[nf->loop_count].back_edge = back_edge;
+    nf->loop_count++;
+}
+
+typedef struct {
+    const NovaToken *name;
+    bool found;
+} AssignFinder;
+
+static void find_assignment(NovaIRExpr **slot, void *ctx) {
+    AssignFinder *finder = static_cast<AssignFinder *>(ctx);
+    if (!*slot || finder->found) return;
+    const NovaIRExpr *expr = *slot;
+    if (expr->kind == NOVA_IR_EXPR_ASSIGN && expr->as.assign.target.length == finder->name->length &&
+        memcmp(expr->as.assign.target.lexeme, finder->name->lexeme, finder->name->length) == 0) {
+        finder->found = true;
+        return;
+    }
+    nova_ir_expr_for_each_child(*slot, find_assignment, ctx);
+}
+
+static int32_t lower_expr(NativeFunction *nf, const NovaIRExpr *expr);
+static void lower_tail(NativeFunction *nf, const NovaIRExpr *expr);
+
+static int32_t lower_operator(NativeFunction *nf, const NovaIRExpr *expr) {
+    NovaOperator op = expr->as.op.op;
+    const NovaTypeInfo *info = nova_semantic_type_info(nf->semantics, expr->as.op.left->type);
+    if (op > NOVA_OP_TO_NUMBER) {
+        native_unsupported(nf, type_kind_description(info ? info->kind : NOVA_TYPE_KIND_UNKNOWN));
+        return NATIVE_NONE;
+    }
+    NativeClass cls;
+    bool unit;
+    if (!native_class_of(nf, expr->as.op.left->type, &cls, &unit)) return NATIVE_NONE;
+    bool is_int = info && info->kind == NOVA_TYPE_KIND_INT;
+    int32_t left = lower_expr(nf, expr->as.op.left);
+    int32_t right = NATIVE_NONE;
+    if (expr->as.op.right) right = lower_expr(nf, expr->as.op.right);
+    if (!nf->ok) return NATIVE_NONE;
+    if (unit || left == NATIVE_NONE || (expr->as.op.right && right == NATIVE_NONE)) {
+        native_unsupported(nf, "operators on Unit");
+        return NATIVE_NONE;
+    }
+    switch (op) {
+    case NOVA_OP_ADD:
+    case NOVA_OP_SUB:
+    case NOVA_OP_MUL:
+        return native_binary(nf, cls == NATIVE_XMM ? LIR_F64_ARITH : LIR_INT_ARITH, op, cls, left, right);
+    case NOVA_OP_DIV:
+        return native_binary(nf, cls == NATIVE_XMM ? LIR_F64_ARITH : LIR_INT_DIV, op, cls, left, right);
+    case NOVA_OP_MOD:
+        return native_binary(nf, cls == NATIVE_XMM ? LIR_F64_REM : LIR_INT_REM, op, cls, left, right);
+    case NOVA_OP_LT:
+    case NOVA_OP_LE:
+    case NOVA_OP_GT:
+    case NOVA_OP_GE:
+    case NOVA_OP_EQ:
+    case NOVA_OP_NE:
+        return native_binary(nf, cls == NATIVE_XMM ? LIR_F64_COMPARE : LIR_INT_COMPARE, op, NATIVE_GPR, left, right);
+    case NOVA_OP_NEG:
+        return native_binary(nf, cls == NATIVE_XMM ? LIR_F64_NEG : LIR_INT_NEG, op, cls, left, NATIVE_NONE);
+    case NOVA_OP_NOT:
+        return native_binary(nf, LIR_NOT, op, NATIVE_GPR, left, NATIVE_NONE);
+    case NOVA_OP_TO_INT:
+        return is_int ? left : native_binary(nf, LIR_F64_TO_INT, op, NATIVE_GPR, left, NATIVE_NONE);
+    case NOVA_OP_TO_NUMBER:
+        return is_int ? native_binary(nf, LIR_INT_TO_F64, op, NATIVE_XMM, left, NATIVE_NONE) : left;
+    default:
+        native_unsupported(nf, "this operator");
+        return NATIVE_NONE;
+    }
+}
+
+static bool lower_call_args(NativeFunction *nf, const NovaIRExpr *expr, int32_t *values) {
+    size_t gprs = 0, xmms = 0;
+    for (size_t i = 0; i < expr->as.call.arg_count; ++i) {
+        values[i] = lower_expr(nf, expr->as.call.args[i]);
+        if (!nf->ok) return false;
+        if (values[i] == NATIVE_NONE) {
+            native_unsupported(nf, "Unit arguments");
+            return false;
+        }
+        if (nf->vregs[values[i]].cls == NATIVE_GPR) {
+            gprs++;
+        } else {
+            xmms++;
+        }
+    }
+    if (gprs > NATIVE_GPR_ARGUMENTS || xmms > NATIVE_XMM_ARGUMENTS) {
+        native_unsupported(nf, "calls passing arguments on the stack");
+        return false;
+    }
+    return true;
+}
+
+static int32_t lower_call(NativeFunction *nf, const NovaIRExpr *expr, LirOp op) {
+    size_t callee = nova_ir_find_function(nf->program, &expr->as.call.callee);
+    if (callee == SIZE_MAX) {
+        native_unsupported(nf, "calls to functions outside the module");
+        return NATIVE_NONE;
+    }
+    int32_t *values = static_cast<int32_t *>(calloc(expr->as.call.arg_count + 1, sizeof(int32_t)));
+    if (!values) {
+        native_fail(nf, "out of memory");
+        return NATIVE_NONE;
+    }
+    int32_t dst = NATIVE_NONE;
+    if (lower_call_args(nf, expr, values)) {
+        NativeClass cls;
+        bool unit;
+        if (native_class_of(nf, nf->program->functions[callee].return_type, &cls, &unit)) {
+            if (!unit && op == LIR_CALL) dst = native_new_vreg(nf, cls);
+            size_t first = native_push_args(nf, values, expr->as.call.arg_count);
+            LirInst *inst = native_emit(nf, op);
+            inst->dst = dst;
+            inst->imm = callee;
+            inst->first_arg = first;
+            inst->arg_count = expr->as.call.arg_count;
+        }
+    }
+    free(values);
+    return dst;
+}
+
+// A self call in tail position reassigns the parameters and jumps back to
+// the top of the body, so tail-recursive loops run in constant stack.
+static void lower_self_tail_call(NativeFunction *nf, const NovaIRExpr *expr) {
+    int32_t *values = static_cast<int32_t *>(calloc(expr->as.call.arg_count + 1, sizeof(int32_t)));
+    if (!values) {
+        native_fail(nf, "out of memory");
+        return;
+    }
+    if (lower_call_args(nf, expr, values)) {
+        const int32_t *params = nf->args + nf->insts[nf->params_inst].first_arg;
+        // An argument that is itself a parameter is copied first, so the
+        // reassignment behaves as a parallel move.
+        for (size_t i = 0; i < expr->as.call.arg_count; ++i) {
+            for (size_t p = 0; p < nf->fn->param_count; ++p) {
+                if (values[i] != params[p] || p == i) continue;
+                int32_t copy = native_new_vreg(nf, nf->vregs[values[i]].cls);
+                native_move(nf, copy, values[i]);
+                values[i] = copy;
+                break;
+            }
+        }
+        for (size_t i = 0; i < expr->as.call.arg_count; ++i) native_move(nf, params[i], values[i]);
+        native_jump(nf, LIR_JUMP, nf->entry_label, NATIVE_NONE);
+    }
+    free(values);
+}
+
+typedef struct {
+    size_t label; // where the arm's test starts
+    const NovaIRMatchArm *arm;
+} NativeArm;
+
+// Literal arms are tested in order; a catch-all arm ends the chain and a
+// match without one traps when nothing matched. With result NATIVE_NONE
+// and tail set the arms return, otherwise they move into result.
+static int32_t lower_match(NativeFunction *nf, const NovaIRExpr *expr, bool tail) {
+    const NovaIRExpr *scrutinee = expr->as.match_expr.scrutinee;
+    const NovaTypeInfo *info = nova_semantic_type_info(nf->semantics, scrutinee->type);
+    NovaTypeKind kind = info ? info->kind : NOVA_TYPE_KIND_UNKNOWN;
+    if (kind != NOVA_TYPE_KIND_NUMBER && kind != NOVA_TYPE_KIND_INT && kind != NOVA_TYPE_KIND_BOOL) {
+        native_unsupported(nf, kind == NOVA_TYPE_KIND_STRING ? "String matches" : "matches on sum and tuple values");
+        return NATIVE_NONE;
+    }
+    int32_t subject = lower_expr(nf, scrutinee);
+    if (!nf->ok) return NATIVE_NONE;
+    int32_t result = NATIVE_NONE;
+    if (!tail) {
+        NativeClass cls;
+        bool unit;
+        if (!native_class_of(nf, expr->type, &cls, &unit)) return NATIVE_NONE;
+        if (!unit) result = native_new_vreg(nf, cls);
+    }
+    size_t end = native_new_label(nf);
+    bool has_fallback = false;
+    for (size_t i = 0; nf->ok && i < expr->as.match_expr.arm_count; ++i) {
+        const NovaIRMatchArm *arm = &expr->as.match_expr.arms[i];
+        size_t next = native_new_label(nf);
+        if (arm->literal) {
+            int32_t literal = kind == NOVA_TYPE_KIND_NUMBER ? native_const(nf, NATIVE_XMM, double_bits(arm->literal->as.number_value))
+                              : kind == NOVA_TYPE_KIND_INT  ? native_const(nf, NATIVE_GPR, (uint64_t)arm->literal->as.int_value)
+                                                            : native_const(nf, NATIVE_GPR, arm->literal->as.bool_value ? 1 : 0);
+            int32_t equal = native_binary(nf, kind == NOVA_TYPE_KIND_NUMBER ? LIR_F64_COMPARE : LIR_INT_COMPARE, NOVA_OP_EQ, NATIVE_GPR, subject, literal);
+            native_jump(nf, LIR_BRANCH_FALSE, next, equal);
+        }
+        if (tail) {
+            lower_tail(nf, arm->body);
+        } else {
+            native_move(nf, result, lower_expr(nf, arm->body));
+            native_jump(nf, LIR_JUMP, end, NATIVE_NONE);
+        }
+        native_place_label(nf, next);
+        if (!arm->literal) {
+            has_fallback = true;
+            break;
+        }
+    }
+    if (!has_fallback) native_emit(nf, LIR_TRAP);
+    native_place_label(nf, end);
+    return result;
+}
+
+static int32_t lower_if(NativeFunction *nf, const NovaIRExpr *expr, bool tail) {
+    int32_t condition = lower_expr(nf, expr->as.if_expr.condition);
+    if (!nf->ok) return NATIVE_NONE;
+    int32_t result = NATIVE_NONE;
+    if (!tail) {
+        NativeClass cls;
+        bool unit;
+        if (!native_class_of(nf, expr->type, &cls, &unit)) return NATIVE_NONE;
+        if (!unit) result = native_new_vreg(nf, cls);
+    }
+    size_t otherwise = native_new_label(nf);
+    size_t end = native_new_label(nf);
+    native_jump(nf, LIR_BRANCH_FALSE, otherwise, condition);
+    if (tail) {
+        lower_tail(nf, expr->as.if_expr.then_branch);
+    } else {
+        native_move(nf, result, lower_expr(nf, expr->as.if_expr.then_branch));
+        native_jump(nf, LIR_JUMP, end, NATIVE_NONE);
+    }
+    native_place_label(nf, otherwise);
+    if (tail) {
+        if (expr->as.if_expr.else_branch) {
+            lower_tail(nf, expr->as.if_expr.else_branch);
+        } else {
+            native_emit(nf, LIR_RETURN);
+        }
+    } else if (expr->as.if_expr.else_branch) {
+        native_move(nf, result, lower_expr(nf, expr->as.if_expr.else_branch));
+    }
+    native_place_label(nf, end);
+    return result;
+}
+
+static int32_t lower_expr(NativeFunction *nf, const NovaIRExpr *expr) {
+    if (!nf->ok || !expr) return NATIVE_NONE;
+    switch (expr->kind) {
+    case NOVA_IR_EXPR_NUMBER: {
+        // Zero placeholders for other types (such as an unset loop result) use their own zero.
+        NativeClass cls;
+        bool unit;
+        if (!native_class_of(nf, expr->type, &cls, &unit)) return NATIVE_NONE;
+        if (unit) return NATIVE_NONE;
+        return native_const(nf, cls, cls == NATIVE_XMM ? double_bits(expr->as.number_value) : (uint64_t)(int64_t)expr->as.number_value);
+    }
+    case NOVA_IR_EXPR_INT:
+        return native_const(nf, NATIVE_GPR, (uint64_t)expr->as.int_value);
+    case NOVA_IR_EXPR_BOOL:
+        return native_const(nf, NATIVE_GPR, expr->as.bool_value ? 1 : 0);
+    case NOVA_IR_EXPR_UNIT:
+        return NATIVE_NONE;
+    case NOVA_IR_EXPR_IDENTIFIER: {
+        const NativeBinding *binding = native_lookup(nf, &expr->as.identifier);
+        if (!binding) {
+            native_unsupported(nf, "function values");
+            return NATIVE_NONE;
+        }
+        if (!binding->assigned || binding->vreg == NATIVE_NONE) return binding->vreg;
+        int32_t copy = native_new_vreg(nf, nf->vregs[binding->vreg].cls);
+        native_move(nf, copy, binding->vreg);
+        return copy;
+    }
+    case NOVA_IR_EXPR_CALL:
+        return lower_call(nf, expr, LIR_CALL);
+    case NOVA_IR_EXPR_SEQUENCE: {
+        int32_t value = NATIVE_NONE;
+        for (size_t i = 0; i < expr->as.sequence.count; ++i) value = lower_expr(nf, expr->as.sequence.items[i]);
+        return value;
+    }
+    case NOVA_IR_EXPR_IF:
+        return lower_if(nf, expr, false);
+    case NOVA_IR_EXPR_WHILE: {
+        size_t head = native_new_label(nf);
+        size_t end = native_new_label(nf);
+        size_t head_inst = nf->inst_count;
+        native_place_label(nf, head);
+        int32_t condition = lower_expr(nf, expr->as.while_expr.condition);
+        native_jump(nf, LIR_BRANCH_FALSE, end, condition);
+        lower_expr(nf, expr->as.while_expr.body);
+        native_add_loop(nf, head_inst, nf->inst_count);
+        native_jump(nf, LIR_JUMP, head, NATIVE_NONE);
+        native_place_label(nf, end);
+        return NATIVE_NONE;
+    }
+    case NOVA_IR_EXPR_MATCH:
+        return lower_match(nf, expr, false);
+    case NOVA_IR_EXPR_LET: {
+        // The binding gets its own vreg: the value may be another binding
+        // that is assigned later.
+        int32_t value = lower_expr(nf, expr->as.let_expr.value);
+        if (!nf->ok) return NATIVE_NONE;
+        int32_t vreg = NATIVE_NONE;
+        if (value != NATIVE_NONE) {
+            vreg = native_new_vreg(nf, nf->vregs[value].cls);
+            native_move(nf, vreg, value);
+        }
+        size_t saved = nf->binding_count;
+        if (!native_bind(nf, expr->as.let_expr.name, vreg, expr->as.let_expr.is_mutable)) return NATIVE_NONE;
+        int32_t result = lower_expr(nf, expr->as.let_expr.body);
+        nf->binding_count = saved;
+        return result;
+    }
+    case NOVA_IR_EXPR_ASSIGN: {
+        const NativeBinding *binding = native_lookup(nf, &expr->as.assign.target);
+        int32_t value = lower_expr(nf, expr->as.assign.value);
+        if (!binding) {
+            native_unsupported(nf, "assignments to unknown names");
+            return NATIVE_NONE;
+        }
+        native_move(nf, binding->vreg, value);
+        return NATIVE_NONE;
+    }
+    case NOVA_IR_EXPR_OPERATOR:
+        return lower_operator(nf, expr);
+    case NOVA_IR_EXPR_STRING:
+        native_unsupported(nf, "String values");
+        return NATIVE_NONE;
+    case NOVA_IR_EXPR_LIST:
+        native_unsupported(nf, "List values");
+        return NATIVE_NONE;
+    case NOVA_IR_EXPR_CONSTRUCT:
+        native_unsupported(nf, "sum and tuple values");
+        return NATIVE_NONE;
+    case NOVA_IR_EXPR_CLOSURE:
+    case NOVA_IR_EXPR_APPLY:
+        native_unsupported(nf, "function values");
+        return NATIVE_NONE;
+    }
+    return NATIVE_NONE;
+}
+
+static void lower_tail(NativeFunction *nf, const NovaIRExpr *expr) {
+    if (!nf->ok) return;
+    if (!expr) {
+        native_emit(nf, LIR_RETURN);
+        return;
+    }
+    switch (expr->kind) {
+    case NOVA_IR_EXPR_IF:
+        lower_if(nf, expr, true);
+        return;
+    case NOVA_IR_EXPR_MATCH:
+        lower_match(nf, expr, true);
+        return;
+    case NOVA_IR_EXPR_SEQUENCE:
+        if (expr->as.sequence.count == 0) break;
+        for (size_t i = 0; i + 1 < expr->as.sequence.count; ++i) lower_expr(nf, expr->as.sequence.items[i]);
+        lower_tail(nf, expr->as.sequence.items[expr->as.sequence.count - 1]);
+        return;
+    case NOVA_IR_EXPR_LET: {
+        int32_t value = lower_expr(nf, expr->as.let_expr.value);
+        if (!nf->ok) return;
+        int32_t vreg = NATIVE_NONE;
+        if (value != NATIVE_NONE) {
+            vreg = native_new_vreg(nf, nf->vregs[value].cls);
+            native_move(nf, vreg, value);
+        }
+        size_t saved = nf->binding_count;
+        if (!native_bind(nf, expr->as.let_expr.name, vreg, expr->as.let_expr.is_mutable)) return;
+        lower_tail(nf, expr->as.let_expr.body);
+        nf->binding_count = saved;
+        return;
+    }
+    case NOVA_IR_EXPR_CALL: {
+        size_t callee = nova_ir_find_function(nf->program, &expr->as.call.callee);
+        if (callee == nf->fn_index) {
+            lower_self_tail_call(nf, expr);
+            return;
+        }
+        // Arguments never go on the stack, so any callee returning the same
+        // type can take over this frame's return address.
+        if (callee != SIZE_MAX && nf->program->functions[callee].return_type == nf->fn->return_type) {
+            lower_call(nf, expr, LIR_TAIL_CALL);
+            return;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    int32_t value = lower_expr(nf, expr);
+    native_emit(nf, LIR_RETURN)->a = value;
+}
+
+static bool lower_function(NativeFunction *nf) {
+    const NovaIRFunction *fn = nf->fn;
+    int32_t *params = static_cast<int32_t *>(calloc(fn->param_count + 1, sizeof(int32_t)));
+    if (!params) {
+        native_fail(nf, "out of memory");
+        return false;
+    }
+    size_t gprs = 0, xmms = 0;
+    for (size_t i = 0; nf->ok && i < fn->param_count; ++i) {
+        NativeClass cls;
+        bool unit;
+        if (!native_class_of(nf, fn->params[i].type, &cls, &unit)) break;
+        if (unit) {
+            native_unsupported(nf, "Unit parameters");
+            break;
+        }
+        if (cls == NATIVE_GPR) {
+            gprs++;
+        } else {
+            xmms++;
+        }
+        params[i] = native_new_vreg(nf, cls);
+        const NovaTypeInfo *info = nova_semantic_type_info(nf->semantics, fn->params[i].type);
+        if (params[i] != NATIVE_NONE) nf->vregs[params[i]].boolean = info && info->kind == NOVA_TYPE_KIND_BOOL;
+        AssignFinder finder = {&fn->params[i].name, false};
+        NovaIRExpr *body = fn->body;
+        find_assignment(&body, &finder);
+        native_bind(nf, fn->params[i].name, params[i], finder.found);
+    }
+    if (nf->ok && (gprs > NATIVE_GPR_ARGUMENTS || xmms > NATIVE_XMM_ARGUMENTS)) native_unsupported(nf, "parameters passed on the stack");
+    NativeClass cls;
+    bool unit;
+    if (nf->ok) native_class_of(nf, fn->return_type, &cls, &unit);
+    if (nf->ok) {
+        size_t first = native_push_args(nf, params, fn->param_count);
+        nf->params_inst = nf->inst_count;
+        LirInst *inst = native_emit(nf, LIR_PARAMS);
+        inst->first_arg = first;
+        inst->arg_count = fn->param_count;
+        nf->entry_label = native_new_label(nf);
+        size_t head = nf->inst_count;
+        native_place_label(nf, nf->entry_label);
+        lower_tail(nf, fn->body);
+        // Every jump back to the entry label closes a loop.
+        for (size_t i = head; nf->ok && i < nf->inst_count; ++i) {
+            if (nf->insts[i].op == LIR_JUMP && nf->insts[i].imm == nf->entry_label) native_add_loop(nf, head, i);
+        }
+    }
+    free(params);
+    return nf->ok;
+}
+
+// Live intervals are conservative: each vreg holds its location from its
+// first to its last mention, and a value live into a loop keeps it to the
+// loop's back edge.
+static void compute_intervals(NativeFunction *nf) {
+    for (size_t i = 0; i < nf->inst_count; ++i) {
+        const LirInst *inst = &nf->insts[i];
+        int32_t operands[3] = {inst->dst, inst->a, inst->b};
+        for (int k = 0; k < 3; ++k) {
+            if (operands[k] == NATIVE_NONE) continue;
+            NativeVReg *vreg = &nf->vregs[operands[k]];
+            if ((int32_t)i < vreg->start) vreg->start = (int32_t)i;
+            if ((int32_t)i > vreg->end) vreg->end = (int32_t)i;
+        }
+        if (inst->op == LIR_CALL || inst->op == LIR_TAIL_CALL || inst->op == LIR_PARAMS) {
+            for (size_t k = 0; k < inst->arg_count; ++k) {
+                NativeVReg *vreg = &nf->vregs[nf->args[inst->first_arg + k]];
+                if ((int32_t)i < vreg->start) vreg->start = (int32_t)i;
+                if ((int32_t)i > vreg->end) vreg->end = (int32_t)i;
+            }
+        }
+    }
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t l = 0; l < nf->loop_count; ++l) {
+            int32_t head = (int32_t)nf->loops[l].head;
+            int32_t back_edge = (int32_t)nf->loops[l].back_edge;
+            for (size_t v = 0; v < nf->vreg_count; ++v) {
+                NativeVReg *vreg = &nf->vregs[v];
+                if (vreg->start < head && vreg->end >= head && vreg->end < back_edge) {
+                    vreg->end = back_edge;
+                    changed = true;
+                }
+            }
+        }
+    }
+    for (size_t i = 0; i < nf->inst_count; ++i) {
+        if (nf->insts[i].op != LIR_CALL) continue;
+        for (size_t v = 0; v < nf->vreg_count; ++v) {
+            NativeVReg *vreg = &nf->vregs[v];
+            if (vreg->start < (int32_t)i && vreg->end > (int32_t)i) vreg->crosses_call = true;
+        }
+    }
+}
+
+typedef struct {
+    int reg_owner[16]; // vreg holding each GPR, NATIVE_NONE when free
+    int xmm_owner[16];
+    int32_t slot_count;
+} NativeAllocation;
+
+static int *owner_of(NativeAllocation *allocation, NativeClass cls) {
+    return cls == NATIVE_GPR ? allocation->reg_owner : allocation->xmm_owner;
+}
+
+static bool register_allowed(const NativeVReg *vreg, int reg) {
+    if (vreg->cls == NATIVE_XMM) return !vreg->crosses_call && reg < NATIVE_ALLOCATABLE_XMM;
+    for (size_t i = 0; i < sizeof(allocatable_callee_saved) / sizeof(allocatable_callee_saved[0]); ++i) {
+        if (allocatable_callee_saved[i] == reg) return true;
+    }
+    if (vreg->crosses_call) return false;
+    for (size_t i = 0; i < sizeof(allocatable_caller_saved) / sizeof(allocatable_caller_saved[0]); ++i) {
+        if (allocatable_caller_saved[i] == reg) return true;
+    }
+    return false;
+}
+
+static int free_register(NativeAllocation *allocation, const NativeVReg *vreg) {
+    int *owner = owner_of(allocation, vreg->cls);
+    if (vreg->cls == NATIVE_XMM) {
+        for (int r = 0; r < NATIVE_ALLOCATABLE_XMM; ++r) {
+            if (owner[r] == NATIVE_NONE && register_allowed(vreg, r)) return r;
+        }
+        return NATIVE_NONE;
+    }
+    for (size_t i = 0; i < sizeof(allocatable_caller_saved) / sizeof(allocatable_caller_saved[0]); ++i) {
+        int r = allocatable_caller_saved[i];
+        if (owner[r] == NATIVE_NONE && register_allowed(vreg, r)) return r;
+    }
+    for (size_t i = 0; i < sizeof(allocatable_callee_saved) / sizeof(allocatable_callee_saved[0]); ++i) {
+        int r = allocatable_callee_saved[i];
+        if (owner[r] == NATIVE_NONE) return r;
+    }
+    return NATIVE_NONE;
+}
+
+static NativeFunction *sort_context;
+
+static int compare_interval_start(const void *left, const void *right) {
+    const NativeVReg *a = &sort_context->vregs[*static_cast<const int32_t *>(left)];
+    const NativeVReg *b = &sort_context->vregs[*static_cast<const int32_t *>(right)];
+    if (a->start != b->start) return a->start < b->start ? -1 : 1;
+    return *static_cast<const int32_t *>(left) < *static_cast<const int32_t *>(right) ? -1 : 1;
+}
+
+static void spill(NativeAllocation *allocation, NativeVReg *vreg) {
+    vreg->reg = NATIVE_NONE;
+    vreg->slot = allocation->slot_count++;
+}
+
+// Classic linear scan over intervals sorted by start. When no register
+// is free, whichever of the new interval and the active interval ending
+// last goes to the stack.
+static bool allocate_registers(NativeFunction *nf, NativeAllocation *allocation) {
+    for (int r = 0; r < 16; ++r) {
+        allocation->reg_owner[r] = NATIVE_NONE;
+        allocation->xmm_owner[r] = NATIVE_NONE;
+    }
+    allocation->slot_count = 0;
+    int32_t *order = static_cast<int32_t *>(malloc((nf->vreg_count + 1) * sizeof(int32_t)));
+    if (!order) return false;
+    size_t count = 0;
+    for (size_t v = 0; v < nf->vreg_count; ++v) {
+        if (nf->vregs[v].start <= nf->vregs[v].end) order[count++] = (int32_t)v;
+    }
+    sort_context = nf;
+    qsort(order, count, sizeof(int32_t), compare_interval_start);
+    for (size_t i = 0; i < count; ++i) {
+        NativeVReg *vreg = &nf->vregs[order[i]];
+        for (int r = 0; r < 16; ++r) {
+            int *owners[2] = {allocation->reg_owner, allocation->xmm_owner};
+            for (int c = 0; c < 2; ++c) {
+                if (owners[c][r] != NATIVE_NONE && nf->vregs[owners[c][r]].end < vreg->start) owners[c][r] = NATIVE_NONE;
+            }
+        }
+        int reg = free_register(allocation, vreg);
+        int *owner = owner_of(allocation, vreg->cls);
+        if (reg == NATIVE_NONE) {
+            int victim_reg = NATIVE_NONE;
+            for (int r = 0; r < 16; ++r) {
+                if (owner[r] == NATIVE_NONE || !register_allowed(vreg, r)) continue;
+                if (victim_reg == NATIVE_NONE || nf->vregs[owner[r]].end > nf->vregs[owner[victim_reg]].end) victim_reg = r;
+            }
+            if (victim_reg != NATIVE_NONE && nf->vregs[owner[victim_reg]].end > vreg->end) {
+                spill(allocation, &nf->vregs[owner[victim_reg]]);
+                reg = victim_reg;
+            }
+        }
+        if (reg == NATIVE_NONE) {
+            spill(allocation, vreg);
+        } else {
+            vreg->reg = reg;
+            owner[reg] = order[i];
+        }
+    }
+    free(order);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// x86-64 encoding
+
+typedef struct {
+    uint8_t *bytes;
+    size_t length;
+    size_t capacity;
+    bool failed;
+} NativeCode;
+
+static void code_byte(NativeCode *code, uint8_t byte) {
+    if (!native_reserve(reinterpret_cast<void **>(&code->bytes), &code->capacity, code->length + 1, 1)) {
+        code->failed = true;
+        return;
+    }
+    code->bytes[code->length++] = byte;
+}
+
+static void code_u32(NativeCode *code, uint32_t value) {
+    for (int i = 0; i < 4; ++i) code_byte(code, (uint8_t)(value >> (8 * i)));
+}
+
+static void code_u64(NativeCode *code, uint64_t value) {
+    for (int i = 0; i < 8; ++i) code_byte(code, (uint8_t)(value >> (8 * i)));
+}
+
+static void code_patch_u32(NativeCode *code, size_t offset, uint32_t value) {
+    if (code->failed) return;
+    for (int i = 0; i < 4; ++i) code->bytes[offset + (size_t)i] = (uint8_t)(value >> (8 * i));
+}
+
+typedef struct {
+    bool memory;
+    int reg; // register operand, or base register of a memory operand
+    int32_t disp;
+} Operand;
+
+static Operand reg_operand(int reg) {
+    Operand operand = {false, reg, 0};
+    return operand;
+}
+
+static Operand mem_operand(int base, int32_t disp) {
+    Operand operand = {true, base, disp};
+    return operand;
+}
+
+// prefix (0, 0x66, 0xF2 or 0xF3), REX, opcode (0x0Fxx for two bytes) and a
+// ModRM byte with reg in the reg field; memory operands always take a
+// 32-bit displacement.
+static void x86_emit(NativeCode *code, uint8_t prefix, bool wide, unsigned opcode, int reg, Operand rm) {
+    if (prefix) code_byte(code, prefix);
+    uint8_t rex = (uint8_t)(0x40 | (wide ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((rm.reg & 8) ? 1 : 0));
+    if (rex != 0x40) code_byte(code, rex);
+    if (opcode > 0xFF) code_byte(code, (uint8_t)(opcode >> 8));
+    code_byte(code, (uint8_t)opcode);
+    if (!rm.memory) {
+        code_byte(code, (uint8_t)(0xC0 | ((reg & 7) << 3) | (rm.reg & 7)));
+        return;
+    }
+    code_byte(code, (uint8_t)(0x80 | ((reg & 7) << 3) | (rm.reg & 7)));
+    if ((rm.reg & 7) == RSP) code_byte(code, 0x24);
+    code_u32(code, (uint32_t)rm.disp);
+}
+
+static void x86_mov_imm(NativeCode *code, int reg, uint64_t value) {
+    if (value <= UINT32_MAX) {
+        if (reg & 8) code_byte(code, 0x41);
+        code_byte(code, (uint8_t)(0xB8 | (reg & 7)));
+        code_u32(code, (uint32_t)value);
+    } else if ((int64_t)value >= INT32_MIN && (int64_t)value < 0) {
+        x86_emit(code, 0, true, 0xC7, 0, reg_operand(reg));
+        code_u32(code, (uint32_t)value);
+    } else {
+        code_byte(code, (uint8_t)(0x48 | ((reg & 8) ? 1 : 0)));
+        code_byte(code, (uint8_t)(0xB8 | (reg & 7)));
+        code_u64(code, value);
+    }
+}
+
+static void x86_push(NativeCode *code, int reg) {
+    if (reg & 8) code_byte(code, 0x41);
+    code_byte(code, (uint8_t)(0x50 | (reg & 7)));
+}
+
+static void x86_pop(NativeCode *code, int reg) {
+    if (reg & 8) code_byte(code, 0x41);
+    code_byte(code, (uint8_t)(0x58 | (reg & 7)));
+}
+
+typedef struct {
+    size_t offset; // of the rel32 field
+    size_t target; // label, or function index for calls
+} NativeFixup;
+
+typedef struct {
+    NativeCode *code;
+    NativeFunction *nf;
+    NativeAllocation allocation;
+    int saved[8]; // callee-saved registers pushed by the prologue
+    size_t saved_count;
+    size_t staging_slots;
+    size_t *labels; // code offset per label; SIZE_MAX until placed
+    size_t label_capacity;
+    size_t label_count;
+    NativeFixup *fixups;
+    size_t fixup_count;
+    size_t fixup_capacity;
+    NativeFixup **calls; // shared across functions
+    size_t *call_count;
+    size_t *call_capacity;
+    void *const *call_slots; // when set, calls go through call_slots[callee] instead
+} NativeEncoder;
+
+static size_t encoder_new_label(NativeEncoder *enc) {
+    if (!native_reserve(reinterpret_cast<void **>(&enc->labels), &enc->label_capacity, enc->label_count + 1, sizeof(size_t))) {
+        enc->code->failed = true;
+        return 0;
+    }
+    enc->labels[enc->label_count] = SIZE_MAX;
+    return enc->label_count++;
+}
+
+static void encoder_place(NativeEncoder *enc, size_t label) {
+    if (label < enc->label_count) enc->labels[label] = enc->code->length;
+}
+
+static void add_fixup(NativeFixup **fixups, size_t *count, size_t *capacity, NativeCode *code, size_t target) {
+    if (!native_reserve(reinterpret_cast<void **>(fixups), capacity, *count + 1, sizeof(NativeFixup))) {
+        code->failed = true;
+        return;
+    }
+    (*fixups)[*count].offset = code->length;
+    (*fixups)[*count].target = target;
+    (*count)++;
+    code_u32(code, 0);
+}
+
+// jmp (cc < 0) or jcc to a label of the function being encoded.
+static void encoder_jump(NativeEncoder *enc, int cc, size_t label) {
+    if (cc < 0) {
+        code_byte(enc->code, 0xE9);
+    } else {
+        code_byte(enc->code, 0x0F);
+        code_byte(enc->code, (uint8_t)(0x80 | cc));
+    }
+    add_fixup(&enc->fixups, &enc->fixup_count, &enc->fixup_capacity, enc->code, label);
+}
+
+static Operand spill_operand(const NativeEncoder *enc, const NativeVReg *vreg) {
+    return mem_operand(RBP, -(int32_t)(8 * (enc->saved_count + 1 + (size_t)vreg->slot)));
+}
+
+static Operand staging_operand(size_t index) {
+    return mem_operand(RSP, (int32_t)(8 * index));
+}
+
+static Operand vreg_operand(const NativeEncoder *enc, int32_t v) {
+    const NativeVReg *vreg = &enc->nf->vregs[v];
+    return vreg->reg != NATIVE_NONE ? reg_operand(vreg->reg) : spill_operand(enc, vreg);
+}
+
+static void load_gpr(NativeEncoder *enc, int32_t v, int target) {
+    Operand source = vreg_operand(enc, v);
+    if (!source.memory && source.reg == target) return;
+    x86_emit(enc->code, 0, true, 0x8B, target, source);
+}
+
+// The register holding v, loading it into scratch when v was spilled.
+static int gpr_in(NativeEncoder *enc, int32_t v, int scratch) {
+    const NativeVReg *vreg = &enc->nf->vregs[v];
+    if (vreg->reg != NATIVE_NONE) return vreg->reg;
+    load_gpr(enc, v, scratch);
+    return scratch;
+}
+
+static void store_gpr(NativeEncoder *enc, int32_t v, int source) {
+    if (v == NATIVE_NONE) return;
+    Operand target = vreg_operand(enc, v);
+    if (!target.memory && target.reg == source) return;
+    x86_emit(enc->code, 0, true, 0x89, source, target);
+}
+
+static void load_xmm(NativeEncoder *enc, int32_t v, int target) {
+    Operand source = vreg_operand(enc, v);
+    if (!source.memory && source.reg == target) return;
+    x86_emit(enc->code, 0xF2, false, 0x0F10, target, source);
+}
+
+static int xmm_in(NativeEncoder *enc, int32_t v, int scratch) {
+    const NativeVReg *vreg = &enc->nf->vregs[v];
+    if (vreg->reg != NATIVE_NONE) return vreg->reg;
+    load_xmm(enc, v, scratch);
+    return scratch;
+}
+
+static void store_xmm(NativeEncoder *enc, int32_t v, int source) {
+    if (v == NATIVE_NONE) return;
+    Operand target = vreg_operand(enc, v);
+    if (!target.memory && target.reg == source) return;
+    x86_emit(enc->code, 0xF2, false, target.memory ? 0x0F11 : 0x0F10, target.memory ? source : target.reg, target.memory ? target : reg_operand(source));
+}
+
+// Restores the callee-saved registers and the caller's frame, leaving rsp
+// at the return address.
+static void emit_frame_release(NativeEncoder *enc) {
+    x86_emit(enc->code, 0, true, 0x8D, RSP, mem_operand(RBP, -(int32_t)(8 * enc->saved_count)));
+    for (size_t i = enc->saved_count; i > 0; --i) x86_pop(enc->code, enc->saved[i - 1]);
+    x86_pop(enc->code, RBP);
+}
+
+static void emit_epilogue(NativeEncoder *enc) {
+    emit_frame_release(enc);
+    code_byte(enc->code, 0xC3);
+}
+
+static int int_condition(NovaOperator op) {
+    switch (op) {
+    case NOVA_OP_LT: return CC_L;
+    case NOVA_OP_LE: return CC_LE;
+    case NOVA_OP_GT: return CC_G;
+    case NOVA_OP_GE: return CC_GE;
+    case NOVA_OP_NE: return CC_NE;
+    default: return CC_E;
+    }
+}
+
+static void emit_setcc_result(NativeEncoder *enc, int cc, int32_t dst) {
+    x86_emit(enc->code, 0, false, 0x0F90 | (unsigned)cc, 0, reg_operand(RAX));
+    x86_emit(enc->code, 0, false, 0x0FB6, RAX, reg_operand(RAX));
+    store_gpr(enc, dst, RAX);
+}
+
+// Ordered comparisons: ucomisd sets CF, ZF and PF on NaN, which fails
+// above/above-or-equal and equal-with-no-parity, and passes not-equal.
+static void emit_f64_compare(NativeEncoder *enc, NovaOperator op, int32_t a, int32_t b, int32_t dst) {
+    NativeCode *code = enc->code;
+    load_xmm(enc, a, XMM15);
+    load_xmm(enc, b, XMM14);
+    switch (op) {
+    case NOVA_OP_LT:
+    case NOVA_OP_LE:
+        x86_emit(code, 0x66, false, 0x0F2E, XMM14, reg_operand(XMM15));
+        emit_setcc_result(enc, op == NOVA_OP_LT ? CC_A : CC_AE, dst);
+        return;
+    case NOVA_OP_GT:
+    case NOVA_OP_GE:
+        x86_emit(code, 0x66, false, 0x0F2E, XMM15, reg_operand(XMM14));
+        emit_setcc_result(enc, op == NOVA_OP_GT ? CC_A : CC_AE, dst);
+        return;
+    default: {
+        bool equal = op == NOVA_OP_EQ;
+        x86_emit(code, 0x66, false, 0x0F2E, XMM15, reg_operand(XMM14));
+        x86_emit(code, 0, false, 0x0F90 | (unsigned)(equal ? CC_E : CC_NE), 0, reg_operand(RAX));
+        x86_emit(code, 0, false, 0x0F90 | (unsigned)(equal ? CC_NP : CC_P), 0, reg_operand(R11));
+        x86_emit(code, 0, false, equal ? 0x20 : 0x08, R11, reg_operand(RAX));
+        x86_emit(code, 0, false, 0x0FB6, RAX, reg_operand(RAX));
+        store_gpr(enc, dst, RAX);
+        return;
+    }
+    }
+}
+
+// Mirrors nova_int_div and nova_int_rem: dividing by zero traps, and a
+// divisor of -1 is handled apart so INT64_MIN / -1 wraps instead of faulting.
+static void emit_int_division(NativeEncoder *enc, bool remainder, int32_t a, int32_t b, int32_t dst) {
+    NativeCode *code = enc->code;
+    size_t nonzero = encoder_new_label(enc), divide = encoder_new_label(enc), done = encoder_new_label(enc);
+    load_gpr(enc, a, RAX);
+    load_gpr(enc, b, R11);
+    x86_emit(code, 0, true, 0x85, R11, reg_operand(R11));
+    encoder_jump(enc, CC_NE, nonzero);
+    code_byte(code, 0x0F);
+    code_byte(code, 0x0B);
+    encoder_place(enc, nonzero);
+    x86_emit(code, 0, true, 0x83, 7, reg_operand(R11));
+    code_byte(code, 0xFF);
+    encoder_jump(enc, CC_NE, divide);
+    if (remainder) {
+        x86_emit(code, 0, false, 0x31, RAX, reg_operand(RAX));
+    } else {
+        x86_emit(code, 0, true, 0xF7, 3, reg_operand(RAX));
+    }
+    encoder_jump(enc, -1, done);
+    encoder_place(enc, divide);
+    code_byte(code, 0x48);
+    code_byte(code, 0x99);
+    x86_emit(code, 0, true, 0xF7, 7, reg_operand(R11));
+    if (remainder) x86_emit(code, 0, true, 0x8B, RAX, reg_operand(RDX));
+    encoder_place(enc, done);
+    store_gpr(enc, dst, RAX);
+}
+
+// Mirrors nova_int_from_f64: cvttsd2si yields INT64_MIN for NaN and out of
+// range values, which are then told apart.
+static void emit_f64_to_int(NativeEncoder *enc, int32_t a, int32_t dst) {
+    NativeCode *code = enc->code;
+    size_t nan = encoder_new_label(enc), done = encoder_new_label(enc);
+    int source = xmm_in(enc, a, XMM15);
+    x86_emit(code, 0xF2, true, 0x0F2C, RAX, reg_operand(source));
+    x86_mov_imm(code, R11, 0x8000000000000000ull);
+    x86_emit(code, 0, true, 0x3B, RAX, reg_operand(R11));
+    encoder_jump(enc, CC_NE, done);
+    x86_emit(code, 0x66, false, 0x0F57, XMM14, reg_operand(XMM14));
+    x86_emit(code, 0x66, false, 0x0F2E, source, reg_operand(XMM14));
+    encoder_jump(enc, CC_P, nan);
+    encoder_jump(enc, CC_B, done); // below zero: INT64_MIN is right
+    x86_emit(code, 0, true, 0xF7, 2, reg_operand(RAX));
+    encoder_jump(enc, -1, done);
+    encoder_place(enc, nan);
+    x86_emit(code, 0, false, 0x31, RAX, reg_operand(RAX));
+    encoder_place(enc, done);
+    store_gpr(enc, dst, RAX);
+}
+
+// fmod through the x87 partial remainder, repeated until it is complete.
+static void emit_f64_remainder(NativeEncoder *enc, int32_t a, int32_t b, int32_t dst) {
+    NativeCode *code = enc->code;
+    x86_emit(code, 0xF2, false, 0x0F11, xmm_in(enc, a, XMM15), staging_operand(0));
+    x86_emit(code, 0xF2, false, 0x0F11, xmm_in(enc, b, XMM14), staging_operand(1));
+    x86_emit(code, 0, false, 0xDD, 0, staging_operand(1));
+    x86_emit(code, 0, false, 0xDD, 0, staging_operand(0));
+    size_t again = code->length;
+    code_byte(code, 0xD9);
+    code_byte(code, 0xF8);
+    code_byte(code, 0xDF);
+    code_byte(code, 0xE0);
+    code_byte(code, 0xF6);
+    code_byte(code, 0xC4);
+    code_byte(code, 0x04);
+    code_byte(code, 0x75);
+    code_byte(code, (uint8_t)(again - (code->length + 1)));
+    x86_emit(code, 0, false, 0xDD, 3, staging_operand(0));
+    code_byte(code, 0xDD);
+    code_byte(code, 0xD8);
+    x86_emit(code, 0xF2, false, 0x0F10, XMM15, staging_operand(0));
+    store_xmm(enc, dst, XMM15);
+}
+
+// Values go through the staging area, so registers that are both sources
+// and argument registers never clobber each other.
+static void emit_argument_shuffle(NativeEncoder *enc, const int32_t *values, size_t count, bool incoming) {
+    NativeCode *code = enc->code;
+    size_t gpr = 0, xmm = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const NativeVReg *vreg = &enc->nf->vregs[values[i]];
+        if (vreg->cls == NATIVE_GPR) {
+            int source = incoming ? gpr_argument_registers[gpr++] : gpr_in(enc, values[i], RAX);
+            x86_emit(code, 0, true, 0x89, source, staging_operand(i));
+        } else {
+            int source = incoming ? xmm++ : xmm_in(enc, values[i], XMM15);
+            x86_emit(code, 0xF2, false, 0x0F11, source, staging_operand(i));
+        }
+    }
+    gpr = 0;
+    xmm = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const NativeVReg *vreg = &enc->nf->vregs[values[i]];
+        if (vreg->cls == NATIVE_GPR) {
+            int target = incoming ? (vreg->reg != NATIVE_NONE ? vreg->reg : RAX) : gpr_argument_registers[gpr++];
+            if (incoming && vreg->boolean) {
+                x86_emit(code, 0, false, 0x0FB6, target, staging_operand(i));
+            } else {
+                x86_emit(code, 0, true, 0x8B, target, staging_operand(i));
+            }
+            if (incoming) store_gpr(enc, values[i], target);
+        } else {
+            int target = incoming ? (vreg->reg != NATIVE_NONE ? vreg->reg : XMM15) : (int)xmm++;
+            x86_emit(code, 0xF2, false, 0x0F10, target, staging_operand(i));
+            if (incoming) store_xmm(enc, values[i], target);
+        }
+    }
+}
+
+static void encode_inst(NativeEncoder *enc, const LirInst *inst) {
+    NativeCode *code = enc->code;
+    NativeFunction *nf = enc->nf;
+    switch (inst->op) {
+    case LIR_PARAMS:
+        emit_argument_shuffle(enc, nf->args + inst->first_arg, inst->arg_count, true);
+        return;
+    case LIR_CONST:
+        if (nf->vregs[inst->dst].cls == NATIVE_GPR) {
+            const NativeVReg *vreg = &nf->vregs[inst->dst];
+            int target = vreg->reg != NATIVE_NONE ? vreg->reg : RAX;
+            x86_mov_imm(code, target, inst->imm);
+            store_gpr(enc, inst->dst, target);
+        } else {
+            x86_mov_imm(code, RAX, inst->imm);
+            const NativeVReg *vreg = &nf->vregs[inst->dst];
+            if (vreg->reg != NATIVE_NONE) {
+                x86_emit(code, 0x66, true, 0x0F6E, vreg->reg, reg_operand(RAX));
+            } else {
+                store_gpr(enc, inst->dst, RAX);
+            }
+        }
+        return;
+    case LIR_MOVE:
+        if (nf->vregs[inst->dst].cls == NATIVE_GPR) {
+            store_gpr(enc, inst->dst, gpr_in(enc, inst->a, RAX));
+        } else {
+            store_xmm(enc, inst->dst, xmm_in(enc, inst->a, XMM15));
+        }
+        return;
+    case LIR_INT_ARITH: {
+        load_gpr(enc, inst->a, RAX);
+        int right = gpr_in(enc, inst->b, R11);
+        unsigned opcode = inst->arith == NOVA_OP_ADD ? 0x03 : inst->arith == NOVA_OP_SUB ? 0x2B : 0x0FAF;
+        x86_emit(code, 0, true, opcode, RAX, reg_operand(right));
+        store_gpr(enc, inst->dst, RAX);
+        return;
+    }
+    case LIR_INT_DIV:
+    case LIR_INT_REM:
+        emit_int_division(enc, inst->op == LIR_INT_REM, inst->a, inst->b, inst->dst);
+        return;
+    case LIR_INT_NEG:
+        load_gpr(enc, inst->a, RAX);
+        x86_emit(code, 0, true, 0xF7, 3, reg_operand(RAX));
+        store_gpr(enc, inst->dst, RAX);
+        return;
+    case LIR_NOT:
+        load_gpr(enc, inst->a, RAX);
+        x86_emit(code, 0, true, 0x83, 6, reg_operand(RAX));
+        code_byte(code, 0x01);
+        store_gpr(enc, inst->dst, RAX);
+        return;
+    case LIR_INT_COMPARE: {
+        load_gpr(enc, inst->a, RAX);
+        int right = gpr_in(enc, inst->b, R11);
+        x86_emit(code, 0, true, 0x3B, RAX, reg_operand(right));
+        emit_setcc_result(enc, int_condition(inst->arith), inst->dst);
+        return;
+    }
+    case LIR_F64_ARITH: {
+        load_xmm(enc, inst->a, XMM15);
+        int right = xmm_in(enc, inst->b, XMM14);
+        unsigned opcode = inst->arith == NOVA_OP_ADD ? 0x0F58 : inst->arith == NOVA_OP_SUB ? 0x0F5C : inst->arith == NOVA_OP_MUL ? 0x0F59 : 0x0F5E;
+        x86_emit(code, 0xF2, false, opcode, XMM15, reg_operand(right));
+        store_xmm(enc, inst->dst, XMM15);
+        return;
+    }
+    case LIR_F64_REM:
+        emit_f64_remainder(enc, inst->a, inst->b, inst->dst);
+        return;
+    case LIR_F64_NEG:
+        x86_mov_imm(code, RAX, 0x8000000000000000ull);
+        x86_emit(code, 0x66, true, 0x0F6E, XMM14, reg_operand(RAX));
+        load_xmm(enc, inst->a, XMM15);
+        x86_emit(code, 0x66, false, 0x0F57, XMM15, reg_operand(XMM14));
+        store_xmm(enc, inst->dst, XMM15);
+        return;
+    case LIR_F64_COMPARE:
+        emit_f64_compare(enc, inst->arith, inst->a, inst->b, inst->dst);
+        return;
+    case LIR_INT_TO_F64:
+        x86_emit(code, 0xF2, true, 0x0F2A, XMM15, reg_operand(gpr_in(enc, inst->a, RAX)));
+        store_xmm(enc, inst->dst, XMM15);
+        return;
+    case LIR_F64_TO_INT:
+        emit_f64_to_int(enc, inst->a, inst->dst);
+        return;
+    case LIR_LABEL:
+        encoder_place(enc, (size_t)inst->imm);
+        return;
+    case LIR_JUMP:
+        encoder_jump(enc, -1, (size_t)inst->imm);
+        return;
+    case LIR_BRANCH_FALSE: {
+        int condition = gpr_in(enc, inst->a, RAX);
+        x86_emit(code, 0, true, 0x85, condition, reg_operand(condition));
+        encoder_jump(enc, CC_E, (size_t)inst->imm);
+        return;
+    }
+    case LIR_CALL:
+        emit_argument_shuffle(enc, nf->args + inst->first_arg, inst->arg_count, false);
+        if (enc->call_slots) {
+            x86_mov_imm(code, RAX, (uint64_t)(uintptr_t)&enc->call_slots[inst->imm]);
+            x86_emit(code, 0, false, 0xFF, 2, mem_operand(RAX, 0));
+        } else {
+            code_byte(code, 0xE8);
+            add_fixup(enc->calls, enc->call_count, enc->call_capacity, code, (size_t)inst->imm);
+        }
+        if (inst->dst != NATIVE_NONE) {
+            if (nf->vregs[inst->dst].cls == NATIVE_GPR) {
+                store_gpr(enc, inst->dst, RAX);
+            } else {
+                store_xmm(enc, inst->dst, XMM0);
+            }
+        }
+        return;
+    case LIR_TAIL_CALL:
+        // The argument registers survive the frame release, which only
+        // touches callee-saved registers, rsp and rbp.
+        emit_argument_shuffle(enc, nf->args + inst->first_arg, inst->arg_count, false);
+        emit_frame_release(enc);
+        if (enc->call_slots) {
+            x86_mov_imm(code, RAX, (uint64_t)(uintptr_t)&enc->call_slots[inst->imm]);
+            x86_emit(code, 0, false, 0xFF, 4, mem_operand(RAX, 0));
+        } else {
+            code_byte(code, 0xE9);
+            add_fixup(enc->calls, enc->call_count, enc->call_capacity, code, (size_t)inst->imm);
+        }
+        return;
+    case LIR_RETURN:
+        if (inst->a != NATIVE_NONE) {
+            if (nf->vregs[inst->a].cls == NATIVE_GPR) {
+                load_gpr(enc, inst->a, RAX);
+            } else {
+                load_xmm(enc, inst->a, XMM0);
+            }
+        }
+        emit_epilogue(enc);
+        return;
+    case LIR_TRAP:
+        code_byte(code, 0x0F);
+        code_byte(code, 0x0B);
+        return;
+    }
+}
+
+// Saves the callee-saved registers the allocation used and sizes the frame:
+// spill slots below them, the staging area at the bottom, and rsp 16-byte
+// aligned at every call.
+static void emit_prologue(NativeEncoder *enc) {
+    NativeFunction *nf = enc->nf;
+    NativeCode *code = enc->code;
+    enc->saved_count = 0;
+    for (size_t i = 0; i < sizeof(allocatable_callee_saved) / sizeof(allocatable_callee_saved[0]); ++i) {
+        int reg = allocatable_callee_saved[i];
+        for (size_t v = 0; v < nf->vreg_count; ++v) {
+            if (nf->vregs[v].cls == NATIVE_GPR && nf->vregs[v].reg == reg && nf->vregs[v].start <= nf->vregs[v].end) {
+                enc->saved[enc->saved_count++] = reg;
+                break;
+            }
+        }
+    }
+    enc->staging_slots = 2;
+    for (size_t i = 0; i < nf->inst_count; ++i) {
+        if ((nf->insts[i].op == LIR_CALL || nf->insts[i].op == LIR_TAIL_CALL || nf->insts[i].op == LIR_PARAMS) && nf->insts[i].arg_count > enc->staging_slots) {
+            enc->staging_slots = nf->insts[i].arg_count;
+        }
+    }
+    size_t frame = 8 * ((size_t)enc->allocation.slot_count + enc->staging_slots);
+    if ((8 * enc->saved_count + frame) % 16 != 0) frame += 8;
+    x86_push(code, RBP);
+    x86_emit(code, 0, true, 0x89, RSP, reg_operand(RBP));
+    for (size_t i = 0; i < enc->saved_count; ++i) x86_push(code, enc->saved[i]);
+    x86_emit(code, 0, true, 0x81, 5, reg_operand(RSP));
+    code_u32(code, (uint32_t)frame);
+}
+
+typedef struct {
+    size_t offset;
+    size_t size;
+} NativeSymbol;
+
+static bool encode_function(NativeFunction *nf, NativeCode *code, NativeFixup **calls, size_t *call_count, size_t *call_capacity, void *const *call_slots) {
+    NativeEncoder enc{};
+    enc.code = code;
+    enc.nf = nf;
+    enc.calls = calls;
+    enc.call_count = call_count;
+    enc.call_capacity = call_capacity;
+    enc.call_slots = call_slots;
+    compute_intervals(nf);
+    if (!allocate_registers(nf, &enc.allocation)) {
+        native_fail(nf, "out of memory");
+        return false;
+    }
+    for (size_t i = 0; i < nf->label_count; ++i) encoder_new_label(&enc);
+    emit_prologue(&enc);
+    for (size_t i = 0; i < nf->inst_count; ++i) encode_inst(&enc, &nf->insts[i]);
+    bool ok = !code->failed;
+    for (size_t i = 0; ok && i < enc.fixup_count; ++i) {
+        size_t target = enc.labels[enc.fixups[i].target];
+        if (target == SIZE_MAX) {
+            ok = false;
+            break;
+        }
+        code_patch_u32(code, enc.fixups[i].offset, (uint32_t)(int32_t)((int64_t)target - (int64_t)(enc.fixups[i].offset + 4)));
+    }
+    free(enc.labels);
+    free(enc.fixups);
+    if (!ok) native_fail(nf, code->failed ? "out of memory" : "native backend: unplaced label");
+    return ok;
+}
+
+static void native_function_free(NativeFunction *nf) {
+    free(nf->insts);
+    free(nf->args);
+    free(nf->vregs);
+    free(nf->bindings);
+    free(nf->loops);
+}
+
+static void native_function_init(NativeFunction *nf, const NovaIRProgram *program, const NovaSemanticContext *semantics, size_t index, char *error_buffer, size_t error_buffer_size) {
+    memset(nf, 0, sizeof(*nf));
+    nf->program = program;
+    nf->semantics = semantics;
+    nf->fn = &program->functions[index];
+    nf->fn_index = index;
+    nf->ok = true;
+    nf->error_buffer = error_buffer;
+    nf->error_buffer_size = error_buffer_size;
+}
+
+// Encodes every function of program after any bytes already in code and
+// resolves the calls between them, including any already recorded.
+static bool encode_program(const NovaIRProgram *program, const NovaSemanticContext *semantics, NativeCode *code, NativeSymbol *symbols, NativeFixup **calls, size_t *call_count, size_t *call_capacity, char *error_buffer, size_t error_buffer_size) {
+    for (size_t i = 0; i < program->function_count; ++i) {
+        while (code->length % 16 != 0) code_byte(code, 0xCC);
+        NativeFunction nf;
+        native_function_init(&nf, program, semantics, i, error_buffer, error_buffer_size);
+        symbols[i].offset = code->length;
+        bool ok = lower_function(&nf) && encode_function(&nf, code, calls, call_count, call_capacity, NULL);
+        native_function_free(&nf);
+        if (!ok) return false;
+        symbols[i].size = code->length - symbols[i].offset;
+    }
+    for (size_t i = 0; i < *call_count; ++i) {
+        const NativeFixup *call = &(*calls)[i];
+        int64_t target = (int64_t)symbols[call->target].offset;
+        code_patch_u32(code, call->offset, (uint32_t)(int32_t)(target - (int64_t)(call->offset + 4)));
+    }
+    if (code->failed && error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "out of memory");
+    return !code->failed;
+}
+
+bool nova_native_encode_function(const NovaIRProgram *program, const NovaSemanticContext *semantics, size_t function_index, void *const *call_slots, uint8_t **code, size_t *code_size, char *error_buffer, size_t error_buffer_size) {
+    if (!program || function_index >= program->function_count || !call_slots || !code || !code_size) return false;
+    NativeCode text{};
+    NativeFunction nf;
+    native_function_init(&nf, program, semantics, function_index, error_buffer, error_buffer_size);
+    bool ok = lower_function(&nf) && encode_function(&nf, &text, NULL, NULL, NULL, call_slots);
+    native_function_free(&nf);
+    if (!ok) {
+        free(text.bytes);
+        return false;
+    }
+    *code = text.bytes;
+    *code_size = text.length;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// ELF files
+
+static void put_u16(NativeCode *out, uint16_t value) {
+    code_byte(out, (uint8_t)value);
+    code_byte(out, (uint8_t)(value >> 8));
+}
+
+static void put_bytes(NativeCode *out, const void *bytes, size_t length) {
+    for (size_t i = 0; i < length; ++i) code_byte(out, static_cast<const uint8_t *>(bytes)[i]);
+}
+
+static void put_padding(NativeCode *out, size_t alignment) {
+    while (out->length % alignment != 0) code_byte(out, 0);
+}
+
+static void put_elf_header(NativeCode *out, uint16_t type, uint64_t entry, uint64_t program_headers, uint16_t program_header_count, uint64_t section_headers, uint16_t section_count, uint16_t string_section) {
+    static const uint8_t ident[16] = {0x7F, 'E', 'L', 'F', 2, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    put_bytes(out, ident, sizeof(ident));
+    put_u16(out, type);
+    put_u16(out, 62); // EM_X86_64
+    code_u32(out, 1);
+    code_u64(out, entry);
+    code_u64(out, program_headers);
+    code_u64(out, section_headers);
+    code_u32(out, 0);
+    put_u16(out, 64);
+    put_u16(out, program_header_count ? 56 : 0);
+    put_u16(out, program_header_count);
+    put_u16(out, section_count ? 64 : 0);
+    put_u16(out, section_count);
+    put_u16(out, string_section);
+}
+
+static void put_section_header(NativeCode *out, uint32_t name, uint32_t type, uint64_t flags, uint64_t offset, uint64_t size, uint32_t link, uint32_t info, uint64_t alignment, uint64_t entry_size) {
+    code_u32(out, name);
+    code_u32(out, type);
+    code_u64(out, flags);
+    code_u64(out, 0);
+    code_u64(out, offset);
+    code_u64(out, size);
+    code_u32(out, link);
+    code_u32(out, info);
+    code_u64(out, alignment);
+    code_u64(out, entry_size);
+}
+
+static bool write_image(const NativeCode *image, const char *path, bool executable, char *error_buffer, size_t error_buffer_size) {
+    FILE *file = fopen(path, "wb");
+    bool ok = file && fwrite(image->bytes, 1, image->length, file) == image->length;
+    if (file && fclose(file) != 0) ok = false;
+    if (ok && executable) ok = chmod(path, 0755) == 0;
+    if (!ok) {
+        if (error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "failed to write %s", path);
+        remove(path);
+    }
+    return ok;
+}
+
+bool nova_native_emit_object(const NovaIRProgram *program, const NovaSemanticContext *semantics, const char *object_path, char *error_buffer, size_t error_buffer_size) {
+    if (!program || !object_path) return false;
+    NativeCode text{};
+    NativeFixup *calls = NULL;
+    size_t call_count = 0, call_capacity = 0;
+    NativeSymbol *symbols = static_cast<NativeSymbol *>(calloc(program->function_count + 1, sizeof(NativeSymbol)));
+    if (!symbols) {
+        if (error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "out of memory");
+        return false;
+    }
+    bool ok = encode_program(program, semantics, &text, symbols, &calls, &call_count, &call_capacity, error_buffer, error_buffer_size);
+    free(calls);
+
+    // Calls inside .text are already resolved, so the object needs no
+    // relocations: a header, .text, the symbol and string tables, and an
+    // empty .note.GNU-stack for a non-executable stack.
+    NativeCode strtab{}, shstrtab{}, symtab{}, image{};
+    if (ok) {
+        code_byte(&strtab, 0);
+        static const char section_names[] = "\0.text\0.symtab\0.strtab\0.shstrtab\0.note.GNU-stack";
+        put_bytes(&shstrtab, section_names, sizeof(section_names));
+        for (int i = 0; i < 24; ++i) code_byte(&symtab, 0);
+        // Locals first: ELF wants them before the globals.
+        uint32_t first_global = 1;
+        for (int pass = 0; pass < 2; ++pass) {
+            for (size_t i = 0; i < program->function_count; ++i) {
+                const NovaIRFunction *fn = &program->functions[i];
+                if (fn->lifted != (pass == 0)) continue;
+                code_u32(&symtab, (uint32_t)strtab.length);
+                put_bytes(&strtab, fn->name.lexeme, fn->name.length);
+                code_byte(&strtab, 0);
+                code_byte(&symtab, (uint8_t)((fn->lifted ? 0 : 1) << 4 | 2)); // STB_LOCAL or STB_GLOBAL, STT_FUNC
+                code_byte(&symtab, 0);
+                put_u16(&symtab, 1);
+                code_u64(&symtab, symbols[i].offset);
+                code_u64(&symtab, symbols[i].size);
+                if (pass == 0) first_global++;
+            }
+        }
+        uint64_t text_offset = 64;
+        uint64_t symtab_offset = (text_offset + text.length + 7) & ~7ull;
+        uint64_t strtab_offset = symtab_offset + symtab.length;
+        uint64_t shstrtab_offset = strtab_offset + strtab.length;
+        uint64_t headers_offset = (shstrtab_offset + shstrtab.length + 7) & ~7ull;
+        put_elf_header(&image, 1, 0, 0, 0, headers_offset, 6, 4);
+        put_bytes(&image, text.bytes, text.length);
+        put_padding(&image, 8);
+        put_bytes(&image, symtab.bytes, symtab.length);
+        put_bytes(&image, strtab.bytes, strtab.length);
+        put_bytes(&image, shstrtab.bytes, shstrtab.length);
+        put_padding(&image, 8);
+        put_section_header(&image, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+        put_section_header(&image, 1, 1, 0x6, text_offset, text.length, 0, 0, 16, 0); // SHT_PROGBITS, ALLOC|EXECINSTR
+        put_section_header(&image, 7, 2, 0, symtab_offset, symtab.length, 3, first_global, 8, 24); // SHT_SYMTAB
+        put_section_header(&image, 15, 3, 0, strtab_offset, strtab.length, 0, 0, 1, 0); // SHT_STRTAB
+        put_section_header(&image, 23, 3, 0, shstrtab_offset, shstrtab.length, 0, 0, 1, 0);
+        put_section_header(&image, 33, 1, 0, headers_offset, 0, 0, 0, 1, 0);
+        ok = !(strtab.failed || shstrtab.failed || symtab.failed || image.failed);
+        if (!ok && error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "out of memory");
+    }
+    if (ok) ok = write_image(&image, object_path, false, error_buffer, error_buffer_size);
+    free(text.bytes);
+    free(strtab.bytes);
+    free(shstrtab.bytes);
+    free(symtab.bytes);
+    free(image.bytes);
+    free(symbols);
+    return ok;
+}
+
+#define NATIVE_IMAGE_BASE 0x400000ull
+#define NATIVE_HEADERS_SIZE (64 + 2 * 56)
+
+bool nova_native_emit_executable(const NovaIRProgram *program, const NovaSemanticContext *semantics, const char *executable_path, const char *entry_function, char *error_buffer, size_t error_buffer_size) {
+    if (!program || !executable_path || !entry_function || entry_function[0] == '\0') return false;
+    NovaToken entry_name = {};
+    entry_name.lexeme = entry_function;
+    entry_name.length = strlen(entry_function);
+    size_t entry = nova_ir_find_function(program, &entry_name);
+    if (entry == SIZE_MAX) {
+        if (error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "unknown entry function %s", entry_function);
+        return false;
+    }
+    const NovaTypeInfo *info = nova_semantic_type_info(semantics, program->functions[entry].return_type);
+    NovaTypeKind result_kind = info ? info->kind : NOVA_TYPE_KIND_NUMBER;
+
+    // The startup stub: the kernel leaves rsp 16-byte aligned at _start, so
+    // the entry function can be called straight away; its result becomes
+    // the status of the exit system call.
+    NativeCode text{};
+    NativeFixup *calls = NULL;
+    size_t call_count = 0, call_capacity = 0;
+    code_byte(&text, 0xE8);
+    add_fixup(&calls, &call_count, &call_capacity, &text, entry);
+    if (result_kind == NOVA_TYPE_KIND_INT) {
+        x86_emit(&text, 0, false, 0x8B, RDI, reg_operand(RAX));
+    } else if (result_kind == NOVA_TYPE_KIND_BOOL) {
+        x86_emit(&text, 0, false, 0x0FB6, RDI, reg_operand(RAX));
+    } else if (result_kind == NOVA_TYPE_KIND_UNIT) {
+        x86_emit(&text, 0, false, 0x31, RDI, reg_operand(RDI));
+    } else {
+        x86_emit(&text, 0xF2, false, 0x0F2C, RDI, reg_operand(XMM0));
+    }
+    x86_mov_imm(&text, RAX, 60); // exit
+    code_byte(&text, 0x0F);
+    code_byte(&text, 0x05);
+
+    NativeSymbol *symbols = static_cast<NativeSymbol *>(calloc(program->function_count + 1, sizeof(NativeSymbol)));
+    bool ok = symbols != NULL;
+    if (!ok && error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "out of memory");
+    if (ok) ok = encode_program(program, semantics, &text, symbols, &calls, &call_count, &call_capacity, error_buffer, error_buffer_size);
+    free(calls);
+    free(symbols);
+
+    // One read-execute segment maps the whole file, headers included.
+    NativeCode image{};
+    if (ok) {
+        uint64_t size = NATIVE_HEADERS_SIZE + text.length;
+        put_elf_header(&image, 2, NATIVE_IMAGE_BASE + NATIVE_HEADERS_SIZE, 64, 2, 0, 0, 0);
+        code_u32(&image, 1); // PT_LOAD
+        code_u32(&image, 5); // R + X
+        code_u64(&image, 0);
+        code_u64(&image, NATIVE_IMAGE_BASE);
+        code_u64(&image, NATIVE_IMAGE_BASE);
+        code_u64(&image, size);
+        code_u64(&image, size);
+        code_u64(&image, 0x1000);
+        code_u32(&image, 0x6474E551); // PT_GNU_STACK
+        code_u32(&image, 6); // R + W
+        for (int i = 0; i < 6; ++i) code_u64(&image, i == 5 ? 16 : 0);
+        put_bytes(&image, text.bytes, text.length);
+        ok = !image.failed;
+        if (!ok && error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "out of memory");
+    }
+    if (ok) ok = write_image(&image, executable_path, true, error_buffer, error_buffer_size);
+    free(text.bytes);
+    free(image.bytes);
+    return ok;
+}
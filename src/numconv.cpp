@@ -0,0 +1,420 @@
+#include "nova/numconv.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nova/generated_numconv_tables.h"
+
+#define DOUBLE_MANTISSA_BITS 52
+#define DOUBLE_EXPONENT_BIAS 1023
+#define DOUBLE_INFINITE_EXPONENT 0x7FF
+// At most this many significant digits fit a uint64_t.
+#define NUMBER_MAX_DIGITS 19
+
+static double double_from_bits(uint64_t bits) {
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static uint64_t multiply_64(uint64_t a, uint64_t b, uint64_t *high) {
+#ifdef __SIZEOF_INT128__
+    __extension__ unsigned __int128 product = (unsigned __int128)a * b;
+    *high = (uint64_t)(product >> 64);
+    return (uint64_t)product;
+#else
+    uint64_t a_low = (uint32_t)a, a_high = a >> 32;
+    uint64_t b_low = (uint32_t)b, b_high = b >> 32;
+    uint64_t low_low = a_low * b_low;
+    uint64_t high_low = a_high * b_low;
+    uint64_t low_high = a_low * b_high;
+    uint64_t middle = high_low + (low_low >> 32) + (uint32_t)low_high;
+    *high = a_high * b_high + (middle >> 32) + (low_high >> 32);
+    return (middle << 32) | (uint32_t)low_low;
+#endif
+}
+
+static int leading_zeros(uint64_t value) {
+    int count = 0;
+    while (!(value & (1ull << 63))) {
+        value <<= 1;
+        ++count;
+    }
+    return count;
+}
+
+// Eisel-Lemire: the double nearest w * 10^q from a 128-bit approximation of
+// 5^q. Returns false in the rare cases the approximation cannot decide.
+static bool eisel_lemire(uint64_t w, int64_t q, uint64_t *bits) {
+    if (w == 0 || q < NOVA_NUMCONV_PARSE_MIN_EXPONENT) {
+        *bits = 0;
+        return true;
+    }
+    if (q > NOVA_NUMCONV_PARSE_MAX_EXPONENT) {
+        *bits = (uint64_t)DOUBLE_INFINITE_EXPONENT << DOUBLE_MANTISSA_BITS;
+        return true;
+    }
+    int shift = leading_zeros(w);
+    w <<= shift;
+    const uint64_t *power = nova_numconv_parse_pow5[q - NOVA_NUMCONV_PARSE_MIN_EXPONENT];
+    uint64_t high;
+    uint64_t low = multiply_64(w, power[0], &high);
+    const uint64_t precision_mask = ~0ull >> (DOUBLE_MANTISSA_BITS + 3);
+    if ((high & precision_mask) == precision_mask) {
+        uint64_t second_high;
+        multiply_64(w, power[1], &second_high);
+        low += second_high;
+        if (second_high > low) ++high;
+        if (low == ~0ull && (q < -27 || q > 55)) return false;
+    }
+    int upper_bit = (int)(high >> 63);
+    uint64_t mantissa = high >> (upper_bit + 64 - DOUBLE_MANTISSA_BITS - 3);
+    // floor(log2(10^q)) + 63, in fixed point.
+    int64_t power2 = (((152170 + 65536) * q) >> 16) + 63 + upper_bit - shift + DOUBLE_EXPONENT_BIAS;
+    if (power2 <= 0) {
+        if (-power2 + 1 >= 64) {
+            *bits = 0;
+            return true;
+        }
+        mantissa >>= -power2 + 1;
+        mantissa += mantissa & 1;
+        mantissa >>= 1;
+        power2 = mantissa < (1ull << DOUBLE_MANTISSA_BITS) ? 0 : 1;
+        *bits = (mantissa & ((1ull << DOUBLE_MANTISSA_BITS) - 1)) | ((uint64_t)power2 << DOUBLE_MANTISSA_BITS);
+        return true;
+    }
+    // Exactly halfway between two doubles: round to even rather than up.
+    if (low <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1 && (mantissa << (upper_bit + 64 - DOUBLE_MANTISSA_BITS - 3)) == high) {
+        mantissa &= ~1ull;
+    }
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if (mantissa >= (2ull << DOUBLE_MANTISSA_BITS)) {
+        mantissa = 1ull << DOUBLE_MANTISSA_BITS;
+        ++power2;
+    }
+    if (power2 >= DOUBLE_INFINITE_EXPONENT) {
+        *bits = (uint64_t)DOUBLE_INFINITE_EXPONENT << DOUBLE_MANTISSA_BITS;
+        return true;
+    }
+    *bits = (mantissa & ((1ull << DOUBLE_MANTISSA_BITS) - 1)) | ((uint64_t)power2 << DOUBLE_MANTISSA_BITS);
+    return true;
+}
+
+static bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Only literals whose first 19 digits leave the rounding open get here.
+static double parse_slow(const char *text, size_t length) {
+    char stack[512];
+    char *copy = length < sizeof(stack) ? stack : static_cast<char *>(malloc(length + 1));
+    if (!copy) return 0.0;
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    double value = strtod(copy, NULL);
+    if (copy != stack) free(copy);
+    return value;
+}
+
+bool nova_number_parse(const char *text, size_t length, double *value) {
+    if (!text || !value) return false;
+    const char *p = text;
+    const char *end = text + length;
+    uint64_t w = 0;
+    int64_t exponent = 0;
+    int digits = 0;
+    bool truncated = false;
+    const char *start = p;
+    for (; p < end && is_digit(*p); ++p) {
+        if (digits < NUMBER_MAX_DIGITS) {
+            w = w * 10 + (uint64_t)(*p - '0');
+            if (w != 0) ++digits;
+        } else {
+            ++exponent;
+            if (*p != '0') truncated = true;
+        }
+    }
+    if (p == start) return false;
+    if (p < end && *p == '.') {
+        start = ++p;
+        for (; p < end && is_digit(*p); ++p) {
+            if (digits < NUMBER_MAX_DIGITS) {
+                w = w * 10 + (uint64_t)(*p - '0');
+                if (w != 0) ++digits;
+                --exponent;
+            } else if (*p != '0') {
+                truncated = true;
+            }
+        }
+        if (p == start) return false;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        ++p;
+        bool negative = p < end && *p == '-';
+        if (p < end && (*p == '-' || *p == '+')) ++p;
+        start = p;
+        int64_t explicit_exponent = 0;
+        for (; p < end && is_digit(*p); ++p) {
+            // Far beyond any double already; stop before it overflows.
+            if (explicit_exponent < 100000) explicit_exponent = explicit_exponent * 10 + (*p - '0');
+        }
+        if (p == start) return false;
+        exponent += negative ? -explicit_exponent : explicit_exponent;
+    }
+    if (p != end) return false;
+
+    // Clinger: both w and 10^|q| are exact doubles, so one operation rounds
+    // correctly.
+    static const double exact_powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                          1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    if (!truncated && w <= (1ull << (DOUBLE_MANTISSA_BITS + 1)) && exponent >= -22 && exponent <= 22) {
+        double mantissa = (double)w;
+        *value = exponent < 0 ? mantissa / exact_powers[-exponent] : mantissa * exact_powers[exponent];
+        return true;
+    }
+    uint64_t bits;
+    if (eisel_lemire(w, exponent, &bits)) {
+        // Dropped digits put the exact value between w and w + 1.
+        uint64_t upper;
+        if (!truncated || (eisel_lemire(w + 1, exponent, &upper) && upper == bits)) {
+            *value = double_from_bits(bits);
+            return true;
+        }
+    }
+    *value = parse_slow(text, length);
+    return true;
+}
+
+bool nova_integer_parse(const char *text, size_t length, int64_t *value) {
+    if (!text || !value || length == 0) return false;
+    uint64_t result = 0;
+    for (size_t i = 0; i < length; ++i) {
+        if (!is_digit(text[i])) return false;
+        uint64_t digit = (uint64_t)(text[i] - '0');
+        if (result > ((uint64_t)INT64_MAX - digit) / 10) return false;
+        result = result * 10 + digit;
+    }
+    *value = (int64_t)result;
+    return true;
+}
+
+// Ryu (Adams, 2018): the shortest decimal inside the interval of values that
+// round to the double, picked as close to it as possible.
+
+static uint32_t pow5_bits(int32_t e) {
+    return (uint32_t)(((e * 1217359) >> 19) + 1);
+}
+
+static uint32_t log10_pow2(int32_t e) {
+    return (uint32_t)((e * 78913) >> 18);
+}
+
+static uint32_t log10_pow5(int32_t e) {
+    return (uint32_t)((e * 732923) >> 20);
+}
+
+static bool multiple_of_pow5(uint64_t value, uint32_t p) {
+    uint32_t count = 0;
+    while (value % 5 == 0) {
+        value /= 5;
+        ++count;
+    }
+    return count >= p;
+}
+
+static bool multiple_of_pow2(uint64_t value, uint32_t p) {
+    return (value & ((1ull << p) - 1)) == 0;
+}
+
+// (m * entry) >> j for a {high, low} table entry, with 64 < j < 128.
+static uint64_t multiply_shift(uint64_t m, const uint64_t *entry, int32_t j) {
+    uint64_t low_high;
+    multiply_64(m, entry[1], &low_high);
+    uint64_t high_high;
+    uint64_t high_low = multiply_64(m, entry[0], &high_high);
+    uint64_t sum = high_low + low_high;
+    high_high += sum < high_low;
+    int32_t shift = j - 64;
+    return (high_high << (64 - shift)) | (sum >> shift);
+}
+
+// Shortest digits and decimal exponent of a finite positive double.
+static uint64_t shortest_digits(uint64_t mantissa_bits, uint32_t exponent_bits, int32_t *exponent) {
+    int32_t e2;
+    uint64_t m2;
+    if (exponent_bits == 0) {
+        e2 = 1 - DOUBLE_EXPONENT_BIAS - DOUBLE_MANTISSA_BITS - 2;
+        m2 = mantissa_bits;
+    } else {
+        e2 = (int32_t)exponent_bits - DOUBLE_EXPONENT_BIAS - DOUBLE_MANTISSA_BITS - 2;
+        m2 = (1ull << DOUBLE_MANTISSA_BITS) | mantissa_bits;
+    }
+    const bool accept_bounds = (m2 & 1) == 0;
+    // The interval is [mv - 1 - mm_shift, mv + 2] in units of a quarter ulp;
+    // it is narrower below powers of two.
+    const uint64_t mv = 4 * m2;
+    const uint32_t mm_shift = mantissa_bits != 0 || exponent_bits <= 1;
+
+    uint64_t vr, vp, vm;
+    int32_t e10;
+    bool vm_trailing_zeros = false;
+    bool vr_trailing_zeros = false;
+    if (e2 >= 0) {
+        const uint32_t q = log10_pow2(e2) - (e2 > 3);
+        e10 = (int32_t)q;
+        const int32_t k = NOVA_NUMCONV_PRINT_BITS + (int32_t)pow5_bits((int32_t)q) - 1;
+        const int32_t i = -e2 + (int32_t)q + k;
+        const uint64_t *entry = nova_numconv_print_pow5_inv[q];
+        vr = multiply_shift(4 * m2, entry, i);
+        vp = multiply_shift(4 * m2 + 2, entry, i);
+        vm = multiply_shift(4 * m2 - 1 - mm_shift, entry, i);
+        if (q <= 21) {
+            if (mv % 5 == 0) {
+                vr_trailing_zeros = multiple_of_pow5(mv, q);
+            } else if (accept_bounds) {
+                vm_trailing_zeros = multiple_of_pow5(mv - 1 - mm_shift, q);
+            } else {
+                vp -= multiple_of_pow5(mv + 2, q);
+            }
+        }
+    } else {
+        const uint32_t q = log10_pow5(-e2) - (-e2 > 1);
+        e10 = (int32_t)q + e2;
+        const int32_t i = -e2 - (int32_t)q;
+        const int32_t k = (int32_t)pow5_bits(i) - NOVA_NUMCONV_PRINT_BITS;
+        const int32_t j = (int32_t)q - k;
+        const uint64_t *entry = nova_numconv_print_pow5[i];
+        vr = multiply_shift(4 * m2, entry, j);
+        vp = multiply_shift(4 * m2 + 2, entry, j);
+        vm = multiply_shift(4 * m2 - 1 - mm_shift, entry, j);
+        if (q <= 1) {
+            vr_trailing_zeros = true;
+            if (accept_bounds) {
+                vm_trailing_zeros = mm_shift == 1;
+            } else {
+                --vp;
+            }
+        } else if (q < 63) {
+            vr_trailing_zeros = multiple_of_pow2(mv, q);
+        }
+    }
+
+    int32_t removed = 0;
+    uint32_t last_removed = 0;
+    uint64_t output;
+    if (vm_trailing_zeros || vr_trailing_zeros) {
+        while (vp / 10 > vm / 10) {
+            vm_trailing_zeros &= vm % 10 == 0;
+            vr_trailing_zeros &= last_removed == 0;
+            last_removed = (uint32_t)(vr % 10);
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            ++removed;
+        }
+        if (vm_trailing_zeros) {
+            while (vm % 10 == 0) {
+                vr_trailing_zeros &= last_removed == 0;
+                last_removed = (uint32_t)(vr % 10);
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+                ++removed;
+            }
+        }
+        // Exactly halfway: round to even.
+        if (vr_trailing_zeros && last_removed == 5 && vr % 2 == 0) last_removed = 4;
+        output = vr + ((vr == vm && (!accept_bounds || !vm_trailing_zeros)) || last_removed >= 5);
+    } else {
+        bool round_up = false;
+        if (vp / 100 > vm / 100) {
+            round_up = vr % 100 >= 50;
+            vr /= 100;
+            vp /= 100;
+            vm /= 100;
+            removed += 2;
+        }
+        while (vp / 10 > vm / 10) {
+            round_up = vr % 10 >= 5;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            ++removed;
+        }
+        output = vr + (vr == vm || round_up);
+    }
+    *exponent = e10 + removed;
+    return output;
+}
+
+size_t nova_number_format(double value, char *buffer) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    size_t used = 0;
+    if (bits >> 63) buffer[used++] = '-';
+    uint64_t mantissa_bits = bits & ((1ull << DOUBLE_MANTISSA_BITS) - 1);
+    uint32_t exponent_bits = (uint32_t)((bits >> DOUBLE_MANTISSA_BITS) & DOUBLE_INFINITE_EXPONENT);
+    if (mantissa_bits == 0 && exponent_bits == 0) {
+        memcpy(buffer + used, "0.0", 4);
+        return used + 3;
+    }
+    int32_t exponent;
+    uint64_t output = shortest_digits(mantissa_bits, exponent_bits, &exponent);
+    char digits[20];
+    int32_t count = 0;
+    for (uint64_t rest = output; rest; rest /= 10) digits[19 - count++] = (char)('0' + rest % 10);
+    const char *first = digits + 20 - count;
+    // value = digits * 10^exponent; point is where the decimal point falls.
+    int32_t point = count + exponent;
+    if (exponent >= 0 && point <= 17) {
+        memcpy(buffer + used, first, (size_t)count);
+        used += (size_t)count;
+        memset(buffer + used, '0', (size_t)exponent);
+        used += (size_t)exponent;
+        buffer[used++] = '.';
+        buffer[used++] = '0';
+    } else if (exponent < 0 && point > 0) {
+        memcpy(buffer + used, first, (size_t)point);
+        used += (size_t)point;
+        buffer[used++] = '.';
+        memcpy(buffer + used, first + point, (size_t)(count - point));
+        used += (size_t)(count - point);
+    } else if (exponent < 0 && point > -5) {
+        buffer[used++] = '0';
+        buffer[used++] = '.';
+        memset(buffer + used, '0', (size_t)-point);
+        used += (size_t)-point;
+        memcpy(buffer + used, first, (size_t)count);
+        used += (size_t)count;
+    } else {
+        buffer[used++] = first[0];
+        buffer[used++] = '.';
+        if (count > 1) {
+            memcpy(buffer + used, first + 1, (size_t)(count - 1));
+            used += (size_t)(count - 1);
+        } else {
+            buffer[used++] = '0';
+        }
+        buffer[used++] = 'e';
+        int32_t scientific = point - 1;
+        if (scientific < 0) {
+            buffer[used++] = '-';
+            scientific = -scientific;
+        }
+        if (scientific >= 100) buffer[used++] = (char)('0' + scientific / 100);
+        if (scientific >= 10) buffer[used++] = (char)('0' + scientific / 10 % 10);
+        buffer[used++] = (char)('0' + scientific % 10);
+    }
+    buffer[used] = '\0';
+    return used;
+}
+
+size_t nova_number_show(double value, char *buffer) {
+    if (!isnan(value) && !isinf(value)) return nova_number_format(value, buffer);
+    const char *special = isnan(value) ? "nan" : value < 0 ? "-inf" : "inf";
+    size_t length = strlen(special);
+    memcpy(buffer, special, length + 1);
+    return length;
+}
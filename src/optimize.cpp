@@ -0,0 +1,1532 @@
+#include "nova/optimize.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void nova_optimize_options_init(NovaOptimizeOptions *options) {
+    if (!options) return;
+    options->inline_functions = true;
+    options->inline_threshold = 12;
+    options->inline_constant_bonus = 4;
+    options->inline_single_call_threshold = 64;
+    options->inline_hot_threshold = 48;
+    options->inline_growth_limit = 2048;
+    options->eliminate_dead_functions = true;
+    options->eliminate_common_calls = true;
+    options->eliminate_tail_calls = true;
+    options->roots = NULL;
+    options->root_count = 0;
+}
+
+void nova_optimize_report_free(NovaOptimizeReport *report) {
+    if (!report) return;
+    free(report->removed_functions);
+    free(report->removed_types);
+    memset(report, 0, sizeof(*report));
+}
+
+static void report_push(NovaToken **items, size_t *count, size_t *capacity, NovaToken token) {
+    if (*count == *capacity) {
+        size_t new_capacity = *capacity == 0 ? 8 : *capacity * 2;
+        NovaToken *grown = static_cast<NovaToken *>(realloc(*items, new_capacity * sizeof(NovaToken)));
+        if (!grown) return;
+        *items = grown;
+        *capacity = new_capacity;
+    }
+    (*items)[(*count)++] = token;
+}
+
+static bool token_equals(const NovaToken *a, const NovaToken *b) {
+    return a->length == b->length && strncmp(a->lexeme, b->lexeme, a->length) == 0;
+}
+
+static bool is_trivial_expr(const NovaIRExpr *expr) {
+    if (!expr) return false;
+    switch (expr->kind) {
+    case NOVA_IR_EXPR_NUMBER:
+    case NOVA_IR_EXPR_INT:
+    case NOVA_IR_EXPR_STRING:
+    case NOVA_IR_EXPR_BOOL:
+    case NOVA_IR_EXPR_UNIT:
+    case NOVA_IR_EXPR_IDENTIFIER:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool is_constant_expr(const NovaIRExpr *expr) {
+    return is_trivial_expr(expr) && expr->kind != NOVA_IR_EXPR_IDENTIFIER;
+}
+
+static void find_loop(NovaIRExpr **slot, void *ctx) {
+    bool *found = static_cast<bool *>(ctx);
+    if (*found || !*slot) return;
+    if ((*slot)->kind == NOVA_IR_EXPR_WHILE) {
+        *found = true;
+        return;
+    }
+    nova_ir_expr_for_each_child(*slot, find_loop, ctx);
+}
+
+static bool contains_loop(const NovaIRExpr *expr) {
+    bool found = false;
+    NovaIRExpr *root = const_cast<NovaIRExpr *>(expr);
+    find_loop(&root, &found);
+    return found;
+}
+
+static void find_assignment(NovaIRExpr **slot, void *ctx) {
+    bool *found = static_cast<bool *>(ctx);
+    if (*found || !*slot) return;
+    if ((*slot)->kind == NOVA_IR_EXPR_ASSIGN) {
+        *found = true;
+        return;
+    }
+    nova_ir_expr_for_each_child(*slot, find_assignment, ctx);
+}
+
+static bool contains_assignment(const NovaIRExpr *expr) {
+    bool found = false;
+    NovaIRExpr *root = const_cast<NovaIRExpr *>(expr);
+    find_assignment(&root, &found);
+    return found;
+}
+
+typedef struct {
+    NovaToken name;
+    NovaIRExpr *replacement;
+} RenameEntry;
+
+typedef struct {
+    NovaIRProgram *program;
+    RenameEntry *entries;
+    size_t count;
+    size_t capacity;
+    bool ok;
+} RenameScope;
+
+static bool rename_push(RenameScope *scope, NovaToken name, NovaIRExpr *replacement) {
+    if (!replacement) {
+        scope->ok = false;
+        return false;
+    }
+    if (scope->count == scope->capacity) {
+        size_t new_capacity = scope->capacity == 0 ? 8 : scope->capacity * 2;
+        RenameEntry *entries = static_cast<RenameEntry *>(realloc(scope->entries, new_capacity * sizeof(RenameEntry)));
+        if (!entries) {
+            nova_ir_expr_free(replacement);
+            scope->ok = false;
+            return false;
+        }
+        scope->entries = entries;
+        scope->capacity = new_capacity;
+    }
+    scope->entries[scope->count].name = name;
+    scope->entries[scope->count].replacement = replacement;
+    scope->count++;
+    return true;
+}
+
+static void rename_pop(RenameScope *scope, size_t count) {
+    while (count-- > 0 && scope->count > 0) {
+        nova_ir_expr_free(scope->entries[--scope->count].replacement);
+    }
+}
+
+static NovaIRExpr *identifier_expr(NovaToken name, NovaTypeId type) {
+    NovaIRExpr *expr = nova_ir_expr_new(NOVA_IR_EXPR_IDENTIFIER, type);
+    if (expr) expr->as.identifier = name;
+    return expr;
+}
+
+// Substitutes parameters and gives every binder in a cloned body a fresh
+// name, so the body can be spliced into any caller without capturing names.
+static void rename_expr(NovaIRExpr **slot, void *ctx) {
+    RenameScope *scope = static_cast<RenameScope *>(ctx);
+    NovaIRExpr *expr = *slot;
+    if (!expr || !scope->ok) return;
+    switch (expr->kind) {
+    case NOVA_IR_EXPR_IDENTIFIER:
+        for (size_t i = scope->count; i > 0; --i) {
+            RenameEntry *entry = &scope->entries[i - 1];
+            if (token_equals(&entry->name, &expr->as.identifier)) {
+                if (entry->replacement->kind == NOVA_IR_EXPR_IDENTIFIER) {
+                    expr->as.identifier = entry->replacement->as.identifier;
+                    return;
+                }
+                NovaIRExpr *copy = nova_ir_expr_clone(entry->replacement);
+                if (!copy) {
+                    scope->ok = false;
+                    return;
+                }
+                nova_ir_expr_free(expr);
+                *slot = copy;
+                return;
+            }
+        }
+        return;
+    case NOVA_IR_EXPR_LET: {
+        rename_expr(&expr->as.let_expr.value, ctx);
+        NovaToken fresh = nova_ir_fresh_name(scope->program, &expr->as.let_expr.name);
+        if (!fresh.lexeme) {
+            scope->ok = false;
+            return;
+        }
+        NovaTypeId type = expr->as.let_expr.value ? expr->as.let_expr.value->type : expr->type;
+        if (!rename_push(scope, expr->as.let_expr.name, identifier_expr(fresh, type))) return;
+        expr->as.let_expr.name = fresh;
+        rename_expr(&expr->as.let_expr.body, ctx);
+        rename_pop(scope, 1);
+        return;
+    }
+    case NOVA_IR_EXPR_ASSIGN:
+        rename_expr(&expr->as.assign.value, ctx);
+        for (size_t i = scope->count; i > 0; --i) {
+            RenameEntry *entry = &scope->entries[i - 1];
+            if (token_equals(&entry->name, &expr->as.assign.target)) {
+                // A parameter replaced by a value cannot be assigned to.
+                if (entry->replacement->kind != NOVA_IR_EXPR_IDENTIFIER) {
+                    scope->ok = false;
+                    return;
+                }
+                expr->as.assign.target = entry->replacement->as.identifier;
+                break;
+            }
+        }
+        return;
+    case NOVA_IR_EXPR_MATCH:
+        rename_expr(&expr->as.match_expr.scrutinee, ctx);
+        for (size_t i = 0; i < expr->as.match_expr.arm_count; ++i) {
+            NovaIRMatchArm *arm = &expr->as.match_expr.arms[i];
+            size_t pushed = 0;
+            for (size_t b = 0; b < arm->binding_count; ++b) {
+                NovaToken fresh = nova_ir_fresh_name(scope->program, &arm->bindings[b]);
+                if (!fresh.lexeme || !rename_push(scope, arm->bindings[b], identifier_expr(fresh, 0))) {
+                    scope->ok = false;
+                    break;
+                }
+                arm->bindings[b] = fresh;
+                pushed++;
+            }
+            rename_expr(&arm->body, ctx);
+            rename_pop(scope, pushed);
+        }
+        return;
+    default:
+        nova_ir_expr_for_each_child(expr, rename_expr, ctx);
+        return;
+    }
+}
+
+typedef struct {
+    const NovaToken *name;
+    size_t uses;
+} UseCounter;
+
+static void count_uses(NovaIRExpr **slot, void *ctx) {
+    UseCounter *counter = static_cast<UseCounter *>(ctx);
+    if (!*slot) return;
+    if ((*slot)->kind == NOVA_IR_EXPR_IDENTIFIER && token_equals(&(*slot)->as.identifier, counter->name)) {
+        counter->uses++;
+        return;
+    }
+    nova_ir_expr_for_each_child(*slot, count_uses, ctx);
+}
+
+// Arguments that are not referenced by the inlined body are still evaluated
+// for their effects, but no longer need a binding.
+static void drop_unused_lets(NovaIRExpr **slot, void *ctx) {
+    NovaIRExpr *expr = *slot;
+    if (!expr) return;
+    nova_ir_expr_for_each_child(expr, drop_unused_lets, ctx);
+    if (expr->kind != NOVA_IR_EXPR_LET) return;
+    UseCounter counter = {&expr->as.let_expr.name, 0};
+    count_uses(&expr->as.let_expr.body, &counter);
+    if (counter.uses > 0) return;
+    NovaIRExpr *value = expr->as.let_expr.value;
+    NovaIRExpr *body = expr->as.let_expr.body;
+    if (is_trivial_expr(value)) {
+        nova_ir_expr_free(value);
+        expr->as.let_expr.value = NULL;
+        expr->as.let_expr.body = NULL;
+        nova_ir_expr_free(expr);
+        *slot = body;
+        return;
+    }
+    NovaIRExpr **items = static_cast<NovaIRExpr **>(malloc(2 * sizeof(NovaIRExpr *)));
+    if (!items) return;
+    items[0] = value;
+    items[1] = body;
+    expr->kind = NOVA_IR_EXPR_SEQUENCE;
+    expr->as.sequence.items = items;
+    expr->as.sequence.count = 2;
+}
+
+typedef struct {
+    NovaIRProgram *program;
+    const NovaOptimizeOptions *options;
+    const NovaIRCallGraph *graph;
+    const size_t *body_sizes;
+    size_t caller;
+    size_t caller_size;
+    uint64_t hot_calls; // a profiled function entered this often is hot; 0 without a profile
+    size_t inlined;
+} InlineContext;
+
+static bool should_inline(const InlineContext *context, size_t callee, const NovaIRExpr *call) {
+    if (callee == SIZE_MAX || callee == context->caller) return false;
+    const NovaIRCallGraphNode *node = &context->graph->nodes[callee];
+    const NovaIRFunction *fn = &context->program->functions[callee];
+    if (node->recursive || !fn->body || fn->param_count != call->as.call.arg_count) return false;
+    // Loops only lower in statement position, so keep them out of line.
+    if (contains_loop(fn->body)) return false;
+    // An effect marker on the call site would be lost with the call.
+    if ((call->as.call.effects & ~fn->effects) != 0) return false;
+
+    const NovaOptimizeOptions *options = context->options;
+    size_t size = context->body_sizes[callee];
+    // The call itself and its argument passing disappear when inlined.
+    size_t budget = options->inline_threshold + 1 + call->as.call.arg_count;
+    for (size_t i = 0; i < call->as.call.arg_count; ++i) {
+        if (is_constant_expr(call->as.call.args[i])) {
+            budget += options->inline_constant_bonus;
+        }
+    }
+    if (node->call_site_count == 1 && budget < options->inline_single_call_threshold) {
+        budget = options->inline_single_call_threshold;
+    }
+    // Calls the profile saw often from a function it saw often are worth
+    // more growth.
+    const NovaIRFunction *caller = &context->program->functions[context->caller];
+    if (context->hot_calls > 0 && fn->profile_calls >= context->hot_calls && caller->profile_calls >= context->hot_calls && budget < options->inline_hot_threshold) {
+        budget = options->inline_hot_threshold;
+    }
+    if (size > budget) return false;
+    return context->caller_size + size <= options->inline_growth_limit;
+}
+
+static NovaIRExpr *inline_call(InlineContext *context, const NovaIRFunction *fn, NovaIRExpr *call) {
+    NovaIRExpr *body = nova_ir_expr_clone(fn->body);
+    if (!body) return NULL;
+    RenameScope scope{};
+    scope.program = context->program;
+    scope.ok = true;
+    size_t arg_count = call->as.call.arg_count;
+    NovaToken *bound = static_cast<NovaToken *>(calloc(arg_count ? arg_count : 1, sizeof(NovaToken)));
+    if (!bound) {
+        nova_ir_expr_free(body);
+        return NULL;
+    }
+    for (size_t i = 0; i < arg_count && scope.ok; ++i) {
+        NovaIRExpr *arg = call->as.call.args[i];
+        if (is_trivial_expr(arg)) {
+            rename_push(&scope, fn->params[i].name, nova_ir_expr_clone(arg));
+            continue;
+        }
+        bound[i] = nova_ir_fresh_name(context->program, &fn->params[i].name);
+        if (!bound[i].lexeme) {
+            scope.ok = false;
+            break;
+        }
+        rename_push(&scope, fn->params[i].name, identifier_expr(bound[i], arg ? arg->type : fn->params[i].type));
+    }
+    if (scope.ok) {
+        rename_expr(&body, &scope);
+    }
+    rename_pop(&scope, scope.count);
+    free(scope.entries);
+    if (!scope.ok) {
+        free(bound);
+        nova_ir_expr_free(body);
+        return NULL;
+    }
+
+    // Bind non-trivial arguments innermost-last so they still evaluate left to right.
+    NovaIRExpr *result = body;
+    for (size_t i = arg_count; i > 0; --i) {
+        if (!bound[i - 1].lexeme) continue;
+        NovaIRExpr *let = nova_ir_expr_new(NOVA_IR_EXPR_LET, call->type);
+        if (!let) {
+            free(bound);
+            nova_ir_expr_free(result);
+            return NULL;
+        }
+        let->as.let_expr.name = bound[i - 1];
+        let->as.let_expr.body = result;
+        result = let;
+    }
+    // Only move the arguments once nothing can fail any more.
+    for (NovaIRExpr *cursor = result; cursor != body; cursor = cursor->as.let_expr.body) {
+        for (size_t i = 0; i < arg_count; ++i) {
+            if (bound[i].lexeme == cursor->as.let_expr.name.lexeme) {
+                cursor->as.let_expr.value = call->as.call.args[i];
+                call->as.call.args[i] = NULL;
+            }
+        }
+    }
+    free(bound);
+    return result;
+}
+
+static void inline_visit(NovaIRExpr **slot, void *ctx) {
+    InlineContext *context = static_cast<InlineContext *>(ctx);
+    if (!*slot) return;
+    nova_ir_expr_for_each_child(*slot, inline_visit, ctx);
+    NovaIRExpr *expr = *slot;
+    if (expr->kind != NOVA_IR_EXPR_CALL) return;
+    size_t callee = nova_ir_call_graph_lookup(context->graph, context->program, &expr->as.call.callee);
+    if (!should_inline(context, callee, expr)) return;
+    NovaIRExpr *replacement = inline_call(context, &context->program->functions[callee], expr);
+    if (!replacement) return;
+    context->caller_size += context->body_sizes[callee];
+    context->inlined++;
+    *slot = replacement;
+    nova_ir_expr_free(expr);
+}
+
+size_t nova_optimize_inline(NovaIRProgram *program, const NovaSemanticContext *semantics, const NovaOptimizeOptions *options) {
+    if (!program || !options || !options->inline_functions || program->function_count == 0) {
+        return 0;
+    }
+    NovaIRCallGraph graph;
+    if (!nova_ir_call_graph_build(program, &graph)) {
+        return 0;
+    }
+    size_t *body_sizes = static_cast<size_t *>(calloc(program->function_count, sizeof(size_t)));
+    if (!body_sizes) {
+        nova_ir_call_graph_free(&graph);
+        return 0;
+    }
+    for (size_t i = 0; i < program->function_count; ++i) {
+        body_sizes[i] = nova_ir_expr_size(program->functions[i].body);
+    }
+
+    InlineContext context{};
+    context.program = program;
+    context.options = options;
+    context.graph = &graph;
+    context.body_sizes = body_sizes;
+    if (program->profiled) {
+        uint64_t hottest = 0;
+        for (size_t i = 0; i < program->function_count; ++i) {
+            if (program->functions[i].profile_calls > hottest) hottest = program->functions[i].profile_calls;
+        }
+        context.hot_calls = hottest > 0 ? (hottest + 63) / 64 : 0;
+    }
+    // Callees are finished before their callers, so inlining pulls in bodies
+    // that have already been simplified.
+    for (size_t order = 0; order < graph.node_count; ++order) {
+        size_t index = graph.bottom_up[order];
+        NovaIRFunction *fn = &program->functions[index];
+        if (!fn->body) continue;
+        size_t before = context.inlined;
+        context.caller = index;
+        context.caller_size = body_sizes[index];
+        inline_visit(&fn->body, &context);
+        // Inlining can expose the closure a call goes through; calling the
+        // lifted function directly lets it be inlined in turn.
+        if (context.inlined != before && nova_ir_devirtualize(program, semantics, &fn->body) > 0) {
+            inline_visit(&fn->body, &context);
+        }
+        if (context.inlined != before) {
+            drop_unused_lets(&fn->body, NULL);
+            nova_ir_fold_constants(&fn->body);
+            body_sizes[index] = nova_ir_expr_size(fn->body);
+        }
+    }
+
+    free(body_sizes);
+    nova_ir_call_graph_free(&graph);
+    return context.inlined;
+}
+
+static void scan_call_effects(NovaIRExpr **slot, void *ctx);
+
+typedef struct {
+    NovaIRProgram *program;
+    const NovaIRCallGraph *graph;
+    NovaEffectMask effects;
+} EffectScan;
+
+static void scan_call_effects(NovaIRExpr **slot, void *ctx) {
+    EffectScan *scan = static_cast<EffectScan *>(ctx);
+    NovaIRExpr *expr = *slot;
+    if (!expr) return;
+    if (expr->kind == NOVA_IR_EXPR_CALL) {
+        size_t callee = nova_ir_call_graph_lookup(scan->graph, scan->program, &expr->as.call.callee);
+        NovaEffectMask callee_effects = callee != SIZE_MAX ? scan->program->functions[callee].effects : NOVA_EFFECT_IMPURE;
+        expr->as.call.effects = static_cast<NovaEffectMask>(expr->as.call.effects | callee_effects);
+        scan->effects = static_cast<NovaEffectMask>(scan->effects | expr->as.call.effects);
+    } else if (expr->kind == NOVA_IR_EXPR_APPLY) {
+        scan->effects = static_cast<NovaEffectMask>(scan->effects | expr->as.apply.effects);
+    }
+    nova_ir_expr_for_each_child(expr, scan_call_effects, ctx);
+}
+
+// Semantic analysis records a function's effects only after its body, so
+// recursive calls see an empty mask. Propagating over the call graph until
+// nothing changes closes that gap.
+static bool infer_effects(NovaIRProgram *program) {
+    NovaIRCallGraph graph;
+    if (!nova_ir_call_graph_build(program, &graph)) {
+        return false;
+    }
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t order = 0; order < graph.node_count; ++order) {
+            NovaIRFunction *fn = &program->functions[graph.bottom_up[order]];
+            EffectScan scan = {program, &graph, fn->effects};
+            scan_call_effects(&fn->body, &scan);
+            if (scan.effects != fn->effects) {
+                fn->effects = scan.effects;
+                changed = true;
+            }
+        }
+    }
+    nova_ir_call_graph_free(&graph);
+    return true;
+}
+
+static void find_impurity(NovaIRExpr **slot, void *ctx) {
+    bool *impure = static_cast<bool *>(ctx);
+    NovaIRExpr *expr = *slot;
+    if (*impure || !expr) return;
+    if (expr->kind == NOVA_IR_EXPR_WHILE || expr->kind == NOVA_IR_EXPR_ASSIGN ||
+        (expr->kind == NOVA_IR_EXPR_CALL && expr->as.call.effects != NOVA_EFFECT_NONE) ||
+        (expr->kind == NOVA_IR_EXPR_APPLY && expr->as.apply.effects != NOVA_EFFECT_NONE)) {
+        *impure = true;
+        return;
+    }
+    nova_ir_expr_for_each_child(expr, find_impurity, ctx);
+}
+
+// Pure expressions may be dropped, duplicated or evaluated early; loops are
+// excluded because dropping one could change whether the program terminates,
+// and assignments because they change what later reads observe.
+static bool expr_is_pure(const NovaIRExpr *expr) {
+    bool impure = false;
+    NovaIRExpr *root = const_cast<NovaIRExpr *>(expr);
+    find_impurity(&root, &impure);
+    return !impure;
+}
+
+static void count_calls(NovaIRExpr **slot, void *ctx) {
+    if (!*slot) return;
+    if ((*slot)->kind == NOVA_IR_EXPR_CALL) (*static_cast<size_t *>(ctx))++;
+    nova_ir_expr_for_each_child(*slot, count_calls, ctx);
+}
+
+static void remove_dead_calls(NovaIRExpr **slot, void *ctx) {
+    size_t *removed = static_cast<size_t *>(ctx);
+    NovaIRExpr *expr = *slot;
+    if (!expr) return;
+    nova_ir_expr_for_each_child(expr, remove_dead_calls, ctx);
+    switch (expr->kind) {
+    case NOVA_IR_EXPR_SEQUENCE: {
+        size_t kept = 0;
+        for (size_t i = 0; i < expr->as.sequence.count; ++i) {
+            NovaIRExpr *item = expr->as.sequence.items[i];
+            bool last = i + 1 == expr->as.sequence.count;
+            if (!last && expr_is_pure(item)) {
+                count_calls(&item, removed);
+                nova_ir_expr_free(item);
+                continue;
+            }
+            expr->as.sequence.items[kept++] = item;
+        }
+        expr->as.sequence.count = kept;
+        break;
+    }
+    case NOVA_IR_EXPR_LET: {
+        UseCounter counter = {&expr->as.let_expr.name, 0};
+        count_uses(&expr->as.let_expr.body, &counter);
+        if (counter.uses > 0 || !expr_is_pure(expr->as.let_expr.value)) break;
+        count_calls(&expr->as.let_expr.value, removed);
+        *slot = expr->as.let_expr.body;
+        expr->as.let_expr.body = NULL;
+        nova_ir_expr_free(expr);
+        break;
+    }
+    case NOVA_IR_EXPR_WHILE:
+        if (expr->as.while_expr.body && expr->as.while_expr.body->kind != NOVA_IR_EXPR_UNIT && expr_is_pure(expr->as.while_expr.body)) {
+            count_calls(&expr->as.while_expr.body, removed);
+            NovaIRExpr *unit = nova_ir_expr_new(NOVA_IR_EXPR_UNIT, expr->as.while_expr.body->type);
+            if (unit) {
+                nova_ir_expr_free(expr->as.while_expr.body);
+                expr->as.while_expr.body = unit;
+            }
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+typedef struct {
+    unsigned char *bytes;
+    size_t length;
+    size_t capacity;
+    bool ok;
+} Signature;
+
+static void signature_append(Signature *sig, const void *data, size_t size) {
+    if (!sig->ok) return;
+    if (sig->length + size > sig->capacity) {
+        size_t new_capacity = sig->capacity == 0 ? 64 : sig->capacity;
+        while (new_capacity < sig->length + size) new_capacity *= 2;
+        unsigned char *bytes = static_cast<unsigned char *>(realloc(sig->bytes, new_capacity));
+        if (!bytes) {
+            sig->ok = false;
+            return;
+        }
+        sig->bytes = bytes;
+        sig->capacity = new_capacity;
+    }
+    memcpy(sig->bytes + sig->length, data, size);
+    sig->length += size;
+}
+
+static void signature_append_token(Signature *sig, const NovaToken *token) {
+    signature_append(sig, &token->length, sizeof(token->length));
+    signature_append(sig, token->lexeme, token->length);
+}
+
+typedef struct {
+    NovaToken name;
+    const void *binder; // parameter, let node or match binding that introduced the name
+} CseBinding;
+
+typedef struct {
+    uint64_t hash;
+    size_t offset; // signature bytes within the arena
+    size_t length;
+    NovaIRExpr **first; // slot of the first occurrence
+    NovaIRExpr ***path; // root-to-first-occurrence slots
+    size_t lca_depth; // common prefix shared by every occurrence
+    size_t guard; // fewest path entries any occurrence needs before its last conditional step
+    size_t count;
+    size_t size;
+} CseCandidate;
+
+typedef struct {
+    NovaIRFunction *fn;
+    CseBinding *scope;
+    size_t scope_count;
+    size_t scope_capacity;
+    NovaIRExpr ***path;
+    size_t path_count;
+    size_t path_capacity;
+    size_t guard; // path index of the innermost branch, arm or loop body entered; 0 outside any
+    CseCandidate *candidates;
+    size_t candidate_count;
+    size_t candidate_capacity;
+    size_t *table; // candidate index + 1, open addressed by hash
+    size_t table_mask;
+    Signature arena;
+    Signature scratch;
+    const CseCandidate *target; // set while rewriting occurrences
+    NovaToken replacement;
+    bool ok;
+} CseContext;
+
+static uint64_t signature_hash(const unsigned char *bytes, size_t length) {
+    uint64_t hash = 1469598103934665603ull;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static void cse_push_binding(CseContext *context, NovaToken name, const void *binder) {
+    if (context->scope_count == context->scope_capacity) {
+        size_t new_capacity = context->scope_capacity == 0 ? 16 : context->scope_capacity * 2;
+        CseBinding *scope = static_cast<CseBinding *>(realloc(context->scope, new_capacity * sizeof(CseBinding)));
+        if (!scope) {
+            context->ok = false;
+            return;
+        }
+        context->scope = scope;
+        context->scope_capacity = new_capacity;
+    }
+    context->scope[context->scope_count].name = name;
+    context->scope[context->scope_count].binder = binder;
+    context->scope_count++;
+}
+
+static const void *cse_resolve(const CseContext *context, const NovaToken *name) {
+    for (size_t i = context->scope_count; i > 0; --i) {
+        if (token_equals(&context->scope[i - 1].name, name)) {
+            return context->scope[i - 1].binder;
+        }
+    }
+    return NULL;
+}
+
+// Serialises a pure call tree with identifiers resolved to their binders, so
+// equal signatures mean equal values wherever both occurrences are in scope.
+static bool cse_signature(const CseContext *context, const NovaIRExpr *expr, Signature *sig) {
+    if (!expr) return false;
+    unsigned char tag = (unsigned char)expr->kind;
+    signature_append(sig, &tag, 1);
+    switch (expr->kind) {
+    case NOVA_IR_EXPR_NUMBER:
+        signature_append(sig, &expr->as.number_value, sizeof(double));
+        return true;
+    case NOVA_IR_EXPR_INT:
+        signature_append(sig, &expr->as.int_value, sizeof(int64_t));
+        return true;
+    case NOVA_IR_EXPR_BOOL: {
+        unsigned char value = expr->as.bool_value ? 1 : 0;
+        signature_append(sig, &value, 1);
+        return true;
+    }
+    case NOVA_IR_EXPR_UNIT:
+        return true;
+    case NOVA_IR_EXPR_STRING: {
+        size_t length = expr->as.string_value.text ? strlen(expr->as.string_value.text) : 0;
+        signature_append(sig, &length, sizeof(length));
+        signature_append(sig, expr->as.string_value.text, length);
+        return true;
+    }
+    case NOVA_IR_EXPR_IDENTIFIER: {
+        const void *binder = cse_resolve(context, &expr->as.identifier);
+        signature_append(sig, &binder, sizeof(binder));
+        if (!binder) signature_append_token(sig, &expr->as.identifier);
+        return true;
+    }
+    case NOVA_IR_EXPR_CALL:
+        if (expr->as.call.effects != NOVA_EFFECT_NONE) return false;
+        signature_append_token(sig, &expr->as.call.callee);
+        signature_append(sig, &expr->as.call.arg_count, sizeof(expr->as.call.arg_count));
+        for (size_t i = 0; i < expr->as.call.arg_count; ++i) {
+            if (!cse_signature(context, expr->as.call.args[i], sig)) return false;
+        }
+        return true;
+    case NOVA_IR_EXPR_CONSTRUCT:
+        signature_append(sig, &expr->type, sizeof(expr->type));
+        signature_append(sig, &expr->as.construct.tag, sizeof(expr->as.construct.tag));
+        for (size_t i = 0; i < expr->as.construct.arg_count; ++i) {
+            if (!cse_signature(context, expr->as.construct.args[i], sig)) return false;
+        }
+        return true;
+    case NOVA_IR_EXPR_OPERATOR: {
+        unsigned char op = (unsigned char)expr->as.op.op;
+        signature_append(sig, &op, 1);
+        if (!cse_signature(context, expr->as.op.left, sig)) return false;
+        if (expr->as.op.right && !cse_signature(context, expr->as.op.right, sig)) return false;
+        return !expr->as.op.third || cse_signature(context, expr->as.op.third, sig);
+    }
+    default:
+        return false;
+    }
+}
+
+static size_t cse_find(const CseContext *context, uint64_t hash, const Signature *sig) {
+    if (!context->table) return SIZE_MAX;
+    size_t slot = (size_t)hash & context->table_mask;
+    while (context->table[slot]) {
+        const CseCandidate *candidate = &context->candidates[context->table[slot] - 1];
+        if (candidate->hash == hash && candidate->length == sig->length &&
+            memcmp(context->arena.bytes + candidate->offset, sig->bytes, sig->length) == 0) {
+            return context->table[slot] - 1;
+        }
+        slot = (slot + 1) & context->table_mask;
+    }
+    return SIZE_MAX;
+}
+
+static bool cse_table_insert(CseContext *context, size_t index) {
+    size_t needed = (context->candidate_count + 1) * 2;
+    if (!context->table || needed > context->table_mask + 1) {
+        size_t capacity = 64;
+        while (capacity < needed) capacity *= 2;
+        size_t *table = static_cast<size_t *>(calloc(capacity, sizeof(size_t)));
+        if (!table) return false;
+        free(context->table);
+        context->table = table;
+        context->table_mask = capacity - 1;
+        for (size_t i = 0; i < context->candidate_count; ++i) {
+            if (i == index) continue;
+            size_t slot = (size_t)context->candidates[i].hash & context->table_mask;
+            while (context->table[slot]) slot = (slot + 1) & context->table_mask;
+            context->table[slot] = i + 1;
+        }
+    }
+    size_t slot = (size_t)context->candidates[index].hash & context->table_mask;
+    while (context->table[slot]) slot = (slot + 1) & context->table_mask;
+    context->table[slot] = index + 1;
+    return true;
+}
+
+static void cse_record(CseContext *context, NovaIRExpr **slot) {
+    uint64_t hash = signature_hash(context->scratch.bytes, context->scratch.length);
+    size_t index = cse_find(context, hash, &context->scratch);
+    if (index != SIZE_MAX) {
+        CseCandidate *candidate = &context->candidates[index];
+        size_t depth = 0;
+        while (depth < candidate->lca_depth && depth < context->path_count && candidate->path[depth] == context->path[depth]) {
+            depth++;
+        }
+        candidate->lca_depth = depth;
+        if (context->guard < candidate->guard) candidate->guard = context->guard;
+        candidate->count++;
+        return;
+    }
+    if (context->candidate_count == context->candidate_capacity) {
+        size_t new_capacity = context->candidate_capacity == 0 ? 16 : context->candidate_capacity * 2;
+        CseCandidate *candidates = static_cast<CseCandidate *>(realloc(context->candidates, new_capacity * sizeof(CseCandidate)));
+        if (!candidates) {
+            context->ok = false;
+            return;
+        }
+        context->candidates = candidates;
+        context->candidate_capacity = new_capacity;
+    }
+    CseCandidate *candidate = &context->candidates[context->candidate_count];
+    candidate->hash = hash;
+    candidate->offset = context->arena.length;
+    candidate->length = context->scratch.length;
+    candidate->first = slot;
+    candidate->path = static_cast<NovaIRExpr ***>(malloc(context->path_count * sizeof(NovaIRExpr **)));
+    candidate->lca_depth = context->path_count;
+    candidate->guard = context->guard;
+    candidate->count = 1;
+    candidate->size = nova_ir_expr_size(*slot);
+    signature_append(&context->arena, context->scratch.bytes, context->scratch.length);
+    if (!candidate->path || !context->arena.ok) {
+        free(candidate->path);
+        context->ok = false;
+        return;
+    }
+    memcpy(candidate->path, context->path, context->path_count * sizeof(NovaIRExpr **));
+    context->candidate_count++;
+    if (!cse_table_insert(context, context->candidate_count - 1)) {
+        context->ok = false;
+    }
+}
+
+static void cse_visit(NovaIRExpr **slot, void *ctx);
+
+// Whether evaluating parent may skip the child in slot, or evaluate it more
+// than once.
+static bool cse_conditional_child(const NovaIRExpr *parent, NovaIRExpr *const *slot) {
+    switch (parent->kind) {
+    case NOVA_IR_EXPR_IF:
+        return slot != &parent->as.if_expr.condition;
+    case NOVA_IR_EXPR_WHILE:
+        return true;
+    case NOVA_IR_EXPR_MATCH:
+        return slot != &parent->as.match_expr.scrutinee;
+    default:
+        return false;
+    }
+}
+
+static void cse_visit_scoped(CseContext *context, NovaIRExpr **slot) {
+    if (!*slot || !context->ok) return;
+    if (context->path_count == context->path_capacity) {
+        size_t new_capacity = context->path_capacity == 0 ? 32 : context->path_capacity * 2;
+        NovaIRExpr ***path = static_cast<NovaIRExpr ***>(realloc(context->path, new_capacity * sizeof(NovaIRExpr **)));
+        if (!path) {
+            context->ok = false;
+            return;
+        }
+        context->path = path;
+        context->path_capacity = new_capacity;
+    }
+    size_t guard = context->guard;
+    if (context->path_count > 0 && cse_conditional_child(*context->path[context->path_count - 1], slot)) {
+        context->guard = context->path_count;
+    }
+    context->path[context->path_count++] = slot;
+    NovaIRExpr *expr = *slot;
+    bool descend = true;
+    if (expr->kind == NOVA_IR_EXPR_CALL) {
+        context->scratch.length = 0;
+        if (cse_signature(context, expr, &context->scratch) && context->scratch.ok) {
+            if (context->target) {
+                if (context->scratch.length == context->target->length &&
+                    memcmp(context->scratch.bytes, context->arena.bytes + context->target->offset, context->scratch.length) == 0) {
+                    NovaIRExpr *identifier = identifier_expr(context->replacement, expr->type);
+                    if (identifier) {
+                        nova_ir_expr_free(expr);
+                        *slot = identifier;
+                        descend = false;
+                    } else {
+                        context->ok = false;
+                    }
+                }
+            } else {
+                cse_record(context, slot);
+            }
+        }
+    }
+    if (descend) {
+        switch (expr->kind) {
+        case NOVA_IR_EXPR_LET:
+            cse_visit_scoped(context, &expr->as.let_expr.value);
+            cse_push_binding(context, expr->as.let_expr.name, expr);
+            cse_visit_scoped(context, &expr->as.let_expr.body);
+            context->scope_count--;
+            break;
+        case NOVA_IR_EXPR_MATCH:
+            cse_visit_scoped(context, &expr->as.match_expr.scrutinee);
+            for (size_t i = 0; i < expr->as.match_expr.arm_count; ++i) {
+                NovaIRMatchArm *arm = &expr->as.match_expr.arms[i];
+                size_t mark = context->scope_count;
+                for (size_t b = 0; b < arm->binding_count; ++b) {
+                    cse_push_binding(context, arm->bindings[b], &arm->bindings[b]);
+                }
+                cse_visit_scoped(context, &arm->body);
+                context->scope_count = mark;
+            }
+            break;
+        default:
+            nova_ir_expr_for_each_child(expr, cse_visit, context);
+            break;
+        }
+    }
+    context->path_count--;
+    context->guard = guard;
+}
+
+static void cse_visit(NovaIRExpr **slot, void *ctx) {
+    cse_visit_scoped(static_cast<CseContext *>(ctx), slot);
+}
+
+static void cse_reset(CseContext *context) {
+    for (size_t i = 0; i < context->candidate_count; ++i) {
+        free(context->candidates[i].path);
+    }
+    context->candidate_count = 0;
+    context->arena.length = 0;
+    context->scope_count = 0;
+    context->path_count = 0;
+    context->guard = 0;
+    context->target = NULL;
+    if (context->table) {
+        memset(context->table, 0, (context->table_mask + 1) * sizeof(size_t));
+    }
+    for (size_t p = 0; p < context->fn->param_count; ++p) {
+        cse_push_binding(context, context->fn->params[p].name, &context->fn->params[p]);
+    }
+}
+
+// Hoists one repeated pure call per round, largest first, so nested repeats
+// are handled once their enclosing expression has been shared.
+static size_t eliminate_common_calls(NovaIRProgram *program, NovaIRFunction *fn) {
+    // Signatures compare names, not values, so they only hold while no binding is reassigned.
+    if (!fn->body || contains_assignment(fn->body)) return 0;
+    CseContext context{};
+    context.fn = fn;
+    context.ok = true;
+    context.arena.ok = true;
+    context.scratch.ok = true;
+    size_t hoisted = 0;
+    for (size_t round = 0; round < 256 && context.ok; ++round) {
+        cse_reset(&context);
+        cse_visit_scoped(&context, &fn->body);
+        if (!context.ok) break;
+        const CseCandidate *best = NULL;
+        for (size_t i = 0; i < context.candidate_count; ++i) {
+            const CseCandidate *candidate = &context.candidates[i];
+            if (candidate->count < 2 || candidate->lca_depth == 0) continue;
+            // The shared let runs whenever its anchor does, so some occurrence
+            // must already run on every path through the anchor: a pure call
+            // may still abort or never return.
+            if (candidate->guard >= candidate->lca_depth) continue;
+            if (!best || candidate->size > best->size) best = candidate;
+        }
+        if (!best) break;
+
+        NovaIRExpr *value = nova_ir_expr_clone(*best->first);
+        NovaToken name = nova_ir_fresh_name(program, &(*best->first)->as.call.callee);
+        NovaIRExpr **anchor = best->path[best->lca_depth - 1];
+        NovaIRExpr *let = value && name.lexeme ? nova_ir_expr_new(NOVA_IR_EXPR_LET, (*anchor)->type) : NULL;
+        if (!let) {
+            nova_ir_expr_free(value);
+            break;
+        }
+        CseCandidate target = *best;
+        context.target = &target;
+        context.replacement = name;
+        context.scope_count = 0;
+        for (size_t p = 0; p < fn->param_count; ++p) {
+            cse_push_binding(&context, fn->params[p].name, &fn->params[p]);
+        }
+        context.path_count = 0;
+        context.guard = 0;
+        cse_visit_scoped(&context, &fn->body);
+        context.target = NULL;
+        let->as.let_expr.name = name;
+        let->as.let_expr.value = value;
+        let->as.let_expr.body = *anchor;
+        *anchor = let;
+        hoisted++;
+    }
+    cse_reset(&context);
+    free(context.candidates);
+    free(context.table);
+    free(context.scope);
+    free(context.path);
+    free(context.arena.bytes);
+    free(context.scratch.bytes);
+    return hoisted;
+}
+
+size_t nova_optimize_eliminate_common_calls(NovaIRProgram *program, const NovaSemanticContext *semantics, size_t *removed_calls) {
+    if (removed_calls) *removed_calls = 0;
+    if (!program || !infer_effects(program)) {
+        return 0;
+    }
+    size_t hoisted = 0;
+    size_t removed = 0;
+    for (size_t i = 0; i < program->function_count; ++i) {
+        NovaIRFunction *fn = &program->functions[i];
+        if (!fn->body) continue;
+        remove_dead_calls(&fn->body, &removed);
+        const NovaTypeInfo *info = nova_semantic_type_info(semantics, fn->return_type);
+        // A Unit function is evaluated only for its effects.
+        if (info && info->kind == NOVA_TYPE_KIND_UNIT && fn->body->kind != NOVA_IR_EXPR_UNIT && expr_is_pure(fn->body)) {
+            NovaIRExpr *unit = nova_ir_expr_new(NOVA_IR_EXPR_UNIT, fn->return_type);
+            if (unit) {
+                count_calls(&fn->body, &removed);
+                nova_ir_expr_free(fn->body);
+                fn->body = unit;
+            }
+        }
+        hoisted += eliminate_common_calls(program, fn);
+        nova_ir_fold_constants(&fn->body);
+    }
+    if (removed_calls) *removed_calls = removed;
+    return hoisted;
+}
+
+static bool is_self_call(const NovaIRFunction *fn, const NovaIRExpr *expr) {
+    return expr && expr->kind == NOVA_IR_EXPR_CALL && token_equals(&expr->as.call.callee, &fn->name) &&
+           expr->as.call.arg_count == fn->param_count;
+}
+
+static bool has_self_tail_call(const NovaIRFunction *fn, const NovaIRExpr *expr) {
+    if (!expr) return false;
+    switch (expr->kind) {
+    case NOVA_IR_EXPR_CALL:
+        return is_self_call(fn, expr);
+    case NOVA_IR_EXPR_IF:
+        return has_self_tail_call(fn, expr->as.if_expr.then_branch) || has_self_tail_call(fn, expr->as.if_expr.else_branch);
+    case NOVA_IR_EXPR_SEQUENCE:
+        return expr->as.sequence.count > 0 && has_self_tail_call(fn, expr->as.sequence.items[expr->as.sequence.count - 1]);
+    case NOVA_IR_EXPR_LET:
+        return has_self_tail_call(fn, expr->as.let_expr.body);
+    case NOVA_IR_EXPR_MATCH:
+        for (size_t i = 0; i < expr->as.match_expr.arm_count; ++i) {
+            if (has_self_tail_call(fn, expr->as.match_expr.arms[i].body)) return true;
+        }
+        return false;
+    default:
+        return false;
+    }
+}
+
+typedef struct {
+    NovaIRProgram *program;
+    const NovaSemanticContext *semantics;
+    const NovaIRFunction *fn;
+    NovaToken running;
+    NovaToken result;
+    bool returns_value;
+    bool ok;
+} TailContext;
+
+static NovaIRExpr *assign_expr(TailContext *context, NovaToken target, NovaIRExpr *value) {
+    NovaIRExpr *assign = value ? nova_ir_expr_new(NOVA_IR_EXPR_ASSIGN, context->semantics->type_unit) : NULL;
+    if (!assign) {
+        nova_ir_expr_free(value);
+        context->ok = false;
+        return NULL;
+    }
+    assign->as.assign.target = target;
+    assign->as.assign.value = value;
+    return assign;
+}
+
+static NovaIRExpr *sequence_expr(TailContext *context, NovaIRExpr **items, size_t count) {
+    NovaIRExpr *sequence = nova_ir_expr_new(NOVA_IR_EXPR_SEQUENCE, context->semantics->type_unit);
+    NovaIRExpr **copy = count > 0 ? static_cast<NovaIRExpr **>(malloc(count * sizeof(NovaIRExpr *))) : NULL;
+    if (!sequence || (count > 0 && !copy)) {
+        for (size_t i = 0; i < count; ++i) nova_ir_expr_free(items[i]);
+        free(sequence);
+        free(copy);
+        context->ok = false;
+        return NULL;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (!items[i]) context->ok = false;
+        copy[i] = items[i];
+    }
+    sequence->as.sequence.items = copy;
+    sequence->as.sequence.count = count;
+    return sequence;
+}
+
+// A tail self call becomes a parallel parameter update: every argument is
+// evaluated into a temporary before any parameter changes.
+static NovaIRExpr *rewrite_self_call(TailContext *context, NovaIRExpr *call) {
+    const NovaIRFunction *fn = context->fn;
+    size_t count = call->as.call.arg_count;
+    NovaIRExpr **updates = static_cast<NovaIRExpr **>(calloc(count ? count : 1, sizeof(NovaIRExpr *)));
+    NovaToken *temps = static_cast<NovaToken *>(calloc(count ? count : 1, sizeof(NovaToken)));
+    if (!updates || !temps) {
+        free(updates);
+        free(temps);
+        nova_ir_expr_free(call);
+        context->ok = false;
+        return NULL;
+    }
+    size_t update_count = 0;
+    for (size_t i = 0; i < count; ++i) {
+        NovaIRExpr *arg = call->as.call.args[i];
+        if (arg->kind == NOVA_IR_EXPR_IDENTIFIER && token_equals(&arg->as.identifier, &fn->params[i].name)) {
+            continue;
+        }
+        if (is_constant_expr(arg)) {
+            updates[update_count++] = assign_expr(context, fn->params[i].name, nova_ir_expr_clone(arg));
+            continue;
+        }
+        temps[i] = nova_ir_fresh_name(context->program, &fn->params[i].name);
+        if (!temps[i].lexeme) {
+            context->ok = false;
+            continue;
+        }
+        updates[update_count++] = assign_expr(context, fn->params[i].name, identifier_expr(temps[i], arg->type));
+    }
+    NovaIRExpr *result = sequence_expr(context, updates, update_count);
+    for (size_t i = count; i > 0 && result; --i) {
+        if (!temps[i - 1].lexeme) continue;
+        NovaIRExpr *let = nova_ir_expr_new(NOVA_IR_EXPR_LET, context->semantics->type_unit);
+        if (!let) {
+            context->ok = false;
+            break;
+        }
+        let->as.let_expr.name = temps[i - 1];
+        let->as.let_expr.value = call->as.call.args[i - 1];
+        call->as.call.args[i - 1] = NULL;
+        let->as.let_expr.body = result;
+        result = let;
+    }
+    free(updates);
+    free(temps);
+    nova_ir_expr_free(call);
+    return result;
+}
+
+// Any other value in tail position ends the loop with that value as result.
+static NovaIRExpr *rewrite_tail_value(TailContext *context, NovaIRExpr *expr) {
+    NovaIRExpr *stop = nova_ir_expr_new(NOVA_IR_EXPR_BOOL, context->semantics->type_bool);
+    if (stop) stop->as.bool_value = false;
+    NovaIRExpr *items[2];
+    items[0] = context->returns_value ? assign_expr(context, context->result, expr) : expr;
+    items[1] = assign_expr(context, context->running, stop);
+    return sequence_expr(context, items, 2);
+}
+
+static NovaIRExpr *rewrite_tail(TailContext *context, NovaIRExpr *expr) {
+    switch (expr->kind) {
+    case NOVA_IR_EXPR_CALL:
+        if (is_self_call(context->fn, expr)) return rewrite_self_call(context, expr);
+        return rewrite_tail_value(context, expr);
+    case NOVA_IR_EXPR_IF:
+        expr->as.if_expr.then_branch = rewrite_tail(context, expr->as.if_expr.then_branch);
+        expr->as.if_expr.else_branch = rewrite_tail(context, expr->as.if_expr.else_branch);
+        break;
+    case NOVA_IR_EXPR_SEQUENCE: {
+        NovaIRExpr **last = &expr->as.sequence.items[expr->as.sequence.count - 1];
+        *last = rewrite_tail(context, *last);
+        break;
+    }
+    case NOVA_IR_EXPR_LET:
+        expr->as.let_expr.body = rewrite_tail(context, expr->as.let_expr.body);
+        break;
+    case NOVA_IR_EXPR_MATCH:
+        for (size_t i = 0; i < expr->as.match_expr.arm_count; ++i) {
+            expr->as.match_expr.arms[i].body = rewrite_tail(context, expr->as.match_expr.arms[i].body);
+        }
+        break;
+    default:
+        return rewrite_tail_value(context, expr);
+    }
+    expr->type = context->semantics->type_unit;
+    return expr;
+}
+
+static bool is_param_name(const NovaIRFunction *fn, const NovaToken *name) {
+    for (size_t i = 0; i < fn->param_count; ++i) {
+        if (token_equals(&fn->params[i].name, name)) return true;
+    }
+    return false;
+}
+
+typedef struct {
+    const NovaIRFunction *fn;
+    bool found;
+} ShadowSearch;
+
+static void find_shadowed_param(NovaIRExpr **slot, void *ctx) {
+    ShadowSearch *search = static_cast<ShadowSearch *>(ctx);
+    NovaIRExpr *expr = *slot;
+    if (!expr || search->found) return;
+    if (expr->kind == NOVA_IR_EXPR_LET && is_param_name(search->fn, &expr->as.let_expr.name)) {
+        search->found = true;
+        return;
+    }
+    if (expr->kind == NOVA_IR_EXPR_MATCH) {
+        for (size_t i = 0; i < expr->as.match_expr.arm_count; ++i) {
+            const NovaIRMatchArm *arm = &expr->as.match_expr.arms[i];
+            for (size_t b = 0; b < arm->binding_count; ++b) {
+                if (is_param_name(search->fn, &arm->bindings[b])) {
+                    search->found = true;
+                    return;
+                }
+            }
+        }
+    }
+    nova_ir_expr_for_each_child(expr, find_shadowed_param, ctx);
+}
+
+static NovaIRExpr *zero_value(const NovaSemanticContext *semantics, NovaTypeId type) {
+    const NovaTypeInfo *info = nova_semantic_type_info(semantics, type);
+    NovaTypeKind kind = info ? info->kind : NOVA_TYPE_KIND_UNKNOWN;
+    NovaIRExpr *zero = NULL;
+    if (kind == NOVA_TYPE_KIND_BOOL) {
+        zero = nova_ir_expr_new(NOVA_IR_EXPR_BOOL, type);
+    } else if (kind == NOVA_TYPE_KIND_STRING) {
+        zero = nova_ir_expr_new(NOVA_IR_EXPR_STRING, type);
+    } else if (kind == NOVA_TYPE_KIND_INT) {
+        zero = nova_ir_expr_new(NOVA_IR_EXPR_INT, type);
+    } else {
+        zero = nova_ir_expr_new(NOVA_IR_EXPR_NUMBER, type);
+    }
+    return zero;
+}
+
+// Rewrites f(p) = ... f(a) ... into
+//   let mut result = 0; let mut running = true;
+//   while running { ... p = a ... result = v; running = false ... }; result
+static bool eliminate_self_tail_calls(NovaIRProgram *program, const NovaSemanticContext *semantics, NovaIRFunction *fn) {
+    if (!fn->body || !has_self_tail_call(fn, fn->body)) return false;
+    const NovaTypeInfo *info = nova_semantic_type_info(semantics, fn->return_type);
+    TailContext context{};
+    context.program = program;
+    context.semantics = semantics;
+    context.fn = fn;
+    context.returns_value = !info || info->kind != NOVA_TYPE_KIND_UNIT;
+    context.ok = true;
+    NovaToken running_base{};
+    running_base.lexeme = "running";
+    running_base.length = 7;
+    running_base.line = fn->name.line;
+    running_base.column = fn->name.column;
+    NovaToken result_base = running_base;
+    result_base.lexeme = "result";
+    result_base.length = 6;
+    context.running = nova_ir_fresh_name(program, &running_base);
+    context.result = nova_ir_fresh_name(program, &result_base);
+    if (!context.running.lexeme || !context.result.lexeme) return false;
+
+    NovaIRExpr *loop = nova_ir_expr_new(NOVA_IR_EXPR_WHILE, semantics->type_unit);
+    NovaIRExpr *running_init = nova_ir_expr_new(NOVA_IR_EXPR_BOOL, semantics->type_bool);
+    NovaIRExpr *running_let = nova_ir_expr_new(NOVA_IR_EXPR_LET, fn->return_type);
+    NovaIRExpr *condition = identifier_expr(context.running, semantics->type_bool);
+    NovaIRExpr *result_let = context.returns_value ? nova_ir_expr_new(NOVA_IR_EXPR_LET, fn->return_type) : NULL;
+    NovaIRExpr *result_init = context.returns_value ? zero_value(semantics, fn->return_type) : NULL;
+    NovaIRExpr *result_read = context.returns_value ? identifier_expr(context.result, fn->return_type) : NULL;
+    if (!loop || !running_init || !running_let || !condition ||
+        (context.returns_value && (!result_let || !result_init || !result_read))) {
+        nova_ir_expr_free(loop);
+        nova_ir_expr_free(running_init);
+        nova_ir_expr_free(running_let);
+        nova_ir_expr_free(condition);
+        nova_ir_expr_free(result_let);
+        nova_ir_expr_free(result_init);
+        nova_ir_expr_free(result_read);
+        return false;
+    }
+    // Rewriting is done in place, so work on a copy that can be dropped on failure.
+    NovaIRExpr *body = nova_ir_expr_clone(fn->body);
+    // The loop assigns parameters by name, so a let or match binding reusing
+    // one would capture both the assignment and the argument; fresh binder
+    // names leave every parameter name meaning the parameter.
+    ShadowSearch shadow = {fn, false};
+    if (body) find_shadowed_param(&body, &shadow);
+    if (body && shadow.found) {
+        RenameScope scope{};
+        scope.program = program;
+        scope.ok = true;
+        rename_expr(&body, &scope);
+        free(scope.entries);
+        context.ok = scope.ok;
+    }
+    body = body && context.ok ? rewrite_tail(&context, body) : body;
+    if (!body || !context.ok) {
+        nova_ir_expr_free(body);
+        nova_ir_expr_free(loop);
+        nova_ir_expr_free(running_init);
+        nova_ir_expr_free(running_let);
+        nova_ir_expr_free(condition);
+        nova_ir_expr_free(result_let);
+        nova_ir_expr_free(result_init);
+        nova_ir_expr_free(result_read);
+        return false;
+    }
+    loop->as.while_expr.condition = condition;
+    loop->as.while_expr.body = body;
+    running_init->as.bool_value = true;
+    running_let->as.let_expr.name = context.running;
+    running_let->as.let_expr.value = running_init;
+    running_let->as.let_expr.is_mutable = true;
+    if (context.returns_value) {
+        NovaIRExpr *items[2] = {loop, result_read};
+        running_let->as.let_expr.body = sequence_expr(&context, items, 2);
+        running_let->as.let_expr.body->type = fn->return_type;
+        result_let->as.let_expr.name = context.result;
+        result_let->as.let_expr.value = result_init;
+        result_let->as.let_expr.is_mutable = true;
+        result_let->as.let_expr.body = running_let;
+        nova_ir_expr_free(fn->body);
+        fn->body = result_let;
+    } else {
+        running_let->as.let_expr.body = loop;
+        nova_ir_expr_free(fn->body);
+        fn->body = running_let;
+    }
+    return true;
+}
+
+size_t nova_optimize_tail_calls(NovaIRProgram *program, const NovaSemanticContext *semantics) {
+    if (!program || !semantics) return 0;
+    size_t rewritten = 0;
+    for (size_t i = 0; i < program->function_count; ++i) {
+        if (eliminate_self_tail_calls(program, semantics, &program->functions[i])) {
+            rewritten++;
+        }
+    }
+    return rewritten;
+}
+
+typedef struct {
+    const NovaSemanticContext *semantics;
+    bool *live_types; // indexed by NovaTypeId
+} TypeMarker;
+
+static void mark_type(TypeMarker *marker, NovaTypeId type);
+
+static const NovaTypeRecord *find_type_record(const NovaSemanticContext *semantics, NovaTypeId type) {
+    for (size_t i = 0; i < semantics->type_records.count; ++i) {
+        if (semantics->type_records.items[i].type_id == type) {
+            return &semantics->type_records.items[i];
+        }
+    }
+    return NULL;
+}
+
+static void mark_named_type(TypeMarker *marker, const NovaParam *param) {
+    if (!param->has_type) return;
+    const NovaTypeRecord *record = nova_semantic_find_type(marker->semantics, &param->type_name);
+    if (record) mark_type(marker, record->type_id);
+}
+
+static void mark_type(TypeMarker *marker, NovaTypeId type) {
+    if (type >= marker->semantics->type_count || marker->live_types[type]) return;
+    marker->live_types[type] = true;
+    const NovaTypeInfo *info = nova_semantic_type_info(marker->semantics, type);
+    if (!info) return;
+    switch (info->kind) {
+    case NOVA_TYPE_KIND_LIST:
+        mark_type(marker, info->as.list.element);
+        break;
+    case NOVA_TYPE_KIND_MAP:
+        mark_type(marker, info->as.map.key);
+        mark_type(marker, info->as.map.value);
+        break;
+    case NOVA_TYPE_KIND_FUNCTION:
+        for (size_t i = 0; i < info->as.function.param_count; ++i) {
+            mark_type(marker, info->as.function.params[i]);
+        }
+        mark_type(marker, info->as.function.result);
+        break;
+    case NOVA_TYPE_KIND_CUSTOM: {
+        const NovaTypeRecord *record = find_type_record(marker->semantics, type);
+        if (!record || !record->decl) break;
+        const NovaTypeDecl *decl = record->decl;
+        for (size_t v = 0; v < decl->variants.count; ++v) {
+            for (size_t p = 0; p < decl->variants.items[v].payload.count; ++p) {
+                mark_named_type(marker, &decl->variants.items[v].payload.items[p]);
+            }
+        }
+        for (size_t f = 0; f < decl->tuple_fields.count; ++f) {
+            mark_named_type(marker, &decl->tuple_fields.items[f]);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static void mark_expr_types(NovaIRExpr **slot, void *ctx) {
+    if (!*slot) return;
+    mark_type(static_cast<TypeMarker *>(ctx), (*slot)->type);
+    nova_ir_expr_for_each_child(*slot, mark_expr_types, ctx);
+}
+
+bool nova_optimize_eliminate_dead_code(NovaIRProgram *program, const NovaSemanticContext *semantics, const char *const *roots, size_t root_count, NovaOptimizeReport *report, char *error_buffer, size_t error_buffer_size) {
+    if (!program || !semantics) {
+        return false;
+    }
+    // Without roots every function is part of the object's interface.
+    if (root_count == 0 || program->function_count == 0) {
+        return true;
+    }
+    NovaIRCallGraph graph;
+    if (!nova_ir_call_graph_build(program, &graph)) {
+        if (error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "out of memory building call graph");
+        return false;
+    }
+    size_t n = program->function_count;
+    bool *live = static_cast<bool *>(calloc(n, sizeof(bool)));
+    size_t *worklist = static_cast<size_t *>(malloc(n * sizeof(size_t)));
+    if (!live || !worklist) {
+        free(live);
+        free(worklist);
+        nova_ir_call_graph_free(&graph);
+        if (error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "out of memory computing reachability");
+        return false;
+    }
+    // Only the roots stay callable from outside the module.
+    for (size_t i = 0; i < n; ++i) program->functions[i].internal = true;
+    size_t pending = 0;
+    for (size_t r = 0; r < root_count; ++r) {
+        NovaToken name{};
+        name.lexeme = roots[r];
+        name.length = strlen(roots[r]);
+        size_t index = nova_ir_call_graph_lookup(&graph, program, &name);
+        if (index == SIZE_MAX) {
+            if (error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "unknown function '%s'", roots[r]);
+            free(live);
+            free(worklist);
+            nova_ir_call_graph_free(&graph);
+            return false;
+        }
+        program->functions[index].internal = false;
+        if (!live[index]) {
+            live[index] = true;
+            worklist[pending++] = index;
+        }
+    }
+    while (pending > 0) {
+        const NovaIRCallGraphNode *node = &graph.nodes[worklist[--pending]];
+        for (size_t i = 0; i < node->callee_count; ++i) {
+            if (!live[node->callees[i]]) {
+                live[node->callees[i]] = true;
+                worklist[pending++] = node->callees[i];
+            }
+        }
+    }
+    free(worklist);
+    nova_ir_call_graph_free(&graph);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (live[i]) {
+            program->functions[kept++] = program->functions[i];
+            continue;
+        }
+        if (report) {
+            report_push(&report->removed_functions, &report->removed_function_count, &report->removed_function_capacity, program->functions[i].name);
+        }
+        nova_ir_function_free(&program->functions[i]);
+    }
+    program->function_count = kept;
+    free(live);
+
+    if (program->type_count == 0) {
+        return true;
+    }
+    TypeMarker marker;
+    marker.semantics = semantics;
+    marker.live_types = static_cast<bool *>(calloc(semantics->type_count ? semantics->type_count : 1, sizeof(bool)));
+    if (!marker.live_types) {
+        return true; // keeping every type is always correct
+    }
+    for (size_t i = 0; i < program->function_count; ++i) {
+        NovaIRFunction *fn = &program->functions[i];
+        for (size_t p = 0; p < fn->param_count; ++p) {
+            mark_type(&marker, fn->params[p].type);
+        }
+        mark_type(&marker, fn->return_type);
+        mark_expr_types(&fn->body, &marker);
+    }
+    size_t kept_types = 0;
+    for (size_t i = 0; i < program->type_count; ++i) {
+        NovaTypeId type = program->types[i];
+        if (type < semantics->type_count && marker.live_types[type]) {
+            program->types[kept_types++] = type;
+            continue;
+        }
+        const NovaTypeRecord *record = find_type_record(semantics, type);
+        if (report && record && record->decl) {
+            report_push(&report->removed_types, &report->removed_type_count, &report->removed_type_capacity, record->decl->name);
+        }
+    }
+    program->type_count = kept_types;
+    free(marker.live_types);
+    return true;
+}
+
+bool nova_optimize_program(NovaIRProgram *program, const NovaSemanticContext *semantics, const NovaOptimizeOptions *options, NovaOptimizeReport *report, char *error_buffer, size_t error_buffer_size) {
+    if (report) {
+        memset(report, 0, sizeof(*report));
+    }
+    if (!program || !semantics) {
+        return false;
+    }
+    NovaOptimizeOptions defaults;
+    if (!options) {
+        nova_optimize_options_init(&defaults);
+        options = &defaults;
+    }
+    bool prune = options->eliminate_dead_functions && options->root_count > 0;
+    // Pruning first keeps the inliner away from dead code; pruning again drops
+    // helpers whose every call site was inlined.
+    if (prune && !nova_optimize_eliminate_dead_code(program, semantics, options->roots, options->root_count, report, error_buffer, error_buffer_size)) {
+        return false;
+    }
+    size_t inlined = nova_optimize_inline(program, semantics, options);
+    if (report) {
+        report->inlined_calls = inlined;
+    }
+    if (options->eliminate_common_calls) {
+        size_t removed = 0;
+        size_t hoisted = nova_optimize_eliminate_common_calls(program, semantics, &removed);
+        if (report) {
+            report->hoisted_calls = hoisted;
+            report->removed_calls = removed;
+        }
+    }
+    // Loops stop the inliner and hide repeats from CSE, so this runs last.
+    if (options->eliminate_tail_calls) {
+        size_t rewritten = nova_optimize_tail_calls(program, semantics);
+        if (report) {
+            report->tail_recursive_functions = rewritten;
+        }
+    }
+    if (prune && inlined > 0 && !nova_optimize_eliminate_dead_code(program, semantics, options->roots, options->root_count, report, error_buffer, error_buffer_size)) {
+        return false;
+    }
+    return true;
+}
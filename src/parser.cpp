@@ -94,6 +94,28 @@ static NovaToken consume(NovaParser *parser, NovaTokenType type, const char *mes
     return token;
 }
 
+// A type annotation: a type name, possibly applied to type arguments in
+// brackets as in `List[Number]`. The annotation comes back as one token
+// spanning its whole source text, which semantic analysis resolves.
+static NovaToken parse_type_name(NovaParser *parser, const char *message) {
+    NovaToken name = consume(parser, NOVA_TOKEN_IDENTIFIER, message);
+    if (name.type == NOVA_TOKEN_ERROR || !check(parser, NOVA_TOKEN_LBRACKET)) {
+        return name;
+    }
+    advance(parser);
+    // The whole generic name stays one token; the checker splits its arguments.
+    do {
+        NovaToken argument = parse_type_name(parser, "expected type argument");
+        if (argument.type == NOVA_TOKEN_ERROR) return argument;
+    } while (match(parser, NOVA_TOKEN_COMMA));
+    NovaToken close = consume(parser, NOVA_TOKEN_RBRACKET, "expected ']' after type argument");
+    if (close.type == NOVA_TOKEN_ERROR) {
+        return close;
+    }
+    name.length = (size_t)(close.lexeme + close.length - name.lexeme);
+    return name;
+}
+
 static NovaExpr *nova_expr_new(NovaExprKind kind, NovaToken start) {
     NovaExpr *expr = static_cast<NovaExpr *>(calloc(1, sizeof(NovaExpr)));
     if (!expr) {
@@ -120,7 +142,8 @@ static bool lookahead_lambda(const NovaParser *parser) {
             index++;
             break;
         }
-        if (type == NOVA_TOKEN_IDENTIFIER || type == NOVA_TOKEN_COMMA || type == NOVA_TOKEN_COLON) {
+        if (type == NOVA_TOKEN_IDENTIFIER || type == NOVA_TOKEN_COMMA || type == NOVA_TOKEN_COLON ||
+            type == NOVA_TOKEN_LBRACKET || type == NOVA_TOKEN_RBRACKET) {
             index++;
             continue;
         }
@@ -140,7 +163,7 @@ static NovaParam parse_param(NovaParser *parser) {
     param.has_type = false;
     if (match(parser, NOVA_TOKEN_COLON)) {
         param.has_type = true;
-        param.type_name = consume(parser, NOVA_TOKEN_IDENTIFIER, "expected type name");
+        param.type_name = parse_type_name(parser, "expected type name");
     }
     return param;
 }
@@ -307,8 +330,65 @@ static NovaExpr *parse_call_expr(NovaParser *parser) {
     return expr;
 }
 
+// Binding power of each binary operator, loosest first; 0 for tokens that
+// are not binary operators. All of them associate to the left.
+static int binary_precedence(NovaTokenType type, NovaOperator *op) {
+    switch (type) {
+    case NOVA_TOKEN_OR: *op = NOVA_OP_OR; return 1;
+    case NOVA_TOKEN_AND: *op = NOVA_OP_AND; return 2;
+    case NOVA_TOKEN_EQUAL_EQUAL: *op = NOVA_OP_EQ; return 3;
+    case NOVA_TOKEN_BANG_EQUAL: *op = NOVA_OP_NE; return 3;
+    case NOVA_TOKEN_LESS: *op = NOVA_OP_LT; return 4;
+    case NOVA_TOKEN_LESS_EQUAL: *op = NOVA_OP_LE; return 4;
+    case NOVA_TOKEN_GREATER: *op = NOVA_OP_GT; return 4;
+    case NOVA_TOKEN_GREATER_EQUAL: *op = NOVA_OP_GE; return 4;
+    case NOVA_TOKEN_PLUS: *op = NOVA_OP_ADD; return 5;
+    case NOVA_TOKEN_MINUS: *op = NOVA_OP_SUB; return 5;
+    case NOVA_TOKEN_STAR: *op = NOVA_OP_MUL; return 6;
+    case NOVA_TOKEN_SLASH: *op = NOVA_OP_DIV; return 6;
+    case NOVA_TOKEN_PERCENT: *op = NOVA_OP_MOD; return 6;
+    default: return 0;
+    }
+}
+
+static NovaExpr *operator_expr(NovaOperator op, NovaToken op_token, NovaToken start, NovaExpr *left, NovaExpr *right) {
+    NovaExpr *expr = nova_expr_new(NOVA_EXPR_OPERATOR, start);
+    expr->as.op.op = op;
+    expr->as.op.op_token = op_token;
+    expr->as.op.left = left;
+    expr->as.op.right = right;
+    return expr;
+}
+
+static NovaExpr *parse_unary_operator(NovaParser *parser) {
+    if (match(parser, NOVA_TOKEN_MINUS) || match(parser, NOVA_TOKEN_NOT)) {
+        NovaToken op_token = previous(parser);
+        NovaExpr *operand = parse_unary_operator(parser);
+        NovaOperator op = op_token.type == NOVA_TOKEN_MINUS ? NOVA_OP_NEG : NOVA_OP_NOT;
+        return operator_expr(op, op_token, op_token, operand, NULL);
+    }
+    return parse_call_expr(parser);
+}
+
+// Precedence climbing: each operand binds everything tighter than the
+// operator to its left.
+static NovaExpr *parse_binary_expr(NovaParser *parser, int min_precedence) {
+    NovaExpr *left = parse_unary_operator(parser);
+    while (true) {
+        NovaOperator op;
+        int precedence = binary_precedence(peek(parser).type, &op);
+        if (precedence == 0 || precedence < min_precedence) {
+            break;
+        }
+        NovaToken op_token = advance(parser);
+        NovaExpr *right = parse_binary_expr(parser, precedence + 1);
+        left = operator_expr(op, op_token, left ? left->start_token : op_token, left, right);
+    }
+    return left;
+}
+
 static NovaExpr *parse_pipe_expr(NovaParser *parser) {
-    NovaExpr *left = parse_call_expr(parser);
+    NovaExpr *left = parse_binary_expr(parser, 1);
     if (!match(parser, NOVA_TOKEN_PIPE_OPERATOR)) {
         return left;
     }
@@ -340,28 +420,65 @@ static NovaExpr *parse_unary_or_pipe(NovaParser *parser) {
     return parse_pipe_expr(parser);
 }
 
+static NovaPattern *parse_pattern(NovaParser *parser) {
+    NovaToken token = peek(parser);
+    if (match(parser, NOVA_TOKEN_NUMBER) || match(parser, NOVA_TOKEN_STRING) ||
+        match(parser, NOVA_TOKEN_TRUE) || match(parser, NOVA_TOKEN_FALSE)) {
+        NovaPattern *pattern = nova_pattern_new(NOVA_PATTERN_LITERAL, token);
+        if (pattern) {
+            pattern->literal_kind = token.type == NOVA_TOKEN_NUMBER ? NOVA_LITERAL_NUMBER
+                                    : token.type == NOVA_TOKEN_STRING ? NOVA_LITERAL_STRING
+                                                                      : NOVA_LITERAL_BOOL;
+        }
+        return pattern;
+    }
+    token = consume(parser, NOVA_TOKEN_IDENTIFIER, "expected pattern");
+    if (token.type != NOVA_TOKEN_IDENTIFIER) {
+        return nova_pattern_new(NOVA_PATTERN_WILDCARD, token);
+    }
+    if (token.length == 1 && token.lexeme[0] == '_') {
+        return nova_pattern_new(NOVA_PATTERN_WILDCARD, token);
+    }
+    if (!match(parser, NOVA_TOKEN_LPAREN)) {
+        return nova_pattern_new(NOVA_PATTERN_NAME, token);
+    }
+    NovaPattern *pattern = nova_pattern_new(NOVA_PATTERN_CONSTRUCTOR, token);
+    if (!check(parser, NOVA_TOKEN_RPAREN)) {
+        do {
+            NovaPattern *arg = parse_pattern(parser);
+            if (pattern && arg) {
+                nova_pattern_list_push(&pattern->args, arg);
+            } else {
+                nova_pattern_free(arg);
+            }
+        } while (match(parser, NOVA_TOKEN_COMMA));
+    }
+    consume(parser, NOVA_TOKEN_RPAREN, "expected ')' after constructor pattern");
+    return pattern;
+}
+
 static NovaExpr *parse_match_expr(NovaParser *parser, NovaToken start) {
     NovaExpr *expr = nova_expr_new(NOVA_EXPR_MATCH, start);
     expr->as.match_expr.scrutinee = parse_expression(parser);
     consume(parser, NOVA_TOKEN_LBRACE, "expected '{' after match expression");
     nova_match_arm_list_init(&expr->as.match_expr.arms);
     while (!check(parser, NOVA_TOKEN_RBRACE) && !is_at_end(parser)) {
-        NovaToken constructor = consume(parser, NOVA_TOKEN_IDENTIFIER, "expected pattern constructor");
-        NovaParamList bindings;
-        nova_param_list_init(&bindings);
-        if (match(parser, NOVA_TOKEN_LPAREN)) {
-            bindings = parse_param_list(parser, NOVA_TOKEN_RPAREN);
+        size_t arm_start = parser->current;
+        NovaMatchArm arm;
+        arm.pattern = parse_pattern(parser);
+        arm.guard = NULL;
+        if (match(parser, NOVA_TOKEN_IF)) {
+            arm.guard = parse_expression(parser);
         }
         consume(parser, NOVA_TOKEN_ARROW, "expected '->' after match arm");
-        NovaExpr *body = parse_expression(parser);
-        NovaMatchArm arm;
-        arm.name = constructor;
-        arm.bindings = bindings;
-        arm.body = body;
+        arm.body = parse_expression(parser);
         nova_match_arm_list_push(&expr->as.match_expr.arms, arm);
         if (!match(parser, NOVA_TOKEN_SEMICOLON)) {
             // implicit separator: continue when encountering next identifier or closing brace
         }
+        if (parser->current == arm_start) {
+            advance(parser);
+        }
     }
     consume(parser, NOVA_TOKEN_RBRACE, "expected '}' to close match");
     return expr;
@@ -408,19 +525,50 @@ static NovaExpr *parse_expression(NovaParser *parser) {
     return parse_unary_or_pipe(parser);
 }
 
-static NovaExpr *parse_block_expression(NovaParser *parser) {
-    NovaToken start = consume(parser, NOVA_TOKEN_LBRACE, "expected '{'");
-    NovaExpr *expr = nova_expr_new(NOVA_EXPR_BLOCK, start);
-    nova_expr_list_init(&expr->as.block.expressions);
+static NovaExpr *parse_local_let(NovaParser *parser);
+
+// Reads block items up to, but not including, the closing brace.
+static void parse_block_items(NovaParser *parser, NovaExprList *items) {
     while (!check(parser, NOVA_TOKEN_RBRACE) && !is_at_end(parser)) {
+        if (check(parser, NOVA_TOKEN_LET)) {
+            nova_expr_list_push(items, parse_local_let(parser));
+            return;
+        }
         NovaExpr *item = parse_expression(parser);
-        nova_expr_list_push(&expr->as.block.expressions, item);
+        nova_expr_list_push(items, item);
         if (!match(parser, NOVA_TOKEN_SEMICOLON)) {
             if (check(parser, NOVA_TOKEN_RBRACE)) {
                 break;
             }
         }
     }
+}
+
+// `let pattern = value; rest` inside a block is a single-arm match whose arm
+// body is the rest of the block, so the names it binds scope over what follows.
+static NovaExpr *parse_local_let(NovaParser *parser) {
+    NovaToken start = consume(parser, NOVA_TOKEN_LET, "expected 'let'");
+    NovaMatchArm arm;
+    arm.pattern = parse_pattern(parser);
+    arm.guard = NULL;
+    consume(parser, NOVA_TOKEN_EQUAL, "expected '=' in let binding");
+    NovaExpr *expr = nova_expr_new(NOVA_EXPR_MATCH, start);
+    expr->as.match_expr.scrutinee = parse_expression(parser);
+    expr->as.match_expr.is_let = true;
+    match(parser, NOVA_TOKEN_SEMICOLON);
+    arm.body = nova_expr_new(NOVA_EXPR_BLOCK, peek(parser));
+    nova_expr_list_init(&arm.body->as.block.expressions);
+    parse_block_items(parser, &arm.body->as.block.expressions);
+    nova_match_arm_list_init(&expr->as.match_expr.arms);
+    nova_match_arm_list_push(&expr->as.match_expr.arms, arm);
+    return expr;
+}
+
+static NovaExpr *parse_block_expression(NovaParser *parser) {
+    NovaToken start = consume(parser, NOVA_TOKEN_LBRACE, "expected '{'");
+    NovaExpr *expr = nova_expr_new(NOVA_EXPR_BLOCK, start);
+    nova_expr_list_init(&expr->as.block.expressions);
+    parse_block_items(parser, &expr->as.block.expressions);
     consume(parser, NOVA_TOKEN_RBRACE, "expected '}' to close block");
     return expr;
 }
@@ -501,7 +649,7 @@ static NovaLetDecl parse_let_decl(NovaParser *parser) {
     decl.has_type = false;
     if (match(parser, NOVA_TOKEN_COLON)) {
         decl.has_type = true;
-        decl.type_name = consume(parser, NOVA_TOKEN_IDENTIFIER, "expected type name");
+        decl.type_name = parse_type_name(parser, "expected type name");
     }
     consume(parser, NOVA_TOKEN_EQUAL, "expected '=' in let declaration");
     decl.value = parse_expression(parser);
@@ -518,7 +666,7 @@ static NovaFunDecl parse_fun_decl(NovaParser *parser) {
     decl.has_return_type = false;
     if (match(parser, NOVA_TOKEN_COLON)) {
         decl.has_return_type = true;
-        decl.return_type = consume(parser, NOVA_TOKEN_IDENTIFIER, "expected return type");
+        decl.return_type = parse_type_name(parser, "expected return type");
     }
     consume(parser, NOVA_TOKEN_EQUAL, "expected '=' before function body");
     decl.body = parse_expression(parser);
@@ -538,6 +686,14 @@ static NovaTypeDecl parse_type_decl(NovaParser *parser) {
     } else if (match(parser, NOVA_TOKEN_LPAREN)) {
         decl.kind = NOVA_TYPE_DECL_TUPLE;
         decl.tuple_fields = parse_param_list(parser, NOVA_TOKEN_RPAREN);
+        // The tuple's constructor shares the type's name and takes its fields in order.
+        NovaVariantDecl constructor;
+        constructor.name = decl.name;
+        nova_param_list_init(&constructor.payload);
+        for (size_t i = 0; i < decl.tuple_fields.count; ++i) {
+            nova_param_list_push(&constructor.payload, decl.tuple_fields.items[i]);
+        }
+        nova_variant_list_push(&decl.variants, constructor);
     } else {
         parser_error(parser, peek(parser), "expected '=' or '(' after type name");
     }
@@ -0,0 +1,213 @@
+#include "nova/profile.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A branch is hinted once it has been seen this often and went the same way
+// in at least NOVA_PROFILE_BIAS_PERCENT of the samples.
+#define NOVA_PROFILE_MIN_SAMPLES 16
+#define NOVA_PROFILE_BIAS_PERCENT 90
+
+typedef struct {
+    const char *name; // points into the profile text
+    size_t ordinal; // branch records only
+    uint64_t counts[2]; // calls and branch sites, or taken and not taken
+    bool stale; // function records only: runs disagree on the number of branch sites
+} ProfileRecord;
+
+typedef struct {
+    ProfileRecord *items;
+    size_t count;
+    size_t capacity;
+} ProfileRecords;
+
+static bool records_push(ProfileRecords *records, const ProfileRecord *record) {
+    if (records->count == records->capacity) {
+        size_t capacity = records->capacity ? records->capacity * 2 : 64;
+        ProfileRecord *items = static_cast<ProfileRecord *>(realloc(records->items, capacity * sizeof(ProfileRecord)));
+        if (!items) return false;
+        records->items = items;
+        records->capacity = capacity;
+    }
+    records->items[records->count++] = *record;
+    return true;
+}
+
+static int compare_records(const void *a, const void *b) {
+    const ProfileRecord *left = static_cast<const ProfileRecord *>(a);
+    const ProfileRecord *right = static_cast<const ProfileRecord *>(b);
+    int order = strcmp(left->name, right->name);
+    if (order != 0) return order;
+    return left->ordinal < right->ordinal ? -1 : left->ordinal > right->ordinal;
+}
+
+// Every run appends its own records, so equal keys are summed into one.
+// Function records whose branch site counts disagree are stale.
+static void records_merge(ProfileRecords *records, bool functions) {
+    if (records->count == 0) return;
+    qsort(records->items, records->count, sizeof(ProfileRecord), compare_records);
+    size_t kept = 0;
+    for (size_t i = 1; i < records->count; ++i) {
+        ProfileRecord *last = &records->items[kept];
+        const ProfileRecord *next = &records->items[i];
+        if (compare_records(last, next) != 0) {
+            records->items[++kept] = *next;
+        } else if (functions) {
+            last->counts[0] += next->counts[0];
+            if (last->counts[1] != next->counts[1]) last->stale = true;
+        } else {
+            last->counts[0] += next->counts[0];
+            last->counts[1] += next->counts[1];
+        }
+    }
+    records->count = kept + 1;
+}
+
+static ProfileRecord *records_find(const ProfileRecords *records, const char *name, size_t name_length, size_t ordinal) {
+    char buffer[256];
+    if (name_length >= sizeof(buffer)) return NULL;
+    memcpy(buffer, name, name_length);
+    buffer[name_length] = '\0';
+    ProfileRecord key = {buffer, ordinal, {0, 0}, false};
+    return static_cast<ProfileRecord *>(bsearch(&key, records->items, records->count, sizeof(ProfileRecord), compare_records));
+}
+
+static char *read_profile(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) return NULL;
+    size_t length = 0;
+    size_t capacity = 4096;
+    char *text = static_cast<char *>(malloc(capacity));
+    while (text) {
+        length += fread(text + length, 1, capacity - length - 1, file);
+        if (length + 1 < capacity) break;
+        capacity *= 2;
+        char *grown = static_cast<char *>(realloc(text, capacity));
+        if (!grown) free(text);
+        text = grown;
+    }
+    bool failed = ferror(file) != 0;
+    fclose(file);
+    if (!text || failed) {
+        free(text);
+        return NULL;
+    }
+    text[length] = '\0';
+    return text;
+}
+
+// Splits text into records in place; returns the 1-based number of the first
+// malformed line, or 0.
+static size_t parse_profile(char *text, ProfileRecords *functions, ProfileRecords *branches, bool *out_of_memory) {
+    size_t line_number = 0;
+    char *save = NULL;
+    for (char *line = strtok_r(text, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+        line_number++;
+        char *fields[5];
+        size_t field_count = 0;
+        char *field_save = NULL;
+        for (char *field = strtok_r(line, " \t\r", &field_save); field && field_count < 5; field = strtok_r(NULL, " \t\r", &field_save)) {
+            fields[field_count++] = field;
+        }
+        if (field_count == 0) continue;
+        bool branch = strcmp(fields[0], "branch") == 0;
+        if (field_count != (branch ? 5u : 4u) || (!branch && strcmp(fields[0], "function") != 0)) return line_number;
+        uint64_t numbers[3];
+        for (size_t i = 2; i < field_count; ++i) {
+            char *end = NULL;
+            numbers[i - 2] = strtoull(fields[i], &end, 10);
+            if (end == fields[i] || *end != '\0') return line_number;
+        }
+        ProfileRecord record = {fields[1], branch ? (size_t)numbers[0] : 0, {numbers[branch ? 1 : 0], numbers[branch ? 2 : 1]}, false};
+        if (!records_push(branch ? branches : functions, &record)) {
+            *out_of_memory = true;
+            return 0;
+        }
+    }
+    return 0;
+}
+
+typedef struct {
+    const NovaIRProgram *program;
+    const ProfileRecords *branches;
+    NovaIRFunction *fn;
+} HintContext;
+
+static void apply_hints(NovaIRExpr **slot, void *ctx) {
+    HintContext *hints = static_cast<HintContext *>(ctx);
+    NovaIRExpr *expr = *slot;
+    if (!expr) return;
+    if (expr->kind == NOVA_IR_EXPR_IF && expr->as.if_expr.site > 0) {
+        const NovaIRBranchSite *site = &hints->program->branch_sites[expr->as.if_expr.site - 1];
+        const ProfileRecord *branch = records_find(hints->branches, site->function.lexeme, site->function.length, site->ordinal);
+        if (branch) {
+            uint64_t samples = branch->counts[0] + branch->counts[1];
+            // A function without calls of its own may still run inlined; its
+            // branches show how often.
+            if (samples > hints->fn->profile_calls) hints->fn->profile_calls = samples;
+            if (samples >= NOVA_PROFILE_MIN_SAMPLES && branch->counts[0] * 100 >= samples * NOVA_PROFILE_BIAS_PERCENT) {
+                expr->as.if_expr.hint = NOVA_IR_BRANCH_LIKELY;
+            } else if (samples >= NOVA_PROFILE_MIN_SAMPLES && branch->counts[1] * 100 >= samples * NOVA_PROFILE_BIAS_PERCENT) {
+                expr->as.if_expr.hint = NOVA_IR_BRANCH_UNLIKELY;
+            }
+        }
+    }
+    nova_ir_expr_for_each_child(expr, apply_hints, ctx);
+}
+
+static void count_sites(NovaIRExpr **slot, void *ctx) {
+    NovaIRExpr *expr = *slot;
+    if (!expr) return;
+    if (expr->kind == NOVA_IR_EXPR_IF && expr->as.if_expr.site > 0) ++*static_cast<size_t *>(ctx);
+    nova_ir_expr_for_each_child(expr, count_sites, ctx);
+}
+
+bool nova_profile_apply(NovaIRProgram *program, const char *directory, char *error_buffer, size_t error_buffer_size) {
+    if (!program || !directory) return false;
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", directory, NOVA_PROFILE_FILE);
+    char *text = read_profile(path);
+    if (!text) {
+        if (error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "cannot read profile %s", path);
+        return false;
+    }
+    ProfileRecords functions = {NULL, 0, 0};
+    ProfileRecords branches = {NULL, 0, 0};
+    bool out_of_memory = false;
+    size_t malformed = parse_profile(text, &functions, &branches, &out_of_memory);
+    if (malformed > 0 || out_of_memory) {
+        if (error_buffer && error_buffer_size > 0) {
+            if (out_of_memory) {
+                snprintf(error_buffer, error_buffer_size, "out of memory");
+            } else {
+                snprintf(error_buffer, error_buffer_size, "%s:%zu: malformed profile record", path, malformed);
+            }
+        }
+        free(functions.items);
+        free(branches.items);
+        free(text);
+        return false;
+    }
+    records_merge(&functions, true);
+    records_merge(&branches, false);
+    HintContext hints = {program, &branches, NULL};
+    for (size_t i = 0; i < program->function_count; ++i) {
+        NovaIRFunction *fn = &program->functions[i];
+        const ProfileRecord *function = records_find(&functions, fn->name.lexeme, fn->name.length, 0);
+        size_t sites = 0;
+        count_sites(&fn->body, &sites);
+        // A profile taken before the function gained or lost a branch no
+        // longer lines up with it.
+        if (!function || function->stale || function->counts[1] != sites) continue;
+        fn->profile_calls = function->counts[0];
+        hints.fn = fn;
+        apply_hints(&fn->body, &hints);
+    }
+    program->profiled = true;
+    free(functions.items);
+    free(branches.items);
+    free(text);
+    return true;
+}
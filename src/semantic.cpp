@@ -1,5 +1,11 @@
 #include "nova/semantic.h"
 
+#include "nova/layout.h"
+#include "nova/match.h"
+#include "nova/numconv.h"
+
+#include <ctype.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
@@ -224,7 +230,11 @@ static void type_record_list_init(NovaTypeRecordList *list) {
 
 static void type_record_list_free(NovaTypeRecordList *list) {
     for (size_t i = 0; i < list->count; ++i) {
+        for (size_t v = 0; v < list->items[i].variant_count; ++v) {
+            free(list->items[i].variants[v].payload_types);
+        }
         free(list->items[i].variants);
+        nova_layout_free(list->items[i].layout);
     }
     free(list->items);
     list->items = NULL;
@@ -247,6 +257,7 @@ static NovaTypeRecord *type_record_add(NovaTypeRecordList *list, const NovaTypeD
     record->type_id = 0;
     record->variants = NULL;
     record->variant_count = 0;
+    record->layout = NULL;
     return record;
 }
 
@@ -277,11 +288,80 @@ static const NovaTypeRecord *type_record_find(const NovaSemanticContext *ctx, co
     return NULL;
 }
 
+static NovaTypeId type_list(NovaSemanticContext *ctx, NovaTypeId element);
+static NovaTypeId type_map(NovaSemanticContext *ctx, NovaTypeId key, NovaTypeId value);
+
+static void trim_token(NovaToken *token) {
+    while (token->length > 0 && isspace((unsigned char)token->lexeme[0])) {
+        token->lexeme++;
+        token->length--;
+    }
+    while (token->length > 0 && isspace((unsigned char)token->lexeme[token->length - 1])) token->length--;
+}
+
+// The parser hands an annotation such as `List[Number]` over as one token.
+bool nova_semantic_split_type_argument(const NovaToken *token, NovaToken *name, NovaToken *argument) {
+    const char *open = static_cast<const char *>(memchr(token->lexeme, '[', token->length));
+    if (!open) return false;
+    *name = *token;
+    name->length = (size_t)(open - token->lexeme);
+    while (name->length > 0 && isspace((unsigned char)name->lexeme[name->length - 1])) name->length--;
+    *argument = *token;
+    argument->lexeme = open + 1;
+    argument->length = token->length - (size_t)(argument->lexeme - token->lexeme) - 1; // drops the closing ']'
+    trim_token(argument);
+    return true;
+}
+
+bool nova_semantic_split_type_pair(const NovaToken *arguments, NovaToken *first, NovaToken *second) {
+    int depth = 0;
+    for (size_t i = 0; i < arguments->length; ++i) {
+        char c = arguments->lexeme[i];
+        if (c == '[') depth++;
+        if (c == ']') depth--;
+        if (c != ',' || depth != 0) continue;
+        *first = *arguments;
+        first->length = i;
+        *second = *arguments;
+        second->lexeme = arguments->lexeme + i + 1;
+        second->length = arguments->length - i - 1;
+        trim_token(first);
+        trim_token(second);
+        return true;
+    }
+    return false;
+}
+
 static NovaTypeId resolve_type_token(NovaSemanticContext *ctx, const NovaToken *token) {
     if (!token || token->type == NOVA_TOKEN_ERROR) {
         return ctx->type_unknown;
     }
+    NovaToken name, argument;
+    if (nova_semantic_split_type_argument(token, &name, &argument)) {
+        NovaToken key, value;
+        if (token_equals_cstr(&name, "Map")) {
+            if (!nova_semantic_split_type_pair(&argument, &key, &value)) {
+                diagnostics_error(ctx, name, "Map expects a key type and a value type");
+                return ctx->type_unknown;
+            }
+            NovaTypeId key_type = resolve_type_token(ctx, &key);
+            NovaTypeId value_type = resolve_type_token(ctx, &value);
+            if (key_type == ctx->type_unknown || value_type == ctx->type_unknown) return ctx->type_unknown;
+            if (key_type != ctx->type_int && key_type != ctx->type_string) {
+                diagnostics_error(ctx, key, "map keys must be Int or String");
+                return ctx->type_unknown;
+            }
+            return type_map(ctx, key_type, value_type);
+        }
+        if (!token_equals_cstr(&name, "List") || nova_semantic_split_type_pair(&argument, &key, &value)) {
+            diagnostics_error(ctx, name, "unknown generic type name");
+            return ctx->type_unknown;
+        }
+        NovaTypeId element = resolve_type_token(ctx, &argument);
+        return element == ctx->type_unknown ? element : type_list(ctx, element);
+    }
     if (token_equals_cstr(token, "Number")) return ctx->type_number;
+    if (token_equals_cstr(token, "Int")) return ctx->type_int;
     if (token_equals_cstr(token, "String")) return ctx->type_string;
     if (token_equals_cstr(token, "Bool")) return ctx->type_bool;
     if (token_equals_cstr(token, "Unit")) return ctx->type_unit;
@@ -293,13 +373,42 @@ static NovaTypeId resolve_type_token(NovaSemanticContext *ctx, const NovaToken *
     return ctx->type_unknown;
 }
 
+NovaTypeId nova_semantic_list_type(const NovaSemanticContext *ctx, NovaTypeId element) {
+    for (NovaTypeId id = 0; id < ctx->type_count; ++id) {
+        if (ctx->types[id].kind == NOVA_TYPE_KIND_LIST && ctx->types[id].as.list.element == element) return id;
+    }
+    return ctx->type_unknown;
+}
+
+// List types are interned, so two lists of the same element type share an id.
 static NovaTypeId type_list(NovaSemanticContext *ctx, NovaTypeId element) {
+    NovaTypeId existing = nova_semantic_list_type(ctx, element);
+    if (existing != ctx->type_unknown) return existing;
     NovaTypeInfo info;
     info.kind = NOVA_TYPE_KIND_LIST;
     info.as.list.element = element;
     return type_pool_add(ctx, info);
 }
 
+NovaTypeId nova_semantic_map_type(const NovaSemanticContext *ctx, NovaTypeId key, NovaTypeId value) {
+    for (NovaTypeId id = 0; id < ctx->type_count; ++id) {
+        const NovaTypeInfo *info = &ctx->types[id];
+        if (info->kind == NOVA_TYPE_KIND_MAP && info->as.map.key == key && info->as.map.value == value) return id;
+    }
+    return ctx->type_unknown;
+}
+
+// Interned like list types.
+static NovaTypeId type_map(NovaSemanticContext *ctx, NovaTypeId key, NovaTypeId value) {
+    NovaTypeId existing = nova_semantic_map_type(ctx, key, value);
+    if (existing != ctx->type_unknown) return existing;
+    NovaTypeInfo info;
+    info.kind = NOVA_TYPE_KIND_MAP;
+    info.as.map.key = key;
+    info.as.map.value = value;
+    return type_pool_add(ctx, info);
+}
+
 static NovaTypeId type_function(NovaSemanticContext *ctx, const NovaTypeId *params, size_t param_count, NovaTypeId result, NovaEffectMask effects) {
     NovaTypeInfo info;
     info.kind = NOVA_TYPE_KIND_FUNCTION;
@@ -330,68 +439,116 @@ static NovaTypeId unify_types(NovaSemanticContext *ctx, NovaTypeId a, NovaTypeId
     if (a == ctx->type_unknown) return b;
     if (b == ctx->type_unknown) return a;
     if (a == b) return a;
+    // Every lambda and function gets its own type record; signatures compare structurally.
+    const NovaTypeInfo *fa = &ctx->types[a];
+    const NovaTypeInfo *fb = &ctx->types[b];
+    if (fa->kind == NOVA_TYPE_KIND_FUNCTION && fb->kind == NOVA_TYPE_KIND_FUNCTION &&
+        fa->as.function.param_count == fb->as.function.param_count && fa->as.function.result == fb->as.function.result &&
+        (fa->as.function.param_count == 0 ||
+         memcmp(fa->as.function.params, fb->as.function.params, fa->as.function.param_count * sizeof(NovaTypeId)) == 0)) {
+        return a;
+    }
+    // An empty literal's element type is unknown until it meets another list.
+    if (fa->kind == NOVA_TYPE_KIND_LIST && fb->kind == NOVA_TYPE_KIND_LIST) {
+        NovaTypeId element = unify_types(ctx, fa->as.list.element, fb->as.list.element, at_token);
+        return element == ctx->type_unknown ? a : type_list(ctx, element);
+    }
+    // Likewise for `Map()` until it meets a map whose types are known.
+    if (fa->kind == NOVA_TYPE_KIND_MAP && fb->kind == NOVA_TYPE_KIND_MAP) {
+        NovaTypeId value_a = fa->as.map.value, value_b = fb->as.map.value; // unifying may grow the type pool
+        NovaTypeId key = unify_types(ctx, fa->as.map.key, fb->as.map.key, at_token);
+        NovaTypeId value = unify_types(ctx, value_a, value_b, at_token);
+        return type_map(ctx, key, value);
+    }
     diagnostics_error(ctx, at_token, "type mismatch");
     return ctx->type_unknown;
 }
 
-static void register_type_decl(NovaSemanticContext *ctx, const NovaTypeDecl *decl) {
+// Payload fields are written either as bare types (`Some(Number)`) or as
+// named fields (`Some(value: Number)`).
+static NovaTypeId payload_type(NovaSemanticContext *ctx, const NovaParam *field) {
+    return resolve_type_token(ctx, field->has_type ? &field->type_name : &field->name);
+}
+
+static void declare_type_decl(NovaSemanticContext *ctx, const NovaTypeDecl *decl) {
     NovaTypeRecord *record = type_record_add(&ctx->type_records, decl);
     if (!record) return;
     record->type_id = type_custom(ctx, record);
-    ctx->types[record->type_id].as.custom.record = record;
-    if (decl->kind == NOVA_TYPE_DECL_SUM) {
-        record->variant_count = decl->variants.count;
-        record->variants = static_cast<NovaVariantRecord *>(calloc(record->variant_count, sizeof(*record->variants)));
-        for (size_t i = 0; i < decl->variants.count; ++i) {
-            const NovaVariantDecl *variant = &decl->variants.items[i];
-            record->variants[i].variant = variant;
-            record->variants[i].arity = variant->payload.count;
-            if (variant->payload.count > 0) {
-                NovaTypeId *params = static_cast<NovaTypeId *>(malloc((variant->payload.count) * sizeof(NovaTypeId)));
-                for (size_t p = 0; p < variant->payload.count; ++p) {
-                    NovaTypeId param_type = ctx->type_unknown;
-                    if (variant->payload.items[p].has_type) {
-                        param_type = resolve_type_token(ctx, &variant->payload.items[p].type_name);
-                    }
-                    params[p] = param_type;
-                }
-                NovaTypeId fn_type = type_function(ctx, params, variant->payload.count, record->type_id, NOVA_EFFECT_NONE);
-                free(params);
-                NovaScopeEntry entry = scope_entry_make(variant->name, fn_type, NOVA_EFFECT_NONE);
-                entry.is_constructor = true;
-                entry.type_record = record;
-                entry.variant_decl = variant;
-                scope_define(ctx, ctx->scope, entry);
-            } else {
-                NovaScopeEntry entry = scope_entry_make(variant->name, record->type_id, NOVA_EFFECT_NONE);
-                entry.is_constructor = true;
-                entry.type_record = record;
-                entry.variant_decl = variant;
-                scope_define(ctx, ctx->scope, entry);
+    // Growing the record list moves earlier records; keep the type pool pointing at them.
+    for (size_t i = 0; i < ctx->type_records.count; ++i) {
+        const NovaTypeRecord *item = &ctx->type_records.items[i];
+        ctx->types[item->type_id].as.custom.record = item;
+    }
+}
+
+// Runs once every type is declared, so payloads may name types declared later.
+static void register_type_decl(NovaSemanticContext *ctx, NovaTypeRecord *record) {
+    const NovaTypeDecl *decl = record->decl;
+    // A tuple type registers like a sum type with a single variant, so its
+    // fields may likewise be bare types.
+    if (decl->kind == NOVA_TYPE_DECL_TUPLE && decl->tuple_fields.count == 0) {
+        diagnostics_warning(ctx, decl->name, "tuple type has no fields");
+    }
+    record->variant_count = decl->variants.count;
+    record->variants = static_cast<NovaVariantRecord *>(calloc(record->variant_count, sizeof(*record->variants)));
+    for (size_t i = 0; i < decl->variants.count; ++i) {
+        const NovaVariantDecl *variant = &decl->variants.items[i];
+        record->variants[i].variant = variant;
+        record->variants[i].arity = variant->payload.count;
+        if (variant->payload.count > 0) {
+            NovaTypeId *params = static_cast<NovaTypeId *>(malloc((variant->payload.count) * sizeof(NovaTypeId)));
+            for (size_t p = 0; p < variant->payload.count; ++p) {
+                params[p] = payload_type(ctx, &variant->payload.items[p]);
             }
-        }
-    } else {
-        if (decl->tuple_fields.count == 0) {
-            diagnostics_warning(ctx, decl->name, "tuple type has no fields");
+            NovaTypeId fn_type = type_function(ctx, params, variant->payload.count, record->type_id, NOVA_EFFECT_NONE);
+            record->variants[i].payload_types = params;
+            NovaScopeEntry entry = scope_entry_make(variant->name, fn_type, NOVA_EFFECT_NONE);
+            entry.is_constructor = true;
+            entry.type_record = record;
+            entry.variant_decl = variant;
+            scope_define(ctx, ctx->scope, entry);
         } else {
-            for (size_t i = 0; i < decl->tuple_fields.count; ++i) {
-                if (!decl->tuple_fields.items[i].has_type) {
-                    diagnostics_warning(ctx, decl->tuple_fields.items[i].name, "tuple field missing type annotation");
-                }
-            }
+            NovaScopeEntry entry = scope_entry_make(variant->name, record->type_id, NOVA_EFFECT_NONE);
+            entry.is_constructor = true;
+            entry.type_record = record;
+            entry.variant_decl = variant;
+            scope_define(ctx, ctx->scope, entry);
         }
     }
 }
 
 static NovaTypeId analyze_expr(NovaSemanticContext *ctx, NovaScope *scope, const NovaExpr *expr, NovaEffectMask *out_effects);
 
-static NovaTypeId analyze_block(NovaSemanticContext *ctx, NovaScope *scope, const NovaExpr *expr, NovaEffectMask *out_effects) {
+// Analyses expr where a value of type expected is wanted. The expectation only
+// decides how integral literals are typed; mismatches are still reported by
+// the caller, so it is never an error on its own.
+static NovaTypeId analyze_expected(NovaSemanticContext *ctx, NovaScope *scope, const NovaExpr *expr, NovaTypeId expected, NovaEffectMask *out_effects) {
+    ctx->expected_type = expected;
+    return analyze_expr(ctx, scope, expr, out_effects);
+}
+
+// Looks through parentheses and negation, so `-17` and `(-17)` count.
+static bool is_integral_literal(const NovaExpr *expr) {
+    while (expr && (expr->kind == NOVA_EXPR_PAREN || (expr->kind == NOVA_EXPR_OPERATOR && expr->as.op.op == NOVA_OP_NEG))) {
+        expr = expr->kind == NOVA_EXPR_PAREN ? expr->as.inner : expr->as.op.left;
+    }
+    return expr && expr->kind == NOVA_EXPR_LITERAL && expr->as.literal.kind == NOVA_LITERAL_NUMBER &&
+           !memchr(expr->as.literal.token.lexeme, '.', expr->as.literal.token.length);
+}
+
+static bool integral_literal_fits(const NovaToken *token) {
+    int64_t value;
+    return nova_integer_parse(token->lexeme, token->length, &value);
+}
+
+static NovaTypeId analyze_block(NovaSemanticContext *ctx, NovaScope *scope, const NovaExpr *expr, NovaTypeId expected, NovaEffectMask *out_effects) {
     NovaScope *inner = scope_push(scope);
     NovaEffectMask effects = NOVA_EFFECT_NONE;
     NovaTypeId type = ctx->type_unit;
     for (size_t i = 0; i < expr->as.block.expressions.count; ++i) {
         NovaEffectMask expr_effects = NOVA_EFFECT_NONE;
-        type = analyze_expr(ctx, inner, expr->as.block.expressions.items[i], &expr_effects);
+        bool last = i + 1 == expr->as.block.expressions.count;
+        type = analyze_expected(ctx, inner, expr->as.block.expressions.items[i], last ? expected : ctx->type_unknown, &expr_effects);
         effects = effect_or(effects, expr_effects);
     }
     scope_free(inner);
@@ -400,13 +557,21 @@ static NovaTypeId analyze_block(NovaSemanticContext *ctx, NovaScope *scope, cons
     return type;
 }
 
-static NovaTypeId analyze_literal(NovaSemanticContext *ctx, NovaScope *scope, const NovaExpr *expr, NovaEffectMask *out_effects) {
+// An integral literal is an Int only where an Int is expected; everywhere
+// else literals stay Numbers, as they were before Int existed.
+static NovaTypeId analyze_literal(NovaSemanticContext *ctx, NovaScope *scope, const NovaExpr *expr, NovaTypeId expected, NovaEffectMask *out_effects) {
     (void)scope;
     NovaEffectMask effects = NOVA_EFFECT_NONE;
     NovaTypeId type = ctx->type_unknown;
     switch (expr->as.literal.kind) {
     case NOVA_LITERAL_NUMBER:
         type = ctx->type_number;
+        if (expected == ctx->type_int && is_integral_literal(expr)) {
+            type = ctx->type_int;
+            if (!integral_literal_fits(&expr->as.literal.token)) {
+                diagnostics_error(ctx, expr->as.literal.token, "integer literal out of range for Int");
+            }
+        }
         break;
     case NOVA_LITERAL_STRING:
         type = ctx->type_string;
@@ -419,9 +584,10 @@ static NovaTypeId analyze_literal(NovaSemanticContext *ctx, NovaScope *scope, co
         break;
     case NOVA_LITERAL_LIST: {
         NovaTypeId element = ctx->type_unknown;
+        NovaTypeId expected_element = ctx->types[expected].kind == NOVA_TYPE_KIND_LIST ? ctx->types[expected].as.list.element : ctx->type_unknown;
         for (size_t i = 0; i < expr->as.literal.elements.count; ++i) {
             NovaEffectMask elem_effects = NOVA_EFFECT_NONE;
-            NovaTypeId elem_type = analyze_expr(ctx, scope, expr->as.literal.elements.items[i], &elem_effects);
+            NovaTypeId elem_type = analyze_expected(ctx, scope, expr->as.literal.elements.items[i], expected_element, &elem_effects);
             element = unify_types(ctx, element, elem_type, expr->start_token);
             effects = effect_or(effects, elem_effects);
         }
@@ -446,8 +612,200 @@ static NovaTypeId analyze_identifier(NovaSemanticContext *ctx, NovaScope *scope,
     return entry->type;
 }
 
-static NovaTypeId analyze_call(NovaSemanticContext *ctx, NovaScope *scope, const NovaExpr *expr, NovaEffectMask *out_effects) {
+// Int(x) and Number(x) convert between the numeric types unless a binding
+// of that name shadows them.
+bool nova_semantic_is_conversion(const NovaSemanticContext *ctx, const NovaExpr *callee) {
+    if (!callee || callee->kind != NOVA_EXPR_IDENTIFIER) return false;
+    const NovaToken *name = &callee->as.identifier.name;
+    if (!token_equals_cstr(name, "Int") && !token_equals_cstr(name, "Number")) return false;
+    return !nova_semantic_lookup_expr(ctx, callee);
+}
+
+static NovaTypeId analyze_conversion(NovaSemanticContext *ctx, NovaScope *scope, const NovaExpr *expr, NovaEffectMask *out_effects) {
+    NovaTypeId result = token_equals_cstr(&expr->as.call.callee->as.identifier.name, "Int") ? ctx->type_int : ctx->type_number;
+    NovaEffectMask effects = NOVA_EFFECT_NONE;
+    if (expr->as.call.args.count != 1) {
+        diagnostics_error(ctx, expr->start_token, "conversion expects one argument");
+    }
+    for (size_t i = 0; i < expr->as.call.args.count; ++i) {
+        const NovaExpr *arg = expr->as.call.args.items[i].value;
+        NovaTypeId arg_type = analyze_expr(ctx, scope, arg, &effects);
+        if (arg_type != ctx->type_unknown && arg_type != ctx->type_number && arg_type != ctx->type_int) {
+            diagnostics_error(ctx, arg->start_token, "conversion expects a Number or Int argument");
+        }
+    }
+    expr_info_list_record(ctx, expr, result, effects);
+    merge_effects(out_effects, effects);
+    return result;
+}
+
+static bool is_list_builtin_name(const NovaToken *name) {
+    return token_equals_cstr(name, "length") || token_equals_cstr(name, "get") || token_equals_cstr(name, "push");
+}
+
+// length(xs), get(xs, i) and push(xs, x) work on lists, and length(s) on
+// Strings too, unless a binding of that name shadows them.
+bool nova_semantic_is_list_builtin(const NovaSemanticContext *ctx, const NovaExpr *callee) {
+    if (!callee || callee->kind != NOVA_EXPR_IDENTIFIER || !is_list_builtin_name(&callee->as.identifier.name)) return false;
+    return !nova_semantic_lookup_expr(ctx, callee);
+}
+
+static bool is_map_builtin_name(const NovaToken *name) {
+    return token_equals_cstr(name, "Map") || token_equals_cstr(name, "put") || token_equals_cstr(name, "has") ||
+           token_equals_cstr(name, "remove");
+}
+
+bool nova_semantic_is_map_builtin(const NovaSemanticContext *ctx, const NovaExpr *callee) {
+    if (!callee || callee->kind != NOVA_EXPR_IDENTIFIER || !is_map_builtin_name(&callee->as.identifier.name)) return false;
+    return !nova_semantic_lookup_expr(ctx, callee);
+}
+
+static void check_map_key(NovaSemanticContext *ctx, NovaTypeId key, NovaToken at_token) {
+    if (key != ctx->type_unknown && key != ctx->type_int && key != ctx->type_string) {
+        diagnostics_error(ctx, at_token, "map keys must be Int or String");
+    }
+}
+
+// The key of length(m) and get(m, k) once the operand turned out to be the
+// map type map.
+static NovaTypeId finish_map_access(NovaSemanticContext *ctx, NovaScope *scope, const NovaExpr *expr, NovaTypeId map, NovaEffectMask effects, NovaEffectMask *out_effects) {
+    const NovaArgList *args = &expr->as.call.args;
+    NovaTypeId key = ctx->types[map].as.map.key;
+    NovaTypeId result = ctx->types[map].as.map.value;
+    if (token_equals_cstr(&expr->as.call.callee->as.identifier.name, "length")) {
+        result = ctx->type_int;
+    } else if (args->count > 1) {
+        const NovaExpr *arg = args->items[1].value;
+        unify_types(ctx, key, analyze_expected(ctx, scope, arg, key, &effects), arg->start_token);
+    }
+    expr_info_list_record(ctx, expr, result, effects);
+    merge_effects(out_effects, effects);
+    return result;
+}
+
+// `Map()` is an empty map and `Map(keys, values)` pairs up two lists; put,
+// has and remove take the map first and the key second. Key and value
+// types flow in from the expected type and out of the arguments, so that
+// `put(Map(), "a", 1)` is a Map[String, Int].
+static NovaTypeId analyze_map_builtin(NovaSemanticContext *ctx, NovaScope *scope, const NovaExpr *expr, NovaTypeId expected, NovaEffectMask *out_effects) {
+    const NovaToken *name = &expr->as.call.callee->as.identifier.name;
+    bool build = token_equals_cstr(name, "Map");
+    bool put = token_equals_cstr(name, "put");
+    bool has = token_equals_cstr(name, "has");
+    const NovaArgList *args = &expr->as.call.args;
+    NovaEffectMask effects = NOVA_EFFECT_NONE;
+    if (build ? args->count != 0 && args->count != 2 : args->count != (put ? 3u : 2u)) {
+        diagnostics_error(ctx, expr->start_token, build ? "Map expects no arguments or a list of keys and a list of values" : put ? "put expects three arguments" : "map operation expects two arguments");
+    }
+    NovaTypeId key = ctx->type_unknown;
+    NovaTypeId value = ctx->type_unknown;
+    if (ctx->types[expected].kind == NOVA_TYPE_KIND_MAP && !has) {
+        key = ctx->types[expected].as.map.key;
+        value = ctx->types[expected].as.map.value;
+    }
+    for (size_t i = 0; i < args->count; ++i) {
+        const NovaExpr *arg = args->items[i].value;
+        if (build && i < 2) {
+            NovaTypeId *slot = i == 0 ? &key : &value;
+            NovaTypeId list = analyze_expected(ctx, scope, arg, *slot == ctx->type_unknown ? *slot : type_list(ctx, *slot), &effects);
+            if (list != ctx->type_unknown && ctx->types[list].kind != NOVA_TYPE_KIND_LIST) {
+                diagnostics_error(ctx, arg->start_token, "expected a List argument");
+            } else if (list != ctx->type_unknown) {
+                *slot = unify_types(ctx, *slot, ctx->types[list].as.list.element, arg->start_token);
+            }
+            if (i == 0) check_map_key(ctx, key, arg->start_token);
+        } else if (i == 0) {
+            NovaTypeId expected_map = key == ctx->type_unknown && value == ctx->type_unknown ? ctx->type_unknown : type_map(ctx, key, value);
+            NovaTypeId map = analyze_expected(ctx, scope, arg, expected_map, &effects);
+            if (map != ctx->type_unknown && ctx->types[map].kind != NOVA_TYPE_KIND_MAP) {
+                diagnostics_error(ctx, arg->start_token, "expected a Map argument");
+            } else if (map != ctx->type_unknown) {
+                NovaTypeId map_value = ctx->types[map].as.map.value; // unifying may grow the type pool
+                key = unify_types(ctx, key, ctx->types[map].as.map.key, arg->start_token);
+                value = unify_types(ctx, value, map_value, arg->start_token);
+            }
+        } else if (i == 1) {
+            key = unify_types(ctx, key, analyze_expected(ctx, scope, arg, key, &effects), arg->start_token);
+            check_map_key(ctx, key, arg->start_token);
+        } else {
+            value = unify_types(ctx, value, analyze_expected(ctx, scope, arg, value, &effects), arg->start_token);
+        }
+    }
+    NovaTypeId result = has ? ctx->type_bool : type_map(ctx, key, value);
+    expr_info_list_record(ctx, expr, result, effects);
+    merge_effects(out_effects, effects);
+    return result;
+}
+
+// An expected result type carries over to the list operand, so the
+// literals in `get([1, 2], 0)` are Ints where an Int is wanted.
+static NovaTypeId analyze_list_builtin(NovaSemanticContext *ctx, NovaScope *scope, const NovaExpr *expr, NovaTypeId expected, NovaEffectMask *out_effects) {
+    const NovaToken *name = &expr->as.call.callee->as.identifier.name;
+    bool length = token_equals_cstr(name, "length");
+    bool push = token_equals_cstr(name, "push");
+    const NovaArgList *args = &expr->as.call.args;
+    NovaEffectMask effects = NOVA_EFFECT_NONE;
+    if (args->count != (length ? 1u : 2u)) {
+        diagnostics_error(ctx, expr->start_token, length ? "length expects one argument" : "list operation expects two arguments");
+    }
+    NovaTypeId list = ctx->type_unknown;
+    if (args->count > 0) {
+        const NovaExpr *arg = args->items[0].value;
+        NovaTypeId expected_list = ctx->type_unknown;
+        if (push) {
+            expected_list = expected;
+        } else if (!length && expected != ctx->type_unknown) {
+            expected_list = type_list(ctx, expected);
+        }
+        list = analyze_expected(ctx, scope, arg, expected_list, &effects);
+        if (!push && list != ctx->type_unknown && ctx->types[list].kind == NOVA_TYPE_KIND_MAP) {
+            return finish_map_access(ctx, scope, expr, list, effects, out_effects);
+        }
+        if (length && list == ctx->type_string) {
+            list = ctx->type_unknown;
+        } else if (list != ctx->type_unknown && ctx->types[list].kind != NOVA_TYPE_KIND_LIST) {
+            diagnostics_error(ctx, arg->start_token, "expected a List argument");
+            list = ctx->type_unknown;
+        }
+    }
+    NovaTypeId element = list != ctx->type_unknown ? ctx->types[list].as.list.element : ctx->type_unknown;
+    for (size_t i = 1; i < args->count; ++i) {
+        const NovaExpr *arg = args->items[i].value;
+        if (push) {
+            NovaTypeId value = analyze_expected(ctx, scope, arg, element, &effects);
+            element = unify_types(ctx, element, value, arg->start_token);
+        } else {
+            NovaTypeId index = analyze_expected(ctx, scope, arg, ctx->type_int, &effects);
+            if (index != ctx->type_unknown && index != ctx->type_int) {
+                diagnostics_error(ctx, arg->start_token, "list index must be an Int");
+            }
+        }
+    }
+    NovaTypeId result = element;
+    if (length) {
+        result = ctx->type_int;
+    } else if (push) {
+        result = list == ctx->type_unknown ? list : element == ctx->type_unknown ? list : type_list(ctx, element);
+    }
+    expr_info_list_record(ctx, expr, result, effects);
+    merge_effects(out_effects, effects);
+    return result;
+}
+
+static NovaTypeId analyze_call(NovaSemanticContext *ctx, NovaScope *scope, const NovaExpr *expr, NovaTypeId expected, NovaEffectMask *out_effects) {
     const NovaExpr *callee_expr = expr->as.call.callee;
+    if (callee_expr->kind == NOVA_EXPR_IDENTIFIER && !scope_lookup(scope, &callee_expr->as.identifier.name) &&
+        (token_equals_cstr(&callee_expr->as.identifier.name, "Int") || token_equals_cstr(&callee_expr->as.identifier.name, "Number"))) {
+        return analyze_conversion(ctx, scope, expr, out_effects);
+    }
+    if (callee_expr->kind == NOVA_EXPR_IDENTIFIER && !scope_lookup(scope, &callee_expr->as.identifier.name) &&
+        is_list_builtin_name(&callee_expr->as.identifier.name)) {
+        return analyze_list_builtin(ctx, scope, expr, expected, out_effects);
+    }
+    if (callee_expr->kind == NOVA_EXPR_IDENTIFIER && !scope_lookup(scope, &callee_expr->as.identifier.name) &&
+        is_map_builtin_name(&callee_expr->as.identifier.name)) {
+        return analyze_map_builtin(ctx, scope, expr, expected, out_effects);
+    }
     NovaEffectMask callee_effects = NOVA_EFFECT_NONE;
     NovaTypeId callee_type = analyze_expr(ctx, scope, callee_expr, &callee_effects);
     NovaEffectMask effects = callee_effects;
@@ -464,7 +822,8 @@ static NovaTypeId analyze_call(NovaSemanticContext *ctx, NovaScope *scope, const
     }
     for (size_t i = 0; i < arg_count; ++i) {
         NovaEffectMask arg_effects = NOVA_EFFECT_NONE;
-        NovaTypeId arg_type = analyze_expr(ctx, scope, expr->as.call.args.items[i].value, &arg_effects);
+        NovaTypeId param = i < callee_info.as.function.param_count ? callee_info.as.function.params[i] : ctx->type_unknown;
+        NovaTypeId arg_type = analyze_expected(ctx, scope, expr->as.call.args.items[i].value, param, &arg_effects);
         effects = effect_or(effects, arg_effects);
         if (i < callee_info.as.function.param_count) {
             unify_types(ctx, callee_info.as.function.params[i], arg_type, expr->as.call.args.items[i].value->start_token);
@@ -505,7 +864,8 @@ static NovaTypeId analyze_pipeline(NovaSemanticContext *ctx, NovaScope *scope, c
         unify_types(ctx, callee_info.as.function.params[0], current_type, stage->start_token);
         for (size_t j = 0; j < args.count; ++j) {
             NovaEffectMask arg_effects = NOVA_EFFECT_NONE;
-            NovaTypeId arg_type = analyze_expr(ctx, scope, args.items[j].value, &arg_effects);
+            NovaTypeId param = j + 1 < callee_info.as.function.param_count ? callee_info.as.function.params[j + 1] : ctx->type_unknown;
+            NovaTypeId arg_type = analyze_expected(ctx, scope, args.items[j].value, param, &arg_effects);
             stage_effects = effect_or(stage_effects, arg_effects);
             if (j + 1 < callee_info.as.function.param_count) {
                 unify_types(ctx, callee_info.as.function.params[j + 1], arg_type, args.items[j].value->start_token);
@@ -514,98 +874,126 @@ static NovaTypeId analyze_pipeline(NovaSemanticContext *ctx, NovaScope *scope, c
         stage_effects = effect_or(stage_effects, callee_info.as.function.effects);
         current_type = callee_info.as.function.result;
         total_effects = effect_or(total_effects, stage_effects);
-        expr_info_list_record(ctx, stage, current_type, stage_effects);
+        // A lambda stage keeps its function type, which lowering needs to lift it.
+        if (stage->kind != NOVA_EXPR_LAMBDA) {
+            expr_info_list_record(ctx, stage, current_type, stage_effects);
+        }
     }
     expr_info_list_record(ctx, expr, current_type, total_effects);
     merge_effects(out_effects, total_effects);
     return current_type;
 }
 
-static void check_match_exhaustiveness(NovaSemanticContext *ctx, const NovaExpr *expr, NovaTypeId scrutinee_type) {
-    const NovaTypeInfo *info = &ctx->types[scrutinee_type];
-    if (info->kind != NOVA_TYPE_KIND_CUSTOM || !info->as.custom.record) {
+static void analyze_pattern(NovaSemanticContext *ctx, NovaScope *scope, const NovaPattern *pattern, NovaTypeId type) {
+    if (!pattern) return;
+    switch (pattern->kind) {
+    case NOVA_PATTERN_WILDCARD:
+        return;
+    case NOVA_PATTERN_LITERAL: {
+        NovaTypeId literal_type = pattern->literal_kind == NOVA_LITERAL_NUMBER   ? ctx->type_number
+                                  : pattern->literal_kind == NOVA_LITERAL_STRING ? ctx->type_string
+                                                                                 : ctx->type_bool;
+        if (literal_type == ctx->type_number && type == ctx->type_int && !memchr(pattern->token.lexeme, '.', pattern->token.length)) {
+            literal_type = ctx->type_int;
+            if (!integral_literal_fits(&pattern->token)) {
+                diagnostics_error(ctx, pattern->token, "integer literal out of range for Int");
+            }
+        }
+        if (type != ctx->type_unknown && type != literal_type) {
+            diagnostics_error(ctx, pattern->token, "pattern type does not match the matched value");
+        }
         return;
     }
-    const NovaTypeRecord *record = info->as.custom.record;
-    if (record->variant_count == 0) {
+    case NOVA_PATTERN_NAME:
+    case NOVA_PATTERN_CONSTRUCTOR:
+        break;
+    }
+    const NovaTypeRecord *record = nova_semantic_type_record(ctx, type);
+    size_t tag = nova_semantic_find_variant(record, &pattern->token);
+    if (pattern->kind == NOVA_PATTERN_NAME && tag == SIZE_MAX) {
+        scope_define(ctx, scope, scope_entry_make(pattern->token, type, NOVA_EFFECT_NONE));
         return;
     }
-    bool *seen = static_cast<bool *>(calloc(record->variant_count, sizeof(bool)));
-    size_t covered = 0;
-    for (size_t i = 0; i < expr->as.match_expr.arms.count; ++i) {
-        const NovaMatchArm *arm = &expr->as.match_expr.arms.items[i];
-        for (size_t v = 0; v < record->variant_count; ++v) {
-            if (token_equals(&record->variants[v].variant->name, &arm->name)) {
-                if (!seen[v]) {
-                    seen[v] = true;
-                    covered++;
-                }
-            }
+    if (tag == SIZE_MAX) {
+        if (type != ctx->type_unknown) {
+            diagnostics_error(ctx, pattern->token, "unknown variant in pattern");
+        }
+        for (size_t i = 0; i < pattern->args.count; ++i) {
+            analyze_pattern(ctx, scope, pattern->args.items[i], ctx->type_unknown);
         }
+        return;
+    }
+    const NovaVariantRecord *variant = &record->variants[tag];
+    if (pattern->args.count != variant->arity) {
+        diagnostics_error(ctx, pattern->token, "wrong number of payload patterns for variant");
     }
-    if (covered < record->variant_count) {
-        diagnostics_warning(ctx, expr->start_token, "match expression may be non-exhaustive");
+    for (size_t i = 0; i < pattern->args.count; ++i) {
+        NovaTypeId field_type = i < variant->arity ? variant->payload_types[i] : ctx->type_unknown;
+        analyze_pattern(ctx, scope, pattern->args.items[i], field_type);
     }
-    free(seen);
 }
 
-static NovaTypeId analyze_match(NovaSemanticContext *ctx, NovaScope *scope, const NovaExpr *expr, NovaEffectMask *out_effects) {
+// Exhaustiveness and unreachable arms come from the same decision tree that
+// IR lowering emits.
+static void check_match_coverage(NovaSemanticContext *ctx, const NovaExpr *expr, NovaTypeId scrutinee_type) {
+    if (scrutinee_type == ctx->type_unknown) return;
+    NovaMatchPlan plan;
+    if (!nova_match_compile(ctx, &expr->as.match_expr, scrutinee_type, &plan)) return;
+    if (!plan.exhaustive) {
+        diagnostics_warning(ctx, expr->start_token, expr->as.match_expr.is_let ? "let pattern may not match every value" : "match expression may be non-exhaustive");
+    }
+    for (size_t i = 0; i < plan.arm_count; ++i) {
+        if (!plan.arm_reachable[i]) {
+            diagnostics_warning(ctx, expr->as.match_expr.arms.items[i].pattern->token, "match arm is unreachable");
+        }
+    }
+    nova_match_plan_free(&plan);
+}
+
+static NovaTypeId analyze_match(NovaSemanticContext *ctx, NovaScope *scope, const NovaExpr *expr, NovaTypeId expected, NovaEffectMask *out_effects) {
     NovaEffectMask effects = NOVA_EFFECT_NONE;
     NovaTypeId scrutinee_type = analyze_expr(ctx, scope, expr->as.match_expr.scrutinee, &effects);
     NovaTypeId arm_type = ctx->type_unknown;
+    bool patterns_ok = true;
     for (size_t i = 0; i < expr->as.match_expr.arms.count; ++i) {
         const NovaMatchArm *arm = &expr->as.match_expr.arms.items[i];
         NovaScope *arm_scope = scope_push(scope);
-        if (arm->bindings.count != 0) {
-            const NovaTypeInfo *info = &ctx->types[scrutinee_type];
-            if (info->kind == NOVA_TYPE_KIND_CUSTOM && info->as.custom.record) {
-                const NovaTypeRecord *record = info->as.custom.record;
-                const NovaVariantDecl *variant_decl = NULL;
-                for (size_t v = 0; v < record->variant_count; ++v) {
-                    if (token_equals(&record->variants[v].variant->name, &arm->name)) {
-                        variant_decl = record->variants[v].variant;
-                        break;
-                    }
-                }
-                if (variant_decl && variant_decl->payload.count == arm->bindings.count) {
-                    for (size_t p = 0; p < arm->bindings.count; ++p) {
-                        NovaTypeId bind_type = ctx->type_unknown;
-                        if (variant_decl->payload.items[p].has_type) {
-                            bind_type = resolve_type_token(ctx, &variant_decl->payload.items[p].type_name);
-                        }
-                        scope_define(ctx, arm_scope,
-                                     scope_entry_make(arm->bindings.items[p].name,
-                                                      bind_type,
-                                                      NOVA_EFFECT_NONE));
-                    }
-                }
+        size_t diagnostic_count = ctx->diagnostics.count;
+        analyze_pattern(ctx, arm_scope, arm->pattern, scrutinee_type);
+        if (ctx->diagnostics.count != diagnostic_count) patterns_ok = false;
+        if (arm->guard) {
+            NovaEffectMask guard_effects = NOVA_EFFECT_NONE;
+            NovaTypeId guard_type = analyze_expr(ctx, arm_scope, arm->guard, &guard_effects);
+            if (guard_type != ctx->type_bool && guard_type != ctx->type_unknown) {
+                diagnostics_error(ctx, arm->guard->start_token, "match guard must be Bool");
             }
+            effects = effect_or(effects, guard_effects);
         }
         NovaEffectMask body_effects = NOVA_EFFECT_NONE;
-        NovaTypeId body_type = analyze_expr(ctx, arm_scope, arm->body, &body_effects);
+        NovaTypeId body_type = analyze_expected(ctx, arm_scope, arm->body, expected, &body_effects);
         scope_free(arm_scope);
         effects = effect_or(effects, body_effects);
         arm_type = unify_types(ctx, arm_type, body_type, arm->body->start_token);
     }
-    check_match_exhaustiveness(ctx, expr, scrutinee_type);
+    if (patterns_ok) check_match_coverage(ctx, expr, scrutinee_type);
     expr_info_list_record(ctx, expr, arm_type, effects);
     merge_effects(out_effects, effects);
     return arm_type;
 }
 
-static NovaTypeId analyze_if(NovaSemanticContext *ctx, NovaScope *scope, const NovaExpr *expr, NovaEffectMask *out_effects) {
+static NovaTypeId analyze_if(NovaSemanticContext *ctx, NovaScope *scope, const NovaExpr *expr, NovaTypeId expected, NovaEffectMask *out_effects) {
     NovaEffectMask effects = NOVA_EFFECT_NONE;
     NovaTypeId cond_type = analyze_expr(ctx, scope, expr->as.if_expr.condition, &effects);
     if (cond_type != ctx->type_bool && cond_type != ctx->type_unknown) {
         diagnostics_error(ctx, expr->as.if_expr.condition->start_token, "if condition must be Bool");
     }
     NovaEffectMask then_effects = NOVA_EFFECT_NONE;
-    NovaTypeId then_type = analyze_expr(ctx, scope, expr->as.if_expr.then_branch, &then_effects);
+    NovaTypeId then_type = analyze_expected(ctx, scope, expr->as.if_expr.then_branch, expected, &then_effects);
     effects = effect_or(effects, then_effects);
     NovaTypeId else_type = ctx->type_unit;
     if (expr->as.if_expr.else_branch) {
         NovaEffectMask else_effects = NOVA_EFFECT_NONE;
-        else_type = analyze_expr(ctx, scope, expr->as.if_expr.else_branch, &else_effects);
+        else_type = analyze_expected(ctx, scope, expr->as.if_expr.else_branch, expected, &else_effects);
         effects = effect_or(effects, else_effects);
     }
     NovaTypeId result = unify_types(ctx, then_type, else_type, expr->start_token);
@@ -653,7 +1041,109 @@ static NovaTypeId analyze_lambda(NovaSemanticContext *ctx, NovaScope *scope, con
     return fn_type;
 }
 
+static void check_operand(NovaSemanticContext *ctx, const NovaExpr *operand, NovaTypeId type, NovaTypeId expected, const char *message) {
+    if (operand && type != expected && type != ctx->type_unknown) {
+        diagnostics_error(ctx, operand->start_token, message);
+    }
+}
+
+// Arithmetic and ordering work on Numbers and on Ints, but never on a mix:
+// conversions are always spelled out. Returns the operands' common type.
+static NovaTypeId check_numeric_operands(NovaSemanticContext *ctx, const NovaOperatorExpr *op, NovaTypeId left, NovaTypeId right, const char *message) {
+    NovaTypeId operands[2] = {left, right};
+    const NovaExpr *exprs[2] = {op->left, op->right};
+    NovaTypeId common = ctx->type_unknown;
+    for (size_t i = 0; i < 2; ++i) {
+        if (!exprs[i] || operands[i] == ctx->type_unknown) continue;
+        if (operands[i] != ctx->type_number && operands[i] != ctx->type_int) {
+            diagnostics_error(ctx, exprs[i]->start_token, message);
+        } else if (common == ctx->type_unknown) {
+            common = operands[i];
+        } else if (common != operands[i]) {
+            diagnostics_error(ctx, op->op_token, "operator mixes Int and Number; convert with Int(...) or Number(...)");
+        }
+    }
+    return common;
+}
+
+// The left operand is analysed first and the right one is expected to match
+// it, so `n + 1` types 1 as an Int when n is one. A bare integral literal on
+// the left instead takes its type from the right operand.
+static NovaTypeId analyze_operator(NovaSemanticContext *ctx, NovaScope *scope, const NovaExpr *expr, NovaTypeId expected, NovaEffectMask *out_effects) {
+    const NovaOperatorExpr *op = &expr->as.op;
+    NovaEffectMask effects = NOVA_EFFECT_NONE;
+    bool arithmetic = op->op == NOVA_OP_ADD || op->op == NOVA_OP_SUB || op->op == NOVA_OP_MUL ||
+                      op->op == NOVA_OP_DIV || op->op == NOVA_OP_MOD || op->op == NOVA_OP_NEG;
+    NovaTypeId outer = arithmetic ? expected : ctx->type_unknown;
+    NovaTypeId left = ctx->type_unknown;
+    NovaTypeId right = ctx->type_unknown;
+    if (op->right && is_integral_literal(op->left) && !is_integral_literal(op->right)) {
+        right = analyze_expected(ctx, scope, op->right, outer, &effects);
+        left = analyze_expected(ctx, scope, op->left, right, &effects);
+    } else {
+        left = analyze_expected(ctx, scope, op->left, outer, &effects);
+        if (op->right) right = analyze_expected(ctx, scope, op->right, left, &effects);
+    }
+    NovaTypeId result = ctx->type_bool;
+    switch (op->op) {
+    case NOVA_OP_ADD:
+        if (left == ctx->type_string || right == ctx->type_string) {
+            check_operand(ctx, op->left, left, ctx->type_string, "concatenation expects String operands");
+            check_operand(ctx, op->right, right, ctx->type_string, "concatenation expects String operands");
+            result = ctx->type_string;
+            break;
+        }
+        [[fallthrough]];
+    case NOVA_OP_SUB:
+    case NOVA_OP_MUL:
+    case NOVA_OP_DIV:
+    case NOVA_OP_MOD:
+    case NOVA_OP_NEG: {
+        NovaTypeId common = check_numeric_operands(ctx, op, left, right, "arithmetic operator expects Number or Int operands");
+        result = common == ctx->type_int ? ctx->type_int : ctx->type_number;
+        break;
+    }
+    case NOVA_OP_LT:
+    case NOVA_OP_LE:
+    case NOVA_OP_GT:
+    case NOVA_OP_GE:
+        check_numeric_operands(ctx, op, left, right, "comparison operator expects Number or Int operands");
+        break;
+    case NOVA_OP_TO_INT:
+    case NOVA_OP_TO_NUMBER:
+    case NOVA_OP_LIST_LENGTH:
+    case NOVA_OP_LIST_GET:
+    case NOVA_OP_LIST_PUSH:
+    case NOVA_OP_MAP_NEW:
+    case NOVA_OP_MAP_LENGTH:
+    case NOVA_OP_MAP_GET:
+    case NOVA_OP_MAP_HAS:
+    case NOVA_OP_MAP_PUT:
+    case NOVA_OP_MAP_REMOVE:
+        break;
+    case NOVA_OP_AND:
+    case NOVA_OP_OR:
+    case NOVA_OP_NOT:
+        check_operand(ctx, op->left, left, ctx->type_bool, "logical operator expects Bool operands");
+        check_operand(ctx, op->right, right, ctx->type_bool, "logical operator expects Bool operands");
+        break;
+    case NOVA_OP_EQ:
+    case NOVA_OP_NE: {
+        NovaTypeId operand = unify_types(ctx, left, right, op->op_token);
+        if (operand != ctx->type_unknown && operand != ctx->type_number && operand != ctx->type_int && operand != ctx->type_bool) {
+            diagnostics_error(ctx, op->op_token, "equality operator expects Number, Int or Bool operands");
+        }
+        break;
+    }
+    }
+    expr_info_list_record(ctx, expr, result, effects);
+    merge_effects(out_effects, effects);
+    return result;
+}
+
 static NovaTypeId analyze_expr(NovaSemanticContext *ctx, NovaScope *scope, const NovaExpr *expr, NovaEffectMask *out_effects) {
+    NovaTypeId expected = ctx->expected_type;
+    ctx->expected_type = ctx->type_unknown;
     if (!expr) {
         merge_effects(out_effects, NOVA_EFFECT_NONE);
         return ctx->type_unknown;
@@ -661,23 +1151,23 @@ static NovaTypeId analyze_expr(NovaSemanticContext *ctx, NovaScope *scope, const
     switch (expr->kind) {
     case NOVA_EXPR_LITERAL:
     case NOVA_EXPR_LIST_LITERAL:
-        return analyze_literal(ctx, scope, expr, out_effects);
+        return analyze_literal(ctx, scope, expr, expected, out_effects);
     case NOVA_EXPR_IDENTIFIER:
         return analyze_identifier(ctx, scope, expr, out_effects);
     case NOVA_EXPR_BLOCK:
-        return analyze_block(ctx, scope, expr, out_effects);
+        return analyze_block(ctx, scope, expr, expected, out_effects);
     case NOVA_EXPR_LAMBDA:
         return analyze_lambda(ctx, scope, expr, out_effects);
     case NOVA_EXPR_CALL:
-        return analyze_call(ctx, scope, expr, out_effects);
+        return analyze_call(ctx, scope, expr, expected, out_effects);
     case NOVA_EXPR_PIPE:
         return analyze_pipeline(ctx, scope, expr, out_effects);
     case NOVA_EXPR_IF:
-        return analyze_if(ctx, scope, expr, out_effects);
+        return analyze_if(ctx, scope, expr, expected, out_effects);
     case NOVA_EXPR_WHILE:
         return analyze_while(ctx, scope, expr, out_effects);
     case NOVA_EXPR_MATCH:
-        return analyze_match(ctx, scope, expr, out_effects);
+        return analyze_match(ctx, scope, expr, expected, out_effects);
     case NOVA_EXPR_ASYNC: {
         NovaEffectMask effects = NOVA_EFFECT_ASYNC;
         NovaTypeId inner = analyze_expr(ctx, scope, expr->as.unary.value, &effects);
@@ -700,23 +1190,32 @@ static NovaTypeId analyze_expr(NovaSemanticContext *ctx, NovaScope *scope, const
         expr_info_list_record(ctx, expr, inner, effects);
         return inner;
     }
-    case NOVA_EXPR_PAREN:
-        return analyze_expr(ctx, scope, expr->as.inner, out_effects);
+    case NOVA_EXPR_PAREN: {
+        NovaEffectMask effects = NOVA_EFFECT_NONE;
+        NovaTypeId inner = analyze_expected(ctx, scope, expr->as.inner, expected, &effects);
+        merge_effects(out_effects, effects);
+        expr_info_list_record(ctx, expr, inner, effects);
+        return inner;
+    }
+    case NOVA_EXPR_OPERATOR:
+        return analyze_operator(ctx, scope, expr, expected, out_effects);
     }
     return ctx->type_unknown;
 }
 
 static void analyze_let(NovaSemanticContext *ctx, NovaScope *scope, const NovaLetDecl *decl) {
     NovaEffectMask effects = NOVA_EFFECT_NONE;
-    NovaTypeId value_type = analyze_expr(ctx, scope, decl->value, &effects);
+    NovaTypeId annotation = decl->has_type ? resolve_type_token(ctx, &decl->type_name) : ctx->type_unknown;
+    NovaTypeId value_type = analyze_expected(ctx, scope, decl->value, annotation, &effects);
     if (decl->has_type) {
-        NovaTypeId annotation = resolve_type_token(ctx, &decl->type_name);
         value_type = unify_types(ctx, annotation, value_type, decl->type_name);
     }
     scope_define(ctx, scope, scope_entry_make(decl->name, value_type, effects));
 }
 
-static void analyze_fun(NovaSemanticContext *ctx, NovaScope *scope, const NovaFunDecl *decl) {
+// Functions are declared before any body is analysed, so calls may refer to
+// functions defined later in the module, including mutually recursive ones.
+static NovaTypeId declare_fun(NovaSemanticContext *ctx, NovaScope *scope, const NovaFunDecl *decl) {
     NovaTypeId *param_types = NULL;
     if (decl->params.count > 0) {
         param_types = static_cast<NovaTypeId *>(malloc(decl->params.count * sizeof(NovaTypeId)));
@@ -734,19 +1233,31 @@ static void analyze_fun(NovaSemanticContext *ctx, NovaScope *scope, const NovaFu
     }
     NovaTypeId function_type = type_function(ctx, param_types, decl->params.count, return_type, NOVA_EFFECT_NONE);
     scope_define(ctx, scope, scope_entry_make(decl->name, function_type, NOVA_EFFECT_NONE));
+    free(param_types);
+    return function_type;
+}
+
+static void analyze_fun(NovaSemanticContext *ctx, NovaScope *scope, const NovaFunDecl *decl, NovaTypeId function_type) {
     NovaScope *fn_scope = scope_push(scope);
     for (size_t i = 0; i < decl->params.count; ++i) {
+        const NovaTypeInfo *info = &ctx->types[function_type];
+        NovaTypeId param_type = i < info->as.function.param_count ? info->as.function.params[i] : ctx->type_unknown;
         scope_define(ctx, fn_scope,
                      scope_entry_make(decl->params.items[i].name,
-                                      param_types[i],
+                                      param_type,
                                       NOVA_EFFECT_NONE));
     }
     NovaEffectMask body_effects = NOVA_EFFECT_NONE;
-    NovaTypeId body_type = analyze_expr(ctx, fn_scope, decl->body, &body_effects);
+    size_t errors = ctx->diagnostics.count;
+    NovaTypeId body_type = analyze_expected(ctx, fn_scope, decl->body, ctx->types[function_type].as.function.result, &body_effects);
     scope_free(fn_scope);
-    ctx->types[function_type].as.function.result = decl->has_return_type ? return_type : body_type;
+    if (!decl->has_return_type) {
+        ctx->types[function_type].as.function.result = body_type;
+    } else if (ctx->diagnostics.count == errors) {
+        // Code generation trusts the annotation, so the body must agree.
+        unify_types(ctx, ctx->types[function_type].as.function.result, body_type, decl->body->start_token);
+    }
     ctx->types[function_type].as.function.effects = body_effects;
-    free(param_types);
 }
 
 void nova_semantic_context_init(NovaSemanticContext *ctx) {
@@ -766,6 +1277,8 @@ void nova_semantic_context_init(NovaSemanticContext *ctx) {
     ctx->type_number = type_pool_add(ctx, type_info_make(NOVA_TYPE_KIND_NUMBER));
     ctx->type_string = type_pool_add(ctx, type_info_make(NOVA_TYPE_KIND_STRING));
     ctx->type_bool = type_pool_add(ctx, type_info_make(NOVA_TYPE_KIND_BOOL));
+    ctx->type_int = type_pool_add(ctx, type_info_make(NOVA_TYPE_KIND_INT));
+    ctx->expected_type = ctx->type_unknown;
 }
 
 void nova_semantic_context_free(NovaSemanticContext *ctx) {
@@ -786,9 +1299,24 @@ void nova_semantic_context_free(NovaSemanticContext *ctx) {
 }
 
 void nova_semantic_analyze_program(NovaSemanticContext *ctx, const NovaProgram *program) {
+    size_t first_record = ctx->type_records.count;
     for (size_t i = 0; i < program->decl_count; ++i) {
         if (program->decls[i].kind == NOVA_DECL_TYPE) {
-            register_type_decl(ctx, &program->decls[i].as.type_decl);
+            declare_type_decl(ctx, &program->decls[i].as.type_decl);
+        }
+    }
+    for (size_t i = first_record; i < ctx->type_records.count; ++i) {
+        register_type_decl(ctx, &ctx->type_records.items[i]);
+    }
+    nova_layout_compute(ctx);
+    NovaTypeId *function_types = NULL;
+    if (program->decl_count > 0) {
+        function_types = static_cast<NovaTypeId *>(calloc(program->decl_count, sizeof(NovaTypeId)));
+        if (!function_types) return;
+    }
+    for (size_t i = 0; i < program->decl_count; ++i) {
+        if (program->decls[i].kind == NOVA_DECL_FUN) {
+            function_types[i] = declare_fun(ctx, ctx->scope, &program->decls[i].as.fun_decl);
         }
     }
     for (size_t i = 0; i < program->decl_count; ++i) {
@@ -798,12 +1326,13 @@ void nova_semantic_analyze_program(NovaSemanticContext *ctx, const NovaProgram *
             analyze_let(ctx, ctx->scope, &decl->as.let_decl);
             break;
         case NOVA_DECL_FUN:
-            analyze_fun(ctx, ctx->scope, &decl->as.fun_decl);
+            analyze_fun(ctx, ctx->scope, &decl->as.fun_decl, function_types[i]);
             break;
         case NOVA_DECL_TYPE:
             break;
         }
     }
+    free(function_types);
 }
 
 const NovaExprInfo *nova_semantic_lookup_expr(const NovaSemanticContext *ctx, const NovaExpr *expr) {
@@ -824,3 +1353,19 @@ const NovaTypeInfo *nova_semantic_type_info(const NovaSemanticContext *ctx, Nova
 const NovaTypeRecord *nova_semantic_find_type(const NovaSemanticContext *ctx, const NovaToken *name) {
     return type_record_find(ctx, name);
 }
+
+const NovaTypeRecord *nova_semantic_type_record(const NovaSemanticContext *ctx, NovaTypeId type_id) {
+    const NovaTypeInfo *info = nova_semantic_type_info(ctx, type_id);
+    if (!info || info->kind != NOVA_TYPE_KIND_CUSTOM) return NULL;
+    return info->as.custom.record;
+}
+
+size_t nova_semantic_find_variant(const NovaTypeRecord *record, const NovaToken *name) {
+    if (!record) return SIZE_MAX;
+    for (size_t v = 0; v < record->variant_count; ++v) {
+        if (token_equals(&record->variants[v].variant->name, name)) {
+            return v;
+        }
+    }
+    return SIZE_MAX;
+}
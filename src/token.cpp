@@ -78,6 +78,20 @@ const char *nova_token_type_name(NovaTokenType type) {
     case NOVA_TOKEN_ARROW_FN: return "ARROW_FN";
     case NOVA_TOKEN_PIPE_OPERATOR: return "PIPE_OPERATOR";
     case NOVA_TOKEN_BANG: return "BANG";
+    case NOVA_TOKEN_PLUS: return "PLUS";
+    case NOVA_TOKEN_MINUS: return "MINUS";
+    case NOVA_TOKEN_STAR: return "STAR";
+    case NOVA_TOKEN_SLASH: return "SLASH";
+    case NOVA_TOKEN_PERCENT: return "PERCENT";
+    case NOVA_TOKEN_LESS: return "LESS";
+    case NOVA_TOKEN_LESS_EQUAL: return "LESS_EQUAL";
+    case NOVA_TOKEN_GREATER: return "GREATER";
+    case NOVA_TOKEN_GREATER_EQUAL: return "GREATER_EQUAL";
+    case NOVA_TOKEN_EQUAL_EQUAL: return "EQUAL_EQUAL";
+    case NOVA_TOKEN_BANG_EQUAL: return "BANG_EQUAL";
+    case NOVA_TOKEN_AND: return "AND";
+    case NOVA_TOKEN_OR: return "OR";
+    case NOVA_TOKEN_NOT: return "NOT";
     case NOVA_TOKEN_EOF: return "EOF";
     case NOVA_TOKEN_ERROR: return "ERROR";
     default: return "UNKNOWN";
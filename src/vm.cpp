@@ -0,0 +1,1544 @@
+#include "nova/vm.h"
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__)
+#define NOVA_VM_COMPUTED_GOTO 1
+#endif
+
+// Registers are untyped 64-bit words; each instruction knows how to read
+// its operands. Objects are collector payloads, so their low bit is clear;
+// values with the low bit set are immediates standing for a payload-free
+// variant (its tag) or a function value without captures (its function).
+typedef union {
+    int64_t i;
+    uint64_t u;
+    double f;
+    void *p;
+} VMReg;
+
+// A sum or tuple value, or a closure whose tag is its function. The count
+// fields follow the header.
+typedef struct {
+    uint32_t tag;
+    uint32_t count;
+} VMObject;
+
+static VMReg *vm_fields(const VMObject *object) {
+    return reinterpret_cast<VMReg *>(const_cast<VMObject *>(object) + 1);
+}
+
+#define NOVA_VM_OPCODES(X) \
+    X(MOVE)                \
+    X(LOADI)               \
+    X(LOADK)               \
+    X(IADD)                \
+    X(ISUB)                \
+    X(IMUL)                \
+    X(IDIV)                \
+    X(IREM)                \
+    X(ADDI)                \
+    X(INEG)                \
+    X(ILT)                 \
+    X(ILE)                 \
+    X(IEQ)                 \
+    X(INE)                 \
+    X(FADD)                \
+    X(FSUB)                \
+    X(FMUL)                \
+    X(FDIV)                \
+    X(FREM)                \
+    X(FNEG)                \
+    X(FLT)                 \
+    X(FLE)                 \
+    X(FEQ)                 \
+    X(FNE)                 \
+    X(NOT)                 \
+    X(I2F)                 \
+    X(F2I)                 \
+    X(JMP)                 \
+    X(JMPF)                \
+    X(JILT)                \
+    X(JILE)                \
+    X(JIEQ)                \
+    X(JINE)                \
+    X(JFLT)                \
+    X(JFLE)                \
+    X(JFEQ)                \
+    X(JFNE)                \
+    X(JILTI)               \
+    X(JILEI)               \
+    X(JIGTI)               \
+    X(JIGEI)               \
+    X(JIEQI)               \
+    X(JINEI)               \
+    X(EXT)                 \
+    X(CALL)                \
+    X(TAILCALL)            \
+    X(APPLY)               \
+    X(RET)                 \
+    X(CLOSURE)             \
+    X(CONSTRUCT)           \
+    X(TAG)                 \
+    X(FIELD)               \
+    X(SWITCH)              \
+    X(TRAP)                \
+    X(UNSUPPORTED)
+
+typedef enum {
+#define NOVA_VM_ENUM(name) VM_OP_##name,
+    NOVA_VM_OPCODES(NOVA_VM_ENUM)
+#undef NOVA_VM_ENUM
+} VMOp;
+
+static const char *const vm_op_names[] = {
+#define NOVA_VM_NAME(name) #name,
+    NOVA_VM_OPCODES(NOVA_VM_NAME)
+#undef NOVA_VM_NAME
+};
+
+// Every instruction is four 16-bit fields. 32-bit immediates and jump
+// offsets span b and c; the fused compare-and-branch instructions keep
+// their offset in a following EXT word. Offsets count from the instruction
+// after the one holding them.
+typedef struct {
+    uint16_t op;
+    uint16_t a;
+    uint16_t b;
+    uint16_t c;
+} VMInst;
+
+typedef struct {
+    uint32_t function;
+    uint32_t argc;
+} VMCallSite;
+
+// Function values are called through a monomorphic inline cache: the last
+// function seen at the site, checked against the callee's arity once.
+typedef struct {
+    uint32_t argc;
+    uint32_t cached_function;
+    const struct VMFunction *cached;
+} VMApplySite;
+
+typedef struct {
+    uint32_t tag; // variant, or the function of a closure
+    uint32_t count;
+} VMShape;
+
+typedef struct VMFunction {
+    char *name;
+    VMInst *code;
+    size_t code_length;
+    uint32_t param_count;
+    uint32_t frame_size;
+    NovaTypeKind result_kind;
+} VMFunction;
+
+struct NovaVMProgram {
+    VMFunction *functions;
+    size_t function_count;
+    uint64_t *constants;
+    size_t constant_count;
+    size_t constant_capacity;
+    VMCallSite *calls;
+    size_t call_count;
+    size_t call_capacity;
+    VMApplySite *applies;
+    size_t apply_count;
+    size_t apply_capacity;
+    VMShape *shapes;
+    size_t shape_count;
+    size_t shape_capacity;
+    int32_t *switches; // per table: count, default offset, one offset per tag
+    size_t switch_length;
+    size_t switch_capacity;
+    char **messages; // reported by UNSUPPORTED
+    size_t message_count;
+    size_t message_capacity;
+};
+
+#define NOVA_VM_MAX_REGISTERS 65535
+
+static bool vm_reserve(void **items, size_t *capacity, size_t needed, size_t item_size) {
+    if (needed <= *capacity) return true;
+    size_t next = *capacity ? *capacity * 2 : 16;
+    while (next < needed) next *= 2;
+    void *grown = realloc(*items, next * item_size);
+    if (!grown) return false;
+    *items = grown;
+    *capacity = next;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Compiler
+
+typedef struct {
+    NovaToken name;
+    uint16_t reg;
+    bool is_mutable; // reads copy the register, since a later assignment may change it
+} VMBinding;
+
+typedef struct {
+    NovaVMProgram *program;
+    const NovaIRProgram *ir;
+    const NovaSemanticContext *semantics;
+    const NovaIRFunction *fn;
+    size_t fn_index;
+    VMInst *code;
+    size_t length;
+    size_t capacity;
+    VMBinding *bindings;
+    size_t binding_count;
+    size_t binding_capacity;
+    uint32_t next_reg;
+    uint32_t max_reg;
+    bool ok;
+    bool out_of_memory;
+    char error[256];
+} VMCompiler;
+
+static void vm_fail(VMCompiler *c, const char *format, ...) {
+    if (c->ok) {
+        va_list args;
+        va_start(args, format);
+        vsnprintf(c->error, sizeof(c->error), format, args);
+        va_end(args);
+    }
+    c->ok = false;
+}
+
+static void vm_out_of_memory(VMCompiler *c) {
+    vm_fail(c, "out of memory");
+    c->out_of_memory = true;
+}
+
+static size_t vm_emit_wide(VMCompiler *c, VMOp op, uint32_t a, uint32_t value);
+
+// Past a limit of the instruction format the whole function becomes a stub.
+static void vm_limit(VMCompiler *c, const char *what) {
+    vm_fail(c, "bytecode VM does not support %s (in %.*s)", what, (int)c->fn->name.length, c->fn->name.lexeme);
+}
+
+static void vm_emit_unsupported(VMCompiler *c, const char *message) {
+    NovaVMProgram *p = c->program;
+    char *copy = strdup(message);
+    if (!copy || !vm_reserve(reinterpret_cast<void **>(&p->messages), &p->message_capacity, p->message_count + 1, sizeof(char *))) {
+        free(copy);
+        vm_out_of_memory(c);
+        return;
+    }
+    p->messages[p->message_count] = copy;
+    vm_emit_wide(c, VM_OP_UNSUPPORTED, 0, (uint32_t)p->message_count++);
+}
+
+// Code the VM cannot run compiles to an instruction that reports why, so
+// only the paths reaching it fail.
+static void vm_unsupported(VMCompiler *c, const char *what) {
+    if (!c->ok) return;
+    char message[256];
+    snprintf(message, sizeof(message), "bytecode VM does not support %s (in %.*s)", what, (int)c->fn->name.length, c->fn->name.lexeme);
+    vm_emit_unsupported(c, message);
+}
+
+static NovaTypeKind vm_kind(const VMCompiler *c, NovaTypeId type) {
+    const NovaTypeInfo *info = nova_semantic_type_info(c->semantics, type);
+    NovaTypeKind kind = info ? info->kind : NOVA_TYPE_KIND_UNKNOWN;
+    return kind == NOVA_TYPE_KIND_UNKNOWN ? NOVA_TYPE_KIND_NUMBER : kind;
+}
+
+static const char *vm_kind_description(NovaTypeKind kind) {
+    switch (kind) {
+    case NOVA_TYPE_KIND_STRING: return "String values";
+    case NOVA_TYPE_KIND_LIST: return "List values";
+    case NOVA_TYPE_KIND_MAP: return "Map values";
+    default: return "this operation";
+    }
+}
+
+static size_t vm_emit(VMCompiler *c, VMOp op, uint32_t a, uint32_t b, uint32_t cc) {
+    if (!vm_reserve(reinterpret_cast<void **>(&c->code), &c->capacity, c->length + 1, sizeof(VMInst))) {
+        vm_out_of_memory(c);
+        return 0;
+    }
+    VMInst *inst = &c->code[c->length];
+    inst->op = (uint16_t)op;
+    inst->a = (uint16_t)a;
+    inst->b = (uint16_t)b;
+    inst->c = (uint16_t)cc;
+    return c->length++;
+}
+
+static size_t vm_emit_wide(VMCompiler *c, VMOp op, uint32_t a, uint32_t value) {
+    return vm_emit(c, op, a, value & 0xFFFF, value >> 16);
+}
+
+static void vm_set_wide(VMCompiler *c, size_t index, int32_t value) {
+    if (!c->ok) return;
+    c->code[index].b = (uint16_t)((uint32_t)value & 0xFFFF);
+    c->code[index].c = (uint16_t)((uint32_t)value >> 16);
+}
+
+// Points the jump whose offset lives at index to the next instruction emitted.
+static void vm_patch_here(VMCompiler *c, size_t index) {
+    if (index != SIZE_MAX) vm_set_wide(c, index, (int32_t)(c->length - (index + 1)));
+}
+
+static void vm_jump_to(VMCompiler *c, size_t target) {
+    size_t index = vm_emit(c, VM_OP_JMP, 0, 0, 0);
+    vm_set_wide(c, index, (int32_t)target - (int32_t)(index + 1));
+}
+
+static uint32_t vm_alloc(VMCompiler *c, uint32_t count) {
+    uint32_t reg = c->next_reg;
+    if (reg + count > NOVA_VM_MAX_REGISTERS) {
+        vm_limit(c, "functions needing more than 65535 registers");
+        return 0;
+    }
+    c->next_reg += count;
+    if (c->next_reg > c->max_reg) c->max_reg = c->next_reg;
+    return reg;
+}
+
+static uint32_t vm_add_constant(VMCompiler *c, uint64_t bits) {
+    NovaVMProgram *p = c->program;
+    for (size_t i = p->constant_count; i > 0 && i + 16 > p->constant_count; --i) {
+        if (p->constants[i - 1] == bits) return (uint32_t)(i - 1);
+    }
+    if (!vm_reserve(reinterpret_cast<void **>(&p->constants), &p->constant_capacity, p->constant_count + 1, sizeof(uint64_t))) {
+        vm_out_of_memory(c);
+        return 0;
+    }
+    p->constants[p->constant_count] = bits;
+    return (uint32_t)p->constant_count++;
+}
+
+static uint32_t vm_add_shape(VMCompiler *c, uint32_t tag, uint32_t count) {
+    NovaVMProgram *p = c->program;
+    if (!vm_reserve(reinterpret_cast<void **>(&p->shapes), &p->shape_capacity, p->shape_count + 1, sizeof(VMShape))) {
+        vm_out_of_memory(c);
+        return 0;
+    }
+    p->shapes[p->shape_count].tag = tag;
+    p->shapes[p->shape_count].count = count;
+    if (p->shape_count >= 0xFFFF) vm_limit(c, "more than 65535 construction sites");
+    return (uint32_t)p->shape_count++;
+}
+
+static uint32_t vm_add_call(VMCompiler *c, size_t function, size_t argc) {
+    NovaVMProgram *p = c->program;
+    if (!vm_reserve(reinterpret_cast<void **>(&p->calls), &p->call_capacity, p->call_count + 1, sizeof(VMCallSite))) {
+        vm_out_of_memory(c);
+        return 0;
+    }
+    p->calls[p->call_count].function = (uint32_t)function;
+    p->calls[p->call_count].argc = (uint32_t)argc;
+    if (p->call_count >= 0xFFFF) vm_limit(c, "more than 65535 call sites");
+    return (uint32_t)p->call_count++;
+}
+
+static void vm_load_bits(VMCompiler *c, uint32_t target, uint64_t bits) {
+    int64_t value = (int64_t)bits;
+    if (value >= INT32_MIN && value <= INT32_MAX) {
+        vm_emit_wide(c, VM_OP_LOADI, target, (uint32_t)(int32_t)value);
+    } else {
+        vm_emit_wide(c, VM_OP_LOADK, target, vm_add_constant(c, bits));
+    }
+}
+
+static uint64_t vm_double_bits(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static bool vm_bind(VMCompiler *c, NovaToken name, uint32_t reg, bool is_mutable) {
+    if (!vm_reserve(reinterpret_cast<void **>(&c->bindings), &c->binding_capacity, c->binding_count + 1, sizeof(VMBinding))) {
+        vm_out_of_memory(c);
+        return false;
+    }
+    c->bindings[c->binding_count].name = name;
+    c->bindings[c->binding_count].reg = (uint16_t)reg;
+    c->bindings[c->binding_count].is_mutable = is_mutable;
+    c->binding_count++;
+    return true;
+}
+
+static const VMBinding *vm_lookup(const VMCompiler *c, const NovaToken *name) {
+    for (size_t i = c->binding_count; i > 0; --i) {
+        const VMBinding *binding = &c->bindings[i - 1];
+        if (binding->name.length == name->length && memcmp(binding->name.lexeme, name->lexeme, name->length) == 0) return binding;
+    }
+    return NULL;
+}
+
+typedef struct {
+    const NovaToken *name; // NULL matches every assignment
+    bool found;
+} VMAssignFinder;
+
+static void vm_find_assignment(NovaIRExpr **slot, void *ctx) {
+    VMAssignFinder *finder = static_cast<VMAssignFinder *>(ctx);
+    if (!*slot || finder->found) return;
+    const NovaIRExpr *expr = *slot;
+    if (expr->kind == NOVA_IR_EXPR_ASSIGN &&
+        (!finder->name || (expr->as.assign.target.length == finder->name->length &&
+                           memcmp(expr->as.assign.target.lexeme, finder->name->lexeme, finder->name->length) == 0))) {
+        finder->found = true;
+        return;
+    }
+    nova_ir_expr_for_each_child(*slot, vm_find_assignment, ctx);
+}
+
+static bool vm_assigns(const NovaIRExpr *expr) {
+    VMAssignFinder finder = {NULL, false};
+    NovaIRExpr *slot = const_cast<NovaIRExpr *>(expr);
+    vm_find_assignment(&slot, &finder);
+    return finder.found;
+}
+
+static void compile_expr(VMCompiler *c, const NovaIRExpr *expr, uint32_t target);
+static void compile_tail(VMCompiler *c, const NovaIRExpr *expr);
+static void compile_effect(VMCompiler *c, const NovaIRExpr *expr);
+
+// The register holding expr's value: a binding's own register, or a fresh
+// temporary the caller releases. A mutable binding is read in place unless
+// later, evaluated before the value is used, may assign it.
+static uint32_t operand_reg(VMCompiler *c, const NovaIRExpr *expr, const NovaIRExpr *later) {
+    if (expr->kind == NOVA_IR_EXPR_IDENTIFIER) {
+        const VMBinding *binding = vm_lookup(c, &expr->as.identifier);
+        if (binding && (!binding->is_mutable || !later || !vm_assigns(later))) return binding->reg;
+    }
+    uint32_t reg = vm_alloc(c, 1);
+    compile_expr(c, expr, reg);
+    return reg;
+}
+
+static bool is_compare(NovaOperator op) {
+    return op == NOVA_OP_LT || op == NOVA_OP_LE || op == NOVA_OP_GT || op == NOVA_OP_GE || op == NOVA_OP_EQ || op == NOVA_OP_NE;
+}
+
+static bool vm_small_int(const NovaIRExpr *expr) {
+    return expr->kind == NOVA_IR_EXPR_INT && expr->as.int_value >= INT16_MIN && expr->as.int_value <= INT16_MAX;
+}
+
+// Emits a jump taken when cond is false and returns the index holding its
+// offset, or SIZE_MAX when cond is the literal true. Comparisons fuse with
+// the branch, and Int comparisons against a small constant take it inline.
+static size_t compile_branch_false(VMCompiler *c, const NovaIRExpr *cond) {
+    uint32_t mark = c->next_reg;
+    size_t patch = SIZE_MAX;
+    if (cond->kind == NOVA_IR_EXPR_BOOL) {
+        if (!cond->as.bool_value) patch = vm_emit(c, VM_OP_JMP, 0, 0, 0);
+    } else if (cond->kind == NOVA_IR_EXPR_OPERATOR && is_compare(cond->as.op.op)) {
+        NovaTypeKind kind = vm_kind(c, cond->as.op.left->type);
+        if (kind != NOVA_TYPE_KIND_NUMBER && kind != NOVA_TYPE_KIND_INT && kind != NOVA_TYPE_KIND_BOOL) {
+            vm_unsupported(c, vm_kind_description(kind));
+            c->next_reg = mark;
+            return SIZE_MAX;
+        }
+        bool number = kind == NOVA_TYPE_KIND_NUMBER;
+        NovaOperator op = cond->as.op.op;
+        const NovaIRExpr *left_expr = cond->as.op.left;
+        const NovaIRExpr *right_expr = cond->as.op.right;
+        if (!number && (vm_small_int(left_expr) || vm_small_int(right_expr))) {
+            if (vm_small_int(left_expr)) {
+                const NovaIRExpr *swap = left_expr;
+                left_expr = right_expr;
+                right_expr = swap;
+                op = op == NOVA_OP_LT ? NOVA_OP_GT : op == NOVA_OP_LE ? NOVA_OP_GE : op == NOVA_OP_GT ? NOVA_OP_LT : op == NOVA_OP_GE ? NOVA_OP_LE : op;
+            }
+            uint32_t reg = operand_reg(c, left_expr, NULL);
+            VMOp fused = op == NOVA_OP_LT ? VM_OP_JILTI
+                       : op == NOVA_OP_LE ? VM_OP_JILEI
+                       : op == NOVA_OP_GT ? VM_OP_JIGTI
+                       : op == NOVA_OP_GE ? VM_OP_JIGEI
+                       : op == NOVA_OP_EQ ? VM_OP_JIEQI
+                                          : VM_OP_JINEI;
+            vm_emit(c, fused, reg, (uint16_t)(int16_t)right_expr->as.int_value, 0);
+            patch = vm_emit(c, VM_OP_EXT, 0, 0, 0);
+            c->next_reg = mark;
+            return patch;
+        }
+        uint32_t left = operand_reg(c, left_expr, right_expr);
+        uint32_t right = operand_reg(c, right_expr, NULL);
+        if (op == NOVA_OP_GT || op == NOVA_OP_GE) {
+            uint32_t swap = left;
+            left = right;
+            right = swap;
+            op = op == NOVA_OP_GT ? NOVA_OP_LT : NOVA_OP_LE;
+        }
+        VMOp fused = op == NOVA_OP_LT ? (number ? VM_OP_JFLT : VM_OP_JILT)
+                   : op == NOVA_OP_LE ? (number ? VM_OP_JFLE : VM_OP_JILE)
+                   : op == NOVA_OP_EQ ? (number ? VM_OP_JFEQ : VM_OP_JIEQ)
+                                      : (number ? VM_OP_JFNE : VM_OP_JINE);
+        vm_emit(c, fused, left, right, 0);
+        patch = vm_emit(c, VM_OP_EXT, 0, 0, 0);
+    } else {
+        uint32_t reg = operand_reg(c, cond, NULL);
+        patch = vm_emit(c, VM_OP_JMPF, reg, 0, 0);
+    }
+    c->next_reg = mark;
+    return patch;
+}
+
+static void compile_operator(VMCompiler *c, const NovaIRExpr *expr, uint32_t target) {
+    NovaOperator op = expr->as.op.op;
+    NovaTypeKind kind = vm_kind(c, expr->as.op.left->type);
+    if (op > NOVA_OP_TO_NUMBER || (kind != NOVA_TYPE_KIND_NUMBER && kind != NOVA_TYPE_KIND_INT && kind != NOVA_TYPE_KIND_BOOL)) {
+        vm_unsupported(c, vm_kind_description(kind));
+        return;
+    }
+    bool number = kind == NOVA_TYPE_KIND_NUMBER;
+    uint32_t mark = c->next_reg;
+    const NovaIRExpr *right = expr->as.op.right;
+    // n + 1 and n - 1 take their constant inline.
+    if (!number && (op == NOVA_OP_ADD || op == NOVA_OP_SUB) && right->kind == NOVA_IR_EXPR_INT &&
+        right->as.int_value >= -32767 && right->as.int_value <= 32767) {
+        uint32_t left = operand_reg(c, expr->as.op.left, NULL);
+        int64_t imm = op == NOVA_OP_ADD ? right->as.int_value : -right->as.int_value;
+        vm_emit(c, VM_OP_ADDI, target, left, (uint16_t)(int16_t)imm);
+        c->next_reg = mark;
+        return;
+    }
+    uint32_t left = operand_reg(c, expr->as.op.left, right);
+    uint32_t other = right ? operand_reg(c, right, NULL) : 0;
+    switch (op) {
+    case NOVA_OP_ADD: vm_emit(c, number ? VM_OP_FADD : VM_OP_IADD, target, left, other); break;
+    case NOVA_OP_SUB: vm_emit(c, number ? VM_OP_FSUB : VM_OP_ISUB, target, left, other); break;
+    case NOVA_OP_MUL: vm_emit(c, number ? VM_OP_FMUL : VM_OP_IMUL, target, left, other); break;
+    case NOVA_OP_DIV: vm_emit(c, number ? VM_OP_FDIV : VM_OP_IDIV, target, left, other); break;
+    case NOVA_OP_MOD: vm_emit(c, number ? VM_OP_FREM : VM_OP_IREM, target, left, other); break;
+    case NOVA_OP_LT: vm_emit(c, number ? VM_OP_FLT : VM_OP_ILT, target, left, other); break;
+    case NOVA_OP_LE: vm_emit(c, number ? VM_OP_FLE : VM_OP_ILE, target, left, other); break;
+    case NOVA_OP_GT: vm_emit(c, number ? VM_OP_FLT : VM_OP_ILT, target, other, left); break;
+    case NOVA_OP_GE: vm_emit(c, number ? VM_OP_FLE : VM_OP_ILE, target, other, left); break;
+    case NOVA_OP_EQ: vm_emit(c, number ? VM_OP_FEQ : VM_OP_IEQ, target, left, other); break;
+    case NOVA_OP_NE: vm_emit(c, number ? VM_OP_FNE : VM_OP_INE, target, left, other); break;
+    case NOVA_OP_NEG: vm_emit(c, number ? VM_OP_FNEG : VM_OP_INEG, target, left, 0); break;
+    case NOVA_OP_NOT: vm_emit(c, VM_OP_NOT, target, left, 0); break;
+    case NOVA_OP_TO_INT:
+        if (number) {
+            vm_emit(c, VM_OP_F2I, target, left, 0);
+        } else if (left != target) {
+            vm_emit(c, VM_OP_MOVE, target, left, 0);
+        }
+        break;
+    case NOVA_OP_TO_NUMBER:
+        if (!number) {
+            vm_emit(c, VM_OP_I2F, target, left, 0);
+        } else if (left != target) {
+            vm_emit(c, VM_OP_MOVE, target, left, 0);
+        }
+        break;
+    default:
+        vm_unsupported(c, "this operator");
+        break;
+    }
+    c->next_reg = mark;
+}
+
+// Evaluates args into consecutive fresh registers and returns the first.
+static uint32_t compile_args(VMCompiler *c, NovaIRExpr *const *args, size_t count, uint32_t leading) {
+    uint32_t base = vm_alloc(c, (uint32_t)count + leading);
+    for (size_t i = 0; c->ok && i < count; ++i) compile_expr(c, args[i], base + leading + (uint32_t)i);
+    return base;
+}
+
+static void compile_let(VMCompiler *c, const NovaIRExpr *expr, uint32_t target, bool tail) {
+    uint32_t mark = c->next_reg;
+    uint32_t reg = vm_alloc(c, 1);
+    compile_expr(c, expr->as.let_expr.value, reg);
+    size_t saved = c->binding_count;
+    if (vm_bind(c, expr->as.let_expr.name, reg, expr->as.let_expr.is_mutable)) {
+        if (tail) {
+            compile_tail(c, expr->as.let_expr.body);
+        } else {
+            compile_expr(c, expr->as.let_expr.body, target);
+        }
+    }
+    c->binding_count = saved;
+    c->next_reg = mark;
+}
+
+// Arm bodies either write target and jump to the end, or return.
+static void compile_arm_body(VMCompiler *c, const NovaIRExpr *body, uint32_t target, bool tail, size_t *exits, size_t *exit_count) {
+    if (tail) {
+        compile_tail(c, body);
+        return;
+    }
+    compile_expr(c, body, target);
+    exits[(*exit_count)++] = vm_emit(c, VM_OP_JMP, 0, 0, 0);
+}
+
+static void compile_literal_match(VMCompiler *c, const NovaIRExpr *expr, NovaTypeKind kind, uint32_t subject, uint32_t target, bool tail, size_t *exits, size_t *exit_count) {
+    bool number = kind == NOVA_TYPE_KIND_NUMBER;
+    for (size_t i = 0; c->ok && i < expr->as.match_expr.arm_count; ++i) {
+        const NovaIRMatchArm *arm = &expr->as.match_expr.arms[i];
+        if (!arm->literal) {
+            compile_arm_body(c, arm->body, target, tail, exits, exit_count);
+            return;
+        }
+        uint32_t mark = c->next_reg;
+        if (kind == NOVA_TYPE_KIND_INT && vm_small_int(arm->literal)) {
+            vm_emit(c, VM_OP_JIEQI, subject, (uint16_t)(int16_t)arm->literal->as.int_value, 0);
+        } else {
+            uint32_t literal = vm_alloc(c, 1);
+            uint64_t bits = number ? vm_double_bits(arm->literal->as.number_value)
+                          : kind == NOVA_TYPE_KIND_INT ? (uint64_t)arm->literal->as.int_value
+                                                       : (arm->literal->as.bool_value ? 1 : 0);
+            vm_load_bits(c, literal, bits);
+            vm_emit(c, number ? VM_OP_JFEQ : VM_OP_JIEQ, subject, literal, 0);
+        }
+        size_t next = vm_emit(c, VM_OP_EXT, 0, 0, 0);
+        c->next_reg = mark;
+        compile_arm_body(c, arm->body, target, tail, exits, exit_count);
+        vm_patch_here(c, next);
+    }
+    vm_emit(c, VM_OP_TRAP, 0, 0, 0);
+}
+
+static void compile_variant_match(VMCompiler *c, const NovaIRExpr *expr, const NovaTypeRecord *record, uint32_t subject, uint32_t target, bool tail, size_t *exits, size_t *exit_count) {
+    NovaVMProgram *p = c->program;
+    size_t variants = record->variant_count;
+    // A tuple type has one variant and nothing to dispatch on.
+    size_t table = SIZE_MAX;
+    size_t dispatch = SIZE_MAX;
+    if (variants > 1) {
+        uint32_t tag = vm_alloc(c, 1);
+        vm_emit(c, VM_OP_TAG, tag, subject, 0);
+        if (!vm_reserve(reinterpret_cast<void **>(&p->switches), &p->switch_capacity, p->switch_length + variants + 2, sizeof(int32_t))) {
+            vm_out_of_memory(c);
+            return;
+        }
+        table = p->switch_length;
+        p->switch_length += variants + 2;
+        p->switches[table] = (int32_t)variants;
+        for (size_t v = 0; v < variants + 1; ++v) p->switches[table + 1 + v] = -1;
+        dispatch = vm_emit_wide(c, VM_OP_SWITCH, tag, (uint32_t)table);
+    }
+    bool has_fallback = false;
+    for (size_t i = 0; c->ok && i < expr->as.match_expr.arm_count; ++i) {
+        const NovaIRMatchArm *arm = &expr->as.match_expr.arms[i];
+        int32_t here = (int32_t)(c->length - (dispatch + 1));
+        if (arm->tag == SIZE_MAX) {
+            if (table != SIZE_MAX) {
+                p->switches[table + 1] = here;
+                for (size_t v = 0; v < variants; ++v) {
+                    if (p->switches[table + 2 + v] < 0) p->switches[table + 2 + v] = here;
+                }
+            }
+            has_fallback = true;
+            compile_arm_body(c, arm->body, target, tail, exits, exit_count);
+            break;
+        }
+        if (arm->tag >= variants) continue;
+        if (table != SIZE_MAX) {
+            if (p->switches[table + 2 + arm->tag] >= 0) continue;
+            p->switches[table + 2 + arm->tag] = here;
+        }
+        uint32_t mark = c->next_reg;
+        size_t saved = c->binding_count;
+        const NovaVariantRecord *variant = &record->variants[arm->tag];
+        for (size_t b = 0; c->ok && b < arm->binding_count && b < variant->arity; ++b) {
+            if (arm->bindings[b].length == 1 && arm->bindings[b].lexeme[0] == '_') continue;
+            uint32_t reg = vm_alloc(c, 1);
+            vm_emit(c, VM_OP_FIELD, reg, subject, (uint32_t)b);
+            vm_bind(c, arm->bindings[b], reg, false);
+        }
+        compile_arm_body(c, arm->body, target, tail, exits, exit_count);
+        c->binding_count = saved;
+        c->next_reg = mark;
+        if (table == SIZE_MAX) {
+            has_fallback = true;
+            break;
+        }
+    }
+    if (!has_fallback) {
+        // A match the checker could not prove exhaustive stops the program on a miss.
+        int32_t here = (int32_t)(c->length - (dispatch + 1));
+        if (table != SIZE_MAX) {
+            p->switches[table + 1] = here;
+            for (size_t v = 0; v < variants; ++v) {
+                if (p->switches[table + 2 + v] < 0) p->switches[table + 2 + v] = here;
+            }
+        }
+        vm_emit(c, VM_OP_TRAP, 0, 0, 0);
+    }
+}
+
+static void compile_match(VMCompiler *c, const NovaIRExpr *expr, uint32_t target, bool tail) {
+    const NovaIRExpr *scrutinee = expr->as.match_expr.scrutinee;
+    NovaTypeKind kind = vm_kind(c, scrutinee->type);
+    const NovaTypeRecord *record = kind == NOVA_TYPE_KIND_CUSTOM ? nova_semantic_type_record(c->semantics, scrutinee->type) : NULL;
+    if (kind != NOVA_TYPE_KIND_NUMBER && kind != NOVA_TYPE_KIND_INT && kind != NOVA_TYPE_KIND_BOOL && !(record && record->variant_count > 0)) {
+        vm_unsupported(c, kind == NOVA_TYPE_KIND_STRING ? "String matches" : vm_kind_description(kind));
+        return;
+    }
+    size_t *exits = static_cast<size_t *>(calloc(expr->as.match_expr.arm_count + 1, sizeof(size_t)));
+    if (!exits) {
+        vm_out_of_memory(c);
+        return;
+    }
+    size_t exit_count = 0;
+    uint32_t mark = c->next_reg;
+    // Arms read the subject before their bodies run, so it may stay in place.
+    uint32_t subject = operand_reg(c, scrutinee, NULL);
+    if (record) {
+        compile_variant_match(c, expr, record, subject, target, tail, exits, &exit_count);
+    } else {
+        compile_literal_match(c, expr, kind, subject, target, tail, exits, &exit_count);
+    }
+    c->next_reg = mark;
+    for (size_t i = 0; i < exit_count; ++i) vm_patch_here(c, exits[i]);
+    free(exits);
+}
+
+static void compile_if(VMCompiler *c, const NovaIRExpr *expr, uint32_t target, bool tail) {
+    size_t otherwise = compile_branch_false(c, expr->as.if_expr.condition);
+    if (tail) {
+        compile_tail(c, expr->as.if_expr.then_branch);
+        vm_patch_here(c, otherwise);
+        if (expr->as.if_expr.else_branch) {
+            compile_tail(c, expr->as.if_expr.else_branch);
+        } else {
+            uint32_t reg = vm_alloc(c, 1);
+            vm_emit_wide(c, VM_OP_LOADI, reg, 0);
+            vm_emit(c, VM_OP_RET, reg, 0, 0);
+            c->next_reg = reg;
+        }
+        return;
+    }
+    compile_expr(c, expr->as.if_expr.then_branch, target);
+    size_t end = vm_emit(c, VM_OP_JMP, 0, 0, 0);
+    vm_patch_here(c, otherwise);
+    if (expr->as.if_expr.else_branch) {
+        compile_expr(c, expr->as.if_expr.else_branch, target);
+    } else {
+        vm_emit_wide(c, VM_OP_LOADI, target, 0);
+    }
+    vm_patch_here(c, end);
+}
+
+static void compile_expr(VMCompiler *c, const NovaIRExpr *expr, uint32_t target) {
+    if (!c->ok || !expr) return;
+    uint32_t mark = c->next_reg;
+    switch (expr->kind) {
+    case NOVA_IR_EXPR_NUMBER: {
+        // Zero placeholders of other types, such as a loop's Unit, use their own zero.
+        NovaTypeKind kind = vm_kind(c, expr->type);
+        vm_load_bits(c, target, kind == NOVA_TYPE_KIND_NUMBER ? vm_double_bits(expr->as.number_value) : (uint64_t)(int64_t)expr->as.number_value);
+        return;
+    }
+    case NOVA_IR_EXPR_INT:
+        vm_load_bits(c, target, (uint64_t)expr->as.int_value);
+        return;
+    case NOVA_IR_EXPR_BOOL:
+        vm_emit_wide(c, VM_OP_LOADI, target, expr->as.bool_value ? 1 : 0);
+        return;
+    case NOVA_IR_EXPR_UNIT:
+        vm_emit_wide(c, VM_OP_LOADI, target, 0);
+        return;
+    case NOVA_IR_EXPR_STRING:
+        vm_unsupported(c, "String values");
+        return;
+    case NOVA_IR_EXPR_LIST:
+        vm_unsupported(c, "List values");
+        return;
+    case NOVA_IR_EXPR_IDENTIFIER: {
+        const VMBinding *binding = vm_lookup(c, &expr->as.identifier);
+        if (!binding) {
+            vm_unsupported(c, "this name");
+            return;
+        }
+        if (binding->reg != target) vm_emit(c, VM_OP_MOVE, target, binding->reg, 0);
+        return;
+    }
+    case NOVA_IR_EXPR_CALL: {
+        size_t callee = nova_ir_find_function(c->ir, &expr->as.call.callee);
+        if (callee == SIZE_MAX) {
+            vm_unsupported(c, "calls to functions outside the module");
+            return;
+        }
+        uint32_t base = compile_args(c, expr->as.call.args, expr->as.call.arg_count, 0);
+        vm_emit(c, VM_OP_CALL, target, base, vm_add_call(c, callee, expr->as.call.arg_count));
+        c->next_reg = mark;
+        return;
+    }
+    case NOVA_IR_EXPR_APPLY: {
+        NovaVMProgram *p = c->program;
+        uint32_t base = vm_alloc(c, (uint32_t)expr->as.apply.arg_count + 1);
+        compile_expr(c, expr->as.apply.callee, base);
+        for (size_t i = 0; c->ok && i < expr->as.apply.arg_count; ++i) compile_expr(c, expr->as.apply.args[i], base + 1 + (uint32_t)i);
+        if (!vm_reserve(reinterpret_cast<void **>(&p->applies), &p->apply_capacity, p->apply_count + 1, sizeof(VMApplySite))) {
+            vm_out_of_memory(c);
+            return;
+        }
+        p->applies[p->apply_count].argc = (uint32_t)expr->as.apply.arg_count;
+        p->applies[p->apply_count].cached_function = UINT32_MAX;
+        p->applies[p->apply_count].cached = NULL;
+        if (p->apply_count >= 0xFFFF) vm_limit(c, "more than 65535 call sites");
+        vm_emit(c, VM_OP_APPLY, target, base, (uint32_t)p->apply_count++);
+        c->next_reg = mark;
+        return;
+    }
+    case NOVA_IR_EXPR_CLOSURE: {
+        size_t function = nova_ir_find_function(c->ir, &expr->as.closure.function);
+        if (function == SIZE_MAX) {
+            vm_unsupported(c, "this function value");
+            return;
+        }
+        if (expr->as.closure.capture_count == 0) {
+            vm_load_bits(c, target, ((uint64_t)function << 1) | 1);
+            return;
+        }
+        uint32_t base = compile_args(c, expr->as.closure.captures, expr->as.closure.capture_count, 0);
+        vm_emit(c, VM_OP_CLOSURE, target, base, vm_add_shape(c, (uint32_t)function, (uint32_t)expr->as.closure.capture_count));
+        c->next_reg = mark;
+        return;
+    }
+    case NOVA_IR_EXPR_CONSTRUCT: {
+        if (expr->as.construct.arg_count == 0) {
+            vm_load_bits(c, target, ((uint64_t)expr->as.construct.tag << 1) | 1);
+            return;
+        }
+        uint32_t base = compile_args(c, expr->as.construct.args, expr->as.construct.arg_count, 0);
+        vm_emit(c, VM_OP_CONSTRUCT, target, base, vm_add_shape(c, (uint32_t)expr->as.construct.tag, (uint32_t)expr->as.construct.arg_count));
+        c->next_reg = mark;
+        return;
+    }
+    case NOVA_IR_EXPR_SEQUENCE:
+        if (expr->as.sequence.count == 0) {
+            vm_emit_wide(c, VM_OP_LOADI, target, 0);
+            return;
+        }
+        for (size_t i = 0; c->ok && i + 1 < expr->as.sequence.count; ++i) compile_effect(c, expr->as.sequence.items[i]);
+        compile_expr(c, expr->as.sequence.items[expr->as.sequence.count - 1], target);
+        return;
+    case NOVA_IR_EXPR_IF:
+        compile_if(c, expr, target, false);
+        return;
+    case NOVA_IR_EXPR_WHILE:
+    case NOVA_IR_EXPR_ASSIGN:
+        compile_effect(c, expr);
+        vm_emit_wide(c, VM_OP_LOADI, target, 0);
+        return;
+    case NOVA_IR_EXPR_MATCH:
+        compile_match(c, expr, target, false);
+        return;
+    case NOVA_IR_EXPR_LET:
+        compile_let(c, expr, target, false);
+        return;
+    case NOVA_IR_EXPR_OPERATOR:
+        compile_operator(c, expr, target);
+        return;
+    }
+}
+
+// Compiles expr for its assignments alone, discarding its value.
+static void compile_effect(VMCompiler *c, const NovaIRExpr *expr) {
+    if (!c->ok || !expr) return;
+    uint32_t mark = c->next_reg;
+    switch (expr->kind) {
+    case NOVA_IR_EXPR_NUMBER:
+    case NOVA_IR_EXPR_INT:
+    case NOVA_IR_EXPR_BOOL:
+    case NOVA_IR_EXPR_UNIT:
+    case NOVA_IR_EXPR_IDENTIFIER:
+        return;
+    case NOVA_IR_EXPR_ASSIGN: {
+        const VMBinding *binding = vm_lookup(c, &expr->as.assign.target);
+        if (!binding) {
+            vm_unsupported(c, "assignments to unknown names");
+            return;
+        }
+        compile_expr(c, expr->as.assign.value, binding->reg);
+        return;
+    }
+    case NOVA_IR_EXPR_SEQUENCE:
+        for (size_t i = 0; c->ok && i < expr->as.sequence.count; ++i) compile_effect(c, expr->as.sequence.items[i]);
+        return;
+    case NOVA_IR_EXPR_IF: {
+        size_t otherwise = compile_branch_false(c, expr->as.if_expr.condition);
+        compile_effect(c, expr->as.if_expr.then_branch);
+        if (expr->as.if_expr.else_branch) {
+            size_t end = vm_emit(c, VM_OP_JMP, 0, 0, 0);
+            vm_patch_here(c, otherwise);
+            compile_effect(c, expr->as.if_expr.else_branch);
+            vm_patch_here(c, end);
+        } else {
+            vm_patch_here(c, otherwise);
+        }
+        return;
+    }
+    case NOVA_IR_EXPR_WHILE: {
+        size_t head = c->length;
+        size_t exit = compile_branch_false(c, expr->as.while_expr.condition);
+        compile_effect(c, expr->as.while_expr.body);
+        vm_jump_to(c, head);
+        vm_patch_here(c, exit);
+        return;
+    }
+    case NOVA_IR_EXPR_LET: {
+        uint32_t reg = vm_alloc(c, 1);
+        compile_expr(c, expr->as.let_expr.value, reg);
+        size_t saved = c->binding_count;
+        if (vm_bind(c, expr->as.let_expr.name, reg, expr->as.let_expr.is_mutable)) compile_effect(c, expr->as.let_expr.body);
+        c->binding_count = saved;
+        c->next_reg = mark;
+        return;
+    }
+    default: {
+        uint32_t scratch = vm_alloc(c, 1);
+        compile_expr(c, expr, scratch);
+        c->next_reg = mark;
+        return;
+    }
+    }
+}
+
+static void compile_tail(VMCompiler *c, const NovaIRExpr *expr) {
+    if (!c->ok) return;
+    uint32_t mark = c->next_reg;
+    switch (expr->kind) {
+    case NOVA_IR_EXPR_IF:
+        compile_if(c, expr, 0, true);
+        return;
+    case NOVA_IR_EXPR_MATCH:
+        compile_match(c, expr, 0, true);
+        return;
+    case NOVA_IR_EXPR_LET:
+        compile_let(c, expr, 0, true);
+        return;
+    case NOVA_IR_EXPR_SEQUENCE:
+        if (expr->as.sequence.count == 0) break;
+        for (size_t i = 0; c->ok && i + 1 < expr->as.sequence.count; ++i) compile_effect(c, expr->as.sequence.items[i]);
+        compile_tail(c, expr->as.sequence.items[expr->as.sequence.count - 1]);
+        return;
+    case NOVA_IR_EXPR_CALL: {
+        size_t callee = nova_ir_find_function(c->ir, &expr->as.call.callee);
+        if (callee == SIZE_MAX) break;
+        uint32_t base = compile_args(c, expr->as.call.args, expr->as.call.arg_count, 0);
+        if (callee == c->fn_index) {
+            // A self call in tail position reassigns the parameters and loops.
+            for (size_t i = 0; i < expr->as.call.arg_count; ++i) vm_emit(c, VM_OP_MOVE, (uint32_t)i, base + (uint32_t)i, 0);
+            vm_jump_to(c, 0);
+        } else {
+            vm_emit(c, VM_OP_TAILCALL, 0, base, vm_add_call(c, callee, expr->as.call.arg_count));
+        }
+        c->next_reg = mark;
+        return;
+    }
+    default:
+        break;
+    }
+    uint32_t reg = operand_reg(c, expr, NULL);
+    vm_emit(c, VM_OP_RET, reg, 0, 0);
+    c->next_reg = mark;
+}
+
+static bool compile_function(NovaVMProgram *program, const NovaIRProgram *ir, const NovaSemanticContext *semantics, size_t index) {
+    const NovaIRFunction *fn = &ir->functions[index];
+    VMFunction *out = &program->functions[index];
+    VMCompiler c;
+    memset(&c, 0, sizeof(c));
+    c.program = program;
+    c.ir = ir;
+    c.semantics = semantics;
+    c.fn = fn;
+    c.fn_index = index;
+    c.ok = true;
+    out->name = static_cast<char *>(malloc(fn->name.length + 1));
+    if (!out->name) return false;
+    memcpy(out->name, fn->name.lexeme, fn->name.length);
+    out->name[fn->name.length] = '\0';
+    out->param_count = (uint32_t)fn->param_count;
+    out->result_kind = vm_kind(&c, fn->return_type);
+
+    uint32_t params = vm_alloc(&c, (uint32_t)fn->param_count);
+    for (size_t i = 0; c.ok && i < fn->param_count; ++i) {
+        NovaTypeKind kind = vm_kind(&c, fn->params[i].type);
+        if (kind == NOVA_TYPE_KIND_STRING || kind == NOVA_TYPE_KIND_LIST || kind == NOVA_TYPE_KIND_MAP) vm_unsupported(&c, vm_kind_description(kind));
+        VMAssignFinder finder = {&fn->params[i].name, false};
+        NovaIRExpr *body = fn->body;
+        vm_find_assignment(&body, &finder);
+        vm_bind(&c, fn->params[i].name, params + (uint32_t)i, finder.found);
+    }
+    if (out->result_kind == NOVA_TYPE_KIND_STRING || out->result_kind == NOVA_TYPE_KIND_LIST || out->result_kind == NOVA_TYPE_KIND_MAP) {
+        vm_unsupported(&c, vm_kind_description(out->result_kind));
+    }
+    if (c.ok && fn->body) {
+        compile_tail(&c, fn->body);
+    } else if (c.ok) {
+        vm_emit_wide(&c, VM_OP_LOADI, vm_alloc(&c, 1), 0);
+        vm_emit(&c, VM_OP_RET, c.next_reg - 1, 0, 0);
+    }
+    free(c.bindings);
+    if (c.out_of_memory) {
+        free(c.code);
+        return false;
+    }
+    if (!c.ok) {
+        // The function still exists, so callers compile; calling it reports why it cannot run.
+        free(c.code);
+        c.code = NULL;
+        c.length = 0;
+        c.capacity = 0;
+        c.ok = true;
+        vm_emit_unsupported(&c, c.error);
+        if (!c.ok) {
+            free(c.code);
+            return false;
+        }
+    }
+    out->code = c.code;
+    out->code_length = c.length;
+    out->frame_size = c.max_reg > 0 ? c.max_reg : 1;
+    return true;
+}
+
+NovaVMProgram *nova_vm_compile(const NovaIRProgram *program, const NovaSemanticContext *semantics, char *error_buffer, size_t error_buffer_size) {
+    if (!program || !semantics) return NULL;
+    NovaVMProgram *out = static_cast<NovaVMProgram *>(calloc(1, sizeof(NovaVMProgram)));
+    if (out) out->functions = static_cast<VMFunction *>(calloc(program->function_count + 1, sizeof(VMFunction)));
+    bool ok = out && out->functions;
+    if (ok) out->function_count = program->function_count;
+    for (size_t i = 0; ok && i < program->function_count; ++i) ok = compile_function(out, program, semantics, i);
+    if (!ok) {
+        if (error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "out of memory");
+        nova_vm_program_free(out);
+        return NULL;
+    }
+    return out;
+}
+
+void nova_vm_program_free(NovaVMProgram *program) {
+    if (!program) return;
+    for (size_t i = 0; i < program->function_count; ++i) {
+        free(program->functions[i].name);
+        free(program->functions[i].code);
+    }
+    for (size_t i = 0; i < program->message_count; ++i) free(program->messages[i]);
+    free(program->messages);
+    free(program->functions);
+    free(program->constants);
+    free(program->calls);
+    free(program->applies);
+    free(program->shapes);
+    free(program->switches);
+    free(program);
+}
+
+static const VMFunction *vm_find_function(const NovaVMProgram *program, const char *name) {
+    for (size_t i = 0; i < program->function_count; ++i) {
+        if (strcmp(program->functions[i].name, name) == 0) return &program->functions[i];
+    }
+    return NULL;
+}
+
+static int32_t vm_wide(const VMInst *inst) {
+    return (int32_t)((uint32_t)inst->b | ((uint32_t)inst->c << 16));
+}
+
+bool nova_vm_disassemble(const NovaVMProgram *program, const char *function, FILE *out) {
+    if (!program || !function || !out) return false;
+    const VMFunction *fn = vm_find_function(program, function);
+    if (!fn) return false;
+    fprintf(out, "%s: %u params, %u registers\n", fn->name, fn->param_count, fn->frame_size);
+    for (size_t i = 0; i < fn->code_length; ++i) {
+        const VMInst *inst = &fn->code[i];
+        fprintf(out, "%4zu  %-11s", i, vm_op_names[inst->op]);
+        switch (inst->op) {
+        case VM_OP_LOADI: fprintf(out, " r%u, %d\n", inst->a, vm_wide(inst)); break;
+        case VM_OP_LOADK: fprintf(out, " r%u, k%d\n", inst->a, vm_wide(inst)); break;
+        case VM_OP_JILTI:
+        case VM_OP_JILEI:
+        case VM_OP_JIGTI:
+        case VM_OP_JIGEI:
+        case VM_OP_JIEQI:
+        case VM_OP_JINEI: fprintf(out, " r%u, %d\n", inst->a, (int16_t)inst->b); break;
+        case VM_OP_ADDI: fprintf(out, " r%u, r%u, %d\n", inst->a, inst->b, (int16_t)inst->c); break;
+        case VM_OP_JMP:
+        case VM_OP_EXT: fprintf(out, " -> %zu\n", (size_t)((int64_t)i + 1 + vm_wide(inst))); break;
+        case VM_OP_JMPF: fprintf(out, " r%u -> %zu\n", inst->a, (size_t)((int64_t)i + 1 + vm_wide(inst))); break;
+        case VM_OP_CALL:
+        case VM_OP_TAILCALL: {
+            const VMCallSite *site = &program->calls[inst->c];
+            fprintf(out, " r%u, %s(r%u, %u args)\n", inst->a, program->functions[site->function].name, inst->b, site->argc);
+            break;
+        }
+        case VM_OP_SWITCH: fprintf(out, " r%u, table %d\n", inst->a, vm_wide(inst)); break;
+        case VM_OP_UNSUPPORTED: fprintf(out, " \"%s\"\n", program->messages[vm_wide(inst)]); break;
+        case VM_OP_TRAP: fputc('\n', out); break;
+        default: fprintf(out, " r%u, r%u, r%u\n", inst->a, inst->b, inst->c); break;
+        }
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Interpreter
+
+#define NOVA_VM_STACK_REGISTERS (1u << 20)
+#define NOVA_VM_MAX_FRAMES (1u << 18)
+
+typedef struct {
+    const VMInst *return_ip;
+    VMReg *base;
+    const VMFunction *fn;
+    uint16_t dst;
+} VMFrame;
+
+struct NovaVM {
+    NovaVMProgram *program;
+    NovaGC *gc;
+    VMReg *stack;
+    VMReg *high_water; // registers above it have never been written
+    VMFrame *frames;
+    char error[256];
+};
+
+// Registers hold untagged words, so they are scanned conservatively: any
+// word that is a live object's payload keeps it alive.
+static void vm_scan_registers(NovaGC *gc, void *ctx) {
+    NovaVM *vm = static_cast<NovaVM *>(ctx);
+    for (VMReg *reg = vm->stack; reg < vm->high_water; ++reg) {
+        if (reg->p && !(reg->u & 1) && nova_gc_owns(gc, reg->p)) nova_gc_mark_ptr(gc, reg->p);
+    }
+}
+
+// Object fields are immutable once built, so tracing needs no barrier.
+static void vm_trace_object(NovaGC *gc, void *payload) {
+    VMObject *object = static_cast<VMObject *>(payload);
+    for (uint32_t i = 0; i < object->count; ++i) {
+        void *field = vm_fields(object)[i].p;
+        if (field && !(vm_fields(object)[i].u & 1) && nova_gc_owns(gc, field)) nova_gc_mark_ptr(gc, field);
+    }
+}
+
+NovaVM *nova_vm_create(NovaVMProgram *program) {
+    if (!program) return NULL;
+    NovaVM *vm = static_cast<NovaVM *>(calloc(1, sizeof(NovaVM)));
+    if (!vm) return NULL;
+    vm->program = program;
+    vm->gc = nova_gc_create(NULL);
+    vm->stack = static_cast<VMReg *>(calloc(NOVA_VM_STACK_REGISTERS, sizeof(VMReg)));
+    vm->frames = static_cast<VMFrame *>(calloc(NOVA_VM_MAX_FRAMES, sizeof(VMFrame)));
+    if (!vm->gc || !vm->stack || !vm->frames) {
+        nova_vm_free(vm);
+        return NULL;
+    }
+    vm->high_water = vm->stack;
+    nova_gc_set_root_scanner(vm->gc, vm_scan_registers, vm);
+    return vm;
+}
+
+void nova_vm_free(NovaVM *vm) {
+    if (!vm) return;
+    nova_gc_destroy(vm->gc);
+    free(vm->stack);
+    free(vm->frames);
+    free(vm);
+}
+
+NovaGCStats nova_vm_gc_stats(const NovaVM *vm) {
+    NovaGCStats stats;
+    memset(&stats, 0, sizeof(stats));
+    return vm ? nova_gc_stats(vm->gc) : stats;
+}
+
+static int64_t vm_int_from_f64(double value) {
+    if (value != value) return 0;
+    if (value >= 9223372036854775808.0) return INT64_MAX;
+    if (value < -9223372036854775808.0) return INT64_MIN;
+    return (int64_t)value;
+}
+
+static VMObject *vm_new_object(NovaVM *vm, uint32_t tag, uint32_t count) {
+    VMObject *object = static_cast<VMObject *>(nova_gc_alloc(vm->gc, sizeof(VMObject) + count * sizeof(VMReg), vm_trace_object, NULL));
+    if (object) {
+        object->tag = tag;
+        object->count = count;
+    }
+    return object;
+}
+
+#if defined(NOVA_VM_COMPUTED_GOTO)
+// Labels as values are a GNU extension.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#define VM_CASE(name) op_##name:
+#define VM_DISPATCH() goto *dispatch_table[ip->op]
+#else
+#define VM_CASE(name) case VM_OP_##name:
+#define VM_DISPATCH() goto dispatch
+#endif
+
+#define VM_FAIL(...)                                                 \
+    do {                                                             \
+        snprintf(vm->error, sizeof(vm->error), __VA_ARGS__);         \
+        return false;                                                \
+    } while (0)
+
+// Runs fn with its arguments already in base[0..]. Frames are windows onto
+// one register stack: a call's frame starts after its caller's registers.
+static bool vm_run(NovaVM *vm, const VMFunction *entry, VMReg *base, VMReg *result) {
+#if defined(NOVA_VM_COMPUTED_GOTO)
+    static const void *const dispatch_table[] = {
+#define NOVA_VM_LABEL(name) &&op_##name,
+        NOVA_VM_OPCODES(NOVA_VM_LABEL)
+#undef NOVA_VM_LABEL
+    };
+#endif
+    NovaVMProgram *program = vm->program;
+    const VMFunction *functions = program->functions;
+    const uint64_t *constants = program->constants;
+    VMReg *const stack_end = vm->stack + NOVA_VM_STACK_REGISTERS;
+    VMFrame *const frames_end = vm->frames + NOVA_VM_MAX_FRAMES;
+    VMFrame *frame = vm->frames;
+    const VMFunction *fn = entry;
+    const VMInst *ip = fn->code;
+    VMReg *r = base;
+    if (r + fn->frame_size > stack_end) VM_FAIL("stack overflow");
+    if (r + fn->frame_size > vm->high_water) vm->high_water = r + fn->frame_size;
+
+#if defined(NOVA_VM_COMPUTED_GOTO)
+    VM_DISPATCH();
+#else
+dispatch:
+    switch ((VMOp)ip->op) {
+#endif
+    VM_CASE(MOVE) {
+        r[ip->a] = r[ip->b];
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(LOADI) {
+        r[ip->a].i = vm_wide(ip);
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(LOADK) {
+        r[ip->a].u = constants[(uint32_t)vm_wide(ip)];
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(IADD) {
+        r[ip->a].u = r[ip->b].u + r[ip->c].u;
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(ISUB) {
+        r[ip->a].u = r[ip->b].u - r[ip->c].u;
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(IMUL) {
+        r[ip->a].u = r[ip->b].u * r[ip->c].u;
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(IDIV) {
+        int64_t divisor = r[ip->c].i;
+        if (divisor == 0) VM_FAIL("division by zero in %s", fn->name);
+        r[ip->a].i = divisor == -1 ? (int64_t)(0 - r[ip->b].u) : r[ip->b].i / divisor;
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(IREM) {
+        int64_t divisor = r[ip->c].i;
+        if (divisor == 0) VM_FAIL("division by zero in %s", fn->name);
+        r[ip->a].i = divisor == -1 ? 0 : r[ip->b].i % divisor;
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(ADDI) {
+        r[ip->a].u = r[ip->b].u + (uint64_t)(int64_t)(int16_t)ip->c;
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(INEG) {
+        r[ip->a].u = 0 - r[ip->b].u;
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(ILT) {
+        r[ip->a].i = r[ip->b].i < r[ip->c].i;
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(ILE) {
+        r[ip->a].i = r[ip->b].i <= r[ip->c].i;
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(IEQ) {
+        r[ip->a].i = r[ip->b].i == r[ip->c].i;
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(INE) {
+        r[ip->a].i = r[ip->b].i != r[ip->c].i;
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(FADD) {
+        r[ip->a].f = r[ip->b].f + r[ip->c].f;
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(FSUB) {
+        r[ip->a].f = r[ip->b].f - r[ip->c].f;
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(FMUL) {
+        r[ip->a].f = r[ip->b].f * r[ip->c].f;
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(FDIV) {
+        r[ip->a].f = r[ip->b].f / r[ip->c].f;
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(FREM) {
+        r[ip->a].f = fmod(r[ip->b].f, r[ip->c].f);
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(FNEG) {
+        r[ip->a].f = -r[ip->b].f;
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(FLT) {
+        r[ip->a].i = r[ip->b].f < r[ip->c].f;
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(FLE) {
+        r[ip->a].i = r[ip->b].f <= r[ip->c].f;
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(FEQ) {
+        r[ip->a].i = r[ip->b].f == r[ip->c].f;
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(FNE) {
+        r[ip->a].i = r[ip->b].f != r[ip->c].f;
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(NOT) {
+        r[ip->a].i = !r[ip->b].i;
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(I2F) {
+        r[ip->a].f = (double)r[ip->b].i;
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(F2I) {
+        r[ip->a].i = vm_int_from_f64(r[ip->b].f);
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(JMP) {
+        ip += 1 + vm_wide(ip);
+        VM_DISPATCH();
+    }
+    VM_CASE(JMPF) {
+        ip += 1 + (r[ip->a].i ? 0 : vm_wide(ip));
+        VM_DISPATCH();
+    }
+#define VM_FUSED_BRANCH(name, field, op)                       \
+    VM_CASE(name) {                                            \
+        bool taken = !(r[ip->a].field op r[ip->b].field);      \
+        ip += 2 + (taken ? vm_wide(ip + 1) : 0);               \
+        VM_DISPATCH();                                         \
+    }
+    VM_FUSED_BRANCH(JILT, i, <)
+    VM_FUSED_BRANCH(JILE, i, <=)
+    VM_FUSED_BRANCH(JIEQ, i, ==)
+    VM_FUSED_BRANCH(JINE, i, !=)
+    VM_FUSED_BRANCH(JFLT, f, <)
+    VM_FUSED_BRANCH(JFLE, f, <=)
+    VM_FUSED_BRANCH(JFEQ, f, ==)
+    VM_FUSED_BRANCH(JFNE, f, !=)
+#define VM_FUSED_BRANCH_IMMEDIATE(name, op)                    \
+    VM_CASE(name) {                                            \
+        bool taken = !(r[ip->a].i op (int16_t)ip->b);          \
+        ip += 2 + (taken ? vm_wide(ip + 1) : 0);               \
+        VM_DISPATCH();                                         \
+    }
+    VM_FUSED_BRANCH_IMMEDIATE(JILTI, <)
+    VM_FUSED_BRANCH_IMMEDIATE(JILEI, <=)
+    VM_FUSED_BRANCH_IMMEDIATE(JIGTI, >)
+    VM_FUSED_BRANCH_IMMEDIATE(JIGEI, >=)
+    VM_FUSED_BRANCH_IMMEDIATE(JIEQI, ==)
+    VM_FUSED_BRANCH_IMMEDIATE(JINEI, !=)
+#undef VM_FUSED_BRANCH_IMMEDIATE
+#undef VM_FUSED_BRANCH
+    VM_CASE(EXT) {
+        VM_FAIL("bytecode error in %s", fn->name);
+    }
+    VM_CASE(CALL) {
+        const VMCallSite *site = &program->calls[ip->c];
+        const VMFunction *callee = &functions[site->function];
+        VMReg *callee_base = r + fn->frame_size;
+        if (frame + 1 >= frames_end || callee_base + callee->frame_size > stack_end) VM_FAIL("stack overflow");
+        if (callee_base + callee->frame_size > vm->high_water) vm->high_water = callee_base + callee->frame_size;
+        for (uint32_t i = 0; i < site->argc; ++i) callee_base[i] = r[ip->b + i];
+        frame->return_ip = ip + 1;
+        frame->base = r;
+        frame->fn = fn;
+        frame->dst = ip->a;
+        ++frame;
+        fn = callee;
+        r = callee_base;
+        ip = fn->code;
+        VM_DISPATCH();
+    }
+    VM_CASE(TAILCALL) {
+        // The callee takes over the caller's frame.
+        const VMCallSite *site = &program->calls[ip->c];
+        const VMFunction *callee = &functions[site->function];
+        if (r + callee->frame_size > stack_end) VM_FAIL("stack overflow");
+        if (r + callee->frame_size > vm->high_water) vm->high_water = r + callee->frame_size;
+        for (uint32_t i = 0; i < site->argc; ++i) r[i] = r[ip->b + i];
+        fn = callee;
+        ip = fn->code;
+        VM_DISPATCH();
+    }
+    VM_CASE(APPLY) {
+        VMApplySite *site = &program->applies[ip->c];
+        VMReg callee_value = r[ip->b];
+        const VMObject *closure = (callee_value.u & 1) ? NULL : static_cast<const VMObject *>(callee_value.p);
+        uint32_t function = closure ? closure->tag : (uint32_t)(callee_value.u >> 1);
+        const VMFunction *callee = site->cached;
+        if (function != site->cached_function) {
+            callee = &functions[function];
+            uint32_t captures = closure ? closure->count : 0;
+            if (callee->param_count != captures + site->argc) VM_FAIL("function value called with the wrong number of arguments in %s", fn->name);
+            site->cached_function = function;
+            site->cached = callee;
+        }
+        VMReg *callee_base = r + fn->frame_size;
+        if (frame + 1 >= frames_end || callee_base + callee->frame_size > stack_end) VM_FAIL("stack overflow");
+        if (callee_base + callee->frame_size > vm->high_water) vm->high_water = callee_base + callee->frame_size;
+        uint32_t captured = 0;
+        if (closure) {
+            for (; captured < closure->count; ++captured) callee_base[captured] = vm_fields(closure)[captured];
+        }
+        for (uint32_t i = 0; i < site->argc; ++i) callee_base[captured + i] = r[ip->b + 1 + i];
+        frame->return_ip = ip + 1;
+        frame->base = r;
+        frame->fn = fn;
+        frame->dst = ip->a;
+        ++frame;
+        fn = callee;
+        r = callee_base;
+        ip = fn->code;
+        VM_DISPATCH();
+    }
+    VM_CASE(RET) {
+        VMReg value = r[ip->a];
+        if (frame == vm->frames) {
+            *result = value;
+            return true;
+        }
+        --frame;
+        r = frame->base;
+        fn = frame->fn;
+        r[frame->dst] = value;
+        ip = frame->return_ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(CLOSURE)
+    VM_CASE(CONSTRUCT) {
+        const VMShape *shape = &program->shapes[ip->c];
+        VMObject *object = vm_new_object(vm, shape->tag, shape->count);
+        if (!object) VM_FAIL("out of memory");
+        for (uint32_t i = 0; i < shape->count; ++i) vm_fields(object)[i] = r[ip->b + i];
+        r[ip->a].p = object;
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(TAG) {
+        VMReg value = r[ip->b];
+        r[ip->a].u = (value.u & 1) ? value.u >> 1 : static_cast<const VMObject *>(value.p)->tag;
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(FIELD) {
+        r[ip->a] = vm_fields(static_cast<const VMObject *>(r[ip->b].p))[ip->c];
+        ++ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(SWITCH) {
+        const int32_t *table = program->switches + vm_wide(ip);
+        uint64_t tag = r[ip->a].u;
+        ip += 1 + (tag < (uint64_t)table[0] ? table[2 + tag] : table[1]);
+        VM_DISPATCH();
+    }
+    VM_CASE(TRAP) {
+        VM_FAIL("no match arm applies in %s", fn->name);
+    }
+    VM_CASE(UNSUPPORTED) {
+        VM_FAIL("%s", program->messages[vm_wide(ip)]);
+    }
+#if !defined(NOVA_VM_COMPUTED_GOTO)
+    }
+    VM_FAIL("bytecode error in %s", fn->name);
+#endif
+}
+
+#if defined(NOVA_VM_COMPUTED_GOTO)
+#pragma GCC diagnostic pop
+#endif
+#undef VM_CASE
+#undef VM_DISPATCH
+#undef VM_FAIL
+
+bool nova_vm_call(NovaVM *vm, const char *function, const NovaVMValue *args, size_t arg_count, NovaVMValue *result, char *error_buffer, size_t error_buffer_size) {
+    if (!vm || !function || !result) return false;
+    const VMFunction *fn = vm_find_function(vm->program, function);
+    if (!fn || fn->param_count != arg_count) {
+        if (error_buffer && error_buffer_size > 0) {
+            snprintf(error_buffer, error_buffer_size, fn ? "%s takes %u arguments" : "unknown function %s", function, fn ? fn->param_count : 0);
+        }
+        return false;
+    }
+    for (size_t i = 0; i < arg_count; ++i) {
+        switch (args[i].kind) {
+        case NOVA_TYPE_KIND_INT: vm->stack[i].i = args[i].as.int_value; break;
+        case NOVA_TYPE_KIND_BOOL: vm->stack[i].i = args[i].as.bool_value ? 1 : 0; break;
+        case NOVA_TYPE_KIND_UNIT: vm->stack[i].i = 0; break;
+        case NOVA_TYPE_KIND_NUMBER: vm->stack[i].f = args[i].as.number; break;
+        default: vm->stack[i].p = const_cast<void *>(args[i].as.object); break;
+        }
+    }
+    VMReg value;
+    value.u = 0;
+    if (!vm_run(vm, fn, vm->stack, &value)) {
+        if (error_buffer && error_buffer_size > 0) snprintf(error_buffer, error_buffer_size, "%s", vm->error);
+        return false;
+    }
+    result->kind = fn->result_kind;
+    switch (fn->result_kind) {
+    case NOVA_TYPE_KIND_INT: result->as.int_value = value.i; break;
+    case NOVA_TYPE_KIND_BOOL: result->as.bool_value = value.i != 0; break;
+    case NOVA_TYPE_KIND_UNIT: result->as.int_value = 0; break;
+    case NOVA_TYPE_KIND_NUMBER: result->as.number = value.f; break;
+    default: result->as.object = value.p; break;
+    }
+    return true;
+}
@@ -1,5 +1,7 @@
 #include <assert.h>
+#include <math.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -15,6 +17,7 @@
 #include <direct.h>
 #include <process.h>
 #else
+#include <dirent.h>
 #include <unistd.h>
 extern int setenv(const char *name, const char *value, int overwrite);
 extern int unsetenv(const char *name);
@@ -26,9 +29,16 @@ extern int unsetenv(const char *name);
 
 #include "nova/codegen.h"
 #include "nova/ir.h"
+#include "nova/jit.h"
+#include "nova/layout.h"
 #include "nova/lexer.h"
+#include "nova/match.h"
+#include "nova/numconv.h"
+#include "nova/optimize.h"
 #include "nova/parser.h"
+#include "nova/profile.h"
 #include "nova/semantic.h"
+#include "nova/vm.h"
 #include "nova/gc.h"
 
 static const char *CORE_PROGRAM =
@@ -314,6 +324,51 @@ static void test_gc_mock_allocator_and_failure(void) {
     assert(allocator.free_calls > 0);
 }
 
+static void scan_mock_stack(NovaGC *gc, void *ctx) {
+    void **words = static_cast<void **>(ctx);
+    for (size_t i = 0; i < 4; ++i) {
+        if (nova_gc_owns(gc, words[i])) nova_gc_mark_ptr(gc, words[i]);
+    }
+}
+
+static void test_gc_root_scanner_and_ownership(void) {
+    NovaGC *gc = nova_gc_create(NULL);
+    assert(gc != NULL);
+    MockNode *kept = static_cast<MockNode *>(nova_gc_alloc(gc, sizeof(MockNode), mock_node_trace, NULL));
+    MockNode *dropped = static_cast<MockNode *>(nova_gc_alloc(gc, sizeof(MockNode), mock_node_trace, NULL));
+    assert(kept != NULL && dropped != NULL);
+    assert(nova_gc_owns(gc, kept) && nova_gc_owns(gc, dropped));
+    assert(!nova_gc_owns(gc, (const char *)kept + 8) && !nova_gc_owns(gc, (void *)1) && !nova_gc_owns(gc, NULL));
+
+    // Words that only might be pointers are checked before they are marked.
+    MockNode local{};
+    void *words[4] = {kept, &local, (void *)1, (void *)0x10};
+    nova_gc_set_root_scanner(gc, scan_mock_stack, words);
+    nova_gc_collect(gc);
+    assert(nova_gc_stats(gc).objects_total == 1);
+    assert(nova_gc_owns(gc, kept));
+
+    // An object allocated while marking is under way survives the sweep. The
+    // chain keeps marking going for a few steps.
+    words[0] = NULL;
+    MockNode *chain = NULL;
+    for (size_t i = 0; i < 4; ++i) {
+        MockNode *node = static_cast<MockNode *>(nova_gc_alloc(gc, sizeof(MockNode), mock_node_trace, NULL));
+        assert(node != NULL);
+        node->child = chain;
+        chain = node;
+    }
+    words[2] = chain;
+    nova_gc_collect_step(gc, 1);
+    assert(nova_gc_stats(gc).collection_in_progress);
+    MockNode *fresh = static_cast<MockNode *>(nova_gc_alloc(gc, sizeof(MockNode), mock_node_trace, NULL));
+    assert(fresh != NULL);
+    while (nova_gc_stats(gc).collection_in_progress) nova_gc_collect_step(gc, 1);
+    assert(nova_gc_owns(gc, fresh) && !nova_gc_owns(gc, kept));
+    assert(nova_gc_stats(gc).objects_total == 5);
+    nova_gc_destroy(gc);
+}
+
 static void test_parser_and_semantics(void) {
     NovaParser parser;
     nova_parser_init(&parser, CORE_PROGRAM);
@@ -418,6 +473,91 @@ static void test_lexer_large_input_tokenization(void) {
     free(source);
 }
 
+static void test_number_conversions(void) {
+    double value = 0.0;
+    const char *halfway = "9007199254740993.0000000000000000000001";
+    assert(nova_number_parse(halfway, strlen(halfway), &value) && value == 9007199254740994.0);
+    assert(nova_number_parse("2.4703282292062328e-324", 23, &value) && value == 4.9406564584124654e-324);
+    assert(nova_number_parse("1.7976931348623159e308", 22, &value) && value > 1.7976931348623157e308);
+    // Only the span is read: the digits after it belong to the next token.
+    assert(nova_number_parse("12.5e3", 4, &value) && value == 12.5);
+    assert(!nova_number_parse("1.", 2, &value) && !nova_number_parse("e5", 2, &value));
+    int64_t integer = 0;
+    assert(nova_integer_parse("9223372036854775807", 19, &integer) && integer == INT64_MAX);
+    assert(!nova_integer_parse("9223372036854775808", 19, &integer));
+
+    char buffer[NOVA_NUMBER_BUFFER_SIZE];
+    const struct {
+        double value;
+        const char *text;
+    } printed[] = {{0.1, "0.1"}, {0.1 + 0.2, "0.30000000000000004"}, {3.0, "3.0"}, {-2.5, "-2.5"}, {-0.0, "-0.0"},
+                   {1e21, "1.0e21"}, {123456.0, "123456.0"}, {0.00001, "0.00001"}, {5e-324, "5.0e-324"},
+                   {1.7976931348623157e308, "1.7976931348623157e308"}};
+    for (size_t i = 0; i < sizeof(printed) / sizeof(printed[0]); ++i) {
+        size_t length = nova_number_format(printed[i].value, buffer);
+        assert(length == strlen(printed[i].text) && strcmp(buffer, printed[i].text) == 0);
+    }
+    // Results shown by nova-check --run and nova-repl also cover non-finite values.
+    assert(nova_number_show(0.1 + 0.2, buffer) == 19 && strcmp(buffer, "0.30000000000000004") == 0);
+    assert(nova_number_show(-INFINITY, buffer) == 4 && strcmp(buffer, "-inf") == 0);
+    assert(nova_number_show(NAN, buffer) == 3 && strcmp(buffer, "nan") == 0);
+    uint64_t state = 88172645463325252ull;
+    for (int i = 0; i < 100000; ++i) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        double random;
+        memcpy(&random, &state, sizeof(random));
+        if (!isfinite(random)) continue;
+        size_t length = nova_number_format(random, buffer);
+        assert(length < sizeof(buffer) && nova_number_parse(buffer + (buffer[0] == '-'), length - (buffer[0] == '-'), &value));
+        assert(fabs(value) == fabs(random) && strtod(buffer, NULL) == random);
+    }
+
+    // Literals longer than any fixed buffer keep every digit that matters, and
+    // constants come out as their shortest spelling.
+    const char *source =
+        "module demo.numbers\n"
+        "fun pick(x: Number): Int = match x { 0.1000000000000000055511151231257827021181583404541015625 -> 3; _ -> 1 }\n"
+        "fun app_entry(): Int = pick(0.1) + pick(0.30000000000000004)\n";
+    NovaParser parser;
+    nova_parser_init(&parser, source);
+    NovaProgram *program = nova_parser_parse(&parser);
+    assert(program != NULL);
+    NovaSemanticContext ctx;
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+    assert(ctx.diagnostics.count == 0);
+    NovaIRProgram *ir = nova_ir_lower(program, &ctx);
+    assert(ir != NULL);
+
+    char error[256] = {0};
+    const char *ir_path = "build/nova-numbers.ll";
+    assert(nova_codegen_emit_llvm_ir(ir, &ctx, ir_path, error, sizeof(error)));
+    char *text = read_file_contents(ir_path);
+    assert(text != NULL);
+    assert(strstr(text, "fcmp oeq double %") != NULL && strstr(text, ", 0.1\n") != NULL);
+    assert(strstr(text, "0.30000000000000004") != NULL && strstr(text, "0.10000000000000001") == NULL);
+    free(text);
+    remove(ir_path);
+
+#ifndef _WIN32
+    const char *exe_path = "build/nova-numbers";
+    bool ok = nova_codegen_emit_executable(ir, &ctx, exe_path, "app_entry", error, sizeof(error));
+    assert(ok && "AOT executable generation failed for number literals");
+    int rc = system("./build/nova-numbers");
+    assert(WIFEXITED(rc));
+    assert(WEXITSTATUS(rc) == 4);
+    remove(exe_path);
+#endif
+
+    nova_ir_free(ir);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+}
+
 static void test_match_exhaustiveness_warning(void) {
     const char *source =
         "module demo.flags\n"
@@ -517,6 +657,76 @@ static void test_codegen_uses_low_latency_flags(void) {
     cleanup_dir(dir);
 }
 
+static void test_codegen_pipes_source_to_compiler(void) {
+    char path_template[] = "build/nova_pipeXXXXXX";
+    char *dir = make_temp_dir(path_template);
+    assert(dir != NULL);
+
+    // The mock keeps what arrives on stdin and fails with a diagnostic.
+    char cc_path[PATH_MAX], stdin_path[PATH_MAX], script[PATH_MAX * 2];
+    snprintf(cc_path, sizeof(cc_path), "%s/mock_cc.sh", dir);
+    snprintf(stdin_path, sizeof(stdin_path), "%s/stdin.c", dir);
+    snprintf(script,
+             sizeof(script),
+             "#!/usr/bin/env bash\n"
+             "cat > %s\n"
+             "echo \"mock: cannot compile\" >&2\n"
+             "exit 3\n",
+             stdin_path);
+    assert(write_file_contents(cc_path, script));
+#ifndef _WIN32
+    assert(chmod(cc_path, 0700) == 0);
+#endif
+    nova_setenv("NOVA_CC", cc_path);
+
+    const char *source =
+        "module demo.pipes\n"
+        "fun app_entry(): Int = 7\n";
+    NovaParser parser;
+    nova_parser_init(&parser, source);
+    NovaProgram *program = nova_parser_parse(&parser);
+    assert(program != NULL);
+    NovaSemanticContext ctx;
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+    assert(ctx.diagnostics.count == 0);
+    NovaIRProgram *ir = nova_ir_lower(program, &ctx);
+    assert(ir != NULL);
+
+    char exe_path[PATH_MAX];
+    snprintf(exe_path, sizeof(exe_path), "%s/app", dir);
+    char error[256] = {0};
+    assert(!nova_codegen_emit_executable(ir, &ctx, exe_path, "app_entry", error, sizeof(error)));
+    assert(strstr(error, "(cc exit 3): mock: cannot compile") != NULL);
+
+    // The program and its main arrive as one translation unit, and nothing
+    // is staged next to the output.
+    char *text = read_file_contents(stdin_path);
+    assert(text != NULL);
+    assert(strstr(text, "int64_t app_entry(void)") != NULL);
+    assert(strstr(text, "int main(void)") != NULL);
+    free(text);
+    char staged[PATH_MAX + 16];
+    snprintf(staged, sizeof(staged), "%s.merge.c", exe_path);
+    assert(read_file_contents(staged) == NULL);
+    snprintf(staged, sizeof(staged), "%s.c", exe_path);
+    assert(read_file_contents(staged) == NULL);
+
+    snprintf(cc_path, sizeof(cc_path), "%s/missing_cc", dir);
+    nova_setenv("NOVA_CC", cc_path);
+    assert(!nova_codegen_emit_executable(ir, &ctx, exe_path, "app_entry", error, sizeof(error)));
+    assert(strstr(error, "(cannot run cc)") != NULL);
+    nova_setenv("NOVA_CC", NULL);
+
+    nova_ir_free(ir);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+
+    cleanup_dir(dir);
+}
+
 static void test_aot_executable_generation(void) {
     const char *source =
         "module demo.aot\n"
@@ -558,6 +768,385 @@ static void test_aot_executable_generation(void) {
     nova_parser_free(&parser);
 }
 
+static void test_partitioned_codegen(void) {
+    char path_template[] = "build/nova_partsXXXXXX";
+    char *dir = make_temp_dir(path_template);
+    assert(dir != NULL);
+
+    const size_t function_count = 200;
+    size_t capacity = function_count * 160 + 1024;
+    char *source = static_cast<char *>(malloc(capacity));
+    assert(source != NULL);
+    size_t used = (size_t)snprintf(source, capacity, "module demo.parts\ntype Pair = Pair(Int, Int)\n");
+    for (size_t i = 0; i < function_count; ++i) {
+        switch (i % 4) {
+        case 0:
+            used += (size_t)snprintf(source + used, capacity - used, "fun f%zu(x: Int): Int = x + %zu\n", i, i % 7);
+            break;
+        case 1:
+            used += (size_t)snprintf(source + used, capacity - used, "fun f%zu(x: Int): Int = { let add = (y: Int) -> y + x; add(%zu) + f%zu(x) }\n", i, i % 5, i - 1);
+            break;
+        case 2:
+            used += (size_t)snprintf(source + used, capacity - used, "fun mk%zu(n: Int) = (y: Int) -> y * n\nfun f%zu(x: Int): Int = mk%zu(x)(2) + f%zu(x)\n", i, i, i, i - 2);
+            break;
+        default:
+            used += (size_t)snprintf(source + used, capacity - used, "fun f%zu(x: Int): Int = match Pair(x, %zu) { Pair(a, b) -> a + b %% 11 + f%zu(x) %% 13 }\n", i, i, i - 1);
+            break;
+        }
+    }
+    used += (size_t)snprintf(source + used, capacity - used, "fun app_entry(): Int = (f%zu(3) + f%zu(4) + f%zu(5)) %% 256\n", function_count - 1, function_count / 2 + 1, function_count / 4 + 2);
+    assert(used < capacity);
+
+    NovaParser parser;
+    nova_parser_init(&parser, source);
+    NovaProgram *program = nova_parser_parse(&parser);
+    assert(program != NULL && !parser.had_error);
+    NovaSemanticContext ctx;
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+    assert(ctx.diagnostics.count == 0);
+    NovaIRProgram *ir = nova_ir_lower(program, &ctx);
+    assert(ir != NULL);
+
+    // Units come out balanced, and lifted lambdas stay with the functions
+    // referring to them so they can remain static.
+    size_t *unit_of = static_cast<size_t *>(calloc(ir->function_count, sizeof(size_t)));
+    assert(unit_of != NULL);
+    assert(nova_codegen_partition(ir, 1, unit_of) == 1);
+    assert(nova_codegen_partition(ir, 4, unit_of) == 4);
+    size_t per_unit[4] = {0, 0, 0, 0};
+    for (size_t i = 0; i < ir->function_count; ++i) per_unit[unit_of[i]]++;
+    for (size_t u = 0; u < 4; ++u) assert(per_unit[u] > ir->function_count / 8);
+    NovaIRCallGraph graph;
+    assert(nova_ir_call_graph_build(ir, &graph));
+    size_t lifted = 0;
+    for (size_t i = 0; i < ir->function_count; ++i) {
+        for (size_t c = 0; c < graph.nodes[i].callee_count; ++c) {
+            size_t callee = graph.nodes[i].callees[c];
+            if (!ir->functions[callee].lifted) continue;
+            lifted++;
+            assert(unit_of[i] == unit_of[callee]);
+        }
+    }
+    assert(lifted >= function_count / 4);
+    nova_ir_call_graph_free(&graph);
+    free(unit_of);
+
+    // The partitioned build links to the same program as the single unit.
+    char single_path[PATH_MAX], parts_path[PATH_MAX], object_path[PATH_MAX];
+    snprintf(single_path, sizeof(single_path), "%s/single", dir);
+    snprintf(parts_path, sizeof(parts_path), "%s/parts", dir);
+    snprintf(object_path, sizeof(object_path), "%s/parts.o", dir);
+    char error[512] = {0};
+    nova_setenv("NOVA_CODEGEN_JOBS", "1");
+    assert(nova_codegen_emit_executable(ir, &ctx, single_path, "app_entry", error, sizeof(error)));
+    nova_setenv("NOVA_CODEGEN_JOBS", "4");
+    bool ok = nova_codegen_emit_executable(ir, &ctx, parts_path, "app_entry", error, sizeof(error));
+    if (!ok) fprintf(stderr, "%s\n", error);
+    assert(ok);
+    assert(nova_codegen_emit_object(ir, &ctx, object_path, error, sizeof(error)));
+    nova_setenv("NOVA_CODEGEN_JOBS", NULL);
+    struct stat st;
+    assert(stat(object_path, &st) == 0);
+
+#ifndef _WIN32
+    int single_rc = system(single_path);
+    int parts_rc = system(parts_path);
+    assert(WIFEXITED(single_rc) && WIFEXITED(parts_rc));
+    assert(WEXITSTATUS(single_rc) == WEXITSTATUS(parts_rc));
+#endif
+
+    nova_ir_free(ir);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+    free(source);
+    cleanup_dir(dir);
+}
+
+#ifndef _WIN32
+static size_t count_dir_entries(const char *path) {
+    DIR *dir = opendir(path);
+    assert(dir != NULL);
+    size_t count = 0;
+    for (struct dirent *entry = readdir(dir); entry; entry = readdir(dir)) {
+        if (entry->d_name[0] != '.') count++;
+    }
+    closedir(dir);
+    return count;
+}
+
+// Builds a chain of function_count functions with NOVA_CACHE_DIR set and
+// returns the executable's exit status; function `edited` adds `bump`.
+static int build_cached_chain(const char *dir, size_t function_count, size_t edited, size_t bump) {
+    size_t capacity = function_count * 64 + 256;
+    char *source = static_cast<char *>(malloc(capacity));
+    assert(source != NULL);
+    size_t used = (size_t)snprintf(source, capacity, "module demo.cached\nfun f0(x: Int): Int = x\n");
+    for (size_t i = 1; i < function_count; ++i) {
+        used += (size_t)snprintf(source + used, capacity - used, "fun f%zu(x: Int): Int = (f%zu(x) + %zu) %% 1009\n", i, i - 1, i % 7 + (i == edited ? bump : 0));
+    }
+    used += (size_t)snprintf(source + used, capacity - used, "fun app_entry(): Int = f%zu(1) %% 256\n", function_count - 1);
+    assert(used < capacity);
+
+    NovaParser parser;
+    nova_parser_init(&parser, source);
+    NovaProgram *program = nova_parser_parse(&parser);
+    assert(program != NULL && !parser.had_error);
+    NovaSemanticContext ctx;
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+    assert(ctx.diagnostics.count == 0);
+    NovaIRProgram *ir = nova_ir_lower(program, &ctx);
+    assert(ir != NULL);
+
+    char cache_path[PATH_MAX], exe_path[PATH_MAX];
+    snprintf(cache_path, sizeof(cache_path), "%s/cache", dir);
+    snprintf(exe_path, sizeof(exe_path), "%s/cached", dir);
+    char error[512] = {0};
+    nova_setenv("NOVA_CACHE_DIR", cache_path);
+    bool ok = nova_codegen_emit_executable(ir, &ctx, exe_path, "app_entry", error, sizeof(error));
+    nova_setenv("NOVA_CACHE_DIR", NULL);
+    if (!ok) fprintf(stderr, "%s\n", error);
+    assert(ok);
+    int rc = system(exe_path);
+    assert(WIFEXITED(rc));
+    remove(exe_path);
+
+    nova_ir_free(ir);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+    free(source);
+    return WEXITSTATUS(rc);
+}
+#endif
+
+static void test_object_cache(void) {
+#ifndef _WIN32
+    char path_template[] = "build/nova_cacheXXXXXX";
+    char *dir = make_temp_dir(path_template);
+    assert(dir != NULL);
+    char cache_path[PATH_MAX];
+    snprintf(cache_path, sizeof(cache_path), "%s/cache", dir);
+
+    const size_t function_count = 160;
+    int before = 1, after = 1;
+    for (size_t i = 1; i < function_count; ++i) {
+        before = (before + (int)(i % 7)) % 1009;
+        after = (after + (int)(i % 7) + (i == 100 ? 5 : 0)) % 1009;
+    }
+
+    // The cache splits even a small program into several units.
+    assert(build_cached_chain(dir, function_count, 0, 0) == before % 256);
+    size_t objects = count_dir_entries(cache_path);
+    assert(objects >= 3);
+
+    // A rebuild compiles nothing, and editing one function recompiles only
+    // its unit.
+    assert(build_cached_chain(dir, function_count, 0, 0) == before % 256);
+    assert(count_dir_entries(cache_path) == objects);
+    assert(build_cached_chain(dir, function_count, 100, 5) == after % 256);
+    assert(count_dir_entries(cache_path) == objects + 1);
+
+    cleanup_dir(dir);
+#endif
+}
+
+#ifndef _WIN32
+static NovaIRProgram *lower_profiled_program(const char *source, NovaParser *parser, NovaProgram **program, NovaSemanticContext *ctx) {
+    nova_parser_init(parser, source);
+    *program = nova_parser_parse(parser);
+    assert(*program != NULL && !parser->had_error);
+    nova_semantic_context_init(ctx);
+    nova_semantic_analyze_program(ctx, *program);
+    assert(ctx->diagnostics.count == 0);
+    NovaIRProgram *ir = nova_ir_lower(*program, ctx);
+    assert(ir != NULL);
+    return ir;
+}
+
+static const NovaIRFunction *find_ir_function(const NovaIRProgram *ir, const char *name) {
+    for (size_t i = 0; i < ir->function_count; ++i) {
+        const NovaIRFunction *fn = &ir->functions[i];
+        if (fn->name.length == strlen(name) && strncmp(fn->name.lexeme, name, fn->name.length) == 0) return fn;
+    }
+    return NULL;
+}
+#endif
+
+static void test_profile_guided_build(void) {
+#ifndef _WIN32
+    char path_template[] = "build/nova_pgoXXXXXX";
+    char *dir = make_temp_dir(path_template);
+    assert(dir != NULL);
+    const char *source =
+        "module demo.pgo\n"
+        "fun step(x: Int): Int = if x % 50 == 0 { x / 2 } else { x + 3 }\n"
+        "fun walk(i: Int, acc: Int): Int = if i == 0 { acc } else { walk(i - 1, step(acc + i) % 1009) }\n"
+        "fun app_entry(): Int = walk(1000, 1) % 256\n";
+    char profile_dir[PATH_MAX], exe_path[PATH_MAX], cc_path[PATH_MAX], stdin_path[PATH_MAX], script[PATH_MAX * 3];
+    snprintf(profile_dir, sizeof(profile_dir), "%s/profile", dir);
+    snprintf(exe_path, sizeof(exe_path), "%s/app", dir);
+    char error[512] = {0};
+
+    // The instrumented executable appends Nova's counts at exit.
+    NovaParser parser;
+    NovaProgram *program = NULL;
+    NovaSemanticContext ctx;
+    NovaIRProgram *ir = lower_profiled_program(source, &parser, &program, &ctx);
+    nova_setenv("NOVA_PGO_GENERATE", profile_dir);
+    bool ok = nova_codegen_emit_executable(ir, &ctx, exe_path, "app_entry", error, sizeof(error));
+    nova_setenv("NOVA_PGO_GENERATE", NULL);
+    if (!ok) fprintf(stderr, "%s\n", error);
+    assert(ok);
+    int instrumented = system(exe_path);
+    assert(WIFEXITED(instrumented));
+    nova_ir_free(ir);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+
+    char profile_path[PATH_MAX + 32];
+    snprintf(profile_path, sizeof(profile_path), "%s/%s", profile_dir, NOVA_PROFILE_FILE);
+    char *profile = read_file_contents(profile_path);
+    assert(profile != NULL);
+    assert(strstr(profile, "function walk 1001 1\n") != NULL);
+    assert(strstr(profile, "function step 1000 1\n") != NULL);
+    assert(strstr(profile, "branch walk 0 1 1000\n") != NULL);
+    free(profile);
+
+    // Both branches went one way, so both are hinted.
+    ir = lower_profiled_program(source, &parser, &program, &ctx);
+    assert(nova_profile_apply(ir, profile_dir, error, sizeof(error)));
+    assert(ir->profiled);
+    const NovaIRFunction *walk = find_ir_function(ir, "walk");
+    const NovaIRFunction *step = find_ir_function(ir, "step");
+    assert(walk && walk->profile_calls == 1001 && walk->body->kind == NOVA_IR_EXPR_IF);
+    assert(walk->body->as.if_expr.hint == NOVA_IR_BRANCH_UNLIKELY);
+    assert(step && step->profile_calls == 1000 && step->body->kind == NOVA_IR_EXPR_IF);
+    assert(step->body->as.if_expr.hint == NOVA_IR_BRANCH_UNLIKELY);
+
+    // The profile-guided build passes the hints and the compiler's profile on.
+    snprintf(cc_path, sizeof(cc_path), "%s/capture_cc.sh", dir);
+    snprintf(stdin_path, sizeof(stdin_path), "%s/stdin.c", dir);
+    snprintf(script, sizeof(script), "#!/usr/bin/env bash\ncat > %s\nexec cc \"$@\" < %s\n", stdin_path, stdin_path);
+    assert(write_file_contents(cc_path, script));
+    assert(chmod(cc_path, 0700) == 0);
+    nova_setenv("NOVA_CC", cc_path);
+    nova_setenv("NOVA_PGO_USE", profile_dir);
+    ok = nova_codegen_emit_executable(ir, &ctx, exe_path, "app_entry", error, sizeof(error));
+    nova_setenv("NOVA_PGO_USE", NULL);
+    nova_setenv("NOVA_CC", NULL);
+    if (!ok) fprintf(stderr, "%s\n", error);
+    assert(ok);
+    char *text = read_file_contents(stdin_path);
+    assert(text != NULL);
+    assert(strstr(text, "if (__builtin_expect((i == 0), 0))") != NULL);
+    assert(strstr(text, "nova_profile") == NULL);
+    free(text);
+    int guided = system(exe_path);
+    assert(WIFEXITED(guided) && WEXITSTATUS(guided) == WEXITSTATUS(instrumented));
+    nova_ir_free(ir);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+
+    // A function that gained a branch no longer matches its records.
+    const char *edited =
+        "module demo.pgo\n"
+        "fun step(x: Int): Int = if x % 50 == 0 { x / 2 } else { if x > 9 { x + 3 } else { x } }\n"
+        "fun walk(i: Int, acc: Int): Int = if i == 0 { acc } else { walk(i - 1, step(acc + i) % 1009) }\n"
+        "fun app_entry(): Int = walk(1000, 1) % 256\n";
+    ir = lower_profiled_program(edited, &parser, &program, &ctx);
+    assert(nova_profile_apply(ir, profile_dir, error, sizeof(error)));
+    step = find_ir_function(ir, "step");
+    assert(step->profile_calls == 0 && step->body->as.if_expr.hint == NOVA_IR_BRANCH_UNKNOWN);
+    assert(find_ir_function(ir, "walk")->body->as.if_expr.hint == NOVA_IR_BRANCH_UNLIKELY);
+
+    assert(write_file_contents(profile_path, "function walk 3\n"));
+    assert(!nova_profile_apply(ir, profile_dir, error, sizeof(error)));
+    assert(strstr(error, ":1: malformed profile record") != NULL);
+    nova_ir_free(ir);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+
+    cleanup_dir(dir);
+#endif
+}
+
+static void test_target_cpu_and_multiversioning(void) {
+#ifndef _WIN32
+    char path_template[] = "build/nova_targetXXXXXX";
+    char *dir = make_temp_dir(path_template);
+    assert(dir != NULL);
+    const char *source =
+        "module demo.target\n"
+        "fun integrate(i: Int, acc: Number): Number = if i == 0 { acc } else { integrate(i - 1, acc + Number(i) * 0.5) }\n"
+        "fun scale(x: Int): Int = x * 2\n"
+        "fun app_entry(): Int = Int(integrate(100, 0)) % 256 + scale(0)\n";
+    NovaParser parser;
+    NovaProgram *program = NULL;
+    NovaSemanticContext ctx;
+    NovaIRProgram *ir = lower_profiled_program(source, &parser, &program, &ctx);
+    // Tail recursion becomes the loop that makes integrate loop heavy.
+    assert(nova_optimize_tail_calls(ir, &ctx) == 1);
+
+    char exe_path[PATH_MAX], cc_path[PATH_MAX], stdin_path[PATH_MAX], args_path[PATH_MAX], script[PATH_MAX * 4];
+    snprintf(exe_path, sizeof(exe_path), "%s/app", dir);
+    snprintf(cc_path, sizeof(cc_path), "%s/capture_cc.sh", dir);
+    snprintf(stdin_path, sizeof(stdin_path), "%s/stdin.c", dir);
+    snprintf(args_path, sizeof(args_path), "%s/args", dir);
+    snprintf(script, sizeof(script), "#!/usr/bin/env bash\ncat > %s\necho \"$@\" > %s\nexec cc \"$@\" < %s\n", stdin_path, args_path, stdin_path);
+    assert(write_file_contents(cc_path, script));
+    assert(chmod(cc_path, 0700) == 0);
+    nova_setenv("NOVA_CC", cc_path);
+    nova_setenv("NOVA_TARGET_CPU", "x86-64-v2");
+    nova_setenv("NOVA_MULTIVERSION", "1");
+    char error[512] = {0};
+    bool ok = nova_codegen_emit_executable(ir, &ctx, exe_path, "app_entry", error, sizeof(error));
+    nova_setenv("NOVA_MULTIVERSION", NULL);
+    nova_setenv("NOVA_TARGET_CPU", NULL);
+    if (!ok) fprintf(stderr, "%s\n", error);
+    assert(ok);
+
+    // Only the loop gets a clone per ISA level, on top of the -march baseline.
+    char *text = read_file_contents(stdin_path);
+    assert(text != NULL);
+    const char *clones = strstr(text, "__attribute__((target_clones(\"arch=x86-64-v4\", \"arch=x86-64-v3\", \"default\")))\ndouble integrate(");
+    assert(clones != NULL && strstr(clones + strlen("__attribute__((target_clones"), "target_clones") == NULL);
+    free(text);
+    char *args = read_file_contents(args_path);
+    assert(args != NULL && strstr(args, "-march=x86-64-v2 ") != NULL);
+    free(args);
+    int rc = system(exe_path);
+    assert(WIFEXITED(rc) && WEXITSTATUS(rc) == 2525 % 256);
+
+    ok = nova_codegen_emit_executable(ir, &ctx, exe_path, "app_entry", error, sizeof(error));
+    nova_setenv("NOVA_CC", NULL);
+    assert(ok);
+    text = read_file_contents(stdin_path);
+    assert(text != NULL && strstr(text, "target_clones") == NULL);
+    free(text);
+    args = read_file_contents(args_path);
+    assert(args != NULL && strstr(args, "-march") == NULL);
+    free(args);
+
+    nova_ir_free(ir);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+    cleanup_dir(dir);
+#endif
+}
+
 static void test_llvm_backend_codegen(void) {
     char path_template[] = "build/nova_llvmXXXXXX";
     char *dir = make_temp_dir(path_template);
@@ -799,20 +1388,253 @@ static void test_ir_control_flow_optimizations(void) {
     nova_parser_free(&parser);
 }
 
-static void test_project_generator(void) {
-    char path_template[] = "build/nova_projXXXXXX";
-    char *project_dir = make_temp_dir(path_template);
-    assert(project_dir != NULL);
+static void test_ir_inliner_collapses_pipelines(void) {
+    const char *source =
+        "module demo.inline\n"
+        "fun identity(x: Number): Number = x\n"
+        "fun twice(x: Number): Number = x\n"
+        "fun compute(): Number = 1 |> identity |> twice\n"
+        "fun spin(flag: Bool): Number = if flag { spin(false) } else { 7 }\n"
+        "fun first(a: Number, b: Number): Number = a\n"
+        "fun app_entry(): Number = first(spin(true), spin(false))\n";
 
-    char command[PATH_MAX * 2];
-    snprintf(command, sizeof(command), "./build/nova-new %s", project_dir);
-    int rc = system(command);
-    assert(rc == 0);
+    NovaParser parser;
+    nova_parser_init(&parser, source);
+    NovaProgram *program = nova_parser_parse(&parser);
+    assert(program != NULL);
 
-    struct stat st;
-    char toml_path[PATH_MAX];
-    snprintf(toml_path, sizeof(toml_path), "%s/nova.toml", project_dir);
-    assert(stat(toml_path, &st) == 0);
+    NovaSemanticContext ctx;
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+    assert(ctx.diagnostics.count == 0);
+
+    NovaIRProgram *ir = nova_ir_lower(program, &ctx);
+    assert(ir != NULL);
+
+    NovaIRCallGraph graph;
+    assert(nova_ir_call_graph_build(ir, &graph));
+    size_t spin_index = nova_ir_find_function(ir, &find_function(ir, "spin")->name);
+    size_t identity_index = nova_ir_find_function(ir, &find_function(ir, "identity")->name);
+    assert(graph.nodes[spin_index].recursive);
+    assert(!graph.nodes[identity_index].recursive);
+    assert(graph.nodes[identity_index].call_site_count == 1);
+    nova_ir_call_graph_free(&graph);
+
+    NovaOptimizeOptions options;
+    nova_optimize_options_init(&options);
+    NovaOptimizeReport report;
+    char error[256] = {0};
+    assert(nova_optimize_program(ir, &ctx, &options, &report, error, sizeof(error)));
+    assert(report.inlined_calls == 3);
+    assert(report.removed_function_count == 0);
+    nova_optimize_report_free(&report);
+
+    const NovaIRFunction *compute_fn = find_function(ir, "compute");
+    assert(compute_fn != NULL && compute_fn->body != NULL);
+    assert(compute_fn->body->kind == NOVA_IR_EXPR_NUMBER);
+    assert(compute_fn->body->as.number_value == 1.0);
+
+    // Recursive callees stay out of line; their argument is bound once.
+    const NovaIRFunction *entry_fn = find_function(ir, "app_entry");
+    assert(entry_fn != NULL && entry_fn->body != NULL);
+    assert(entry_fn->body->kind == NOVA_IR_EXPR_LET);
+    assert(entry_fn->body->as.let_expr.value->kind == NOVA_IR_EXPR_CALL);
+    assert(token_matches(&entry_fn->body->as.let_expr.value->as.call.callee, "spin"));
+
+    const char *exe_path = "build/nova-inline-sample";
+    bool ok = nova_codegen_emit_executable(ir, &ctx, exe_path, "app_entry", error, sizeof(error));
+    assert(ok && "AOT executable generation failed after inlining");
+#ifndef _WIN32
+    int rc = system("./build/nova-inline-sample");
+    assert(WIFEXITED(rc));
+    assert(WEXITSTATUS(rc) == 7);
+#endif
+    remove(exe_path);
+
+    nova_setenv("NOVA_CODEGEN_BACKEND", "llvm");
+    ok = nova_codegen_emit_executable(ir, &ctx, exe_path, "app_entry", error, sizeof(error));
+    assert(ok && "LLVM executable generation failed after inlining");
+#ifndef _WIN32
+    rc = system("./build/nova-inline-sample");
+    assert(WIFEXITED(rc));
+    assert(WEXITSTATUS(rc) == 7);
+#endif
+    nova_setenv("NOVA_CODEGEN_BACKEND", NULL);
+    remove(exe_path);
+
+    nova_ir_free(ir);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+}
+
+static void test_dead_function_elimination(void) {
+    const char *source =
+        "module demo.dce\n"
+        "type Shape = Circle(Number) | Square(Number)\n"
+        "type Unused = Nothing\n"
+        "fun area(s: Shape): Number = 3\n"
+        "fun unused_helper(): Number = 4\n"
+        "fun only_from_unused(): Number = unused_helper()\n"
+        "fun spin(flag: Bool): Number = if flag { spin(false) } else { 5 }\n"
+        "fun app_entry(): Number = spin(true)\n";
+
+    NovaParser parser;
+    nova_parser_init(&parser, source);
+    NovaProgram *program = nova_parser_parse(&parser);
+    assert(program != NULL);
+
+    NovaSemanticContext ctx;
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+
+    NovaIRProgram *ir = nova_ir_lower(program, &ctx);
+    assert(ir != NULL);
+    assert(ir->function_count == 5);
+    assert(ir->type_count == 2);
+
+    char error[256] = {0};
+    const char *missing_root = "does_not_exist";
+    assert(!nova_optimize_eliminate_dead_code(ir, &ctx, &missing_root, 1, NULL, error, sizeof(error)));
+    assert(strstr(error, "does_not_exist") != NULL);
+    assert(ir->function_count == 5);
+
+    const char *entry = "app_entry";
+    NovaOptimizeOptions options;
+    nova_optimize_options_init(&options);
+    options.roots = &entry;
+    options.root_count = 1;
+    NovaOptimizeReport report;
+    assert(nova_optimize_program(ir, &ctx, &options, &report, error, sizeof(error)));
+    assert(ir->function_count == 2);
+    assert(find_function(ir, "app_entry") != NULL);
+    assert(find_function(ir, "spin") != NULL);
+    assert(report.removed_function_count == 3);
+    assert(report.removed_type_count == 2);
+    bool saw_helper = false;
+    for (size_t i = 0; i < report.removed_function_count; ++i) {
+        if (token_matches(&report.removed_functions[i], "unused_helper")) saw_helper = true;
+    }
+    assert(saw_helper);
+    assert(ir->type_count == 0);
+    nova_optimize_report_free(&report);
+
+    const char *exe_path = "build/nova-dce-sample";
+    bool ok = nova_codegen_emit_executable(ir, &ctx, exe_path, "app_entry", error, sizeof(error));
+    assert(ok && "AOT executable generation failed after dead-function elimination");
+#ifndef _WIN32
+    int rc = system("./build/nova-dce-sample");
+    assert(WIFEXITED(rc));
+    assert(WEXITSTATUS(rc) == 5);
+#endif
+    remove(exe_path);
+
+    nova_ir_free(ir);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+}
+
+static void test_effect_aware_common_call_elimination(void) {
+    const char *source =
+        "module demo.cse\n"
+        "fun spin(flag: Bool): Number = if flag { spin(false) } else { 7 }\n"
+        "fun keep(a: Number, b: Number): Number = a\n"
+        "fun twice_pure(flag: Bool): Number = keep(spin(flag), spin(flag))\n"
+        "fun twice_impure(flag: Bool): Number = keep(! spin(flag), ! spin(flag))\n"
+        "fun unused(flag: Bool): Number = { spin(flag); ! spin(flag); 3 }\n"
+        "fun rec(flag: Bool): Number = keep(rec(false), keep(rec(false), ! spin(true)))\n"
+        "fun branches(c: Bool, d: Bool): Number = if c { spin(d) } else { if d { spin(d) } else { 5 } }\n"
+        "fun guarded(c: Bool): Number = keep(spin(c), if c { spin(c) } else { 1 })\n"
+        "fun arm(c: Bool): Number = if c { keep(spin(c), spin(c)) } else { 1 }\n";
+
+    NovaParser parser;
+    nova_parser_init(&parser, source);
+    NovaProgram *program = nova_parser_parse(&parser);
+    assert(program != NULL);
+
+    NovaSemanticContext ctx;
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+    assert(ctx.diagnostics.count == 0);
+
+    NovaIRProgram *ir = nova_ir_lower(program, &ctx);
+    assert(ir != NULL);
+
+    const NovaIRFunction *impure_fn = find_function(ir, "twice_impure");
+    assert(impure_fn->body->as.call.args[0]->as.call.effects & NOVA_EFFECT_IMPURE);
+
+    NovaOptimizeOptions options;
+    nova_optimize_options_init(&options);
+    options.inline_functions = false;
+    NovaOptimizeReport report;
+    char error[256] = {0};
+    assert(nova_optimize_program(ir, &ctx, &options, &report, error, sizeof(error)));
+    assert(report.hoisted_calls == 3);
+    assert(report.removed_calls == 1);
+    nova_optimize_report_free(&report);
+
+    const NovaIRFunction *pure_fn = find_function(ir, "twice_pure");
+    assert(pure_fn->body->kind == NOVA_IR_EXPR_LET);
+    const NovaIRExpr *shared = pure_fn->body->as.let_expr.value;
+    assert(shared->kind == NOVA_IR_EXPR_CALL && token_matches(&shared->as.call.callee, "spin"));
+    const NovaIRExpr *use = pure_fn->body->as.let_expr.body;
+    assert(use->kind == NOVA_IR_EXPR_CALL && use->as.call.arg_count == 2);
+    assert(use->as.call.args[0]->kind == NOVA_IR_EXPR_IDENTIFIER);
+    assert(use->as.call.args[1]->kind == NOVA_IR_EXPR_IDENTIFIER);
+
+    // Impure calls keep their count and order.
+    impure_fn = find_function(ir, "twice_impure");
+    assert(impure_fn->body->kind == NOVA_IR_EXPR_CALL);
+    assert(impure_fn->body->as.call.args[0]->kind == NOVA_IR_EXPR_CALL);
+    assert(impure_fn->body->as.call.args[1]->kind == NOVA_IR_EXPR_CALL);
+
+    const NovaIRFunction *unused_fn = find_function(ir, "unused");
+    assert(unused_fn->body->kind == NOVA_IR_EXPR_SEQUENCE);
+    assert(unused_fn->body->as.sequence.count == 2);
+    assert(unused_fn->body->as.sequence.items[0]->kind == NOVA_IR_EXPR_CALL);
+    assert(unused_fn->body->as.sequence.items[0]->as.call.effects & NOVA_EFFECT_IMPURE);
+
+    // rec only looks pure to itself until effects are propagated over the call graph.
+    const NovaIRFunction *rec_fn = find_function(ir, "rec");
+    assert(rec_fn->effects & NOVA_EFFECT_IMPURE);
+    assert(rec_fn->body->kind == NOVA_IR_EXPR_CALL);
+
+    // A call made on only some paths is not hoisted above the branch: a pure
+    // function may still abort or never return.
+    const NovaIRFunction *branches_fn = find_function(ir, "branches");
+    assert(branches_fn->body->kind == NOVA_IR_EXPR_IF);
+    assert(branches_fn->body->as.if_expr.then_branch->kind == NOVA_IR_EXPR_CALL);
+    assert(branches_fn->body->as.if_expr.else_branch->as.if_expr.then_branch->kind == NOVA_IR_EXPR_CALL);
+    const NovaIRFunction *guarded_fn = find_function(ir, "guarded");
+    assert(guarded_fn->body->kind == NOVA_IR_EXPR_LET);
+    const NovaIRFunction *arm_fn = find_function(ir, "arm");
+    assert(arm_fn->body->kind == NOVA_IR_EXPR_IF);
+    assert(arm_fn->body->as.if_expr.then_branch->kind == NOVA_IR_EXPR_LET);
+
+    nova_ir_free(ir);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+}
+
+static void test_project_generator(void) {
+    char path_template[] = "build/nova_projXXXXXX";
+    char *project_dir = make_temp_dir(path_template);
+    assert(project_dir != NULL);
+
+    char command[PATH_MAX * 2];
+    snprintf(command, sizeof(command), "./build/nova-new %s", project_dir);
+    int rc = system(command);
+    assert(rc == 0);
+
+    struct stat st;
+    char toml_path[PATH_MAX];
+    snprintf(toml_path, sizeof(toml_path), "%s/nova.toml", project_dir);
+    assert(stat(toml_path, &st) == 0);
 
     char main_path[PATH_MAX];
     snprintf(main_path, sizeof(main_path), "%s/src/main.nova", project_dir);
@@ -833,29 +1655,966 @@ static void test_project_generator(void) {
 
     NovaIRProgram *ir = nova_ir_lower(program, &ctx);
     assert(ir != NULL);
-
-    const NovaIRFunction *main_fn = find_function(ir, "main");
-    assert(main_fn != NULL);
-    assert(main_fn->body != NULL);
-    assert(main_fn->body->kind == NOVA_IR_EXPR_CALL);
-    assert(token_matches(&main_fn->body->as.call.callee, "answer"));
-
-    char object_path[PATH_MAX];
-    snprintf(object_path, sizeof(object_path), "%s/main.o", project_dir);
-    char error[256];
-    bool ok = nova_codegen_emit_object(ir, &ctx, object_path, error, sizeof(error));
-    assert(ok && "code generation failed for generated project");
-    assert(stat(object_path, &st) == 0);
-    remove(object_path);
+
+    const NovaIRFunction *main_fn = find_function(ir, "main");
+    assert(main_fn != NULL);
+    assert(main_fn->body != NULL);
+    assert(main_fn->body->kind == NOVA_IR_EXPR_CALL);
+    assert(token_matches(&main_fn->body->as.call.callee, "answer"));
+
+    char object_path[PATH_MAX];
+    snprintf(object_path, sizeof(object_path), "%s/main.o", project_dir);
+    char error[256];
+    bool ok = nova_codegen_emit_object(ir, &ctx, object_path, error, sizeof(error));
+    assert(ok && "code generation failed for generated project");
+    assert(stat(object_path, &st) == 0);
+    remove(object_path);
+
+    nova_ir_free(ir);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+    free(source);
+
+    cleanup_dir(project_dir);
+}
+
+static void test_tail_calls_become_loops(void) {
+    const char *source =
+        "module demo.tail\n"
+        "fun ping(flag: Bool): Number = if flag { pong(flag) } else { 3 }\n"
+        "fun pong(flag: Bool): Number = if flag { ping(false) } else { 4 }\n"
+        "fun settle(flag: Bool, last: Number): Number = if flag { settle(false, 6) } else { last }\n"
+        "fun app_entry(): Number = first(settle(true, 1), ping(true))\n"
+        "fun first(a: Number, b: Number): Number = a\n";
+
+    NovaParser parser;
+    nova_parser_init(&parser, source);
+    NovaProgram *program = nova_parser_parse(&parser);
+    assert(program != NULL);
+
+    // ping calls pong and app_entry calls first before either is declared.
+    NovaSemanticContext ctx;
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+    assert(ctx.diagnostics.count == 0);
+
+    NovaIRProgram *ir = nova_ir_lower(program, &ctx);
+    assert(ir != NULL);
+
+    NovaOptimizeOptions options;
+    nova_optimize_options_init(&options);
+    options.inline_functions = false;
+    NovaOptimizeReport report;
+    char error[256] = {0};
+    assert(nova_optimize_program(ir, &ctx, &options, &report, error, sizeof(error)));
+    assert(report.tail_recursive_functions == 1);
+    nova_optimize_report_free(&report);
+
+    // Self recursion turns into a loop; mutual recursion is left to the backend.
+    const NovaIRFunction *settle_fn = find_function(ir, "settle");
+    assert(settle_fn->body->kind == NOVA_IR_EXPR_LET);
+    assert(settle_fn->body->as.let_expr.is_mutable);
+    const NovaIRExpr *running = settle_fn->body->as.let_expr.body;
+    assert(running->kind == NOVA_IR_EXPR_LET && running->as.let_expr.is_mutable);
+    assert(running->as.let_expr.body->kind == NOVA_IR_EXPR_SEQUENCE);
+    assert(running->as.let_expr.body->as.sequence.items[0]->kind == NOVA_IR_EXPR_WHILE);
+    assert(find_function(ir, "ping")->body->kind == NOVA_IR_EXPR_IF);
+
+    const char *ir_path = "build/nova-tail-sample.ll";
+    assert(nova_codegen_emit_llvm_ir(ir, &ctx, ir_path, error, sizeof(error)));
+    char *text = read_file_contents(ir_path);
+    assert(text != NULL);
+    assert(strstr(text, "musttail call double @pong(i1 %flag)") != NULL);
+    assert(strstr(text, "musttail call double @ping(i1 0)") != NULL);
+    assert(strstr(text, "alloca double") != NULL);
+    free(text);
+    remove(ir_path);
+
+    const char *exe_path = "build/nova-tail-sample";
+    bool ok = nova_codegen_emit_executable(ir, &ctx, exe_path, "app_entry", error, sizeof(error));
+    assert(ok && "AOT executable generation failed for tail calls");
+#ifndef _WIN32
+    int rc = system("./build/nova-tail-sample");
+    assert(WIFEXITED(rc));
+    assert(WEXITSTATUS(rc) == 6);
+#endif
+    remove(exe_path);
+
+    nova_setenv("NOVA_CODEGEN_BACKEND", "llvm");
+    ok = nova_codegen_emit_executable(ir, &ctx, exe_path, "app_entry", error, sizeof(error));
+    assert(ok && "LLVM executable generation failed for tail calls");
+#ifndef _WIN32
+    rc = system("./build/nova-tail-sample");
+    assert(WIFEXITED(rc));
+    assert(WEXITSTATUS(rc) == 6);
+#endif
+    nova_setenv("NOVA_CODEGEN_BACKEND", NULL);
+    remove(exe_path);
+
+    nova_ir_free(ir);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+}
+
+static void test_tail_calls_with_shadowed_params(void) {
+    // The tail calls pass bindings that reuse the parameter names.
+    const char *source =
+        "module demo.shadow\n"
+        "type Box = Wrap(Int)\n"
+        "fun dec(n: Int): Box = Wrap(n - 1)\n"
+        "fun f(n: Int, acc: Int): Int = if n == 0 { acc } else { match dec(n) { Wrap(n) -> f(n, acc + 1) } }\n"
+        "fun g(n: Int, acc: Int): Int = if n == 0 { acc } else { { let n = n - 1; g(n, acc + 2) } }\n"
+        "fun app_entry(): Int = f(10, 0) + g(10, 0)\n";
+
+    NovaParser parser;
+    nova_parser_init(&parser, source);
+    NovaProgram *program = nova_parser_parse(&parser);
+    assert(program != NULL);
+    NovaSemanticContext ctx;
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+    assert(ctx.diagnostics.count == 0);
+    NovaIRProgram *ir = nova_ir_lower(program, &ctx);
+    assert(ir != NULL);
+
+    NovaOptimizeOptions options;
+    nova_optimize_options_init(&options);
+    options.inline_functions = false;
+    NovaOptimizeReport report;
+    char error[256] = {0};
+    assert(nova_optimize_program(ir, &ctx, &options, &report, error, sizeof(error)));
+    assert(report.tail_recursive_functions == 2);
+    nova_optimize_report_free(&report);
+    assert(find_function(ir, "f")->body->as.let_expr.is_mutable);
+    assert(find_function(ir, "g")->body->as.let_expr.is_mutable);
+
+#ifndef _WIN32
+    const char *exe_path = "build/nova-tail-shadow";
+    bool ok = nova_codegen_emit_executable(ir, &ctx, exe_path, "app_entry", error, sizeof(error));
+    assert(ok && "AOT executable generation failed for shadowed tail calls");
+    int rc = system("timeout 10 ./build/nova-tail-shadow");
+    assert(WIFEXITED(rc));
+    assert(WEXITSTATUS(rc) == 30);
+    remove(exe_path);
+#endif
+
+    nova_ir_free(ir);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+}
+
+static void test_llvm_tail_calls_with_aggregates(void) {
+    // Shape is held by value as an LLVM struct, which llc cannot promise to
+    // pass through a musttail call.
+    const char *source =
+        "module demo.aggregate\n"
+        "type Shape = Dot | Box(Int, Int, Int)\n"
+        "fun build_a(n: Int): Shape = if n == 0 { Box(n, 2, 3) } else { build_b(n - 1) }\n"
+        "fun build_b(n: Int): Shape = if n == 0 { Dot } else { build_a(n - 1) }\n"
+        "fun size(s: Shape): Int = match s { Dot -> 1; Box(a, b, c) -> a + b + c }\n"
+        "fun app_entry(): Int = size(build_a(10))\n";
+
+    NovaParser parser;
+    nova_parser_init(&parser, source);
+    NovaProgram *program = nova_parser_parse(&parser);
+    assert(program != NULL);
+    NovaSemanticContext ctx;
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+    assert(ctx.diagnostics.count == 0);
+    NovaIRProgram *ir = nova_ir_lower(program, &ctx);
+    assert(ir != NULL);
+
+    char error[256] = {0};
+    const char *ir_path = "build/nova-tail-aggregate.ll";
+    assert(nova_codegen_emit_llvm_ir(ir, &ctx, ir_path, error, sizeof(error)));
+    char *text = read_file_contents(ir_path);
+    assert(text != NULL);
+    assert(strstr(text, "= tail call %nova.Shape @build_b(i64 ") != NULL);
+    assert(strstr(text, "= tail call %nova.Shape @build_a(i64 ") != NULL);
+    assert(strstr(text, "musttail") == NULL);
+    free(text);
+    remove(ir_path);
+
+#ifndef _WIN32
+    const char *exe_path = "build/nova-tail-aggregate";
+    nova_setenv("NOVA_CODEGEN_BACKEND", "llvm");
+    bool ok = nova_codegen_emit_executable(ir, &ctx, exe_path, "app_entry", error, sizeof(error));
+    nova_setenv("NOVA_CODEGEN_BACKEND", NULL);
+    assert(ok && "LLVM executable generation failed for aggregate tail calls");
+    int rc = system("./build/nova-tail-aggregate");
+    assert(WIFEXITED(rc));
+    assert(WEXITSTATUS(rc) == 5);
+    remove(exe_path);
+#endif
+
+    nova_ir_free(ir);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+}
+
+static void test_function_attributes_from_effects(void) {
+    const char *source =
+        "module demo.attrs\n"
+        "fun fib(n: Int): Int = if n < 2 { n } else { fib(n - 1) + fib(n - 2) }\n"
+        "fun sq(x: Number): Number = x * x\n"
+        "fun hyp(a: Number, b: Number): Number = sq(a) + sq(b)\n"
+        "fun total(xs: List[Int]): Int = length(xs)\n"
+        "fun app_entry(): Int = fib(10) + Int(hyp(3.0, 4.0)) + total([1, 2, 3])\n";
+
+    NovaParser parser;
+    nova_parser_init(&parser, source);
+    NovaProgram *program = nova_parser_parse(&parser);
+    assert(program != NULL);
+
+    NovaSemanticContext ctx;
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+    assert(ctx.diagnostics.count == 0);
+
+    NovaIRProgram *ir = nova_ir_lower(program, &ctx);
+    assert(ir != NULL);
+
+    const char *entry = "app_entry";
+    NovaOptimizeOptions options;
+    nova_optimize_options_init(&options);
+    options.inline_functions = false;
+    options.roots = &entry;
+    options.root_count = 1;
+    NovaOptimizeReport report;
+    char error[256] = {0};
+    assert(nova_optimize_program(ir, &ctx, &options, &report, error, sizeof(error)));
+    nova_optimize_report_free(&report);
+    assert(!find_function(ir, "app_entry")->internal);
+    assert(find_function(ir, "fib")->internal);
+
+    // Only the root keeps external linkage; scalar-only pure functions read no
+    // memory, and prototypes list callees first.
+    char path_template[] = "build/nova_attrsXXXXXX";
+    char *dir = make_temp_dir(path_template);
+    assert(dir != NULL);
+    char cc_path[PATH_MAX];
+    snprintf(cc_path, sizeof(cc_path), "%s/capture_cc.sh", dir);
+    char source_path[PATH_MAX];
+    snprintf(source_path, sizeof(source_path), "%s/unit.c", dir);
+    char script[PATH_MAX * 2];
+    snprintf(script,
+             sizeof(script),
+             "#!/usr/bin/env bash\n"
+             "cat > %s\n"
+             "prev=\"\"\n"
+             "for arg in \"$@\"; do\n"
+             "  if [ \"$prev\" = \"-o\" ]; then : > \"$arg\"; fi\n"
+             "  prev=\"$arg\"\n"
+             "done\n",
+             source_path);
+    assert(write_file_contents(cc_path, script));
+#ifndef _WIN32
+    assert(chmod(cc_path, 0700) == 0);
+#endif
+    nova_setenv("NOVA_CC", cc_path);
+    char object_path[PATH_MAX];
+    snprintf(object_path, sizeof(object_path), "%s/out.o", dir);
+    assert(nova_codegen_emit_object(ir, &ctx, object_path, error, sizeof(error)));
+    nova_setenv("NOVA_CC", NULL);
+    char *text = read_file_contents(source_path);
+    assert(text != NULL);
+    assert(strstr(text, "static __attribute__((const)) int64_t fib(int64_t n);") != NULL);
+    assert(strstr(text, "static __attribute__((pure)) int64_t total(const void * xs);") != NULL);
+    assert(strstr(text, "\n__attribute__((pure)) int64_t app_entry(void);") != NULL);
+    assert(strstr(text, "static double hyp(double a, double b) {") != NULL);
+    const char *sq_prototype = strstr(text, "static __attribute__((const)) double sq(double x);");
+    const char *hyp_prototype = strstr(text, "static __attribute__((const)) double hyp(double a, double b);");
+    assert(sq_prototype && hyp_prototype && sq_prototype < hyp_prototype);
+    free(text);
+    cleanup_dir(dir);
+
+    // The LLVM backend adds internal fastcc linkage, and willreturn where
+    // nothing can loop or trap.
+    const char *ir_path = "build/nova-attrs-sample.ll";
+    assert(nova_codegen_emit_llvm_ir(ir, &ctx, ir_path, error, sizeof(error)));
+    text = read_file_contents(ir_path);
+    assert(text != NULL);
+    assert(strstr(text, "define internal fastcc i64 @fib(i64 %n) nounwind readnone {") != NULL);
+    assert(strstr(text, "define internal fastcc double @sq(double %x) nounwind readnone willreturn {") != NULL);
+    assert(strstr(text, "define internal fastcc i64 @total(ptr %xs) nounwind {") != NULL);
+    assert(strstr(text, "define i64 @app_entry() nounwind {") != NULL);
+    assert(strstr(text, "call fastcc i64 @fib(") != NULL);
+    free(text);
+    remove(ir_path);
+
+    const char *exe_path = "build/nova-attrs-sample";
+    nova_setenv("NOVA_CODEGEN_BACKEND", "llvm");
+    bool ok = nova_codegen_emit_executable(ir, &ctx, exe_path, "app_entry", error, sizeof(error));
+    nova_setenv("NOVA_CODEGEN_BACKEND", NULL);
+    assert(ok && "LLVM executable generation failed with function attributes");
+#ifndef _WIN32
+    int rc = system("./build/nova-attrs-sample");
+    assert(WIFEXITED(rc));
+    assert(WEXITSTATUS(rc) == 83);
+#endif
+    ok = nova_codegen_emit_executable(ir, &ctx, exe_path, "app_entry", error, sizeof(error));
+    assert(ok && "AOT executable generation failed with function attributes");
+#ifndef _WIN32
+    rc = system("./build/nova-attrs-sample");
+    assert(WIFEXITED(rc));
+    assert(WEXITSTATUS(rc) == 83);
+#endif
+    remove(exe_path);
+
+    nova_ir_free(ir);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+}
+
+static void test_match_compiles_to_switch(void) {
+    const char *source =
+        "module demo.shapes\n"
+        "type Shape = Circle(Number) | Square(Number, Bool) | Empty\n"
+        "type Option = Some(Shape) | None\n"
+        "fun area(s: Shape): Number = match s { Circle(r) -> r; Square(side, big) -> if big { side } else { 2 }; Empty -> 0 }\n"
+        "fun pick(o: Option): Number = match o { Some(shape) -> area(shape); _ -> 1 }\n"
+        "fun app_entry(): Number = pick(Some(Square(9, true)))\n";
+
+    NovaParser parser;
+    nova_parser_init(&parser, source);
+    NovaProgram *program = nova_parser_parse(&parser);
+    assert(program != NULL);
+
+    // Option's payload refers to Shape; the wildcard arm covers None.
+    NovaSemanticContext ctx;
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+    assert(ctx.diagnostics.count == 0);
+
+    NovaIRProgram *ir = nova_ir_lower(program, &ctx);
+    assert(ir != NULL);
+
+    const NovaIRExpr *match = find_function(ir, "area")->body;
+    assert(match->kind == NOVA_IR_EXPR_MATCH);
+    assert(match->as.match_expr.arm_count == 3);
+    assert(match->as.match_expr.arms[0].tag == 0);
+    assert(match->as.match_expr.arms[1].tag == 1);
+    assert(match->as.match_expr.arms[2].tag == 2);
+    const NovaIRExpr *wildcard = find_function(ir, "pick")->body;
+    assert(wildcard->as.match_expr.arms[1].tag == SIZE_MAX);
+
+    const NovaIRExpr *entry = find_function(ir, "app_entry")->body;
+    assert(entry->kind == NOVA_IR_EXPR_CALL);
+    const NovaIRExpr *some = entry->as.call.args[0];
+    assert(some->kind == NOVA_IR_EXPR_CONSTRUCT && some->as.construct.tag == 0);
+    assert(some->as.construct.args[0]->kind == NOVA_IR_EXPR_CONSTRUCT);
+    assert(some->as.construct.args[0]->as.construct.tag == 1);
+
+    char error[256] = {0};
+    const char *ir_path = "build/nova-match-sample.ll";
+    assert(nova_codegen_emit_llvm_ir(ir, &ctx, ir_path, error, sizeof(error)));
+    char *text = read_file_contents(ir_path);
+    assert(text != NULL);
+    assert(strstr(text, "switch i32") != NULL);
+    assert(strstr(text, "%nova.Shape = type { i8, [2 x i64] }") != NULL);
+    free(text);
+    remove(ir_path);
+
+    const char *exe_path = "build/nova-match-sample";
+    bool ok = nova_codegen_emit_executable(ir, &ctx, exe_path, "app_entry", error, sizeof(error));
+    assert(ok && "AOT executable generation failed for match");
+#ifndef _WIN32
+    int rc = system("./build/nova-match-sample");
+    assert(WIFEXITED(rc));
+    assert(WEXITSTATUS(rc) == 9);
+#endif
+    remove(exe_path);
+
+    nova_setenv("NOVA_CODEGEN_BACKEND", "llvm");
+    ok = nova_codegen_emit_executable(ir, &ctx, exe_path, "app_entry", error, sizeof(error));
+    assert(ok && "LLVM executable generation failed for match");
+#ifndef _WIN32
+    rc = system("./build/nova-match-sample");
+    assert(WIFEXITED(rc));
+    assert(WEXITSTATUS(rc) == 9);
+#endif
+    nova_setenv("NOVA_CODEGEN_BACKEND", NULL);
+    remove(exe_path);
+
+    nova_ir_free(ir);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+}
+
+static int run_match_entry(const NovaIRProgram *ir, const NovaSemanticContext *ctx, const char *entry) {
+    char error[256] = {0};
+    const char *exe_path = "build/nova-pattern-sample";
+    bool ok = nova_codegen_emit_executable(ir, ctx, exe_path, entry, error, sizeof(error));
+    assert(ok && "executable generation failed for nested patterns");
+    int status = 0;
+#ifndef _WIN32
+    int rc = system("./build/nova-pattern-sample");
+    assert(WIFEXITED(rc));
+    status = WEXITSTATUS(rc);
+#endif
+    remove(exe_path);
+    return status;
+}
+
+static void test_match_decision_trees(void) {
+    const char *source =
+        "module demo.patterns\n"
+        "type Shape = Circle(Number) | Square(Number, Bool) | Empty\n"
+        "type Option = Some(Shape) | None\n"
+        "fun area(o: Option): Number = match o {\n"
+        "    Some(Circle(0)) -> 100\n"
+        "    Some(Circle(r)) if big(r) -> 50\n"
+        "    Some(Circle(r)) -> r\n"
+        "    Some(Square(side, true)) -> side\n"
+        "    Some(Square(_, false)) -> 2\n"
+        "    Some(Empty) -> 3\n"
+        "    None -> 4\n"
+        "}\n"
+        "fun big(r: Number): Bool = match r { 7 -> true; 8 -> true; _ -> false }\n"
+        "fun word(s: String): Number = match s { \"one\" -> 1; \"two\" -> 2; \"three\" -> 3; \"fo\\\"ur\" -> 4; _ -> 0 }\n"
+        "fun flag(b: Bool): Number = match b { true -> 10; false -> 20 }\n"
+        "fun guarded(): Number = area(Some(Circle(7)))\n"
+        "fun literal(): Number = area(Some(Circle(0)))\n"
+        "fun square(): Number = area(Some(Square(5, false)))\n"
+        "fun quoted(): Number = word(\"fo\\\"ur\")\n"
+        "fun unknown(): Number = word(\"five\")\n"
+        "fun no(): Number = flag(false)\n";
+
+    NovaParser parser;
+    nova_parser_init(&parser, source);
+    NovaProgram *program = nova_parser_parse(&parser);
+    assert(program != NULL);
+    assert(parser.diagnostics.count == 0);
+
+    NovaSemanticContext ctx;
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+    assert(ctx.diagnostics.count == 0);
+
+    NovaIRProgram *ir = nova_ir_lower(program, &ctx);
+    assert(ir != NULL);
+
+    // Option's tag is tested once; Shape's tag is tested under Some only.
+    const NovaIRExpr *outer = find_function(ir, "area")->body;
+    assert(outer->kind == NOVA_IR_EXPR_MATCH);
+    assert(outer->as.match_expr.arm_count == 2);
+    const NovaIRExpr *inner = outer->as.match_expr.arms[0].body;
+    while (inner->kind == NOVA_IR_EXPR_LET) inner = inner->as.let_expr.body;
+    assert(inner->kind == NOVA_IR_EXPR_MATCH);
+    assert(inner->as.match_expr.arm_count == 3);
+
+    const NovaIRExpr *flag = find_function(ir, "flag")->body;
+    assert(flag->kind == NOVA_IR_EXPR_IF);
+    const NovaIRExpr *word = find_function(ir, "word")->body;
+    assert(word->kind == NOVA_IR_EXPR_MATCH);
+    assert(word->as.match_expr.arm_count == 5);
+    assert(word->as.match_expr.arms[0].literal != NULL);
+    assert(word->as.match_expr.arms[4].literal == NULL);
+
+    char error[256] = {0};
+    const char *ir_path = "build/nova-pattern-sample.ll";
+    assert(nova_codegen_emit_llvm_ir(ir, &ctx, ir_path, error, sizeof(error)));
+    char *text = read_file_contents(ir_path);
+    assert(text != NULL);
+    assert(strstr(text, "call i32 @nova_string_hash(ptr") != NULL);
+    assert(strstr(text, "call i1 @nova_string_equal(ptr") != NULL);
+    free(text);
+    remove(ir_path);
+
+    for (int backend = 0; backend < 2; ++backend) {
+        nova_setenv("NOVA_CODEGEN_BACKEND", backend ? "llvm" : NULL);
+        assert(run_match_entry(ir, &ctx, "guarded") == 50);
+        assert(run_match_entry(ir, &ctx, "literal") == 100);
+        assert(run_match_entry(ir, &ctx, "square") == 2);
+        assert(run_match_entry(ir, &ctx, "quoted") == 4);
+        assert(run_match_entry(ir, &ctx, "unknown") == 0);
+        assert(run_match_entry(ir, &ctx, "no") == 20);
+    }
+    nova_setenv("NOVA_CODEGEN_BACKEND", NULL);
+
+    nova_ir_free(ir);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+}
+
+static void test_match_coverage_from_decision_tree(void) {
+    const char *source =
+        "module demo.coverage\n"
+        "type Shape = Circle(Number) | Empty\n"
+        "type Option = Some(Shape) | None\n"
+        "fun partial(o: Option): Number = match o { Some(Circle(r)) -> r; None -> 0 }\n"
+        "fun shadowed(o: Option): Number = match o { Some(s) -> 1; Some(Empty) -> 2; None -> 3 }\n"
+        "fun wrong(o: Option): Number = match o { Some(Circle(r, 1)) -> r; _ -> 0 }\n";
+
+    NovaParser parser;
+    nova_parser_init(&parser, source);
+    NovaProgram *program = nova_parser_parse(&parser);
+    assert(program != NULL);
+
+    NovaSemanticContext ctx;
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+
+    bool non_exhaustive = false;
+    bool unreachable = false;
+    bool arity = false;
+    for (size_t i = 0; i < ctx.diagnostics.count; ++i) {
+        const NovaDiagnostic *diag = &ctx.diagnostics.items[i];
+        if (strcmp(diag->message, "match expression may be non-exhaustive") == 0) {
+            assert(diag->severity == NOVA_DIAGNOSTIC_WARNING);
+            non_exhaustive = true;
+        } else if (strcmp(diag->message, "match arm is unreachable") == 0) {
+            assert(diag->severity == NOVA_DIAGNOSTIC_WARNING);
+            assert(diag->token.line == 5);
+            unreachable = true;
+        } else if (strcmp(diag->message, "wrong number of payload patterns for variant") == 0) {
+            assert(diag->severity == NOVA_DIAGNOSTIC_ERROR);
+            arity = true;
+        }
+    }
+    assert(non_exhaustive && unreachable && arity);
+    assert(ctx.diagnostics.count == 3);
+
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+}
+
+static void test_perfect_hash_string_keys(void) {
+    enum { KEY_COUNT = 200 };
+    char storage[KEY_COUNT][16];
+    const char *keys[KEY_COUNT];
+    size_t lengths[KEY_COUNT];
+    for (size_t i = 0; i < KEY_COUNT; ++i) {
+        snprintf(storage[i], sizeof(storage[i]), "key%zu", i * 7919);
+        keys[i] = storage[i];
+        lengths[i] = strlen(storage[i]);
+    }
+
+    NovaPerfectHash hash;
+    assert(nova_match_perfect_hash(keys, lengths, KEY_COUNT, &hash));
+    bool *seen = (bool *)calloc(hash.slot_count, sizeof(bool));
+    assert(seen != NULL);
+    for (size_t i = 0; i < KEY_COUNT; ++i) {
+        uint32_t h = nova_match_string_hash(keys[i], lengths[i], hash.seed);
+        uint32_t slot = nova_match_hash_mix(h ^ hash.displacements[h & (hash.bucket_count - 1)]) & (uint32_t)(hash.slot_count - 1);
+        assert(!seen[slot]);
+        seen[slot] = true;
+        assert(hash.slots[slot] == i);
+    }
+    free(seen);
+    nova_perfect_hash_free(&hash);
+}
+
+static const NovaTypeLayout *find_layout(const NovaSemanticContext *ctx, const char *name) {
+    NovaToken token = {NOVA_TOKEN_IDENTIFIER, name, strlen(name), 0, 0};
+    const NovaTypeRecord *record = nova_semantic_find_type(ctx, &token);
+    assert(record != NULL && record->layout != NULL);
+    return record->layout;
+}
+
+static void test_sum_type_layouts(void) {
+    const char *source =
+        "module demo.layout\n"
+        "type Option = Some(Number) | None\n"
+        "type Flag = On | Off | Unknown\n"
+        "type MaybeFlag = HasFlag(Flag) | NoFlag\n"
+        "type MaybeBool = HasBool(Bool) | NoBool\n"
+        "type Shape = Circle(Number) | Square(Number, Bool) | Empty\n"
+        "type MaybeShape = HasShape(Shape) | NoShape\n"
+        "type List = Cons(Number, List) | Nil\n"
+        "type Pair = Pair(Number, Number)\n"
+        "fun opt(o: Option): Number = match o { Some(x) -> x; None -> 11 }\n"
+        "fun shape(s: MaybeShape): Number = match s { HasShape(Square(x, true)) -> x; HasShape(_) -> 62; NoShape -> 64 }\n"
+        "fun second(l: List): Number = match l { Cons(_, Cons(x, _)) -> x; _ -> 89 }\n"
+        "fun flag(f: MaybeFlag): Number = match f { HasFlag(Unknown) -> 33; HasFlag(_) -> 32; NoFlag -> 34 }\n"
+        "fun none(): Number = opt(None)\n"
+        "fun square(): Number = shape(HasShape(Square(65, true)))\n"
+        "fun missing(): Number = shape(NoShape)\n"
+        "fun list(): Number = second(Cons(1, Cons(81, Nil)))\n"
+        "fun unknown(): Number = flag(HasFlag(Unknown))\n";
+
+    NovaParser parser;
+    nova_parser_init(&parser, source);
+    NovaProgram *program = nova_parser_parse(&parser);
+    assert(program != NULL);
+
+    NovaSemanticContext ctx;
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+    assert(ctx.diagnostics.count == 0);
+
+    // Option(Number) keeps the bare double; None is a signalling NaN.
+    const NovaTypeLayout *option = find_layout(&ctx, "Option");
+    assert(option->kind == NOVA_LAYOUT_NICHE);
+    assert(option->repr.kind == NOVA_REPR_F64 && option->repr.size == 8);
+    assert(option->variants[1].niche_code == NOVA_LAYOUT_F64_NICHE);
+    assert(strcmp(option->c_type, "double") == 0);
+
+    const NovaTypeLayout *flag = find_layout(&ctx, "Flag");
+    assert(flag->kind == NOVA_LAYOUT_ENUM && flag->repr.size == 1);
+    const NovaTypeLayout *maybe_flag = find_layout(&ctx, "MaybeFlag");
+    assert(maybe_flag->kind == NOVA_LAYOUT_NICHE && maybe_flag->variants[1].niche_code == 3);
+    const NovaTypeLayout *maybe_bool = find_layout(&ctx, "MaybeBool");
+    assert(maybe_bool->kind == NOVA_LAYOUT_NICHE && strcmp(maybe_bool->c_type, "uint8_t") == 0);
+
+    const NovaTypeLayout *shape = find_layout(&ctx, "Shape");
+    assert(shape->kind == NOVA_LAYOUT_TAGGED);
+    assert(shape->tag_size == 1 && shape->payload_offset == 8 && shape->repr.size == 24);
+    assert(shape->variants[1].fields[1].offset == 8);
+    const NovaTypeLayout *maybe_shape = find_layout(&ctx, "MaybeShape");
+    assert(maybe_shape->kind == NOVA_LAYOUT_NICHE && maybe_shape->repr.kind == NOVA_REPR_STRUCT);
+    assert(nova_layout_niche_host(&ctx, maybe_shape) == shape);
+
+    const NovaTypeLayout *list = find_layout(&ctx, "List");
+    assert(list->kind == NOVA_LAYOUT_TAGGED && list->variants[0].fields[1].boxed);
+    const NovaTypeLayout *pair = find_layout(&ctx, "Pair");
+    assert(pair->tag_size == 0 && pair->repr.size == 16);
+
+    NovaIRProgram *ir = nova_ir_lower(program, &ctx);
+    assert(ir != NULL);
+    for (int backend = 0; backend < 2; ++backend) {
+        nova_setenv("NOVA_CODEGEN_BACKEND", backend ? "llvm" : NULL);
+        assert(run_match_entry(ir, &ctx, "none") == 11);
+        assert(run_match_entry(ir, &ctx, "square") == 65);
+        assert(run_match_entry(ir, &ctx, "missing") == 64);
+        assert(run_match_entry(ir, &ctx, "list") == 81);
+        assert(run_match_entry(ir, &ctx, "unknown") == 33);
+    }
+    nova_setenv("NOVA_CODEGEN_BACKEND", NULL);
+
+    nova_ir_free(ir);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+}
+
+static void test_tuple_types(void) {
+    const char *source =
+        "module demo.tuples\n"
+        "type Pair(x: Number, y: Number)\n"
+        "type Tagged(label: String, ok: Bool, value: Number)\n"
+        "type Meters(m: Number)\n"
+        "type Range(lo: Number, hi: Number)\n"
+        "type Step = Step(Range, Number) | Done\n"
+        "fun swap(p: Pair): Pair = { let Pair(a, b) = p; Pair(b, a) }\n"
+        "fun first(p: Pair): Number = match p { Pair(a, _) -> a }\n"
+        "fun pick(t: Tagged): Number = { let Tagged(_, ok, v) = t; if ok { v } else { 0 } }\n"
+        "fun hi(s: Step): Number = match s { Step(Range(_, h), _) -> h; Done -> 9 }\n"
+        "fun swapped(): Number = { let q = swap(Pair(3, 4)); first(q) }\n"
+        "fun tagged(): Number = pick(Tagged(\"t\", true, 7))\n"
+        "fun nested(): Number = hi(Step(Range(1, 10), 2))\n"
+        "fun meters(): Number = { let Meters(m) = Meters(12); m }\n";
+
+    NovaParser parser;
+    nova_parser_init(&parser, source);
+    NovaProgram *program = nova_parser_parse(&parser);
+    assert(program != NULL);
+    assert(!parser.had_error);
+
+    NovaSemanticContext ctx;
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+    assert(ctx.diagnostics.count == 0);
+
+    // Several fields make a plain struct; a single field is the field itself.
+    const NovaTypeLayout *pair = find_layout(&ctx, "Pair");
+    assert(pair->kind == NOVA_LAYOUT_STRUCT && pair->tag_size == 0 && pair->repr.size == 16);
+    const NovaTypeLayout *tagged = find_layout(&ctx, "Tagged");
+    assert(tagged->kind == NOVA_LAYOUT_STRUCT && tagged->repr.size == 24);
+    assert(tagged->variants[0].fields[1].offset == 8 && tagged->variants[0].fields[2].offset == 16);
+    const NovaTypeLayout *meters = find_layout(&ctx, "Meters");
+    assert(meters->kind == NOVA_LAYOUT_NICHE && strcmp(meters->c_type, "double") == 0);
+    assert(find_layout(&ctx, "Step")->kind == NOVA_LAYOUT_TAGGED);
+
+    NovaIRProgram *ir = nova_ir_lower(program, &ctx);
+    assert(ir != NULL);
+    char error[256] = {0};
+    const char *ir_path = "build/nova-tuple-sample.ll";
+    assert(nova_codegen_emit_llvm_ir(ir, &ctx, ir_path, error, sizeof(error)));
+    char *text = read_file_contents(ir_path);
+    assert(text != NULL);
+    assert(strstr(text, "%nova.Pair = type { double, double }") != NULL);
+    assert(strstr(text, "define %nova.Pair @swap(%nova.Pair %p)") != NULL);
+    assert(strstr(text, "insertvalue %nova.Pair") != NULL);
+    assert(strstr(text, "call ptr @nova.box") == NULL);
+    free(text);
+    remove(ir_path);
+
+    for (int backend = 0; backend < 2; ++backend) {
+        nova_setenv("NOVA_CODEGEN_BACKEND", backend ? "llvm" : NULL);
+        assert(run_match_entry(ir, &ctx, "swapped") == 4);
+        assert(run_match_entry(ir, &ctx, "tagged") == 7);
+        assert(run_match_entry(ir, &ctx, "nested") == 10);
+        assert(run_match_entry(ir, &ctx, "meters") == 12);
+    }
+    nova_setenv("NOVA_CODEGEN_BACKEND", NULL);
+
+    nova_ir_free(ir);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+
+    // A let pattern that can fail is accepted with a warning, like a non-exhaustive match.
+    const char *refutable =
+        "module demo.refutable\n"
+        "type Option = Some(Number) | None\n"
+        "fun get(o: Option): Number = { let Some(x) = o; x }\n";
+    nova_parser_init(&parser, refutable);
+    program = nova_parser_parse(&parser);
+    assert(program != NULL);
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+    assert(ctx.diagnostics.count == 1);
+    assert(ctx.diagnostics.items[0].severity == NOVA_DIAGNOSTIC_WARNING);
+    assert(strcmp(ctx.diagnostics.items[0].message, "let pattern may not match every value") == 0);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+}
+
+static void test_native_operators(void) {
+    NovaTokenArray tokens = nova_lexer_tokenize("+ - * / % < <= > >= == != and or not -> => = !");
+    const NovaTokenType expected[] = {
+        NOVA_TOKEN_PLUS, NOVA_TOKEN_MINUS, NOVA_TOKEN_STAR, NOVA_TOKEN_SLASH, NOVA_TOKEN_PERCENT,
+        NOVA_TOKEN_LESS, NOVA_TOKEN_LESS_EQUAL, NOVA_TOKEN_GREATER, NOVA_TOKEN_GREATER_EQUAL,
+        NOVA_TOKEN_EQUAL_EQUAL, NOVA_TOKEN_BANG_EQUAL, NOVA_TOKEN_AND, NOVA_TOKEN_OR, NOVA_TOKEN_NOT,
+        NOVA_TOKEN_ARROW, NOVA_TOKEN_ARROW_FN, NOVA_TOKEN_EQUAL, NOVA_TOKEN_BANG, NOVA_TOKEN_EOF,
+    };
+    assert(tokens.size == sizeof(expected) / sizeof(expected[0]));
+    for (size_t i = 0; i < tokens.size; ++i) {
+        assert(tokens.data[i].type == expected[i]);
+    }
+    nova_token_array_free(&tokens);
+
+    const char *source =
+        "module demo.operators\n"
+        "fun folded(): Number = 1 + 2 * 3 - 8 / 4 % 3\n"
+        "fun count(n: Number, acc: Number): Number = if n == 0 { acc } else { count(n - 1, acc + 1) }\n"
+        "fun counted(): Number = count(100000000, 0) - 99999958\n"
+        "fun band(x: Number): Number = if x < 0 or x > 10 { 1 } else { if not (x == 5) and x >= 2 { 2 } else { 3 } }\n"
+        "fun bands(): Number = band(-3) * 100 + band(7) * 10 + band(5)\n"
+        "fun fact(n: Number): Number = if n <= 1 { 1 } else { n * fact(n - 1) }\n"
+        "fun facts(): Number = fact(5) / 4 - -1 + 10 % 4\n"
+        "fun flips(b: Bool): Number = if b != true { 7 } else { 9 }\n"
+        "fun flipped(): Number = flips(false) + flips(3 < 2 == false) |> twice\n"
+        "fun twice(x: Number): Number = x * 2\n";
+
+    NovaParser parser;
+    nova_parser_init(&parser, source);
+    NovaProgram *program = nova_parser_parse(&parser);
+    assert(program != NULL);
+    assert(!parser.had_error);
+
+    // Multiplicative binds tighter than additive, and both associate to the left.
+    const NovaExpr *body = program->decls[0].as.fun_decl.body;
+    assert(body->kind == NOVA_EXPR_OPERATOR && body->as.op.op == NOVA_OP_SUB);
+    assert(body->as.op.left->kind == NOVA_EXPR_OPERATOR && body->as.op.left->as.op.op == NOVA_OP_ADD);
+    assert(body->as.op.right->as.op.op == NOVA_OP_MOD && body->as.op.right->as.op.left->as.op.op == NOVA_OP_DIV);
+    // A pipe takes the whole operator expression as its input.
+    assert(program->decls[8].as.fun_decl.body->kind == NOVA_EXPR_PIPE);
+
+    NovaSemanticContext ctx;
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+    assert(ctx.diagnostics.count == 0);
+
+    NovaIRProgram *ir = nova_ir_lower(program, &ctx);
+    assert(ir != NULL);
+    const NovaIRFunction *folded = find_function(ir, "folded");
+    assert(folded->body->kind == NOVA_IR_EXPR_NUMBER && folded->body->as.number_value == 5);
+    // `and` and `or` short-circuit through conditionals.
+    const NovaIRExpr *band = find_function(ir, "band")->body;
+    assert(band->kind == NOVA_IR_EXPR_IF && band->as.if_expr.condition->kind == NOVA_IR_EXPR_IF);
+    assert(find_function(ir, "fact")->body->as.if_expr.condition->kind == NOVA_IR_EXPR_OPERATOR);
+
+    NovaOptimizeOptions options;
+    nova_optimize_options_init(&options);
+    NovaOptimizeReport report;
+    char error[256] = {0};
+    assert(nova_optimize_program(ir, &ctx, &options, &report, error, sizeof(error)));
+    nova_optimize_report_free(&report);
+
+    const char *ir_path = "build/nova-operator-sample.ll";
+    assert(nova_codegen_emit_llvm_ir(ir, &ctx, ir_path, error, sizeof(error)));
+    char *text = read_file_contents(ir_path);
+    assert(text != NULL);
+    assert(strstr(text, "fcmp oeq double") != NULL);
+    assert(strstr(text, "fsub double") != NULL);
+    assert(strstr(text, "fmul double") != NULL);
+    assert(strstr(text, "icmp ne i1") != NULL);
+    assert(strstr(text, "xor i1") != NULL);
+    free(text);
+    remove(ir_path);
+
+    // The counting loop runs 10^8 iterations of native adds and compares.
+    for (int backend = 0; backend < 2; ++backend) {
+        nova_setenv("NOVA_CODEGEN_BACKEND", backend ? "llvm" : NULL);
+        assert(run_match_entry(ir, &ctx, "counted") == 42);
+        assert(run_match_entry(ir, &ctx, "bands") == 123);
+        assert(run_match_entry(ir, &ctx, "facts") == 33);
+        assert(run_match_entry(ir, &ctx, "flipped") == 32);
+    }
+    nova_setenv("NOVA_CODEGEN_BACKEND", NULL);
+
+    nova_ir_free(ir);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+
+    const char *mistyped =
+        "module demo.mistyped\n"
+        "fun sum(): Number = 1 + true\n"
+        "fun both(): Bool = 1 and true\n"
+        "fun same(): Bool = \"a\" == \"b\"\n";
+    nova_parser_init(&parser, mistyped);
+    program = nova_parser_parse(&parser);
+    assert(program != NULL);
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+    assert(ctx.diagnostics.count == 3);
+    assert(strcmp(ctx.diagnostics.items[0].message, "arithmetic operator expects Number or Int operands") == 0);
+    assert(strcmp(ctx.diagnostics.items[1].message, "logical operator expects Bool operands") == 0);
+    assert(strcmp(ctx.diagnostics.items[2].message, "equality operator expects Number, Int or Bool operands") == 0);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+}
+
+static void test_int_type(void) {
+    const char *source =
+        "module demo.ints\n"
+        "type Boxed = Wrap(Int)\n"
+        "type MaybeInt = Some(Int) | None\n"
+        "fun count(n: Int, acc: Int): Int = if n == 0 { acc } else { count(n - 1, acc + 1) }\n"
+        "fun counted(): Int = count(100000000, 0) - 99999958\n"
+        "fun classify(n: Int): Int = match n { 0 -> 10; 1 -> 20; _ -> 30 }\n"
+        "fun classes(): Int = classify(0) + classify(1) + classify(7)\n"
+        "fun divided(a: Int, b: Int): Int = a / b * 10 + a % b\n"
+        "fun quotients(): Int = divided(-7, 2) + 100\n"
+        "fun get(m: MaybeInt): Int = match m { Some(x) -> x; None -> 0 }\n"
+        "fun unwrap(b: Boxed): Int = match b { Wrap(x) -> x }\n"
+        "fun boxes(): Int = unwrap(Wrap(40)) + get(Some(2)) + get(None)\n"
+        "fun converted(x: Number): Int = Int(x * 2.5) + Int(Number(3) / 2)\n"
+        "fun conversions(): Int = converted(4)\n"
+        "fun wraps(x: Int): Bool = x + 1 < x\n"
+        "fun wrapped(): Int = if wraps(9223372036854775807) { 6 } else { 0 }\n"
+        "fun folded(): Int = 7 / 2 + -(3 * 4)\n"
+        "fun ratio(): Number = 7 / 2\n"
+        "fun offset(p: Int): Int = (p - 10)\n"
+        "fun offsets(): Int = offset(5) + 1 + 100\n"
+        "fun drift(n: Int, a: Int): Int = (if n == 0 { a - 10 } else { drift(n - 1, a + 1) })\n"
+        "fun drifted(): Int = drift(3, 0) + 100\n"
+        "fun mirrored(p: Int): Int = if -17 == p { (-17) + p } else { if -(17) < p { 1 } else { 2 } }\n"
+        "fun mirrors(): Int = mirrored(-17) + mirrored(0) * 10 + mirrored(-20) * 20 + 50\n";
+
+    NovaParser parser;
+    nova_parser_init(&parser, source);
+    NovaProgram *program = nova_parser_parse(&parser);
+    assert(program != NULL);
+    assert(!parser.had_error);
+
+    NovaSemanticContext ctx;
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+    assert(ctx.diagnostics.count == 0);
+
+    NovaIRProgram *ir = nova_ir_lower(program, &ctx);
+    assert(ir != NULL);
+    // Integral literals are Ints only where an Int is expected.
+    const NovaIRExpr *folded = find_function(ir, "folded")->body;
+    assert(folded->kind == NOVA_IR_EXPR_INT && folded->as.int_value == -9);
+    const NovaIRExpr *ratio = find_function(ir, "ratio")->body;
+    assert(ratio->kind == NOVA_IR_EXPR_NUMBER && ratio->as.number_value == 3.5);
+    const NovaIRExpr *converted = find_function(ir, "converted")->body;
+    assert(converted->kind == NOVA_IR_EXPR_OPERATOR && converted->as.op.left->as.op.op == NOVA_OP_TO_INT);
+    // Number(3) / 2 folds through the conversion, then truncates to 1.
+    assert(converted->as.op.right->kind == NOVA_IR_EXPR_INT && converted->as.op.right->as.int_value == 1);
+    // A parenthesized body keeps the declared result type.
+    assert(find_function(ir, "offset")->return_type == ctx.type_int);
+    assert(find_function(ir, "drift")->return_type == ctx.type_int);
+
+    NovaOptimizeOptions options;
+    nova_optimize_options_init(&options);
+    NovaOptimizeReport report;
+    char error[256] = {0};
+    assert(nova_optimize_program(ir, &ctx, &options, &report, error, sizeof(error)));
+    nova_optimize_report_free(&report);
+
+    const char *ir_path = "build/nova-int-sample.ll";
+    assert(nova_codegen_emit_llvm_ir(ir, &ctx, ir_path, error, sizeof(error)));
+    char *text = read_file_contents(ir_path);
+    assert(text != NULL);
+    assert(strstr(text, "define i64 @count(i64 %n, i64 %acc)") != NULL);
+    assert(strstr(text, "add i64") != NULL);
+    assert(strstr(text, "icmp slt i64") != NULL);
+    assert(strstr(text, "@nova.int.div") != NULL);
+    assert(strstr(text, "@llvm.fptosi.sat.i64.f64") != NULL);
+    assert(strstr(text, "fadd double") == NULL);
+    free(text);
+    remove(ir_path);
+
+    for (int backend = 0; backend < 2; ++backend) {
+        nova_setenv("NOVA_CODEGEN_BACKEND", backend ? "llvm" : NULL);
+        assert(run_match_entry(ir, &ctx, "counted") == 42);
+        assert(run_match_entry(ir, &ctx, "classes") == 60);
+        assert(run_match_entry(ir, &ctx, "quotients") == 69);
+        assert(run_match_entry(ir, &ctx, "boxes") == 42);
+        assert(run_match_entry(ir, &ctx, "conversions") == 11);
+        assert(run_match_entry(ir, &ctx, "wrapped") == 6);
+        assert(run_match_entry(ir, &ctx, "offsets") == 96);
+        assert(run_match_entry(ir, &ctx, "drifted") == 93);
+        assert(run_match_entry(ir, &ctx, "mirrors") == 66);
+    }
+    nova_setenv("NOVA_CODEGEN_BACKEND", NULL);
 
     nova_ir_free(ir);
     nova_semantic_context_free(&ctx);
     nova_program_free(program);
     free(program);
     nova_parser_free(&parser);
-    free(source);
 
-    cleanup_dir(project_dir);
+    const char *mistyped =
+        "module demo.mistyped\n"
+        "fun mixed(n: Int): Number = n * 2.5\n"
+        "fun huge(): Int = 9223372036854775808\n"
+        "fun text(): Int = Int(\"7\")\n"
+        "fun halved(): Int = (2.5)\n";
+    nova_parser_init(&parser, mistyped);
+    program = nova_parser_parse(&parser);
+    assert(program != NULL);
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+    assert(ctx.diagnostics.count == 4);
+    assert(strcmp(ctx.diagnostics.items[0].message, "operator mixes Int and Number; convert with Int(...) or Number(...)") == 0);
+    assert(strcmp(ctx.diagnostics.items[1].message, "integer literal out of range for Int") == 0);
+    assert(strcmp(ctx.diagnostics.items[2].message, "conversion expects a Number or Int argument") == 0);
+    assert(strcmp(ctx.diagnostics.items[3].message, "type mismatch") == 0);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
 }
 
 static void test_while_loop_codegen(void) {
@@ -992,7 +2751,7 @@ static void test_examples(void) {
     };
     const struct ExampleCheck examples[] = {
         { "examples/pipeline.nova", "" },
-        { "examples/options.nova", "--skip-codegen " },
+        { "examples/options.nova", "" },
         { "examples/loop.nova", "" },
     };
     for (size_t i = 0; i < sizeof(examples) / sizeof(examples[0]); ++i) {
@@ -1003,22 +2762,738 @@ static void test_examples(void) {
     }
 }
 
+static void test_closures(void) {
+    const char *source =
+        "module demo.closures\n"
+        "fun twice(x: Number): Number = x * 2\n"
+        "fun piped(): Number = 5 |> (y: Number) -> y + 1\n"
+        "fun local(): Number = {\n"
+        "    let n = 10\n"
+        "    let add = (x: Number) -> x + n\n"
+        "    add(3) + add(4)\n"
+        "}\n"
+        "fun adder(n: Number) = (x: Number) -> x + n\n"
+        "fun escaped(): Number = {\n"
+        "    let add5 = adder(5)\n"
+        "    add5(30)\n"
+        "}\n"
+        "fun chained(): Number = adder(1)(3)\n"
+        "fun named(): Number = {\n"
+        "    let g = twice\n"
+        "    g(21)\n"
+        "}\n"
+        "fun scale(k: Number, v: Number): Number = v |> (x: Number) -> x * k |> (y: Number) -> y + k\n"
+        "fun scaled(): Number = scale(3, 4)\n"
+        "fun nest(a: Number) = (b: Number) -> (c: Number) -> a + b + c\n"
+        "fun nested(): Number = nest(1)(2)(3)\n"
+        "fun pick(flag: Bool) = if flag { (x: Number) -> x + 1 } else { (x: Number) -> x - 1 }\n"
+        "fun picked(): Number = pick(true)(10) + pick(false)(10)\n";
+
+    NovaParser parser;
+    nova_parser_init(&parser, source);
+    NovaProgram *program = nova_parser_parse(&parser);
+    assert(program != NULL);
+    assert(!parser.had_error);
+
+    NovaSemanticContext ctx;
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+    assert(ctx.diagnostics.count == 0);
+
+    NovaIRProgram *ir = nova_ir_lower(program, &ctx);
+    assert(ir != NULL);
+    // A lambda applied where it is written is a direct call of the lifted function.
+    const NovaIRExpr *piped = find_function(ir, "piped")->body;
+    assert(piped->kind == NOVA_IR_EXPR_CALL && piped->as.call.arg_count == 1);
+    const NovaIRFunction *lifted = find_function(ir, "lambda__1");
+    assert(lifted != NULL && lifted->lifted && lifted->capture_count == 0);
+    // Captures become leading parameters, passed directly when the closure is known.
+    const NovaIRExpr *local = find_function(ir, "local")->body;
+    while (local->kind == NOVA_IR_EXPR_LET) local = local->as.let_expr.body;
+    assert(local->kind == NOVA_IR_EXPR_OPERATOR);
+    assert(local->as.op.left->kind == NOVA_IR_EXPR_CALL && local->as.op.left->as.call.arg_count == 2);
+    // An escaping lambda builds its environment; the caller goes through it.
+    const NovaIRExpr *adder = find_function(ir, "adder")->body;
+    assert(adder->kind == NOVA_IR_EXPR_CLOSURE && adder->as.closure.capture_count == 1);
+    const NovaIRFunction *adder_lambda = find_function(ir, "lambda__5");
+    assert(adder_lambda != NULL && adder_lambda->capture_count == 1 && adder_lambda->param_count == 2);
+    assert(find_function(ir, "chained")->body->kind == NOVA_IR_EXPR_APPLY);
+
+    for (int backend = 0; backend < 2; ++backend) {
+        nova_setenv("NOVA_CODEGEN_BACKEND", backend ? "llvm" : NULL);
+        assert(run_match_entry(ir, &ctx, "escaped") == 35);
+        assert(run_match_entry(ir, &ctx, "chained") == 4);
+        assert(run_match_entry(ir, &ctx, "nested") == 6);
+        assert(run_match_entry(ir, &ctx, "picked") == 20);
+    }
+    nova_setenv("NOVA_CODEGEN_BACKEND", NULL);
+
+    char error[256] = {0};
+    const char *ir_path = "build/nova-closure-sample.ll";
+    assert(nova_codegen_emit_llvm_ir(ir, &ctx, ir_path, error, sizeof(error)));
+    char *text = read_file_contents(ir_path);
+    assert(text != NULL);
+    assert(strstr(text, "%nova.env.lambda__5 = type { ptr, double }") != NULL);
+    assert(strstr(text, "call ptr @nova_rt_alloc(i64 ptrtoint (ptr getelementptr (%nova.env.lambda__5, ptr null, i32 1) to i64), ptr @nova.trace.env.lambda__5)") != NULL);
+    assert(strstr(text, "@nova.closure.twice = private unnamed_addr constant") != NULL);
+    free(text);
+    remove(ir_path);
+
+    NovaOptimizeOptions options;
+    nova_optimize_options_init(&options);
+    NovaOptimizeReport report;
+    assert(nova_optimize_program(ir, &ctx, &options, &report, error, sizeof(error)));
+    nova_optimize_report_free(&report);
+    // Inlining the lifted functions leaves nothing of the closures behind.
+    piped = find_function(ir, "piped")->body;
+    assert(piped->kind == NOVA_IR_EXPR_NUMBER && piped->as.number_value == 6);
+    const NovaIRExpr *chained = find_function(ir, "chained")->body;
+    assert(chained->kind == NOVA_IR_EXPR_NUMBER && chained->as.number_value == 4);
+
+    for (int backend = 0; backend < 2; ++backend) {
+        nova_setenv("NOVA_CODEGEN_BACKEND", backend ? "llvm" : NULL);
+        assert(run_match_entry(ir, &ctx, "local") == 27);
+        assert(run_match_entry(ir, &ctx, "escaped") == 35);
+        assert(run_match_entry(ir, &ctx, "named") == 42);
+        assert(run_match_entry(ir, &ctx, "scaled") == 15);
+        assert(run_match_entry(ir, &ctx, "picked") == 20);
+    }
+    nova_setenv("NOVA_CODEGEN_BACKEND", NULL);
+
+    nova_ir_free(ir);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+}
+
+static void test_managed_heap(void) {
+    // Each round builds and drops a 200 cell list, so collections run while
+    // the kept list is referenced only from the stack or a closure.
+    const char *source =
+        "module demo.heap\n"
+        "type List = Cons(Number, List) | Nil\n"
+        "fun build(n: Number, acc: List): List = if n == 0 { acc } else { build(n - 1, Cons(n, acc)) }\n"
+        "fun total(l: List, acc: Number): Number = match l { Cons(x, rest) -> total(rest, acc + x); Nil -> acc }\n"
+        "fun churn(n: Number, keep: List): Number = if n == 0 { total(keep, 0) } else { churn(n - 1 + (total(build(200, Nil), 0) - 20100), keep) }\n"
+        "fun summer(l: List) = (bias: Number) -> total(l, bias)\n"
+        "fun kept(): Number = churn(4000, build(100, Nil)) - 5000\n"
+        "fun captured(): Number = {\n"
+        "    let s = summer(build(100, Nil))\n"
+        "    churn(4000, Nil) + s(0) - 5000\n"
+        "}\n";
+
+    NovaParser parser;
+    nova_parser_init(&parser, source);
+    NovaProgram *program = nova_parser_parse(&parser);
+    assert(program != NULL);
+    assert(!parser.had_error);
+
+    NovaSemanticContext ctx;
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+    assert(ctx.diagnostics.count == 0);
+
+    NovaIRProgram *ir = nova_ir_lower(program, &ctx);
+    assert(ir != NULL);
+
+    char error[256] = {0};
+    const char *ir_path = "build/nova-heap-sample.ll";
+    assert(nova_codegen_emit_llvm_ir(ir, &ctx, ir_path, error, sizeof(error)));
+    char *text = read_file_contents(ir_path);
+    assert(text != NULL);
+    assert(strstr(text, "define private void @nova.trace.List(ptr %gc, ptr %value)") != NULL);
+    assert(strstr(text, "call ptr @nova_rt_alloc(i64 24, ptr @nova.trace.List)") != NULL);
+    assert(strstr(text, "call void @nova.trace.List(ptr %gc, ptr %c0.addr)") != NULL);
+    assert(strstr(text, "@malloc") == NULL);
+    free(text);
+    remove(ir_path);
+
+    for (int backend = 0; backend < 2; ++backend) {
+        nova_setenv("NOVA_CODEGEN_BACKEND", backend ? "llvm" : NULL);
+        assert(run_match_entry(ir, &ctx, "kept") == 50);
+        assert(run_match_entry(ir, &ctx, "captured") == 50);
+    }
+    nova_setenv("NOVA_CODEGEN_BACKEND", NULL);
+
+    nova_ir_free(ir);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+}
+
+static void test_lists(void) {
+    // 2000 pushes take the list through two tree levels; `base` is pushed onto
+    // twice, so the second push finds its tail slot claimed and must copy, and
+    // `wide` is a literal that starts out with a leaf in its tree.
+    const char *source =
+        "module demo.lists\n"
+        "type Shape = Circle(Number) | Square(Number)\n"
+        "fun fill(i: Int, n: Int, acc: List[Int]): List[Int] = if i == n { acc } else { fill(i + 1, n, push(acc, i)) }\n"
+        "fun sum(xs: List[Int], i: Int, acc: Int): Int = if i == length(xs) { acc } else { sum(xs, i + 1, acc + get(xs, i)) }\n"
+        "fun area(s: Shape): Number = match s { Circle(r) -> 3 * r * r; Square(w) -> w * w }\n"
+        "fun literal(): Int = length([1, 2, 3]) + get(get([[4], [5, 6]], 1), 1)\n"
+        "fun pushed(): Int = sum(fill(0, 2000, []), 0, 0) % 251\n"
+        "fun shapes(): Number = area(get([Circle(1), Square(3)], 1))\n"
+        "fun versions(): Int = {\n"
+        "    let base = fill(0, 40, [])\n"
+        "    let a = push(base, 100)\n"
+        "    let b = push(base, 200)\n"
+        "    get(a, 40) + get(b, 40) - get(base, 39) + length(base)\n"
+        "}\n"
+        "fun wide(): Number = {\n"
+        "    let xs = [0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33]\n"
+        "    let ys = push(push(xs, 34), 35)\n"
+        "    let zs = push(xs, 50)\n"
+        "    get(ys, 35) + get(xs, 33) + get(xs, 31) - get(zs, 34) + Number(length(xs))\n"
+        "}\n";
+
+    NovaParser parser;
+    nova_parser_init(&parser, source);
+    NovaProgram *program = nova_parser_parse(&parser);
+    assert(program != NULL);
+    assert(!parser.had_error);
+
+    NovaSemanticContext ctx;
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+    assert(ctx.diagnostics.count == 0);
+
+    NovaIRProgram *ir = nova_ir_lower(program, &ctx);
+    assert(ir != NULL);
+
+    char error[256] = {0};
+    const char *ir_path = "build/nova-list-sample.ll";
+    assert(nova_codegen_emit_llvm_ir(ir, &ctx, ir_path, error, sizeof(error)));
+    char *text = read_file_contents(ir_path);
+    assert(text != NULL);
+    // A literal is built in one call; a list of lists traces each element as a reference.
+    assert(strstr(text, "call ptr @nova_list_new(i64 ptrtoint (ptr getelementptr (ptr, ptr null, i32 1) to i64), ptr @nova_rt_trace_ref, i64 2, ptr %items)") != NULL);
+    assert(strstr(text, "call ptr @nova_list_push(ptr %list, i64 ptrtoint (ptr getelementptr (i64, ptr null, i32 1) to i64), ptr null, ptr %cell)") != NULL);
+    assert(strstr(text, "call i64 @nova_list_length(ptr %") != NULL);
+    free(text);
+    remove(ir_path);
+
+    for (int backend = 0; backend < 2; ++backend) {
+        nova_setenv("NOVA_CODEGEN_BACKEND", backend ? "llvm" : NULL);
+        assert(run_match_entry(ir, &ctx, "literal") == 9);
+        assert(run_match_entry(ir, &ctx, "pushed") == 1999000 % 251);
+        assert(run_match_entry(ir, &ctx, "shapes") == 9);
+        assert(run_match_entry(ir, &ctx, "versions") == 301 % 256);
+        assert(run_match_entry(ir, &ctx, "wide") == 35 + 33 + 31 - 50 + 34);
+    }
+    nova_setenv("NOVA_CODEGEN_BACKEND", NULL);
+
+    nova_ir_free(ir);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+}
+
+static void test_strings(void) {
+    // `rope` builds 150 bytes out of ten-byte pieces, which is past the flat
+    // limit, and matches it against a literal from the string table; `churn`
+    // keeps such a rope alive while thousands of others are collected.
+    // `forked` appends to one string twice, so the second append finds the
+    // buffer claimed and must copy it, and `keyed` compares 1200-byte strings
+    // that filled their buffers at different points.
+#define TEN "0123456789"
+    const char *source =
+        "module demo.strings\n"
+        "type Entry(key: String, hits: Int)\n"
+        "fun word(s: String): Int = match s {\n"
+        "    \"one\" -> 1\n"
+        "    \"seventeen\" -> 17\n"
+        "    \"a much longer literal key\" -> 40\n"
+        "    \"" TEN TEN TEN TEN TEN TEN TEN TEN TEN TEN TEN TEN TEN TEN TEN "\" -> 50\n"
+        "    _ -> 0\n"
+        "}\n"
+        "fun repeat(s: String, n: Int, acc: String): String = if n == 0 { acc } else { repeat(s, n - 1, acc + s) }\n"
+        "fun lengths(): Int = (length(\"hello\") + length(repeat(\"abc\", 100, \"\"))) % 256\n"
+        "fun pieces(): Int = word(\"seven\" + \"teen\") + word(\"o\" + \"ne\") + word(\"\"\"one\"\"\")\n"
+        "fun tagged(): Int = { let Entry(k, h) = Entry(\"a much longer literal key\", 3); word(k) + h }\n"
+        "fun rope(): Int = word(repeat(\"" TEN "\", 15, \"\"))\n"
+        "fun churn(n: Int, keep: String): Int = if n == 0 { word(keep) } else { churn(n - 1 + length(repeat(\"" TEN "\", 300, \"\")) - 3000, keep) }\n"
+        "fun kept(): Int = churn(2000, repeat(\"" TEN "\", 15, \"\"))\n"
+        "fun forked(): Int = {\n"
+        "    let base = repeat(\"" TEN "\", 14, \"\")\n"
+        "    let a = base + \"" TEN "\"\n"
+        "    let b = base + \"abc\"\n"
+        "    word(a) + word(base + \"" TEN "\") + length(b)\n"
+        "}\n"
+        "fun keyed(): Number = get(put(Map(), repeat(\"" TEN "\", 120, \"\"), 7), repeat(\"" TEN TEN "\", 60, \"\"))\n";
+#undef TEN
+
+    NovaParser parser;
+    nova_parser_init(&parser, source);
+    NovaProgram *program = nova_parser_parse(&parser);
+    assert(program != NULL);
+    assert(!parser.had_error);
+
+    NovaSemanticContext ctx;
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+    assert(ctx.diagnostics.count == 0);
+
+    NovaIRProgram *ir = nova_ir_lower(program, &ctx);
+    assert(ir != NULL);
+    // Each distinct literal is interned once, whether a value or a match key.
+    size_t long_keys = 0;
+    for (size_t i = 0; i < ir->string_count; ++i) {
+        if (ir->strings[i].length == 25 && memcmp(ir->strings[i].bytes, "a much longer literal key", 25) == 0) long_keys++;
+    }
+    assert(long_keys == 1);
+
+    char error[256] = {0};
+    const char *ir_path = "build/nova-string-sample.ll";
+    assert(nova_codegen_emit_llvm_ir(ir, &ctx, ir_path, error, sizeof(error)));
+    char *text = read_file_contents(ir_path);
+    assert(text != NULL);
+    // Long literals live in the one table; short ones are inline words.
+    const char *table = strstr(text, "@nova.strings = private unnamed_addr constant");
+    assert(table != NULL);
+    assert(strstr(table, "c\"a much longer literal key\\00\"") != NULL);
+    assert(strstr(text, "inttoptr i64 ") != NULL);
+    assert(strstr(text, "call ptr @nova_string_concat(ptr") != NULL);
+    assert(strstr(text, "call i64 @nova_string_length(ptr") != NULL);
+    free(text);
+    remove(ir_path);
+
+    for (int backend = 0; backend < 2; ++backend) {
+        nova_setenv("NOVA_CODEGEN_BACKEND", backend ? "llvm" : NULL);
+        assert(run_match_entry(ir, &ctx, "lengths") == 305 % 256);
+        assert(run_match_entry(ir, &ctx, "pieces") == 19);
+        assert(run_match_entry(ir, &ctx, "tagged") == 43);
+        assert(run_match_entry(ir, &ctx, "rope") == 50);
+        assert(run_match_entry(ir, &ctx, "kept") == 50);
+        assert(run_match_entry(ir, &ctx, "forked") == 243);
+        assert(run_match_entry(ir, &ctx, "keyed") == 7);
+    }
+    nova_setenv("NOVA_CODEGEN_BACKEND", NULL);
+
+    nova_ir_free(ir);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+
+    const char *mistyped =
+        "module demo.mistyped\n"
+        "fun glue(): String = \"a\" + 1\n";
+    nova_parser_init(&parser, mistyped);
+    program = nova_parser_parse(&parser);
+    assert(program != NULL);
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+    assert(ctx.diagnostics.count == 1);
+    assert(strcmp(ctx.diagnostics.items[0].message, "concatenation expects String operands") == 0);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+}
+
+static void test_maps(void) {
+    // `churn` puts one key and removes the previous one 20000 times, so old
+    // versions keep being collected while `fill`'s twenty keys stay live.
+    const char *source =
+        "module demo.maps\n"
+        "fun fill(m: Map[Int, Int], n: Int): Map[Int, Int] = if n == 0 { m } else { fill(put(m, n, n * 2), n - 1) }\n"
+        "fun sum(m: Map[Int, Int], n: Int, acc: Int): Int = if n == 0 { acc } else { sum(m, n - 1, acc + get(m, n)) }\n"
+        "fun total(): Int = sum(fill(Map(), 50), 50, 0) % 256\n"
+        "fun words(): Number = { let m = put(put(Map(), \"one\", 1), \"seven\" + \"teen\", 17); get(m, \"seventeen\") + get(m, \"one\") }\n"
+        "fun built(): Int = { let m = Map([\"a\", \"b\", \"c\"], [1, 2, 3]); length(remove(m, \"b\")) * 10 + length(m) }\n"
+        "fun versions(): Int = { let m = fill(Map(), 10); let n = remove(m, 3); if has(m, 3) { if has(n, 3) { 1 } else { 42 } } else { 2 } }\n"
+        "fun churn(m: Map[Int, Int], n: Int): Map[Int, Int] = if n == 0 { m } else { churn(remove(put(m, n + 1000, n), n + 1001), n - 1) }\n"
+        "fun kept(): Int = { let m = churn(fill(Map(), 20), 20000); length(m) + get(m, 20) + get(m, 1001) }\n";
+
+    NovaParser parser;
+    nova_parser_init(&parser, source);
+    NovaProgram *program = nova_parser_parse(&parser);
+    assert(program != NULL);
+    assert(!parser.had_error);
+
+    NovaSemanticContext ctx;
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+    assert(ctx.diagnostics.count == 0);
+
+    NovaIRProgram *ir = nova_ir_lower(program, &ctx);
+    assert(ir != NULL);
+
+    char error[256] = {0};
+    const char *ir_path = "build/nova-map-sample.ll";
+    assert(nova_codegen_emit_llvm_ir(ir, &ctx, ir_path, error, sizeof(error)));
+    char *text = read_file_contents(ir_path);
+    assert(text != NULL);
+    // String keys are passed by pointer with the String key kind; Map() of
+    // two empty lists needs no lists at all.
+    assert(strstr(text, "call ptr @nova_map_put(ptr %map, i32 1, ") != NULL);
+    assert(strstr(text, "call ptr @nova_map_put(ptr %map, i32 0, ") != NULL);
+    assert(strstr(text, "call ptr @nova_map_new()") != NULL);
+    assert(strstr(text, "call ptr @nova_map_from_lists(i32 1, ") != NULL);
+    free(text);
+    remove(ir_path);
+
+    for (int backend = 0; backend < 2; ++backend) {
+        nova_setenv("NOVA_CODEGEN_BACKEND", backend ? "llvm" : NULL);
+        assert(run_match_entry(ir, &ctx, "total") == 2550 % 256);
+        assert(run_match_entry(ir, &ctx, "words") == 18);
+        assert(run_match_entry(ir, &ctx, "built") == 23);
+        assert(run_match_entry(ir, &ctx, "versions") == 42);
+        assert(run_match_entry(ir, &ctx, "kept") == 21 + 40 + 1);
+    }
+    nova_setenv("NOVA_CODEGEN_BACKEND", NULL);
+
+    nova_ir_free(ir);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+
+    const char *mistyped =
+        "module demo.mistyped\n"
+        "fun index(m: Map[Bool, Int]): Int = length(m)\n";
+    nova_parser_init(&parser, mistyped);
+    program = nova_parser_parse(&parser);
+    assert(program != NULL);
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+    assert(ctx.diagnostics.count == 1);
+    assert(strcmp(ctx.diagnostics.items[0].message, "map keys must be Int or String") == 0);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+}
+
+static void test_native_backend(void) {
+    const char *source =
+        "module demo.native\n"
+        "fun fib(n: Int): Int = if n < 2 { n } else { fib(n - 1) + fib(n - 2) }\n"
+        "fun sum(n: Int, acc: Int): Int = if n == 0 { acc } else { sum(n - 1, acc + n) }\n"
+        "fun scale(x: Number, k: Int): Number = x * Number(k)\n"
+        "fun pick(b: Bool): Int = match b { true -> 1; false -> 2 }\n"
+        "fun classify(x: Int): Int = match x { 0 -> 10; 1 -> 20; _ -> 30 }\n"
+        "fun mix(a: Int, b: Number, c: Int, d: Number, e: Int, f: Int, g: Int): Number = Number(a + c + e + f + g) + b * d\n"
+        "fun deep(a: Int, b: Int, c: Int): Int = { let x = fib(a); let y = fib(b); x + y * 2 + c + fib(c) }\n"
+        "fun fibs(): Int = fib(20) % 256\n"
+        "fun sums(): Int = sum(1000000, 0) % 251\n"
+        "fun arith(): Int = (0 - 7) / 2 + (0 - 7) % 3 * 10 + 100\n"
+        "fun floats(): Number = (17.5 % 5.0) * 10.0 + scale(0.5, 4) - Number(Int(0.0 - 3.7))\n"
+        "fun branches(): Int = classify(0) + classify(1) + classify(7) + pick(1 < 2) * 100 + pick(2.0 < 1.0)\n"
+        "fun calls(): Int = Int(mix(1, 2.0, 3, 4.0, 5, 6, 7)) + deep(5, 6, 8) % 100\n"
+        "fun ping(n: Int, acc: Int): Int = if n == 0 { acc } else { pong(n - 1, acc + 1) }\n"
+        "fun pong(n: Int, acc: Int): Int = if n == 0 { acc } else { ping(n - 1, acc + 2) }\n"
+        "fun bounced(): Int = ping(10000000, 0) % 256\n";
+
+    NovaParser parser;
+    nova_parser_init(&parser, source);
+    NovaProgram *program = nova_parser_parse(&parser);
+    assert(program != NULL);
+    assert(parser.diagnostics.count == 0);
+    NovaSemanticContext ctx;
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+    assert(ctx.diagnostics.count == 0);
+    NovaIRProgram *ir = nova_ir_lower(program, &ctx);
+    assert(ir != NULL);
+
+    // The relocatable object links against C code calling the functions
+    // with the platform's calling convention.
+    char error[256] = {0};
+    nova_setenv("NOVA_CODEGEN_BACKEND", "native");
+    assert(nova_codegen_emit_object(ir, &ctx, "build/nova-native-sample.o", error, sizeof(error)));
+#ifndef _WIN32
+    assert(write_file_contents("build/nova-native-driver.c",
+                               "#include <stdbool.h>\n"
+                               "#include <stdint.h>\n"
+                               "int64_t fib(int64_t n);\n"
+                               "double scale(double x, int64_t k);\n"
+                               "int64_t pick(bool b);\n"
+                               "int main(void) { return fib(10) == 55 && scale(1.5, 4) == 6.0 && pick(true) == 1 ? 0 : 1; }\n"));
+    int rc = system("cc -o build/nova-native-driver build/nova-native-driver.c build/nova-native-sample.o && ./build/nova-native-driver");
+    assert(WIFEXITED(rc) && WEXITSTATUS(rc) == 0);
+    remove("build/nova-native-driver");
+#endif
+    remove("build/nova-native-driver.c");
+    remove("build/nova-native-sample.o");
+
+    // Before inlining folds them together, ping and pong only reach 10^7
+    // deep through sibling-call jumps.
+    assert(run_match_entry(ir, &ctx, "bounced") == 15000000 % 256);
+
+    NovaOptimizeOptions options;
+    nova_optimize_options_init(&options);
+    NovaOptimizeReport report;
+    assert(nova_optimize_program(ir, &ctx, &options, &report, error, sizeof(error)));
+    nova_optimize_report_free(&report);
+    for (int backend = 0; backend < 2; ++backend) {
+        nova_setenv("NOVA_CODEGEN_BACKEND", backend ? "native" : NULL);
+        assert(run_match_entry(ir, &ctx, "fibs") == 6765 % 256);
+        assert(run_match_entry(ir, &ctx, "sums") == 136);
+        assert(run_match_entry(ir, &ctx, "arith") == 87);
+        assert(run_match_entry(ir, &ctx, "floats") == 30);
+        assert(run_match_entry(ir, &ctx, "branches") == 162);
+        assert(run_match_entry(ir, &ctx, "calls") == 30 + 50);
+    }
+
+    nova_ir_free(ir);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+
+    // Anything outside the scalar subset is refused with a pointer to the
+    // other backends.
+    nova_parser_init(&parser, "module demo.text\nfun greet(): Int = length(\"hi\")\n");
+    program = nova_parser_parse(&parser);
+    assert(program != NULL);
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+    assert(ctx.diagnostics.count == 0);
+    ir = nova_ir_lower(program, &ctx);
+    assert(ir != NULL);
+    nova_setenv("NOVA_CODEGEN_BACKEND", "native");
+    assert(!nova_codegen_emit_executable(ir, &ctx, "build/nova-pattern-sample", "greet", error, sizeof(error)));
+    assert(strstr(error, "native backend does not support String values (in greet)") != NULL);
+    nova_setenv("NOVA_CODEGEN_BACKEND", NULL);
+
+    nova_ir_free(ir);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+}
+
+static void test_jit(void) {
+    const char *source =
+        "module demo.jit\n"
+        "fun fib(n: Int): Int = if n < 2 { n } else { fib(n - 1) + fib(n - 2) }\n"
+        "fun text(): Int = length(\"hi\")\n"
+        "fun div(a: Int, b: Int): Int = a / b\n"
+        "fun answer(): Int = fib(20) - 6723\n"
+        "fun half(): Number = Number(fib(7)) / 2.0\n"
+        "fun odd(): Bool = fib(8) % 2 == 1\n"
+        "fun guarded(flag: Bool): Int = if flag { text() } else { 5 }\n"
+        "fun lazy(): Int = guarded(false)\n"
+        "fun strict(): Int = guarded(true)\n"
+        "fun boom(): Int = div(1, 0)\n";
+
+    NovaParser parser;
+    nova_parser_init(&parser, source);
+    NovaProgram *program = nova_parser_parse(&parser);
+    assert(program != NULL);
+    assert(parser.diagnostics.count == 0);
+    NovaSemanticContext ctx;
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+    assert(ctx.diagnostics.count == 0);
+    NovaIRProgram *ir = nova_ir_lower(program, &ctx);
+    assert(ir != NULL);
+
+    NovaJit *jit = nova_jit_create(ir, &ctx);
+    assert(jit != NULL);
+    assert(nova_jit_compiled_count(jit) == 0);
+    NovaJitValue value;
+    char error[256] = {0};
+    assert(nova_jit_call(jit, "answer", &value, error, sizeof(error)));
+    assert(value.kind == NOVA_TYPE_KIND_INT && value.as.int_value == 42);
+    assert(nova_jit_compiled_count(jit) == 2);
+    assert(nova_jit_call(jit, "half", &value, error, sizeof(error)));
+    assert(value.kind == NOVA_TYPE_KIND_NUMBER && value.as.number == 6.5);
+    assert(nova_jit_call(jit, "odd", &value, error, sizeof(error)));
+    assert(value.kind == NOVA_TYPE_KIND_BOOL && value.as.bool_value);
+
+    // Functions compile on their first call, so one the backend cannot
+    // compile only fails once it is reached.
+    assert(nova_jit_call(jit, "lazy", &value, error, sizeof(error)));
+    assert(value.as.int_value == 5);
+    assert(!nova_jit_call(jit, "strict", &value, error, sizeof(error)));
+    assert(strstr(error, "native backend does not support String values (in text)") != NULL);
+    assert(!nova_jit_call(jit, "boom", &value, error, sizeof(error)));
+    assert(strstr(error, "trapped") != NULL);
+
+    // The engine survives both failures, and compiled code is callable from C.
+    int64_t (*fib)(int64_t) = reinterpret_cast<int64_t (*)(int64_t)>(nova_jit_function(jit, "fib", error, sizeof(error)));
+    assert(fib != NULL && fib(25) == 75025);
+    assert(nova_jit_function(jit, "missing", error, sizeof(error)) == NULL);
+    assert(strstr(error, "unknown function missing") != NULL);
+
+    char perf_path[64];
+    snprintf(perf_path, sizeof(perf_path), "/tmp/perf-%ld.map", (long)getpid());
+    char *perf_map = read_file_contents(perf_path);
+    assert(perf_map != NULL);
+    assert(strstr(perf_map, " fib\n") != NULL);
+    assert(strstr(perf_map, " answer\n") != NULL);
+    free(perf_map);
+    nova_jit_free(jit);
+    remove(perf_path);
+
+    nova_ir_free(ir);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+}
+
+static void test_vm(void) {
+    const char *source =
+        "module demo.vm\n"
+        "type Tree = Leaf | Node(Tree, Int, Tree)\n"
+        "type Shape = Circle(Number) | Square(Number) | Dot\n"
+        "fun fib(n: Int): Int = if n < 2 { n } else { fib(n - 1) + fib(n - 2) }\n"
+        "fun count(i: Int, acc: Int): Int = if i == 0 { acc } else { count(i - 1, acc + i) }\n"
+        "fun grow(d: Int, v: Int): Tree = if d == 0 { Leaf } else { Node(grow(d - 1, v * 2), v, grow(d - 1, v * 2 + 1)) }\n"
+        "fun total(t: Tree): Int = match t { Leaf -> 0; Node(l, x, r) -> total(l) + x + total(r) }\n"
+        "fun trees(k: Int, acc: Int): Int = if k == 0 { acc } else { trees(k - 1, acc + total(grow(8, 1))) }\n"
+        "fun area(s: Shape): Number = match s { Circle(r) -> 3.0 * r * r; Square(w) -> w * w; Dot -> 1.0 }\n"
+        "fun shapes(): Number = area(Circle(2.0)) + area(Square(3.0)) + area(Dot)\n"
+        "fun adder(n: Int) = (x: Int) -> x + n\n"
+        "fun applied(i: Int, acc: Int): Int = if i == 0 { acc } else { applied(i - 1, adder(i)(acc)) }\n"
+        "fun classify(n: Int): Int = match n { 0 -> 10; 1 -> 20; _ -> 30 }\n"
+        "fun big(): Bool = classify(5) > 25 and Int(-3.7) == -3\n"
+        "fun text(): Int = length(\"hi\")\n"
+        "fun guarded(flag: Bool): Int = if flag { text() } else { 5 }\n"
+        "fun div(a: Int, b: Int): Int = a / b\n";
+
+    NovaParser parser;
+    nova_parser_init(&parser, source);
+    NovaProgram *program = nova_parser_parse(&parser);
+    assert(program != NULL);
+    assert(parser.diagnostics.count == 0);
+    NovaSemanticContext ctx;
+    nova_semantic_context_init(&ctx);
+    nova_semantic_analyze_program(&ctx, program);
+    assert(ctx.diagnostics.count == 0);
+    NovaIRProgram *ir = nova_ir_lower(program, &ctx);
+    assert(ir != NULL);
+    NovaOptimizeReport report;
+    char error[256] = {0};
+    assert(nova_optimize_program(ir, &ctx, NULL, &report, error, sizeof(error)));
+    nova_optimize_report_free(&report);
+
+    NovaVMProgram *bytecode = nova_vm_compile(ir, &ctx, error, sizeof(error));
+    assert(bytecode != NULL);
+    NovaVM *vm = nova_vm_create(bytecode);
+    assert(vm != NULL);
+    NovaVMValue args[2];
+    NovaVMValue value;
+    args[0].kind = NOVA_TYPE_KIND_INT;
+    args[0].as.int_value = 20;
+    assert(nova_vm_call(vm, "fib", args, 1, &value, error, sizeof(error)));
+    assert(value.kind == NOVA_TYPE_KIND_INT && value.as.int_value == 6765);
+    // Self tail calls loop in one frame, however deep the recursion.
+    args[0].as.int_value = 1000000;
+    args[1].kind = NOVA_TYPE_KIND_INT;
+    args[1].as.int_value = 0;
+    assert(nova_vm_call(vm, "count", args, 2, &value, error, sizeof(error)));
+    assert(value.as.int_value == 500000500000LL);
+    assert(nova_vm_call(vm, "shapes", NULL, 0, &value, error, sizeof(error)));
+    assert(value.kind == NOVA_TYPE_KIND_NUMBER && value.as.number == 22.0);
+    assert(nova_vm_call(vm, "big", NULL, 0, &value, error, sizeof(error)));
+    assert(value.kind == NOVA_TYPE_KIND_BOOL && value.as.bool_value);
+    args[0].as.int_value = 1000;
+    assert(nova_vm_call(vm, "applied", args, 2, &value, error, sizeof(error)));
+    assert(value.as.int_value == 500500);
+
+    // Trees are garbage once summed, so building many of them collects.
+    args[0].as.int_value = 200;
+    assert(nova_vm_call(vm, "trees", args, 2, &value, error, sizeof(error)));
+    assert(value.as.int_value == 200 * 32640);
+    NovaGCStats stats = nova_vm_gc_stats(vm);
+    assert(stats.collections > 0);
+    assert(stats.objects_swept > 0);
+
+    // Functions the VM cannot run fail when reached, and traps are errors.
+    args[0].kind = NOVA_TYPE_KIND_BOOL;
+    args[0].as.bool_value = false;
+    assert(nova_vm_call(vm, "guarded", args, 1, &value, error, sizeof(error)));
+    assert(value.as.int_value == 5);
+    args[0].as.bool_value = true;
+    assert(!nova_vm_call(vm, "guarded", args, 1, &value, error, sizeof(error)));
+    assert(strstr(error, "bytecode VM does not support String values") != NULL);
+    args[0].kind = NOVA_TYPE_KIND_INT;
+    args[0].as.int_value = 1;
+    args[1].as.int_value = 0;
+    assert(!nova_vm_call(vm, "div", args, 2, &value, error, sizeof(error)));
+    assert(strstr(error, "division by zero in div") != NULL);
+    assert(!nova_vm_call(vm, "fib", args, 2, &value, error, sizeof(error)));
+    assert(strstr(error, "fib takes 1 arguments") != NULL);
+    assert(!nova_vm_call(vm, "missing", NULL, 0, &value, error, sizeof(error)));
+    assert(strstr(error, "unknown function missing") != NULL);
+
+    // Comparisons with a small constant fuse with their branch; matches switch on the tag.
+    char *listing = NULL;
+    size_t listing_size = 0;
+    FILE *out = open_memstream(&listing, &listing_size);
+    assert(out != NULL);
+    assert(nova_vm_disassemble(bytecode, "fib", out));
+    assert(nova_vm_disassemble(bytecode, "total", out));
+    assert(!nova_vm_disassemble(bytecode, "missing", out));
+    fclose(out);
+    assert(strstr(listing, "JILTI") != NULL);
+    assert(strstr(listing, "SWITCH") != NULL);
+    assert(strstr(listing, "CALL        r2, fib") != NULL);
+    free(listing);
+
+    nova_vm_free(vm);
+    nova_vm_program_free(bytecode);
+    nova_ir_free(ir);
+    nova_semantic_context_free(&ctx);
+    nova_program_free(program);
+    free(program);
+    nova_parser_free(&parser);
+}
+
 int main(void) {
     test_gc_preserves_reachable_objects();
     test_gc_incremental_steps();
     test_gc_mock_allocator_and_failure();
+    test_gc_root_scanner_and_ownership();
     test_parser_and_semantics();
     test_parser_reports_recoverable_errors();
     test_lexer_keyword_classification();
     test_lexer_large_input_tokenization();
+    test_number_conversions();
     test_match_exhaustiveness_warning();
     test_codegen_uses_low_latency_flags();
+    test_codegen_pipes_source_to_compiler();
     test_aot_executable_generation();
+    test_partitioned_codegen();
+    test_object_cache();
+    test_profile_guided_build();
+    test_target_cpu_and_multiversioning();
     test_llvm_backend_codegen();
     test_llvm_backend_stability_stress();
     test_codegen_pipeline();
     test_ir_lowering_extensions();
     test_ir_control_flow_optimizations();
+    test_ir_inliner_collapses_pipelines();
+    test_dead_function_elimination();
+    test_effect_aware_common_call_elimination();
+    test_tail_calls_become_loops();
+    test_tail_calls_with_shadowed_params();
+    test_llvm_tail_calls_with_aggregates();
+    test_function_attributes_from_effects();
+    test_match_compiles_to_switch();
+    test_match_decision_trees();
+    test_match_coverage_from_decision_tree();
+    test_perfect_hash_string_keys();
+    test_sum_type_layouts();
+    test_tuple_types();
+    test_native_operators();
+    test_int_type();
+    test_closures();
+    test_managed_heap();
+    test_lists();
+    test_strings();
+    test_maps();
+    test_native_backend();
+    test_jit();
+    test_vm();
     test_while_loop_codegen();
     test_project_generator();
     test_stability_checker_cli();
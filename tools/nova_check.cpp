@@ -19,8 +19,12 @@
 
 #include "nova/codegen.h"
 #include "nova/ir.h"
+#include "nova/numconv.h"
+#include "nova/optimize.h"
 #include "nova/parser.h"
+#include "nova/profile.h"
 #include "nova/semantic.h"
+#include "nova/vm.h"
 
 static char *read_file_contents(const char *path) {
     FILE *file = fopen(path, "rb");
@@ -75,6 +79,14 @@ static long nova_process_id(void) {
 #endif
 }
 
+static int nova_setenv(const char *name, const char *value) {
+#ifdef _WIN32
+    return _putenv_s(name, value);
+#else
+    return setenv(name, value, 1);
+#endif
+}
+
 static void print_diagnostics(const char *label, const NovaDiagnosticList *list) {
     if (!list || list->count == 0) {
         return;
@@ -98,15 +110,50 @@ static size_t diagnostic_count(const NovaDiagnosticList *list, NovaDiagnosticSev
     return count;
 }
 
+// Interprets entry, which takes no parameters, on the bytecode VM.
+static bool run_entry(const NovaIRProgram *ir, const NovaSemanticContext *ctx, const char *entry) {
+    char error[256] = {0};
+    NovaVMProgram *bytecode = nova_vm_compile(ir, ctx, error, sizeof(error));
+    NovaVM *vm = bytecode ? nova_vm_create(bytecode) : NULL;
+    NovaVMValue result;
+    bool ok = vm && nova_vm_call(vm, entry, NULL, 0, &result, error, sizeof(error));
+    if (!ok) {
+        fprintf(stderr, "nova-check: %s\n", error[0] ? error : "out of memory");
+    } else if (result.kind == NOVA_TYPE_KIND_NUMBER) {
+        char text[NOVA_NUMBER_BUFFER_SIZE];
+        nova_number_show(result.as.number, text);
+        printf("%s\n", text);
+    } else if (result.kind == NOVA_TYPE_KIND_INT) {
+        printf("%lld\n", (long long)result.as.int_value);
+    } else if (result.kind == NOVA_TYPE_KIND_BOOL) {
+        printf("%s\n", result.as.bool_value ? "true" : "false");
+    } else if (result.kind == NOVA_TYPE_KIND_UNIT) {
+        printf("()\n");
+    } else {
+        printf("<value>\n");
+    }
+    nova_vm_free(vm);
+    nova_vm_program_free(bytecode);
+    return ok;
+}
+
 static void usage(const char *argv0) {
-    fprintf(stderr, "Usage: %s [--strict] [--skip-codegen] [--emit-aot <path>] [--entry <function>] <file>\n", argv0);
+    fprintf(stderr, "Usage: %s [--strict] [--skip-codegen] [--no-opt] [--emit-aot <path>] [--pgo-generate <dir>] [--pgo-use <dir>] [--target-cpu <name|native>] [--multiversion] [--run] [--entry <function>] [--export <function>]... <file>\n", argv0);
 }
 
 int main(int argc, char **argv) {
     bool strict = false;
     bool skip_codegen = false;
+    bool optimize = true;
     const char *aot_output = NULL;
+    const char *pgo_generate = NULL;
+    const char *pgo_use = NULL;
+    const char *target_cpu = NULL;
+    bool multiversion = false;
+    bool run = false;
     const char *entry_function = "main";
+    const char **exports = static_cast<const char **>(calloc((size_t)argc, sizeof(const char *)));
+    size_t export_count = 0;
     const char *path = NULL;
 
     for (int i = 1; i < argc; ++i) {
@@ -114,37 +161,80 @@ int main(int argc, char **argv) {
             strict = true;
         } else if (strcmp(argv[i], "--skip-codegen") == 0) {
             skip_codegen = true;
+        } else if (strcmp(argv[i], "--no-opt") == 0) {
+            optimize = false;
         } else if (strcmp(argv[i], "--emit-aot") == 0) {
             if (i + 1 >= argc) {
                 usage(argv[0]);
+                free(exports);
                 return 2;
             }
             aot_output = argv[++i];
+        } else if (strcmp(argv[i], "--pgo-generate") == 0 || strcmp(argv[i], "--pgo-use") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                free(exports);
+                return 2;
+            }
+            if (strcmp(argv[i], "--pgo-generate") == 0) {
+                pgo_generate = argv[++i];
+            } else {
+                pgo_use = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--target-cpu") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                free(exports);
+                return 2;
+            }
+            target_cpu = argv[++i];
+        } else if (strcmp(argv[i], "--multiversion") == 0) {
+            multiversion = true;
+        } else if (strcmp(argv[i], "--run") == 0) {
+            run = true;
         } else if (strcmp(argv[i], "--entry") == 0) {
             if (i + 1 >= argc) {
                 usage(argv[0]);
+                free(exports);
                 return 2;
             }
             entry_function = argv[++i];
+        } else if (strcmp(argv[i], "--export") == 0) {
+            if (i + 1 >= argc || !exports) {
+                usage(argv[0]);
+                free(exports);
+                return 2;
+            }
+            exports[export_count++] = argv[++i];
         } else if (argv[i][0] == '-') {
             usage(argv[0]);
+            free(exports);
             return 2;
         } else if (!path) {
             path = argv[i];
         } else {
             usage(argv[0]);
+            free(exports);
             return 2;
         }
     }
 
-    if (!path) {
+    if (!path || (pgo_generate && pgo_use)) {
         usage(argv[0]);
+        free(exports);
         return 2;
     }
+    // Code generation reads the profile directories and target options from
+    // the environment.
+    if (pgo_generate) nova_setenv("NOVA_PGO_GENERATE", pgo_generate);
+    if (pgo_use) nova_setenv("NOVA_PGO_USE", pgo_use);
+    if (target_cpu) nova_setenv("NOVA_TARGET_CPU", target_cpu);
+    if (multiversion) nova_setenv("NOVA_MULTIVERSION", "1");
 
     char *source = read_file_contents(path);
     if (!source) {
         fprintf(stderr, "nova-check: failed to read %s\n", path);
+        free(exports);
         return 1;
     }
 
@@ -155,6 +245,7 @@ int main(int argc, char **argv) {
         print_diagnostics("parser", &parser.diagnostics);
         nova_parser_free(&parser);
         free(source);
+        free(exports);
         return 1;
     }
 
@@ -171,6 +262,7 @@ int main(int argc, char **argv) {
         free(program);
         nova_parser_free(&parser);
         free(source);
+        free(exports);
         return 1;
     }
 
@@ -183,9 +275,72 @@ int main(int argc, char **argv) {
             free(program);
             nova_parser_free(&parser);
             free(source);
+            free(exports);
+            return 1;
+        }
+
+        char profile_error[256] = {0};
+        if (pgo_use && !nova_profile_apply(ir, pgo_use, profile_error, sizeof(profile_error))) {
+            fprintf(stderr, "nova-check: %s\n", profile_error[0] ? profile_error : "cannot apply profile");
+            nova_ir_free(ir);
+            nova_semantic_context_free(&ctx);
+            nova_program_free(program);
+            free(program);
+            nova_parser_free(&parser);
+            free(source);
+            free(exports);
             return 1;
         }
 
+        if (optimize) {
+            NovaOptimizeOptions options;
+            nova_optimize_options_init(&options);
+            // Executables and interpreted runs only need what the entry point reaches; objects keep their exports.
+            if (aot_output || run) {
+                options.roots = &entry_function;
+                options.root_count = 1;
+            } else {
+                options.roots = exports;
+                options.root_count = export_count;
+            }
+            NovaOptimizeReport report;
+            char error[256] = {0};
+            if (!nova_optimize_program(ir, &ctx, &options, &report, error, sizeof(error))) {
+                fprintf(stderr, "nova-check: %s\n", error[0] ? error : "optimisation failed");
+                nova_optimize_report_free(&report);
+                nova_ir_free(ir);
+                nova_semantic_context_free(&ctx);
+                nova_program_free(program);
+                free(program);
+                nova_parser_free(&parser);
+                free(source);
+                free(exports);
+                return 1;
+            }
+            if (report.removed_function_count > 0 || report.removed_type_count > 0) {
+                printf("nova-check: removed %zu unreachable functions and %zu unused types\n", report.removed_function_count, report.removed_type_count);
+                for (size_t i = 0; i < report.removed_function_count; ++i) {
+                    printf("  fun %.*s\n", (int)report.removed_functions[i].length, report.removed_functions[i].lexeme);
+                }
+                for (size_t i = 0; i < report.removed_type_count; ++i) {
+                    printf("  type %.*s\n", (int)report.removed_types[i].length, report.removed_types[i].lexeme);
+                }
+            }
+            nova_optimize_report_free(&report);
+        }
+
+        if (run) {
+            bool ok = run_entry(ir, &ctx, entry_function);
+            nova_ir_free(ir);
+            nova_semantic_context_free(&ctx);
+            nova_program_free(program);
+            free(program);
+            nova_parser_free(&parser);
+            free(source);
+            free(exports);
+            return ok ? 0 : 1;
+        }
+
         if (nova_mkdir("build", 0755) != 0 && errno != EEXIST) {
             fprintf(stderr, "nova-check: failed to create build directory\n");
             nova_ir_free(ir);
@@ -194,6 +349,7 @@ int main(int argc, char **argv) {
             free(program);
             nova_parser_free(&parser);
             free(source);
+            free(exports);
             return 1;
         }
 
@@ -218,6 +374,7 @@ int main(int argc, char **argv) {
             free(program);
             nova_parser_free(&parser);
             free(source);
+            free(exports);
             return 1;
         }
         if (!aot_output) {
@@ -233,5 +390,6 @@ int main(int argc, char **argv) {
     free(program);
     nova_parser_free(&parser);
     free(source);
+    free(exports);
     return 0;
 }
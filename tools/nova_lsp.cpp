@@ -166,6 +166,9 @@ static void describe_type(const NovaSemanticContext *ctx, NovaTypeId type, char
     case NOVA_TYPE_KIND_NUMBER:
         snprintf(buffer, size, "Number");
         break;
+    case NOVA_TYPE_KIND_INT:
+        snprintf(buffer, size, "Int");
+        break;
     case NOVA_TYPE_KIND_STRING:
         snprintf(buffer, size, "String");
         break;
@@ -178,6 +181,9 @@ static void describe_type(const NovaSemanticContext *ctx, NovaTypeId type, char
     case NOVA_TYPE_KIND_LIST:
         snprintf(buffer, size, "List");
         break;
+    case NOVA_TYPE_KIND_MAP:
+        snprintf(buffer, size, "Map");
+        break;
     case NOVA_TYPE_KIND_FUNCTION:
         snprintf(buffer, size, "Function");
         break;
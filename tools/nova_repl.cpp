@@ -3,6 +3,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "nova/ir.h"
+#include "nova/jit.h"
+#include "nova/numconv.h"
 #include "nova/parser.h"
 #include "nova/semantic.h"
 
@@ -11,6 +14,7 @@ static const char *type_name(const NovaSemanticContext *ctx, NovaTypeId type) {
     if (!info) return "Unknown";
     switch (info->kind) {
     case NOVA_TYPE_KIND_NUMBER: return "Number";
+    case NOVA_TYPE_KIND_INT: return "Int";
     case NOVA_TYPE_KIND_STRING: return "String";
     case NOVA_TYPE_KIND_BOOL: return "Bool";
     case NOVA_TYPE_KIND_UNIT: return "Unit";
@@ -21,10 +25,76 @@ static const char *type_name(const NovaSemanticContext *ctx, NovaTypeId type) {
         return "Custom";
     case NOVA_TYPE_KIND_FUNCTION: return "Function";
     case NOVA_TYPE_KIND_LIST: return "List";
+    case NOVA_TYPE_KIND_MAP: return "Map";
     default: return "Unknown";
     }
 }
 
+// Definitions entered so far; each input is checked together with them.
+static char *session;
+
+static char *session_source(const char *prefix, const char *line) {
+    const char *header = "module repl.session\n";
+    const char *defined = session ? session : "";
+    size_t length = strlen(header) + strlen(defined) + strlen(prefix) + strlen(line) + 2;
+    char *source = static_cast<char *>(malloc(length));
+    if (source) snprintf(source, length, "%s%s%s%s\n", header, defined, prefix, line);
+    return source;
+}
+
+static bool is_definition(const char *line) {
+    while (*line == ' ' || *line == '\t') line++;
+    return strncmp(line, "fun ", 4) == 0 || strncmp(line, "type ", 5) == 0;
+}
+
+static void print_value(const NovaJitValue *value) {
+    char text[NOVA_NUMBER_BUFFER_SIZE];
+    switch (value->kind) {
+    case NOVA_TYPE_KIND_INT: printf("%lld", (long long)value->as.int_value); break;
+    case NOVA_TYPE_KIND_BOOL: printf("%s", value->as.bool_value ? "true" : "false"); break;
+    case NOVA_TYPE_KIND_UNIT: printf("()"); break;
+    default:
+        nova_number_show(value->as.number, text);
+        printf("%s", text);
+        break;
+    }
+}
+
+// Expressions become the body of a function `it`, which the JIT compiles
+// and runs; values outside the JIT's scalar subset only report their type.
+static void evaluate(NovaProgram *program, const NovaSemanticContext *ctx) {
+    NovaIRProgram *ir = nova_ir_lower(program, ctx);
+    if (!ir) {
+        fprintf(stderr, "lowering failed\n");
+        return;
+    }
+    NovaToken name = {};
+    name.lexeme = "it";
+    name.length = 2;
+    size_t index = nova_ir_find_function(ir, &name);
+    NovaTypeId type = index != SIZE_MAX ? ir->functions[index].return_type : ctx->type_unknown;
+    const NovaTypeInfo *info = nova_semantic_type_info(ctx, type);
+    NovaTypeKind kind = info ? info->kind : NOVA_TYPE_KIND_UNKNOWN;
+    if (kind == NOVA_TYPE_KIND_NUMBER || kind == NOVA_TYPE_KIND_INT || kind == NOVA_TYPE_KIND_BOOL || kind == NOVA_TYPE_KIND_UNIT) {
+        NovaJit *jit = nova_jit_create(ir, ctx);
+        NovaJitValue value;
+        char error[256] = {0};
+        if (jit && nova_jit_call(jit, "it", &value, error, sizeof(error))) {
+            printf("=> ");
+            print_value(&value);
+            printf(" : %s\n", type_name(ctx, type));
+        } else if (strstr(error, "does not support")) {
+            printf("=> %s (not evaluated: %s)\n", type_name(ctx, type), error);
+        } else {
+            fprintf(stderr, "error: %s\n", jit ? error : "cannot start the JIT");
+        }
+        nova_jit_free(jit);
+    } else {
+        printf("=> %s\n", type_name(ctx, type));
+    }
+    nova_ir_free(ir);
+}
+
 int main(void) {
     char line[1024];
     printf("nova> ");
@@ -32,20 +102,23 @@ int main(void) {
         if (strncmp(line, ":quit", 5) == 0) {
             break;
         }
-        const char *header = "module repl.session\n";
-        size_t source_len = strlen(header) + strlen("let it = ") + strlen(line) + 1;
-        char *source = static_cast<char *>(malloc(source_len));
+        line[strcspn(line, "\n")] = '\0';
+        bool definition = is_definition(line);
+        char *source = session_source(definition ? "" : "fun it() = ", line);
         if (!source) {
             fprintf(stderr, "allocation failed\n");
             return 1;
         }
-        snprintf(source, source_len, "%slet it = %s", header, line);
 
         NovaParser parser;
         nova_parser_init(&parser, source);
         NovaProgram *program = nova_parser_parse(&parser);
         if (!program || parser.had_error) {
             fprintf(stderr, "parse error (%zu issues)\n", parser.diagnostics.count);
+            if (program) {
+                nova_program_free(program);
+                free(program);
+            }
             nova_parser_free(&parser);
             free(source);
             printf("nova> ");
@@ -57,14 +130,17 @@ int main(void) {
         nova_semantic_analyze_program(&ctx, program);
         if (ctx.diagnostics.count > 0) {
             fprintf(stderr, "semantic issues detected (%zu)\n", ctx.diagnostics.count);
-        } else {
-            const NovaLetDecl *decl = &program->decls[0].as.let_decl;
-            const NovaExprInfo *info = nova_semantic_lookup_expr(&ctx, decl->value);
-            if (info) {
-                printf("=> %s\n", type_name(&ctx, info->type));
-            } else {
-                printf("=> Unknown\n");
+        } else if (definition) {
+            // Accepted definitions join the session.
+            size_t used = session ? strlen(session) : 0;
+            char *grown = static_cast<char *>(realloc(session, used + strlen(line) + 2));
+            if (grown) {
+                session = grown;
+                snprintf(session + used, strlen(line) + 2, "%s\n", line);
+                printf("defined\n");
             }
+        } else {
+            evaluate(program, &ctx);
         }
 
         nova_semantic_context_free(&ctx);
@@ -74,7 +150,7 @@ int main(void) {
         free(source);
         printf("nova> ");
     }
+    free(session);
     printf("bye\n");
     return 0;
 }
-